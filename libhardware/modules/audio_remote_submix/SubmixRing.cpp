@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "r_submix"
+
+#include <algorithm>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cutils/atomic.h>
+#include <cutils/log.h>
+
+#include "SubmixRing.h"
+
+// How long the headroom of the readers is watched before the target is shrunk.
+#define ADAPT_WINDOW_NS 2000000000LL
+
+namespace android {
+
+static size_t roundUpPowerOfTwo(size_t frames)
+{
+    size_t capacity = 1;
+    while (capacity < frames) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+SubmixRing::SubmixRing(size_t frameSize, size_t minFrames, size_t periodFrames)
+    : mFrameSize(frameSize),
+      mCapacity(roundUpPowerOfTwo(std::max(minFrames, 4 * periodFrames))),
+      mPeriodFrames(periodFrames),
+      mMinTargetFrames(periodFrames * 5 / 4),
+      mMaxTargetFrames(mCapacity - 2 * periodFrames),
+      mWritePos(0),
+      mWriteLimit(0),
+      mShutdown(0),
+      mWindowStartNs(0),
+      mWindowMinHeadroom(SSIZE_MAX)
+{
+    mData = (uint8_t*)calloc(mCapacity, mFrameSize);
+    mTargetFrames = std::min(std::max((int32_t)(2 * periodFrames), mMinTargetFrames),
+            mMaxTargetFrames);
+    memset(mReaders, 0, sizeof(mReaders));
+    pthread_mutex_init(&mLock, NULL);
+    ALOGV("SubmixRing: capacity %zu frames, period %zu, target %d", mCapacity, mPeriodFrames,
+            mTargetFrames);
+}
+
+SubmixRing::~SubmixRing()
+{
+    free(mData);
+    pthread_mutex_destroy(&mLock);
+}
+
+size_t SubmixRing::write(const void* buffer, size_t frames)
+{
+    const uint8_t* src = (const uint8_t*)buffer;
+    int32_t pos = mWritePos;
+    size_t count = frames;
+    if (count > mCapacity) {
+        // The frames that would be overwritten by this same write are skipped.
+        src += (count - mCapacity) * mFrameSize;
+        pos += count - mCapacity;
+        count = mCapacity;
+    }
+    const int32_t end = pos + count;
+
+    // Readers check the limit after copying, so it must be visible before any slot changes.
+    android_atomic_release_store(end, &mWriteLimit);
+    android_memory_barrier();
+
+    const size_t index = pos & (mCapacity - 1);
+    const size_t first = std::min(count, mCapacity - index);
+    memcpy(mData + index * mFrameSize, src, first * mFrameSize);
+    if (first < count) {
+        memcpy(mData, src + first * mFrameSize, (count - first) * mFrameSize);
+    }
+
+    android_atomic_release_store(end, &mWritePos);
+    return frames;
+}
+
+int SubmixRing::addReader()
+{
+    pthread_mutex_lock(&mLock);
+    for (int i = 0; i < MAX_READERS; i++) {
+        Reader* reader = &mReaders[i];
+        if (!reader->active) {
+            memset(&reader->stats, 0, sizeof(reader->stats));
+            reader->position = android_atomic_acquire_load(&mWritePos) - targetFrames();
+            android_atomic_release_store(1, &reader->active);
+            pthread_mutex_unlock(&mLock);
+            return i;
+        }
+    }
+    pthread_mutex_unlock(&mLock);
+    return -ENOSPC;
+}
+
+void SubmixRing::removeReader(int reader)
+{
+    pthread_mutex_lock(&mLock);
+    android_atomic_release_store(0, &mReaders[reader].active);
+    pthread_mutex_unlock(&mLock);
+}
+
+void SubmixRing::resyncReader(int reader)
+{
+    android_atomic_release_store(android_atomic_acquire_load(&mWritePos) - targetFrames(),
+            &mReaders[reader].position);
+}
+
+size_t SubmixRing::availableToRead(int reader) const
+{
+    const int32_t behind = framesBehind(android_atomic_acquire_load(&mWritePos),
+            mReaders[reader].position);
+    return std::min((size_t)std::max(behind, 0), mCapacity);
+}
+
+void SubmixRing::overrun_l(Reader* reader, int32_t writePos)
+{
+    const int32_t resyncPos = writePos - targetFrames();
+    const int32_t skipped = framesBehind(resyncPos, reader->position);
+    reader->stats.overruns++;
+    reader->stats.overrunFrames += std::max(skipped, 0);
+    android_atomic_release_store(resyncPos, &reader->position);
+}
+
+ssize_t SubmixRing::read(int reader, void* buffer, size_t frames)
+{
+    Reader* r = &mReaders[reader];
+    // After an overrun the reader is targetFrames() behind the writer, far enough from being
+    // lapped again that one retry is enough unless the reader thread stalls mid-copy.
+    for (int attempt = 0; attempt < 2; attempt++) {
+        const int32_t pos = r->position;
+        const int32_t writePos = android_atomic_acquire_load(&mWritePos);
+        if (framesBehind(writePos, pos) > (int32_t)mCapacity) {
+            pthread_mutex_lock(&mLock);
+            overrun_l(r, writePos);
+            pthread_mutex_unlock(&mLock);
+            continue;
+        }
+        const size_t count = std::min(frames, (size_t)std::max(framesBehind(writePos, pos), 0));
+        if (count == 0) {
+            return 0;
+        }
+
+        const size_t index = pos & (mCapacity - 1);
+        const size_t first = std::min(count, mCapacity - index);
+        memcpy(buffer, mData + index * mFrameSize, first * mFrameSize);
+        if (first < count) {
+            memcpy((uint8_t*)buffer + first * mFrameSize, mData, (count - first) * mFrameSize);
+        }
+
+        // If a write that started during the copy reached the frames copied, they may be torn.
+        android_memory_barrier();
+        const int32_t writeLimit = android_atomic_acquire_load(&mWriteLimit);
+        if (framesBehind(writeLimit, pos) > (int32_t)mCapacity) {
+            pthread_mutex_lock(&mLock);
+            overrun_l(r, android_atomic_acquire_load(&mWritePos));
+            pthread_mutex_unlock(&mLock);
+            continue;
+        }
+
+        android_atomic_release_store(pos + count, &r->position);
+        r->stats.framesRead += count;
+        return count;
+    }
+    return 0;
+}
+
+void SubmixRing::reportHeadroom(int reader, ssize_t headroom, int64_t nowNs)
+{
+    pthread_mutex_lock(&mLock);
+    int32_t target = mTargetFrames;
+    if (headroom < 0) {
+        mReaders[reader].stats.underruns++;
+        target = std::min(target + (int32_t)mPeriodFrames / 2, mMaxTargetFrames);
+        mWindowStartNs = nowNs;
+        mWindowMinHeadroom = SSIZE_MAX;
+    } else {
+        if (mWindowStartNs == 0) {
+            mWindowStartNs = nowNs;
+        }
+        mWindowMinHeadroom = std::min(mWindowMinHeadroom, headroom);
+        if (nowNs - mWindowStartNs >= ADAPT_WINDOW_NS) {
+            // Keep a quarter period spare; give back half of the rest at a time.
+            const ssize_t excess = mWindowMinHeadroom - (ssize_t)mPeriodFrames / 4;
+            if (excess > 0) {
+                target = std::max(target - (int32_t)(excess / 2), mMinTargetFrames);
+            }
+            mWindowStartNs = nowNs;
+            mWindowMinHeadroom = SSIZE_MAX;
+        }
+    }
+    if (target != mTargetFrames) {
+        ALOGV("SubmixRing: target %d -> %d frames", mTargetFrames, target);
+        android_atomic_release_store(target, &mTargetFrames);
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+size_t SubmixRing::targetFrames() const
+{
+    return android_atomic_acquire_load(&mTargetFrames);
+}
+
+size_t SubmixRing::framesInFlight() const
+{
+    const int32_t writePos = android_atomic_acquire_load(&mWritePos);
+    int32_t behind = -1;
+    for (int i = 0; i < MAX_READERS; i++) {
+        if (android_atomic_acquire_load(&mReaders[i].active)) {
+            behind = std::max(behind, framesBehind(writePos,
+                    android_atomic_acquire_load(&mReaders[i].position)));
+        }
+    }
+    if (behind < 0) {
+        return targetFrames();
+    }
+    return std::min((size_t)behind, mCapacity);
+}
+
+void SubmixRing::getReaderStats(int reader, ReaderStats* stats) const
+{
+    pthread_mutex_lock(&mLock);
+    *stats = mReaders[reader].stats;
+    pthread_mutex_unlock(&mLock);
+}
+
+int SubmixRing::readerCount() const
+{
+    int count = 0;
+    for (int i = 0; i < MAX_READERS; i++) {
+        if (android_atomic_acquire_load(&mReaders[i].active)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void SubmixRing::shutdown()
+{
+    android_atomic_release_store(1, &mShutdown);
+}
+
+bool SubmixRing::isShutdown() const
+{
+    return android_atomic_acquire_load(&mShutdown) != 0;
+}
+
+}; // namespace android
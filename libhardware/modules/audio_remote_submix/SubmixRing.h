@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUBMIXRING_H_
+#define SUBMIXRING_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <utils/RefBase.h>
+
+namespace android {
+
+/*
+ * Single-writer, multi-reader ring of audio frames for the remote submix.
+ *
+ * The writer never blocks and never waits for readers: it overwrites the oldest frames. Each
+ * reader has its own position, so every reader sees every frame. A reader that falls more than
+ * the capacity behind has been overrun; it loses the frames in between, is moved back to
+ * targetFrames() behind the writer, and the loss is counted in its stats.
+ *
+ * The writer is expected to stay targetFrames() ahead of real time. Readers report their
+ * headroom (frames available beyond what they asked for) with reportHeadroom(): an underrun
+ * grows the target, and a window in which every read had spare headroom shrinks it, so the
+ * latency follows the worst jitter between the writer and any reader.
+ *
+ * Thread safety:
+ * write() from one thread at a time; read() and resyncReader() for a given reader from one
+ * thread at a time. Neither takes a lock. Adding and removing readers, overrun accounting and
+ * reportHeadroom() take the internal lock.
+ */
+class SubmixRing : public RefBase {
+public:
+    static const int MAX_READERS = 8;
+
+    struct ReaderStats {
+        uint64_t framesRead;
+        uint32_t overruns;
+        uint64_t overrunFrames; // frames the reader skipped because the writer lapped it
+        uint32_t underruns;     // reads that found fewer frames than they asked for
+    };
+
+    // The capacity is minFrames rounded up to a power of two. periodFrames is the usual size of
+    // a read or write, and sets the bounds and step of the target latency.
+    SubmixRing(size_t frameSize, size_t minFrames, size_t periodFrames);
+
+    size_t capacity() const { return mCapacity; }
+    size_t frameSize() const { return mFrameSize; }
+    size_t periodFrames() const { return mPeriodFrames; }
+
+    // Copies frames into the ring and returns the count. If frames exceeds the capacity only the
+    // last capacity() frames are kept. Only call from the writer.
+    size_t write(const void* buffer, size_t frames);
+
+    // Returns a reader index, or -ENOSPC if MAX_READERS are attached. The reader starts
+    // targetFrames() behind the writer.
+    int addReader();
+    void removeReader(int reader);
+    // Drops whatever the reader has not read yet and moves it targetFrames() behind the writer.
+    void resyncReader(int reader);
+
+    // Frames the reader can read now, at most the capacity.
+    size_t availableToRead(int reader) const;
+    // Copies up to frames and returns the count; never blocks.
+    ssize_t read(int reader, void* buffer, size_t frames);
+
+    // Headroom is the frames available when the reader asked, minus the frames it asked for.
+    void reportHeadroom(int reader, ssize_t headroom, int64_t nowNs);
+    size_t targetFrames() const;
+    // Frames written but not yet read by the slowest reader, or the target if there are none.
+    size_t framesInFlight() const;
+
+    void getReaderStats(int reader, ReaderStats* stats) const;
+    // Overruns of the reader so far, without the lock. Only call from the reader.
+    uint32_t getOverruns(int reader) const { return mReaders[reader].stats.overruns; }
+    int readerCount() const;
+
+    // After shutdown() the writer should discard its data; readers see no new frames.
+    void shutdown();
+    bool isShutdown() const;
+
+protected:
+    virtual ~SubmixRing();
+
+private:
+    struct Reader {
+        volatile int32_t active;
+        volatile int32_t position; // written by the reader only, or under mLock when detached
+        ReaderStats stats;
+    };
+
+    // Moves the reader to the target behind writePos and counts the frames skipped.
+    // Must be called with mLock held.
+    void overrun_l(Reader* reader, int32_t writePos);
+
+    int32_t framesBehind(int32_t writePos, int32_t readPos) const {
+        return (int32_t)((uint32_t)writePos - (uint32_t)readPos);
+    }
+
+    const size_t mFrameSize;
+    const size_t mCapacity;
+    const size_t mPeriodFrames;
+    const int32_t mMinTargetFrames;
+    const int32_t mMaxTargetFrames;
+    uint8_t* mData;
+
+    // Positions run freely and wrap; the slot of a position is position & (mCapacity - 1).
+    volatile int32_t mWritePos;   // end of the last completed write
+    volatile int32_t mWriteLimit; // end of the write in progress, published before copying
+    volatile int32_t mShutdown;
+    volatile int32_t mTargetFrames;
+
+    mutable pthread_mutex_t mLock;
+    Reader mReaders[MAX_READERS];
+    int64_t mWindowStartNs;
+    ssize_t mWindowMinHeadroom;
+};
+
+}; // namespace android
+
+#endif // SUBMIXRING_H_
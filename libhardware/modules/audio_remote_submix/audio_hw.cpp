@@ -23,12 +23,15 @@
 //#define LOG_NDEBUG 0
 
 #include <errno.h>
+#include <limits.h>
 #include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/param.h>
 #include <sys/time.h>
-#include <sys/limits.h>
+#include <time.h>
+#include <unistd.h>
 #ifndef LOG_STREAMS_TO_FILES
 #include <sys/stat.h>
 #endif
@@ -43,14 +46,11 @@
 #include <hardware/hardware.h>
 #include <system/audio.h>
 
-#include <media/AudioParameter.h>
-#include <media/AudioBufferProvider.h>
-#include <media/nbaio/MonoPipe.h>
-#include <media/nbaio/MonoPipeReader.h>
+#include <utils/Errors.h>
 
-#define MAX_UNREAD_COUNTS            50 //to print debug information
+#include "SubmixRing.h"
 
-#include <utils/String8.h>
+#define MAX_UNREAD_COUNTS            50 //to print debug information
 
 #define LOG_STREAMS_TO_FILES 0
 #if LOG_STREAMS_TO_FILES
@@ -73,11 +73,12 @@ namespace android {
 #define SUBMIX_ALOGE(...)
 #endif // SUBMIX_VERBOSE_LOGGING
 
-// NOTE: This value will be rounded up to the nearest power of 2 by MonoPipe().
+// Nominal size of the pipe.  The SubmixRing is twice this, rounded up to a power of 2, so that
+// the latency has room to grow when the readers are late.
 #define DEFAULT_PIPE_SIZE_IN_FRAMES  (1024*4)
-// Value used to divide the MonoPipe() buffer into segments that are written to the source and
-// read from the sink.  The maximum latency of the device is the size of the MonoPipe's buffer
-// the minimum latency is the MonoPipe buffer size divided by this value.
+// Value used to divide the nominal pipe size into periods, the size of the buffers written to
+// and read from the pipe.  The latency starts at two periods and adapts to the jitter the input
+// streams see, between 1.25 periods and the ring size less two periods (see SubmixRing).
 #define DEFAULT_PIPE_PERIOD_COUNT    4
 // The duration of MAX_READ_ATTEMPTS * READ_ATTEMPT_SLEEP_MS must be stricly inferior to
 //   the duration of a record buffer at the current record sample rate (of the device, not of
@@ -88,12 +89,9 @@ namespace android {
 #define DEFAULT_SAMPLE_RATE_HZ       48000 // default sample rate
 // See NBAIO_Format frameworks/av/include/media/nbaio/NBAIO.h.
 #define DEFAULT_FORMAT               AUDIO_FORMAT_PCM_16_BIT
-// A legacy user of this device does not close the input stream when it shuts down, which
-// results in the application opening a new input stream before closing the old input stream
-// handle it was previously using.  Setting this value to 1 allows multiple clients to open
-// multiple input streams from this device.  If this option is enabled, each input stream returned
-// is *the same stream* which means that readers will race to read data from these streams.
-#define ENABLE_LEGACY_INPUT_OPEN     1
+// Up to SubmixRing::MAX_READERS input streams can be open on a route at once, for instance a
+// remote display and a local recording, or a legacy client that opens a new input stream before
+// closing its old one.  Each input stream reads every frame written to the route.
 // Whether channel conversion (16-bit signed PCM mono->stereo, stereo->mono) is enabled.
 #define ENABLE_CHANNEL_CONVERSION    1
 // Whether resampling is enabled.
@@ -165,17 +163,13 @@ typedef struct route_config {
     // A usecase example is one where the component capturing the audio is then sending it over
     // Wifi for presentation on a remote Wifi Display device (e.g. a dongle attached to a TV, or a
     // TV with Wifi Display capabilities), or to a wireless audio player.
-    sp<MonoPipe> rsxSink;
-    sp<MonoPipeReader> rsxSource;
-    // Pointers to the current input and output stream instances.  rsxSink and rsxSource are
-    // destroyed if both and input and output streams are destroyed.
+    // The output stream writes to rsxRing and each input stream reads from it with a reader of its
+    // own.
+    sp<SubmixRing> rsxRing;
+    // Pointer to the current output stream instance and number of open input streams.  rsxRing
+    // is destroyed when neither an input nor the output stream is open.
     struct submix_stream_out *output;
-    struct submix_stream_in *input;
-#if ENABLE_RESAMPLING
-    // Buffer used as temporary storage for resampled data prior to returning data to the output
-    // stream.
-    int16_t resampler_buffer[DEFAULT_PIPE_SIZE_IN_FRAMES];
-#endif // ENABLE_RESAMPLING
+    int input_count;
 } route_config_t;
 
 struct submix_audio_device {
@@ -192,6 +186,9 @@ struct submix_stream_out {
     int route_handle;
     bool output_standby;
     uint64_t write_counter_frames;
+    // CLOCK_MONOTONIC time of the first write after standby; writes are paced from it.  0 in
+    // standby.
+    int64_t write_start_ns;
 #if LOG_STREAMS_TO_FILES
     int log_fd;
 #endif // LOG_STREAMS_TO_FILES
@@ -214,10 +211,18 @@ struct submix_stream_in {
     uint32_t lost_counter_frames;
 #endif
 
-#if ENABLE_LEGACY_INPUT_OPEN
-    // Number of references to this input stream.
-    volatile int32_t ref_count;
-#endif // ENABLE_LEGACY_INPUT_OPEN
+    // Ring of the route this stream reads from, and its reader index in the ring.  The route's
+    // ring is replaced when the output stream is reopened at another rate; the stream moves to
+    // the new ring on its next read.
+    sp<SubmixRing> ring;
+    int reader;
+    // Overrun frames already returned by in_get_input_frames_lost().
+    uint64_t reported_lost_frames;
+#if ENABLE_RESAMPLING
+    // Buffer used as temporary storage for pipe data prior to resampling it.
+    int16_t *resampler_buffer;
+    size_t resampler_buffer_size_frames;
+#endif // ENABLE_RESAMPLING
 #if LOG_STREAMS_TO_FILES
     int log_fd;
 #endif // LOG_STREAMS_TO_FILES
@@ -429,6 +434,14 @@ static bool audio_config_compare(const audio_config * const input_config,
     return true;
 }
 
+// Return the CLOCK_MONOTONIC time in nanoseconds.
+static int64_t submix_monotonic_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
 // If one doesn't exist, create a pipe for the submix audio device rsxadev of size
 // buffer_size_frames and optionally associate "in" or "out" with the submix audio device.
 // Must be called with lock held on the submix_audio_device
@@ -450,7 +463,7 @@ static void submix_audio_device_create_pipe_l(struct submix_audio_device * const
     // mask.
     if (in) {
         in->route_handle = route_idx;
-        rsxadev->routes[route_idx].input = in;
+        rsxadev->routes[route_idx].input_count++;
         rsxadev->routes[route_idx].config.input_channel_mask = config->channel_mask;
 #if ENABLE_RESAMPLING
         rsxadev->routes[route_idx].config.input_sample_rate = config->sample_rate;
@@ -475,7 +488,7 @@ static void submix_audio_device_create_pipe_l(struct submix_audio_device * const
     strncpy(rsxadev->routes[route_idx].address, address, AUDIO_DEVICE_MAX_ADDRESS_LEN);
     ALOGD("  now using address %s for route %d", rsxadev->routes[route_idx].address, route_idx);
     // If a pipe isn't associated with the device, create one.
-    if (rsxadev->routes[route_idx].rsxSink == NULL || rsxadev->routes[route_idx].rsxSource == NULL)
+    if (rsxadev->routes[route_idx].rsxRing == NULL)
     {
         struct submix_config * const device_config = &rsxadev->routes[route_idx].config;
         uint32_t channel_count;
@@ -491,33 +504,9 @@ static void submix_audio_device_create_pipe_l(struct submix_audio_device * const
 #else
         const uint32_t pipe_channel_count = channel_count;
 #endif // ENABLE_CHANNEL_CONVERSION
-        const NBAIO_Format format = Format_from_SR_C(config->sample_rate, pipe_channel_count,
-            config->format);
-        const NBAIO_Format offers[1] = {format};
-        size_t numCounterOffers = 0;
-        // Create a MonoPipe with optional blocking set to true.
-        MonoPipe* sink = new MonoPipe(buffer_size_frames, format, true /*writeCanBlock*/);
-        // Negotiation between the source and sink cannot fail as the device open operation
-        // creates both ends of the pipe using the same audio format.
-        ssize_t index = sink->negotiate(offers, 1, NULL, numCounterOffers);
-        ALOG_ASSERT(index == 0);
-        MonoPipeReader* source = new MonoPipeReader(sink);
-        numCounterOffers = 0;
-        index = source->negotiate(offers, 1, NULL, numCounterOffers);
-        ALOG_ASSERT(index == 0);
-        ALOGV("submix_audio_device_create_pipe_l(): created pipe");
-
-        // Save references to the source and sink.
-        ALOG_ASSERT(rsxadev->routes[route_idx].rsxSink == NULL);
-        ALOG_ASSERT(rsxadev->routes[route_idx].rsxSource == NULL);
-        rsxadev->routes[route_idx].rsxSink = sink;
-        rsxadev->routes[route_idx].rsxSource = source;
         // Store the sanitized audio format in the device so that it's possible to determine
         // the format of the pipe source when opening the input device.
         memcpy(&device_config->common, config, sizeof(device_config->common));
-        device_config->buffer_size_frames = sink->maxFrames();
-        device_config->buffer_period_size_frames = device_config->buffer_size_frames /
-                buffer_period_count;
         if (in) device_config->pipe_frame_size = audio_stream_in_frame_size(&in->stream);
         if (out) device_config->pipe_frame_size = audio_stream_out_frame_size(&out->stream);
 #if ENABLE_CHANNEL_CONVERSION
@@ -525,15 +514,21 @@ static void submix_audio_device_create_pipe_l(struct submix_audio_device * const
         device_config->pipe_frame_size = (device_config->pipe_frame_size * pipe_channel_count) /
                 channel_count;
 #endif // ENABLE_CHANNEL_CONVERSION
+        device_config->buffer_period_size_frames = buffer_size_frames / buffer_period_count;
+        SubmixRing* ring = new SubmixRing(device_config->pipe_frame_size, buffer_size_frames * 2,
+                device_config->buffer_period_size_frames);
+        ALOGV("submix_audio_device_create_pipe_l(): created pipe");
+
+        rsxadev->routes[route_idx].rsxRing = ring;
+        device_config->buffer_size_frames = ring->capacity();
         SUBMIX_ALOGV("submix_audio_device_create_pipe_l(): pipe frame size %zd, pipe size %zd, "
                      "period size %zd", device_config->pipe_frame_size,
                      device_config->buffer_size_frames, device_config->buffer_period_size_frames);
     }
 }
 
-// Release references to the sink and source.  Input and output threads may maintain references
-// to these objects via StrongPointer (sp<MonoPipe> and sp<MonoPipeReader>) which they can use
-// before they shutdown.
+// Release the reference to the ring.  Input and output threads may maintain references to it
+// via StrongPointer (sp<SubmixRing>) which they can use before they shutdown.
 // Must be called with lock held on the submix_audio_device
 static void submix_audio_device_release_pipe_l(struct submix_audio_device * const rsxadev,
         int route_idx)
@@ -542,43 +537,64 @@ static void submix_audio_device_release_pipe_l(struct submix_audio_device * cons
     ALOG_ASSERT(route_idx < MAX_ROUTES);
     ALOGD("submix_audio_device_release_pipe_l(idx=%d) addr=%s", route_idx,
             rsxadev->routes[route_idx].address);
-    if (rsxadev->routes[route_idx].rsxSink != 0) {
-        rsxadev->routes[route_idx].rsxSink.clear();
-        rsxadev->routes[route_idx].rsxSink = 0;
-    }
-    if (rsxadev->routes[route_idx].rsxSource != 0) {
-        rsxadev->routes[route_idx].rsxSource.clear();
-        rsxadev->routes[route_idx].rsxSource = 0;
+    if (rsxadev->routes[route_idx].rsxRing != 0) {
+        rsxadev->routes[route_idx].rsxRing.clear();
     }
     memset(rsxadev->routes[route_idx].address, 0, AUDIO_DEVICE_MAX_ADDRESS_LEN);
-#ifdef ENABLE_RESAMPLING
-    memset(rsxadev->routes[route_idx].resampler_buffer, 0,
-            sizeof(int16_t) * DEFAULT_PIPE_SIZE_IN_FRAMES);
-#endif
+}
+
+// Attach the input stream to the ring as a new reader, detaching it from the ring it read from
+// before, if any.  Returns 0, or a negative errno if the ring has no reader left.
+// Must be called with lock held on the submix_audio_device
+static int submix_stream_in_attach_l(struct submix_stream_in * const in,
+                                     const sp<SubmixRing>& ring)
+{
+    if (in->ring != NULL) {
+        in->ring->removeReader(in->reader);
+        in->ring.clear();
+    }
+    const int reader = ring->addReader();
+    if (reader < 0) {
+        ALOGE("submix_stream_in_attach_l(): no reader left on the pipe");
+        return reader;
+    }
+#if ENABLE_RESAMPLING
+    if (in->resampler_buffer_size_frames < ring->capacity()) {
+        int16_t * const buffer = (int16_t *)realloc(in->resampler_buffer,
+                ring->capacity() * ring->frameSize());
+        if (!buffer) {
+            ring->removeReader(reader);
+            return -ENOMEM;
+        }
+        in->resampler_buffer = buffer;
+        in->resampler_buffer_size_frames = ring->capacity();
+    }
+#endif // ENABLE_RESAMPLING
+    in->ring = ring;
+    in->reader = reader;
+    in->reported_lost_frames = 0;
+    return 0;
 }
 
 // Remove references to the specified input and output streams.  When the device no longer
 // references input and output streams destroy the associated pipe.
 // Must be called with lock held on the submix_audio_device
 static void submix_audio_device_destroy_pipe_l(struct submix_audio_device * const rsxadev,
-                                             const struct submix_stream_in * const in,
+                                             struct submix_stream_in * const in,
                                              const struct submix_stream_out * const out)
 {
-    MonoPipe* sink;
     ALOGV("submix_audio_device_destroy_pipe_l()");
     int route_idx = -1;
     if (in != NULL) {
-#if ENABLE_LEGACY_INPUT_OPEN
-        const_cast<struct submix_stream_in*>(in)->ref_count--;
         route_idx = in->route_handle;
-        ALOG_ASSERT(rsxadev->routes[route_idx].input == in);
-        if (in->ref_count == 0) {
-            rsxadev->routes[route_idx].input = NULL;
+        ALOG_ASSERT(rsxadev->routes[route_idx].input_count > 0);
+        rsxadev->routes[route_idx].input_count--;
+        if (in->ring != NULL) {
+            in->ring->removeReader(in->reader);
+            in->ring.clear();
         }
-        ALOGV("submix_audio_device_destroy_pipe_l(): input ref_count %d", in->ref_count);
-#else
-        rsxadev->input = NULL;
-#endif // ENABLE_LEGACY_INPUT_OPEN
+        ALOGV("submix_audio_device_destroy_pipe_l(): %d input streams left",
+                rsxadev->routes[route_idx].input_count);
     }
     if (out != NULL) {
         route_idx = out->route_handle;
@@ -586,7 +602,8 @@ static void submix_audio_device_destroy_pipe_l(struct submix_audio_device * cons
         rsxadev->routes[route_idx].output = NULL;
     }
     if (route_idx != -1 &&
-            rsxadev->routes[route_idx].input == NULL && rsxadev->routes[route_idx].output == NULL) {
+            rsxadev->routes[route_idx].input_count == 0 &&
+            rsxadev->routes[route_idx].output == NULL) {
         submix_audio_device_release_pipe_l(rsxadev, route_idx);
         ALOGD("submix_audio_device_destroy_pipe_l(): pipe destroyed");
     }
@@ -614,16 +631,35 @@ static bool submix_open_validate_l(const struct submix_audio_device * const rsxa
 
     // Query the device for the current audio config and whether input and output streams are open.
     output_open = rsxadev->routes[route_idx].output != NULL;
-    input_open = rsxadev->routes[route_idx].input != NULL;
+    input_open = rsxadev->routes[route_idx].input_count > 0;
     memcpy(&pipe_config, &rsxadev->routes[route_idx].config.common, sizeof(pipe_config));
 
-    // If the stream is already open, don't open it again.
-    if (opening_input ? !ENABLE_LEGACY_INPUT_OPEN && input_open : output_open) {
+    // Only one output stream can be open, and as many input streams as the pipe has readers.
+    if (opening_input ? rsxadev->routes[route_idx].input_count >= SubmixRing::MAX_READERS :
+            output_open) {
         ALOGE("submix_open_validate_l(): %s stream already open.", opening_input ? "Input" :
                 "Output");
         return false;
     }
 
+    // Input streams share the channel conversion and resampling settings of the route, so they
+    // must all use the same channel mask and sample rate.
+    if (opening_input && input_open) {
+        const struct submix_config * const route_config = &rsxadev->routes[route_idx].config;
+#if ENABLE_RESAMPLING
+        const uint32_t input_sample_rate = route_config->input_sample_rate;
+#else
+        const uint32_t input_sample_rate = route_config->common.sample_rate;
+#endif // ENABLE_RESAMPLING
+        if (config->channel_mask != route_config->input_channel_mask ||
+                config->sample_rate != input_sample_rate) {
+            ALOGE("submix_open_validate_l(): input stream %x %uHz doesn't match open input "
+                  "streams %x %uHz", config->channel_mask, config->sample_rate,
+                  route_config->input_channel_mask, input_sample_rate);
+            return false;
+        }
+    }
+
     SUBMIX_ALOGV("submix_open_validate_l(): sample rate=%d format=%x "
                  "%s_channel_mask=%x", config->sample_rate, config->format,
                  opening_input ? "in" : "out", config->channel_mask);
@@ -784,6 +820,7 @@ static int out_standby(struct audio_stream *stream)
 
     out->output_standby = true;
     out->write_counter_frames = 0;
+    out->write_start_ns = 0;
 
     pthread_mutex_unlock(&rsxadev->lock);
 
@@ -800,29 +837,27 @@ static int out_dump(const struct audio_stream *stream, int fd)
 static int out_set_parameters(struct audio_stream *stream, const char *kvpairs)
 {
     int exiting = -1;
-    AudioParameter parms = AudioParameter(String8(kvpairs));
+    struct str_parms *parms = str_parms_create_str(kvpairs);
     SUBMIX_ALOGV("out_set_parameters() kvpairs='%s'", kvpairs);
+    if (!parms) {
+        return -ENOMEM;
+    }
 
     // FIXME this is using hard-coded strings but in the future, this functionality will be
     //       converted to use audio HAL extensions required to support tunneling
-    if ((parms.getInt(String8("exiting"), exiting) == NO_ERROR) && (exiting > 0)) {
+    if ((str_parms_get_int(parms, "exiting", &exiting) == 0) && (exiting > 0)) {
         struct submix_audio_device * const rsxadev =
                 audio_stream_get_submix_stream_out(stream)->dev;
         pthread_mutex_lock(&rsxadev->lock);
-        { // using the sink
-            sp<MonoPipe> sink =
-                    rsxadev->routes[audio_stream_get_submix_stream_out(stream)->route_handle]
-                                    .rsxSink;
-            if (sink == NULL) {
-                pthread_mutex_unlock(&rsxadev->lock);
-                return 0;
-            }
-
-            ALOGD("out_set_parameters(): shutting down MonoPipe sink");
-            sink->shutdown(true);
-        } // done using the sink
+        const sp<SubmixRing>& ring =
+                rsxadev->routes[audio_stream_get_submix_stream_out(stream)->route_handle].rsxRing;
+        if (ring != NULL) {
+            ALOGD("out_set_parameters(): shutting down pipe");
+            ring->shutdown();
+        }
         pthread_mutex_unlock(&rsxadev->lock);
     }
+    str_parms_destroy(parms);
     return 0;
 }
 
@@ -837,11 +872,17 @@ static uint32_t out_get_latency(const struct audio_stream_out *stream)
 {
     const struct submix_stream_out * const out = audio_stream_out_get_submix_stream_out(
             const_cast<struct audio_stream_out *>(stream));
-    const struct submix_config * const config = &out->dev->routes[out->route_handle].config;
+    struct submix_audio_device * const rsxadev = out->dev;
+    const struct submix_config * const config = &rsxadev->routes[out->route_handle].config;
     const size_t stream_frame_size =
                             audio_stream_out_frame_size(stream);
+    // The latency is the current target of the pipe rather than its size.
+    pthread_mutex_lock(&rsxadev->lock);
+    const sp<SubmixRing>& ring = rsxadev->routes[out->route_handle].rsxRing;
+    const size_t pipe_frames = ring != NULL ? ring->targetFrames() : config->buffer_size_frames;
+    pthread_mutex_unlock(&rsxadev->lock);
     const size_t buffer_size_frames = calculate_stream_pipe_size_in_frames(
-            &stream->common, config, config->buffer_size_frames, stream_frame_size);
+            &stream->common, config, pipe_frames, stream_frame_size);
     const uint32_t sample_rate = out_get_sample_rate(&stream->common);
     const uint32_t latency_ms = (buffer_size_frames * 1000) / sample_rate;
     SUBMIX_ALOGV("out_get_latency() returns %u ms, size in frames %zu, sample rate %u",
@@ -862,25 +903,25 @@ static ssize_t out_write(struct audio_stream_out *stream, const void* buffer,
                          size_t bytes)
 {
     ALOGD("out_write(bytes=%zd)", bytes);
-    ssize_t written_frames = 0;
     const size_t frame_size = audio_stream_out_frame_size(stream);
     struct submix_stream_out * const out = audio_stream_out_get_submix_stream_out(stream);
     struct submix_audio_device * const rsxadev = out->dev;
     const size_t frames = bytes / frame_size;
+    const uint32_t sample_rate = out_get_sample_rate(&stream->common);
 
     pthread_mutex_lock(&rsxadev->lock);
 
     out->output_standby = false;
 
-    sp<MonoPipe> sink = rsxadev->routes[out->route_handle].rsxSink;
-    if (sink != NULL) {
-        if (sink->isShutdown()) {
-            sink.clear();
+    sp<SubmixRing> ring = rsxadev->routes[out->route_handle].rsxRing;
+    if (ring != NULL) {
+        if (ring->isShutdown()) {
+            ring.clear();
             pthread_mutex_unlock(&rsxadev->lock);
             SUBMIX_ALOGV("out_write(): pipe shutdown, ignoring the write.");
             // the pipe has already been shutdown, this buffer will be lost but we must
             //   simulate timing so we don't drain the output faster than realtime
-            usleep(frames * 1000000 / out_get_sample_rate(&stream->common));
+            usleep(frames * 1000000 / sample_rate);
             return bytes;
         }
     } else {
@@ -889,65 +930,43 @@ static ssize_t out_write(struct audio_stream_out *stream, const void* buffer,
         ALOG_ASSERT("out_write without a pipe!");
         return 0;
     }
-    //Dump debug data
-    dumpPcmData(r_submix_streamout,(void*)buffer,bytes,streamout_propty);
-
-    // If the write to the sink would block when no input stream is present, flush enough frames
-    // from the pipe to make space to write the most recent data.
-    {
-        const size_t availableToWrite = sink->availableToWrite();
-        sp<MonoPipeReader> source = rsxadev->routes[out->route_handle].rsxSource;
-        if (rsxadev->routes[out->route_handle].input == NULL && availableToWrite < frames) {
-            static uint8_t flush_buffer[64];
-            const size_t flushBufferSizeFrames = sizeof(flush_buffer) / frame_size;
-            size_t frames_to_flush_from_source = frames - availableToWrite;
-            SUBMIX_ALOGV("out_write(): flushing %d frames from the pipe to avoid blocking",
-                         frames_to_flush_from_source);
-            while (frames_to_flush_from_source) {
-                const size_t flush_size = min(frames_to_flush_from_source, flushBufferSizeFrames);
-                frames_to_flush_from_source -= flush_size;
-                // read does not block
-                source->read(flush_buffer, flush_size, AudioBufferProvider::kInvalidPTS);
-            }
-        }
-    }
 
     pthread_mutex_unlock(&rsxadev->lock);
 
-    written_frames = sink->write(buffer, frames);
+    //Dump debug data
+    dumpPcmData(r_submix_streamout,(void*)buffer,bytes,streamout_propty);
+
+    // The ring never blocks the writer: readers that fall too far behind are overrun instead,
+    // so the output can be written with or without input streams.
+    const ssize_t written_frames = ring->write(buffer, frames);
 
 #if LOG_STREAMS_TO_FILES
     if (out->log_fd >= 0) write(out->log_fd, buffer, written_frames * frame_size);
 #endif // LOG_STREAMS_TO_FILES
 
-    if (written_frames < 0) {
-        if (written_frames == (ssize_t)NEGOTIATE) {
-            ALOGE("out_write() write to pipe returned NEGOTIATE");
-
-            pthread_mutex_lock(&rsxadev->lock);
-            sink.clear();
-            pthread_mutex_unlock(&rsxadev->lock);
-
-            written_frames = 0;
-            return 0;
-        } else {
-            // write() returned UNDERRUN or WOULD_BLOCK, retry
-            ALOGE("out_write() write to pipe returned unexpected %zd", written_frames);
-            written_frames = sink->write(buffer, frames);
-        }
-    }
-
+    // Pace the writes so that the pipe holds the target latency ahead of real time.
+    const int64_t target_frames = ring->targetFrames();
+    const int64_t now_ns = submix_monotonic_ns();
     pthread_mutex_lock(&rsxadev->lock);
-    sink.clear();
-    if (written_frames > 0) {
-        out->write_counter_frames += written_frames;
+    ring.clear();
+    if (out->write_start_ns == 0) {
+        out->write_start_ns = now_ns;
+    }
+    out->write_counter_frames += written_frames;
+    const int64_t ahead_frames = (int64_t)out->write_counter_frames - target_frames;
+    int64_t deadline_ns = out->write_start_ns + ahead_frames * 1000000000LL / sample_rate;
+    if (now_ns - deadline_ns > target_frames * 1000000000LL / sample_rate) {
+        // The writer stalled for longer than the target; restart the pacing from now rather than
+        // catch up in a burst that would overrun the readers.
+        out->write_start_ns = now_ns - ahead_frames * 1000000000LL / sample_rate;
+        deadline_ns = now_ns;
     }
     pthread_mutex_unlock(&rsxadev->lock);
 
-    if (written_frames < 0) {
-        ALOGE("out_write() failed writing to pipe with %zd", written_frames);
-        return 0;
+    if (deadline_ns > now_ns) {
+        usleep((deadline_ns - now_ns) / 1000);
     }
+
     const ssize_t written_bytes = written_frames * frame_size;
     ALOGD("out_write() wrote %zd bytes %zd frames", written_bytes, written_frames);
     return written_bytes;
@@ -965,11 +984,12 @@ static int out_get_presentation_position(const struct audio_stream_out *stream,
     pthread_mutex_lock(&rsxadev->lock);
 
     if (frames) {
-        const ssize_t frames_in_pipe =
-                rsxadev->routes[out->route_handle].rsxSource->availableToRead();
-        if (CC_UNLIKELY(frames_in_pipe < 0)) {
+        // Frames are presented once the slowest input stream has read them.
+        const sp<SubmixRing>& ring = rsxadev->routes[out->route_handle].rsxRing;
+        if (CC_UNLIKELY(ring == NULL)) {
             *frames = out->write_counter_frames;
         } else {
+            const size_t frames_in_pipe = ring->framesInFlight();
             *frames = out->write_counter_frames > (uint64_t) frames_in_pipe ?
                     out->write_counter_frames - frames_in_pipe : 0;
         }
@@ -1201,8 +1221,9 @@ static ssize_t in_read(struct audio_stream_in *stream, void* buffer,
             ? true : rsxadev->routes[in->route_handle].output->output_standby;
     const bool output_standby_transition = (in->output_standby_rec_thr != output_standby);
     in->output_standby_rec_thr = output_standby;
+    const bool resync = in->input_standby || output_standby_transition;
 
-    if (in->input_standby || output_standby_transition) {
+    if (resync) {
         in->input_standby = false;
         // keep track of when we exit input standby (== first read == start "real recording")
         // or when we start recording silence, and reset projected time
@@ -1228,8 +1249,17 @@ static ssize_t in_read(struct audio_stream_in *stream, void* buffer,
 
     {
         // about to read from audio source
-        sp<MonoPipeReader> source = rsxadev->routes[in->route_handle].rsxSource;
-        if (source == NULL) {
+        sp<SubmixRing> ring = rsxadev->routes[in->route_handle].rsxRing;
+        if (ring != NULL && ring != in->ring) {
+            // The pipe was recreated since this stream last read.
+            if (submix_stream_in_attach_l(in, ring) != 0) {
+                ring.clear();
+            }
+        } else if (ring != NULL && resync) {
+            // Skip what was written while in standby and start the target latency behind.
+            ring->resyncReader(in->reader);
+        }
+        if (ring == NULL) {
             in->read_error_count++;// ok if it rolls over
             ALOGE_IF(in->read_error_count < MAX_READ_ERROR_LOGS,
                     "no audio pipe yet we're trying to read! (not all errors will be logged)");
@@ -1265,9 +1295,7 @@ static ssize_t in_read(struct audio_stream_in *stream, void* buffer,
         const uint32_t input_sample_rate = in_get_sample_rate(&stream->common);
         const uint32_t output_sample_rate =
                 rsxadev->routes[in->route_handle].config.output_sample_rate;
-        const size_t resampler_buffer_size_frames =
-            sizeof(rsxadev->routes[in->route_handle].resampler_buffer) /
-                sizeof(rsxadev->routes[in->route_handle].resampler_buffer[0]);
+        const size_t resampler_buffer_size_frames = in->resampler_buffer_size_frames;
         float resampler_ratio = 1.0f;
         // Determine whether resampling is required.
         if (input_sample_rate != output_sample_rate) {
@@ -1281,6 +1309,19 @@ static ssize_t in_read(struct audio_stream_in *stream, void* buffer,
         }
 #endif // ENABLE_RESAMPLING
 
+        // Tell the pipe how much spare data there was when this read started, so that it can
+        // adapt the latency to how late this and the other input streams read.
+        if (!output_standby && !ring->isShutdown()) {
+            size_t pipe_frames_to_read = frames_to_read;
+#if ENABLE_RESAMPLING
+            pipe_frames_to_read = (size_t)((float)pipe_frames_to_read * resampler_ratio);
+#endif // ENABLE_RESAMPLING
+            ring->reportHeadroom(in->reader,
+                    (ssize_t)ring->availableToRead(in->reader) - (ssize_t)pipe_frames_to_read,
+                    submix_monotonic_ns());
+        }
+
+        const uint32_t overruns = ring->getOverruns(in->reader);
         while ((remaining_frames > 0) && (attempts < MAX_READ_ATTEMPTS)) {
             ssize_t frames_read = -1977;
             size_t read_frames = remaining_frames;
@@ -1293,7 +1334,7 @@ static ssize_t in_read(struct audio_stream_in *stream, void* buffer,
                     (float)read_frames * (float)resampler_ratio);
                 read_frames = min(frames_required_for_resampler, resampler_buffer_size_frames);
                 // Read into the resampler buffer.
-                buff = (char*)rsxadev->routes[in->route_handle].resampler_buffer;
+                buff = (char*)in->resampler_buffer;
             }
 #endif // ENABLE_RESAMPLING
 #if ENABLE_CHANNEL_CONVERSION
@@ -1304,9 +1345,10 @@ static ssize_t in_read(struct audio_stream_in *stream, void* buffer,
             }
 #endif // ENABLE_CHANNEL_CONVERSION
 
-            SUBMIX_ALOGV("in_read(): frames available to read %zd", source->availableToRead());
+            SUBMIX_ALOGV("in_read(): frames available to read %zu",
+                         ring->availableToRead(in->reader));
 
-            frames_read = source->read(buff, read_frames, AudioBufferProvider::kInvalidPTS);
+            frames_read = ring->read(in->reader, buff, read_frames);
 
             SUBMIX_ALOGV("in_read(): frames read %zd", frames_read);
 
@@ -1375,9 +1417,16 @@ static ssize_t in_read(struct audio_stream_in *stream, void* buffer,
                 usleep(READ_ATTEMPT_SLEEP_MS * 1000);
             }
         }
-        // done using the source
+        // The reader fell so far behind that the pipe dropped frames for it: don't try to catch
+        // up with the lost time, which would only read the pipe empty.
+        if (ring->getOverruns(in->reader) != overruns) {
+            SUBMIX_ALOGV("in_read(): overrun, restarting the projected time");
+            clock_gettime(CLOCK_MONOTONIC, &in->record_start_time);
+            in->read_counter_frames = frames_to_read;
+        }
+        // done using the ring
         pthread_mutex_lock(&rsxadev->lock);
-        source.clear();
+        ring.clear();
         pthread_mutex_unlock(&rsxadev->lock);
     }
 
@@ -1472,9 +1521,17 @@ static uint32_t in_get_input_frames_lost(struct audio_stream_in *stream)
     }
     return frame_lost;
 #else
-    (void)stream;
-
-    return 0;
+    struct submix_stream_in * const in = audio_stream_in_get_submix_stream_in(stream);
+    uint32_t frames_lost = 0;
+    pthread_mutex_lock(&in->dev->lock);
+    if (in->ring != NULL) {
+        SubmixRing::ReaderStats stats;
+        in->ring->getReaderStats(in->reader, &stats);
+        frames_lost = (uint32_t)(stats.overrunFrames - in->reported_lost_frames);
+        in->reported_lost_frames = stats.overrunFrames;
+    }
+    pthread_mutex_unlock(&in->dev->lock);
+    return frames_lost;
 #endif
 }
 
@@ -1557,18 +1614,19 @@ static int adev_open_output_stream(struct audio_hw_device *dev,
     out->stream.get_presentation_position = out_get_presentation_position;
 
     out->write_counter_frames = 0;
+    out->write_start_ns = 0;
 
 #if ENABLE_RESAMPLING
-    // Recreate the pipe with the correct sample rate so that MonoPipe.write() rate limits
-    // writes correctly.
+    // Recreate the pipe with the correct sample rate so that its latency and the pacing of
+    // out_write() are computed at the rate of the output.
     force_pipe_creation = rsxadev->routes[route_idx].config.common.sample_rate
             != config->sample_rate;
 #endif // ENABLE_RESAMPLING
 
-    // If the sink has been shutdown or pipe recreation is forced (see above), delete the pipe so
-    // that it's recreated.
-    if ((rsxadev->routes[route_idx].rsxSink != NULL
-            && rsxadev->routes[route_idx].rsxSink->isShutdown()) || force_pipe_creation) {
+    // If the pipe has been shutdown or pipe recreation is forced (see above), delete the pipe so
+    // that it's recreated.  Open input streams move to the new pipe on their next read.
+    if ((rsxadev->routes[route_idx].rsxRing != NULL
+            && rsxadev->routes[route_idx].rsxRing->isShutdown()) || force_pipe_creation) {
         submix_audio_device_release_pipe_l(rsxadev, route_idx);
     }
 
@@ -1749,56 +1807,40 @@ static int adev_open_input_stream(struct audio_hw_device *dev,
         return -EINVAL;
     }
 
-#if ENABLE_LEGACY_INPUT_OPEN
-    in = rsxadev->routes[route_idx].input;
-    if (in) {
-        in->ref_count++;
-        sp<MonoPipe> sink = rsxadev->routes[route_idx].rsxSink;
-        ALOG_ASSERT(sink != NULL);
-        // If the sink has been shutdown, delete the pipe.
-        if (sink != NULL) {
-            if (sink->isShutdown()) {
-                ALOGD(" Non-NULL shut down sink when opening input stream, releasing, refcount=%d",
-                        in->ref_count);
-                submix_audio_device_release_pipe_l(rsxadev, in->route_handle);
-            } else {
-                ALOGD(" Non-NULL sink when opening input stream, refcount=%d", in->ref_count);
-            }
-        } else {
-            ALOGE("NULL sink when opening input stream, refcount=%d", in->ref_count);
-        }
+    // If the pipe has been shutdown, delete it so that it's recreated.
+    if (rsxadev->routes[route_idx].rsxRing != NULL
+            && rsxadev->routes[route_idx].rsxRing->isShutdown()) {
+        ALOGD(" Shut down pipe when opening input stream, releasing");
+        submix_audio_device_release_pipe_l(rsxadev, route_idx);
     }
-#else
-    in = NULL;
-#endif // ENABLE_LEGACY_INPUT_OPEN
 
+    in = (struct submix_stream_in *)calloc(1, sizeof(struct submix_stream_in));
     if (!in) {
-        in = (struct submix_stream_in *)calloc(1, sizeof(struct submix_stream_in));
-        if (!in) return -ENOMEM;
-        in->ref_count = 1;
-
-        // Initialize the function pointer tables (v-tables).
-        in->stream.common.get_sample_rate = in_get_sample_rate;
-        in->stream.common.set_sample_rate = in_set_sample_rate;
-        in->stream.common.get_buffer_size = in_get_buffer_size;
-        in->stream.common.get_channels = in_get_channels;
-        in->stream.common.get_format = in_get_format;
-        in->stream.common.set_format = in_set_format;
-        in->stream.common.standby = in_standby;
-        in->stream.common.dump = in_dump;
-        in->stream.common.set_parameters = in_set_parameters;
-        in->stream.common.get_parameters = in_get_parameters;
-        in->stream.common.add_audio_effect = in_add_audio_effect;
-        in->stream.common.remove_audio_effect = in_remove_audio_effect;
-        in->stream.set_gain = in_set_gain;
-        in->stream.read = in_read;
-        in->stream.get_input_frames_lost = in_get_input_frames_lost;
-
-        in->dev = rsxadev;
+        pthread_mutex_unlock(&rsxadev->lock);
+        return -ENOMEM;
+    }
+
+    // Initialize the function pointer tables (v-tables).
+    in->stream.common.get_sample_rate = in_get_sample_rate;
+    in->stream.common.set_sample_rate = in_set_sample_rate;
+    in->stream.common.get_buffer_size = in_get_buffer_size;
+    in->stream.common.get_channels = in_get_channels;
+    in->stream.common.get_format = in_get_format;
+    in->stream.common.set_format = in_set_format;
+    in->stream.common.standby = in_standby;
+    in->stream.common.dump = in_dump;
+    in->stream.common.set_parameters = in_set_parameters;
+    in->stream.common.get_parameters = in_get_parameters;
+    in->stream.common.add_audio_effect = in_add_audio_effect;
+    in->stream.common.remove_audio_effect = in_remove_audio_effect;
+    in->stream.set_gain = in_set_gain;
+    in->stream.read = in_read;
+    in->stream.get_input_frames_lost = in_get_input_frames_lost;
+
+    in->dev = rsxadev;
 #if LOG_STREAMS_TO_FILES
-        in->log_fd = -1;
+    in->log_fd = -1;
 #endif
-    }
 
     // Initialize the input stream.
     in->read_counter_frames = 0;
@@ -1821,8 +1863,17 @@ static int adev_open_input_stream(struct audio_hw_device *dev,
     ALOGV("adev_open_input_stream(): about to create pipe");
     submix_audio_device_create_pipe_l(rsxadev, config, DEFAULT_PIPE_SIZE_IN_FRAMES,
                                     DEFAULT_PIPE_PERIOD_COUNT, in, NULL, address, route_idx);
+    res = submix_stream_in_attach_l(in, rsxadev->routes[route_idx].rsxRing);
+    if (res != 0) {
+        submix_audio_device_destroy_pipe_l(rsxadev, in, NULL);
+        pthread_mutex_unlock(&rsxadev->lock);
+#if ENABLE_RESAMPLING
+        free(in->resampler_buffer);
+#endif // ENABLE_RESAMPLING
+        free(in);
+        return res;
+    }
 #if LOG_STREAMS_TO_FILES
-    if (in->log_fd >= 0) close(in->log_fd);
     in->log_fd = open(LOG_STREAM_IN_FILENAME, O_CREAT | O_TRUNC | O_WRONLY,
                       LOG_STREAM_FILE_PERMISSIONS);
     ALOGE_IF(in->log_fd < 0, "adev_open_input_stream(): log file open failed %s",
@@ -1848,11 +1899,10 @@ static void adev_close_input_stream(struct audio_hw_device *dev,
 #if LOG_STREAMS_TO_FILES
     if (in->log_fd >= 0) close(in->log_fd);
 #endif // LOG_STREAMS_TO_FILES
-#if ENABLE_LEGACY_INPUT_OPEN
-    if (in->ref_count == 0) free(in);
-#else
+#if ENABLE_RESAMPLING
+    free(in->resampler_buffer);
+#endif // ENABLE_RESAMPLING
     free(in);
-#endif // ENABLE_LEGACY_INPUT_OPEN
 
     pthread_mutex_unlock(&rsxadev->lock);
 }
@@ -1863,7 +1913,7 @@ static int adev_dump(const audio_hw_device_t *device, int fd)
             reinterpret_cast<const struct submix_audio_device *>(
                     reinterpret_cast<const uint8_t *>(device) -
                             offsetof(struct submix_audio_device, device));
-    char msg[100];
+    char msg[100 + AUDIO_DEVICE_MAX_ADDRESS_LEN];
     int n = sprintf(msg, "\nReroute submix audio module:\n");
     write(fd, &msg, n);
     for (int i=0 ; i < MAX_ROUTES ; i++) {
@@ -1872,6 +1922,25 @@ static int adev_dump(const audio_hw_device_t *device, int fd)
                 rsxadev->routes[i].config.output_sample_rate,
                 rsxadev->routes[i].address);
         write(fd, &msg, n);
+        const sp<SubmixRing>& ring = rsxadev->routes[i].rsxRing;
+        if (ring != NULL) {
+            n = snprintf(msg, sizeof(msg), "  pipe %zu frames, latency %zu frames, %d readers%s\n",
+                    ring->capacity(), ring->targetFrames(), ring->readerCount(),
+                    ring->isShutdown() ? ", shut down" : "");
+            write(fd, &msg, n);
+            for (int reader = 0; reader < SubmixRing::MAX_READERS; reader++) {
+                SubmixRing::ReaderStats stats;
+                ring->getReaderStats(reader, &stats);
+                if (stats.framesRead == 0 && stats.overruns == 0 && stats.underruns == 0) {
+                    continue;
+                }
+                n = snprintf(msg, sizeof(msg), "   reader[%d] read=%llu overruns=%u (%llu frames) "
+                        "underruns=%u\n", reader, (unsigned long long)stats.framesRead,
+                        stats.overruns, (unsigned long long)stats.overrunFrames,
+                        stats.underruns);
+                write(fd, &msg, n);
+            }
+        }
     }
     return 0;
 }
@@ -1879,6 +1948,11 @@ static int adev_dump(const audio_hw_device_t *device, int fd)
 static int adev_close(hw_device_t *device)
 {
     ALOGI("adev_close()");
+    struct submix_audio_device * const rsxadev = reinterpret_cast<struct submix_audio_device *>(
+            reinterpret_cast<uint8_t *>(device) - offsetof(struct submix_audio_device, device));
+    for (int i=0 ; i < MAX_ROUTES ; i++) {
+        rsxadev->routes[i].rsxRing.clear();
+    }
     free(device);
     return 0;
 }
@@ -0,0 +1,19 @@
+LOCAL_PATH := $(call my-dir)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	r_submix_tests.cpp \
+	../SubmixRing.cpp
+
+LOCAL_MODULE := r_submix_tests
+
+LOCAL_STATIC_LIBRARIES := libcutils libutils liblog
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/..
+
+LOCAL_CFLAGS := -Wno-unused-parameter
+
+LOCAL_LDLIBS += -lpthread -lrt
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,416 @@
+#include <algorithm>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "audio_hw.cpp"
+
+// Tests of the remote submix pipe and HAL: the SubmixRing on its own, then one output stream
+// fanned out to several input streams, written and read by threads at real time. Reports
+// glitches (frames missing, repeated or zero once the data started) and the end-to-end latency
+// of each input stream.
+
+// Run it like this:
+//
+// make r_submix_tests -j32 && \
+// out/host/linux-x86/obj/EXECUTABLES/r_submix_tests_intermediates/r_submix_tests
+//
+// -d <seconds> runs each phase for that long (default 3), -j <us> and -w <us> add random
+// delays of up to that long before one in eight reads and writes, and -r <count> sets the number
+// of input streams. Without -j or -w the default phases run and are checked.
+
+using namespace android;
+
+#define TEST_ADDRESS "0"
+#define TEST_SAMPLE_RATE 48000
+#define TEST_STALL_MS 300
+
+static int64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Delays one call in eight by up to max_us, like a thread that is occasionally scheduled late.
+static void random_delay(int max_us) {
+    if (max_us > 0 && rand() % 8 == 0) {
+        usleep(rand() % max_us);
+    }
+}
+
+// Each stereo frame carries its 1-based index: low 16 bits left, high 16 bits right.
+static void stamp_frames(int16_t* data, uint32_t first, size_t frames) {
+    for (size_t i = 0; i < frames; i++) {
+        const uint32_t value = first + i + 1;
+        data[2 * i] = (int16_t)(value & 0xffff);
+        data[2 * i + 1] = (int16_t)(value >> 16);
+    }
+}
+
+static uint32_t frame_value(const int16_t* data, size_t frame) {
+    return (uint16_t)data[2 * frame] | ((uint32_t)(uint16_t)data[2 * frame + 1] << 16);
+}
+
+bool checkInt(const char* msg, long expected, long actual) {
+    if (actual != expected) {
+        printf("%s; expected %ld; actual was %ld\n", msg, expected, actual);
+        return false;
+    }
+    return true;
+}
+
+bool checkTrue(const char* msg, bool condition) {
+    if (!condition) {
+        printf("%s\n", msg);
+    }
+    return condition;
+}
+
+// SubmixRing
+
+bool testRingFanOut() {
+    printf("testRingFanOut\n");
+    sp<SubmixRing> ring = new SubmixRing(4, 64, 8);
+    if (!checkInt("capacity", 64, ring->capacity())) return false;
+    const int first = ring->addReader();
+    const int second = ring->addReader();
+    // Readers start the target (two periods) behind the writer, in silence.
+    if (!checkInt("initial target", 16, ring->targetFrames())) return false;
+    if (!checkInt("initial available", 16, ring->availableToRead(first))) return false;
+    int16_t in[2 * 24], out[2 * 64];
+    ring->read(first, out, 16);
+    ring->read(second, out, 16);
+
+    stamp_frames(in, 0, 24);
+    ring->write(in, 24);
+    for (int reader = first; reader <= second; reader++) {
+        if (!checkInt("available", 24, ring->availableToRead(reader))) return false;
+        if (!checkInt("read", 24, ring->read(reader, out, 64))) return false;
+        for (int i = 0; i < 24; i++) {
+            if (!checkInt("frame", i + 1, frame_value(out, i))) return false;
+        }
+    }
+    if (!checkInt("in flight", 0, ring->framesInFlight())) return false;
+    ring->write(in, 10);
+    ring->read(first, out, 10);
+    if (!checkInt("in flight of slowest reader", 10, ring->framesInFlight())) return false;
+    ring->removeReader(second);
+    if (!checkInt("in flight after remove", 0, ring->framesInFlight())) return false;
+    if (!checkInt("reader count", 1, ring->readerCount())) return false;
+    return true;
+}
+
+bool testRingOverrun() {
+    printf("testRingOverrun\n");
+    sp<SubmixRing> ring = new SubmixRing(4, 64, 8);
+    const int reader = ring->addReader();
+    int16_t in[2 * 100], out[2 * 64];
+    ring->read(reader, out, 64);
+
+    // 100 frames into 64: the reader lost 100 - 16 frames and resumes 16 behind the writer.
+    stamp_frames(in, 0, 100);
+    if (!checkInt("write", 100, ring->write(in, 100))) return false;
+    if (!checkInt("read after overrun", 16, ring->read(reader, out, 64))) return false;
+    if (!checkInt("first frame after overrun", 85, frame_value(out, 0))) return false;
+    SubmixRing::ReaderStats stats;
+    ring->getReaderStats(reader, &stats);
+    if (!checkInt("overruns", 1, stats.overruns)) return false;
+    if (!checkInt("overrun frames", 84, stats.overrunFrames)) return false;
+    if (!checkInt("frames read", 32, stats.framesRead)) return false;
+    return true;
+}
+
+bool testRingTargetAdapts() {
+    printf("testRingTargetAdapts\n");
+    sp<SubmixRing> ring = new SubmixRing(4, 1024, 64);
+    const int reader = ring->addReader();
+    const int64_t second = 1000000000LL;
+    if (!checkInt("initial target", 128, ring->targetFrames())) return false;
+
+    // An underrun grows the target by half a period, up to the capacity less two periods.
+    ring->reportHeadroom(reader, -10, second);
+    if (!checkInt("target after underrun", 160, ring->targetFrames())) return false;
+    for (int i = 0; i < 100; i++) {
+        ring->reportHeadroom(reader, -1, second);
+    }
+    if (!checkInt("target at maximum", 1024 - 128, ring->targetFrames())) return false;
+
+    // Two seconds with at least 400 frames spare gives back half of what exceeds a quarter period.
+    ring->reportHeadroom(reader, 500, 2 * second);
+    if (!checkInt("target within window", 1024 - 128, ring->targetFrames())) return false;
+    ring->reportHeadroom(reader, 400, 3 * second);
+    if (!checkInt("target after window", 1024 - 128 - (400 - 16) / 2, ring->targetFrames())) {
+        return false;
+    }
+    // It never goes under 1.25 periods.
+    for (int i = 5; i < 40; i += 2) {
+        ring->reportHeadroom(reader, 1000, i * second);
+    }
+    if (!checkInt("target at minimum", 80, ring->targetFrames())) return false;
+    SubmixRing::ReaderStats stats;
+    ring->getReaderStats(reader, &stats);
+    if (!checkInt("underruns", 101, stats.underruns)) return false;
+    return true;
+}
+
+// HAL
+
+struct WriterThread {
+    struct audio_stream_out* stream;
+    int jitter_us;
+    volatile bool stop;
+    // Start time of the out_write() call of each buffer.
+    std::vector<int64_t> write_times;
+    size_t buffer_frames;
+    pthread_t thread;
+};
+
+struct ReaderThread {
+    struct audio_stream_in* stream;
+    WriterThread* writer;
+    int jitter_us;
+    int64_t stall_at_ns; // if not 0, stop reading for TEST_STALL_MS at this time
+    volatile bool stop;
+    bool started;        // saw the first frame written
+    uint32_t expected;
+    uint64_t frames;
+    uint64_t glitches;
+    uint64_t frames_lost;
+    std::vector<int64_t> latencies_ns;
+    pthread_t thread;
+};
+
+static void* writer_loop(void* arg) {
+    WriterThread* writer = (WriterThread*)arg;
+    const size_t bytes = writer->stream->common.get_buffer_size(&writer->stream->common);
+    writer->buffer_frames = bytes / 4;
+    std::vector<int16_t> buffer(writer->buffer_frames * 2);
+    uint32_t written = 0;
+    while (!writer->stop) {
+        random_delay(writer->jitter_us);
+        stamp_frames(&buffer[0], written, writer->buffer_frames);
+        if (written / writer->buffer_frames < writer->write_times.size()) {
+            writer->write_times[written / writer->buffer_frames] = now_ns();
+        }
+        writer->stream->write(writer->stream, &buffer[0], bytes);
+        written += writer->buffer_frames;
+    }
+    return NULL;
+}
+
+static void* reader_loop(void* arg) {
+    ReaderThread* reader = (ReaderThread*)arg;
+    const size_t bytes = reader->stream->common.get_buffer_size(&reader->stream->common);
+    const size_t frames = bytes / 4;
+    std::vector<int16_t> buffer(frames * 2);
+    while (!reader->stop) {
+        random_delay(reader->jitter_us);
+        if (reader->stall_at_ns != 0 && now_ns() >= reader->stall_at_ns) {
+            reader->stall_at_ns = 0;
+            usleep(TEST_STALL_MS * 1000);
+        }
+        reader->stream->read(reader->stream, &buffer[0], bytes);
+        const int64_t read_ns = now_ns();
+        for (size_t i = 0; i < frames; i++) {
+            const uint32_t value = frame_value(&buffer[0], i);
+            if (!reader->started) {
+                if (value == 0) continue;
+                reader->started = true;
+            } else if (value != reader->expected) {
+                reader->glitches++;
+            }
+            reader->expected = value + 1;
+            reader->frames++;
+            const size_t index = (value - 1) / reader->writer->buffer_frames;
+            if (value != 0 && (value - 1) % reader->writer->buffer_frames == 0 &&
+                    index < reader->writer->write_times.size()) {
+                reader->latencies_ns.push_back(read_ns - reader->writer->write_times[index]);
+            }
+        }
+        reader->frames_lost += reader->stream->get_input_frames_lost(reader->stream);
+    }
+    return NULL;
+}
+
+static double percentile_ms(std::vector<int64_t>& values, double fraction) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    return values[min(values.size() - 1, (size_t)(fraction * values.size()))] / 1e6;
+}
+
+struct RunResult {
+    uint64_t glitches;
+    uint64_t frames_lost;
+    size_t initial_target;
+    size_t final_target;
+};
+
+// Opens one output and reader_count input streams on the same address, writes and reads them
+// for seconds, and reports per input stream. Reader 0 stalls once halfway if stall is set.
+static bool run_hal(const char* name, int seconds, int reader_count, int read_jitter_us,
+        int write_jitter_us, bool stall, std::vector<RunResult>* results) {
+    hw_device_t* device;
+    if (HAL_MODULE_INFO_SYM.common.methods->open(&HAL_MODULE_INFO_SYM.common,
+            AUDIO_HARDWARE_INTERFACE, &device) != 0) {
+        printf("%s: open failed\n", name);
+        return false;
+    }
+    struct audio_hw_device* dev = (struct audio_hw_device*)device;
+    struct audio_config config;
+    memset(&config, 0, sizeof(config));
+    config.sample_rate = TEST_SAMPLE_RATE;
+    config.channel_mask = AUDIO_CHANNEL_OUT_STEREO;
+    config.format = AUDIO_FORMAT_PCM_16_BIT;
+    struct audio_stream_out* out;
+    if (dev->open_output_stream(dev, 0, AUDIO_DEVICE_OUT_REMOTE_SUBMIX, AUDIO_OUTPUT_FLAG_NONE,
+            &config, &out, TEST_ADDRESS) != 0) {
+        printf("%s: open_output_stream failed\n", name);
+        return false;
+    }
+    std::vector<struct audio_stream_in*> ins(reader_count);
+    for (int i = 0; i < reader_count; i++) {
+        config.channel_mask = AUDIO_CHANNEL_IN_STEREO;
+        if (dev->open_input_stream(dev, i + 1, AUDIO_DEVICE_IN_REMOTE_SUBMIX, &config, &ins[i],
+                AUDIO_INPUT_FLAG_NONE, TEST_ADDRESS, AUDIO_SOURCE_REMOTE_SUBMIX) != 0) {
+            printf("%s: open_input_stream %d failed\n", name, i);
+            return false;
+        }
+    }
+    struct submix_audio_device* rsxadev = audio_hw_device_get_submix_audio_device(dev);
+    int route_idx;
+    submix_get_route_idx_for_address_l(rsxadev, TEST_ADDRESS, &route_idx);
+    sp<SubmixRing> ring = rsxadev->routes[route_idx].rsxRing;
+    const size_t initial_target = ring->targetFrames();
+
+    WriterThread writer;
+    writer.stream = out;
+    writer.jitter_us = write_jitter_us;
+    writer.stop = false;
+    writer.write_times.resize((seconds + 1) * TEST_SAMPLE_RATE / 256);
+    writer.buffer_frames = out->common.get_buffer_size(&out->common) / 4;
+    pthread_create(&writer.thread, NULL, writer_loop, &writer);
+    usleep(100000);
+
+    std::vector<ReaderThread> readers(reader_count);
+    const int64_t start_ns = now_ns();
+    for (int i = 0; i < reader_count; i++) {
+        ReaderThread* reader = &readers[i];
+        reader->stream = ins[i];
+        reader->writer = &writer;
+        reader->jitter_us = read_jitter_us;
+        reader->stall_at_ns = stall && i == 0 ? start_ns + seconds * 500000000LL : 0;
+        reader->stop = false;
+        reader->started = false;
+        reader->expected = 0;
+        reader->frames = reader->glitches = reader->frames_lost = 0;
+        pthread_create(&reader->thread, NULL, reader_loop, reader);
+    }
+    sleep(seconds);
+    for (int i = 0; i < reader_count; i++) {
+        readers[i].stop = true;
+        pthread_join(readers[i].thread, NULL);
+    }
+    writer.stop = true;
+    pthread_join(writer.thread, NULL);
+
+    printf("%s: %d s, %d readers, read jitter %d us, write jitter %d us, latency target "
+           "%zu -> %zu frames\n", name, seconds, reader_count, read_jitter_us, write_jitter_us,
+           initial_target, ring->targetFrames());
+    printf("  reader     frames  glitches      lost underruns   p50 ms   p99 ms   max ms\n");
+    results->clear();
+    for (int i = 0; i < reader_count; i++) {
+        ReaderThread* reader = &readers[i];
+        SubmixRing::ReaderStats stats;
+        ring->getReaderStats(audio_stream_in_get_submix_stream_in(ins[i])->reader, &stats);
+        printf("  %6d %10llu %9llu %9llu %9u %8.1f %8.1f %8.1f\n", i,
+               (unsigned long long)reader->frames, (unsigned long long)reader->glitches,
+               (unsigned long long)reader->frames_lost, stats.underruns,
+               percentile_ms(reader->latencies_ns, 0.5), percentile_ms(reader->latencies_ns, 0.99),
+               percentile_ms(reader->latencies_ns, 1.0));
+        RunResult result = { reader->glitches, reader->frames_lost, initial_target,
+                ring->targetFrames() };
+        results->push_back(result);
+    }
+    ring.clear();
+
+    for (int i = 0; i < reader_count; i++) {
+        dev->close_input_stream(dev, ins[i]);
+    }
+    dev->close_output_stream(dev, out);
+    device->close(device);
+    return true;
+}
+
+bool testFanOut(int seconds) {
+    std::vector<RunResult> results;
+    if (!run_hal("testFanOut", seconds, 2, 0, 0, false, &results)) return false;
+    for (size_t i = 0; i < results.size(); i++) {
+        if (!checkInt("glitches", 0, results[i].glitches)) return false;
+        if (!checkInt("frames lost", 0, results[i].frames_lost)) return false;
+    }
+    return checkTrue("latency did not shrink with steady readers",
+            results[0].final_target < results[0].initial_target);
+}
+
+bool testStalledReader(int seconds) {
+    std::vector<RunResult> results;
+    if (!run_hal("testStalledReader", seconds, 2, 0, 0, true, &results)) return false;
+    // The stalled reader is overrun and told so; the other one does not notice.
+    if (!checkTrue("stalled reader lost no frames", results[0].frames_lost > 0)) return false;
+    if (!checkTrue("stalled reader has no glitch", results[0].glitches > 0)) return false;
+    if (!checkInt("other reader glitches", 0, results[1].glitches)) return false;
+    return checkInt("other reader frames lost", 0, results[1].frames_lost);
+}
+
+bool testLateWriter(int seconds) {
+    std::vector<RunResult> results;
+    if (!run_hal("testLateWriter", seconds, 2, 0, 40000, false, &results)) return false;
+    // Writes up to 40 ms late underrun the initial latency of two periods, so the target grows.
+    return checkTrue("latency did not grow with a late writer",
+            results[0].final_target > results[0].initial_target);
+}
+
+int main(int argc, char **argv) {
+    int seconds = 3;
+    int read_jitter_us = -1;
+    int write_jitter_us = -1;
+    int reader_count = 2;
+    int opt;
+    srand(1);
+    while ((opt = getopt(argc, argv, "d:j:w:r:")) != -1) {
+        switch (opt) {
+        case 'd': seconds = atoi(optarg); break;
+        case 'j': read_jitter_us = atoi(optarg); break;
+        case 'w': write_jitter_us = atoi(optarg); break;
+        case 'r': reader_count = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-d seconds] [-j read jitter us] [-w write jitter us] "
+                    "[-r readers]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (read_jitter_us >= 0 || write_jitter_us >= 0) {
+        std::vector<RunResult> results;
+        return run_hal("run", seconds, reader_count, max(read_jitter_us, 0),
+                max(write_jitter_us, 0), false, &results) ? 0 : 1;
+    }
+
+    if (testRingFanOut()
+            && testRingOverrun()
+            && testRingTargetAdapts()
+            && testFanOut(seconds)
+            && testStalledReader(seconds)
+            && testLateWriter(seconds)) {
+        printf("ALL PASSED\n");
+    } else {
+        printf("SOMETHING FAILED\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
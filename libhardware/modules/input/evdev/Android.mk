@@ -21,7 +21,8 @@ LOCAL_SRC_FILES := \
     InputHub.cpp \
     InputDevice.cpp \
     InputDeviceManager.cpp \
-    InputHost.cpp
+    InputHost.cpp \
+    TouchCoalescer.cpp
 
 LOCAL_SHARED_LIBRARIES := \
     libhardware_legacy \
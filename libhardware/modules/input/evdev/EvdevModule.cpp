@@ -55,7 +55,7 @@ static std::shared_ptr<EvdevModule> gEvdevModule;
 
 EvdevModule::EvdevModule(InputHost inputHost) :
     mInputHost(inputHost),
-    mDeviceManager(std::make_shared<InputDeviceManager>()),
+    mDeviceManager(std::make_shared<InputDeviceManager>(inputHost)),
     mInputHub(std::make_shared<InputHub>(mDeviceManager)) {}
 
 void EvdevModule::init() {
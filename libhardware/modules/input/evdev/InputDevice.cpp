@@ -97,6 +97,25 @@ void EvdevDevice::processInput(InputEvent& event, nsecs_t currentTime) {
                     ", call time %" PRId64 ".", event.when, time, currentTime);
         }
     }
+
+    if (mTouchCoalescer != nullptr) {
+        mTouchCoalescer->processEvent(event);
+    }
+}
+
+nsecs_t EvdevDevice::getNextDeadline() {
+    return mTouchCoalescer != nullptr ? mTouchCoalescer->getNextDeadline() : -1;
+}
+
+void EvdevDevice::onDeadline(nsecs_t now) {
+    if (mTouchCoalescer != nullptr) {
+        mTouchCoalescer->onDeadline(now);
+    }
+}
+
+void EvdevDevice::enableTouchCoalescing(const TouchCoalescerConfig& config,
+        TouchCoalescer::FrameCallback callback) {
+    mTouchCoalescer = std::make_unique<TouchCoalescer>(config, callback);
 }
 
 }  // namespace android
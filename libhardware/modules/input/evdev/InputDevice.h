@@ -22,6 +22,7 @@
 #include <utils/Timers.h>
 
 #include "InputHub.h"
+#include "TouchCoalescer.h"
 
 namespace android {
 
@@ -33,6 +34,13 @@ class InputDeviceInterface {
 public:
     virtual void processInput(InputEvent& event, nsecs_t currentTime) = 0;
 
+    /**
+     * Returns the time at which onDeadline() should be called even if no
+     * input arrives, or -1 if the device is not waiting for one.
+     */
+    virtual nsecs_t getNextDeadline() { return -1; }
+    virtual void onDeadline(nsecs_t now) {}
+
 protected:
     InputDeviceInterface() = default;
     virtual ~InputDeviceInterface() = default;
@@ -47,9 +55,19 @@ public:
     virtual ~EvdevDevice() override = default;
 
     virtual void processInput(InputEvent& event, nsecs_t currentTime) override;
+    virtual nsecs_t getNextDeadline() override;
+    virtual void onDeadline(nsecs_t now) override;
+
+    /**
+     * Passes the device's multitouch events through a TouchCoalescer, which
+     * hands the resulting frames to callback.
+     */
+    void enableTouchCoalescing(const TouchCoalescerConfig& config,
+            TouchCoalescer::FrameCallback callback);
 
 private:
     std::shared_ptr<InputDeviceNode> mDeviceNode;
+    std::unique_ptr<TouchCoalescer> mTouchCoalescer;
 
     int32_t mOverrideSec = 0;
     int32_t mOverrideUsec = 0;
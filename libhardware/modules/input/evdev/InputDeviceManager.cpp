@@ -17,6 +17,13 @@
 #define LOG_TAG "InputDeviceManager"
 //#define LOG_NDEBUG 0
 
+#include <linux/input.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __STDC_FORMAT_MACROS
+#include <cinttypes>
+
 #include <utils/Log.h>
 
 #include "InputDevice.h"
@@ -24,6 +31,19 @@
 
 namespace android {
 
+static InputBus getInputBus(uint16_t busType) {
+    switch (busType) {
+        case BUS_USB:
+            return INPUT_BUS_USB;
+        case BUS_BLUETOOTH:
+            return INPUT_BUS_BT;
+        case BUS_RS232:
+            return INPUT_BUS_SERIAL;
+        default:
+            return INPUT_BUS_BUILTIN;
+    }
+}
+
 void InputDeviceManager::onInputEvent(std::shared_ptr<InputDeviceNode> node, InputEvent& event,
         nsecs_t event_time) {
     if (mDevices[node] == nullptr) {
@@ -33,8 +53,30 @@ void InputDeviceManager::onInputEvent(std::shared_ptr<InputDeviceNode> node, Inp
     mDevices[node]->processInput(event, event_time);
 }
 
+void InputDeviceManager::onInputEvents(std::shared_ptr<InputDeviceNode> node,
+        InputEvent* events, size_t count, nsecs_t event_time) {
+    auto device = mDevices.find(node);
+    if (device == mDevices.end() || device->second == nullptr) {
+        ALOGE("got input events for unknown node %s", node->getPath().c_str());
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        device->second->processInput(events[i], event_time);
+    }
+}
+
 void InputDeviceManager::onDeviceAdded(std::shared_ptr<InputDeviceNode> node) {
-    mDevices[node] = std::make_shared<EvdevDevice>(node);
+    auto device = std::make_shared<EvdevDevice>(node);
+    if (mHost != nullptr && node->getAbsoluteAxisInfo(ABS_MT_POSITION_X) != nullptr) {
+        auto id = mHost->createDeviceIdentifier(node->getName().c_str(), node->getProductId(),
+                node->getVendorId(), getInputBus(node->getBusType()),
+                node->getUniqueId().c_str());
+        TouchCoalescerConfig config;
+        if (getTouchCoalescerConfig(node, id, &config)) {
+            registerTouchDevice(node, id, config, device);
+        }
+    }
+    mDevices[node] = device;
 }
 
 void InputDeviceManager::onDeviceRemoved(std::shared_ptr<InputDeviceNode> node) {
@@ -42,9 +84,143 @@ void InputDeviceManager::onDeviceRemoved(std::shared_ptr<InputDeviceNode> node)
         ALOGE("could not remove unknown node %s", node->getPath().c_str());
         return;
     }
+    auto hostDevice = mHostDevices.find(node);
+    if (hostDevice != mHostDevices.end()) {
+        mHost->unregisterDevice(hostDevice->second);
+        mHostDevices.erase(hostDevice);
+    }
     // TODO: tell the InputDevice and InputDeviceNode that they are being
     // removed so they can run any cleanup.
     mDevices.erase(node);
 }
 
+nsecs_t InputDeviceManager::getNextDeadline() {
+    nsecs_t next = -1;
+    for (const auto& device : mDevices) {
+        nsecs_t deadline = device.second != nullptr ? device.second->getNextDeadline() : -1;
+        if (deadline >= 0 && (next < 0 || deadline < next)) {
+            next = deadline;
+        }
+    }
+    return next;
+}
+
+void InputDeviceManager::onDeadline(nsecs_t now) {
+    for (const auto& device : mDevices) {
+        if (device.second != nullptr) {
+            device.second->onDeadline(now);
+        }
+    }
+}
+
+/**
+ * Multitouch devices are coalesced when their properties set
+ * touch.coalesce.rate, the most frames per second to report. The targets are
+ * offset from CLOCK_MONOTONIC zero by touch.coalesce.phaseUs, and
+ * touch.resample = 0 reports frames with their own times rather than
+ * resampled to the targets.
+ */
+bool InputDeviceManager::getTouchCoalescerConfig(const std::shared_ptr<InputDeviceNode>& node,
+        InputDeviceIdentifier id, TouchCoalescerConfig* outConfig) {
+    auto properties = mHost->getDevicePropertyMap(id);
+
+    // The values belong to the InputProperty objects, so keep those around.
+    auto rateProperty = properties.getDeviceProperty("touch.coalesce.rate");
+    const char* rate = rateProperty.getValue();
+    double hz = rate != nullptr ? strtod(rate, nullptr) : 0;
+    if (hz <= 0) {
+        return false;
+    }
+    outConfig->period = static_cast<nsecs_t>(1e9 / hz);
+
+    auto phaseProperty = properties.getDeviceProperty("touch.coalesce.phaseUs");
+    const char* phase = phaseProperty.getValue();
+    if (phase != nullptr) {
+        outConfig->phase = us2ns(strtoll(phase, nullptr, 10));
+    }
+    auto resampleProperty = properties.getDeviceProperty("touch.resample");
+    const char* resample = resampleProperty.getValue();
+    if (resample != nullptr) {
+        outConfig->resample = strcmp(resample, "0") != 0 && strcmp(resample, "false") != 0;
+    }
+    ALOGI("coalescing touch frames from %s to %.1f Hz%s", node->getPath().c_str(), hz,
+            outConfig->resample ? ", resampled" : "");
+    return true;
+}
+
+static void declareAxis(InputReportDefinition& report, InputUsage usage,
+        const AbsoluteAxisInfo* info) {
+    report.declareUsage(INPUT_COLLECTION_ID_TOUCH, usage, info->minValue, info->maxValue,
+            info->resolution);
+}
+
+/**
+ * Registers a coalesced multitouch device with the host and reports its touch
+ * frames as one touch collection per slot. The contacts that are up in a frame
+ * are reported with zero pressure; devices without ABS_MT_PRESSURE report a
+ * pressure of 1 for the contacts that are down.
+ */
+void InputDeviceManager::registerTouchDevice(const std::shared_ptr<InputDeviceNode>& node,
+        InputDeviceIdentifier id, const TouchCoalescerConfig& config,
+        const std::shared_ptr<EvdevDevice>& device) {
+    auto reportDefinition = mHost->createInputReportDefinition();
+    reportDefinition.addCollection(INPUT_COLLECTION_ID_TOUCH, TOUCH_MAX_SLOTS);
+    declareAxis(reportDefinition, INPUT_USAGE_AXIS_X, node->getAbsoluteAxisInfo(ABS_MT_POSITION_X));
+    auto yInfo = node->getAbsoluteAxisInfo(ABS_MT_POSITION_Y);
+    if (yInfo != nullptr) {
+        declareAxis(reportDefinition, INPUT_USAGE_AXIS_Y, yInfo);
+    }
+    auto pressureInfo = node->getAbsoluteAxisInfo(ABS_MT_PRESSURE);
+    if (pressureInfo != nullptr) {
+        declareAxis(reportDefinition, INPUT_USAGE_AXIS_PRESSURE, pressureInfo);
+    } else {
+        reportDefinition.declareUsage(INPUT_COLLECTION_ID_TOUCH, INPUT_USAGE_AXIS_PRESSURE,
+                0, 1, 0);
+    }
+    auto touchMajorInfo = node->getAbsoluteAxisInfo(ABS_MT_TOUCH_MAJOR);
+    if (touchMajorInfo != nullptr) {
+        declareAxis(reportDefinition, INPUT_USAGE_AXIS_TOUCH_MAJOR, touchMajorInfo);
+    }
+
+    auto deviceDefinition = mHost->createDeviceDefinition();
+    deviceDefinition.addReport(reportDefinition);
+    InputDeviceHandle handle = mHost->registerDevice(id, deviceDefinition);
+    if (handle == nullptr) {
+        ALOGE("could not register touch device %s", node->getPath().c_str());
+        return;
+    }
+    mHostDevices[node] = handle;
+
+    InputReport report = reportDefinition.allocateReport();
+    bool hasPressure = pressureInfo != nullptr;
+    bool hasTouchMajor = touchMajorInfo != nullptr;
+    device->enableTouchCoalescing(config,
+            [report, handle, hasPressure, hasTouchMajor](const TouchFrame& frame) mutable {
+        bool down[TOUCH_MAX_SLOTS] = {};
+        for (size_t i = 0; i < frame.contactCount; ++i) {
+            const TouchContact& contact = frame.contacts[i];
+            down[contact.slot] = true;
+            report.setIntUsage(INPUT_COLLECTION_ID_TOUCH, INPUT_USAGE_AXIS_X, contact.x,
+                    contact.slot);
+            report.setIntUsage(INPUT_COLLECTION_ID_TOUCH, INPUT_USAGE_AXIS_Y, contact.y,
+                    contact.slot);
+            report.setIntUsage(INPUT_COLLECTION_ID_TOUCH, INPUT_USAGE_AXIS_PRESSURE,
+                    hasPressure ? contact.pressure : 1, contact.slot);
+            if (hasTouchMajor) {
+                report.setIntUsage(INPUT_COLLECTION_ID_TOUCH, INPUT_USAGE_AXIS_TOUCH_MAJOR,
+                        contact.touchMajor, contact.slot);
+            }
+        }
+        for (size_t slot = 0; slot < TOUCH_MAX_SLOTS; ++slot) {
+            if (!down[slot]) {
+                report.setIntUsage(INPUT_COLLECTION_ID_TOUCH, INPUT_USAGE_AXIS_PRESSURE, 0,
+                        static_cast<int32_t>(slot));
+            }
+        }
+        ALOGV("touch frame: %zu contacts at %" PRId64 "%s", frame.contactCount, frame.when,
+                frame.resampled ? " (resampled)" : "");
+        report.reportEvent(handle);
+    });
+}
+
 }  // namespace android
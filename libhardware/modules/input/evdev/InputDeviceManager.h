@@ -23,6 +23,7 @@
 #include <utils/Timers.h>
 
 #include "InputDevice.h"
+#include "InputHost.h"
 #include "InputHub.h"
 
 namespace android {
@@ -34,18 +35,35 @@ namespace android {
  */
 class InputDeviceManager : public InputCallbackInterface {
 public:
+    InputDeviceManager() = default;
+    /** Devices are configured from the host's device properties. */
+    explicit InputDeviceManager(InputHost host) : mHost(std::make_unique<InputHost>(host)) {}
     virtual ~InputDeviceManager() override = default;
 
     virtual void onInputEvent(std::shared_ptr<InputDeviceNode> node, InputEvent& event,
             nsecs_t event_time) override;
+    virtual void onInputEvents(std::shared_ptr<InputDeviceNode> node, InputEvent* events,
+            size_t count, nsecs_t event_time) override;
     virtual void onDeviceAdded(std::shared_ptr<InputDeviceNode> node) override;
     virtual void onDeviceRemoved(std::shared_ptr<InputDeviceNode> node) override;
+    virtual nsecs_t getNextDeadline() override;
+    virtual void onDeadline(nsecs_t now) override;
 
 private:
+    bool getTouchCoalescerConfig(const std::shared_ptr<InputDeviceNode>& node,
+            InputDeviceIdentifier id, TouchCoalescerConfig* outConfig);
+    void registerTouchDevice(const std::shared_ptr<InputDeviceNode>& node,
+            InputDeviceIdentifier id, const TouchCoalescerConfig& config,
+            const std::shared_ptr<EvdevDevice>& device);
+
+    std::unique_ptr<InputHost> mHost;
+
     template<class T, class U>
     using DeviceMap = std::unordered_map<std::shared_ptr<T>, std::shared_ptr<U>>;
 
     DeviceMap<InputDeviceNode, InputDeviceInterface> mDevices;
+    // Host handles of the devices whose touch frames are reported to the host.
+    std::unordered_map<std::shared_ptr<InputDeviceNode>, InputDeviceHandle> mHostDevices;
 };
 
 }  // namespace android
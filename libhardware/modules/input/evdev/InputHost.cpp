@@ -18,6 +18,11 @@
 
 namespace android {
 
+void InputReport::setIntUsage(InputCollectionId id, InputUsage usage, int32_t value,
+        int32_t arityIndex) {
+    mCallbacks.input_report_set_usage_int(mHost, mReport, id, usage, value, arityIndex);
+}
+
 void InputReport::reportEvent(InputDeviceHandle d) {
     mCallbacks.report_event(mHost, d, mReport);
 }
@@ -55,6 +55,7 @@ public:
     InputReport& operator=(const InputReport& rhs) = default;
     operator input_report_t*() const { return mReport; }
 
+    void setIntUsage(InputCollectionId id, InputUsage usage, int32_t value, int32_t arityIndex);
     void reportEvent(InputDeviceHandle d);
 
 private:
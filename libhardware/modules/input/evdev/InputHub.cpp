@@ -46,6 +46,9 @@ namespace android {
 static const char WAKE_LOCK_ID[] = "KeyEvents";
 static const int NO_TIMEOUT = -1;
 static const int EPOLL_MAX_EVENTS = 16;
+// How many times poll() goes back to epoll for more ready fds after a full
+// batch before it returns to the caller.
+static const int EPOLL_MAX_DRAIN_ROUNDS = 4;
 static const int INPUT_MAX_EVENTS = 128;
 
 static constexpr bool testBit(int bit, const uint8_t arr[]) {
@@ -513,16 +516,28 @@ status_t InputHub::poll() {
         release_wake_lock(WAKE_LOCK_ID);
     }
 
+    // Wake up for the callback's deadline, e.g. a touch frame held back for
+    // coalescing, even if no more events arrive.
+    nsecs_t deadline = mInputCallback->getNextDeadline();
+    int timeout = NO_TIMEOUT;
+    if (deadline >= 0) {
+        timeout = toMillisecondTimeoutDelay(systemTime(SYSTEM_TIME_MONOTONIC), deadline);
+    }
+
     struct epoll_event pendingEventItems[EPOLL_MAX_EVENTS];
-    int pollResult = epoll_wait(mEpollFd, pendingEventItems, EPOLL_MAX_EVENTS, NO_TIMEOUT);
+    int pollResult = epoll_wait(mEpollFd, pendingEventItems, EPOLL_MAX_EVENTS, timeout);
 
     if (manageWakeLocks()) {
         acquire_wake_lock(PARTIAL_WAKE_LOCK, WAKE_LOCK_ID);
     }
 
     if (pollResult == 0) {
-        ALOGW("epoll_wait should not return 0 with no timeout");
-        return UNKNOWN_ERROR;
+        if (timeout == NO_TIMEOUT) {
+            ALOGW("epoll_wait should not return 0 with no timeout");
+            return UNKNOWN_ERROR;
+        }
+        checkDeadline();
+        return OK;
     }
     if (pollResult < 0) {
         // An error occurred. Return even if it's EINTR, and let the caller
@@ -532,89 +547,72 @@ status_t InputHub::poll() {
     }
 
     // pollResult > 0: there are events to process
-    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
     std::vector<int> removedDeviceFds;
-    int inputFd = -1;
-    std::shared_ptr<InputDeviceNode> deviceNode;
-    for (int i = 0; i < pollResult; ++i) {
-        const struct epoll_event& eventItem = pendingEventItems[i];
+    for (int round = 1; ; ++round) {
+        nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        for (int i = 0; i < pollResult; ++i) {
+            const struct epoll_event& eventItem = pendingEventItems[i];
+
+            int dataFd = static_cast<int>(eventItem.data.u32);
+            if (dataFd == mINotifyFd) {
+                if (eventItem.events & EPOLLIN) {
+                    deviceChange = true;
+                } else {
+                    ALOGW("Received unexpected epoll event 0x%08x for INotify.", eventItem.events);
+                }
+                continue;
+            }
 
-        int dataFd = static_cast<int>(eventItem.data.u32);
-        if (dataFd == mINotifyFd) {
-            if (eventItem.events & EPOLLIN) {
-                deviceChange = true;
-            } else {
-                ALOGW("Received unexpected epoll event 0x%08x for INotify.", eventItem.events);
+            if (dataFd == mWakeEventFd) {
+                if (eventItem.events & EPOLLIN) {
+                    ALOGV("awoken after wake()");
+                    uint64_t u;
+                    ssize_t nRead = TEMP_FAILURE_RETRY(read(mWakeEventFd, &u, sizeof(uint64_t)));
+                    if (nRead != sizeof(uint64_t)) {
+                        ALOGW("Could not read event fd; waking anyway.");
+                    }
+                } else {
+                    ALOGW("Received unexpected epoll event 0x%08x for wake event.",
+                            eventItem.events);
+                }
+                continue;
             }
-            continue;
-        }
 
-        if (dataFd == mWakeEventFd) {
+            auto deviceNode = findNodeByFd(dataFd);
+            if (deviceNode == nullptr) {
+                ALOGE("could not find device node for fd %d", dataFd);
+                continue;
+            }
             if (eventItem.events & EPOLLIN) {
-                ALOGV("awoken after wake()");
-                uint64_t u;
-                ssize_t nRead = TEMP_FAILURE_RETRY(read(mWakeEventFd, &u, sizeof(uint64_t)));
-                if (nRead != sizeof(uint64_t)) {
-                    ALOGW("Could not read event fd; waking anyway.");
+                if (!readDeviceEvents(dataFd, deviceNode, now)) {
+                    removedDeviceFds.push_back(dataFd);
                 }
+            } else if (eventItem.events & EPOLLHUP) {
+                ALOGI("Removing device fd %d due to epoll hangup event.", dataFd);
+                removedDeviceFds.push_back(dataFd);
             } else {
-                ALOGW("Received unexpected epoll event 0x%08x for wake event.",
-                        eventItem.events);
+                ALOGW("Received unexpected epoll event 0x%08x for device fd %d",
+                        eventItem.events, dataFd);
             }
-            continue;
         }
 
-        // Update the fd and device node when the fd changes. When several
-        // events are read back-to-back with the same fd, this saves many reads
-        // from the hash table.
-        if (inputFd != dataFd) {
-            inputFd = dataFd;
-            deviceNode = mDeviceNodes[inputFd];
-        }
-        if (deviceNode == nullptr) {
-            ALOGE("could not find device node for fd %d", inputFd);
-            continue;
+        // A full batch may have left other fds ready. Read them now rather
+        // than on the next poll(), so that a few busy devices do not hold back
+        // the frames of the rest.
+        if (pollResult < EPOLL_MAX_EVENTS || round == EPOLL_MAX_DRAIN_ROUNDS) {
+            break;
         }
-        if (eventItem.events & EPOLLIN) {
-            struct input_event ievs[INPUT_MAX_EVENTS];
-            for (;;) {
-                ssize_t readSize = TEMP_FAILURE_RETRY(read(inputFd, ievs, sizeof(ievs)));
-                if (readSize == 0 || (readSize < 0 && errno == ENODEV)) {
-                    ALOGW("could not get event, removed? (fd: %d, size: %d errno: %d)",
-                            inputFd, readSize, errno);
-
-                    removedDeviceFds.push_back(inputFd);
-                    break;
-                } else if (readSize < 0) {
-                    if (errno != EAGAIN && errno != EINTR) {
-                        ALOGW("could not get event. errno=%d", errno);
-                    }
-                    break;
-                } else if (readSize % sizeof(input_event) != 0) {
-                    ALOGE("could not get event. wrong size=%d", readSize);
-                    break;
-                } else {
-                    size_t count = static_cast<size_t>(readSize) / sizeof(struct input_event);
-                    for (size_t i = 0; i < count; ++i) {
-                        auto& iev = ievs[i];
-                        auto when = s2ns(iev.time.tv_sec) + us2ns(iev.time.tv_usec);
-                        InputEvent inputEvent = { when, iev.type, iev.code, iev.value };
-                        mInputCallback->onInputEvent(deviceNode, inputEvent, now);
-                    }
-                }
-            }
-        } else if (eventItem.events & EPOLLHUP) {
-            ALOGI("Removing device fd %d due to epoll hangup event.", inputFd);
-            removedDeviceFds.push_back(inputFd);
-        } else {
-            ALOGW("Received unexpected epoll event 0x%08x for device fd %d",
-                    eventItem.events, inputFd);
+        pollResult = epoll_wait(mEpollFd, pendingEventItems, EPOLL_MAX_EVENTS, 0);
+        if (pollResult <= 0) {
+            break;
         }
     }
 
     if (removedDeviceFds.size()) {
         for (auto deviceFd : removedDeviceFds) {
-            auto deviceNode = mDeviceNodes[deviceFd];
+            // A hung up fd is reported again by every epoll_wait, so it can be
+            // in the list more than once.
+            auto deviceNode = findNodeByFd(deviceFd);
             if (deviceNode != nullptr) {
                 status_t ret = closeNodeByFd(deviceFd);
                 if (ret != OK) {
@@ -630,9 +628,68 @@ status_t InputHub::poll() {
         readNotify();
     }
 
+    // Other fds may have kept epoll_wait from timing out; the deadline must
+    // not wait for them to go quiet.
+    checkDeadline();
+
     return OK;
 }
 
+void InputHub::checkDeadline() {
+    nsecs_t deadline = mInputCallback->getNextDeadline();
+    if (deadline < 0) {
+        return;
+    }
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    if (now >= deadline) {
+        mInputCallback->onDeadline(now);
+    }
+}
+
+bool InputHub::readDeviceEvents(int fd, const std::shared_ptr<InputDeviceNode>& node,
+        nsecs_t now) {
+    // Hand the callback a frame at a time. Frames that straddle two reads are
+    // put back together; a frame that is still incomplete once the device runs
+    // out of events is delivered as is, rather than held until the next poll().
+    struct input_event ievs[INPUT_MAX_EVENTS];
+    bool present = true;
+    mFrameEvents.clear();
+    for (;;) {
+        ssize_t readSize = TEMP_FAILURE_RETRY(read(fd, ievs, sizeof(ievs)));
+        if (readSize == 0 || (readSize < 0 && errno == ENODEV)) {
+            ALOGW("could not get event, removed? (fd: %d, size: %zd errno: %d)",
+                    fd, readSize, errno);
+            present = false;
+            break;
+        } else if (readSize < 0) {
+            if (errno != EAGAIN && errno != EINTR) {
+                ALOGW("could not get event. errno=%d", errno);
+            }
+            break;
+        } else if (readSize % sizeof(input_event) != 0) {
+            ALOGE("could not get event. wrong size=%zd", readSize);
+            break;
+        }
+
+        size_t count = static_cast<size_t>(readSize) / sizeof(struct input_event);
+        for (size_t i = 0; i < count; ++i) {
+            auto& iev = ievs[i];
+            auto when = s2ns(iev.time.tv_sec) + us2ns(iev.time.tv_usec);
+            mFrameEvents.push_back({ when, iev.type, iev.code, iev.value });
+            if (iev.type == EV_SYN && iev.code == SYN_REPORT) {
+                mInputCallback->onInputEvents(node, mFrameEvents.data(), mFrameEvents.size(),
+                        now);
+                mFrameEvents.clear();
+            }
+        }
+    }
+    if (!mFrameEvents.empty()) {
+        mInputCallback->onInputEvents(node, mFrameEvents.data(), mFrameEvents.size(), now);
+        mFrameEvents.clear();
+    }
+    return present;
+}
+
 status_t InputHub::wake() {
     ALOGV("wake() called");
 
@@ -723,18 +780,31 @@ status_t InputHub::scanDir(const std::string& path) {
     return OK;
 }
 
+std::shared_ptr<InputDeviceNode> InputHub::openDeviceNode(const std::string& path,
+        int* outFd) {
+    auto evdevNode = std::shared_ptr<EvdevDeviceNode>(EvdevDeviceNode::openDeviceNode(path));
+    if (evdevNode == nullptr) {
+        return nullptr;
+    }
+    *outFd = evdevNode->getFd();
+    return evdevNode;
+}
+
 status_t InputHub::openNode(const std::string& path,
         std::shared_ptr<InputDeviceNode>* outNode) {
     ALOGV("opening %s...", path.c_str());
-    auto evdevNode = std::shared_ptr<EvdevDeviceNode>(EvdevDeviceNode::openDeviceNode(path));
-    if (evdevNode == nullptr) {
+    int fd = -1;
+    auto node = openDeviceNode(path, &fd);
+    if (node == nullptr) {
         return UNKNOWN_ERROR;
     }
 
-    auto fd = evdevNode->getFd();
     ALOGV("opened %s with fd %d", path.c_str(), fd);
-    *outNode = std::static_pointer_cast<InputDeviceNode>(evdevNode);
-    mDeviceNodes[fd] = *outNode;
+    *outNode = node;
+    if (static_cast<size_t>(fd) >= mDeviceNodes.size()) {
+        mDeviceNodes.resize(fd + 1);
+    }
+    mDeviceNodes[fd] = node;
     struct epoll_event eventItem{};
     eventItem.events = EPOLLIN;
     if (mWakeupMechanism == WakeMechanism::EPOLL_WAKEUP) {
@@ -769,9 +839,9 @@ status_t InputHub::openNode(const std::string& path,
 }
 
 status_t InputHub::closeNode(const std::shared_ptr<InputDeviceNode>& node) {
-    for (auto pair : mDeviceNodes) {
-        if (pair.second.get() == node.get()) {
-            return closeNodeByFd(pair.first);
+    for (size_t fd = 0; fd < mDeviceNodes.size(); ++fd) {
+        if (mDeviceNodes[fd].get() == node.get()) {
+            return closeNodeByFd(fd);
         }
     }
     return BAD_VALUE;
@@ -783,14 +853,16 @@ status_t InputHub::closeNodeByFd(int fd) {
         ALOGW("Could not remove device fd from epoll instance. errno=%d", errno);
         ret = -errno;
     }
-    mDeviceNodes.erase(fd);
-    ::close(fd);
+    // The node closes the fd when the last reference to it goes away. Closing
+    // it here as well could close a device opened in the meantime on the same
+    // fd.
+    mDeviceNodes[fd].reset();
     return ret;
 }
 
 std::shared_ptr<InputDeviceNode> InputHub::findNodeByPath(const std::string& path) {
-    for (auto pair : mDeviceNodes) {
-        if (pair.second->getPath() == path) return pair.second;
+    for (const auto& node : mDeviceNodes) {
+        if (node != nullptr && node->getPath() == path) return node;
     }
     return nullptr;
 }
@@ -20,6 +20,7 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <utils/String8.h>
 #include <utils/Timers.h>
@@ -91,9 +92,31 @@ class InputCallbackInterface {
 public:
     virtual void onInputEvent(std::shared_ptr<InputDeviceNode> node, InputEvent& event,
             nsecs_t event_time) = 0;
+
+    /**
+     * Receives the events of one frame from a device: everything up to and
+     * including the SYN_REPORT that ends it, or whatever had been read of the
+     * frame when the device ran out of events. The events are only valid for
+     * the duration of the call.
+     *
+     * The default implementation calls onInputEvent() for each event.
+     */
+    virtual void onInputEvents(std::shared_ptr<InputDeviceNode> node, InputEvent* events,
+            size_t count, nsecs_t event_time) {
+        for (size_t i = 0; i < count; ++i) {
+            onInputEvent(node, events[i], event_time);
+        }
+    }
     virtual void onDeviceAdded(std::shared_ptr<InputDeviceNode> node) = 0;
     virtual void onDeviceRemoved(std::shared_ptr<InputDeviceNode> node) = 0;
 
+    /**
+     * Returns the CLOCK_MONOTONIC time by which poll() should return and call
+     * onDeadline() even if no events arrive, or -1 for no deadline.
+     */
+    virtual nsecs_t getNextDeadline() { return -1; }
+    virtual void onDeadline(nsecs_t now) {}
+
 protected:
     InputCallbackInterface() = default;
     virtual ~InputCallbackInterface() = default;
@@ -140,6 +163,15 @@ public:
 
     virtual void dump(String8& dump) override;
 
+protected:
+    /**
+     * Opens the input device at path and returns it along with the fd to poll
+     * for its input_event records, or nullptr if path is not an input device.
+     * The node owns the fd. Tests override this to feed the hub from pipes.
+     */
+    virtual std::shared_ptr<InputDeviceNode> openDeviceNode(const std::string& path,
+            int* outFd);
+
 private:
     status_t readNotify();
     status_t scanDir(const std::string& path);
@@ -147,6 +179,12 @@ private:
     status_t closeNode(const std::shared_ptr<InputDeviceNode>& node);
     status_t closeNodeByFd(int fd);
     std::shared_ptr<InputDeviceNode> findNodeByPath(const std::string& path);
+    std::shared_ptr<InputDeviceNode> findNodeByFd(int fd) const {
+        return fd >= 0 && static_cast<size_t>(fd) < mDeviceNodes.size() ?
+                mDeviceNodes[fd] : nullptr;
+    }
+    bool readDeviceEvents(int fd, const std::shared_ptr<InputDeviceNode>& node, nsecs_t now);
+    void checkDeadline();
 
     enum class WakeMechanism {
         /**
@@ -196,7 +234,11 @@ private:
     // Map from watch descriptors to watched paths
     std::unordered_map<int, std::string> mWatchedPaths;
     // Map from file descriptors to InputDeviceNodes
-    std::unordered_map<int, std::shared_ptr<InputDeviceNode>> mDeviceNodes;
+    // Indexed by fd; fds are small and dense, and this is looked up for every
+    // epoll item.
+    std::vector<std::shared_ptr<InputDeviceNode>> mDeviceNodes;
+    // The frame being assembled by readDeviceEvents().
+    std::vector<InputEvent> mFrameEvents;
 };
 
 }  // namespace android
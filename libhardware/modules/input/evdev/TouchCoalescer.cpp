@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define LOG_TAG "TouchCoalescer"
+//#define LOG_NDEBUG 0
+
+#include <linux/input.h>
+#include <math.h>
+
+#include <utils/Log.h>
+
+#include "TouchCoalescer.h"
+
+namespace android {
+
+TouchCoalescer::TouchCoalescer(const TouchCoalescerConfig& config, FrameCallback callback) :
+    mConfig(config), mCallback(callback) {
+    for (size_t i = 0; i < TOUCH_MAX_SLOTS; ++i) {
+        mSlots[i].contact = TouchContact{ static_cast<int32_t>(i), -1, 0, 0, 0, 0 };
+    }
+}
+
+void TouchCoalescer::processEvent(const InputEvent& event) {
+    if (event.type == EV_SYN) {
+        if (event.code == SYN_REPORT) {
+            if (mDropping) {
+                // The kernel dropped events, so the slots may be stale; pick
+                // up again from here.
+                mDropping = false;
+                return;
+            }
+            endFrame(event.when);
+        } else if (event.code == SYN_DROPPED) {
+            ALOGW("events dropped by the kernel; skipping to the next frame");
+            mDropping = true;
+        }
+        return;
+    }
+    if (event.type != EV_ABS || mDropping) {
+        return;
+    }
+
+    if (event.code == ABS_MT_SLOT) {
+        mCurrentSlot = event.value;
+        return;
+    }
+    if (mCurrentSlot < 0 || static_cast<size_t>(mCurrentSlot) >= TOUCH_MAX_SLOTS) {
+        return;
+    }
+    Slot& slot = mSlots[mCurrentSlot];
+    switch (event.code) {
+        case ABS_MT_TRACKING_ID:
+            slot.active = event.value >= 0;
+            slot.contact.trackingId = event.value;
+            break;
+        case ABS_MT_POSITION_X:
+            slot.contact.x = event.value;
+            break;
+        case ABS_MT_POSITION_Y:
+            slot.contact.y = event.value;
+            break;
+        case ABS_MT_PRESSURE:
+            slot.contact.pressure = event.value;
+            break;
+        case ABS_MT_TOUCH_MAJOR:
+            slot.contact.touchMajor = event.value;
+            break;
+    }
+}
+
+void TouchCoalescer::flush() {
+    if (mHaveHeld) {
+        report(mHeld);
+        mHaveHeld = false;
+    }
+}
+
+void TouchCoalescer::onDeadline(nsecs_t now) {
+    if (!mHaveHeld || now < mNextTarget) {
+        return;
+    }
+    // Nothing arrived past the target to resample against, so the held frame
+    // goes out with its own time.
+    flush();
+    mNextTarget = nextTargetAfter(now);
+}
+
+void TouchCoalescer::endFrame(nsecs_t when) {
+    TouchFrame frame;
+    frame.when = when;
+    for (size_t i = 0; i < TOUCH_MAX_SLOTS; ++i) {
+        if (mSlots[i].active) {
+            frame.contacts[frame.contactCount++] = mSlots[i].contact;
+        }
+    }
+    // Frames with nothing down after the last contact went up (key or button
+    // frames, say) carry nothing for the consumer.
+    if (frame.contactCount == 0 && mLastReported.contactCount == 0) {
+        return;
+    }
+
+    mFramesIn++;
+    coalesce(frame);
+    mPrevious = frame;
+}
+
+void TouchCoalescer::coalesce(const TouchFrame& frame) {
+    if (mConfig.period <= 0) {
+        report(frame);
+        return;
+    }
+
+    if (!sameContacts(frame, mLastReported)) {
+        flush();
+        report(frame);
+        mNextTarget = nextTargetAfter(frame.when);
+        return;
+    }
+
+    if (frame.when < mNextTarget) {
+        mHeld = frame;
+        mHaveHeld = true;
+        return;
+    }
+
+    mHaveHeld = false;
+    if (!mConfig.resample || mPrevious.when >= mNextTarget || frame.when <= mPrevious.when ||
+            !sameContacts(mPrevious, frame)) {
+        report(frame);
+    } else {
+        float alpha = float(mNextTarget - mPrevious.when) / float(frame.when - mPrevious.when);
+        TouchFrame resampled = frame;
+        resampled.when = mNextTarget;
+        resampled.resampled = true;
+        for (size_t i = 0; i < frame.contactCount; ++i) {
+            const TouchContact& a = mPrevious.contacts[i];
+            const TouchContact& b = frame.contacts[i];
+            TouchContact& out = resampled.contacts[i];
+            out.x = a.x + int32_t(lroundf((b.x - a.x) * alpha));
+            out.y = a.y + int32_t(lroundf((b.y - a.y) * alpha));
+        }
+        report(resampled);
+    }
+    mNextTarget = nextTargetAfter(frame.when);
+}
+
+void TouchCoalescer::report(const TouchFrame& frame) {
+    mFramesOut++;
+    mLastReported = frame;
+    mCallback(frame);
+}
+
+nsecs_t TouchCoalescer::nextTargetAfter(nsecs_t when) const {
+    nsecs_t offset = when - mConfig.phase;
+    nsecs_t periods = offset / mConfig.period;
+    if (offset < 0 && offset % mConfig.period != 0) {
+        periods--;
+    }
+    return mConfig.phase + (periods + 1) * mConfig.period;
+}
+
+bool TouchCoalescer::sameContacts(const TouchFrame& a, const TouchFrame& b) {
+    if (a.contactCount != b.contactCount) {
+        return false;
+    }
+    for (size_t i = 0; i < a.contactCount; ++i) {
+        if (a.contacts[i].slot != b.contacts[i].slot ||
+                a.contacts[i].trackingId != b.contacts[i].trackingId) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace android
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef ANDROID_TOUCH_COALESCER_H_
+#define ANDROID_TOUCH_COALESCER_H_
+
+#include <functional>
+
+#include <utils/Timers.h>
+
+#include "InputHub.h"
+
+namespace android {
+
+/** Slots beyond this many are ignored. */
+static constexpr size_t TOUCH_MAX_SLOTS = 16;
+
+struct TouchContact {
+    int32_t slot;
+    int32_t trackingId;
+    int32_t x;
+    int32_t y;
+    int32_t pressure;
+    int32_t touchMajor;
+};
+
+/** The contacts down at one point in time, in slot order. */
+struct TouchFrame {
+    nsecs_t when = 0;
+    // Whether the positions were interpolated to when rather than measured.
+    bool resampled = false;
+    size_t contactCount = 0;
+    TouchContact contacts[TOUCH_MAX_SLOTS];
+};
+
+struct TouchCoalescerConfig {
+    // Frames are reported at most once per period, at the targets
+    // phase + k * period, e.g. the display's vsync. 0 reports every frame.
+    nsecs_t period = 0;
+    nsecs_t phase = 0;
+    // Whether a frame reported at a target has its positions interpolated to
+    // the target from the frames on either side of it.
+    bool resample = true;
+};
+
+/**
+ * TouchCoalescer assembles the events of a multitouch (protocol B) device into
+ * TouchFrames, one per SYN_REPORT, and reports them at most at the rate the
+ * consumer can use.
+ *
+ * Frames that fall between two targets are held back, and only the latest is
+ * kept. The first frame at or after a target is reported with the target's
+ * time, its positions resampled to that time. A frame in which a contact goes
+ * down or up is never dropped: it is reported as soon as it arrives, after any
+ * frame that was held back. When no frame arrives by the next target, e.g.
+ * because the contacts stopped moving, the held frame is reported once
+ * onDeadline() is called at or after getNextDeadline().
+ */
+class TouchCoalescer {
+public:
+    using FrameCallback = std::function<void(const TouchFrame& frame)>;
+
+    TouchCoalescer(const TouchCoalescerConfig& config, FrameCallback callback);
+
+    void processEvent(const InputEvent& event);
+
+    /** Reports the frame being held back, if there is one. */
+    void flush();
+
+    /**
+     * Returns the time by which onDeadline() should be called to report the
+     * frame being held back, or -1 if no frame is held back.
+     */
+    nsecs_t getNextDeadline() const { return mHaveHeld ? mNextTarget : -1; }
+
+    /** Reports the frame being held back if its deadline has passed by now. */
+    void onDeadline(nsecs_t now);
+
+    uint64_t getFramesIn() const { return mFramesIn; }
+    uint64_t getFramesOut() const { return mFramesOut; }
+
+private:
+    struct Slot {
+        bool active = false;
+        TouchContact contact;
+    };
+
+    void endFrame(nsecs_t when);
+    void coalesce(const TouchFrame& frame);
+    void report(const TouchFrame& frame);
+    nsecs_t nextTargetAfter(nsecs_t when) const;
+    static bool sameContacts(const TouchFrame& a, const TouchFrame& b);
+
+    TouchCoalescerConfig mConfig;
+    FrameCallback mCallback;
+
+    Slot mSlots[TOUCH_MAX_SLOTS];
+    int32_t mCurrentSlot = 0;
+    // Set by SYN_DROPPED; the events up to the next SYN_REPORT are incomplete.
+    bool mDropping = false;
+
+    TouchFrame mPrevious;       // the last frame assembled
+    TouchFrame mLastReported;
+    TouchFrame mHeld;
+    bool mHaveHeld = false;
+    nsecs_t mNextTarget = 0;
+
+    uint64_t mFramesIn = 0;
+    uint64_t mFramesOut = 0;
+};
+
+}  // namespace android
+
+#endif  // ANDROID_TOUCH_COALESCER_H_
@@ -17,6 +17,7 @@
 #include <hardware/sensors.h>
 #include <algorithm>
 #include <pthread.h>
+#include <cutils/atomic.h>
 #include <cutils/log.h>
 
 #include "SensorEventQueue.h"
@@ -24,9 +25,11 @@
 SensorEventQueue::SensorEventQueue(int capacity) {
     mCapacity = capacity;
 
-    mStart = 0;
-    mSize = 0;
+    mReadPos = 0;
+    mWritePos = 0;
+    mWriterWaiting = 0;
     mData = new sensors_event_t[mCapacity];
+    pthread_mutex_init(&mSpaceAvailableMutex, NULL);
     pthread_cond_init(&mSpaceAvailableCondition, NULL);
 }
 
@@ -34,58 +37,79 @@ SensorEventQueue::~SensorEventQueue() {
     delete[] mData;
     mData = NULL;
     pthread_cond_destroy(&mSpaceAvailableCondition);
+    pthread_mutex_destroy(&mSpaceAvailableMutex);
 }
 
 int SensorEventQueue::getWritableRegion(int requestedLength, sensors_event_t** out) {
-    if (mSize == mCapacity || requestedLength <= 0) {
+    int size = getSize();
+    if (size == mCapacity || requestedLength <= 0) {
         *out = NULL;
         return 0;
     }
     // Start writing after the last readable record.
-    int firstWritable = (mStart + mSize) % mCapacity;
+    int firstWritable = indexOf(mWritePos);
 
-    int lastWritable = firstWritable + requestedLength - 1;
+    // Don't go past the end of the data array, or into the readable region.
+    int length = std::min(requestedLength, mCapacity - size);
+    length = std::min(length, mCapacity - firstWritable);
 
-    // Don't go past the end of the data array.
-    if (lastWritable > mCapacity - 1) {
-        lastWritable = mCapacity - 1;
-    }
-    // Don't go into the readable region.
-    if (firstWritable < mStart && lastWritable >= mStart) {
-        lastWritable = mStart - 1;
-    }
     *out = &mData[firstWritable];
-    return lastWritable - firstWritable + 1;
+    return length;
 }
 
 void SensorEventQueue::markAsWritten(int count) {
-    mSize += count;
+    int32_t pos = mWritePos + count;
+    if (pos >= 2 * mCapacity) {
+        pos -= 2 * mCapacity;
+    }
+    // Publish the records along with the new position.
+    android_atomic_release_store(pos, &mWritePos);
 }
 
 int SensorEventQueue::getSize() {
-    return mSize;
+    int32_t size = android_atomic_acquire_load(&mWritePos) -
+            android_atomic_acquire_load(&mReadPos);
+    if (size < 0) {
+        size += 2 * mCapacity;
+    }
+    return size;
 }
 
 sensors_event_t* SensorEventQueue::peek() {
-    if (mSize == 0) return NULL;
-    return &mData[mStart];
+    if (getSize() == 0) return NULL;
+    return &mData[indexOf(mReadPos)];
 }
 
 void SensorEventQueue::dequeue() {
-    if (mSize == 0) return;
-    if (mSize == mCapacity) {
+    if (getSize() == 0) return;
+    int32_t pos = mReadPos + 1;
+    if (pos == 2 * mCapacity) {
+        pos = 0;
+    }
+    android_atomic_release_store(pos, &mReadPos);
+
+    // Pairs with the barrier in waitForSpace(): either the writer sees the slot just freed,
+    // or we see that it is about to sleep.
+    android_memory_barrier();
+    if (android_atomic_acquire_load(&mWriterWaiting)) {
+        pthread_mutex_lock(&mSpaceAvailableMutex);
         pthread_cond_broadcast(&mSpaceAvailableCondition);
+        pthread_mutex_unlock(&mSpaceAvailableMutex);
     }
-    mSize--;
-    mStart = (mStart + 1) % mCapacity;
 }
 
 // returns true if it waited, or false if it was a no-op.
-bool SensorEventQueue::waitForSpace(pthread_mutex_t* mutex) {
-    bool waited = false;
-    while (mSize == mCapacity) {
-        waited = true;
-        pthread_cond_wait(&mSpaceAvailableCondition, mutex);
+bool SensorEventQueue::waitForSpace() {
+    if (getSize() < mCapacity) {
+        return false;
+    }
+    pthread_mutex_lock(&mSpaceAvailableMutex);
+    android_atomic_release_store(1, &mWriterWaiting);
+    android_memory_barrier();
+    while (getSize() == mCapacity) {
+        pthread_cond_wait(&mSpaceAvailableCondition, &mSpaceAvailableMutex);
     }
-    return waited;
+    android_atomic_release_store(0, &mWriterWaiting);
+    pthread_mutex_unlock(&mSpaceAvailableMutex);
+    return true;
 }
@@ -19,6 +19,7 @@
 
 #include <hardware/sensors.h>
 #include <pthread.h>
+#include <stdint.h>
 
 /*
  * Fixed-size circular queue, with an API developed around the sensor HAL poll() method.
@@ -27,16 +28,22 @@
  * write to, instead of using an intermediate buffer and a memcpy.
  *
  * Thread safety:
- * Reading can be done safely after grabbing the mutex lock, while poll() writing in a separate
- * thread without a mutex lock. But there can only be one writer at a time.
+ * Lock-free for exactly one writer thread and one reader thread. The writer owns the write
+ * position and the reader the read position; each publishes its own with a release store.
+ * Only a writer that finds the queue full takes the internal lock, to sleep.
  */
 class SensorEventQueue {
     int mCapacity;
-    int mStart; // start of readable region
-    int mSize; // number of readable items
+    // Positions run over [0, 2 * mCapacity), so a full queue can be told from an empty one.
+    volatile int32_t mReadPos; // written by the reader only
+    volatile int32_t mWritePos; // written by the writer only
+    volatile int32_t mWriterWaiting;
     sensors_event_t* mData;
+    pthread_mutex_t mSpaceAvailableMutex;
     pthread_cond_t mSpaceAvailableCondition;
 
+    int indexOf(int32_t pos) const { return pos < mCapacity ? pos : pos - mCapacity; }
+
 public:
     SensorEventQueue(int capacity);
     ~SensorEventQueue();
@@ -45,32 +52,33 @@ public:
     // writable space, it will return a region of at least one. Because it must return
     // a pointer to a contiguous region, it may return smaller regions as we approach the end of
     // the data array.
-    // Only call while holding the lock.
+    // Only call from the writer.
     // The region is not marked internally in any way. Subsequent calls may return overlapping
     // regions. This class expects there to be exactly one writer at a time.
     int getWritableRegion(int requestedLength, sensors_event_t** out);
 
     // After writing to the region returned by getWritableRegion(), call this to indicate how
-    // many records were actually written.
+    // many records were actually written. They become visible to the reader.
     // This increases size() by count.
-    // Only call while holding the lock.
+    // Only call from the writer.
     void markAsWritten(int count);
 
-    // Gets the number of readable records.
-    // Only call while holding the lock.
+    // Gets the number of readable records. Safe from either thread; the other side may change
+    // it at any time, but only the reader can make it smaller.
     int getSize();
 
     // Returns pointer to the first readable record, or NULL if size() is zero.
-    // Only call this while holding the lock.
+    // Only call from the reader.
     sensors_event_t* peek();
 
     // This will decrease the size by one, freeing up the oldest readable event's slot for writing.
-    // Only call while holding the lock.
+    // Only call from the reader.
     void dequeue();
 
     // Blocks until space is available. No-op if there is already space.
     // Returns true if it had to wait.
-    bool waitForSpace(pthread_mutex_t* mutex);
+    // Only call from the writer.
+    bool waitForSpace();
 };
 
 #endif // SENSOREVENTQUEUE_H_
@@ -43,12 +43,13 @@ static const int MAX_CONF_LINE_LENGTH = 1024;
 static pthread_mutex_t init_modules_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t init_sensors_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-// This mutex is shared by all queues
+// The queues themselves are lock-free. This mutex only guards the multihal poll()
+// going to sleep on data_available_cond.
 static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 // Used to pause the multihal poll(). Broadcasted by sub-polling tasks if waiting_for_data.
 static pthread_cond_t data_available_cond = PTHREAD_COND_INITIALIZER;
-bool waiting_for_data = false;
+static volatile int32_t waiting_for_data = 0;
 
 /*
  * Vector of sub modules, whose indexes are referred to in this file as module_index.
@@ -79,7 +80,18 @@ struct FullHandle {
     }
 };
 
-std::map<int, FullHandle> global_to_full;
+/*
+ * Global handles are handed out densely from 1, so global_to_full is indexed by global handle;
+ * entry 0 is unused.
+ * Every event is remapped from a local handle, so the reverse lookup is flat too: per module,
+ * indexed by local handle, holding -1 for unknown handles. Sub-HALs number their sensors from
+ * small integers; a local handle outside [0, MAX_FLAT_LOCAL_HANDLE) falls back to
+ * full_to_global.
+ */
+static const int MAX_FLAT_LOCAL_HANDLE = 256;
+
+std::vector<FullHandle> global_to_full(1);
+std::vector<std::vector<int> > local_to_global;
 std::map<FullHandle, int> full_to_global;
 int next_global_handle = 1;
 
@@ -88,39 +100,67 @@ static int assign_global_handle(int module_index, int local_handle) {
     FullHandle full_handle;
     full_handle.moduleIndex = module_index;
     full_handle.localHandle = local_handle;
-    full_to_global[full_handle] = global_handle;
-    global_to_full[global_handle] = full_handle;
+    global_to_full.push_back(full_handle);
+    if (local_handle >= 0 && local_handle < MAX_FLAT_LOCAL_HANDLE) {
+        if ((int)local_to_global.size() <= module_index) {
+            local_to_global.resize(module_index + 1);
+        }
+        std::vector<int>& flat = local_to_global[module_index];
+        if ((int)flat.size() <= local_handle) {
+            flat.resize(local_handle + 1, -1);
+        }
+        flat[local_handle] = global_handle;
+    } else {
+        full_to_global[full_handle] = global_handle;
+    }
     return global_handle;
 }
 
-// Returns the local handle, or -1 if it does not exist.
-static int get_local_handle(int global_handle) {
-    if (global_to_full.count(global_handle) == 0) {
+// Returns the FullHandle, or NULL if the global handle does not exist.
+static const FullHandle* get_full_handle(int global_handle) {
+    if (global_handle <= 0 || global_handle >= (int)global_to_full.size()) {
         ALOGW("Unknown global_handle %d", global_handle);
-        return -1;
+        return NULL;
     }
-    return global_to_full[global_handle].localHandle;
+    return &global_to_full[global_handle];
+}
+
+// Returns the local handle, or -1 if it does not exist.
+static int get_local_handle(int global_handle) {
+    const FullHandle* f = get_full_handle(global_handle);
+    return f != NULL ? f->localHandle : -1;
 }
 
 // Returns the sub_hw_modules index of the module that contains the sensor associates with this
 // global_handle, or -1 if that global_handle does not exist.
 static int get_module_index(int global_handle) {
-    if (global_to_full.count(global_handle) == 0) {
-        ALOGW("Unknown global_handle %d", global_handle);
+    const FullHandle* f = get_full_handle(global_handle);
+    if (f == NULL) {
         return -1;
     }
-    FullHandle f = global_to_full[global_handle];
     ALOGV("FullHandle for global_handle %d: moduleIndex %d, localHandle %d",
-            global_handle, f.moduleIndex, f.localHandle);
-    return f.moduleIndex;
+            global_handle, f->moduleIndex, f->localHandle);
+    return f->moduleIndex;
 }
 
 // Returns the global handle for this full_handle, or -1 if the full_handle is unknown.
 static int get_global_handle(FullHandle* full_handle) {
     int global_handle = -1;
-    if (full_to_global.count(*full_handle)) {
-        global_handle = full_to_global[*full_handle];
+    int local_handle = full_handle->localHandle;
+    if (local_handle >= 0 && local_handle < MAX_FLAT_LOCAL_HANDLE) {
+        if (full_handle->moduleIndex < (int)local_to_global.size()) {
+            const std::vector<int>& flat = local_to_global[full_handle->moduleIndex];
+            if (local_handle < (int)flat.size()) {
+                global_handle = flat[local_handle];
+            }
+        }
     } else {
+        std::map<FullHandle, int>::const_iterator it = full_to_global.find(*full_handle);
+        if (it != full_to_global.end()) {
+            global_handle = it->second;
+        }
+    }
+    if (global_handle == -1) {
         ALOGW("Unknown FullHandle: moduleIndex %d, localHandle %d",
             full_handle->moduleIndex, full_handle->localHandle);
     }
@@ -142,28 +182,29 @@ void *writerTask(void* ptr) {
     sensors_event_t* buffer;
     int eventsPolled;
     while (1) {
-        pthread_mutex_lock(&queue_mutex);
-        if (queue->waitForSpace(&queue_mutex)) {
+        if (queue->waitForSpace()) {
             ALOGV("writerTask waited for space");
         }
         int bufferSize = queue->getWritableRegion(SENSOR_EVENT_QUEUE_CAPACITY, &buffer);
-        // Do blocking poll outside of lock
-        pthread_mutex_unlock(&queue_mutex);
 
         ALOGV("writerTask before poll() - bufferSize = %d", bufferSize);
         eventsPolled = device->poll(device, buffer, bufferSize);
         ALOGV("writerTask poll() got %d events.", eventsPolled);
-        if (eventsPolled == 0) {
+        if (eventsPolled <= 0) {
             continue;
         }
-        pthread_mutex_lock(&queue_mutex);
         queue->markAsWritten(eventsPolled);
         ALOGV("writerTask wrote %d events", eventsPolled);
-        if (waiting_for_data) {
+
+        // Pairs with the barrier in wait_for_data(): either poll() sees these events,
+        // or we see that it is about to sleep.
+        android_memory_barrier();
+        if (android_atomic_acquire_load(&waiting_for_data)) {
             ALOGV("writerTask - broadcast data_available_cond");
+            pthread_mutex_lock(&queue_mutex);
             pthread_cond_broadcast(&data_available_cond);
+            pthread_mutex_unlock(&queue_mutex);
         }
-        pthread_mutex_unlock(&queue_mutex);
     }
     // never actually returns
     return NULL;
@@ -198,13 +239,18 @@ struct sensors_poll_context_t {
     std::vector<hw_device_t*> sub_hw_devices;
     std::vector<SensorEventQueue*> queues;
     std::vector<pthread_t> threads;
-    int nextReadIndex;
+
+    // Scratch for poll(): events readable in each queue, and each queue's oldest event.
+    std::vector<int> readable;
+    std::vector<sensors_event_t*> heads;
 
     sensors_poll_device_t* get_v0_device_by_handle(int global_handle);
     sensors_poll_device_1_t* get_v1_device_by_handle(int global_handle);
     int get_device_version_by_handle(int global_handle);
 
     void copy_event_remap_handle(sensors_event_t* src, sensors_event_t* dest, int sub_index);
+    int merge_queues(sensors_event_t* data, int maxReads);
+    void wait_for_data();
 };
 
 void sensors_poll_context_t::addSubHwDevice(struct hw_device_t* sub_hw_device) {
@@ -213,6 +259,8 @@ void sensors_poll_context_t::addSubHwDevice(struct hw_device_t* sub_hw_device) {
 
     SensorEventQueue *queue = new SensorEventQueue(SENSOR_EVENT_QUEUE_CAPACITY);
     this->queues.push_back(queue);
+    this->readable.push_back(0);
+    this->heads.push_back(NULL);
 
     TaskContext* taskContext = new TaskContext();
     taskContext->device = (sensors_poll_device_t*) sub_hw_device;
@@ -327,43 +375,79 @@ void sensors_poll_context_t::copy_event_remap_handle(sensors_event_t* dest, sens
     }
 }
 
+/*
+ * Moves up to maxReads events from the queues into data, oldest timestamp first. This is a
+ * k-way merge over the queue heads; each queue stays in the order its sub-HAL produced, so
+ * meta-data events still follow the events they complete.
+ * Returns the number of events read, which is zero if the queues were all empty.
+ */
+int sensors_poll_context_t::merge_queues(sensors_event_t* data, int maxReads) {
+    int queueCount = (int)this->queues.size();
+    int pending = 0;
+    int eventsRead = 0;
+
+    // Only merge what is readable now, so a busy sub-HAL cannot keep poll() from returning.
+    for (int i = 0; i < queueCount; i++) {
+        this->readable[i] = this->queues[i]->getSize();
+        this->heads[i] = this->readable[i] > 0 ? this->queues[i]->peek() : NULL;
+        pending += this->readable[i];
+    }
+
+    while (pending > 0 && eventsRead < maxReads) {
+        int oldest = -1;
+        for (int i = 0; i < queueCount; i++) {
+            if (this->heads[i] != NULL && (oldest < 0 ||
+                    this->heads[i]->timestamp < this->heads[oldest]->timestamp)) {
+                oldest = i;
+            }
+        }
+
+        SensorEventQueue* queue = this->queues[oldest];
+        this->copy_event_remap_handle(&data[eventsRead], this->heads[oldest], oldest);
+        if (data[eventsRead].sensor == -1) {
+            // Bad handle, do not pass corrupted event upstream !
+            ALOGW("Dropping bad local handle event packet on the floor");
+        } else {
+            eventsRead++;
+        }
+        queue->dequeue();
+        pending--;
+        this->heads[oldest] = --this->readable[oldest] > 0 ? queue->peek() : NULL;
+    }
+    return eventsRead;
+}
+
+// Blocks until at least one queue has data.
+void sensors_poll_context_t::wait_for_data() {
+    ALOGV("poll stopping to wait for data");
+    pthread_mutex_lock(&queue_mutex);
+    android_atomic_release_store(1, &waiting_for_data);
+    android_memory_barrier();
+    for (;;) {
+        bool empty = true;
+        for (size_t i = 0; i < this->queues.size() && empty; i++) {
+            empty = this->queues[i]->getSize() == 0;
+        }
+        if (!empty) {
+            break;
+        }
+        pthread_cond_wait(&data_available_cond, &queue_mutex);
+    }
+    android_atomic_release_store(0, &waiting_for_data);
+    pthread_mutex_unlock(&queue_mutex);
+}
+
 int sensors_poll_context_t::poll(sensors_event_t *data, int maxReads) {
     ALOGV("poll");
-    int empties = 0;
-    int queueCount = 0;
     int eventsRead = 0;
 
-    pthread_mutex_lock(&queue_mutex);
-    queueCount = (int)this->queues.size();
     while (eventsRead == 0) {
-        while (empties < queueCount && eventsRead < maxReads) {
-            SensorEventQueue* queue = this->queues.at(this->nextReadIndex);
-            sensors_event_t* event = queue->peek();
-            if (event == NULL) {
-                empties++;
-            } else {
-                empties = 0;
-                this->copy_event_remap_handle(&data[eventsRead], event, nextReadIndex);
-                if (data[eventsRead].sensor == -1) {
-                    // Bad handle, do not pass corrupted event upstream !
-                    ALOGW("Dropping bad local handle event packet on the floor");
-                } else {
-                    eventsRead++;
-                }
-                queue->dequeue();
-            }
-            this->nextReadIndex = (this->nextReadIndex + 1) % queueCount;
-        }
+        eventsRead = this->merge_queues(data, maxReads);
         if (eventsRead == 0) {
             // The queues have been scanned and none contain data, so wait.
-            ALOGV("poll stopping to wait for data");
-            waiting_for_data = true;
-            pthread_cond_wait(&data_available_cond, &queue_mutex);
-            waiting_for_data = false;
-            empties = 0;
+            this->wait_for_data();
         }
     }
-    pthread_mutex_unlock(&queue_mutex);
     ALOGV("poll returning %d events.", eventsRead);
 
     return eventsRead;
@@ -660,8 +744,6 @@ static int open_sensors(const struct hw_module_t* hw_module, const char* name,
     dev->proxy_device.batch = device__batch;
     dev->proxy_device.flush = device__flush;
 
-    dev->nextReadIndex = 0;
-
     // Open() the subhal modules. Remember their devices in a vector parallel to sub_hw_modules.
     for (std::vector<hw_module_t*>::iterator it = sub_hw_modules->begin();
             it != sub_hw_modules->end(); it++) {
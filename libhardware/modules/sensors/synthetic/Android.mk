@@ -0,0 +1,49 @@
+# Copyright (C) 2016 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+LOCAL_PATH := $(call my-dir)
+
+# Synthetic sub-HAL for the sensors multihal, configured from
+# /system/etc/sensors/synthetic.conf
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := sensors.synthetic
+LOCAL_MODULE_RELATIVE_PATH := hw
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CFLAGS := -DLOG_TAG=\"SyntheticSensors\" -Wno-missing-field-initializers
+
+LOCAL_SRC_FILES := \
+    SyntheticSensors.cpp \
+    module.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+    libcutils \
+    liblog
+
+include $(BUILD_SHARED_LIBRARY)
+
+# The same, without the module symbol, for host load tests of the multihal.
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := libsensors_synthetic_host
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CFLAGS := -DLOG_TAG=\"SyntheticSensors\"
+
+LOCAL_SRC_FILES := SyntheticSensors.cpp
+
+LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH)
+
+include $(BUILD_HOST_STATIC_LIBRARY)
@@ -0,0 +1,607 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+
+#include <cutils/log.h>
+
+#include "SyntheticSensors.h"
+
+static const int64_t MIN_PERIOD_NS = 50000; // 20 kHz, also reported as minDelay
+static const int64_t MAX_PERIOD_NS = 1000000000;
+static const int MAX_CONF_LINE_LENGTH = 1024;
+
+struct synthetic_sensor_state_t {
+    bool enabled;
+    int64_t period_ns;
+    int64_t max_latency_ns;
+    int64_t next_sample_ns; // generated sensors only
+    uint64_t sample_count;
+    int pending_flushes;
+
+    // FIFO of samples not yet delivered, oldest at head.
+    sensors_event_t* fifo;
+    uint32_t capacity;
+    uint32_t head;
+    uint32_t count;
+};
+
+struct synthetic_sensors_device_t {
+    sensors_poll_device_1 device; // must be first
+
+    synthetic_sensors_module_t* module;
+    pthread_mutex_t lock;
+    pthread_cond_t cond; // signalled when poll() may have something new to do
+    synthetic_sensor_state_t sensors[SYNTHETIC_SENSORS_MAX_SENSORS];
+
+    // Replay position: next capture record, and the offset that maps capture time to now.
+    size_t replay_next;
+    int64_t replay_offset_ns;
+    bool replay_started;
+
+    synthetic_sensors_stats_t stats;
+};
+
+static int64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*****************************************************************************/
+
+bool synthetic_capture_write_header(FILE* file) {
+    synthetic_capture_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SYNTHETIC_CAPTURE_MAGIC;
+    header.version = SYNTHETIC_CAPTURE_VERSION;
+    header.event_size = sizeof(sensors_event_t);
+    return fwrite(&header, sizeof(header), 1, file) == 1;
+}
+
+ssize_t synthetic_capture_read(const char* path, sensors_event_t** events) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        ALOGE("Cannot open capture %s: %s", path, strerror(errno));
+        return -errno;
+    }
+
+    synthetic_capture_header_t header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+            header.magic != SYNTHETIC_CAPTURE_MAGIC ||
+            header.version != SYNTHETIC_CAPTURE_VERSION ||
+            header.event_size != sizeof(sensors_event_t)) {
+        ALOGE("%s is not a capture this build can read", path);
+        fclose(file);
+        return -EINVAL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file) - (long)sizeof(header);
+    fseek(file, sizeof(header), SEEK_SET);
+    size_t count = size > 0 ? size / sizeof(sensors_event_t) : 0;
+
+    *events = new sensors_event_t[count];
+    count = fread(*events, sizeof(sensors_event_t), count, file);
+    fclose(file);
+    return count;
+}
+
+/*****************************************************************************/
+
+static void init_sensor(struct sensor_t* sensor, int handle, int type, uint32_t fifo) {
+    memset(sensor, 0, sizeof(*sensor));
+    sensor->name = "Synthetic Sensor";
+    sensor->vendor = "The Android Open Source Project";
+    sensor->version = 1;
+    sensor->handle = handle;
+    sensor->type = type;
+    sensor->maxRange = 1000.0f;
+    sensor->resolution = 1.0f;
+    sensor->power = 0.1f;
+    sensor->minDelay = MIN_PERIOD_NS / 1000;
+    sensor->fifoReservedEventCount = fifo;
+    sensor->fifoMaxEventCount = fifo;
+    sensor->maxDelay = MAX_PERIOD_NS / 1000;
+    sensor->flags = SENSOR_FLAG_CONTINUOUS_MODE;
+}
+
+static bool compare_timestamps(const sensors_event_t& a, const sensors_event_t& b) {
+    return a.timestamp < b.timestamp;
+}
+
+// Loads the capture and lists the sensors in it, renumbering the records' handles to match.
+static int load_replay(synthetic_sensors_module_t* module) {
+    sensors_event_t* events;
+    ssize_t count = synthetic_capture_read(module->config.replay_path, &events);
+    if (count < 0) {
+        return count;
+    }
+
+    int captured_handles[SYNTHETIC_SENSORS_MAX_SENSORS];
+    size_t kept = 0;
+    for (ssize_t i = 0; i < count; i++) {
+        sensors_event_t* ev = &events[i];
+        // Flush completions are the consumer's business, not data to replay.
+        if (ev->type == SENSOR_TYPE_META_DATA) {
+            continue;
+        }
+        int index = 0;
+        while (index < module->sensor_count && captured_handles[index] != ev->sensor) {
+            index++;
+        }
+        if (index == module->sensor_count) {
+            if (index == SYNTHETIC_SENSORS_MAX_SENSORS) {
+                ALOGW("Capture has more than %d sensors; skipping handle %d",
+                        SYNTHETIC_SENSORS_MAX_SENSORS, ev->sensor);
+                continue;
+            }
+            captured_handles[index] = ev->sensor;
+            init_sensor(&module->sensors[index], index + 1, ev->type,
+                    module->config.replay_fifo_max_event_count);
+            module->sensor_count++;
+        }
+        events[kept] = *ev;
+        events[kept].sensor = index + 1;
+        kept++;
+    }
+    std::stable_sort(events, events + kept, compare_timestamps);
+
+    module->replay_events = events;
+    module->replay_count = kept;
+    ALOGI("Replaying %zu events of %d sensors from %s", kept, module->sensor_count,
+            module->config.replay_path);
+    return 0;
+}
+
+// Call with module->lock held.
+static int configure_locked(synthetic_sensors_module_t* module,
+        const synthetic_sensors_config_t* config) {
+    module->config = *config;
+    module->sensor_count = 0;
+    module->replay_events = NULL;
+    module->replay_count = 0;
+    module->configured = true;
+
+    if (config->replay_path != NULL) {
+        return load_replay(module);
+    }
+    for (int i = 0; i < config->sensor_count && i < SYNTHETIC_SENSORS_MAX_SENSORS; i++) {
+        init_sensor(&module->sensors[i], i + 1, config->sensors[i].type,
+                config->sensors[i].fifo_max_event_count);
+        module->sensor_count++;
+    }
+    return 0;
+}
+
+static void load_config_file(synthetic_sensors_config_t* config) {
+    memset(config, 0, sizeof(*config));
+
+    FILE* file = fopen(SYNTHETIC_SENSORS_CONFIG_FILENAME, "r");
+    if (file == NULL) {
+        ALOGW("No synthetic sensors config file found at %s", SYNTHETIC_SENSORS_CONFIG_FILENAME);
+        return;
+    }
+    char line[MAX_CONF_LINE_LENGTH];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char path[MAX_CONF_LINE_LENGTH];
+        char loop[8];
+        int type;
+        int rate;
+        unsigned fifo;
+
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        if (sscanf(line, "sensor %d %d %u", &type, &rate, &fifo) == 3 && rate > 0) {
+            if (config->sensor_count < SYNTHETIC_SENSORS_MAX_SENSORS) {
+                synthetic_sensor_config_t* sensor = &config->sensors[config->sensor_count++];
+                sensor->type = type;
+                sensor->period_ns = 1000000000LL / rate;
+                sensor->fifo_max_event_count = fifo;
+            }
+        } else if (sscanf(line, "replay %s %u %7s", path, &fifo, loop) >= 2) {
+            config->replay_path = strdup(path);
+            config->replay_fifo_max_event_count = fifo;
+            config->replay_loop = sscanf(line, "replay %*s %*u %7s", loop) == 1 &&
+                    strcmp(loop, "loop") == 0;
+        } else {
+            ALOGW("Ignoring synthetic sensors config line: %s", line);
+        }
+    }
+    fclose(file);
+}
+
+// Configures a module loaded as a library, from its config file, on first use.
+static void lazy_configure(synthetic_sensors_module_t* module) {
+    pthread_mutex_lock(&module->lock);
+    if (!module->configured) {
+        synthetic_sensors_config_t config;
+        load_config_file(&config);
+        configure_locked(module, &config);
+    }
+    pthread_mutex_unlock(&module->lock);
+}
+
+int synthetic_sensors_get_sensors_list(struct sensors_module_t* module,
+        struct sensor_t const** list) {
+    synthetic_sensors_module_t* m = (synthetic_sensors_module_t*) module;
+    lazy_configure(m);
+    *list = m->sensors;
+    return m->sensor_count;
+}
+
+int synthetic_sensors_module_init(synthetic_sensors_module_t* module,
+        const synthetic_sensors_config_t* config) {
+    memset(module, 0, sizeof(*module));
+    module->base.common.tag = HARDWARE_MODULE_TAG;
+    module->base.common.version_major = 1;
+    module->base.common.version_minor = 0;
+    module->base.common.id = SENSORS_HARDWARE_MODULE_ID;
+    module->base.common.name = "Synthetic Sensor Module";
+    module->base.common.author = "The Android Open Source Project";
+    module->base.common.methods = &synthetic_sensors_module_methods;
+    module->base.get_sensors_list = synthetic_sensors_get_sensors_list;
+    pthread_mutex_init(&module->lock, NULL);
+
+    pthread_mutex_lock(&module->lock);
+    int err = configure_locked(module, config);
+    pthread_mutex_unlock(&module->lock);
+    return err;
+}
+
+void synthetic_sensors_get_stats(synthetic_sensors_module_t* module,
+        synthetic_sensors_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+    pthread_mutex_lock(&module->lock);
+    synthetic_sensors_device_t* dev = module->device;
+    if (dev != NULL) {
+        pthread_mutex_lock(&dev->lock);
+        *stats = dev->stats;
+        pthread_mutex_unlock(&dev->lock);
+    }
+    pthread_mutex_unlock(&module->lock);
+}
+
+/*****************************************************************************/
+
+// Returns the state of a local handle, or NULL if there is no such sensor.
+static synthetic_sensor_state_t* get_sensor(synthetic_sensors_device_t* dev, int handle) {
+    if (handle < 1 || handle > dev->module->sensor_count) {
+        return NULL;
+    }
+    return &dev->sensors[handle - 1];
+}
+
+// Appends a sample, overwriting the oldest one if the FIFO is full.
+static void push_sample(synthetic_sensors_device_t* dev, synthetic_sensor_state_t* s,
+        const sensors_event_t* ev) {
+    if (s->count == s->capacity) {
+        s->head = (s->head + 1) % s->capacity;
+        s->count--;
+        dev->stats.dropped++;
+    }
+    s->fifo[(s->head + s->count) % s->capacity] = *ev;
+    s->count++;
+    dev->stats.generated++;
+}
+
+// Moves every sample due by now into the FIFOs.
+static void generate_samples(synthetic_sensors_device_t* dev, int64_t now) {
+    synthetic_sensors_module_t* module = dev->module;
+
+    if (module->replay_events != NULL) {
+        while (dev->replay_started && dev->replay_next < module->replay_count) {
+            sensors_event_t ev = module->replay_events[dev->replay_next];
+            ev.timestamp += dev->replay_offset_ns;
+            if (ev.timestamp > now) {
+                break;
+            }
+            synthetic_sensor_state_t* s = &dev->sensors[ev.sensor - 1];
+            if (s->enabled) {
+                push_sample(dev, s, &ev);
+            }
+            if (++dev->replay_next == module->replay_count && module->config.replay_loop) {
+                // Start over one average sample spacing after the last record.
+                int64_t first = module->replay_events[0].timestamp;
+                int64_t last = module->replay_events[module->replay_count - 1].timestamp;
+                dev->replay_offset_ns += last - first +
+                        std::max((last - first) / (int64_t)module->replay_count, MIN_PERIOD_NS);
+                dev->replay_next = 0;
+            }
+        }
+        return;
+    }
+
+    for (int i = 0; i < module->sensor_count; i++) {
+        synthetic_sensor_state_t* s = &dev->sensors[i];
+        if (!s->enabled) {
+            continue;
+        }
+        while (s->next_sample_ns <= now) {
+            sensors_event_t ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.version = sizeof(sensors_event_t);
+            ev.sensor = i + 1;
+            ev.type = module->sensors[i].type;
+            ev.timestamp = s->next_sample_ns;
+            ev.data[0] = (float)s->sample_count++;
+            push_sample(dev, s, &ev);
+            s->next_sample_ns += s->period_ns;
+        }
+    }
+}
+
+// A sensor's FIFO is reported once it is full, once its oldest sample has waited the max
+// report latency, or on flush. Unbatched sensors report every sample straight away.
+static bool is_deliverable(const synthetic_sensor_state_t* s, int64_t now) {
+    if (s->pending_flushes > 0) {
+        return true;
+    }
+    if (s->count == 0) {
+        return false;
+    }
+    return s->max_latency_ns == 0 || s->count == s->capacity ||
+            s->fifo[s->head].timestamp + s->max_latency_ns <= now;
+}
+
+static int collect_events(synthetic_sensors_device_t* dev, sensors_event_t* data, int count,
+        int64_t now) {
+    int written = 0;
+    for (int i = 0; i < dev->module->sensor_count && written < count; i++) {
+        synthetic_sensor_state_t* s = &dev->sensors[i];
+        if (!is_deliverable(s, now)) {
+            continue;
+        }
+        while (s->count > 0 && written < count) {
+            data[written++] = s->fifo[s->head];
+            s->head = (s->head + 1) % s->capacity;
+            s->count--;
+            dev->stats.delivered++;
+        }
+        // A flush completes after everything that was in the FIFO.
+        while (s->count == 0 && s->pending_flushes > 0 && written < count) {
+            sensors_meta_data_event_t* meta = &data[written++];
+            memset(meta, 0, sizeof(*meta));
+            meta->version = META_DATA_VERSION;
+            meta->type = SENSOR_TYPE_META_DATA;
+            meta->meta_data.what = META_DATA_FLUSH_COMPLETE;
+            meta->meta_data.sensor = i + 1;
+            s->pending_flushes--;
+            dev->stats.flushes++;
+        }
+    }
+    return written;
+}
+
+// Earliest time something may become deliverable, or -1 if nothing will until we are signalled.
+static int64_t next_deadline(synthetic_sensors_device_t* dev) {
+    synthetic_sensors_module_t* module = dev->module;
+    int64_t deadline = -1;
+
+    if (module->replay_events != NULL) {
+        if (dev->replay_started && dev->replay_next < module->replay_count) {
+            deadline = module->replay_events[dev->replay_next].timestamp + dev->replay_offset_ns;
+        }
+        // Batched samples already in a FIFO still fall due on their own.
+    }
+
+    for (int i = 0; i < module->sensor_count; i++) {
+        synthetic_sensor_state_t* s = &dev->sensors[i];
+        if (!s->enabled) {
+            continue;
+        }
+        int64_t due;
+        if (module->replay_events != NULL) {
+            if (s->count == 0 || s->max_latency_ns == 0) {
+                continue;
+            }
+            due = s->fifo[s->head].timestamp + s->max_latency_ns;
+        } else if (s->max_latency_ns == 0) {
+            due = s->next_sample_ns;
+        } else {
+            // Sleep through the batch: until the oldest sample times out, or the FIFO fills.
+            int64_t oldest = s->count > 0 ? s->fifo[s->head].timestamp : s->next_sample_ns;
+            int64_t full = s->next_sample_ns +
+                    (int64_t)(s->capacity - s->count - 1) * s->period_ns;
+            due = std::min(oldest + s->max_latency_ns, full);
+        }
+        if (deadline < 0 || due < deadline) {
+            deadline = due;
+        }
+    }
+    return deadline;
+}
+
+static int synthetic_poll(struct sensors_poll_device_t* device, sensors_event_t* data,
+        int count) {
+    synthetic_sensors_device_t* dev = (synthetic_sensors_device_t*) device;
+    int written = 0;
+
+    pthread_mutex_lock(&dev->lock);
+    while (written == 0) {
+        int64_t now = now_ns();
+        generate_samples(dev, now);
+        written = collect_events(dev, data, count, now);
+        if (written > 0) {
+            break;
+        }
+
+        int64_t deadline = next_deadline(dev);
+        if (deadline < 0) {
+            pthread_cond_wait(&dev->cond, &dev->lock);
+        } else {
+            struct timespec ts;
+            ts.tv_sec = deadline / 1000000000LL;
+            ts.tv_nsec = deadline % 1000000000LL;
+            pthread_cond_timedwait(&dev->cond, &dev->lock, &ts);
+        }
+    }
+    pthread_mutex_unlock(&dev->lock);
+    return written;
+}
+
+static int synthetic_activate(struct sensors_poll_device_t* device, int handle, int enabled) {
+    synthetic_sensors_device_t* dev = (synthetic_sensors_device_t*) device;
+    int err = 0;
+
+    pthread_mutex_lock(&dev->lock);
+    synthetic_sensor_state_t* s = get_sensor(dev, handle);
+    if (s == NULL) {
+        err = -EINVAL;
+    } else if (enabled && !s->enabled) {
+        int64_t now = now_ns();
+        s->enabled = true;
+        s->next_sample_ns = now + s->period_ns;
+        if (dev->module->replay_count > 0 && !dev->replay_started) {
+            dev->replay_offset_ns = now - dev->module->replay_events[0].timestamp;
+            dev->replay_started = true;
+        }
+        pthread_cond_signal(&dev->cond);
+    } else if (!enabled) {
+        // Whatever was batched is lost, as on hardware.
+        s->enabled = false;
+        s->count = 0;
+        s->pending_flushes = 0;
+    }
+    pthread_mutex_unlock(&dev->lock);
+    return err;
+}
+
+static int synthetic_set_delay(struct sensors_poll_device_t* device, int handle, int64_t ns) {
+    synthetic_sensors_device_t* dev = (synthetic_sensors_device_t*) device;
+    int err = 0;
+
+    pthread_mutex_lock(&dev->lock);
+    synthetic_sensor_state_t* s = get_sensor(dev, handle);
+    if (s == NULL) {
+        err = -EINVAL;
+    } else {
+        s->period_ns = std::max(MIN_PERIOD_NS, std::min(ns, MAX_PERIOD_NS));
+        pthread_cond_signal(&dev->cond);
+    }
+    pthread_mutex_unlock(&dev->lock);
+    return err;
+}
+
+static int synthetic_batch(struct sensors_poll_device_1* device, int handle, int flags,
+        int64_t period_ns, int64_t timeout) {
+    synthetic_sensors_device_t* dev = (synthetic_sensors_device_t*) device;
+    int err = 0;
+
+    pthread_mutex_lock(&dev->lock);
+    synthetic_sensor_state_t* s = get_sensor(dev, handle);
+    if (s == NULL) {
+        err = -EINVAL;
+    } else if (!(flags & SENSORS_BATCH_DRY_RUN)) {
+        s->period_ns = std::max(MIN_PERIOD_NS, std::min(period_ns, MAX_PERIOD_NS));
+        // Without a FIFO, batching quietly degrades to continuous reporting.
+        bool hasFifo = dev->module->sensors[handle - 1].fifoMaxEventCount > 0;
+        s->max_latency_ns = hasFifo ? std::max(timeout, (int64_t)0) : 0;
+        pthread_cond_signal(&dev->cond);
+    }
+    pthread_mutex_unlock(&dev->lock);
+    return err;
+}
+
+static int synthetic_flush(struct sensors_poll_device_1* device, int handle) {
+    synthetic_sensors_device_t* dev = (synthetic_sensors_device_t*) device;
+    int err = 0;
+
+    pthread_mutex_lock(&dev->lock);
+    synthetic_sensor_state_t* s = get_sensor(dev, handle);
+    if (s == NULL || !s->enabled) {
+        err = -EINVAL;
+    } else {
+        s->pending_flushes++;
+        pthread_cond_signal(&dev->cond);
+    }
+    pthread_mutex_unlock(&dev->lock);
+    return err;
+}
+
+static int synthetic_close(struct hw_device_t* device) {
+    synthetic_sensors_device_t* dev = (synthetic_sensors_device_t*) device;
+    synthetic_sensors_module_t* module = dev->module;
+
+    pthread_mutex_lock(&module->lock);
+    module->device = NULL;
+    pthread_mutex_unlock(&module->lock);
+
+    for (int i = 0; i < SYNTHETIC_SENSORS_MAX_SENSORS; i++) {
+        delete[] dev->sensors[i].fifo;
+    }
+    pthread_cond_destroy(&dev->cond);
+    pthread_mutex_destroy(&dev->lock);
+    delete dev;
+    return 0;
+}
+
+static int synthetic_open(const struct hw_module_t* hw_module, const char* name,
+        struct hw_device_t** device) {
+    synthetic_sensors_module_t* module = (synthetic_sensors_module_t*) hw_module;
+
+    if (strcmp(name, SENSORS_HARDWARE_POLL) != 0) {
+        return -EINVAL;
+    }
+    lazy_configure(module);
+
+    synthetic_sensors_device_t* dev = new synthetic_sensors_device_t();
+    memset(dev, 0, sizeof(*dev));
+    dev->device.common.tag = HARDWARE_DEVICE_TAG;
+    dev->device.common.version = SENSORS_DEVICE_API_VERSION_1_3;
+    dev->device.common.module = const_cast<hw_module_t*>(hw_module);
+    dev->device.common.close = synthetic_close;
+    dev->device.activate = synthetic_activate;
+    dev->device.setDelay = synthetic_set_delay;
+    dev->device.poll = synthetic_poll;
+    dev->device.batch = synthetic_batch;
+    dev->device.flush = synthetic_flush;
+    dev->module = module;
+
+    pthread_mutex_init(&dev->lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&dev->cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    for (int i = 0; i < module->sensor_count; i++) {
+        synthetic_sensor_state_t* s = &dev->sensors[i];
+        s->capacity = std::max(module->sensors[i].fifoMaxEventCount, (uint32_t)1);
+        s->fifo = new sensors_event_t[s->capacity];
+        s->period_ns = module->replay_events == NULL ? module->config.sensors[i].period_ns
+                : MIN_PERIOD_NS;
+        s->period_ns = std::max(MIN_PERIOD_NS, std::min(s->period_ns, MAX_PERIOD_NS));
+    }
+
+    pthread_mutex_lock(&module->lock);
+    module->device = dev;
+    pthread_mutex_unlock(&module->lock);
+
+    *device = &dev->device.common;
+    return 0;
+}
+
+struct hw_module_methods_t synthetic_sensors_module_methods = {
+    open : synthetic_open
+};
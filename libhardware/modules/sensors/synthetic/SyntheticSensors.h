@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHETICSENSORS_H_
+#define SYNTHETICSENSORS_H_
+
+#include <hardware/sensors.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+/*
+ * Synthetic sensors sub-HAL, for load-testing the multihal without devices.
+ *
+ * Each sensor either generates samples at its sampling period, or the module replays a capture
+ * of sensors_event_t records with the original spacing. Samples go through a per-sensor FIFO
+ * of fifoMaxEventCount events, so batch() max report latency and flush() behave as they do on
+ * hardware, and samples the poll() caller falls too far behind on are dropped and counted.
+ *
+ * As a loadable sub-HAL (sensors.synthetic.so, listed in hals.conf) it is configured from
+ * SYNTHETIC_SENSORS_CONFIG_FILENAME:
+ *
+ *   sensor <type> <rate Hz> <fifo events>
+ *   replay <capture path> <fifo events> [loop]
+ *
+ * In-process users initialize their own modules with synthetic_sensors_module_init().
+ */
+
+#define SYNTHETIC_SENSORS_CONFIG_FILENAME "/system/etc/sensors/synthetic.conf"
+#define SYNTHETIC_SENSORS_MAX_SENSORS 32
+
+struct synthetic_sensor_config_t {
+    int type;
+    int64_t period_ns;            // until setDelay() or batch() say otherwise
+    uint32_t fifo_max_event_count; // 0 means no batching; one sample is still held
+};
+
+struct synthetic_sensors_config_t {
+    int sensor_count;
+    synthetic_sensor_config_t sensors[SYNTHETIC_SENSORS_MAX_SENSORS];
+
+    // If set, the module reports the sensors found in the capture instead, each with a FIFO of
+    // replay_fifo_max_event_count events, and sensors is ignored.
+    const char* replay_path;
+    uint32_t replay_fifo_max_event_count;
+    bool replay_loop;
+};
+
+struct synthetic_sensors_stats_t {
+    uint64_t generated;
+    uint64_t delivered;
+    uint64_t dropped;       // overwritten in a full FIFO before poll() got to them
+    uint64_t flushes;       // META_DATA_FLUSH_COMPLETE events delivered
+};
+
+struct synthetic_sensors_device_t;
+
+struct synthetic_sensors_module_t {
+    struct sensors_module_t base;
+
+    pthread_mutex_t lock;
+    bool configured;
+    synthetic_sensors_config_t config;
+    struct sensor_t sensors[SYNTHETIC_SENSORS_MAX_SENSORS];
+    int sensor_count;
+    sensors_event_t* replay_events; // capture, sorted by timestamp; NULL unless replaying
+    size_t replay_count;
+    synthetic_sensors_device_t* device; // the open device, if any
+};
+
+extern struct hw_module_methods_t synthetic_sensors_module_methods;
+
+int synthetic_sensors_get_sensors_list(struct sensors_module_t* module,
+        struct sensor_t const** list);
+
+// Sets up a module that was not loaded from a library. config is copied; replay_path is read
+// now. Returns 0, or a negative errno if the capture cannot be loaded.
+int synthetic_sensors_module_init(synthetic_sensors_module_t* module,
+        const synthetic_sensors_config_t* config);
+
+// Counters of the module's open device; all zero if it has none.
+void synthetic_sensors_get_stats(synthetic_sensors_module_t* module,
+        synthetic_sensors_stats_t* stats);
+
+/*
+ * Captures are a synthetic_capture_header_t followed by sensors_event_t records in the order
+ * they were delivered.
+ */
+#define SYNTHETIC_CAPTURE_MAGIC 0x534e5343 // 'SNSC'
+#define SYNTHETIC_CAPTURE_VERSION 1
+
+struct synthetic_capture_header_t {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t event_size; // sizeof(sensors_event_t) of the writer
+    uint32_t reserved;
+};
+
+// Returns false if the header could not be written.
+bool synthetic_capture_write_header(FILE* file);
+
+// Reads a capture into a new[]-allocated array and returns its length, or a negative errno.
+ssize_t synthetic_capture_read(const char* path, sensors_event_t** events);
+
+#endif // SYNTHETICSENSORS_H_
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SyntheticSensors.h"
+
+/*
+ * The module symbol of sensors.synthetic.so. It lives apart from the implementation so that
+ * in-process users, which may also link the multihal, can set up any number of modules with
+ * synthetic_sensors_module_init() instead.
+ */
+struct synthetic_sensors_module_t HAL_MODULE_INFO_SYM = {
+    base : {
+        common : {
+            tag : HARDWARE_MODULE_TAG,
+            version_major : 1,
+            version_minor : 0,
+            id : SENSORS_HARDWARE_MODULE_ID,
+            name : "Synthetic Sensor Module",
+            author : "The Android Open Source Project",
+            methods : &synthetic_sensors_module_methods,
+            dso : NULL,
+            reserved : {0},
+        },
+        get_sensors_list : synthetic_sensors_get_sensors_list,
+    },
+    lock : PTHREAD_MUTEX_INITIALIZER,
+};
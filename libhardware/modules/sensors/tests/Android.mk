@@ -15,3 +15,20 @@ LOCAL_C_INCLUDES := $(LOCAL_PATH)/.. bionic
 LOCAL_LDLIBS += -lpthread
 
 include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	multihal_benchmark.cpp \
+	../SensorEventQueue.cpp
+
+LOCAL_CFLAGS := -DLOG_TAG=\"MultiHal\"
+LOCAL_MODULE := multihal_benchmark
+
+LOCAL_STATIC_LIBRARIES := libsensors_synthetic_host libcutils libutils liblog
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/.. bionic
+
+LOCAL_LDLIBS += -lpthread -lrt -ldl
+
+include $(BUILD_HOST_EXECUTABLE)
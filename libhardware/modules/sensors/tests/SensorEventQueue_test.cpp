@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <hardware/sensors.h>
 #include <pthread.h>
+#include <sched.h>
 #include <cutils/atomic.h>
 
 #include "SensorEventQueue.cpp"
@@ -107,28 +108,35 @@ void *fullQueueWriterTask(void* ptr) {
     ctx->success = true;
     int totalWaits = 0;
     int totalWrites = 0;
+    int totalWriteCalls = 0;
     sensors_event_t* buffer;
 
     while (totalWrites < FULL_QUEUE_EVENT_COUNT) {
-        pthread_mutex_lock(&mutex);
-        if (queue->waitForSpace(&mutex)) {
+        if (queue->waitForSpace()) {
             totalWaits++;
             printf(".");
         }
         int writableSize = queue->getWritableRegion(FULL_QUEUE_CAPACITY, &buffer);
         queue->markAsWritten(writableSize);
         totalWrites += writableSize;
+        totalWriteCalls++;
         for (int i = 0; i < writableSize; i++) {
             printf("w");
         }
+        pthread_mutex_lock(&mutex);
         pthread_cond_broadcast(&dataAvailableCond);
         pthread_mutex_unlock(&mutex);
     }
     printf("\n");
 
+    // The reader only frees a slot once the queue is full, so after the first fill every write
+    // is a single event. Without an external lock, whether the writer actually sleeps in
+    // waitForSpace() depends on whether the reader got there first.
     ctx->success =
             checkInt("totalWrites", FULL_QUEUE_EVENT_COUNT, totalWrites) &&
-            checkInt("totalWaits", FULL_QUEUE_EVENT_COUNT - FULL_QUEUE_CAPACITY, totalWaits);
+            checkInt("totalWriteCalls", FULL_QUEUE_EVENT_COUNT - FULL_QUEUE_CAPACITY + 1,
+                    totalWriteCalls) &&
+            totalWaits <= FULL_QUEUE_EVENT_COUNT - FULL_QUEUE_CAPACITY;
     return NULL;
 }
 
@@ -151,10 +159,10 @@ void* fullQueueReaderTask(void* ptr) {
         while (!fullQueueReaderShouldRead(queue->getSize(), totalReads)) {
             pthread_cond_wait(&dataAvailableCond, &mutex);
         }
+        pthread_mutex_unlock(&mutex);
         queue->dequeue();
         totalReads++;
         printf("r");
-        pthread_mutex_unlock(&mutex);
     }
     printf("\n");
     ctx->success = ctx->success && checkInt("totalreads", FULL_QUEUE_EVENT_COUNT, totalReads);
@@ -186,11 +194,91 @@ bool testFullQueueIo() {
     return true;
 }
 
+int SPSC_QUEUE_CAPACITY = 20;
+int SPSC_EVENT_COUNT = 1000000;
+
+void* spscWriterTask(void* ptr) {
+    TaskContext* ctx = (TaskContext*)ptr;
+    SensorEventQueue* queue = ctx->queue;
+    sensors_event_t* buffer;
+    int totalWrites = 0;
+
+    while (totalWrites < SPSC_EVENT_COUNT) {
+        queue->waitForSpace();
+        // vary the batch size, as sub-HALs do
+        int requested = 1 + totalWrites % 7;
+        int writableSize = queue->getWritableRegion(requested, &buffer);
+        if (writableSize > SPSC_EVENT_COUNT - totalWrites) {
+            writableSize = SPSC_EVENT_COUNT - totalWrites;
+        }
+        for (int i = 0; i < writableSize; i++) {
+            buffer[i].timestamp = totalWrites + i;
+        }
+        queue->markAsWritten(writableSize);
+        totalWrites += writableSize;
+    }
+    ctx->success = checkInt("totalWrites", SPSC_EVENT_COUNT, totalWrites);
+    return NULL;
+}
+
+void* spscReaderTask(void* ptr) {
+    TaskContext* ctx = (TaskContext*)ptr;
+    SensorEventQueue* queue = ctx->queue;
+    int totalReads = 0;
+    ctx->success = true;
+
+    while (totalReads < SPSC_EVENT_COUNT) {
+        sensors_event_t* event = queue->peek();
+        if (event == NULL) {
+            sched_yield();
+            continue;
+        }
+        if (event->timestamp != totalReads) {
+            printf("Expected timestamp %d; actual was %lld\n", totalReads,
+                    (long long)event->timestamp);
+            ctx->success = false;
+            return NULL;
+        }
+        queue->dequeue();
+        totalReads++;
+    }
+    ctx->success = checkInt("totalReads", SPSC_EVENT_COUNT, totalReads);
+    return NULL;
+}
+
+// Test that the lock-free queue hands every event over, in order, with one writer and one reader
+// running concurrently and no external lock.
+bool testSpscOrdering() {
+    printf("testSpscOrdering\n");
+    SensorEventQueue* queue = new SensorEventQueue(SPSC_QUEUE_CAPACITY);
+
+    TaskContext readerCtx;
+    readerCtx.success = true;
+    readerCtx.queue = queue;
+
+    TaskContext writerCtx;
+    writerCtx.success = true;
+    writerCtx.queue = queue;
+
+    pthread_t writer, reader;
+    pthread_create(&reader, NULL, spscReaderTask, &readerCtx);
+    pthread_create(&writer, NULL, spscWriterTask, &writerCtx);
+
+    pthread_join(writer, NULL);
+    pthread_join(reader, NULL);
+
+    if (!readerCtx.success || !writerCtx.success) return false;
+    if (!checkSize(queue, 0)) return false;
+    printf("passed\n");
+    return true;
+}
+
 
 int main(int argc, char **argv) {
     if (testSimpleWriteSizeCounts() &&
             testWrappingWriteSizeCounts() &&
-            testFullQueueIo()) {
+            testFullQueueIo() &&
+            testSpscOrdering()) {
         printf("ALL PASSED\n");
     } else {
         printf("SOMETHING FAILED\n");
@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <deque>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "multihal.cpp"
+#include "SyntheticSensors.h"
+
+// Load test of the multihal poll() path, driven by synthetic sub-HALs that each run a writer
+// thread, as real sub-HALs would.
+//
+// Run it like this:
+//
+// make multihal_benchmark -j32 && \
+// out/host/linux-x86/obj/EXECUTABLES/multihal_benchmark_intermediates/multihal_benchmark \
+//     -S batch -m 3 -s 2 -r 400 -d 5
+//
+// Scenarios:
+//   stream        every sample is reported as it is taken
+//   batch         samples wait in the sub-HAL FIFOs for up to the max report latency (-l)
+//   flush         batch, and every sensor is flushed every -f ms
+//   backpressure  stream, but the consumer polls a few events every -c ms, so the multihal
+//                 queues fill, the writers block in waitForSpace() and the sub-HAL FIFOs overflow
+//
+// Generated sensors report at the same rate, each sub-HAL offset in phase. With -p every sub-HAL
+// replays a capture instead; -o records what the consumer received, in the same format.
+//
+// An event's latency is how long after its timestamp poll() handed it over, so under batch it
+// includes the time spent in the FIFO. CPU is the whole process: sub-HALs, multihal and consumer.
+
+static const int MAX_SYNTHETIC_MODULES = 16;
+static const int POLL_BUFFER_SIZE = 256;
+static const int BACKPRESSURE_POLL_SIZE = 4;
+
+enum Scenario {
+    SCENARIO_STREAM,
+    SCENARIO_BATCH,
+    SCENARIO_FLUSH,
+    SCENARIO_BACKPRESSURE,
+};
+
+static const char* SCENARIO_NAMES[] = { "stream", "batch", "flush", "backpressure" };
+
+static synthetic_sensors_module_t synthetic_modules[MAX_SYNTHETIC_MODULES];
+
+static sensors_poll_device_1_t* poll_dev;
+static int global_sensor_count;
+static volatile int32_t stopping;
+
+// Times of flush() calls whose completion has not come back yet, per global handle.
+static pthread_mutex_t flush_mutex = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<std::deque<int64_t> > flush_times;
+
+static int64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int64_t cpu_ns() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return ((int64_t)usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000LL +
+            ((int64_t)usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000LL;
+}
+
+static void sleep_ms(int ms) {
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000L;
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+    }
+}
+
+struct FlusherArgs {
+    int periodMs;
+};
+
+static void* flusher_task(void* ptr) {
+    FlusherArgs* args = (FlusherArgs*) ptr;
+    while (!android_atomic_acquire_load(&stopping)) {
+        sleep_ms(args->periodMs);
+        for (int handle = 1; handle <= global_sensor_count; handle++) {
+            pthread_mutex_lock(&flush_mutex);
+            flush_times[handle].push_back(now_ns());
+            pthread_mutex_unlock(&flush_mutex);
+            poll_dev->flush(poll_dev, handle);
+        }
+    }
+    return NULL;
+}
+
+// Ends the run after the given time. The flushes make sure poll() returns even if no sensor is
+// due to report for a while.
+static void* stopper_task(void* ptr) {
+    sleep_ms(*(int*) ptr);
+    android_atomic_release_store(1, &stopping);
+    for (int handle = 1; handle <= global_sensor_count; handle++) {
+        poll_dev->flush(poll_dev, handle);
+    }
+    return NULL;
+}
+
+static int64_t percentile(std::vector<int64_t>& v, int pct) {
+    if (v.empty()) {
+        return 0;
+    }
+    size_t i = v.size() * pct / 100;
+    return v[std::min(i, v.size() - 1)];
+}
+
+static void print_latencies(const char* what, std::vector<int64_t>& v) {
+    std::sort(v.begin(), v.end());
+    printf("%s: p50 %.1f us, p99 %.1f us, max %.1f us (%zu)\n", what,
+            percentile(v, 50) / 1000.0, percentile(v, 99) / 1000.0,
+            (v.empty() ? 0 : v.back()) / 1000.0, v.size());
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "usage: %s [-S stream|batch|flush|backpressure] [-m sub-HALs]\n"
+            "        [-s sensors per sub-HAL] [-r rate Hz] [-F fifo events] [-l latency ms]\n"
+            "        [-f flush period ms] [-c consumer period ms] [-d seconds]\n"
+            "        [-p capture to replay [-L]] [-o capture to record]\n", name);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv) {
+    Scenario scenario = SCENARIO_STREAM;
+    int moduleCount = 3;
+    int sensorCount = 2;
+    int rateHz = 400;
+    int fifoEvents = 300;
+    int latencyMs = 100;
+    int flushPeriodMs = 50;
+    int consumerPeriodMs = 50;
+    int seconds = 5;
+    const char* replayPath = NULL;
+    bool replayLoop = false;
+    const char* recordPath = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "S:m:s:r:F:l:f:c:d:p:Lo:")) != -1) {
+        switch (opt) {
+        case 'S': {
+            int i = 0;
+            while (i <= SCENARIO_BACKPRESSURE && strcmp(optarg, SCENARIO_NAMES[i]) != 0) {
+                i++;
+            }
+            if (i > SCENARIO_BACKPRESSURE) {
+                usage(argv[0]);
+            }
+            scenario = (Scenario) i;
+            break;
+        }
+        case 'm': moduleCount = atoi(optarg); break;
+        case 's': sensorCount = atoi(optarg); break;
+        case 'r': rateHz = atoi(optarg); break;
+        case 'F': fifoEvents = atoi(optarg); break;
+        case 'l': latencyMs = atoi(optarg); break;
+        case 'f': flushPeriodMs = atoi(optarg); break;
+        case 'c': consumerPeriodMs = atoi(optarg); break;
+        case 'd': seconds = atoi(optarg); break;
+        case 'p': replayPath = optarg; break;
+        case 'L': replayLoop = true; break;
+        case 'o': recordPath = optarg; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (moduleCount < 1 || moduleCount > MAX_SYNTHETIC_MODULES ||
+            sensorCount < 1 || sensorCount > SYNTHETIC_SENSORS_MAX_SENSORS ||
+            rateHz < 1 || fifoEvents < 0 || latencyMs < 0 || flushPeriodMs < 1 ||
+            consumerPeriodMs < 1 || seconds < 1) {
+        usage(argv[0]);
+    }
+
+    // Stand in for hals.conf: lazy_init_modules() leaves a non-NULL sub_hw_modules alone.
+    sub_hw_modules = new std::vector<hw_module_t *>();
+    int64_t periodNs = 1000000000LL / rateHz;
+    for (int m = 0; m < moduleCount; m++) {
+        synthetic_sensors_config_t config;
+        memset(&config, 0, sizeof(config));
+        config.sensor_count = sensorCount;
+        for (int i = 0; i < sensorCount; i++) {
+            config.sensors[i].type = i % 2 ? SENSOR_TYPE_GYROSCOPE : SENSOR_TYPE_ACCELEROMETER;
+            config.sensors[i].period_ns = periodNs;
+            config.sensors[i].fifo_max_event_count = fifoEvents;
+        }
+        config.replay_path = replayPath;
+        config.replay_fifo_max_event_count = fifoEvents;
+        config.replay_loop = replayLoop;
+        if (synthetic_sensors_module_init(&synthetic_modules[m], &config) != 0) {
+            fprintf(stderr, "cannot load %s\n", replayPath);
+            return EXIT_FAILURE;
+        }
+        sub_hw_modules->push_back(&synthetic_modules[m].base.common);
+    }
+
+    struct sensor_t const* list;
+    global_sensor_count = HAL_MODULE_INFO_SYM.get_sensors_list(&HAL_MODULE_INFO_SYM, &list);
+    struct hw_device_t* hw_device;
+    open_sensors(&HAL_MODULE_INFO_SYM.common, SENSORS_HARDWARE_POLL, &hw_device);
+    poll_dev = (sensors_poll_device_1_t*) hw_device;
+    flush_times.resize(global_sensor_count + 1);
+
+    // Sub-HALs are offset in phase as they are opened, so start them in order.
+    bool batched = scenario == SCENARIO_BATCH || scenario == SCENARIO_FLUSH;
+    int64_t latencyNs = batched ? (int64_t)latencyMs * 1000000LL : 0;
+    for (int handle = 1; handle <= global_sensor_count; handle++) {
+        poll_dev->batch(poll_dev, handle, 0, periodNs, latencyNs);
+        poll_dev->activate(&poll_dev->v0, handle, 1);
+        if (handle % sensorCount == 0 && replayPath == NULL) {
+            sleep_ms(std::max(1, (int)(periodNs / 1000000 / moduleCount)));
+        }
+    }
+
+    FILE* record = NULL;
+    if (recordPath != NULL) {
+        record = fopen(recordPath, "w");
+        if (record == NULL || !synthetic_capture_write_header(record)) {
+            fprintf(stderr, "cannot write %s: %s\n", recordPath, strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (replayPath != NULL) {
+        printf("%s: %d sub-HALs replaying %s (%d sensors), fifo %d, %d s\n",
+                SCENARIO_NAMES[scenario], moduleCount, replayPath,
+                global_sensor_count / moduleCount, fifoEvents, seconds);
+    } else {
+        printf("%s: %d sub-HALs x %d sensors at %d Hz, fifo %d, %d s\n",
+                SCENARIO_NAMES[scenario], moduleCount, sensorCount, rateHz, fifoEvents, seconds);
+    }
+
+    pthread_t stopper;
+    int durationMs = seconds * 1000;
+    pthread_create(&stopper, NULL, stopper_task, &durationMs);
+    pthread_t flusher;
+    FlusherArgs flusherArgs = { flushPeriodMs };
+    if (scenario == SCENARIO_FLUSH) {
+        pthread_create(&flusher, NULL, flusher_task, &flusherArgs);
+    }
+
+    int pollSize = scenario == SCENARIO_BACKPRESSURE ? BACKPRESSURE_POLL_SIZE : POLL_BUFFER_SIZE;
+    sensors_event_t buffer[POLL_BUFFER_SIZE];
+    std::vector<int64_t> latencies;
+    std::vector<int64_t> flushLatencies;
+    std::vector<int64_t> lastTimestamp(global_sensor_count + 1, 0);
+    long events = 0;
+    long polls = 0;
+    long sensorOutOfOrder = 0;
+    long badHandles = 0;
+
+    int64_t start = now_ns();
+    int64_t startCpu = cpu_ns();
+    while (!android_atomic_acquire_load(&stopping)) {
+        int n = poll_dev->poll(&poll_dev->v0, buffer, pollSize);
+        int64_t now = now_ns();
+        polls++;
+        if (record != NULL) {
+            fwrite(buffer, sizeof(sensors_event_t), n, record);
+        }
+        for (int i = 0; i < n; i++) {
+            sensors_event_t* ev = &buffer[i];
+            if (ev->type == SENSOR_TYPE_META_DATA) {
+                int handle = ev->meta_data.sensor;
+                pthread_mutex_lock(&flush_mutex);
+                if (handle >= 1 && handle <= global_sensor_count &&
+                        !flush_times[handle].empty()) {
+                    flushLatencies.push_back(now - flush_times[handle].front());
+                    flush_times[handle].pop_front();
+                }
+                pthread_mutex_unlock(&flush_mutex);
+                continue;
+            }
+            if (ev->sensor < 1 || ev->sensor > global_sensor_count) {
+                badHandles++;
+                continue;
+            }
+            events++;
+            latencies.push_back(now - ev->timestamp);
+            if (ev->timestamp < lastTimestamp[ev->sensor]) {
+                sensorOutOfOrder++;
+            }
+            lastTimestamp[ev->sensor] = ev->timestamp;
+        }
+        if (scenario == SCENARIO_BACKPRESSURE) {
+            sleep_ms(consumerPeriodMs);
+        }
+    }
+    double elapsed = (now_ns() - start) / 1e9;
+    int64_t cpu = cpu_ns() - startCpu;
+
+    if (record != NULL) {
+        fclose(record);
+    }
+
+    synthetic_sensors_stats_t total;
+    memset(&total, 0, sizeof(total));
+    for (int m = 0; m < moduleCount; m++) {
+        synthetic_sensors_stats_t stats;
+        synthetic_sensors_get_stats(&synthetic_modules[m], &stats);
+        total.generated += stats.generated;
+        total.delivered += stats.delivered;
+        total.dropped += stats.dropped;
+        total.flushes += stats.flushes;
+    }
+
+    printf("%ld events in %.2f s: %.0f events/s, %.1f events/poll, %.1f ms CPU per 1k events\n",
+            events, elapsed, events / elapsed, polls ? (double)events / polls : 0.0,
+            events ? cpu / 1e6 / events * 1000 : 0.0);
+    print_latencies("latency", latencies);
+    if (scenario == SCENARIO_FLUSH) {
+        print_latencies("flush complete", flushLatencies);
+    }
+    printf("sub-HALs: %llu generated, %llu dropped in full FIFOs, %llu flushes completed\n",
+            (unsigned long long)total.generated, (unsigned long long)total.dropped,
+            (unsigned long long)total.flushes);
+    printf("%ld out of order within a sensor, %ld bad handles\n", sensorOutOfOrder, badHandles);
+
+    // The sub-HAL writer threads never return; leave without closing the device.
+    return (sensorOutOfOrder == 0 && badHandles == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -19,7 +19,8 @@ include $(CLEAR_VARS)
 LOCAL_MODULE := audio.usb.default
 LOCAL_MODULE_RELATIVE_PATH := hw
 LOCAL_SRC_FILES := \
-	audio_hal.c
+	audio_hal.c \
+	format_convert.c
 LOCAL_C_INCLUDES += \
 	external/tinyalsa/include \
 	$(MTK_PATH_SOURCE)/hardware/perfservice/perfservicenative \
@@ -36,3 +37,4 @@ endif
 
 include $(BUILD_SHARED_LIBRARY)
 
+include $(call all-makefiles-under, $(LOCAL_PATH))
@@ -25,6 +25,12 @@
 #define MTK_AUDIO_DEBUG
 #endif
 
+/* Per-write timing and PCM dumps. Compiled out of user builds: they cost several clock reads
+ * per buffer and a file write whenever the dump property is set. */
+#if defined(MTK_AUDIO_DEBUG)
+#define USB_AUDIO_PCM_DEBUG
+#endif
+
 #include <errno.h>
 #include <inttypes.h>
 #include <pthread.h>
@@ -44,7 +50,6 @@
 #include <system/audio.h>
 
 #include <tinyalsa/asoundlib.h>
-#include <audio_utils/channels.h>
 
 #define USB_TAG "[USB_AUD] "
 
@@ -63,6 +68,7 @@ static const unsigned k_force_channels = 0;
 #include "alsa_device_profile.h"
 #include "alsa_device_proxy.h"
 #include "alsa_logging.h"
+#include "format_convert.h"
 
 #define DEFAULT_INPUT_BUFFER_SIZE_MS 20
 
@@ -106,10 +112,13 @@ struct stream_out {
                                          * too few channels. */
     audio_channel_mask_t hal_channel_mask;   /* channel mask exposed to AudioFlinger. */
 
-    void * conversion_buffer;           /* any conversions are put into here
-                                         * they could come from here too if
-                                         * there was a previous conversion */
-    size_t conversion_buffer_size;      /* in bytes */
+    struct format_convert conversion;   /* from the AudioFlinger format to the device format */
+    void * conversion_buffer;           /* converted frames on their way to the device,
+                                         * allocated when the stream is opened */
+    size_t conversion_buffer_frames;    /* writes are converted this many frames at a time */
+#ifdef USB_AUDIO_PCM_DEBUG
+    bool pcm_dump;                      /* dump property was set when the stream started */
+#endif
 };
 
 struct stream_in {
@@ -131,13 +140,16 @@ struct stream_in {
                                          * too few channels. */
     audio_channel_mask_t hal_channel_mask;   /* channel mask exposed to AudioFlinger. */
 
-    /* We may need to read more data from the device in order to data reduce to 16bit, 4chan */
-    void * conversion_buffer;           /* any conversions are put into here
-                                         * they could come from here too if
-                                         * there was a previous conversion */
-    size_t conversion_buffer_size;      /* in bytes */
+    struct format_convert conversion;   /* from the device format to the AudioFlinger format */
+    void * conversion_buffer;           /* frames read from the device before conversion,
+                                         * allocated when the stream is opened */
+    size_t conversion_buffer_frames;    /* reads are converted this many frames at a time */
+#ifdef USB_AUDIO_PCM_DEBUG
+    bool pcm_dump;                      /* dump property was set when the stream started */
+#endif
 };
 
+#ifdef USB_AUDIO_PCM_DEBUG
 //MTK +++
 //usb output pcm dump
 const char * usbstreamout = "/sdcard/mtklog/audio_dump/usbstreamout.pcm";
@@ -146,6 +158,7 @@ const char * streamout_propty = "streamout.pcm.dump";
 const char * usbstreamin = "/sdcard/mtklog/audio_dump/usbstreamin.pcm";
 const char * streamin_propty = "streamin.pcm.dump";
 //MTK ---
+#endif
 
 /*
  * NOTE: when multiple mutexes have to be acquired, always take the
@@ -256,11 +269,19 @@ void lock_output_stream(struct stream_out *out)
     pthread_mutex_unlock(&out->pre_lock);
 }
 
+#ifdef USB_AUDIO_PCM_DEBUG
 //MTK+++
 #define calc_time_diff(x, y) ((x.tv_sec - y.tv_sec )+ (double)( x.tv_nsec - y.tv_nsec ) / (double)1000000000)
-struct timespec mNewtime, mOldtime;  // for calculate latency
-double timerec[3];  // 0=>threadloop, 1=>kernel delay, 2=>process delay
-bool bDebugEnable = false;
+static struct timespec mNewtime, mOldtime;  // for calculate latency
+static double timerec[3];  // 0=>threadloop, 1=>kernel delay, 2=>process delay
+
+/* Adds the time since the last mark to timerec[index]. */
+static void mark_time(int index)
+{
+    clock_gettime(CLOCK_REALTIME, &mNewtime);
+    timerec[index] += calc_time_diff(mNewtime, mOldtime);
+    mOldtime = mNewtime;
+}
 
 int checkAndCreateDirectory(const char * pC)
 {
@@ -293,32 +314,68 @@ int checkAndCreateDirectory(const char * pC)
 
 
 
-void dumpPcmData(const char * filepath, void * buffer, int count,const char * propty)
+bool pcmDumpEnabled(const char * propty)
 {
     char value[PROPERTY_VALUE_MAX];
-    int ret;
     property_get(propty, value, "0");
-    int bflag=atoi(value);
-    bDebugEnable = bflag;
-    if(bflag)
+    return atoi(value) != 0;
+}
+
+void dumpPcmData(const char * filepath, const void * buffer, int count)
+{
+    int ret = checkAndCreateDirectory(filepath);
+    if(ret<0)
     {
-       ret = checkAndCreateDirectory(filepath);
-	   if(ret<0)
-	   {
-	       ALOGE("dumpPcmData checkAndCreateDirectory() fail!!!");
-	   }
-	   else
-       {
-           FILE * fp= fopen(filepath, "ab+");
-           if(fp!=NULL)
-           {
-               fwrite(buffer,1,count,fp);
-               fclose(fp);
-           }
-	   }
+        ALOGE("dumpPcmData checkAndCreateDirectory() fail!!!");
+    }
+    else
+    {
+        FILE * fp= fopen(filepath, "ab+");
+        if(fp!=NULL)
+        {
+            fwrite(buffer,1,count,fp);
+            fclose(fp);
+        }
     }
 }
 //MTK---
+#endif
+
+/*
+ * Sets up the conversion between the AudioFlinger side and the device side of a stream, and
+ * allocates the buffer for a period of frames at the larger of the two frame sizes so that
+ * out_write() and in_read() never allocate.
+ * Falls back to passing data through unchanged if the format is not one we can convert.
+ */
+static void *setup_conversion(struct format_convert *conv, size_t *buffer_frames,
+                              audio_format_t src_format, unsigned src_channels,
+                              audio_format_t dst_format, unsigned dst_channels,
+                              size_t period_frames)
+{
+    if (!format_convert_init(conv, src_format, src_channels, dst_format, dst_channels)) {
+        if (src_format != dst_format || src_channels != dst_channels) {
+            ALOGE(USB_TAG"no conversion from format %#x/%u channels to %#x/%u channels",
+                  src_format, src_channels, dst_format, dst_channels);
+        }
+        conv->src_format = conv->dst_format = src_format;
+        conv->src_channels = conv->dst_channels = src_channels;
+    }
+    *buffer_frames = 0;
+    if (format_convert_is_identity(conv)) {
+        return NULL;
+    }
+
+    size_t frame_size = format_convert_src_frame_size(conv);
+    if (format_convert_dst_frame_size(conv) > frame_size) {
+        frame_size = format_convert_dst_frame_size(conv);
+    }
+    void *buffer = malloc(period_frames * frame_size);
+    if (buffer != NULL) {
+        *buffer_frames = period_frames;
+    }
+    return buffer;
+}
+
 /*
  * HAl Functions
  */
@@ -486,6 +543,9 @@ static int start_output_stream(struct stream_out *out)
 {
     ALOGV("start_output_stream(card:%d device:%d)", out->profile->card, out->profile->device);
 
+#ifdef USB_AUDIO_PCM_DEBUG
+    out->pcm_dump = pcmDumpEnabled(streamout_propty);
+#endif
     return proxy_open(&out->proxy);
 }
 
@@ -494,9 +554,10 @@ static ssize_t out_write(struct audio_stream_out *stream, const void* buffer, si
     int ret;
     struct stream_out *out = (struct stream_out *)stream;
 
-    clock_gettime(CLOCK_REALTIME, &mNewtime);
-    timerec[0] = calc_time_diff(mNewtime, mOldtime);
-    mOldtime = mNewtime;
+#ifdef USB_AUDIO_PCM_DEBUG
+    timerec[0] = timerec[1] = timerec[2] = 0;
+    mark_time(0);
+#endif
 
     lock_output_stream(out);
     ALOGV(USB_TAG"+out_write(%d)",bytes);
@@ -511,53 +572,51 @@ static ssize_t out_write(struct audio_stream_out *stream, const void* buffer, si
         out->standby = false;
     }
 
-    alsa_device_proxy* proxy = &out->proxy;
-    const void * write_buff = buffer;
-    int num_write_buff_bytes = bytes;
-    const int num_device_channels = proxy_get_channel_count(proxy); /* what we told alsa */
-    const int num_req_channels = out->hal_channel_count; /* what we told AudioFlinger */
-    if (num_device_channels != num_req_channels) {
-        /* allocate buffer */
-        const size_t required_conversion_buffer_size =
-                 bytes * num_device_channels / num_req_channels;
-        if (required_conversion_buffer_size > out->conversion_buffer_size) {
-            out->conversion_buffer_size = required_conversion_buffer_size;
-            out->conversion_buffer = realloc(out->conversion_buffer,
-                                             out->conversion_buffer_size);
-        }
-        /* convert data */
-        const audio_format_t audio_format = out_get_format(&(out->stream.common));
-        const unsigned sample_size_in_bytes = audio_bytes_per_sample(audio_format);
-        num_write_buff_bytes =
-                adjust_channels(write_buff, num_req_channels,
-                                out->conversion_buffer, num_device_channels,
-                                sample_size_in_bytes, num_write_buff_bytes);
-        write_buff = out->conversion_buffer;
+    const struct format_convert *conv = &out->conversion;
+    const bool convert = out->conversion_buffer != NULL;
+    const size_t frame_size = format_convert_src_frame_size(conv);
+    const uint8_t *src = (const uint8_t *)buffer;
+    size_t frames = bytes / frame_size;
+    if (frames == 0) {
+        ALOGD(USB_TAG"out_write() no proxy_write?");
     }
+    while (frames > 0) {
+        /* what we told AudioFlinger -> what we told alsa, a conversion buffer at a time */
+        const void *write_buff = src;
+        size_t count = frames;
+        size_t num_write_buff_bytes = count * frame_size;
+        if (convert) {
+            if (count > out->conversion_buffer_frames) {
+                count = out->conversion_buffer_frames;
+            }
+            num_write_buff_bytes =
+                    format_convert_frames(conv, src, out->conversion_buffer, count);
+            write_buff = out->conversion_buffer;
+        }
+#ifdef USB_AUDIO_PCM_DEBUG
+        mark_time(2);
+#endif
 
-    clock_gettime(CLOCK_REALTIME, &mNewtime);
-    timerec[2] = calc_time_diff(mNewtime, mOldtime);
-    mOldtime = mNewtime;
-
-    if (write_buff != NULL && num_write_buff_bytes != 0) {
         proxy_write(&out->proxy, write_buff, num_write_buff_bytes);
 
-        clock_gettime(CLOCK_REALTIME, &mNewtime);
-        timerec[1] = calc_time_diff(mNewtime, mOldtime);
-        mOldtime = mNewtime;
+#ifdef USB_AUDIO_PCM_DEBUG
+        mark_time(1);
         //Dump debug data
-        dumpPcmData(usbstreamout,(void*)write_buff,num_write_buff_bytes,streamout_propty);
-    }
-    else {
-        clock_gettime(CLOCK_REALTIME, &mOldtime);
-        ALOGD(USB_TAG"out_write() no proxy_write?");
+        if (out->pcm_dump) {
+            dumpPcmData(usbstreamout, write_buff, num_write_buff_bytes);
+        }
+#endif
+        src += count * frame_size;
+        frames -= count;
     }
 
     pthread_mutex_unlock(&out->lock);
 
-    if (bDebugEnable) {
+#ifdef USB_AUDIO_PCM_DEBUG
+    if (out->pcm_dump) {
         ALOGD(USB_TAG"%s, latency_in_us,%1.6lf,%1.6lf,%1.6lf", __FUNCTION__, timerec[0], timerec[1], timerec[2]);
     }
+#endif
     ALOGV(USB_TAG"-out_write(%d)",bytes);
     return bytes;
 
@@ -729,8 +788,18 @@ static int adev_open_output_stream(struct audio_hw_device *dev,
     /* TODO The retry mechanism isn't implemented in AudioPolicyManager/AudioFlinger. */
     ret = 0;
 
-    out->conversion_buffer = NULL;
-    out->conversion_buffer_size = 0;
+    /* The HAL doesn't change the sample format yet, only the channel count. */
+    const audio_format_t format = out_get_format(&out->stream.common);
+    out->conversion_buffer =
+            setup_conversion(&out->conversion, &out->conversion_buffer_frames,
+                             format, out->hal_channel_count,
+                             format, proxy_get_channel_count(&out->proxy),
+                             proxy_get_period_size(&out->proxy));
+    if (out->conversion_buffer == NULL && !format_convert_is_identity(&out->conversion)) {
+        free(out);
+        *stream_out = NULL;
+        return -ENOMEM;
+    }
 
     out->standby = true;
 
@@ -757,7 +826,7 @@ static void adev_close_output_stream(struct audio_hw_device *dev,
     free(out->conversion_buffer);
 
     out->conversion_buffer = NULL;
-    out->conversion_buffer_size = 0;
+    out->conversion_buffer_frames = 0;
 
     free(stream);
 }
@@ -926,6 +995,9 @@ static int start_input_stream(struct stream_in *in)
           in->profile->card, in->profile->device);
 #endif
 
+#ifdef USB_AUDIO_PCM_DEBUG
+    in->pcm_dump = pcmDumpEnabled(streamin_propty);
+#endif
     return proxy_open(&in->proxy);
 }
 
@@ -933,8 +1005,6 @@ static int start_input_stream(struct stream_in *in)
 static ssize_t in_read(struct audio_stream_in *stream, void* buffer, size_t bytes)
 {
     size_t num_read_buff_bytes = 0;
-    void * read_buff = buffer;
-    void * out_buff = buffer;
     int ret = 0;
 
     struct stream_in * in = (struct stream_in *)stream;
@@ -951,49 +1021,35 @@ static ssize_t in_read(struct audio_stream_in *stream, void* buffer, size_t byte
         in->standby = false;
     }
 
-    alsa_device_profile * profile = in->profile;
-
     /*
-     * OK, we need to figure out how much data to read to be able to output the requested
-     * number of bytes in the HAL format (16-bit, stereo).
+     * Read from the device in its own format, a conversion buffer at a time, and convert
+     * into the caller's buffer in the format we told AudioFlinger.
      */
-    num_read_buff_bytes = bytes;
-    int num_device_channels = proxy_get_channel_count(&in->proxy); /* what we told Alsa */
-    int num_req_channels = in->hal_channel_count; /* what we told AudioFlinger */
-
-    if (num_device_channels != num_req_channels) {
-        num_read_buff_bytes = (num_device_channels * num_read_buff_bytes) / num_req_channels;
-    }
-
-    /* Setup/Realloc the conversion buffer (if necessary). */
-    if (num_read_buff_bytes != bytes) {
-        if (num_read_buff_bytes > in->conversion_buffer_size) {
-            /*TODO Remove this when AudioPolicyManger/AudioFlinger support arbitrary formats
-              (and do these conversions themselves) */
-            in->conversion_buffer_size = num_read_buff_bytes;
-            in->conversion_buffer = realloc(in->conversion_buffer, in->conversion_buffer_size);
+    const struct format_convert *conv = &in->conversion;
+    const bool convert = in->conversion_buffer != NULL;
+    const size_t device_frame_size = format_convert_src_frame_size(conv);
+    const size_t hal_frame_size = format_convert_dst_frame_size(conv);
+    uint8_t *dst = (uint8_t *)buffer;
+    size_t frames = bytes / hal_frame_size;
+    while (frames > 0) {
+        size_t count = frames;
+        if (convert && count > in->conversion_buffer_frames) {
+            count = in->conversion_buffer_frames;
+        }
+        void *read_buff = convert ? in->conversion_buffer : dst;
+        ret = proxy_read(&in->proxy, read_buff, count * device_frame_size);
+        if (ret != 0) {
+            break;
         }
-        read_buff = in->conversion_buffer;
+        if (convert) {
+            format_convert_frames(conv, read_buff, dst, count);
+        }
+        dst += count * hal_frame_size;
+        frames -= count;
     }
 
-    ret = proxy_read(&in->proxy, read_buff, num_read_buff_bytes);
     if (ret == 0) {
-        if (num_device_channels != num_req_channels) {
-	// ALOGV("chans dev:%d req:%d", num_device_channels, num_req_channels);
-
-            out_buff = buffer;
-            /* Num Channels conversion */
-            if (num_device_channels != num_req_channels) {
-                audio_format_t audio_format = in_get_format(&(in->stream.common));
-                unsigned sample_size_in_bytes = audio_bytes_per_sample(audio_format);
-
-                num_read_buff_bytes =
-                    adjust_channels(read_buff, num_device_channels,
-                                    out_buff, num_req_channels,
-                                    sample_size_in_bytes, num_read_buff_bytes);
-            }
-        }
-
+        num_read_buff_bytes = dst - (uint8_t *)buffer;
         /* no need to acquire in->dev->lock to read mic_muted here as we don't change its state */
         if (num_read_buff_bytes > 0 && in->dev->mic_muted)
             memset(buffer, 0, num_read_buff_bytes);
@@ -1005,8 +1061,12 @@ err:
     pthread_mutex_unlock(&in->lock);
 
     ALOGV("audio_hal:usb in_read, bytes =%d, num_read_buff_bytes=%d", bytes,num_read_buff_bytes);
+#ifdef USB_AUDIO_PCM_DEBUG
     //Dump debug data
-    dumpPcmData(usbstreamin,(void*)buffer,num_read_buff_bytes,streamin_propty);
+    if (in->pcm_dump && num_read_buff_bytes > 0) {
+        dumpPcmData(usbstreamin, buffer, num_read_buff_bytes);
+    }
+#endif
 
     return num_read_buff_bytes;
 }
@@ -1124,8 +1184,18 @@ static int adev_open_input_stream(struct audio_hw_device *dev,
     ALOGD("audio_hal:usb adev_open_input_stream, in->proxy.channels=%d", in->proxy.alsa_config.channels);
     in->standby = true;
 
-    in->conversion_buffer = NULL;
-    in->conversion_buffer_size = 0;
+    /* The HAL doesn't change the sample format yet, only the channel count. */
+    const audio_format_t format = in_get_format(&in->stream.common);
+    in->conversion_buffer =
+            setup_conversion(&in->conversion, &in->conversion_buffer_frames,
+                             format, proxy_get_channel_count(&in->proxy),
+                             format, in->hal_channel_count,
+                             proxy_get_period_size(&in->proxy));
+    if (in->conversion_buffer == NULL && !format_convert_is_identity(&in->conversion)) {
+        free(in);
+        *stream_in = NULL;
+        return -ENOMEM;
+    }
 
     *stream_in = &in->stream;
 
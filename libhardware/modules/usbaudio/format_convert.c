@@ -0,0 +1,671 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "modules.usbaudio.format_convert"
+/*#define LOG_NDEBUG 0*/
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define FORMAT_CONVERT_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define FORMAT_CONVERT_SSE2
+#endif
+
+#include "format_convert.h"
+
+/* Size of the stack buffers used when a conversion needs an intermediate step. */
+#define SCRATCH_SAMPLES 1024
+
+#define Q15_SCALE 32768.0f
+#define Q31_SCALE 2147483648.0f
+
+static bool simd_enabled = true;
+
+/*
+ * Scalar conversions. These define the results; the vector loops below must match them
+ * exactly, except that ARMv7 NEON rounds float ties away from zero.
+ */
+static inline int16_t i16_from_float(float f)
+{
+    float s = f * Q15_SCALE;
+    if (s > 32767.0f) {
+        s = 32767.0f;
+    } else if (s < -32768.0f) {
+        s = -32768.0f;
+    }
+    return (int16_t)lrintf(s);
+}
+
+static inline int32_t q31_from_float(float f)
+{
+    const float s = f * Q31_SCALE;
+    if (s >= Q31_SCALE) {
+        return INT32_MAX;
+    } else if (s <= -Q31_SCALE) {
+        return INT32_MIN;
+    }
+    return (int32_t)lrintf(s);
+}
+
+static inline int32_t q31_from_q8_23(int32_t v)
+{
+    if (v > 0x7fffff) {
+        v = 0x7fffff;
+    } else if (v < -0x800000) {
+        v = -0x800000;
+    }
+    return (int32_t)((uint32_t)v << 8);
+}
+
+static inline int32_t q31_from_p24(const uint8_t *p)
+{
+    return (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24));
+}
+
+static inline void p24_from_q31(uint8_t *p, int32_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 24);
+}
+
+/*
+ * Vector loops. Each handles a whole number of vectors from the start of the buffer and
+ * returns how many samples (or frames, for the channel loops) it did; the caller finishes the
+ * rest with the scalar code. Loads and stores are unaligned.
+ */
+static size_t i16_to_float_simd(const int16_t *src, float *dst, size_t count)
+{
+    size_t i = 0;
+#if defined(FORMAT_CONVERT_SSE2)
+    const __m128 scale = _mm_set1_ps(1.0f / Q15_SCALE);
+    for (; i + 8 <= count; i += 8) {
+        const __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+#elif defined(FORMAT_CONVERT_NEON)
+    for (; i + 8 <= count; i += 8) {
+        const int16x8_t x = vld1q_s16(src + i);
+        const float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(x)));
+        const float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(x)));
+        vst1q_f32(dst + i, vmulq_n_f32(lo, 1.0f / Q15_SCALE));
+        vst1q_f32(dst + i + 4, vmulq_n_f32(hi, 1.0f / Q15_SCALE));
+    }
+#endif
+    return i;
+}
+
+#if defined(FORMAT_CONVERT_NEON)
+/* Rounds to nearest and saturates to int32. */
+static inline int32x4_t neon_round_f32(float32x4_t s)
+{
+#if defined(__aarch64__)
+    return vcvtnq_s32_f32(s);
+#else
+    const uint32x4_t negative = vcltq_f32(s, vdupq_n_f32(0.0f));
+    const float32x4_t half = vbslq_f32(negative, vdupq_n_f32(-0.5f), vdupq_n_f32(0.5f));
+    return vcvtq_s32_f32(vaddq_f32(s, half));
+#endif
+}
+#endif
+
+static size_t float_to_i16_simd(const float *src, int16_t *dst, size_t count)
+{
+    size_t i = 0;
+#if defined(FORMAT_CONVERT_SSE2)
+    const __m128 scale = _mm_set1_ps(Q15_SCALE);
+    const __m128 max = _mm_set1_ps(32767.0f);
+    const __m128 min = _mm_set1_ps(-32768.0f);
+    for (; i + 8 <= count; i += 8) {
+        __m128 lo = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+        __m128 hi = _mm_mul_ps(_mm_loadu_ps(src + i + 4), scale);
+        lo = _mm_max_ps(_mm_min_ps(lo, max), min);
+        hi = _mm_max_ps(_mm_min_ps(hi, max), min);
+        _mm_storeu_si128((__m128i *)(dst + i),
+                _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi)));
+    }
+#elif defined(FORMAT_CONVERT_NEON)
+    for (; i + 8 <= count; i += 8) {
+        const int32x4_t lo = neon_round_f32(vmulq_n_f32(vld1q_f32(src + i), Q15_SCALE));
+        const int32x4_t hi = neon_round_f32(vmulq_n_f32(vld1q_f32(src + i + 4), Q15_SCALE));
+        vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+    }
+#endif
+    return i;
+}
+
+static size_t i16_to_q31_simd(const int16_t *src, int32_t *dst, size_t count)
+{
+    size_t i = 0;
+#if defined(FORMAT_CONVERT_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= count; i += 8) {
+        const __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_unpacklo_epi16(zero, x));
+        _mm_storeu_si128((__m128i *)(dst + i + 4), _mm_unpackhi_epi16(zero, x));
+    }
+#elif defined(FORMAT_CONVERT_NEON)
+    for (; i + 8 <= count; i += 8) {
+        const int16x8_t x = vld1q_s16(src + i);
+        vst1q_s32(dst + i, vshll_n_s16(vget_low_s16(x), 16));
+        vst1q_s32(dst + i + 4, vshll_n_s16(vget_high_s16(x), 16));
+    }
+#endif
+    return i;
+}
+
+static size_t q31_to_i16_simd(const int32_t *src, int16_t *dst, size_t count)
+{
+    size_t i = 0;
+#if defined(FORMAT_CONVERT_SSE2)
+    for (; i + 8 <= count; i += 8) {
+        const __m128i lo = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(src + i)), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(src + i + 4)), 16);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(lo, hi));
+    }
+#elif defined(FORMAT_CONVERT_NEON)
+    for (; i + 8 <= count; i += 8) {
+        const int16x4_t lo = vshrn_n_s32(vld1q_s32(src + i), 16);
+        const int16x4_t hi = vshrn_n_s32(vld1q_s32(src + i + 4), 16);
+        vst1q_s16(dst + i, vcombine_s16(lo, hi));
+    }
+#endif
+    return i;
+}
+
+static size_t q31_to_float_simd(const int32_t *src, float *dst, size_t count)
+{
+    size_t i = 0;
+#if defined(FORMAT_CONVERT_SSE2)
+    const __m128 scale = _mm_set1_ps(1.0f / Q31_SCALE);
+    for (; i + 4 <= count; i += 4) {
+        const __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(x), scale));
+    }
+#elif defined(FORMAT_CONVERT_NEON)
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(src + i)), 1.0f / Q31_SCALE));
+    }
+#endif
+    return i;
+}
+
+static size_t float_to_q31_simd(const float *src, int32_t *dst, size_t count)
+{
+    size_t i = 0;
+#if defined(FORMAT_CONVERT_SSE2)
+    const __m128 scale = _mm_set1_ps(Q31_SCALE);
+    for (; i + 4 <= count; i += 4) {
+        const __m128 s = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+        /* cvtps gives 0x80000000 when out of range; flip it to INT32_MAX on the positive side */
+        const __m128i overflow = _mm_castps_si128(_mm_cmpge_ps(s, scale));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(_mm_cvtps_epi32(s), overflow));
+    }
+#elif defined(FORMAT_CONVERT_NEON)
+    for (; i + 4 <= count; i += 4) {
+        vst1q_s32(dst + i, neon_round_f32(vmulq_n_f32(vld1q_f32(src + i), Q31_SCALE)));
+    }
+#endif
+    return i;
+}
+
+/* Channel loops for the usual mono <-> stereo cases. */
+static size_t mono_to_stereo_16_simd(const int16_t *src, int16_t *dst, size_t frames)
+{
+    size_t i = 0;
+#if defined(FORMAT_CONVERT_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= frames; i += 8) {
+        const __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_unpacklo_epi16(x, zero));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i + 8), _mm_unpackhi_epi16(x, zero));
+    }
+#elif defined(FORMAT_CONVERT_NEON)
+    int16x8x2_t pair;
+    pair.val[1] = vdupq_n_s16(0);
+    for (; i + 8 <= frames; i += 8) {
+        pair.val[0] = vld1q_s16(src + i);
+        vst2q_s16(dst + 2 * i, pair);
+    }
+#endif
+    return i;
+}
+
+static size_t stereo_to_mono_16_simd(const int16_t *src, int16_t *dst, size_t frames)
+{
+    size_t i = 0;
+#if defined(FORMAT_CONVERT_SSE2)
+    for (; i + 8 <= frames; i += 8) {
+        /* keep the left sample of each 32-bit pair, sign extended, then pack back to 16 bits */
+        const __m128i a = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+        const __m128i b = _mm_loadu_si128((const __m128i *)(src + 2 * i + 8));
+        _mm_storeu_si128((__m128i *)(dst + i),
+                _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16),
+                                _mm_srai_epi32(_mm_slli_epi32(b, 16), 16)));
+    }
+#elif defined(FORMAT_CONVERT_NEON)
+    for (; i + 8 <= frames; i += 8) {
+        vst1q_s16(dst + i, vld2q_s16(src + 2 * i).val[0]);
+    }
+#endif
+    return i;
+}
+
+static size_t mono_to_stereo_32_simd(const int32_t *src, int32_t *dst, size_t frames)
+{
+    size_t i = 0;
+#if defined(FORMAT_CONVERT_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= frames; i += 4) {
+        const __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_unpacklo_epi32(x, zero));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i + 4), _mm_unpackhi_epi32(x, zero));
+    }
+#elif defined(FORMAT_CONVERT_NEON)
+    int32x4x2_t pair;
+    pair.val[1] = vdupq_n_s32(0);
+    for (; i + 4 <= frames; i += 4) {
+        pair.val[0] = vld1q_s32(src + i);
+        vst2q_s32(dst + 2 * i, pair);
+    }
+#endif
+    return i;
+}
+
+static size_t stereo_to_mono_32_simd(const int32_t *src, int32_t *dst, size_t frames)
+{
+    size_t i = 0;
+#if defined(FORMAT_CONVERT_SSE2)
+    for (; i + 4 <= frames; i += 4) {
+        const __m128 a = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(src + 2 * i)));
+        const __m128 b = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(src + 2 * i + 4)));
+        _mm_storeu_si128((__m128i *)(dst + i),
+                _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))));
+    }
+#elif defined(FORMAT_CONVERT_NEON)
+    for (; i + 4 <= frames; i += 4) {
+        vst1q_s32(dst + i, vld2q_s32(src + 2 * i).val[0]);
+    }
+#endif
+    return i;
+}
+
+/*
+ * Sample conversions: the vector loop, then the scalar tail.
+ */
+static void i16_to_float(const int16_t *src, float *dst, size_t count)
+{
+    size_t i = simd_enabled ? i16_to_float_simd(src, dst, count) : 0;
+    for (; i < count; i++) {
+        dst[i] = src[i] * (1.0f / Q15_SCALE);
+    }
+}
+
+static void float_to_i16(const float *src, int16_t *dst, size_t count)
+{
+    size_t i = simd_enabled ? float_to_i16_simd(src, dst, count) : 0;
+    for (; i < count; i++) {
+        dst[i] = i16_from_float(src[i]);
+    }
+}
+
+static void i16_to_q31(const int16_t *src, int32_t *dst, size_t count)
+{
+    size_t i = simd_enabled ? i16_to_q31_simd(src, dst, count) : 0;
+    for (; i < count; i++) {
+        dst[i] = (int32_t)((uint32_t)(uint16_t)src[i] << 16);
+    }
+}
+
+static void q31_to_i16(const int32_t *src, int16_t *dst, size_t count)
+{
+    size_t i = simd_enabled ? q31_to_i16_simd(src, dst, count) : 0;
+    for (; i < count; i++) {
+        dst[i] = (int16_t)(src[i] >> 16);
+    }
+}
+
+static void i16_to_p24(const int16_t *src, uint8_t *dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++, dst += 3) {
+        dst[0] = 0;
+        dst[1] = (uint8_t)src[i];
+        dst[2] = (uint8_t)(src[i] >> 8);
+    }
+}
+
+static void p24_to_i16(const uint8_t *src, int16_t *dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++, src += 3) {
+        dst[i] = (int16_t)(src[1] | (src[2] << 8));
+    }
+}
+
+/* Any supported format to and from Q0.31, for the pairs without a direct conversion. */
+static void to_q31(const void *src, audio_format_t format, int32_t *dst, size_t count)
+{
+    size_t i = 0;
+    switch (format) {
+    case AUDIO_FORMAT_PCM_16_BIT:
+        i16_to_q31((const int16_t *)src, dst, count);
+        break;
+    case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+        for (const uint8_t *p = (const uint8_t *)src; i < count; i++, p += 3) {
+            dst[i] = q31_from_p24(p);
+        }
+        break;
+    case AUDIO_FORMAT_PCM_8_24_BIT:
+        for (; i < count; i++) {
+            dst[i] = q31_from_q8_23(((const int32_t *)src)[i]);
+        }
+        break;
+    case AUDIO_FORMAT_PCM_32_BIT:
+        memcpy(dst, src, count * sizeof(int32_t));
+        break;
+    case AUDIO_FORMAT_PCM_FLOAT:
+        i = simd_enabled ? float_to_q31_simd((const float *)src, dst, count) : 0;
+        for (; i < count; i++) {
+            dst[i] = q31_from_float(((const float *)src)[i]);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void from_q31(const int32_t *src, void *dst, audio_format_t format, size_t count)
+{
+    size_t i = 0;
+    switch (format) {
+    case AUDIO_FORMAT_PCM_16_BIT:
+        q31_to_i16(src, (int16_t *)dst, count);
+        break;
+    case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+        for (uint8_t *p = (uint8_t *)dst; i < count; i++, p += 3) {
+            p24_from_q31(p, src[i]);
+        }
+        break;
+    case AUDIO_FORMAT_PCM_8_24_BIT:
+        for (; i < count; i++) {
+            ((int32_t *)dst)[i] = src[i] >> 8;
+        }
+        break;
+    case AUDIO_FORMAT_PCM_32_BIT:
+        memcpy(dst, src, count * sizeof(int32_t));
+        break;
+    case AUDIO_FORMAT_PCM_FLOAT:
+        i = simd_enabled ? q31_to_float_simd(src, (float *)dst, count) : 0;
+        for (; i < count; i++) {
+            ((float *)dst)[i] = (float)src[i] * (1.0f / Q31_SCALE);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void format_convert_samples(const void *src, audio_format_t src_format,
+                            void *dst, audio_format_t dst_format, size_t samples)
+{
+    if (src_format == dst_format) {
+        memcpy(dst, src, samples * audio_bytes_per_sample(src_format));
+        return;
+    }
+
+    /* 16-bit on one side covers nearly all devices and streams; convert those directly. */
+    if (src_format == AUDIO_FORMAT_PCM_16_BIT) {
+        switch (dst_format) {
+        case AUDIO_FORMAT_PCM_FLOAT:
+            i16_to_float((const int16_t *)src, (float *)dst, samples);
+            return;
+        case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+            i16_to_p24((const int16_t *)src, (uint8_t *)dst, samples);
+            return;
+        default:
+            break;
+        }
+    } else if (dst_format == AUDIO_FORMAT_PCM_16_BIT) {
+        switch (src_format) {
+        case AUDIO_FORMAT_PCM_FLOAT:
+            float_to_i16((const float *)src, (int16_t *)dst, samples);
+            return;
+        case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+            p24_to_i16((const uint8_t *)src, (int16_t *)dst, samples);
+            return;
+        default:
+            break;
+        }
+    }
+
+    if (dst_format == AUDIO_FORMAT_PCM_32_BIT) {
+        to_q31(src, src_format, (int32_t *)dst, samples);
+        return;
+    }
+    if (src_format == AUDIO_FORMAT_PCM_32_BIT) {
+        from_q31((const int32_t *)src, dst, dst_format, samples);
+        return;
+    }
+
+    int32_t scratch[SCRATCH_SAMPLES];
+    const size_t src_sample_size = audio_bytes_per_sample(src_format);
+    const size_t dst_sample_size = audio_bytes_per_sample(dst_format);
+    const uint8_t *in = (const uint8_t *)src;
+    uint8_t *out = (uint8_t *)dst;
+    while (samples > 0) {
+        const size_t count = samples < SCRATCH_SAMPLES ? samples : SCRATCH_SAMPLES;
+        to_q31(in, src_format, scratch, count);
+        from_q31(scratch, out, dst_format, count);
+        in += count * src_sample_size;
+        out += count * dst_sample_size;
+        samples -= count;
+    }
+}
+
+/*
+ * Drops or zero-fills channels, one frame at a time. type is the sample type; for packed
+ * 24-bit the generic byte version below is used instead.
+ */
+#define ADJUST_CHANNELS(type, src, src_channels, dst, dst_channels, frames) \
+{ \
+    const type *in = (const type *)(src); \
+    type *out = (type *)(dst); \
+    const unsigned copied = (src_channels) < (dst_channels) ? (src_channels) : (dst_channels); \
+    for (size_t frame = 0; frame < (frames); frame++) { \
+        unsigned channel = 0; \
+        for (; channel < copied; channel++) { \
+            out[channel] = in[channel]; \
+        } \
+        for (; channel < (dst_channels); channel++) { \
+            out[channel] = 0; \
+        } \
+        in += (src_channels); \
+        out += (dst_channels); \
+    } \
+}
+
+void format_convert_channels(const void *src, unsigned src_channels,
+                             void *dst, unsigned dst_channels,
+                             size_t sample_size, size_t frames)
+{
+    if (src_channels == dst_channels) {
+        memcpy(dst, src, frames * src_channels * sample_size);
+        return;
+    }
+
+    /* Pairs of 16-bit channels move together, so stereo to quad is mono to stereo at 32 bits. */
+    if (sample_size == sizeof(int16_t) && src_channels % 2 == 0 && dst_channels % 2 == 0 &&
+            ((uintptr_t)src | (uintptr_t)dst) % sizeof(int32_t) == 0) {
+        src_channels /= 2;
+        dst_channels /= 2;
+        sample_size = sizeof(int32_t);
+    }
+
+    size_t done = 0;
+    if (simd_enabled) {
+        if (sample_size == sizeof(int16_t) && src_channels == 1 && dst_channels == 2) {
+            done = mono_to_stereo_16_simd((const int16_t *)src, (int16_t *)dst, frames);
+        } else if (sample_size == sizeof(int16_t) && src_channels == 2 && dst_channels == 1) {
+            done = stereo_to_mono_16_simd((const int16_t *)src, (int16_t *)dst, frames);
+        } else if (sample_size == sizeof(int32_t) && src_channels == 1 && dst_channels == 2) {
+            done = mono_to_stereo_32_simd((const int32_t *)src, (int32_t *)dst, frames);
+        } else if (sample_size == sizeof(int32_t) && src_channels == 2 && dst_channels == 1) {
+            done = stereo_to_mono_32_simd((const int32_t *)src, (int32_t *)dst, frames);
+        }
+    }
+    src = (const uint8_t *)src + done * src_channels * sample_size;
+    dst = (uint8_t *)dst + done * dst_channels * sample_size;
+    frames -= done;
+
+    switch (sample_size) {
+    case sizeof(int16_t):
+        ADJUST_CHANNELS(int16_t, src, src_channels, dst, dst_channels, frames);
+        break;
+    case sizeof(int32_t):
+        ADJUST_CHANNELS(int32_t, src, src_channels, dst, dst_channels, frames);
+        break;
+    default: {
+        const uint8_t *in = (const uint8_t *)src;
+        uint8_t *out = (uint8_t *)dst;
+        const size_t src_frame_size = src_channels * sample_size;
+        const size_t dst_frame_size = dst_channels * sample_size;
+        const size_t copied = src_frame_size < dst_frame_size ? src_frame_size : dst_frame_size;
+        for (size_t frame = 0; frame < frames; frame++) {
+            memcpy(out, in, copied);
+            memset(out + copied, 0, dst_frame_size - copied);
+            in += src_frame_size;
+            out += dst_frame_size;
+        }
+        break;
+    }
+    }
+}
+
+bool format_convert_is_supported(audio_format_t format)
+{
+    switch (format) {
+    case AUDIO_FORMAT_PCM_16_BIT:
+    case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+    case AUDIO_FORMAT_PCM_8_24_BIT:
+    case AUDIO_FORMAT_PCM_32_BIT:
+    case AUDIO_FORMAT_PCM_FLOAT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool format_convert_init(struct format_convert *conv,
+                         audio_format_t src_format, unsigned src_channels,
+                         audio_format_t dst_format, unsigned dst_channels)
+{
+    if (!format_convert_is_supported(src_format) || !format_convert_is_supported(dst_format) ||
+            src_channels == 0 || src_channels > FORMAT_CONVERT_MAX_CHANNELS ||
+            dst_channels == 0 || dst_channels > FORMAT_CONVERT_MAX_CHANNELS) {
+        return false;
+    }
+    conv->src_format = src_format;
+    conv->src_channels = src_channels;
+    conv->dst_format = dst_format;
+    conv->dst_channels = dst_channels;
+    return true;
+}
+
+bool format_convert_is_identity(const struct format_convert *conv)
+{
+    return conv->src_format == conv->dst_format && conv->src_channels == conv->dst_channels;
+}
+
+size_t format_convert_src_frame_size(const struct format_convert *conv)
+{
+    return audio_bytes_per_sample(conv->src_format) * conv->src_channels;
+}
+
+size_t format_convert_dst_frame_size(const struct format_convert *conv)
+{
+    return audio_bytes_per_sample(conv->dst_format) * conv->dst_channels;
+}
+
+size_t format_convert_frames(const struct format_convert *conv,
+                             const void *src, void *dst, size_t frames)
+{
+    const size_t src_sample_size = audio_bytes_per_sample(conv->src_format);
+    const size_t dst_sample_size = audio_bytes_per_sample(conv->dst_format);
+    const size_t dst_bytes = frames * conv->dst_channels * dst_sample_size;
+
+    if (conv->src_format == conv->dst_format) {
+        format_convert_channels(src, conv->src_channels, dst, conv->dst_channels,
+                                src_sample_size, frames);
+        return dst_bytes;
+    }
+    if (conv->src_channels == conv->dst_channels) {
+        format_convert_samples(src, conv->src_format, dst, conv->dst_format,
+                               frames * conv->src_channels);
+        return dst_bytes;
+    }
+
+    /*
+     * Both change. Work on the fewer channels: drop channels before converting the samples,
+     * add them after. The intermediate step goes through a stack buffer.
+     */
+    int32_t scratch[SCRATCH_SAMPLES];
+    const uint8_t *in = (const uint8_t *)src;
+    uint8_t *out = (uint8_t *)dst;
+    if (conv->dst_channels < conv->src_channels) {
+        const size_t chunk = sizeof(scratch) / (src_sample_size * conv->dst_channels);
+        while (frames > 0) {
+            const size_t count = frames < chunk ? frames : chunk;
+            format_convert_channels(in, conv->src_channels, scratch, conv->dst_channels,
+                                    src_sample_size, count);
+            format_convert_samples(scratch, conv->src_format, out, conv->dst_format,
+                                   count * conv->dst_channels);
+            in += count * conv->src_channels * src_sample_size;
+            out += count * conv->dst_channels * dst_sample_size;
+            frames -= count;
+        }
+    } else {
+        const size_t chunk = sizeof(scratch) / (dst_sample_size * conv->src_channels);
+        while (frames > 0) {
+            const size_t count = frames < chunk ? frames : chunk;
+            format_convert_samples(in, conv->src_format, scratch, conv->dst_format,
+                                   count * conv->src_channels);
+            format_convert_channels(scratch, conv->src_channels, out, conv->dst_channels,
+                                    dst_sample_size, count);
+            in += count * conv->src_channels * src_sample_size;
+            out += count * conv->dst_channels * dst_sample_size;
+            frames -= count;
+        }
+    }
+    return dst_bytes;
+}
+
+bool format_convert_set_simd_enabled(bool enabled)
+{
+#if defined(FORMAT_CONVERT_SSE2) || defined(FORMAT_CONVERT_NEON)
+    simd_enabled = enabled;
+    return true;
+#else
+    simd_enabled = false;
+    return false;
+#endif
+}
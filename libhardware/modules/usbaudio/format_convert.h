@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_USBAUDIO_FORMAT_CONVERT_H
+#define ANDROID_HARDWARE_USBAUDIO_FORMAT_CONVERT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <system/audio.h>
+
+__BEGIN_DECLS
+
+/*
+ * Sample format and channel count conversion between what AudioFlinger sees and what the
+ * USB device was opened with.
+ *
+ * Supported formats are AUDIO_FORMAT_PCM_16_BIT, AUDIO_FORMAT_PCM_24_BIT_PACKED,
+ * AUDIO_FORMAT_PCM_8_24_BIT, AUDIO_FORMAT_PCM_32_BIT and AUDIO_FORMAT_PCM_FLOAT, with up to
+ * FORMAT_CONVERT_MAX_CHANNELS channels. Channels are adjusted the way adjust_channels() in
+ * audio_utils does it: extra source channels are dropped and missing ones are zero-filled.
+ *
+ * The inner loops use SSE2 or NEON when the compiler targets them, with a scalar version for
+ * everything else and for the tail of each buffer. Narrowing integer conversions truncate;
+ * conversions from float round to nearest and clamp.
+ */
+
+#define FORMAT_CONVERT_MAX_CHANNELS 32
+
+struct format_convert {
+    audio_format_t src_format;
+    unsigned src_channels;
+    audio_format_t dst_format;
+    unsigned dst_channels;
+};
+
+bool format_convert_is_supported(audio_format_t format);
+
+/*
+ * Sets up a conversion. Returns false if either format is not supported or a channel count is
+ * zero or above FORMAT_CONVERT_MAX_CHANNELS.
+ */
+bool format_convert_init(struct format_convert *conv,
+                         audio_format_t src_format, unsigned src_channels,
+                         audio_format_t dst_format, unsigned dst_channels);
+
+/* True if the formats and channel counts match and the data can be used as is. */
+bool format_convert_is_identity(const struct format_convert *conv);
+
+size_t format_convert_src_frame_size(const struct format_convert *conv);
+size_t format_convert_dst_frame_size(const struct format_convert *conv);
+
+/*
+ * Converts frames from src into dst and returns the number of bytes written to dst.
+ * src and dst must not overlap.
+ */
+size_t format_convert_frames(const struct format_convert *conv,
+                             const void *src, void *dst, size_t frames);
+
+/*
+ * Building blocks of format_convert_frames(), for callers that only need one of them.
+ * Neither allocates; src and dst must not overlap.
+ */
+void format_convert_channels(const void *src, unsigned src_channels,
+                             void *dst, unsigned dst_channels,
+                             size_t sample_size, size_t frames);
+void format_convert_samples(const void *src, audio_format_t src_format,
+                            void *dst, audio_format_t dst_format, size_t samples);
+
+/*
+ * Turns the SSE2/NEON loops off or back on, for tests and benchmarks that compare them with the
+ * scalar code. Returns false if this build has no vector loops. Not thread safe.
+ */
+bool format_convert_set_simd_enabled(bool enabled);
+
+__END_DECLS
+
+#endif /* ANDROID_HARDWARE_USBAUDIO_FORMAT_CONVERT_H */
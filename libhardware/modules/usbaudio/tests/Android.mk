@@ -0,0 +1,17 @@
+LOCAL_PATH := $(call my-dir)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	format_convert_benchmark.c \
+	../format_convert.c
+
+LOCAL_MODULE := format_convert_benchmark
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/..
+
+LOCAL_CFLAGS := -Wno-unused-parameter -O2
+
+LOCAL_LDLIBS += -lm -lrt
+
+include $(BUILD_HOST_EXECUTABLE)
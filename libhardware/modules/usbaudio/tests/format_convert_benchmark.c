@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "format_convert.h"
+
+/*
+ * Checks the vector loops of format_convert against the scalar code, then times both on the
+ * conversions the USB HAL meets with common devices.
+ *
+ * Run it like this:
+ *
+ * make format_convert_benchmark -j32 && \
+ * out/host/linux-x86/obj/EXECUTABLES/format_convert_benchmark_intermediates/format_convert_benchmark \
+ *     -f 480 -n 20000
+ *
+ * -f is the frames per buffer (480 is 10 ms at 48 kHz) and -n the buffers converted per case.
+ * The checks use an odd frame count and buffers that are not 16-byte aligned, so the scalar
+ * tails and the unaligned vector loads run too.
+ */
+
+#define CHECK_FRAMES 1021
+/* Offset of the checked buffers from malloc()'s alignment; keeps samples naturally aligned. */
+#define CHECK_OFFSET 4
+
+struct conversion_case {
+    const char *name;
+    audio_format_t src_format;
+    unsigned src_channels;
+    audio_format_t dst_format;
+    unsigned dst_channels;
+};
+
+static const struct conversion_case cases[] = {
+    /* channel count only: AudioFlinger stereo against mono, quad and 8 channel devices */
+    { "16 stereo -> 16 mono",       AUDIO_FORMAT_PCM_16_BIT, 2, AUDIO_FORMAT_PCM_16_BIT, 1 },
+    { "16 mono -> 16 stereo",       AUDIO_FORMAT_PCM_16_BIT, 1, AUDIO_FORMAT_PCM_16_BIT, 2 },
+    { "16 stereo -> 16 quad",       AUDIO_FORMAT_PCM_16_BIT, 2, AUDIO_FORMAT_PCM_16_BIT, 4 },
+    { "16 8ch -> 16 stereo",        AUDIO_FORMAT_PCM_16_BIT, 8, AUDIO_FORMAT_PCM_16_BIT, 2 },
+    { "24p stereo -> 24p mono",     AUDIO_FORMAT_PCM_24_BIT_PACKED, 2,
+                                    AUDIO_FORMAT_PCM_24_BIT_PACKED, 1 },
+    { "32 stereo -> 32 mono",       AUDIO_FORMAT_PCM_32_BIT, 2, AUDIO_FORMAT_PCM_32_BIT, 1 },
+    { "32 mono -> 32 stereo",       AUDIO_FORMAT_PCM_32_BIT, 1, AUDIO_FORMAT_PCM_32_BIT, 2 },
+    /* sample format only */
+    { "16 -> float",                AUDIO_FORMAT_PCM_16_BIT, 2, AUDIO_FORMAT_PCM_FLOAT, 2 },
+    { "float -> 16",                AUDIO_FORMAT_PCM_FLOAT, 2, AUDIO_FORMAT_PCM_16_BIT, 2 },
+    { "16 -> 24p",                  AUDIO_FORMAT_PCM_16_BIT, 2, AUDIO_FORMAT_PCM_24_BIT_PACKED, 2 },
+    { "24p -> 16",                  AUDIO_FORMAT_PCM_24_BIT_PACKED, 2, AUDIO_FORMAT_PCM_16_BIT, 2 },
+    { "16 -> 32",                   AUDIO_FORMAT_PCM_16_BIT, 2, AUDIO_FORMAT_PCM_32_BIT, 2 },
+    { "32 -> 16",                   AUDIO_FORMAT_PCM_32_BIT, 2, AUDIO_FORMAT_PCM_16_BIT, 2 },
+    { "8_24 -> 16",                 AUDIO_FORMAT_PCM_8_24_BIT, 2, AUDIO_FORMAT_PCM_16_BIT, 2 },
+    { "float -> 32",                AUDIO_FORMAT_PCM_FLOAT, 2, AUDIO_FORMAT_PCM_32_BIT, 2 },
+    { "32 -> float",                AUDIO_FORMAT_PCM_32_BIT, 2, AUDIO_FORMAT_PCM_FLOAT, 2 },
+    { "float -> 24p",               AUDIO_FORMAT_PCM_FLOAT, 2, AUDIO_FORMAT_PCM_24_BIT_PACKED, 2 },
+    { "24p -> float",               AUDIO_FORMAT_PCM_24_BIT_PACKED, 2, AUDIO_FORMAT_PCM_FLOAT, 2 },
+    /* both */
+    { "float stereo -> 16 mono",    AUDIO_FORMAT_PCM_FLOAT, 2, AUDIO_FORMAT_PCM_16_BIT, 1 },
+    { "16 mono -> float stereo",    AUDIO_FORMAT_PCM_16_BIT, 1, AUDIO_FORMAT_PCM_FLOAT, 2 },
+    { "24p stereo -> 16 mono",      AUDIO_FORMAT_PCM_24_BIT_PACKED, 2, AUDIO_FORMAT_PCM_16_BIT, 1 },
+    { "16 stereo -> 32 quad",       AUDIO_FORMAT_PCM_16_BIT, 2, AUDIO_FORMAT_PCM_32_BIT, 4 },
+};
+
+static bool has_simd;
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Random samples at full scale; floats go a little past +-1 to exercise the clamping. */
+static void fill_random(void *buffer, audio_format_t format, size_t samples)
+{
+    size_t i;
+    switch (format) {
+    case AUDIO_FORMAT_PCM_16_BIT:
+        for (i = 0; i < samples; i++) {
+            ((int16_t *)buffer)[i] = (int16_t)rand();
+        }
+        break;
+    case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+        for (i = 0; i < samples * 3; i++) {
+            ((uint8_t *)buffer)[i] = (uint8_t)rand();
+        }
+        break;
+    case AUDIO_FORMAT_PCM_8_24_BIT:
+        for (i = 0; i < samples; i++) {
+            ((int32_t *)buffer)[i] = (rand() & 0xffffff) - 0x800000;
+        }
+        break;
+    case AUDIO_FORMAT_PCM_32_BIT:
+        for (i = 0; i < samples; i++) {
+            ((int32_t *)buffer)[i] = (int32_t)(((uint32_t)rand() << 16) ^ (uint32_t)rand());
+        }
+        break;
+    case AUDIO_FORMAT_PCM_FLOAT:
+        for (i = 0; i < samples; i++) {
+            ((float *)buffer)[i] = (float)rand() / RAND_MAX * 2.4f - 1.2f;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static int64_t sample_at(const void *buffer, audio_format_t format, size_t i)
+{
+    const uint8_t *p;
+    switch (format) {
+    case AUDIO_FORMAT_PCM_16_BIT:
+        return ((const int16_t *)buffer)[i];
+    case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+        p = (const uint8_t *)buffer + 3 * i;
+        return (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24) >> 8;
+    default:
+        return ((const int32_t *)buffer)[i];
+    }
+}
+
+/*
+ * Compares the vector and scalar results. Conversions from float to integer may differ by one
+ * where ARMv7 NEON rounds a tie the other way; everything else must match exactly.
+ */
+static bool compare(const struct conversion_case *c, const void *simd, const void *scalar,
+                    size_t samples)
+{
+    if (c->dst_format == AUDIO_FORMAT_PCM_FLOAT || c->src_format != AUDIO_FORMAT_PCM_FLOAT) {
+        if (memcmp(simd, scalar, samples * audio_bytes_per_sample(c->dst_format)) == 0) {
+            return true;
+        }
+        printf("  %s: vector and scalar results differ\n", c->name);
+        return false;
+    }
+    for (size_t i = 0; i < samples; i++) {
+        const int64_t diff = sample_at(simd, c->dst_format, i) - sample_at(scalar, c->dst_format, i);
+        if (diff > 1 || diff < -1) {
+            printf("  %s: sample %zu is %lld, expected %lld\n", c->name, i,
+                   (long long)sample_at(simd, c->dst_format, i),
+                   (long long)sample_at(scalar, c->dst_format, i));
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool check_case(const struct conversion_case *c)
+{
+    struct format_convert conv;
+    if (!format_convert_init(&conv, c->src_format, c->src_channels,
+                             c->dst_format, c->dst_channels)) {
+        printf("  %s: not supported\n", c->name);
+        return false;
+    }
+    const size_t src_bytes = CHECK_FRAMES * format_convert_src_frame_size(&conv);
+    const size_t dst_bytes = CHECK_FRAMES * format_convert_dst_frame_size(&conv);
+    uint8_t *src = malloc(src_bytes + CHECK_OFFSET);
+    uint8_t *simd = malloc(dst_bytes + CHECK_OFFSET);
+    uint8_t *scalar = malloc(dst_bytes);
+    fill_random(src + CHECK_OFFSET, c->src_format, CHECK_FRAMES * c->src_channels);
+
+    bool ok = true;
+    format_convert_set_simd_enabled(true);
+    if (format_convert_frames(&conv, src + CHECK_OFFSET, simd + CHECK_OFFSET, CHECK_FRAMES)
+            != dst_bytes) {
+        printf("  %s: wrong byte count\n", c->name);
+        ok = false;
+    }
+    format_convert_set_simd_enabled(false);
+    format_convert_frames(&conv, src + CHECK_OFFSET, scalar, CHECK_FRAMES);
+    ok = ok && compare(c, simd + CHECK_OFFSET, scalar, CHECK_FRAMES * c->dst_channels);
+
+    free(src);
+    free(simd);
+    free(scalar);
+    return ok;
+}
+
+/* Known values, so a mistake shared by both implementations still shows up. */
+static bool check_values(void)
+{
+    bool ok = true;
+    const int16_t i16[4] = { 0, -32768, 32767, 16384 };
+    float f[4];
+    format_convert_samples(i16, AUDIO_FORMAT_PCM_16_BIT, f, AUDIO_FORMAT_PCM_FLOAT, 4);
+    ok = ok && f[0] == 0.0f && f[1] == -1.0f && f[2] == 32767.0f / 32768.0f && f[3] == 0.5f;
+
+    const float clip[4] = { 1.0f, 2.0f, -1.0f, -3.0f };
+    int16_t clipped[4];
+    int32_t clipped32[4];
+    format_convert_samples(clip, AUDIO_FORMAT_PCM_FLOAT, clipped, AUDIO_FORMAT_PCM_16_BIT, 4);
+    ok = ok && clipped[0] == 32767 && clipped[1] == 32767 &&
+            clipped[2] == -32768 && clipped[3] == -32768;
+    format_convert_samples(clip, AUDIO_FORMAT_PCM_FLOAT, clipped32, AUDIO_FORMAT_PCM_32_BIT, 4);
+    ok = ok && clipped32[0] == INT32_MAX && clipped32[1] == INT32_MAX &&
+            clipped32[2] == INT32_MIN && clipped32[3] == INT32_MIN;
+
+    uint8_t p24[6];
+    format_convert_samples(i16 + 1, AUDIO_FORMAT_PCM_16_BIT, p24,
+                           AUDIO_FORMAT_PCM_24_BIT_PACKED, 2);
+    ok = ok && p24[0] == 0 && p24[1] == 0x00 && p24[2] == 0x80 &&
+            p24[3] == 0 && p24[4] == 0xff && p24[5] == 0x7f;
+
+    /* channels are dropped or zero-filled, never mixed */
+    const int16_t stereo[4] = { 1, 2, 3, 4 };
+    int16_t mono[2], quad[8];
+    format_convert_channels(stereo, 2, mono, 1, sizeof(int16_t), 2);
+    ok = ok && mono[0] == 1 && mono[1] == 3;
+    format_convert_channels(stereo, 2, quad, 4, sizeof(int16_t), 2);
+    ok = ok && quad[0] == 1 && quad[1] == 2 && quad[2] == 0 && quad[3] == 0 &&
+            quad[4] == 3 && quad[5] == 4 && quad[6] == 0 && quad[7] == 0;
+
+    if (!ok) {
+        printf("  known values: wrong\n");
+    }
+    return ok;
+}
+
+/* Returns the average ns per frame of converting buffers of frames. */
+static double time_case(const struct format_convert *conv, const void *src, void *dst,
+                        size_t frames, int buffers)
+{
+    const int64_t start = now_ns();
+    for (int i = 0; i < buffers; i++) {
+        format_convert_frames(conv, src, dst, frames);
+    }
+    return (double)(now_ns() - start) / ((double)buffers * frames);
+}
+
+static void benchmark(size_t frames, int buffers)
+{
+    printf("\n%-26s %12s %12s %8s\n", "conversion", "scalar ns/f", "simd ns/f", "speedup");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const struct conversion_case *c = &cases[i];
+        struct format_convert conv;
+        format_convert_init(&conv, c->src_format, c->src_channels, c->dst_format, c->dst_channels);
+        void *src = malloc(frames * format_convert_src_frame_size(&conv));
+        void *dst = malloc(frames * format_convert_dst_frame_size(&conv));
+        fill_random(src, c->src_format, frames * c->src_channels);
+
+        format_convert_set_simd_enabled(false);
+        time_case(&conv, src, dst, frames, buffers / 10 + 1);
+        const double scalar = time_case(&conv, src, dst, frames, buffers);
+        if (has_simd) {
+            format_convert_set_simd_enabled(true);
+            time_case(&conv, src, dst, frames, buffers / 10 + 1);
+            const double simd = time_case(&conv, src, dst, frames, buffers);
+            printf("%-26s %12.3f %12.3f %7.2fx\n", c->name, scalar, simd, scalar / simd);
+        } else {
+            printf("%-26s %12.3f %12s %8s\n", c->name, scalar, "-", "-");
+        }
+
+        free(src);
+        free(dst);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t frames = 480;
+    int buffers = 20000;
+    int opt;
+    while ((opt = getopt(argc, argv, "f:n:")) != -1) {
+        switch (opt) {
+        case 'f':
+            frames = strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            buffers = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-f frames per buffer] [-n buffers per case]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (frames == 0 || buffers <= 0) {
+        fprintf(stderr, "frames and buffers must be positive\n");
+        return 1;
+    }
+
+    srand(1);
+    has_simd = format_convert_set_simd_enabled(true);
+    printf("vector loops: %s\n", has_simd ? "yes" : "no, scalar only");
+
+    bool ok = check_values();
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        ok = check_case(&cases[i]) && ok;
+    }
+    if (!ok) {
+        printf("SOMETHING FAILED\n");
+        return 1;
+    }
+    printf("ALL PASSED\n");
+
+    benchmark(frames, buffers);
+    return 0;
+}
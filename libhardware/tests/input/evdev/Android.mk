@@ -6,7 +6,9 @@ LOCAL_C_INCLUDES += hardware/libhardware/modules/input/evdev
 LOCAL_SRC_FILES:= \
     InputDevice_test.cpp \
     InputHub_test.cpp \
-    TestHelpers.cpp
+    PipeInputHub.cpp \
+    TestHelpers.cpp \
+    TouchCoalescer_test.cpp
 
 LOCAL_SHARED_LIBRARIES := \
     libinput_evdev \
@@ -21,3 +23,27 @@ LOCAL_MODULE := libinput_evdevtests
 LOCAL_MODULE_TAGS := tests
 
 include $(BUILD_NATIVE_TEST)
+
+# InputHub benchmark, with fifos for devices
+include $(CLEAR_VARS)
+
+LOCAL_C_INCLUDES += hardware/libhardware/modules/input/evdev
+
+LOCAL_SRC_FILES:= \
+    InputHub_benchmark.cpp \
+    PipeInputHub.cpp \
+    TestHelpers.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+    libinput_evdev \
+    liblog \
+    libutils
+
+LOCAL_CLANG := true
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter
+LOCAL_CPPFLAGS += -std=c++14
+
+LOCAL_MODULE := InputHub_benchmark
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_EXECUTABLE)
@@ -25,6 +25,7 @@
 
 #include "InputDevice.h"
 #include "InputHub.h"
+#include "TestHelpers.h"
 
 // # of milliseconds to allow for timing measurements
 #define TIMING_TOLERANCE_MS 25
@@ -130,5 +131,35 @@ TEST(EvdevDeviceTest, testClockCorrectionOk) {
     EXPECT_NEAR(now, event.when, ms2ns(TIMING_TOLERANCE_MS));
 }
 
+TEST(EvdevDeviceTest, testTouchCoalescing) {
+    auto node = std::make_shared<MockInputDeviceNode>();
+    auto device = std::make_unique<EvdevDevice>(node);
+    ASSERT_TRUE(device != nullptr);
+
+    std::vector<TouchFrame> frames;
+    device->enableTouchCoalescing(TouchCoalescerConfig(),
+            [&](const TouchFrame& frame) { frames.push_back(frame); });
+
+    // The touch frame takes the time override like any other event.
+    auto events = parseEventScript(R"(
+[       0.000002] 0004 0006 00000001
+[       0.000002] 0004 0007 000dbba0
+[       0.000002] 0003 0039 00000005
+[       0.000002] 0003 0035 00000010
+[       0.000002] 0003 0036 00000020
+[       0.000002] 0000 0000 00000000
+)");
+    for (auto& event : events) {
+        device->processInput(event, event.when);
+    }
+
+    ASSERT_EQ(1U, frames.size());
+    EXPECT_EQ(s2ns(1) + us2ns(900000), frames[0].when);
+    ASSERT_EQ(1U, frames[0].contactCount);
+    EXPECT_EQ(5, frames[0].contacts[0].trackingId);
+    EXPECT_EQ(16, frames[0].contacts[0].x);
+    EXPECT_EQ(32, frames[0].contacts[0].y);
+}
+
 }  // namespace tests
 }  // namespace android
@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define LOG_TAG "InputHub_benchmark"
+
+#include <linux/input.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <utils/Log.h>
+#include <utils/Timers.h>
+
+#include "InputHub.h"
+#include "PipeInputHub.h"
+#include "TestHelpers.h"
+
+// Measures InputHub::poll() with fake multitouch panels: each device is a fifo
+// fed by a writer thread with frames of -c contacts at -r Hz (0 for as fast as
+// the hub reads them).
+//
+//   InputHub_benchmark [-d devices] [-c contacts] [-r rate Hz] [-t seconds] [-e]
+//
+// By default the callback takes whole frames through onInputEvents(); -e makes
+// it take them an event at a time through onInputEvent(), as callbacks that
+// predate onInputEvents() do.
+//
+// A frame's latency is from its write to the callback that completes it. CPU
+// is that of the polling thread alone, the hub plus a trivial callback.
+
+namespace android {
+
+static std::atomic<bool> gStopping(false);
+
+static int64_t threadCpuNs() {
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    return (static_cast<int64_t>(usage.ru_utime.tv_sec) + usage.ru_stime.tv_sec) * 1000000000LL +
+            (static_cast<int64_t>(usage.ru_utime.tv_usec) + usage.ru_stime.tv_usec) * 1000LL;
+}
+
+class BenchmarkCallback : public InputCallbackInterface {
+public:
+    explicit BenchmarkCallback(bool perEvent) : mPerEvent(perEvent) {
+        mLatencies.reserve(1 << 20);
+    }
+
+    virtual void onInputEvent(std::shared_ptr<InputDeviceNode> node, InputEvent& event,
+            nsecs_t event_time) override {
+        mEvents++;
+        if (event.type == EV_SYN && event.code == SYN_REPORT) {
+            endFrame(event.when);
+        }
+    }
+
+    virtual void onInputEvents(std::shared_ptr<InputDeviceNode> node, InputEvent* events,
+            size_t count, nsecs_t event_time) override {
+        if (mPerEvent) {
+            InputCallbackInterface::onInputEvents(node, events, count, event_time);
+            return;
+        }
+        mEvents += count;
+        mBatches++;
+        const InputEvent& last = events[count - 1];
+        if (last.type == EV_SYN && last.code == SYN_REPORT) {
+            endFrame(last.when);
+        }
+    }
+
+    virtual void onDeviceAdded(std::shared_ptr<InputDeviceNode> node) override { mDevices++; }
+    virtual void onDeviceRemoved(std::shared_ptr<InputDeviceNode> node) override {}
+
+    uint64_t events() const { return mEvents; }
+    uint64_t batches() const { return mBatches; }
+    size_t devices() const { return mDevices; }
+    std::vector<nsecs_t>& latencies() { return mLatencies; }
+
+private:
+    void endFrame(nsecs_t when) {
+        // Timestamps only have microsecond resolution.
+        mLatencies.push_back(systemTime(SYSTEM_TIME_MONOTONIC) - when);
+    }
+
+    bool mPerEvent;
+    uint64_t mEvents = 0;
+    uint64_t mBatches = 0;
+    size_t mDevices = 0;
+    std::vector<nsecs_t> mLatencies;
+};
+
+static void writeFrames(int fd, int contacts, int rate, uint64_t* outFrames) {
+    std::vector<struct input_event> frame(contacts * 3 + 1);
+    for (int i = 0; i < contacts; ++i) {
+        frame[i * 3] = { {}, EV_ABS, ABS_MT_SLOT, i };
+        frame[i * 3 + 1] = { {}, EV_ABS, ABS_MT_POSITION_X, 0 };
+        frame[i * 3 + 2] = { {}, EV_ABS, ABS_MT_POSITION_Y, 0 };
+    }
+    frame[contacts * 3] = { {}, EV_SYN, SYN_REPORT, 0 };
+
+    nsecs_t period = rate > 0 ? s2ns(1) / rate : 0;
+    nsecs_t next = systemTime(SYSTEM_TIME_MONOTONIC);
+    uint64_t frames = 0;
+    while (!gStopping) {
+        if (period) {
+            next += period;
+            nsecs_t delay = next - systemTime(SYSTEM_TIME_MONOTONIC);
+            if (delay > 0) {
+                std::this_thread::sleep_for(std::chrono::nanoseconds(delay));
+            }
+        }
+
+        nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        struct timeval time = { static_cast<time_t>(now / 1000000000LL),
+                static_cast<suseconds_t>((now % 1000000000LL) / 1000) };
+        for (int i = 0; i < contacts; ++i) {
+            frame[i * 3 + 1].value = (frames + i * 37) % 1080;
+            frame[i * 3 + 2].value = (frames * 3 + i * 53) % 1920;
+        }
+        for (auto& iev : frame) {
+            iev.time = time;
+        }
+
+        size_t size = frame.size() * sizeof(struct input_event);
+        ssize_t nWrite = TEMP_FAILURE_RETRY(write(fd, frame.data(), size));
+        while (nWrite < 0 && errno == EAGAIN && !gStopping) {
+            // The fifo is full; wait for the hub to catch up. Frames are
+            // smaller than PIPE_BUF, so they are never split.
+            struct pollfd pfd = { fd, POLLOUT, 0 };
+            ::poll(&pfd, 1, 10);
+            nWrite = TEMP_FAILURE_RETRY(write(fd, frame.data(), size));
+        }
+        if (nWrite < 0) {
+            if (!gStopping) {
+                ALOGE("could not write frame. errno=%d", errno);
+            }
+            break;
+        }
+        frames++;
+    }
+    *outFrames = frames;
+}
+
+static nsecs_t percentile(const std::vector<nsecs_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(sorted.size() * p))];
+}
+
+static int run(int argc, char** argv) {
+    int deviceCount = 4;
+    int contacts = 10;
+    int rate = 240;
+    int seconds = 5;
+    bool perEvent = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:c:r:t:e")) != -1) {
+        switch (opt) {
+            case 'd': deviceCount = atoi(optarg); break;
+            case 'c': contacts = atoi(optarg); break;
+            case 'r': rate = atoi(optarg); break;
+            case 't': seconds = atoi(optarg); break;
+            case 'e': perEvent = true; break;
+            default:
+                fprintf(stderr, "usage: %s [-d devices] [-c contacts] [-r rate Hz] "
+                        "[-t seconds] [-e]\n", argv[0]);
+                return 1;
+        }
+    }
+    // A frame must fit in one atomic fifo write.
+    if (deviceCount < 1 || contacts < 1 ||
+            (contacts * 3 + 1) * sizeof(struct input_event) > PIPE_BUF || seconds < 1) {
+        fprintf(stderr, "bad arguments\n");
+        return 1;
+    }
+
+    TempDir tempDir;
+    std::vector<std::unique_ptr<TempFile>> deviceFiles;
+    for (int i = 0; i < deviceCount; ++i) {
+        deviceFiles.emplace_back(tempDir.newTempFile());
+    }
+
+    auto callback = std::make_shared<BenchmarkCallback>(perEvent);
+    auto inputHub = std::make_shared<PipeInputHub>(callback);
+    if (inputHub->registerDevicePath(tempDir.getName()) != OK ||
+            callback->devices() != deviceFiles.size()) {
+        fprintf(stderr, "could not open the fake devices\n");
+        return 1;
+    }
+
+    std::vector<uint64_t> written(deviceCount);
+    std::vector<std::thread> writers;
+    for (int i = 0; i < deviceCount; ++i) {
+        writers.emplace_back(writeFrames, deviceFiles[i]->getFd(), contacts, rate, &written[i]);
+    }
+    std::thread stopper([&] {
+        std::this_thread::sleep_for(std::chrono::seconds(seconds));
+        gStopping = true;
+        inputHub->wake();
+    });
+
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    int64_t cpuStart = threadCpuNs();
+    uint64_t polls = 0;
+    while (!gStopping) {
+        inputHub->poll();
+        polls++;
+    }
+    int64_t cpu = threadCpuNs() - cpuStart;
+    double elapsed = (systemTime(SYSTEM_TIME_MONOTONIC) - start) / 1e9;
+
+    stopper.join();
+    for (auto& writer : writers) {
+        writer.join();
+    }
+
+    uint64_t frames = 0;
+    for (auto n : written) {
+        frames += n;
+    }
+    auto& latencies = callback->latencies();
+    std::sort(latencies.begin(), latencies.end());
+    uint64_t events = callback->events();
+
+    printf("%s delivery: %d devices, %d contacts/frame, %d Hz\n",
+            perEvent ? "per-event" : "per-frame", deviceCount, contacts, rate);
+    printf("  %llu frames written, %zu read, %llu events in %.2f s: %.0f events/s\n",
+            (unsigned long long) frames, latencies.size(), (unsigned long long) events,
+            elapsed, events / elapsed);
+    printf("  %llu polls, %llu callbacks, %.1f us poll thread CPU per 1k events\n",
+            (unsigned long long) polls,
+            (unsigned long long) (perEvent ? events : callback->batches()),
+            events ? cpu / 1e3 / (events / 1e3) : 0.0);
+    printf("  frame latency us: p50 %.1f  p99 %.1f  max %.1f\n",
+            percentile(latencies, 0.5) / 1e3, percentile(latencies, 0.99) / 1e3,
+            latencies.empty() ? 0.0 : latencies.back() / 1e3);
+    return 0;
+}
+
+}  // namespace android
+
+int main(int argc, char** argv) {
+    return android::run(argc, argv);
+}
@@ -22,6 +22,7 @@
 #include <chrono>
 #include <memory>
 #include <mutex>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -30,7 +31,9 @@
 #include <utils/Timers.h>
 
 #include "InputHub.h"
+#include "PipeInputHub.h"
 #include "TestHelpers.h"
+#include "TouchCoalescer.h"
 
 // # of milliseconds to fudge stopwatch measurements
 #define TIMING_TOLERANCE_MS 25
@@ -42,6 +45,8 @@ namespace tests {
 using namespace std::literals::chrono_literals;
 
 using InputCbFunc = std::function<void(std::shared_ptr<InputDeviceNode>, InputEvent&, nsecs_t)>;
+using InputEventsCbFunc =
+        std::function<void(std::shared_ptr<InputDeviceNode>, InputEvent*, size_t, nsecs_t)>;
 using DeviceCbFunc = std::function<void(std::shared_ptr<InputDeviceNode>)>;
 
 static const InputCbFunc kNoopInputCb = [](std::shared_ptr<InputDeviceNode>, InputEvent&, nsecs_t){};
@@ -54,24 +59,45 @@ public:
     virtual ~TestInputCallback() = default;
 
     void setInputCallback(InputCbFunc cb) { mInputCb = cb; }
+    // Until this is set, frames are passed to the input callback an event at a
+    // time.
+    void setInputEventsCallback(InputEventsCbFunc cb) { mInputEventsCb = cb; }
     void setDeviceAddedCallback(DeviceCbFunc cb) { mDeviceAddedCb = cb; }
     void setDeviceRemovedCallback(DeviceCbFunc cb) { mDeviceRemovedCb = cb; }
+    void setDeadline(nsecs_t deadline) { mDeadline = deadline; }
+    nsecs_t getDeadlineTime() const { return mDeadlineTime; }
 
     virtual void onInputEvent(std::shared_ptr<InputDeviceNode> node, InputEvent& event,
             nsecs_t event_time) override {
         mInputCb(node, event, event_time);
     }
+    virtual void onInputEvents(std::shared_ptr<InputDeviceNode> node, InputEvent* events,
+            size_t count, nsecs_t event_time) override {
+        if (mInputEventsCb) {
+            mInputEventsCb(node, events, count, event_time);
+        } else {
+            InputCallbackInterface::onInputEvents(node, events, count, event_time);
+        }
+    }
     virtual void onDeviceAdded(std::shared_ptr<InputDeviceNode> node) override {
         mDeviceAddedCb(node);
     }
     virtual void onDeviceRemoved(std::shared_ptr<InputDeviceNode> node) override {
         mDeviceRemovedCb(node);
     }
+    virtual nsecs_t getNextDeadline() override { return mDeadline; }
+    virtual void onDeadline(nsecs_t now) override {
+        mDeadlineTime = now;
+        mDeadline = -1;
+    }
 
 private:
     InputCbFunc mInputCb;
+    InputEventsCbFunc mInputEventsCb;
     DeviceCbFunc mDeviceAddedCb;
     DeviceCbFunc mDeviceRemovedCb;
+    nsecs_t mDeadline = -1;
+    nsecs_t mDeadlineTime = -1;
 };
 
 class InputHubTest : public ::testing::Test {
@@ -96,6 +122,71 @@ TEST_F(InputHubTest, testWake) {
     EXPECT_NEAR(100, elapsedMillis, TIMING_TOLERANCE_MS);
 }
 
+TEST_F(InputHubTest, testDeadline) {
+    nsecs_t deadline = systemTime(SYSTEM_TIME_MONOTONIC) + ms2ns(100);
+    mCallback->setDeadline(deadline);
+
+    StopWatch stopWatch("poll");
+    EXPECT_EQ(OK, mInputHub->poll());
+    int32_t elapsedMillis = ns2ms(stopWatch.elapsedTime());
+
+    EXPECT_NEAR(100, elapsedMillis, TIMING_TOLERANCE_MS);
+    EXPECT_GE(mCallback->getDeadlineTime(), deadline);
+}
+
+// Feeds a TouchCoalescer's deadline through the InputHub.
+class CoalescingInputCallback : public TestInputCallback {
+public:
+    CoalescingInputCallback(const TouchCoalescerConfig& config,
+            TouchCoalescer::FrameCallback callback) : mCoalescer(config, callback) {}
+
+    TouchCoalescer& getCoalescer() { return mCoalescer; }
+
+    virtual nsecs_t getNextDeadline() override { return mCoalescer.getNextDeadline(); }
+    virtual void onDeadline(nsecs_t now) override { mCoalescer.onDeadline(now); }
+
+private:
+    TouchCoalescer mCoalescer;
+};
+
+TEST(InputHubDeadlineTest, testDeadlineWithOtherFdReady) {
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    std::vector<TouchFrame> frames;
+    TouchCoalescerConfig config;
+    config.period = ms2ns(50);
+    config.phase = start;
+    auto callback = std::make_shared<CoalescingInputCallback>(config,
+            [&](const TouchFrame& frame) { frames.push_back(frame); });
+    auto inputHub = std::make_shared<InputHub>(callback);
+
+    // A finger goes down at the target and moves 1 ms later; the move is held
+    // back until the next target, 50 ms on.
+    const InputEvent events[] = {
+        { start, EV_ABS, ABS_MT_TRACKING_ID, 1 },
+        { start, EV_ABS, ABS_MT_POSITION_X, 10 },
+        { start, EV_SYN, SYN_REPORT, 0 },
+        { start + ms2ns(1), EV_ABS, ABS_MT_POSITION_X, 11 },
+        { start + ms2ns(1), EV_SYN, SYN_REPORT, 0 },
+    };
+    for (const auto& event : events) {
+        callback->getCoalescer().processEvent(event);
+    }
+    ASSERT_EQ(1U, frames.size());
+    ASSERT_EQ(start + ms2ns(50), callback->getNextDeadline());
+
+    // Keep the wake fd ready for every poll() so that epoll_wait never times
+    // out, past the deadline.
+    while (frames.size() < 2 && systemTime(SYSTEM_TIME_MONOTONIC) < start + ms2ns(200)) {
+        EXPECT_EQ(OK, inputHub->wake());
+        EXPECT_EQ(OK, inputHub->poll());
+    }
+    int32_t elapsedMillis = ns2ms(systemTime(SYSTEM_TIME_MONOTONIC) - start);
+
+    ASSERT_EQ(2U, frames.size());
+    EXPECT_EQ(11, frames[1].contacts[0].x);
+    EXPECT_NEAR(50, elapsedMillis, TIMING_TOLERANCE_MS);
+}
+
 TEST_F(InputHubTest, DISABLED_testDeviceAdded) {
     auto tempDir = std::make_shared<TempDir>();
     std::string pathname;
@@ -255,5 +346,81 @@ TEST_F(InputHubTest, DISABLED_testCallbackOrder) {
     EXPECT_TRUE(deviceCallbackFinished);
 }
 
+static struct input_event makeEvent(int type, int code, int value) {
+    struct input_event iev;
+    iev.time = { 1, 0 };
+    iev.type = type;
+    iev.code = code;
+    iev.value = value;
+    return iev;
+}
+
+// Two complete touch frames followed by the start of a third.
+static const struct input_event kFrames[] = {
+    makeEvent(EV_ABS, ABS_MT_SLOT, 0),
+    makeEvent(EV_ABS, ABS_MT_POSITION_X, 100),
+    makeEvent(EV_ABS, ABS_MT_POSITION_Y, 200),
+    makeEvent(EV_SYN, SYN_REPORT, 0),
+    makeEvent(EV_ABS, ABS_MT_POSITION_X, 101),
+    makeEvent(EV_SYN, SYN_REPORT, 0),
+    makeEvent(EV_ABS, ABS_MT_POSITION_Y, 201),
+};
+static const size_t kFrameEventCount = sizeof(kFrames) / sizeof(kFrames[0]);
+
+TEST_F(InputHubTest, testInputEventsBatchedByFrame) {
+    auto tempDir = std::make_unique<TempDir>();
+    auto deviceFile = std::unique_ptr<TempFile>(tempDir->newTempFile());
+    auto inputHub = std::make_shared<PipeInputHub>(mCallback);
+
+    std::vector<size_t> frameSizes;
+    std::vector<int32_t> codes;
+    mCallback->setInputEventsCallback(
+            [&](std::shared_ptr<InputDeviceNode> node, InputEvent* events, size_t count,
+                    nsecs_t) {
+                EXPECT_EQ(deviceFile->getName(), node->getPath());
+                frameSizes.push_back(count);
+                for (size_t i = 0; i < count; ++i) {
+                    EXPECT_EQ(s2ns(1), events[i].when);
+                    codes.push_back(events[i].code);
+                }
+            });
+    ASSERT_EQ(OK, inputHub->registerDevicePath(tempDir->getName()));
+
+    ssize_t nWrite = TEMP_FAILURE_RETRY(write(deviceFile->getFd(), kFrames, sizeof(kFrames)));
+    ASSERT_EQ(static_cast<ssize_t>(sizeof(kFrames)), nWrite);
+
+    EXPECT_EQ(OK, inputHub->poll());
+
+    // The incomplete frame is delivered once the device runs dry, not held back.
+    EXPECT_EQ((std::vector<size_t>{ 4, 2, 1 }), frameSizes);
+    ASSERT_EQ(kFrameEventCount, codes.size());
+    for (size_t i = 0; i < codes.size(); ++i) {
+        EXPECT_EQ(kFrames[i].code, codes[i]);
+    }
+}
+
+TEST_F(InputHubTest, testInputEventsFallBackToInputEvent) {
+    auto tempDir = std::make_unique<TempDir>();
+    auto deviceFile = std::unique_ptr<TempFile>(tempDir->newTempFile());
+    auto inputHub = std::make_shared<PipeInputHub>(mCallback);
+
+    size_t eventCount = 0;
+    mCallback->setInputCallback(
+            [&](std::shared_ptr<InputDeviceNode>, InputEvent& event, nsecs_t) {
+                ASSERT_LT(eventCount, kFrameEventCount);
+                EXPECT_EQ(kFrames[eventCount].type, event.type);
+                EXPECT_EQ(kFrames[eventCount].code, event.code);
+                EXPECT_EQ(kFrames[eventCount].value, event.value);
+                eventCount++;
+            });
+    ASSERT_EQ(OK, inputHub->registerDevicePath(tempDir->getName()));
+
+    ssize_t nWrite = TEMP_FAILURE_RETRY(write(deviceFile->getFd(), kFrames, sizeof(kFrames)));
+    ASSERT_EQ(static_cast<ssize_t>(sizeof(kFrames)), nWrite);
+
+    EXPECT_EQ(OK, inputHub->poll());
+    EXPECT_EQ(kFrameEventCount, eventCount);
+}
+
 }  // namespace tests
 }  // namespace android
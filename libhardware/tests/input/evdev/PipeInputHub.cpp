@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define LOG_TAG "PipeInputHub"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <utils/Log.h>
+
+#include "PipeInputHub.h"
+
+namespace android {
+
+/** A device node with no keys or axes, backed by the read end of a fifo. */
+class PipeDeviceNode : public InputDeviceNode {
+public:
+    PipeDeviceNode(const std::string& path, int fd) : mFd(fd), mPath(path) {}
+    virtual ~PipeDeviceNode() {
+        ::close(mFd);
+    }
+
+    virtual const std::string& getPath() const override { return mPath; }
+
+    virtual const std::string& getName() const override { return mName; }
+    virtual const std::string& getLocation() const override { return mLocation; }
+    virtual const std::string& getUniqueId() const override { return mPath; }
+
+    virtual uint16_t getBusType() const override { return 0; }
+    virtual uint16_t getVendorId() const override { return 0; }
+    virtual uint16_t getProductId() const override { return 0; }
+    virtual uint16_t getVersion() const override { return 0; }
+
+    virtual bool hasKey(int32_t key) const override { return false; }
+    virtual bool hasRelativeAxis(int axis) const override { return false; }
+    virtual const AbsoluteAxisInfo* getAbsoluteAxisInfo(int32_t axis) const override {
+        return nullptr;
+    }
+    virtual bool hasInputProperty(int property) const override { return false; }
+
+    virtual int32_t getKeyState(int32_t key) const override { return 0; }
+    virtual int32_t getSwitchState(int32_t sw) const override { return 0; }
+    virtual status_t getAbsoluteAxisValue(int32_t axis, int32_t* outValue) const override {
+        *outValue = 0;
+        return -1;
+    }
+
+    virtual void vibrate(nsecs_t duration) override {}
+    virtual void cancelVibrate(int32_t deviceId) override {}
+
+    virtual void disableDriverKeyRepeat() override {}
+
+private:
+    int mFd;
+    std::string mPath;
+    std::string mName = "Pipe Device";
+    std::string mLocation = "pipe/0";
+};
+
+std::shared_ptr<InputDeviceNode> PipeInputHub::openDeviceNode(const std::string& path,
+        int* outFd) {
+    int fd = TEMP_FAILURE_RETRY(::open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC));
+    if (fd < 0) {
+        ALOGE("could not open pipe device %s. errno=%d", path.c_str(), errno);
+        return nullptr;
+    }
+    *outFd = fd;
+    return std::make_shared<PipeDeviceNode>(path, fd);
+}
+
+}  // namespace android
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef ANDROID_PIPE_INPUT_HUB_H_
+#define ANDROID_PIPE_INPUT_HUB_H_
+
+#include <memory>
+#include <string>
+
+#include "InputHub.h"
+
+namespace android {
+
+/**
+ * An InputHub that treats every file under its device paths as an input
+ * device, such as the fifos made by TempDir::newTempFile(). Whatever
+ * input_event records are written to a fifo are read back as that device's
+ * events, and closing the last writer removes the device.
+ */
+class PipeInputHub : public InputHub {
+public:
+    explicit PipeInputHub(std::shared_ptr<InputCallbackInterface> cb) : InputHub(cb) {}
+    virtual ~PipeInputHub() override = default;
+
+protected:
+    virtual std::shared_ptr<InputDeviceNode> openDeviceNode(const std::string& path,
+            int* outFd) override;
+};
+
+}  // namespace android
+
+#endif  // ANDROID_PIPE_INPUT_HUB_H_
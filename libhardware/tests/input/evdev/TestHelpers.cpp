@@ -19,11 +19,15 @@
 
 #include <dirent.h>
 #include <fcntl.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <sstream>
+#include <string>
+
 #include <utils/Log.h>
 
 #include "TestHelpers.h"
@@ -90,4 +94,24 @@ TempFile* TempDir::newTempFile() {
     return new TempFile(mName);
 }
 
+std::vector<InputEvent> parseEventScript(const char* script) {
+    std::vector<InputEvent> events;
+    std::istringstream lines(script);
+    std::string line;
+    while (std::getline(lines, line)) {
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line[start] == '#') {
+            continue;
+        }
+        unsigned long sec, usec;
+        unsigned int type, code, value;
+        int matched = sscanf(line.c_str(), " [ %lu.%lu] %x %x %x", &sec, &usec, &type, &code,
+                &value);
+        LOG_FATAL_IF(matched != 5, "bad event script line: %s", line.c_str());
+        events.push_back({ s2ns(sec) + us2ns(usec), static_cast<int32_t>(type),
+                static_cast<int32_t>(code), static_cast<int32_t>(value) });
+    }
+    return events;
+}
+
 }  // namespace android
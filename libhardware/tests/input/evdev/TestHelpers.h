@@ -19,6 +19,9 @@
 
 #include <future>
 #include <thread>
+#include <vector>
+
+#include "InputHub.h"
 
 namespace android {
 
@@ -78,6 +81,15 @@ private:
     char* mName;
 };
 
+/**
+ * Parses events recorded with "getevent -t", one per line:
+ *
+ *   [       1.004166] 0003 0035 00000064
+ *
+ * Blank lines and lines starting with # are skipped.
+ */
+std::vector<InputEvent> parseEventScript(const char* script);
+
 }  // namespace android
 
 #endif  // ANDROID_TEST_HELPERS_H_
@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define LOG_TAG "TouchCoalescer_test"
+//#define LOG_NDEBUG 0
+
+#include <linux/input.h>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <utils/Timers.h>
+
+#include "TestHelpers.h"
+#include "TouchCoalescer.h"
+
+namespace android {
+namespace tests {
+
+// A 240 Hz swipe: one finger goes down at x=100, moves 10 to the right every
+// 4 ms for 32 ms, and goes up.
+static const char kSwipe[] = R"(
+[       1.000000] 0003 0039 00000007
+[       1.000000] 0003 0035 00000064
+[       1.000000] 0003 0036 000001f4
+[       1.000000] 0003 003a 00000020
+[       1.000000] 0001 014a 00000001
+[       1.000000] 0000 0000 00000000
+[       1.004000] 0003 0035 0000006e
+[       1.004000] 0000 0000 00000000
+[       1.008000] 0003 0035 00000078
+[       1.008000] 0000 0000 00000000
+[       1.012000] 0003 0035 00000082
+[       1.012000] 0000 0000 00000000
+[       1.016000] 0003 0035 0000008c
+[       1.016000] 0000 0000 00000000
+[       1.020000] 0003 0035 00000096
+[       1.020000] 0000 0000 00000000
+[       1.024000] 0003 0035 000000a0
+[       1.024000] 0000 0000 00000000
+[       1.028000] 0003 0035 000000aa
+[       1.028000] 0000 0000 00000000
+[       1.032000] 0003 0035 000000b4
+[       1.032000] 0000 0000 00000000
+[       1.036000] 0003 0039 ffffffff
+[       1.036000] 0001 014a 00000000
+[       1.036000] 0000 0000 00000000
+)";
+
+// Two fingers in slots 0 and 1; the second goes up while the first moves.
+static const char kTwoFingers[] = R"(
+[       2.000000] 0003 002f 00000000
+[       2.000000] 0003 0039 00000001
+[       2.000000] 0003 0035 0000000a
+[       2.000000] 0003 0036 00000014
+[       2.000000] 0003 002f 00000001
+[       2.000000] 0003 0039 00000002
+[       2.000000] 0003 0035 0000001e
+[       2.000000] 0003 0036 00000028
+[       2.000000] 0000 0000 00000000
+[       2.008000] 0003 0039 ffffffff
+[       2.008000] 0003 002f 00000000
+[       2.008000] 0003 0035 0000000b
+[       2.008000] 0000 0000 00000000
+)";
+
+class TouchCoalescerTest : public ::testing::Test {
+protected:
+    void run(const TouchCoalescerConfig& config, const char* script) {
+        mCoalescer = std::make_unique<TouchCoalescer>(config,
+                [this](const TouchFrame& frame) { mFrames.push_back(frame); });
+        for (const auto& event : parseEventScript(script)) {
+            mCoalescer->processEvent(event);
+        }
+    }
+
+    void expectFrame(size_t index, nsecs_t when, bool resampled, int32_t x) {
+        ASSERT_LT(index, mFrames.size());
+        const TouchFrame& frame = mFrames[index];
+        EXPECT_EQ(when, frame.when) << "frame " << index;
+        EXPECT_EQ(resampled, frame.resampled) << "frame " << index;
+        ASSERT_EQ(1U, frame.contactCount) << "frame " << index;
+        EXPECT_EQ(7, frame.contacts[0].trackingId);
+        EXPECT_EQ(x, frame.contacts[0].x) << "frame " << index;
+        EXPECT_EQ(500, frame.contacts[0].y) << "frame " << index;
+        EXPECT_EQ(32, frame.contacts[0].pressure);
+    }
+
+    std::unique_ptr<TouchCoalescer> mCoalescer;
+    std::vector<TouchFrame> mFrames;
+};
+
+TEST_F(TouchCoalescerTest, testEveryFrameWithoutPeriod) {
+    run(TouchCoalescerConfig(), kSwipe);
+
+    ASSERT_EQ(10U, mFrames.size());
+    for (size_t i = 0; i < 9; ++i) {
+        expectFrame(i, s2ns(1) + ms2ns(4 * i), false, 100 + 10 * i);
+    }
+    EXPECT_EQ(0U, mFrames[9].contactCount);
+}
+
+TEST_F(TouchCoalescerTest, testAssemblesSlots) {
+    run(TouchCoalescerConfig(), kTwoFingers);
+
+    ASSERT_EQ(2U, mFrames.size());
+    ASSERT_EQ(2U, mFrames[0].contactCount);
+    EXPECT_EQ(0, mFrames[0].contacts[0].slot);
+    EXPECT_EQ(1, mFrames[0].contacts[0].trackingId);
+    EXPECT_EQ(10, mFrames[0].contacts[0].x);
+    EXPECT_EQ(20, mFrames[0].contacts[0].y);
+    EXPECT_EQ(1, mFrames[0].contacts[1].slot);
+    EXPECT_EQ(2, mFrames[0].contacts[1].trackingId);
+    EXPECT_EQ(30, mFrames[0].contacts[1].x);
+    EXPECT_EQ(40, mFrames[0].contacts[1].y);
+
+    ASSERT_EQ(1U, mFrames[1].contactCount);
+    EXPECT_EQ(1, mFrames[1].contacts[0].trackingId);
+    EXPECT_EQ(11, mFrames[1].contacts[0].x);
+}
+
+TEST_F(TouchCoalescerTest, testCoalesceAndResample) {
+    // Targets at 2 ms past every 16 ms: 1.010, 1.026 and 1.042.
+    TouchCoalescerConfig config;
+    config.period = ms2ns(16);
+    config.phase = ms2ns(2);
+    run(config, kSwipe);
+
+    // The down frame goes out as is. The frames at 1.012 and 1.028 are the
+    // first past a target, so they are resampled halfway back to the frames
+    // before them. The frame at 1.032 is held back until the finger goes up.
+    ASSERT_EQ(5U, mFrames.size());
+    expectFrame(0, s2ns(1), false, 100);
+    expectFrame(1, s2ns(1) + ms2ns(10), true, 125);
+    expectFrame(2, s2ns(1) + ms2ns(26), true, 165);
+    expectFrame(3, s2ns(1) + ms2ns(32), false, 180);
+    EXPECT_EQ(s2ns(1) + ms2ns(36), mFrames[4].when);
+    EXPECT_EQ(0U, mFrames[4].contactCount);
+
+    EXPECT_EQ(10U, mCoalescer->getFramesIn());
+    EXPECT_EQ(5U, mCoalescer->getFramesOut());
+}
+
+TEST_F(TouchCoalescerTest, testCoalesceWithoutResampling) {
+    TouchCoalescerConfig config;
+    config.period = ms2ns(16);
+    config.phase = ms2ns(2);
+    config.resample = false;
+    run(config, kSwipe);
+
+    ASSERT_EQ(5U, mFrames.size());
+    expectFrame(0, s2ns(1), false, 100);
+    expectFrame(1, s2ns(1) + ms2ns(12), false, 130);
+    expectFrame(2, s2ns(1) + ms2ns(28), false, 170);
+    expectFrame(3, s2ns(1) + ms2ns(32), false, 180);
+    EXPECT_EQ(0U, mFrames[4].contactCount);
+}
+
+TEST_F(TouchCoalescerTest, testFlushReportsHeldFrame) {
+    TouchCoalescerConfig config;
+    config.period = ms2ns(16);
+    config.phase = ms2ns(2);
+    // Everything up to the frame at 1.032.
+    std::string script(kSwipe);
+    script.resize(script.find("[       1.036000]"));
+    run(config, script.c_str());
+
+    ASSERT_EQ(3U, mFrames.size());
+    mCoalescer->flush();
+    ASSERT_EQ(4U, mFrames.size());
+    expectFrame(3, s2ns(1) + ms2ns(32), false, 180);
+    mCoalescer->flush();
+    EXPECT_EQ(4U, mFrames.size());
+}
+
+TEST_F(TouchCoalescerTest, testDeadlineReportsStillContact) {
+    TouchCoalescerConfig config;
+    config.period = ms2ns(16);
+    config.phase = ms2ns(2);
+    // The finger moves up to the frame at 1.016 and then stays still, so no
+    // frame arrives after the target at 1.026.
+    std::string script(kSwipe);
+    script.resize(script.find("[       1.020000]"));
+    run(config, script.c_str());
+
+    ASSERT_EQ(2U, mFrames.size());
+    expectFrame(1, s2ns(1) + ms2ns(10), true, 125);
+    EXPECT_EQ(s2ns(1) + ms2ns(26), mCoalescer->getNextDeadline());
+
+    mCoalescer->onDeadline(s2ns(1) + ms2ns(20));
+    EXPECT_EQ(2U, mFrames.size());
+
+    mCoalescer->onDeadline(s2ns(1) + ms2ns(26));
+    ASSERT_EQ(3U, mFrames.size());
+    expectFrame(2, s2ns(1) + ms2ns(16), false, 140);
+    EXPECT_EQ(-1, mCoalescer->getNextDeadline());
+
+    mCoalescer->onDeadline(s2ns(1) + ms2ns(42));
+    EXPECT_EQ(3U, mFrames.size());
+}
+
+TEST_F(TouchCoalescerTest, testSynDroppedSkipsFrame) {
+    static const char kDropped[] = R"(
+[       3.000000] 0003 0039 00000003
+[       3.000000] 0003 0035 00000001
+[       3.000000] 0000 0000 00000000
+[       3.004000] 0000 0003 00000000
+[       3.004000] 0003 0035 00000063
+[       3.004000] 0000 0000 00000000
+[       3.008000] 0003 0036 00000002
+[       3.008000] 0000 0000 00000000
+)";
+    run(TouchCoalescerConfig(), kDropped);
+
+    // The events between SYN_DROPPED and the SYN_REPORT after it are ignored.
+    ASSERT_EQ(2U, mFrames.size());
+    EXPECT_EQ(s2ns(3) + ms2ns(8), mFrames[1].when);
+    EXPECT_EQ(1, mFrames[1].contacts[0].x);
+    EXPECT_EQ(2, mFrames[1].contacts[0].y);
+}
+
+}  // namespace tests
+}  // namespace android
@@ -1414,6 +1414,11 @@ status_t AudioPolicyManagerBase::dump(int fd)
     result.append(buffer);
     snprintf(buffer, SIZE, " Force use for system %d\n", mForceUse[AudioSystem::FOR_SYSTEM]);
     result.append(buffer);
+    snprintf(buffer, SIZE, " Decision cache: %s%s, %zu routing states, %u hits, %u misses, "
+             "%u mismatches\n", mDecisionCacheEnabled ? "on" : "off",
+             mCheckDecisionCache ? " (checked)" : "", mRoutingDecisions.size(),
+             mDecisionCacheHits, mDecisionCacheMisses, mDecisionCacheMismatches);
+    result.append(buffer);
     write(fd, result.string(), result.size());
 
 
@@ -1550,10 +1555,21 @@ AudioPolicyManagerBase::AudioPolicyManagerBase(AudioPolicyClientInterface *clien
     mLimitRingtoneVolume(false), mLastVoiceVolume(-1.0f),
     mTotalEffectsCpuLoad(0), mTotalEffectsMemory(0),
     mA2dpSuspended(false), mHasA2dp(false), mHasUsb(false), mHasRemoteSubmix(false),
-    mSpeakerDrcEnabled(false)
+    mSpeakerDrcEnabled(false), mRoutingDecisionsDefaultDevice(AUDIO_DEVICE_NONE),
+    mLastRoutingKey(0), mLastRoutingIndex(-1),
+    mDecisionCacheEnabled(true), mCheckDecisionCache(false),
+    mDecisionCacheHits(0), mDecisionCacheMisses(0), mDecisionCacheMismatches(0)
 {
     mpClientInterface = clientInterface;
 
+    char propValue[PROPERTY_VALUE_MAX];
+    if (property_get("audio.policy.decision_cache", propValue, "1")) {
+        mDecisionCacheEnabled = atoi(propValue) != 0;
+    }
+    if (property_get("audio.policy.check_decision_cache", propValue, "0")) {
+        mCheckDecisionCache = atoi(propValue) != 0;
+    }
+
     for (int i = 0; i < AudioSystem::NUM_FORCE_USE; i++) {
         mForceUse[i] = AudioSystem::FORCE_NONE;
     }
@@ -2319,10 +2335,28 @@ bool AudioPolicyManagerBase::vectorsEqual(SortedVector<audio_io_handle_t>& outpu
     return true;
 }
 
+bool AudioPolicyManagerBase::outputsUnchanged()
+{
+    if (mPreviousOutputs.size() != mOutputs.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < mOutputs.size(); i++) {
+        if (mPreviousOutputs.keyAt(i) != mOutputs.keyAt(i) ||
+                mPreviousOutputs.valueAt(i) != mOutputs.valueAt(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void AudioPolicyManagerBase::checkOutputForStrategy(routing_strategy strategy)
 {
     audio_devices_t oldDevice = getDeviceForStrategy(strategy, true /*fromCache*/);
     audio_devices_t newDevice = getDeviceForStrategy(strategy, false /*fromCache*/);
+    // same device on the same outputs: nothing can move
+    if (oldDevice == newDevice && outputsUnchanged()) {
+        return;
+    }
     SortedVector<audio_io_handle_t> srcOutputs = getOutputsForDevice(oldDevice, mPreviousOutputs);
     SortedVector<audio_io_handle_t> dstOutputs = getOutputsForDevice(newDevice, mOutputs);
 
@@ -2541,6 +2575,93 @@ audio_devices_t AudioPolicyManagerBase::getDeviceForStrategy(routing_strategy st
         return mDeviceForStrategy[strategy];
     }
 
+    // STRATEGY_SONIFICATION_RESPECTFUL depends on recent stream activity and is always
+    // recomputed, from the cached decisions of the strategies it follows
+    uint64_t key;
+    if (!mDecisionCacheEnabled || strategy < 0 || strategy >= NUM_STRATEGIES ||
+            strategy == STRATEGY_SONIFICATION_RESPECTFUL || !getRoutingKey(&key)) {
+        return computeDeviceForStrategy(strategy);
+    }
+
+    if (mRoutingDecisionsDefaultDevice != mDefaultOutputDevice) {
+        invalidateRoutingDecisions();
+        mRoutingDecisionsDefaultDevice = mDefaultOutputDevice;
+    }
+    ssize_t index = mLastRoutingIndex;
+    if (index < 0 || key != mLastRoutingKey) {
+        index = mRoutingDecisions.indexOfKey(key);
+        mLastRoutingKey = key;
+        mLastRoutingIndex = index;
+    }
+    if (index >= 0 && (mRoutingDecisions.valueAt(index).mValid & (1 << strategy))) {
+        mDecisionCacheHits++;
+        device = mRoutingDecisions.valueAt(index).mDevice[strategy];
+        if (mCheckDecisionCache) {
+            mDecisionCacheEnabled = false;
+            uint32_t expected = computeDeviceForStrategy(strategy);
+            mDecisionCacheEnabled = true;
+            if (expected != device) {
+                ALOGE("getDeviceForStrategy() strategy %d cached device %x instead of %x, "
+                      "routing key %" PRIx64, strategy, device, expected, key);
+                mDecisionCacheMismatches++;
+                invalidateRoutingDecisions();
+                device = expected;
+            }
+        }
+        return device;
+    }
+
+    mDecisionCacheMisses++;
+    device = computeDeviceForStrategy(strategy);
+    // the strategies this one follows may have added or flushed entries meanwhile
+    index = mRoutingDecisions.indexOfKey(key);
+    if (index < 0) {
+        if (mRoutingDecisions.size() >= MAX_ROUTING_DECISIONS) {
+            invalidateRoutingDecisions();
+        }
+        index = mRoutingDecisions.add(key, RoutingDecision());
+        // adding moves the entries after it
+        mLastRoutingKey = key;
+        mLastRoutingIndex = index;
+    }
+    RoutingDecision& decision = mRoutingDecisions.editValueAt(index);
+    decision.mDevice[strategy] = device;
+    decision.mValid |= 1 << strategy;
+    return device;
+}
+
+bool AudioPolicyManagerBase::getRoutingKey(uint64_t *key)
+{
+    // phone state and forced configurations take 4 bits each
+    uint64_t k = (uint64_t)(mPhoneState - AudioSystem::MODE_INVALID);
+    if (k >= 16) {
+        return false;
+    }
+    for (int i = 0; i < AudioSystem::NUM_FORCE_USE; i++) {
+        if ((uint32_t)mForceUse[i] >= 16) {
+            return false;
+        }
+        k = (k << 4) | mForceUse[i];
+    }
+    k = (k << 1) | (isInCall() ? 1 : 0);
+    // whether A2DP can be used only matters with an A2DP device connected: skip the walk
+    // through the outputs otherwise
+    k = (k << 1) | (((mAvailableOutputDevices & AUDIO_DEVICE_OUT_ALL_A2DP) && mHasA2dp &&
+            !mA2dpSuspended && getA2dpOutput() != 0) ? 1 : 0);
+    *key = (k << 32) | mAvailableOutputDevices;
+    return true;
+}
+
+void AudioPolicyManagerBase::invalidateRoutingDecisions()
+{
+    mRoutingDecisions.clear();
+    mLastRoutingIndex = -1;
+}
+
+audio_devices_t AudioPolicyManagerBase::computeDeviceForStrategy(routing_strategy strategy)
+{
+    uint32_t device = AUDIO_DEVICE_NONE;
+
     switch (strategy) {
 
     case STRATEGY_SONIFICATION_RESPECTFUL:
@@ -2589,10 +2710,12 @@ audio_devices_t AudioPolicyManagerBase::getDeviceForStrategy(routing_strategy st
             // FALL THROUGH
 
         default:    // FORCE_NONE
-            // when not in a phone call, phone strategy should route STREAM_VOICE_CALL to A2DP
+            // when not in a phone call, phone strategy should route STREAM_VOICE_CALL to A2DP.
+            // getA2dpOutput() walks the outputs: only call it with an A2DP device connected
             if (mHasA2dp && !isInCall() &&
                     (mForceUse[AudioSystem::FOR_MEDIA] != AudioSystem::FORCE_NO_BT_A2DP) &&
-                    (getA2dpOutput() != 0) && !mA2dpSuspended) {
+                    !mA2dpSuspended && (mAvailableOutputDevices & AUDIO_DEVICE_OUT_ALL_A2DP) &&
+                    (getA2dpOutput() != 0)) {
                 device = mAvailableOutputDevices & AUDIO_DEVICE_OUT_BLUETOOTH_A2DP;
                 if (device) break;
                 device = mAvailableOutputDevices & AUDIO_DEVICE_OUT_BLUETOOTH_A2DP_HEADPHONES;
@@ -2627,7 +2750,8 @@ audio_devices_t AudioPolicyManagerBase::getDeviceForStrategy(routing_strategy st
             // A2DP speaker when forcing to speaker output
             if (mHasA2dp && !isInCall() &&
                     (mForceUse[AudioSystem::FOR_MEDIA] != AudioSystem::FORCE_NO_BT_A2DP) &&
-                    (getA2dpOutput() != 0) && !mA2dpSuspended) {
+                    !mA2dpSuspended && (mAvailableOutputDevices & AUDIO_DEVICE_OUT_ALL_A2DP) &&
+                    (getA2dpOutput() != 0)) {
                 device = mAvailableOutputDevices & AUDIO_DEVICE_OUT_BLUETOOTH_A2DP_SPEAKER;
                 if (device) break;
             }
@@ -2687,7 +2811,8 @@ audio_devices_t AudioPolicyManagerBase::getDeviceForStrategy(routing_strategy st
         }
         if ((device2 == AUDIO_DEVICE_NONE) &&
                 mHasA2dp && (mForceUse[AudioSystem::FOR_MEDIA] != AudioSystem::FORCE_NO_BT_A2DP) &&
-                (getA2dpOutput() != 0) && !mA2dpSuspended) {
+                !mA2dpSuspended && (mAvailableOutputDevices & AUDIO_DEVICE_OUT_ALL_A2DP) &&
+                (getA2dpOutput() != 0)) {
             device2 = mAvailableOutputDevices & AUDIO_DEVICE_OUT_BLUETOOTH_A2DP;
             if (device2 == AUDIO_DEVICE_NONE) {
                 device2 = mAvailableOutputDevices & AUDIO_DEVICE_OUT_BLUETOOTH_A2DP_HEADPHONES;
@@ -3097,6 +3222,34 @@ float AudioPolicyManagerBase::volIndexToAmpl(audio_devices_t device, const Strea
     return amplification;
 }
 
+float AudioPolicyManagerBase::cachedVolIndexToAmpl(audio_devices_t device,
+        StreamDescriptor& streamDesc, int indexInUi)
+{
+    device_category deviceCategory = getDeviceCategory(device);
+    StreamDescriptor::AmplTable& table = streamDesc.mAmplTable[deviceCategory];
+
+    if (table.mCurve != streamDesc.mVolumeCurve[deviceCategory] ||
+            table.mIndexMin != streamDesc.mIndexMin ||
+            table.mIndexMax != streamDesc.mIndexMax) {
+        // the curve of DTMF changes with the phone state, and the index range when the
+        // stream volume is initialized
+        table.mCurve = streamDesc.mVolumeCurve[deviceCategory];
+        table.mIndexMin = streamDesc.mIndexMin;
+        table.mIndexMax = streamDesc.mIndexMax;
+        table.mAmpl.clear();
+        if (table.mIndexMax > table.mIndexMin &&
+                table.mIndexMax - table.mIndexMin < MAX_AMPL_TABLE_SIZE) {
+            for (int index = table.mIndexMin; index <= table.mIndexMax; index++) {
+                table.mAmpl.add(volIndexToAmpl(device, streamDesc, index));
+            }
+        }
+    }
+    if (indexInUi < table.mIndexMin || indexInUi - table.mIndexMin >= (int)table.mAmpl.size()) {
+        return volIndexToAmpl(device, streamDesc, indexInUi);
+    }
+    return table.mAmpl[indexInUi - table.mIndexMin];
+}
+
 const AudioPolicyManagerBase::VolumeCurvePoint
     AudioPolicyManagerBase::sDefaultVolumeCurve[AudioPolicyManagerBase::VOLCNT] = {
     {1, -49.5f}, {33, -33.5f}, {66, -17.0f}, {100, 0.0f}
@@ -3250,7 +3403,17 @@ float AudioPolicyManagerBase::computeVolume(int stream,
         return 1.0;
     }
 
-    volume = volIndexToAmpl(device, streamDesc, index);
+    if (mDecisionCacheEnabled) {
+        volume = cachedVolIndexToAmpl(device, streamDesc, index);
+        if (mCheckDecisionCache && volume != volIndexToAmpl(device, streamDesc, index)) {
+            ALOGE("computeVolume() stream %d index %d device %x cached volume %f instead of %f",
+                  stream, index, device, volume, volIndexToAmpl(device, streamDesc, index));
+            mDecisionCacheMismatches++;
+            volume = volIndexToAmpl(device, streamDesc, index);
+        }
+    } else {
+        volume = volIndexToAmpl(device, streamDesc, index);
+    }
 
     // if a headset is connected, apply the following rules to ring tones and notifications
     // to avoid sound level bursts in user's ears:
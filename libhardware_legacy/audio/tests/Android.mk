@@ -0,0 +1,22 @@
+LOCAL_PATH := $(call my-dir)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	audio_policy_benchmark.cpp
+
+LOCAL_MODULE := audio_policy_benchmark
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CFLAGS := -Wno-unused-parameter -O2
+
+LOCAL_STATIC_LIBRARIES := \
+	libaudiopolicy_legacy \
+	libmedia_helper
+
+LOCAL_SHARED_LIBRARIES := \
+	libcutils \
+	libutils \
+	liblog
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,372 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <hardware_legacy/AudioPolicyManagerBase.h>
+
+/*
+ * Replays a generated trace of stream starts and stops, volume changes, headset plugs, calls
+ * and forced routings against AudioPolicyManagerBase with a fake client, with and without the
+ * routing and volume decision cache. Checks that both make the same client calls, that the
+ * cache checker finds no stale decision, and times the replays.
+ *
+ * The policy loads the audio_policy.conf of the device it runs on. Run it like this:
+ *
+ * make audio_policy_benchmark -j32 && \
+ * adb push $OUT/system/bin/audio_policy_benchmark /data/local/tmp && \
+ * adb shell /data/local/tmp/audio_policy_benchmark -e 2000 -n 20
+ *
+ * -e is the number of events in the trace and -n the replays timed per case. The policy
+ * treats music stopped less than 5 seconds ago as still playing, keep a replay well under that
+ * or the logs of the runs can legitimately differ.
+ */
+
+using namespace android_audio_legacy;
+
+/* The calls the policy makes, logged instead of applied. */
+class FakeClient : public AudioPolicyClientInterface
+{
+public:
+    FakeClient() : mNextHandle(1), mLogging(false), mCalls(0) {}
+    virtual ~FakeClient() {}
+
+    void startLog() { mLog.clear(); mCalls = 0; mLogging = true; }
+    const String8& log() const { return mLog; }
+    size_t calls() const { return mCalls; }
+
+    virtual audio_module_handle_t loadHwModule(const char *name) { return mNextHandle++; }
+
+    virtual audio_io_handle_t openOutput(audio_module_handle_t module,
+                                         audio_devices_t *pDevices,
+                                         uint32_t *pSamplingRate,
+                                         audio_format_t *pFormat,
+                                         audio_channel_mask_t *pChannelMask,
+                                         uint32_t *pLatencyMs,
+                                         audio_output_flags_t flags,
+                                         const audio_offload_info_t *offloadInfo)
+    {
+        if (*pSamplingRate == 0) *pSamplingRate = 48000;
+        if (*pFormat == AUDIO_FORMAT_DEFAULT) *pFormat = AUDIO_FORMAT_PCM_16_BIT;
+        if (*pChannelMask == 0) *pChannelMask = AUDIO_CHANNEL_OUT_STEREO;
+        // no latency, or the policy sleeps while it waits for buffers to drain on each reroute
+        *pLatencyMs = 0;
+        logCall("open output %d devices %x\n", mNextHandle, *pDevices);
+        return mNextHandle++;
+    }
+    virtual audio_io_handle_t openDuplicateOutput(audio_io_handle_t output1,
+                                                  audio_io_handle_t output2)
+    {
+        logCall("duplicate %d %d into %d\n", output1, output2, mNextHandle);
+        return mNextHandle++;
+    }
+    virtual status_t closeOutput(audio_io_handle_t output)
+    {
+        logCall("close output %d\n", output);
+        return NO_ERROR;
+    }
+    virtual status_t suspendOutput(audio_io_handle_t output)
+    {
+        logCall("suspend %d\n", output);
+        return NO_ERROR;
+    }
+    virtual status_t restoreOutput(audio_io_handle_t output)
+    {
+        logCall("restore %d\n", output);
+        return NO_ERROR;
+    }
+    virtual audio_io_handle_t openInput(audio_module_handle_t module,
+                                        audio_devices_t *pDevices,
+                                        uint32_t *pSamplingRate,
+                                        audio_format_t *pFormat,
+                                        audio_channel_mask_t *pChannelMask)
+    {
+        return mNextHandle++;
+    }
+    virtual status_t closeInput(audio_io_handle_t input) { return NO_ERROR; }
+    virtual status_t setStreamVolume(AudioSystem::stream_type stream, float volume,
+                                     audio_io_handle_t output, int delayMs)
+    {
+        logCall("volume stream %d output %d %.9g delay %d\n", stream, output, volume, delayMs);
+        return NO_ERROR;
+    }
+    virtual status_t invalidateStream(AudioSystem::stream_type stream)
+    {
+        logCall("invalidate %d\n", stream);
+        return NO_ERROR;
+    }
+    virtual void setParameters(audio_io_handle_t ioHandle, const String8& keyValuePairs,
+                               int delayMs)
+    {
+        logCall("parameters %d %s delay %d\n", ioHandle, keyValuePairs.string(), delayMs);
+    }
+    virtual String8 getParameters(audio_io_handle_t ioHandle, const String8& keys)
+    {
+        return String8("");
+    }
+    virtual status_t startTone(ToneGenerator::tone_type tone, AudioSystem::stream_type stream)
+    {
+        logCall("start tone %d stream %d\n", tone, stream);
+        return NO_ERROR;
+    }
+    virtual status_t stopTone()
+    {
+        logCall("stop tone\n");
+        return NO_ERROR;
+    }
+    virtual status_t setVoiceVolume(float volume, int delayMs)
+    {
+        logCall("voice volume %.9g delay %d\n", volume, delayMs);
+        return NO_ERROR;
+    }
+    virtual status_t moveEffects(int session, audio_io_handle_t srcOutput,
+                                 audio_io_handle_t dstOutput)
+    {
+        logCall("move effects %d from %d to %d\n", session, srcOutput, dstOutput);
+        return NO_ERROR;
+    }
+
+private:
+    void logCall(const char *fmt, ...) __attribute__((format(printf, 2, 3)))
+    {
+        if (!mLogging) {
+            return;
+        }
+        mCalls++;
+        va_list args;
+        va_start(args, fmt);
+        mLog.appendFormatV(fmt, args);
+        va_end(args);
+    }
+
+    int mNextHandle;
+    bool mLogging;
+    String8 mLog;
+    size_t mCalls;
+};
+
+class TestPolicyManager : public AudioPolicyManagerBase
+{
+public:
+    TestPolicyManager(AudioPolicyClientInterface *client, bool cached, bool checked)
+        : AudioPolicyManagerBase(client)
+    {
+        mDecisionCacheEnabled = cached;
+        mCheckDecisionCache = checked;
+    }
+    virtual ~TestPolicyManager() {}
+
+    uint32_t hits() const { return mDecisionCacheHits; }
+    uint32_t misses() const { return mDecisionCacheMisses; }
+    uint32_t mismatches() const { return mDecisionCacheMismatches; }
+};
+
+enum event_type {
+    EVENT_START,
+    EVENT_STOP,
+    EVENT_VOLUME,
+    EVENT_HEADSET,
+    EVENT_PHONE_STATE,
+    EVENT_FORCE_USE,
+};
+
+struct event {
+    event_type type;
+    int stream;
+    int value;
+};
+
+static const AudioSystem::stream_type kStreams[] = {
+    AudioSystem::MUSIC, AudioSystem::RING, AudioSystem::NOTIFICATION, AudioSystem::SYSTEM,
+    AudioSystem::ALARM, AudioSystem::VOICE_CALL, AudioSystem::DTMF,
+};
+static const int kNumStreams = sizeof(kStreams) / sizeof(kStreams[0]);
+
+/* Mostly media and notifications coming and going, now and then a plug, a call or a
+ * routing forced by the user. */
+static void generateTrace(Vector<event>& trace, int events, unsigned int seed)
+{
+    bool active[kNumStreams] = { false };
+    for (int i = 0; i < events; i++) {
+        event e;
+        int stream = rand_r(&seed) % kNumStreams;
+        int dice = rand_r(&seed) % 100;
+        e.stream = stream;
+        e.value = 0;
+        if (dice < 45) {
+            e.type = active[stream] ? EVENT_STOP : EVENT_START;
+            active[stream] = !active[stream];
+        } else if (dice < 75) {
+            e.type = EVENT_VOLUME;
+            e.value = rand_r(&seed) % 16;
+        } else if (dice < 85) {
+            e.type = EVENT_HEADSET;
+            e.value = rand_r(&seed) % 2;
+        } else if (dice < 93) {
+            static const int states[] = {
+                AudioSystem::MODE_NORMAL, AudioSystem::MODE_RINGTONE,
+                AudioSystem::MODE_IN_CALL, AudioSystem::MODE_NORMAL,
+                AudioSystem::MODE_IN_COMMUNICATION, AudioSystem::MODE_NORMAL,
+            };
+            e.type = EVENT_PHONE_STATE;
+            e.value = states[rand_r(&seed) % (sizeof(states) / sizeof(states[0]))];
+        } else {
+            e.type = EVENT_FORCE_USE;
+            e.value = rand_r(&seed) % 4;
+        }
+        trace.add(e);
+    }
+    // leave nothing playing
+    for (int stream = 0; stream < kNumStreams; stream++) {
+        if (active[stream]) {
+            event e = { EVENT_STOP, stream, 0 };
+            trace.add(e);
+        }
+    }
+}
+
+static void replay(AudioPolicyInterface *policy, const Vector<event>& trace)
+{
+    audio_io_handle_t outputs[kNumStreams];
+
+    for (int stream = 0; stream < kNumStreams; stream++) {
+        policy->initStreamVolume(kStreams[stream], 0, 15);
+        policy->setStreamVolumeIndex(kStreams[stream], 10, AUDIO_DEVICE_OUT_DEFAULT);
+    }
+    for (size_t i = 0; i < trace.size(); i++) {
+        const event& e = trace[i];
+        const AudioSystem::stream_type stream = kStreams[e.stream];
+        switch (e.type) {
+        case EVENT_START:
+            outputs[e.stream] = policy->getOutput(stream, 0, AUDIO_FORMAT_DEFAULT, 0,
+                                                  AudioSystem::OUTPUT_FLAG_INDIRECT, NULL);
+            policy->startOutput(outputs[e.stream], stream);
+            break;
+        case EVENT_STOP:
+            policy->stopOutput(outputs[e.stream], stream);
+            policy->releaseOutput(outputs[e.stream]);
+            break;
+        case EVENT_VOLUME:
+            policy->setStreamVolumeIndex(stream, e.value, AUDIO_DEVICE_OUT_DEFAULT);
+            break;
+        case EVENT_HEADSET:
+            policy->setDeviceConnectionState(AUDIO_DEVICE_OUT_WIRED_HEADSET,
+                    e.value ? AudioSystem::DEVICE_STATE_AVAILABLE :
+                              AudioSystem::DEVICE_STATE_UNAVAILABLE, "");
+            break;
+        case EVENT_PHONE_STATE:
+            policy->setPhoneState(e.value);
+            break;
+        case EVENT_FORCE_USE:
+            if (e.value < 2) {
+                policy->setForceUse(AudioSystem::FOR_COMMUNICATION,
+                        e.value ? AudioSystem::FORCE_SPEAKER : AudioSystem::FORCE_NONE);
+            } else {
+                policy->setForceUse(AudioSystem::FOR_MEDIA, e.value == 3 ?
+                        AudioSystem::FORCE_NO_BT_A2DP : AudioSystem::FORCE_NONE);
+            }
+            break;
+        }
+    }
+}
+
+/* the fastest of the replays, the others being slowed down by whatever else runs */
+static long replayTimeUs(const Vector<event>& trace, bool cached, int iterations)
+{
+    struct timespec start, end;
+    long best = -1;
+
+    for (int i = 0; i < iterations; i++) {
+        FakeClient client;
+        TestPolicyManager policy(&client, cached, false);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        replay(&policy, trace);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        long us = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000;
+        if (best < 0 || us < best)
+            best = us;
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    int events = 2000, iterations = 20;
+    bool failed = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "e:n:")) != -1) {
+        switch (opt) {
+        case 'e':
+            events = atoi(optarg);
+            break;
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-e events] [-n replays]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (iterations < 1)
+        iterations = 1;
+
+    Vector<event> trace;
+    generateTrace(trace, events, 1);
+
+    FakeClient uncachedClient;
+    TestPolicyManager uncached(&uncachedClient, false, false);
+    uncachedClient.startLog();
+    replay(&uncached, trace);
+
+    FakeClient cachedClient;
+    TestPolicyManager cached(&cachedClient, true, false);
+    cachedClient.startLog();
+    replay(&cached, trace);
+    if (cachedClient.log() != uncachedClient.log()) {
+        printf("cached decisions change the client calls\n");
+        failed = true;
+    }
+    if (cached.hits() == 0) {
+        printf("no cached decision used\n");
+        failed = true;
+    }
+
+    FakeClient checkedClient;
+    TestPolicyManager checked(&checkedClient, true, true);
+    checkedClient.startLog();
+    replay(&checked, trace);
+    if (checked.mismatches() != 0) {
+        printf("%u cached decisions differ from the policy\n", checked.mismatches());
+        failed = true;
+    }
+    if (checkedClient.log() != uncachedClient.log()) {
+        printf("checked decisions change the client calls\n");
+        failed = true;
+    }
+
+    printf("%zu events, %zu client calls: %u routing decisions cached, %u reused\n",
+           trace.size(), uncachedClient.calls(), cached.misses(), cached.hits());
+    printf("replay %ld us, with cached decisions %ld us\n",
+           replayTimeUs(trace, false, iterations), replayTimeUs(trace, true, iterations));
+
+    printf("%s\n", failed ? "SOMETHING FAILED" : "ALL PASSED");
+    return failed ? 1 : 0;
+}
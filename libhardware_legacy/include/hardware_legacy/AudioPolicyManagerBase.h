@@ -56,6 +56,12 @@ namespace android_audio_legacy {
 // Can be overridden by the audio.offload.min.duration.secs property
 #define OFFLOAD_DEFAULT_MIN_DURATION_SECS 60
 
+// Number of routing states whose decisions are kept before they are all dropped: a device
+// rarely goes through more than a few (phone states times connected accessories)
+#define MAX_ROUTING_DECISIONS 32
+// Largest volume index range whose amplifications are tabulated per stream and device category
+#define MAX_AMPL_TABLE_SIZE 128
+
 // ----------------------------------------------------------------------------
 // AudioPolicyManagerBase implements audio policy manager behavior common to all platforms.
 // Each platform must implement an AudioPolicyManager class derived from AudioPolicyManagerBase
@@ -324,6 +330,21 @@ protected:
             bool mCanBeMuted;   // true is the stream can be muted
 
             const VolumeCurvePoint *mVolumeCurve[DEVICE_CATEGORY_CNT];
+
+            // volIndexToAmpl() results for indices mIndexMin to mIndexMax on one device
+            // category, valid as long as the curve and index range match the ones they were
+            // computed for. See cachedVolIndexToAmpl().
+            class AmplTable
+            {
+            public:
+                AmplTable() : mCurve(NULL), mIndexMin(0), mIndexMax(0) {}
+
+                const VolumeCurvePoint *mCurve;
+                int mIndexMin;
+                int mIndexMax;
+                Vector<float> mAmpl;
+            };
+            AmplTable mAmplTable[DEVICE_CATEGORY_CNT];
         };
 
         // stream descriptor used for volume control
@@ -460,6 +481,25 @@ protected:
 
         void updateDevicesAndOutputs();
 
+        // device choices of getDeviceForStrategy() for one routing state, see getRoutingKey()
+        class RoutingDecision
+        {
+        public:
+            RoutingDecision() : mValid(0) {}
+
+            audio_devices_t mDevice[NUM_STRATEGIES];
+            uint32_t mValid; // bit field of the strategies mDevice[] holds a device for
+        };
+
+        // packs everything getDeviceForStrategy() reads, apart from the stream activity
+        // STRATEGY_SONIFICATION_RESPECTFUL depends on, in a key of mRoutingDecisions.
+        // Returns false if the state does not fit in a key and must not be cached.
+        bool getRoutingKey(uint64_t *key);
+
+        // forgets all cached routing decisions. Subclasses whose getDeviceForStrategy() reads
+        // more state than getRoutingKey() packs must call it when that state changes.
+        void invalidateRoutingDecisions();
+
         virtual uint32_t getMaxEffectsCpuLoad();
         virtual uint32_t getMaxEffectsMemory();
 #ifdef AUDIO_POLICY_TEST
@@ -573,6 +613,18 @@ protected:
 
         Vector <HwModule *> mHwModules;
 
+        // routing decisions already taken, by routing key. Entries never go stale as the key
+        // holds all their inputs, the table is only emptied when it grows too large.
+        KeyedVector<uint64_t, RoutingDecision> mRoutingDecisions;
+        audio_devices_t mRoutingDecisionsDefaultDevice; // mDefaultOutputDevice they were taken for
+        uint64_t mLastRoutingKey;       // key looked up last, routing state rarely changes
+        ssize_t mLastRoutingIndex;      // its index in mRoutingDecisions, -1 if none
+        bool mDecisionCacheEnabled;     // use mRoutingDecisions and the stream amplification tables
+        bool mCheckDecisionCache;       // recompute cached decisions and report differences
+        uint32_t mDecisionCacheHits;
+        uint32_t mDecisionCacheMisses;
+        uint32_t mDecisionCacheMismatches;
+
 #ifdef AUDIO_POLICY_TEST
         Mutex   mLock;
         Condition mWaitWorkCV;
@@ -591,6 +643,13 @@ protected:
 private:
         static float volIndexToAmpl(audio_devices_t device, const StreamDescriptor& streamDesc,
                 int indexInUi);
+        // volIndexToAmpl() through the amplification tables of streamDesc
+        float cachedVolIndexToAmpl(audio_devices_t device, StreamDescriptor& streamDesc,
+                int indexInUi);
+        // getDeviceForStrategy() with fromCache false, without mRoutingDecisions
+        audio_devices_t computeDeviceForStrategy(routing_strategy strategy);
+        // true if mPreviousOutputs holds the same outputs as mOutputs
+        bool outputsUnchanged();
         // updates device caching and output for streams that can influence the
         //    routing of notifications
         void handleNotificationRoutingForStream(AudioSystem::stream_type stream);
@@ -28,6 +28,7 @@ LOCAL_SRC_FILES := \
 	audio_hw.c \
 	voice.c \
 	platform_info.c \
+	mixer_update.c \
 	audio_extn/ext_speaker.c \
 	$(AUDIO_PLATFORM)/platform.c
 
@@ -96,4 +97,6 @@ LOCAL_MODULE_TAGS := optional
 
 include $(BUILD_SHARED_LIBRARY)
 
+include $(call all-makefiles-under, $(LOCAL_PATH))
+
 endif
@@ -231,6 +231,8 @@ static int32_t stop_hfp(struct audio_device *adev)
         return -EINVAL;
     }
 
+    mixer_update_begin(&adev->mixer_update);
+
     /* 2. Get and set stream specific mixer controls */
     disable_audio_route(adev, uc_info);
 
@@ -238,6 +240,8 @@ static int32_t stop_hfp(struct audio_device *adev)
     disable_snd_device(adev, uc_info->out_snd_device);
     disable_snd_device(adev, uc_info->in_snd_device);
 
+    mixer_update_commit(&adev->mixer_update);
+
     list_remove(&uc_info->list);
     free(uc_info);
 
@@ -816,7 +816,7 @@ int audio_extn_spkr_prot_start_processing(snd_device_t snd_device)
     }
     ALOGV("%s: snd_device(%d: %s)", __func__, snd_device,
            platform_get_snd_device_name(snd_device));
-    audio_route_apply_and_update_path(adev->audio_route,
+    mixer_update_apply_path(&adev->mixer_update,
            platform_get_snd_device_name(snd_device));
 
     pthread_mutex_lock(&handle.mutex_spkr_prot);
@@ -829,6 +829,9 @@ int audio_extn_spkr_prot_start_processing(snd_device_t snd_device)
         list_add_tail(&adev->usecase_list, &uc_info_tx->list);
         enable_snd_device(adev, SND_DEVICE_IN_CAPTURE_VI_FEEDBACK);
         enable_audio_route(adev, uc_info_tx);
+        /* we are called from enable_snd_device(), possibly inside a routing
+         * transaction: the feedback path must be live before the pcm opens */
+        mixer_update_flush(&adev->mixer_update);
 
         pcm_dev_tx_id = platform_get_pcm_device_id(uc_info_tx->id, PCM_CAPTURE);
         if (pcm_dev_tx_id < 0) {
@@ -893,7 +896,7 @@ void audio_extn_spkr_prot_stop_processing(snd_device_t snd_device)
     handle.spkr_processing_state = SPKR_PROCESSING_IN_IDLE;
     pthread_mutex_unlock(&handle.mutex_spkr_prot);
     if (adev)
-        audio_route_reset_and_update_path(adev->audio_route,
+        mixer_update_reset_path(&adev->mixer_update,
                                       platform_get_snd_device_name(snd_device));
     ALOGV("%s: Exit", __func__);
 }
@@ -259,7 +259,7 @@ int enable_audio_route(struct audio_device *adev,
     strcpy(mixer_path, use_case_table[usecase->id]);
     platform_add_backend_name(adev->platform, mixer_path, snd_device);
     ALOGD("%s: apply and update mixer path: %s", __func__, mixer_path);
-    audio_route_apply_and_update_path(adev->audio_route, mixer_path);
+    mixer_update_apply_path(&adev->mixer_update, mixer_path);
 
     ALOGV("%s: exit", __func__);
     return 0;
@@ -282,7 +282,7 @@ int disable_audio_route(struct audio_device *adev,
     strcpy(mixer_path, use_case_table[usecase->id]);
     platform_add_backend_name(adev->platform, mixer_path, snd_device);
     ALOGD("%s: reset and update mixer path: %s", __func__, mixer_path);
-    audio_route_reset_and_update_path(adev->audio_route, mixer_path);
+    mixer_update_reset_path(&adev->mixer_update, mixer_path);
 
     ALOGV("%s: exit", __func__);
     return 0;
@@ -342,7 +342,7 @@ int enable_snd_device(struct audio_device *adev,
     } else {
         const char * dev_path = platform_get_snd_device_name(snd_device);
         ALOGD("%s: snd_device(%d: %s)", __func__, snd_device, dev_path);
-        audio_route_apply_and_update_path(adev->audio_route, dev_path);
+        mixer_update_apply_path(&adev->mixer_update, dev_path);
     }
 
     return 0;
@@ -378,7 +378,7 @@ int disable_snd_device(struct audio_device *adev,
                 disable_snd_device(adev, new_snd_devices[i]);
             }
         } else {
-            audio_route_reset_and_update_path(adev->audio_route, dev_path);
+            mixer_update_reset_path(&adev->mixer_update, dev_path);
         }
         audio_extn_sound_trigger_update_device_status(snd_device,
                                         ST_EVENT_SND_DEVICE_FREE);
@@ -664,6 +664,12 @@ int select_devices(struct audio_device *adev,
           out_snd_device, platform_get_snd_device_name(out_snd_device),
           in_snd_device,  platform_get_snd_device_name(in_snd_device));
 
+    /*
+     * Collect the whole switch in one routing transaction so that each mixer
+     * control is written once, with its final value, when it is committed.
+     */
+    mixer_update_begin(&adev->mixer_update);
+
     /*
      * Limitation: While in call, to do a device switch we need to disable
      * and enable both RX and TX devices though one of them is same as current
@@ -686,6 +692,10 @@ int select_devices(struct audio_device *adev,
         disable_snd_device(adev, usecase->in_snd_device);
     }
 
+    /* In call the old devices must really go off, see the limitation above */
+    if (usecase->type == VOICE_CALL)
+        mixer_update_flush(&adev->mixer_update);
+
     /* Applicable only on the targets that has external modem.
      * New device information should be sent to modem before enabling
      * the devices to reduce in-call device switch time.
@@ -710,16 +720,20 @@ int select_devices(struct audio_device *adev,
         enable_snd_device(adev, in_snd_device);
     }
 
-    if (usecase->type == VOICE_CALL)
+    if (usecase->type == VOICE_CALL) {
+        mixer_update_flush(&adev->mixer_update);
         status = platform_switch_voice_call_device_post(adev->platform,
                                                         out_snd_device,
                                                         in_snd_device);
+    }
 
     usecase->in_snd_device = in_snd_device;
     usecase->out_snd_device = out_snd_device;
 
     enable_audio_route(adev, usecase);
 
+    mixer_update_commit(&adev->mixer_update);
+
     /* Applicable only on the targets that has external modem.
      * Enable device command should be sent to modem only after
      * enabling voice call mixer controls
@@ -749,12 +763,16 @@ static int stop_input_stream(struct stream_in *in)
         return -EINVAL;
     }
 
+    mixer_update_begin(&adev->mixer_update);
+
     /* 1. Disable stream specific mixer controls */
     disable_audio_route(adev, uc_info);
 
     /* 2. Disable the tx device */
     disable_snd_device(adev, uc_info->in_snd_device);
 
+    mixer_update_commit(&adev->mixer_update);
+
     list_remove(&uc_info->list);
     free(uc_info);
 
@@ -1074,12 +1092,16 @@ static int stop_output_stream(struct stream_out *out)
             adev->offload_effects_stop_output(out->handle, out->pcm_device_id);
     }
 
+    mixer_update_begin(&adev->mixer_update);
+
     /* 1. Get and set stream specific mixer controls */
     disable_audio_route(adev, uc_info);
 
     /* 2. Disable the rx device */
     disable_snd_device(adev, uc_info->out_snd_device);
 
+    mixer_update_commit(&adev->mixer_update);
+
     list_remove(&uc_info->list);
     free(uc_info);
 
@@ -2809,6 +2831,8 @@ static int adev_open(const hw_module_t *module, const char *name,
         return -EINVAL;
     }
 
+    mixer_update_init(&adev->mixer_update, adev->audio_route);
+
     adev->extspk = audio_extn_extspk_init(adev);
     audio_extn_sound_trigger_init(adev);
 
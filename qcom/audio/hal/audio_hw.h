@@ -25,6 +25,7 @@
 #include <tinycompress/tinycompress.h>
 
 #include <audio_route/audio_route.h>
+#include "mixer_update.h"
 #include "voice.h"
 
 #define VISUALIZER_LIBRARY_PATH "/system/lib/soundfx/libqcomvisualizer.so"
@@ -215,6 +216,7 @@ struct audio_device {
     int *snd_dev_ref_cnt;
     struct listnode usecase_list;
     struct audio_route *audio_route;
+    struct mixer_update mixer_update;
     int acdb_settings;
     struct voice voice;
     unsigned int cur_hdmi_channels;
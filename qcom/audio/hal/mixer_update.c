@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "mixer_update"
+/*#define LOG_NDEBUG 0*/
+
+#include <cutils/log.h>
+#include <audio_route/audio_route.h>
+
+#include "mixer_update.h"
+
+void mixer_update_init(struct mixer_update *update, struct audio_route *audio_route)
+{
+    update->audio_route = audio_route;
+    update->depth = 0;
+    update->pending = false;
+    update->paths = 0;
+}
+
+void mixer_update_begin(struct mixer_update *update)
+{
+    if (update->depth++ == 0)
+        update->paths = 0;
+}
+
+void mixer_update_apply_path(struct mixer_update *update, const char *name)
+{
+    if (update->depth == 0) {
+        audio_route_apply_and_update_path(update->audio_route, name);
+        return;
+    }
+    audio_route_apply_path(update->audio_route, name);
+    update->pending = true;
+    update->paths++;
+}
+
+void mixer_update_reset_path(struct mixer_update *update, const char *name)
+{
+    if (update->depth == 0) {
+        audio_route_reset_and_update_path(update->audio_route, name);
+        return;
+    }
+    audio_route_reset_path(update->audio_route, name);
+    update->pending = true;
+    update->paths++;
+}
+
+void mixer_update_flush(struct mixer_update *update)
+{
+    if (update->pending) {
+        audio_route_update_mixer(update->audio_route);
+        update->pending = false;
+    }
+}
+
+void mixer_update_commit(struct mixer_update *update)
+{
+    if (update->depth == 0) {
+        ALOGE("%s: no transaction to commit", __func__);
+        return;
+    }
+    if (--update->depth > 0)
+        return;
+
+    ALOGV("%s: writing %u path changes", __func__, update->paths);
+    mixer_update_flush(update);
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MIXER_UPDATE_H
+#define MIXER_UPDATE_H
+
+#include <stdbool.h>
+
+struct audio_route;
+
+/*
+ * Routing transactions. Between mixer_update_begin() and the matching
+ * mixer_update_commit(), applying or resetting a mixer path only changes the
+ * audio_route state; the commit then writes each control whose value differs
+ * from what the mixer holds, once, with a single audio_route_update_mixer().
+ * A control that a device switch turns off and on again is not written at all.
+ *
+ * Outside a transaction paths are written immediately, as
+ * audio_route_apply_and_update_path() and audio_route_reset_and_update_path()
+ * do. Transactions nest and only the outermost commit writes. Callers must hold
+ * the audio_device lock for the whole transaction.
+ */
+struct mixer_update {
+    struct audio_route *audio_route;
+    unsigned int depth;
+    bool pending;       /* paths changed since the mixer was last written */
+    unsigned int paths; /* path changes batched since the outermost begin */
+};
+
+void mixer_update_init(struct mixer_update *update, struct audio_route *audio_route);
+
+void mixer_update_begin(struct mixer_update *update);
+
+void mixer_update_apply_path(struct mixer_update *update, const char *name);
+
+void mixer_update_reset_path(struct mixer_update *update, const char *name);
+
+/* Writes the pending changes now without ending the transaction, for code that
+ * must open a PCM on a route it just enabled. */
+void mixer_update_flush(struct mixer_update *update);
+
+void mixer_update_commit(struct mixer_update *update);
+
+#endif /* MIXER_UPDATE_H */
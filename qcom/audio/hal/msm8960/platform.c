@@ -1040,10 +1040,10 @@ int platform_swap_lr_channels(struct audio_device *adev, bool swap_channels)
                 const char *mixer_path;
                 if (swap_channels) {
                     mixer_path = platform_get_snd_device_name(SND_DEVICE_OUT_SPEAKER_REVERSE);
-                    audio_route_apply_and_update_path(adev->audio_route, mixer_path);
+                    mixer_update_apply_path(&adev->mixer_update, mixer_path);
                 } else {
                     mixer_path = platform_get_snd_device_name(SND_DEVICE_OUT_SPEAKER);
-                    audio_route_apply_and_update_path(adev->audio_route, mixer_path);
+                    mixer_update_apply_path(&adev->mixer_update, mixer_path);
                 }
                 break;
             }
@@ -512,9 +512,12 @@ void platform_set_echo_reference(struct audio_device *adev, bool enable, audio_d
     struct platform_data *my_data = (struct platform_data *)adev->platform;
     snd_device_t snd_device = SND_DEVICE_NONE;
 
+    /* moving the reference between backends writes only the controls that differ */
+    mixer_update_begin(&adev->mixer_update);
+
     if (strcmp(my_data->ec_ref_mixer_path, "")) {
         ALOGV("%s: diabling %s", __func__, my_data->ec_ref_mixer_path);
-        audio_route_reset_and_update_path(adev->audio_route, my_data->ec_ref_mixer_path);
+        mixer_update_reset_path(&adev->mixer_update, my_data->ec_ref_mixer_path);
     }
 
     if (enable) {
@@ -525,8 +528,10 @@ void platform_set_echo_reference(struct audio_device *adev, bool enable, audio_d
         }
 
         ALOGD("%s: enabling %s", __func__, my_data->ec_ref_mixer_path);
-        audio_route_apply_and_update_path(adev->audio_route, my_data->ec_ref_mixer_path);
+        mixer_update_apply_path(&adev->mixer_update, my_data->ec_ref_mixer_path);
     }
+
+    mixer_update_commit(&adev->mixer_update);
 }
 
 static struct csd_data *open_csd_client(bool i2s_ext_modem)
@@ -2100,10 +2105,10 @@ int platform_swap_lr_channels(struct audio_device *adev, bool swap_channels)
                 const char *mixer_path;
                 if (swap_channels) {
                     mixer_path = platform_get_snd_device_name(SND_DEVICE_OUT_SPEAKER_REVERSE);
-                    audio_route_apply_and_update_path(adev->audio_route, mixer_path);
+                    mixer_update_apply_path(&adev->mixer_update, mixer_path);
                 } else {
                     mixer_path = platform_get_snd_device_name(SND_DEVICE_OUT_SPEAKER);
-                    audio_route_apply_and_update_path(adev->audio_route, mixer_path);
+                    mixer_update_apply_path(&adev->mixer_update, mixer_path);
                 }
                 break;
             }
@@ -63,6 +63,8 @@ int platform_set_snd_device_backend(snd_device_t snd_device, const char * backen
 
 /* From platform_info.c */
 int platform_info_init(void *);
+/* As platform_info_init() with other paths; cache_path may be NULL to always parse */
+int platform_info_load(void *platform, const char *xml_path, const char *cache_path);
 
 int platform_get_usecase_index(const char * usecase);
 int platform_set_usecase_pcm_id(audio_usecase_t usecase, int32_t type, int32_t pcm_id);
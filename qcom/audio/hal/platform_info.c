@@ -18,7 +18,13 @@
 #define LOG_NDDEBUG 0
 
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <expat.h>
 #include <cutils/log.h>
 #include <audio_hw.h>
@@ -26,6 +32,44 @@
 #include <platform.h>
 
 #define PLATFORM_INFO_XML_PATH      "/system/etc/audio_platform_info.xml"
+#define PLATFORM_INFO_CACHE_PATH    "/data/misc/audio/audio_platform_info.cache"
+
+/*
+ * The settings made while parsing the XML are recorded, in order, into a
+ * binary cache next to the hash of the XML they came from. While the XML
+ * hashes the same, later starts replay the cache instead of parsing.
+ *
+ * Every well formed entry is recorded whether or not the HAL knows its
+ * device or usecase, and names are looked up again on replay, so a cache
+ * stays valid when the HAL is rebuilt with different tables.
+ * Bump CACHE_VERSION when the records or what they mean change.
+ */
+#define CACHE_MAGIC     0x43495041 /* "APIC" */
+#define CACHE_VERSION   2
+
+struct cache_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t xml_hash;
+    uint32_t xml_size;
+    uint32_t payload_size;
+    uint64_t payload_hash;
+};
+
+typedef enum {
+    RECORD_ACDB_ID,         /* values: acdb id; strings: device */
+    RECORD_PCM_ID,          /* values: type, pcm id; strings: usecase */
+    RECORD_BACKEND,         /* values: has interface; strings: device, backend, interface */
+    RECORD_CONFIG_PARAM,    /* strings: key, value */
+    RECORD_CONFIG_END,      /* end of config_params, apply what was collected */
+} record_type_t;
+
+struct cache_record {
+    uint16_t type;
+    uint16_t size;          /* including the strings, a multiple of 4 */
+    int32_t values[2];
+    /* followed by the NUL terminated strings */
+};
 
 typedef enum {
     ROOT,
@@ -56,6 +100,10 @@ static section_t section;
 struct platform_info {
     void             *platform;
     struct str_parms *kvpairs;
+    /* records for the cache, NULL when not recording */
+    uint8_t          *records;
+    size_t           records_size;
+    size_t           records_capacity;
 };
 
 static struct platform_info my_data;
@@ -86,6 +134,56 @@ static struct platform_info my_data;
  * </audio_platform_info>
  */
 
+/* appends a record for the cache if one is being built */
+static void record(record_type_t type, int32_t value0, int32_t value1,
+                   const char *str0, const char *str1, const char *str2)
+{
+    const char *strs[] = { str0, str1, str2 };
+    size_t size = sizeof(struct cache_record);
+    struct cache_record *rec;
+    uint8_t *p;
+    unsigned int i;
+
+    if (my_data.records == NULL)
+        return;
+
+    for (i = 0; i < 3 && strs[i] != NULL; i++)
+        size += strlen(strs[i]) + 1;
+    size = (size + 3) & ~3;
+    if (size > UINT16_MAX) {
+        ALOGE("%s: %s too long to cache", __func__, str0);
+        free(my_data.records);
+        my_data.records = NULL;
+        return;
+    }
+
+    if (my_data.records_size + size > my_data.records_capacity) {
+        size_t capacity = 2 * my_data.records_capacity + size;
+        uint8_t *records = realloc(my_data.records, capacity);
+        if (records == NULL) {
+            free(my_data.records);
+            my_data.records = NULL;
+            return;
+        }
+        my_data.records = records;
+        my_data.records_capacity = capacity;
+    }
+
+    p = my_data.records + my_data.records_size;
+    memset(p, 0, size);
+    rec = (struct cache_record *)p;
+    rec->type = type;
+    rec->size = size;
+    rec->values[0] = value0;
+    rec->values[1] = value1;
+    p += sizeof(*rec);
+    for (i = 0; i < 3 && strs[i] != NULL; i++) {
+        strcpy((char *)p, strs[i]);
+        p += strlen(strs[i]) + 1;
+    }
+    my_data.records_size += size;
+}
+
 static void process_root(const XML_Char **attr __unused)
 {
 }
@@ -100,13 +198,6 @@ static void process_pcm_id(const XML_Char **attr)
         goto done;
     }
 
-    index = platform_get_usecase_index((char *)attr[1]);
-    if (index < 0) {
-        ALOGE("%s: usecase %s in %s not found!",
-              __func__, attr[1], PLATFORM_INFO_XML_PATH);
-        goto done;
-    }
-
     if (strcmp(attr[2], "type") != 0) {
         ALOGE("%s: usecase type not mentioned", __func__);
         goto done;
@@ -129,6 +220,14 @@ static void process_pcm_id(const XML_Char **attr)
     }
 
     int id = atoi((char *)attr[5]);
+    record(RECORD_PCM_ID, type, id, attr[1], NULL, NULL);
+
+    index = platform_get_usecase_index((char *)attr[1]);
+    if (index < 0) {
+        ALOGE("%s: usecase %s in %s not found!",
+              __func__, attr[1], PLATFORM_INFO_XML_PATH);
+        goto done;
+    }
 
     if (platform_set_usecase_pcm_id(index, type, id) < 0) {
         ALOGE("%s: usecase %s in %s, type %d id %d was not set!",
@@ -151,13 +250,6 @@ static void process_backend_name(const XML_Char **attr)
         goto done;
     }
 
-    index = platform_get_snd_device_index((char *)attr[1]);
-    if (index < 0) {
-        ALOGE("%s: Device %s in %s not found, no ACDB ID set!",
-              __func__, attr[1], PLATFORM_INFO_XML_PATH);
-        goto done;
-    }
-
     if (strcmp(attr[2], "backend") != 0) {
         ALOGE("%s: Device %s in %s has no backed set!",
               __func__, attr[1], PLATFORM_INFO_XML_PATH);
@@ -171,6 +263,14 @@ static void process_backend_name(const XML_Char **attr)
             hw_interface = (char *)attr[5];
         }
     }
+    record(RECORD_BACKEND, hw_interface != NULL, 0, attr[1], attr[3], hw_interface);
+
+    index = platform_get_snd_device_index((char *)attr[1]);
+    if (index < 0) {
+        ALOGE("%s: Device %s in %s not found, no ACDB ID set!",
+              __func__, attr[1], PLATFORM_INFO_XML_PATH);
+        goto done;
+    }
 
     if (platform_set_snd_device_backend(index, attr[3], hw_interface) < 0) {
         ALOGE("%s: Device %s in %s, backend %s was not set!",
@@ -191,15 +291,16 @@ static void process_acdb_id(const XML_Char **attr)
         goto done;
     }
 
-    index = platform_get_snd_device_index((char *)attr[1]);
-    if (index < 0) {
-        ALOGE("%s: Device %s in %s not found, no ACDB ID set!",
+    if (strcmp(attr[2], "acdb_id") != 0) {
+        ALOGE("%s: Device %s in %s has no acdb_id, no ACDB ID set!",
               __func__, attr[1], PLATFORM_INFO_XML_PATH);
         goto done;
     }
+    record(RECORD_ACDB_ID, atoi((char *)attr[3]), 0, attr[1], NULL, NULL);
 
-    if (strcmp(attr[2], "acdb_id") != 0) {
-        ALOGE("%s: Device %s in %s has no acdb_id, no ACDB ID set!",
+    index = platform_get_snd_device_index((char *)attr[1]);
+    if (index < 0) {
+        ALOGE("%s: Device %s in %s not found, no ACDB ID set!",
               __func__, attr[1], PLATFORM_INFO_XML_PATH);
         goto done;
     }
@@ -228,6 +329,7 @@ static void process_config_params(const XML_Char **attr)
     }
 
     str_parms_add_str(my_data.kvpairs, (char*)attr[1], (char*)attr[3]);
+    record(RECORD_CONFIG_PARAM, 0, 0, attr[1], attr[3], NULL);
 done:
     return;
 }
@@ -288,71 +390,270 @@ static void end_tag(void *userdata __unused, const XML_Char *tag_name)
     } else if (strcmp(tag_name, "config_params") == 0) {
         section = ROOT;
         platform_set_parameters(my_data.platform, my_data.kvpairs);
+        record(RECORD_CONFIG_END, 0, 0, NULL, NULL, NULL);
+    }
+}
+
+/* 64-bit FNV-1a */
+static uint64_t hash_bytes(const uint8_t *data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/* returns the string after the first n of a record, or NULL if it runs past the record */
+static const char *record_string(const struct cache_record *rec, unsigned int n)
+{
+    const char *str = (const char *)(rec + 1);
+    const char *end = (const char *)rec + rec->size;
+
+    while (str < end) {
+        const char *nul = memchr(str, '\0', end - str);
+        if (nul == NULL)
+            return NULL;
+        if (n-- == 0)
+            return str;
+        str = nul + 1;
+    }
+    return NULL;
+}
+
+static bool record_is_valid(const struct cache_record *rec)
+{
+    switch (rec->type) {
+    case RECORD_ACDB_ID:
+    case RECORD_PCM_ID:
+        return record_string(rec, 0) != NULL;
+    case RECORD_BACKEND:
+        return record_string(rec, rec->values[0] ? 2 : 1) != NULL;
+    case RECORD_CONFIG_PARAM:
+        return record_string(rec, 1) != NULL;
+    case RECORD_CONFIG_END:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void replay_record(const struct cache_record *rec)
+{
+    const char *name = record_string(rec, 0);
+    int index;
+
+    switch (rec->type) {
+    case RECORD_ACDB_ID:
+        index = platform_get_snd_device_index((char *)name);
+        if (index < 0 || platform_set_snd_device_acdb_id(index, rec->values[0]) < 0)
+            ALOGE("%s: Device %s, ACDB ID %d was not set!", __func__, name, rec->values[0]);
+        break;
+    case RECORD_PCM_ID:
+        index = platform_get_usecase_index(name);
+        if (index < 0 || platform_set_usecase_pcm_id(index, rec->values[0], rec->values[1]) < 0)
+            ALOGE("%s: usecase %s, type %d id %d was not set!",
+                  __func__, name, rec->values[0], rec->values[1]);
+        break;
+    case RECORD_BACKEND:
+        index = platform_get_snd_device_index((char *)name);
+        if (index < 0 ||
+                platform_set_snd_device_backend(index, record_string(rec, 1),
+                        rec->values[0] ? record_string(rec, 2) : NULL) < 0)
+            ALOGE("%s: Device %s, backend %s was not set!",
+                  __func__, name, record_string(rec, 1));
+        break;
+    case RECORD_CONFIG_PARAM:
+        str_parms_add_str(my_data.kvpairs, name, record_string(rec, 1));
+        break;
+    case RECORD_CONFIG_END:
+        platform_set_parameters(my_data.platform, my_data.kvpairs);
+        break;
+    }
+}
+
+/* replays the cache if it was built from this XML, returns 0 if it did */
+static int load_cache(const char *cache_path, uint64_t xml_hash, size_t xml_size)
+{
+    const struct cache_header *header;
+    const uint8_t *payload;
+    struct stat st;
+    void *map;
+    size_t offset;
+    int fd;
+    int ret = -EINVAL;
+
+    fd = open(cache_path, O_RDONLY);
+    if (fd < 0)
+        return -ENOENT;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(*header)) {
+        close(fd);
+        return -EINVAL;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -ENOMEM;
+
+    header = map;
+    payload = (const uint8_t *)(header + 1);
+    if (header->magic != CACHE_MAGIC || header->version != CACHE_VERSION ||
+            header->xml_hash != xml_hash || header->xml_size != xml_size ||
+            header->payload_size != st.st_size - sizeof(*header) ||
+            header->payload_hash != hash_bytes(payload, header->payload_size)) {
+        ALOGD("%s: %s is stale", __func__, cache_path);
+        goto done;
+    }
+
+    /* check every record before applying any of them */
+    for (offset = 0; offset < header->payload_size; ) {
+        const struct cache_record *rec = (const struct cache_record *)(payload + offset);
+        if (header->payload_size - offset < sizeof(*rec) || rec->size < sizeof(*rec) ||
+                (rec->size & 3) != 0 || rec->size > header->payload_size - offset ||
+                !record_is_valid(rec)) {
+            ALOGE("%s: %s is corrupt", __func__, cache_path);
+            goto done;
+        }
+        offset += rec->size;
+    }
+
+    for (offset = 0; offset < header->payload_size; ) {
+        const struct cache_record *rec = (const struct cache_record *)(payload + offset);
+        replay_record(rec);
+        offset += rec->size;
+    }
+    ret = 0;
+
+done:
+    munmap(map, st.st_size);
+    return ret;
+}
+
+static void write_cache(const char *cache_path, uint64_t xml_hash, size_t xml_size)
+{
+    struct cache_header header;
+    char tmp_path[PATH_MAX];
+    int fd;
+
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.xml_hash = xml_hash;
+    header.xml_size = xml_size;
+    header.payload_size = my_data.records_size;
+    header.payload_hash = hash_bytes(my_data.records, my_data.records_size);
+
+    /* write aside and rename so a reader never sees half a cache */
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", cache_path);
+    fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0640);
+    if (fd < 0) {
+        ALOGV("%s: cannot create %s", __func__, tmp_path);
+        return;
+    }
+    if (write(fd, &header, sizeof(header)) != (ssize_t)sizeof(header) ||
+            write(fd, my_data.records, my_data.records_size) != (ssize_t)my_data.records_size ||
+            fsync(fd) < 0) {
+        ALOGE("%s: failed to write %s", __func__, tmp_path);
+        close(fd);
+        unlink(tmp_path);
+        return;
+    }
+    close(fd);
+    if (rename(tmp_path, cache_path) < 0) {
+        ALOGE("%s: failed to rename %s", __func__, tmp_path);
+        unlink(tmp_path);
     }
 }
 
 int platform_info_init(void *platform)
+{
+    return platform_info_load(platform, PLATFORM_INFO_XML_PATH, PLATFORM_INFO_CACHE_PATH);
+}
+
+int platform_info_load(void *platform, const char *xml_path, const char *cache_path)
 {
     XML_Parser      parser;
-    FILE            *file;
+    int             fd;
     int             ret = 0;
-    int             bytes_read;
-    void            *buf;
-    static const uint32_t kBufSize = 1024;
+    struct stat     st;
+    uint8_t         *xml;
+    uint64_t        xml_hash;
 
     section = ROOT;
 
-    file = fopen(PLATFORM_INFO_XML_PATH, "r");
-    if (!file) {
+    fd = open(xml_path, O_RDONLY);
+    if (fd < 0) {
         ALOGD("%s: Failed to open %s, using defaults.",
-            __func__, PLATFORM_INFO_XML_PATH);
+            __func__, xml_path);
         ret = -ENODEV;
         goto done;
     }
 
-    parser = XML_ParserCreate(NULL);
-    if (!parser) {
-        ALOGE("%s: Failed to create XML parser!", __func__);
-        ret = -ENODEV;
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+        ALOGE("%s: Failed to stat %s", __func__, xml_path);
+        ret = -EINVAL;
+        goto err_close_file;
+    }
+
+    xml = malloc(st.st_size);
+    if (xml == NULL) {
+        ret = -ENOMEM;
         goto err_close_file;
     }
+    if (read(fd, xml, st.st_size) != st.st_size) {
+        ALOGE("%s: read failed for %s", __func__, xml_path);
+        ret = -EIO;
+        goto err_free_xml;
+    }
 
     my_data.platform = platform;
     my_data.kvpairs = str_parms_create();
 
-    XML_SetElementHandler(parser, start_tag, end_tag);
+    xml_hash = hash_bytes(xml, st.st_size);
+    if (cache_path != NULL && load_cache(cache_path, xml_hash, st.st_size) == 0) {
+        ALOGV("%s: loaded %s", __func__, cache_path);
+        goto err_free_xml;
+    }
 
-    while (1) {
-        buf = XML_GetBuffer(parser, kBufSize);
-        if (buf == NULL) {
-            ALOGE("%s: XML_GetBuffer failed", __func__);
-            ret = -ENOMEM;
-            goto err_free_parser;
-        }
+    parser = XML_ParserCreate(NULL);
+    if (!parser) {
+        ALOGE("%s: Failed to create XML parser!", __func__);
+        ret = -ENODEV;
+        goto err_free_xml;
+    }
 
-        bytes_read = fread(buf, 1, kBufSize, file);
-        if (bytes_read < 0) {
-            ALOGE("%s: fread failed, bytes read = %d", __func__, bytes_read);
-             ret = bytes_read;
-            goto err_free_parser;
-        }
+    if (cache_path != NULL) {
+        my_data.records = malloc(1024);
+        my_data.records_size = 0;
+        my_data.records_capacity = my_data.records != NULL ? 1024 : 0;
+    }
 
-        if (XML_ParseBuffer(parser, bytes_read,
-                            bytes_read == 0) == XML_STATUS_ERROR) {
-            ALOGE("%s: XML_ParseBuffer failed, for %s",
-                __func__, PLATFORM_INFO_XML_PATH);
-            ret = -EINVAL;
-            goto err_free_parser;
-        }
+    XML_SetElementHandler(parser, start_tag, end_tag);
 
-        if (bytes_read == 0)
-            break;
+    if (XML_Parse(parser, (const char *)xml, st.st_size, 1) == XML_STATUS_ERROR) {
+        ALOGE("%s: XML_Parse failed, for %s",
+            __func__, xml_path);
+        ret = -EINVAL;
+        goto err_free_parser;
     }
 
+    if (my_data.records != NULL)
+        write_cache(cache_path, xml_hash, st.st_size);
+
 err_free_parser:
+    free(my_data.records);
+    my_data.records = NULL;
     XML_ParserFree(parser);
+err_free_xml:
+    if (my_data.kvpairs != NULL) {
+        str_parms_destroy(my_data.kvpairs);
+        my_data.kvpairs = NULL;
+    }
+    free(xml);
 err_close_file:
-    fclose(file);
+    close(fd);
 done:
     return ret;
 }
@@ -0,0 +1,43 @@
+LOCAL_PATH := $(call my-dir)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	mixer_update_test.c \
+	../mixer_update.c
+
+LOCAL_MODULE := mixer_update_test
+
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/.. \
+	$(call include-path-for, audio-route)
+
+LOCAL_CFLAGS := -Wno-unused-parameter -O2
+
+LOCAL_SHARED_LIBRARIES := liblog
+
+LOCAL_LDLIBS += -lrt
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	platform_info_benchmark.c \
+	../platform_info.c
+
+LOCAL_MODULE := platform_info_benchmark
+
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/.. \
+	$(LOCAL_PATH)/../msm8974 \
+	external/tinyalsa/include \
+	external/tinycompress/include \
+	$(call include-path-for, audio-route) \
+	external/expat/lib
+
+LOCAL_CFLAGS := -Wno-unused-parameter -O2
+
+LOCAL_STATIC_LIBRARIES := libexpat libcutils liblog
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,322 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <audio_route/audio_route.h>
+
+#include "mixer_update.h"
+
+/*
+ * Checks routing transactions against a mock audio_route that keeps the
+ * current and pending value of each control like libaudioroute does and counts
+ * the controls it writes, then times a device switch with and without a
+ * transaction, each control write costing -w microseconds.
+ *
+ * Run it like this:
+ *
+ * make mixer_update_test -j32 && \
+ * out/host/linux-x86/obj/EXECUTABLES/mixer_update_test_intermediates/mixer_update_test \
+ *     -w 200 -n 50
+ */
+
+/* A cut down msm8974 playback mixer: two front ends on SLIMBUS_0_RX, which
+ * both the speaker and the headphones use. */
+enum {
+    CTL_SLIM0_RX_MM1,
+    CTL_SLIM0_RX_MM5,
+    CTL_SLIM_RX1_MUX,
+    CTL_SLIM_RX2_MUX,
+    CTL_SLIM0_RX_CHANNELS,
+    CTL_RX1_MIX1_INP1,
+    CTL_RX2_MIX1_INP1,
+    CTL_CLASS_H_DSM_MUX,
+    CTL_HPHL_DAC_SWITCH,
+    CTL_COMP1_SWITCH,
+    CTL_RX7_MIX1_INP1,
+    CTL_SPK_DRV_VOLUME,
+    CTL_COMP0_SWITCH,
+    CTL_COUNT
+};
+
+struct setting {
+    int ctl;
+    int value;
+};
+
+struct path {
+    const char *name;
+    struct setting settings[8];
+    int num_settings;
+};
+
+static const struct path paths[] = {
+    { "low-latency-playback", { { CTL_SLIM0_RX_MM1, 1 } }, 1 },
+    { "deep-buffer-playback", { { CTL_SLIM0_RX_MM5, 1 } }, 1 },
+    { "speaker", {
+        { CTL_SLIM_RX1_MUX, 1 }, { CTL_SLIM_RX2_MUX, 1 }, { CTL_SLIM0_RX_CHANNELS, 1 },
+        { CTL_RX7_MIX1_INP1, 2 }, { CTL_SPK_DRV_VOLUME, 8 }, { CTL_COMP0_SWITCH, 1 } }, 6 },
+    { "headphones", {
+        { CTL_SLIM_RX1_MUX, 1 }, { CTL_SLIM_RX2_MUX, 1 }, { CTL_SLIM0_RX_CHANNELS, 1 },
+        { CTL_RX1_MIX1_INP1, 1 }, { CTL_RX2_MIX1_INP1, 2 }, { CTL_CLASS_H_DSM_MUX, 1 },
+        { CTL_HPHL_DAC_SWITCH, 1 }, { CTL_COMP1_SWITCH, 1 } }, 8 },
+};
+
+struct audio_route {
+    int mixer[CTL_COUNT];       /* what the hardware holds */
+    int pending[CTL_COUNT];     /* what the paths applied so far ask for */
+    int writes[CTL_COUNT];
+    int total_writes;
+    long write_cost_us;
+};
+
+static const struct path *find_path(const char *name)
+{
+    size_t i;
+    for (i = 0; i < sizeof(paths) / sizeof(paths[0]); i++) {
+        if (strcmp(paths[i].name, name) == 0)
+            return &paths[i];
+    }
+    return NULL;
+}
+
+static void write_ctl(struct audio_route *ar, int ctl)
+{
+    if (ar->mixer[ctl] == ar->pending[ctl])
+        return;
+    ar->mixer[ctl] = ar->pending[ctl];
+    ar->writes[ctl]++;
+    ar->total_writes++;
+    if (ar->write_cost_us > 0) {
+        /* spin rather than sleep, an ALSA control write keeps the caller busy */
+        struct timespec start, now;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        do {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+        } while ((now.tv_sec - start.tv_sec) * 1000000 +
+                 (now.tv_nsec - start.tv_nsec) / 1000 < ar->write_cost_us);
+    }
+}
+
+static int set_path(struct audio_route *ar, const char *name, bool reset, bool update)
+{
+    const struct path *path = find_path(name);
+    int i;
+    if (path == NULL)
+        return -1;
+    for (i = 0; i < path->num_settings; i++)
+        ar->pending[path->settings[i].ctl] = reset ? 0 : path->settings[i].value;
+    if (update) {
+        for (i = 0; i < path->num_settings; i++)
+            write_ctl(ar, path->settings[i].ctl);
+    }
+    return 0;
+}
+
+int audio_route_apply_path(struct audio_route *ar, const char *name)
+{
+    return set_path(ar, name, false, false);
+}
+
+int audio_route_apply_and_update_path(struct audio_route *ar, const char *name)
+{
+    return set_path(ar, name, false, true);
+}
+
+int audio_route_reset_path(struct audio_route *ar, const char *name)
+{
+    return set_path(ar, name, true, false);
+}
+
+int audio_route_reset_and_update_path(struct audio_route *ar, const char *name)
+{
+    return set_path(ar, name, true, true);
+}
+
+int audio_route_update_mixer(struct audio_route *ar)
+{
+    int ctl;
+    for (ctl = 0; ctl < CTL_COUNT; ctl++)
+        write_ctl(ar, ctl);
+    return 0;
+}
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAILED %s:%d: ", __func__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            failures++; \
+        } \
+    } while (0)
+
+static void reset_counts(struct audio_route *ar)
+{
+    memset(ar->writes, 0, sizeof(ar->writes));
+    ar->total_writes = 0;
+}
+
+/* Low latency and deep buffer playing on the speaker. */
+static void start_on_speaker(struct audio_route *ar, struct mixer_update *update)
+{
+    memset(ar, 0, sizeof(*ar));
+    mixer_update_init(update, ar);
+    mixer_update_apply_path(update, "speaker");
+    mixer_update_apply_path(update, "deep-buffer-playback");
+    mixer_update_apply_path(update, "low-latency-playback");
+}
+
+/*
+ * What select_devices() does when the low latency output moves to the
+ * headphones: it takes its own route down, check_and_route_playback_usecases()
+ * moves deep buffer off the shared backend and onto the headphones, and the low
+ * latency route comes back up.
+ */
+static void switch_to_headphones(struct mixer_update *update, bool transaction)
+{
+    if (transaction)
+        mixer_update_begin(update);
+    mixer_update_reset_path(update, "low-latency-playback");
+    mixer_update_reset_path(update, "deep-buffer-playback");
+    mixer_update_reset_path(update, "speaker");
+    mixer_update_apply_path(update, "headphones");
+    mixer_update_apply_path(update, "deep-buffer-playback");
+    mixer_update_apply_path(update, "low-latency-playback");
+    if (transaction)
+        mixer_update_commit(update);
+}
+
+static void test_device_switch(void)
+{
+    struct audio_route immediate, batched;
+    struct mixer_update update;
+    int ctl;
+
+    start_on_speaker(&immediate, &update);
+    reset_counts(&immediate);
+    switch_to_headphones(&update, false);
+
+    start_on_speaker(&batched, &update);
+    reset_counts(&batched);
+    switch_to_headphones(&update, true);
+
+    CHECK(memcmp(immediate.mixer, batched.mixer, sizeof(immediate.mixer)) == 0,
+          "final mixer states differ");
+    for (ctl = 0; ctl < CTL_COUNT; ctl++) {
+        CHECK(batched.writes[ctl] <= 1, "control %d written %d times", ctl, batched.writes[ctl]);
+    }
+    /* the front end routes and the shared backend settle where they were */
+    CHECK(batched.writes[CTL_SLIM0_RX_MM1] == 0 && batched.writes[CTL_SLIM0_RX_MM5] == 0 &&
+          batched.writes[CTL_SLIM_RX1_MUX] == 0 && batched.writes[CTL_SLIM0_RX_CHANNELS] == 0,
+          "unchanged controls written");
+    CHECK(batched.total_writes == 8, "%d writes, expected 8", batched.total_writes);
+    CHECK(immediate.total_writes > batched.total_writes, "%d writes without a transaction",
+          immediate.total_writes);
+    printf("device switch: %d control writes, %d in a transaction\n",
+           immediate.total_writes, batched.total_writes);
+}
+
+static void test_nesting(void)
+{
+    struct audio_route ar;
+    struct mixer_update update;
+
+    memset(&ar, 0, sizeof(ar));
+    mixer_update_init(&update, &ar);
+
+    mixer_update_begin(&update);
+    mixer_update_begin(&update);
+    mixer_update_apply_path(&update, "speaker");
+    mixer_update_commit(&update);
+    CHECK(ar.total_writes == 0, "inner commit wrote %d controls", ar.total_writes);
+
+    mixer_update_flush(&update);
+    CHECK(ar.total_writes == 6, "flush wrote %d controls", ar.total_writes);
+    mixer_update_reset_path(&update, "speaker");
+    mixer_update_apply_path(&update, "speaker");
+    mixer_update_commit(&update);
+    CHECK(ar.total_writes == 6, "commit rewrote unchanged controls");
+
+    /* outside a transaction paths go straight to the mixer */
+    mixer_update_apply_path(&update, "low-latency-playback");
+    CHECK(ar.total_writes == 7, "apply outside a transaction not written");
+
+    /* unbalanced commits are ignored */
+    mixer_update_commit(&update);
+    mixer_update_apply_path(&update, "deep-buffer-playback");
+    CHECK(ar.total_writes == 8, "unbalanced commit left a transaction open");
+}
+
+static long switch_time_us(struct mixer_update *update, struct audio_route *ar, bool transaction,
+                           long write_cost_us, int iterations)
+{
+    struct timespec start, end;
+    long total = 0;
+    int i;
+
+    for (i = 0; i < iterations; i++) {
+        start_on_speaker(ar, update);
+        ar->write_cost_us = write_cost_us;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        switch_to_headphones(update, transaction);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        total += (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000;
+    }
+    return total / iterations;
+}
+
+int main(int argc, char **argv)
+{
+    long write_cost_us = 100;
+    int iterations = 20;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "w:n:")) != -1) {
+        switch (opt) {
+        case 'w':
+            write_cost_us = atol(optarg);
+            break;
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-w write cost in us] [-n switches]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    test_device_switch();
+    test_nesting();
+
+    if (iterations > 0) {
+        struct audio_route ar;
+        struct mixer_update update;
+        printf("speaker to headphones with %ld us per control write: %ld us, %ld us in a "
+               "transaction\n", write_cost_us,
+               switch_time_us(&update, &ar, false, write_cost_us, iterations),
+               switch_time_us(&update, &ar, true, write_cost_us, iterations));
+    }
+
+    printf("%s\n", failures == 0 ? "ALL PASSED" : "SOMETHING FAILED");
+    return failures == 0 ? 0 : 1;
+}
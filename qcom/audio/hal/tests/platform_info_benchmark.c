@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <audio_hw.h>
+#include "platform_api.h"
+
+/*
+ * Times platform_info_load() on a generated audio_platform_info.xml: parsing
+ * it, parsing and writing the cache, and replaying the cache. Checks that the
+ * replay makes the same platform calls as the parse, that editing the XML
+ * makes the cache stale, and that a cache written by a HAL that did not know
+ * some of the names still sets them once the HAL does.
+ *
+ * Run it like this:
+ *
+ * make platform_info_benchmark -j32 && \
+ * out/host/linux-x86/obj/EXECUTABLES/platform_info_benchmark_intermediates/platform_info_benchmark \
+ *     -d 120 -n 200
+ *
+ * -d is the number of devices in the XML (a msm8994 file has about 100) and -n
+ * the loads timed per case.
+ */
+
+/* The platform calls platform_info.c makes, logged instead of applied. */
+static char call_log[1 << 20];
+static size_t call_log_size;
+
+static void log_call(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+static void log_call(const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    if (call_log_size < sizeof(call_log))
+        call_log_size += vsnprintf(call_log + call_log_size,
+                                   sizeof(call_log) - call_log_size, fmt, args);
+    va_end(args);
+}
+
+/* device and usecase names are "dev<N>" and "uc<N>", the HAL knows those below known_limit */
+static int known_limit = 1 << 30;
+
+static int name_index(const char *name, const char *prefix)
+{
+    size_t len = strlen(prefix);
+    int index;
+
+    if (strncmp(name, prefix, len) != 0)
+        return -1;
+    index = atoi(name + len);
+    return index < known_limit ? index : -1;
+}
+
+int platform_get_snd_device_index(char *name)
+{
+    return name_index(name, "dev");
+}
+
+int platform_get_usecase_index(const char *name)
+{
+    return name_index(name, "uc");
+}
+
+int platform_set_snd_device_acdb_id(snd_device_t snd_device, unsigned int acdb_id)
+{
+    log_call("acdb %d %u\n", snd_device, acdb_id);
+    return 0;
+}
+
+int platform_set_usecase_pcm_id(audio_usecase_t usecase, int32_t type, int32_t pcm_id)
+{
+    log_call("pcm %d %d %d\n", usecase, type, pcm_id);
+    return 0;
+}
+
+int platform_set_snd_device_backend(snd_device_t snd_device, const char *backend,
+                                    const char *hw_interface)
+{
+    log_call("backend %d %s %s\n", snd_device, backend, hw_interface ? hw_interface : "-");
+    return 0;
+}
+
+int platform_set_parameters(void *platform, struct str_parms *parms)
+{
+    char *str = str_parms_to_str(parms);
+    log_call("params %s\n", str);
+    free(str);
+    return 0;
+}
+
+static void write_xml(const char *path, int devices, int variant)
+{
+    FILE *f = fopen(path, "w");
+    int i;
+
+    if (f == NULL) {
+        perror(path);
+        exit(1);
+    }
+    fprintf(f, "<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?>\n<audio_platform_info>\n");
+    fprintf(f, "    <acdb_ids>\n");
+    for (i = 0; i < devices; i++)
+        fprintf(f, "        <device name=\"dev%d\" acdb_id=\"%d\"/>\n", i, 100 + i + variant);
+    fprintf(f, "    </acdb_ids>\n    <backend_names>\n");
+    for (i = 0; i < devices / 4; i++) {
+        if (i % 2)
+            fprintf(f, "        <device name=\"dev%d\" backend=\"speaker-and-headphones\" "
+                       "interface=\"SLIMBUS_0_RX-and-SLIMBUS_6_RX\"/>\n", i);
+        else
+            fprintf(f, "        <device name=\"dev%d\" backend=\"bt-sco\"/>\n", i);
+    }
+    fprintf(f, "    </backend_names>\n    <pcm_ids>\n");
+    for (i = 0; i < devices / 4; i++)
+        fprintf(f, "        <usecase name=\"uc%d\" type=\"%s\" id=\"%d\"/>\n",
+                i, i % 2 ? "in" : "out", i);
+    fprintf(f, "    </pcm_ids>\n    <config_params>\n");
+    fprintf(f, "        <param key=\"snd_card_name\" value=\"msm8994-tomtom-mtp-snd-card\"/>\n");
+    fprintf(f, "        <param key=\"operator_info\" value=\"tmus;aa;bb;cc\"/>\n");
+    fprintf(f, "    </config_params>\n</audio_platform_info>\n");
+    fclose(f);
+}
+
+static long load_time_us(const char *xml_path, const char *cache_path, int iterations,
+                         bool keep_cache)
+{
+    struct timespec start, end;
+    long total = 0;
+    int i;
+
+    for (i = 0; i < iterations; i++) {
+        if (!keep_cache)
+            unlink(cache_path);
+        call_log_size = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        platform_info_load(NULL, xml_path, cache_path);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        total += (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000;
+    }
+    return total / iterations;
+}
+
+int main(int argc, char **argv)
+{
+    char dir[] = "/tmp/platform_info_benchmark.XXXXXX";
+    char xml_path[64], cache_path[64];
+    static char parsed_log[sizeof(call_log)];
+    int devices = 120, iterations = 200;
+    bool failed = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:n:")) != -1) {
+        switch (opt) {
+        case 'd':
+            devices = atoi(optarg);
+            break;
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-d devices] [-n loads]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (iterations < 1)
+        iterations = 1;
+
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    snprintf(xml_path, sizeof(xml_path), "%s/audio_platform_info.xml", dir);
+    snprintf(cache_path, sizeof(cache_path), "%s/audio_platform_info.cache", dir);
+    write_xml(xml_path, devices, 0);
+
+    /* what parsing does, then what the cache replays */
+    platform_info_load(NULL, xml_path, NULL);
+    memcpy(parsed_log, call_log, call_log_size);
+    size_t parsed_log_size = call_log_size;
+
+    call_log_size = 0;
+    platform_info_load(NULL, xml_path, cache_path);
+    if (access(cache_path, R_OK) != 0) {
+        printf("cache not written\n");
+        failed = true;
+    }
+    call_log_size = 0;
+    platform_info_load(NULL, xml_path, cache_path);
+    if (call_log_size != parsed_log_size || memcmp(call_log, parsed_log, call_log_size) != 0) {
+        printf("cache replay differs from parse\n");
+        failed = true;
+    }
+
+    printf("%d devices: parse %ld us, parse and write cache %ld us, cache %ld us\n", devices,
+           load_time_us(xml_path, NULL, iterations, true),
+           load_time_us(xml_path, cache_path, iterations, false),
+           load_time_us(xml_path, cache_path, iterations, true));
+
+    /* an edited XML must be parsed again */
+    write_xml(xml_path, devices, 1);
+    call_log_size = 0;
+    platform_info_load(NULL, xml_path, NULL);
+    memcpy(parsed_log, call_log, call_log_size);
+    parsed_log_size = call_log_size;
+    call_log_size = 0;
+    platform_info_load(NULL, xml_path, cache_path);
+    if (call_log_size != parsed_log_size || memcmp(call_log, parsed_log, call_log_size) != 0) {
+        printf("stale cache used\n");
+        failed = true;
+    }
+
+    /* a cache written by a HAL without the upper half of the devices and usecases must
+     * still set them when a HAL that has them replays it */
+    known_limit = devices / 8;
+    unlink(cache_path);
+    platform_info_load(NULL, xml_path, cache_path);
+    known_limit = 1 << 30;
+    call_log_size = 0;
+    platform_info_load(NULL, xml_path, cache_path);
+    if (call_log_size != parsed_log_size || memcmp(call_log, parsed_log, call_log_size) != 0) {
+        printf("cache dropped names the writing HAL did not know\n");
+        failed = true;
+    }
+
+    unlink(xml_path);
+    unlink(cache_path);
+    rmdir(dir);
+
+    printf("%s\n", failed ? "SOMETHING FAILED" : "ALL PASSED");
+    return failed ? 1 : 0;
+}
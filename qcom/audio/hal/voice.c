@@ -82,6 +82,8 @@ int voice_stop_usecase(struct audio_device *adev, audio_usecase_t usecase_id)
         return -EINVAL;
     }
 
+    mixer_update_begin(&adev->mixer_update);
+
     /* 2. Get and set stream specific mixer controls */
     disable_audio_route(adev, uc_info);
 
@@ -89,6 +91,8 @@ int voice_stop_usecase(struct audio_device *adev, audio_usecase_t usecase_id)
     disable_snd_device(adev, uc_info->out_snd_device);
     disable_snd_device(adev, uc_info->in_snd_device);
 
+    mixer_update_commit(&adev->mixer_update);
+
     list_remove(&uc_info->list);
     free(uc_info);
 
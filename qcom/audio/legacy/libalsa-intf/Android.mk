@@ -29,6 +29,7 @@ include $(BUILD_EXECUTABLE)
 include $(CLEAR_VARS)
 LOCAL_SRC_FILES:= alsaucm_test.c
 LOCAL_MODULE:= alsaucm_test
+LOCAL_CFLAGS := -DCOMPILED_CONFIG_DIR=\"/data/misc/audio/\"
 LOCAL_SHARED_LIBRARIES:= libc libcutils libalsa-intf
 LOCAL_MODULE_TAGS:= debug
 include $(BUILD_EXECUTABLE)
@@ -43,6 +44,7 @@ LOCAL_MODULE:= libalsa-intf
 LOCAL_MODULE_TAGS := optional
 LOCAL_SHARED_LIBRARIES:= libc libcutils #libutils #libmedia libhardware_legacy
 LOCAL_CFLAGS := -DQC_PROP -DCONFIG_DIR=\"/system/etc/snd_soc_msm/\"
+LOCAL_CFLAGS += -DCOMPILED_CONFIG_DIR=\"/data/misc/audio/\"
 
 LOCAL_SHARED_LIBRARIES += libdl
 include $(BUILD_SHARED_LIBRARY)
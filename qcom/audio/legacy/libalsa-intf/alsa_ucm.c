@@ -58,6 +58,7 @@
 #include <sys/time.h>
 #include <sys/poll.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <dlfcn.h>
 
 #include <linux/ioctl.h>
@@ -699,24 +700,139 @@ int use_case_index)
     return ret;
 }
 
+/* FNV-1a hash of a verb, device, modifier or mixer control name */
+static uint32_t snd_ucm_hash(const char *name)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*name)
+        hash = (hash ^ (unsigned char)*name++) * 16777619u;
+    return hash;
+}
+
+static const char *snd_ucm_ctrl_name(const void *list, int index)
+{
+    return ((const card_mctrl_t *)list)[index].case_name;
+}
+
+static const char *snd_ucm_str_name(const void *list, int index)
+{
+    return ((char * const *)list)[index];
+}
+
+/* Find a name in the index built over a list
+ * name_at - returns the name of a list entry
+ * Returns the list index, -EINVAL if not found or -ENOENT if the list
+ * has no index yet
+ */
+static int snd_ucm_index_find(const snd_ucm_name_index_t *index,
+const void *list, const char *(*name_at)(const void *, int), const char *name)
+{
+    uint32_t slot;
+    int entry;
+
+    if (index == NULL || index->size == 0)
+        return -ENOENT;
+    slot = snd_ucm_hash(name) & (index->size - 1);
+    while ((entry = index->slots[slot]) != 0) {
+        if (!strcmp(name_at(list, entry - 1), name))
+            return entry - 1;
+        slot = (slot + 1) & (index->size - 1);
+    }
+    return -EINVAL;
+}
+
+/* Build an index over the first count entries of a list. Of duplicate
+ * names the first is kept, as a scan of the list would find it.
+ * Returns 0 on sucess, negative error code otherwise
+ */
+static int snd_ucm_index_build(snd_ucm_name_index_t *index,
+const void *list, const char *(*name_at)(const void *, int), int count)
+{
+    const char *name;
+    uint32_t slot;
+    int size = 8, i;
+
+    while (size < 2 * count)
+        size <<= 1;
+    index->slots = (int *)calloc(size, sizeof(int));
+    if (index->slots == NULL) {
+        index->size = 0;
+        return -ENOMEM;
+    }
+    index->size = size;
+    for (i = 0; i < count; i++) {
+        if ((name = name_at(list, i)) == NULL)
+            continue;
+        slot = snd_ucm_hash(name) & (size - 1);
+        while (index->slots[slot] != 0 &&
+               strcmp(name_at(list, index->slots[slot] - 1), name))
+            slot = (slot + 1) & (size - 1);
+        if (index->slots[slot] == 0)
+            index->slots[slot] = i + 1;
+    }
+    return 0;
+}
+
+/* Returns the index of a verb in the verb list, -EINVAL if not found */
+static int snd_ucm_get_verb_index(card_ctxt_t *card_ctxt, const char *verb)
+{
+    int index;
+
+    index = snd_ucm_index_find(&card_ctxt->verb_list_index,
+                card_ctxt->verb_list, snd_ucm_str_name, verb);
+    if (index != -ENOENT)
+        return index;
+    for (index = 0; strncmp(card_ctxt->verb_list[index], SND_UCM_END_OF_LIST,
+         strlen(SND_UCM_END_OF_LIST)); index++) {
+        if (!strcmp(card_ctxt->verb_list[index], verb))
+            return index;
+    }
+    return -EINVAL;
+}
+
+/* Returns the index of a modifier valid for a verb, -EINVAL if not found.
+ * The modifier list names the modifier sections in order, so the index of
+ * the section is the index in the list.
+ */
+static int snd_ucm_get_modifier_index(use_case_verb_t *verb,
+const char *modifier)
+{
+    int index;
+
+    index = snd_ucm_index_find(&verb->mod_ctrls_index, verb->mod_ctrls,
+                snd_ucm_ctrl_name, modifier);
+    if (index != -ENOENT)
+        return index;
+    for (index = 0; strncmp(verb->modifier_list[index], SND_UCM_END_OF_LIST,
+         strlen(SND_UCM_END_OF_LIST)); index++) {
+        if (!strcmp(verb->modifier_list[index], modifier))
+            return index;
+    }
+    return -EINVAL;
+}
+
 int get_use_case_index(snd_use_case_mgr_t *uc_mgr, const char *use_case,
 int ctrl_list_type)
 {
     use_case_verb_t *verb_list;
     card_mctrl_t *ctrl_list;
+    snd_ucm_name_index_t *ctrl_index = NULL;
     int ret = 0, index = 0, verb_index;
 
     verb_list = uc_mgr->card_ctxt_ptr->use_case_verb_list;
     verb_index = uc_mgr->card_ctxt_ptr->current_verb_index;
-    if (ctrl_list_type == CTRL_LIST_VERB) {
-        ctrl_list =
-            uc_mgr->card_ctxt_ptr->use_case_verb_list[verb_index].verb_ctrls;
+    if (verb_index < 0) {
+        ctrl_list = NULL;
+    } else if (ctrl_list_type == CTRL_LIST_VERB) {
+        ctrl_list = verb_list[verb_index].verb_ctrls;
+        ctrl_index = &verb_list[verb_index].verb_ctrls_index;
     } else if (ctrl_list_type == CTRL_LIST_DEVICE) {
-        ctrl_list =
-            uc_mgr->card_ctxt_ptr->use_case_verb_list[verb_index].device_ctrls;
+        ctrl_list = verb_list[verb_index].device_ctrls;
+        ctrl_index = &verb_list[verb_index].device_ctrls_index;
     } else if (ctrl_list_type == CTRL_LIST_MODIFIER) {
-        ctrl_list =
-            uc_mgr->card_ctxt_ptr->use_case_verb_list[verb_index].mod_ctrls;
+        ctrl_list = verb_list[verb_index].mod_ctrls;
+        ctrl_index = &verb_list[verb_index].mod_ctrls_index;
     } else {
         ctrl_list = NULL;
     }
@@ -727,6 +843,12 @@ int ctrl_list_type)
                 uc_mgr->card_ctxt_ptr->current_verb, verb_index);
         return -EINVAL;
     }
+    /* Lists get an index once parsing completes, scan them until then */
+    ret = snd_ucm_index_find(ctrl_index, ctrl_list, snd_ucm_ctrl_name,
+              use_case);
+    if (ret != -ENOENT)
+        return ret;
+    ret = 0;
     while(strncmp(ctrl_list[index].case_name, use_case, (strlen(use_case)+1))) {
         if (!strncmp(ctrl_list[index].case_name, SND_UCM_END_OF_LIST,
             strlen(SND_UCM_END_OF_LIST))) {
@@ -747,6 +869,25 @@ int ctrl_list_type)
     }
 }
 
+/* Look up a mixer control, remembering the result by interned name so
+ * that each control is only searched for once per card
+ * Returns the control or NULL if the card has no such control
+ */
+static struct mixer_ctl *snd_ucm_get_mixer_ctl(card_ctxt_t *card_ctxt,
+mixer_control_t *mixer)
+{
+    int id = mixer->ctl_id;
+
+    if (id < 0 || id >= card_ctxt->mixer_ctl_count ||
+        card_ctxt->mixer_ctls == NULL)
+        return mixer_get_control(card_ctxt->mixer_handle,
+                   mixer->control_name, 0);
+    if (card_ctxt->mixer_ctls[id] == NULL)
+        card_ctxt->mixer_ctls[id] = mixer_get_control(card_ctxt->mixer_handle,
+                                        mixer->control_name, 0);
+    return card_ctxt->mixer_ctls[id];
+}
+
 /* Apply the required mixer controls for specific use case
  * uc_mgr - UCM structure pointer
  * use_case - use case name
@@ -822,8 +963,8 @@ const char *use_case, int enable, int ctrl_list_type, int uc_index)
                     ALOGE("No valid controls exist for this case: %s", use_case);
                     break;
                 }
-                ctl = mixer_get_control(uc_mgr->card_ctxt_ptr->mixer_handle,
-                          mixer_list[index].control_name, 0);
+                ctl = snd_ucm_get_mixer_ctl(uc_mgr->card_ctxt_ptr,
+                          &mixer_list[index]);
                 if (ctl) {
                     if (mixer_list[index].type == TYPE_INT) {
                         ALOGV("Setting mixer control: %s, value: %d",
@@ -850,9 +991,8 @@ const char *use_case, int enable, int ctrl_list_type, int uc_index)
                        mixer_list = ctrl_list[uc_index].dis_mixer_list;
                        mixer_count = ctrl_list[uc_index].dis_mixer_count;
                        for(i = 0; i < mixer_count; i++) {
-                           ctl = mixer_get_control(
-                                     uc_mgr->card_ctxt_ptr->mixer_handle,
-                                     mixer_list[i].control_name, 0);
+                           ctl = snd_ucm_get_mixer_ctl(
+                                     uc_mgr->card_ctxt_ptr, &mixer_list[i]);
                            if (ctl) {
                                if (mixer_list[i].type == TYPE_INT) {
                                    ret = mixer_ctl_set(ctl,
@@ -874,78 +1014,80 @@ const char *use_case, int enable, int ctrl_list_type, int uc_index)
     return ret;
 }
 
+/* Capability of the known verbs and modifiers, anything else is voice */
+static const struct use_case_type {
+    const char *name;
+    int type;
+} use_case_types[] = {
+    { SND_USE_CASE_VERB_HIFI, CAP_RX },
+    { SND_USE_CASE_VERB_HIFI_LOWLATENCY_MUSIC, CAP_RX },
+    { SND_USE_CASE_VERB_HIFI_LOW_POWER, CAP_RX },
+    { SND_USE_CASE_VERB_HIFI_TUNNEL, CAP_RX },
+    { SND_USE_CASE_VERB_HIFI2, CAP_RX },
+    { SND_USE_CASE_VERB_DIGITAL_RADIO, CAP_RX },
+    { SND_USE_CASE_MOD_PLAY_MUSIC, CAP_RX },
+    { SND_USE_CASE_MOD_PLAY_LOWLATENCY_MUSIC, CAP_RX },
+    { SND_USE_CASE_MOD_PLAY_MUSIC2, CAP_RX },
+    { SND_USE_CASE_MOD_PLAY_LPA, CAP_RX },
+    { SND_USE_CASE_MOD_PLAY_TUNNEL, CAP_RX },
+    { SND_USE_CASE_MOD_PLAY_FM, CAP_RX },
+    { SND_USE_CASE_VERB_HIFI_REC, CAP_TX },
+    { SND_USE_CASE_VERB_FM_REC, CAP_TX },
+    { SND_USE_CASE_VERB_FM_A2DP_REC, CAP_TX },
+    { SND_USE_CASE_MOD_CAPTURE_MUSIC, CAP_TX },
+    { SND_USE_CASE_VERB_HIFI_LOWLATENCY_REC, CAP_TX },
+    { SND_USE_CASE_MOD_CAPTURE_LOWLATENCY_MUSIC, CAP_TX },
+    { SND_USE_CASE_MOD_CAPTURE_FM, CAP_TX },
+    { SND_USE_CASE_MOD_CAPTURE_A2DP_FM, CAP_TX },
+    { SND_USE_CASE_VERB_VOICECALL, CAP_VOICE },
+    { SND_USE_CASE_VERB_IP_VOICECALL, CAP_VOICE },
+    { SND_USE_CASE_VERB_DL_REC, CAP_VOICE },
+    { SND_USE_CASE_VERB_UL_DL_REC, CAP_VOICE },
+    { SND_USE_CASE_VERB_INCALL_REC, CAP_VOICE },
+    { SND_USE_CASE_MOD_PLAY_VOICE, CAP_VOICE },
+    { SND_USE_CASE_MOD_PLAY_VOIP, CAP_VOICE },
+    { SND_USE_CASE_MOD_CAPTURE_VOICE_DL, CAP_VOICE },
+    { SND_USE_CASE_MOD_CAPTURE_VOICE_UL_DL, CAP_VOICE },
+    { SND_USE_CASE_VERB_VOLTE, CAP_VOICE },
+    { SND_USE_CASE_MOD_PLAY_VOLTE, CAP_VOICE },
+};
+
+static snd_ucm_name_index_t use_case_types_index;
+static pthread_once_t use_case_types_once = PTHREAD_ONCE_INIT;
+
+static const char *use_case_type_name(const void *list, int index)
+{
+    return ((const struct use_case_type *)list)[index].name;
+}
+
+static void build_use_case_types_index(void)
+{
+    snd_ucm_index_build(&use_case_types_index, use_case_types,
+        use_case_type_name,
+        sizeof(use_case_types)/sizeof(use_case_types[0]));
+}
+
 int getUseCaseType(const char *useCase)
 {
+    unsigned int index;
+    int ret;
+
     ALOGV("getUseCaseType: use case is %s\n", useCase);
-    if (!strncmp(useCase, SND_USE_CASE_VERB_HIFI,
-           MAX_LEN(useCase,SND_USE_CASE_VERB_HIFI)) ||
-        !strncmp(useCase, SND_USE_CASE_VERB_HIFI_LOWLATENCY_MUSIC,
-           MAX_LEN(useCase,SND_USE_CASE_VERB_HIFI_LOWLATENCY_MUSIC)) ||
-        !strncmp(useCase, SND_USE_CASE_VERB_HIFI_LOW_POWER,
-           MAX_LEN(useCase,SND_USE_CASE_VERB_HIFI_LOW_POWER)) ||
-        !strncmp(useCase, SND_USE_CASE_VERB_HIFI_TUNNEL,
-            MAX_LEN(useCase,SND_USE_CASE_VERB_HIFI_TUNNEL)) ||
-        !strncmp(useCase, SND_USE_CASE_VERB_HIFI2,
-            MAX_LEN(useCase,SND_USE_CASE_VERB_HIFI2)) ||
-        !strncmp(useCase, SND_USE_CASE_VERB_DIGITAL_RADIO,
-            MAX_LEN(useCase,SND_USE_CASE_VERB_DIGITAL_RADIO)) ||
-        !strncmp(useCase, SND_USE_CASE_MOD_PLAY_MUSIC,
-            MAX_LEN(useCase,SND_USE_CASE_MOD_PLAY_MUSIC)) ||
-        !strncmp(useCase, SND_USE_CASE_MOD_PLAY_LOWLATENCY_MUSIC,
-            MAX_LEN(useCase,SND_USE_CASE_MOD_PLAY_LOWLATENCY_MUSIC)) ||
-        !strncmp(useCase, SND_USE_CASE_MOD_PLAY_MUSIC2,
-            MAX_LEN(useCase,SND_USE_CASE_MOD_PLAY_MUSIC2)) ||
-        !strncmp(useCase, SND_USE_CASE_MOD_PLAY_LPA,
-            MAX_LEN(useCase,SND_USE_CASE_MOD_PLAY_LPA)) ||
-        !strncmp(useCase, SND_USE_CASE_MOD_PLAY_TUNNEL,
-            MAX_LEN(useCase,SND_USE_CASE_MOD_PLAY_TUNNEL)) ||
-        !strncmp(useCase, SND_USE_CASE_MOD_PLAY_FM,
-            MAX_LEN(useCase,SND_USE_CASE_MOD_PLAY_FM))) {
-        return CAP_RX;
-    } else if (!strncmp(useCase, SND_USE_CASE_VERB_HIFI_REC,
-            MAX_LEN(useCase,SND_USE_CASE_VERB_HIFI_REC)) ||
-        !strncmp(useCase, SND_USE_CASE_VERB_FM_REC,
-            MAX_LEN(useCase,SND_USE_CASE_VERB_FM_REC)) ||
-        !strncmp(useCase, SND_USE_CASE_VERB_FM_A2DP_REC,
-            MAX_LEN(useCase,SND_USE_CASE_VERB_FM_A2DP_REC)) ||
-        !strncmp(useCase, SND_USE_CASE_MOD_CAPTURE_MUSIC,
-            MAX_LEN(useCase,SND_USE_CASE_MOD_CAPTURE_MUSIC)) ||
-        !strncmp(useCase, SND_USE_CASE_VERB_HIFI_LOWLATENCY_REC,
-            MAX_LEN(useCase,SND_USE_CASE_VERB_HIFI_LOWLATENCY_REC)) ||
-        !strncmp(useCase, SND_USE_CASE_MOD_CAPTURE_LOWLATENCY_MUSIC,
-            MAX_LEN(useCase,SND_USE_CASE_MOD_CAPTURE_LOWLATENCY_MUSIC)) ||
-        !strncmp(useCase, SND_USE_CASE_MOD_CAPTURE_FM,
-            MAX_LEN(useCase,SND_USE_CASE_MOD_CAPTURE_FM)) ||
-        !strncmp(useCase, SND_USE_CASE_MOD_CAPTURE_A2DP_FM,
-            MAX_LEN(useCase,SND_USE_CASE_MOD_CAPTURE_A2DP_FM))) {
-        return CAP_TX;
-    } else if (!strncmp(useCase, SND_USE_CASE_VERB_VOICECALL,
-            MAX_LEN(useCase,SND_USE_CASE_VERB_VOICECALL)) ||
-        !strncmp(useCase, SND_USE_CASE_VERB_IP_VOICECALL,
-            MAX_LEN(useCase,SND_USE_CASE_VERB_IP_VOICECALL)) ||
-        !strncmp(useCase, SND_USE_CASE_VERB_DL_REC,
-            MAX_LEN(useCase,SND_USE_CASE_VERB_DL_REC)) ||
-        !strncmp(useCase, SND_USE_CASE_VERB_UL_DL_REC,
-            MAX_LEN(useCase,SND_USE_CASE_VERB_UL_DL_REC)) ||
-        !strncmp(useCase, SND_USE_CASE_VERB_INCALL_REC,
-            MAX_LEN(useCase,SND_USE_CASE_VERB_INCALL_REC)) ||
-        !strncmp(useCase, SND_USE_CASE_MOD_PLAY_VOICE,
-            MAX_LEN(useCase,SND_USE_CASE_MOD_PLAY_VOICE)) ||
-        !strncmp(useCase, SND_USE_CASE_MOD_PLAY_VOIP,
-            MAX_LEN(useCase,SND_USE_CASE_MOD_PLAY_VOIP)) ||
-        !strncmp(useCase, SND_USE_CASE_MOD_CAPTURE_VOICE_DL,
-            MAX_LEN(useCase,SND_USE_CASE_MOD_CAPTURE_VOICE_DL)) ||
-        !strncmp(useCase, SND_USE_CASE_MOD_CAPTURE_VOICE_UL_DL,
-            MAX_LEN(useCase,SND_USE_CASE_MOD_CAPTURE_VOICE_UL_DL)) ||
-        !strncmp(useCase, SND_USE_CASE_VERB_VOLTE,
-            MAX_LEN(useCase,SND_USE_CASE_VERB_VOLTE)) ||
-        !strncmp(useCase, SND_USE_CASE_MOD_PLAY_VOLTE,
-            MAX_LEN(useCase, SND_USE_CASE_MOD_PLAY_VOLTE))) {
-        return CAP_VOICE;
-    } else {
-        ALOGE("unknown use case %s, returning voice capablity", useCase);
-        return CAP_VOICE;
+    pthread_once(&use_case_types_once, build_use_case_types_index);
+    ret = snd_ucm_index_find(&use_case_types_index, use_case_types,
+              use_case_type_name, useCase);
+    if (ret >= 0)
+        return use_case_types[ret].type;
+    if (ret == -ENOENT) {
+        for (index = 0;
+             index < sizeof(use_case_types)/sizeof(use_case_types[0]);
+             index++) {
+            if (!strcmp(use_case_types[index].name, useCase))
+                return use_case_types[index].type;
+        }
     }
+    ALOGE("unknown use case %s, returning voice capablity", useCase);
+    return CAP_VOICE;
 }
 
 /* Set/Reset mixer controls of specific use case for all current devices
@@ -1281,18 +1423,7 @@ const char *device, int enable)
  */
 static int get_usecase_type(snd_use_case_mgr_t *uc_mgr, const char *usecase)
 {
-    int ret = -EINVAL, index = 0;
-
-    while (strncmp(uc_mgr->card_ctxt_ptr->verb_list[index],
-        SND_UCM_END_OF_LIST, strlen(SND_UCM_END_OF_LIST))) {
-        if (!strncmp(uc_mgr->card_ctxt_ptr->verb_list[index], usecase,
-            (strlen(usecase)+1))) {
-            ret = 0;
-            break;
-        }
-        index++;
-    }
-    if (ret == 0)
+    if (snd_ucm_get_verb_index(uc_mgr->card_ctxt_ptr, usecase) >= 0)
         return CTRL_LIST_VERB;
     else
         return CTRL_LIST_MODIFIER;
@@ -1456,21 +1587,14 @@ int snd_use_case_set(snd_use_case_mgr_t *uc_mgr,
 
     if (!strncmp(identifier, "_verb", 5)) {
         /* Check if value is valid verb */
-        while (strncmp(uc_mgr->card_ctxt_ptr->verb_list[index],
-               SND_UCM_END_OF_LIST, strlen(SND_UCM_END_OF_LIST))) {
-            if (!strncmp(uc_mgr->card_ctxt_ptr->verb_list[index], value,
-                (strlen(value)+1))) {
-                ret = 0;
-                break;
-            }
-            index++;
-        }
+        if ((index = snd_ucm_get_verb_index(uc_mgr->card_ctxt_ptr,
+            value)) >= 0)
+            ret = 0;
         if ((ret < 0) && (strncmp(value, SND_USE_CASE_VERB_INACTIVE,
             strlen(SND_USE_CASE_VERB_INACTIVE)))) {
             ALOGE("Invalid verb identifier value");
         } else {
-            ALOGV("Index:%d Verb:%s", index,
-                uc_mgr->card_ctxt_ptr->verb_list[index]);
+            ALOGV("Index:%d Verb:%s", index, value);
             /* Disable the mixer controls for current use case
              * for all the enabled devices */
             if (strncmp(uc_mgr->card_ctxt_ptr->current_verb,
@@ -1554,15 +1678,9 @@ int snd_use_case_set(snd_use_case_mgr_t *uc_mgr,
             ALOGV("Index:%d Verb:%s", verb_index,
                  uc_mgr->card_ctxt_ptr->verb_list[verb_index]);
             verb_list = uc_mgr->card_ctxt_ptr->use_case_verb_list;
-            while(strncmp(verb_list[verb_index].modifier_list[index], value,
-                  (strlen(value)+1))) {
-                if (!strncmp(verb_list[verb_index].modifier_list[index],
-                    SND_UCM_END_OF_LIST, strlen(SND_UCM_END_OF_LIST))){
-                    ret = -EINVAL;
-                    break;
-                }
-                index++;
-            }
+            if ((index = snd_ucm_get_modifier_index(&verb_list[verb_index],
+                value)) < 0)
+                ret = index;
             if (ret < 0) {
                 ALOGE("Invalid modifier identifier value");
             } else {
@@ -1681,21 +1799,14 @@ int snd_use_case_set_case(snd_use_case_mgr_t *uc_mgr,
 
     if (!strncmp(identifier, "_verb", 5)) {
         /* Check if value is valid verb */
-        while (strncmp(uc_mgr->card_ctxt_ptr->verb_list[index],
-               SND_UCM_END_OF_LIST, MAX_STR_LEN)) {
-            if (!strncmp(uc_mgr->card_ctxt_ptr->verb_list[index],
-                value, MAX_STR_LEN)) {
-                ret = 0;
-                break;
-            }
-            index++;
-        }
+        if ((index = snd_ucm_get_verb_index(uc_mgr->card_ctxt_ptr,
+            value)) >= 0)
+            ret = 0;
         if ((ret < 0) && (strncmp(value, SND_USE_CASE_VERB_INACTIVE,
             MAX_STR_LEN))) {
             ALOGE("Invalid verb identifier value");
         } else {
-            ALOGV("Index:%d Verb:%s", index,
-                 uc_mgr->card_ctxt_ptr->verb_list[index]);
+            ALOGV("Index:%d Verb:%s", index, value);
             /* Disable the mixer controls for current use case
              * for specified device */
             if (strncmp(uc_mgr->card_ctxt_ptr->current_verb,
@@ -1795,15 +1906,9 @@ int snd_use_case_set_case(snd_use_case_mgr_t *uc_mgr,
             ret = -EINVAL;
         } else {
             ret = 0;
-            while(strncmp(uc_mgr->card_ctxt_ptr->verb_list[index],
-                  uc_mgr->card_ctxt_ptr->current_verb, MAX_STR_LEN)) {
-                if (!strncmp(uc_mgr->card_ctxt_ptr->verb_list[index],
-                    SND_UCM_END_OF_LIST, MAX_STR_LEN)){
-                    ret = -EINVAL;
-                    break;
-                }
-                index++;
-            }
+            if ((index = snd_ucm_get_verb_index(uc_mgr->card_ctxt_ptr,
+                uc_mgr->card_ctxt_ptr->current_verb)) < 0)
+                ret = index;
         }
         if (ret < 0) {
             ALOGE("Invalid verb identifier value");
@@ -1812,15 +1917,9 @@ int snd_use_case_set_case(snd_use_case_mgr_t *uc_mgr,
             verb_list = uc_mgr->card_ctxt_ptr->use_case_verb_list;
             ALOGV("Index:%d Verb:%s", verb_index,
                  uc_mgr->card_ctxt_ptr->verb_list[verb_index]);
-            while(strncmp(verb_list[verb_index].modifier_list[index],
-                value, MAX_STR_LEN)) {
-                if (!strncmp(verb_list[verb_index].modifier_list[index],
-                    SND_UCM_END_OF_LIST, MAX_STR_LEN)){
-                    ret = -EINVAL;
-                    break;
-                }
-                index++;
-            }
+            if ((index = snd_ucm_get_modifier_index(&verb_list[verb_index],
+                value)) < 0)
+                ret = index;
             if (ret < 0) {
                 ALOGE("Invalid modifier identifier value");
             } else {
@@ -1960,8 +2059,11 @@ int snd_use_case_mgr_open(snd_use_case_mgr_t **uc_mgr, const char *card_name)
          * previously for the same card */
     snd_use_case_mgr_reset(uc_mgr_ptr);
         uc_mgr_ptr->card_ctxt_ptr->current_verb_index = -1;
-        /* Parse config files and update mixer controls */
-        ret = snd_ucm_parse(&uc_mgr_ptr);
+        /* Map the compiled config if it is up to date, otherwise parse
+         * config files and update mixer controls */
+        ret = snd_ucm_load_compiled(&uc_mgr_ptr);
+        if (ret < 0)
+            ret = snd_ucm_parse(&uc_mgr_ptr);
         if(ret < 0) {
             ALOGE("Failed to parse config files: %d", ret);
             snd_ucm_free_mixer_list(&uc_mgr_ptr);
@@ -2252,8 +2354,17 @@ void *second_stage_parsing_thread(void *uc_mgr_ptr)
         /* Prints use cases and mixer controls parsed from config files */
         snd_ucm_print((*uc_mgr));
 #endif
-    if(ret < 0)
+    if(ret < 0) {
         ALOGE("Failed to parse config files: %d", ret);
+    } else {
+        /* All verbs are in, index them and compile the config so that
+         * the next open maps it instead of parsing */
+        pthread_mutex_lock(&(*uc_mgr)->card_ctxt_ptr->card_lock);
+        ret = snd_ucm_build_index((*uc_mgr)->card_ctxt_ptr);
+        pthread_mutex_unlock(&(*uc_mgr)->card_ctxt_ptr->card_lock);
+        if (ret == 0)
+            snd_ucm_write_compiled((*uc_mgr)->card_ctxt_ptr);
+    }
     ALOGE("Exiting parsing thread uc_mgr %p\n", uc_mgr);
     return NULL;
 }
@@ -2266,7 +2377,11 @@ int snd_use_case_mgr_wait_for_parsing(snd_use_case_mgr_t *uc_mgr)
 {
     int ret;
 
+    /* No thread when the config is single file or compiled */
+    if (!uc_mgr->thr_created)
+        return 0;
     ret = pthread_join(uc_mgr->thr, NULL);
+    uc_mgr->thr_created = false;
     return ret;
 }
 
@@ -2304,10 +2419,11 @@ static int snd_ucm_parse(snd_use_case_mgr_t **uc_mgr)
         close(fd);
         return -EINVAL;
     }
+    snd_ucm_add_source((*uc_mgr)->card_ctxt_ptr, path);
     current_str = read_buf;
     verb_count = get_verb_count(current_str);
     (*uc_mgr)->card_ctxt_ptr->use_case_verb_list =
-        (use_case_verb_t *)malloc((verb_count+1)*(sizeof(use_case_verb_t)));
+        (use_case_verb_t *)calloc((verb_count+1), sizeof(use_case_verb_t));
     if ((*uc_mgr)->card_ctxt_ptr->use_case_verb_list == NULL) {
         ALOGE("failed to allocate memory for use case verb list\n");
         munmap(read_buf, st.st_size);
@@ -2315,7 +2431,7 @@ static int snd_ucm_parse(snd_use_case_mgr_t **uc_mgr)
         return -ENOMEM;
     }
     if (((*uc_mgr)->card_ctxt_ptr->verb_list =
-        (char **)malloc((verb_count+2)*(sizeof(char *)))) == NULL) {
+        (char **)calloc((verb_count+2), sizeof(char *))) == NULL) {
         ALOGE("failed to allocate memory for verb list\n");
         munmap(read_buf, st.st_size);
         close(fd);
@@ -2327,6 +2443,8 @@ static int snd_ucm_parse(snd_use_case_mgr_t **uc_mgr)
         ret = parse_single_config_format(uc_mgr, current_str, verb_count);
         munmap(read_buf, st.st_size);
         close(fd);
+        if (ret == 0 && snd_ucm_build_index((*uc_mgr)->card_ctxt_ptr) == 0)
+            snd_ucm_write_compiled((*uc_mgr)->card_ctxt_ptr);
         return ret;
     }
     while (*current_str != (char)EOF)  {
@@ -2427,9 +2545,10 @@ static int snd_ucm_parse(snd_use_case_mgr_t **uc_mgr)
         ALOGD("Creating Parsing thread uc_mgr %p\n", uc_mgr);
         rc = pthread_create(&(*uc_mgr)->thr, 0, second_stage_parsing_thread,
                  (void*)(*uc_mgr));
-        if(rc < 0) {
+        if(rc != 0) {
             ALOGE("Failed to create parsing thread rc %d errno %d\n", rc, errno);
         } else {
+            (*uc_mgr)->thr_created = true;
             ALOGV("Prasing thread created successfully\n");
         }
     }
@@ -2899,6 +3018,8 @@ const char *file_name, int index)
              ALOGE("failed to open config file %s error %d\n", path, errno);
              return -EINVAL;
         }
+        if (parse_count == 0)
+            snd_ucm_add_source((*uc_mgr)->card_ctxt_ptr, path);
         if (fstat(fd, &st) < 0) {
             ALOGE("failed to stat %s error %d\n", path, errno);
             close(fd);
@@ -3491,6 +3612,7 @@ int size)
         if (p == NULL)
             break;
         list = ((*mixer_list)+size);
+        list->ctl_id = -1;
         list->control_name = (char *)malloc((strlen(p)+1)*sizeof(char));
         if(list->control_name == NULL) {
             ret = -ENOMEM;
@@ -3649,6 +3771,18 @@ void snd_ucm_free_mixer_list(snd_use_case_mgr_t **uc_mgr)
     int index = 0, verb_index = 0;
 
     pthread_mutex_lock(&(*uc_mgr)->card_ctxt_ptr->card_lock);
+    snd_ucm_free_index((*uc_mgr)->card_ctxt_ptr);
+    if ((*uc_mgr)->card_ctxt_ptr->compiled_buf) {
+        /* Everything lives in the mapping of the compiled config */
+        munmap((*uc_mgr)->card_ctxt_ptr->compiled_buf,
+            (*uc_mgr)->card_ctxt_ptr->compiled_size);
+        (*uc_mgr)->card_ctxt_ptr->compiled_buf = NULL;
+        (*uc_mgr)->card_ctxt_ptr->compiled_size = 0;
+        (*uc_mgr)->card_ctxt_ptr->use_case_verb_list = NULL;
+        (*uc_mgr)->card_ctxt_ptr->verb_list = NULL;
+        pthread_mutex_unlock(&(*uc_mgr)->card_ctxt_ptr->card_lock);
+        return;
+    }
     verb_list = (*uc_mgr)->card_ctxt_ptr->use_case_verb_list;
     while(strncmp((*uc_mgr)->card_ctxt_ptr->verb_list[verb_index],
           SND_UCM_END_OF_LIST, 3)) {
@@ -3915,3 +4049,873 @@ const char *value)
     }
     return ret;
 }
+
+/* Add a config file to the files the parsed config came from
+ * card_ctxt - card context
+ * path - config file path
+ * Returns 0 on sucess, negative error code otherwise
+ */
+static int snd_ucm_add_source(card_ctxt_t *card_ctxt, const char *path)
+{
+    char **source_files;
+    int index;
+
+    /* A file missed out would let a stale compiled config be used */
+    if (card_ctxt->source_count < 0)
+        return -ENOMEM;
+    source_files = (char **)realloc(card_ctxt->source_files,
+                       (card_ctxt->source_count+1)*sizeof(char *));
+    if (source_files == NULL ||
+        (source_files[card_ctxt->source_count] = strdup(path)) == NULL) {
+        ALOGE("Failed to allocate memory for config file %s", path);
+        if (source_files == NULL)
+            source_files = card_ctxt->source_files;
+        for (index = 0; index < card_ctxt->source_count; index++)
+            free(source_files[index]);
+        free(source_files);
+        card_ctxt->source_files = NULL;
+        card_ctxt->source_count = -1;
+        return -ENOMEM;
+    }
+    card_ctxt->source_files = source_files;
+    card_ctxt->source_count++;
+    return 0;
+}
+
+/* Visit every mixer control of every verb, device and modifier */
+static void snd_ucm_for_each_mixer(card_ctxt_t *card_ctxt, int verb_count,
+void (*fn)(mixer_control_t *, void *), void *arg)
+{
+    use_case_verb_t *verb;
+    card_mctrl_t *lists[3];
+    int counts[3], verb_index, list, index, mindex;
+
+    for (verb_index = 0; verb_index < verb_count; verb_index++) {
+        verb = &card_ctxt->use_case_verb_list[verb_index];
+        lists[0] = verb->verb_ctrls;
+        counts[0] = verb->verb_count;
+        lists[1] = verb->device_ctrls;
+        counts[1] = verb->device_count;
+        lists[2] = verb->mod_ctrls;
+        counts[2] = verb->mod_count;
+        for (list = 0; list < 3; list++) {
+            if (lists[list] == NULL)
+                continue;
+            for (index = 0; index < counts[list]; index++) {
+                for (mindex = 0; mindex < lists[list][index].ena_mixer_count;
+                     mindex++)
+                    fn(&lists[list][index].ena_mixer_list[mindex], arg);
+                for (mindex = 0; mindex < lists[list][index].dis_mixer_count;
+                     mindex++)
+                    fn(&lists[list][index].dis_mixer_list[mindex], arg);
+            }
+        }
+    }
+}
+
+/* Open addressed table used to intern mixer control names */
+struct snd_ucm_intern {
+    const char **names;
+    int *ids;
+    int size;
+    int count;
+};
+
+static void snd_ucm_count_mixer(mixer_control_t *mixer, void *arg)
+{
+    (*(int *)arg)++;
+}
+
+static void snd_ucm_intern_mixer(mixer_control_t *mixer, void *arg)
+{
+    struct snd_ucm_intern *intern = (struct snd_ucm_intern *)arg;
+    uint32_t slot;
+
+    if (mixer->control_name == NULL)
+        return;
+    slot = snd_ucm_hash(mixer->control_name) & (intern->size - 1);
+    while (intern->names[slot] != NULL &&
+           strcmp(intern->names[slot], mixer->control_name))
+        slot = (slot + 1) & (intern->size - 1);
+    if (intern->names[slot] == NULL) {
+        intern->names[slot] = mixer->control_name;
+        intern->ids[slot] = intern->count++;
+    }
+    mixer->ctl_id = intern->ids[slot];
+}
+
+/* Give each distinct mixer control name an id, so that looking up the
+ * control on the card is done once per name
+ * Returns 0 on sucess, negative error code otherwise
+ */
+static int snd_ucm_intern_controls(card_ctxt_t *card_ctxt, int verb_count)
+{
+    struct snd_ucm_intern intern;
+    int total = 0;
+
+    snd_ucm_for_each_mixer(card_ctxt, verb_count, snd_ucm_count_mixer,
+        &total);
+    memset(&intern, 0, sizeof(intern));
+    intern.size = 8;
+    while (intern.size < 2 * total)
+        intern.size <<= 1;
+    intern.names = (const char **)calloc(intern.size, sizeof(char *));
+    intern.ids = (int *)calloc(intern.size, sizeof(int));
+    if (intern.names == NULL || intern.ids == NULL) {
+        free(intern.names);
+        free(intern.ids);
+        return -ENOMEM;
+    }
+    snd_ucm_for_each_mixer(card_ctxt, verb_count, snd_ucm_intern_mixer,
+        &intern);
+    free(intern.names);
+    free(intern.ids);
+    card_ctxt->mixer_ctls = (struct mixer_ctl **)calloc(
+                                intern.count ? intern.count : 1,
+                                sizeof(struct mixer_ctl *));
+    if (card_ctxt->mixer_ctls == NULL)
+        return -ENOMEM;
+    card_ctxt->mixer_ctl_count = intern.count;
+    return 0;
+}
+
+/* Index the verb list and the control lists of every verb once parsing
+ * has completed, and intern the mixer control names
+ * card_ctxt - card context, with card_lock held
+ * Returns 0 on sucess, negative error code otherwise
+ */
+static int snd_ucm_build_index(card_ctxt_t *card_ctxt)
+{
+    use_case_verb_t *verb;
+    int verb_count, ret = 0;
+
+    for (verb_count = 0; strncmp(card_ctxt->verb_list[verb_count],
+         SND_UCM_END_OF_LIST, strlen(SND_UCM_END_OF_LIST)); verb_count++) {
+        verb = &card_ctxt->use_case_verb_list[verb_count];
+        /* A verb that failed to parse keeps being scanned */
+        if (verb->verb_ctrls == NULL || verb->device_ctrls == NULL ||
+            verb->mod_ctrls == NULL) {
+            ALOGE("Verb %s not parsed, not indexed",
+                card_ctxt->verb_list[verb_count]);
+            ret = -EINVAL;
+            continue;
+        }
+        if (snd_ucm_index_build(&verb->verb_ctrls_index, verb->verb_ctrls,
+                snd_ucm_ctrl_name, verb->verb_count) < 0 ||
+            snd_ucm_index_build(&verb->device_ctrls_index, verb->device_ctrls,
+                snd_ucm_ctrl_name, verb->device_count) < 0 ||
+            snd_ucm_index_build(&verb->mod_ctrls_index, verb->mod_ctrls,
+                snd_ucm_ctrl_name, verb->mod_count) < 0)
+            ret = -ENOMEM;
+    }
+    if (snd_ucm_index_build(&card_ctxt->verb_list_index, card_ctxt->verb_list,
+            snd_ucm_str_name, verb_count) < 0)
+        ret = -ENOMEM;
+    if (snd_ucm_intern_controls(card_ctxt, verb_count) < 0)
+        ret = -ENOMEM;
+    return ret;
+}
+
+/* Free the indexes, resolved mixer controls and config file names of a
+ * card. Indexes of a compiled config live in its mapping.
+ */
+static void snd_ucm_free_index(card_ctxt_t *card_ctxt)
+{
+    use_case_verb_t *verb;
+    int index;
+
+    if (card_ctxt->compiled_buf == NULL && card_ctxt->verb_list != NULL &&
+        card_ctxt->use_case_verb_list != NULL) {
+        for (index = 0; card_ctxt->verb_list[index] != NULL &&
+             strncmp(card_ctxt->verb_list[index], SND_UCM_END_OF_LIST,
+             strlen(SND_UCM_END_OF_LIST)); index++) {
+            verb = &card_ctxt->use_case_verb_list[index];
+            free(verb->verb_ctrls_index.slots);
+            free(verb->device_ctrls_index.slots);
+            free(verb->mod_ctrls_index.slots);
+            memset(&verb->verb_ctrls_index, 0, sizeof(snd_ucm_name_index_t));
+            memset(&verb->device_ctrls_index, 0,
+                sizeof(snd_ucm_name_index_t));
+            memset(&verb->mod_ctrls_index, 0, sizeof(snd_ucm_name_index_t));
+        }
+        free(card_ctxt->verb_list_index.slots);
+    }
+    memset(&card_ctxt->verb_list_index, 0, sizeof(snd_ucm_name_index_t));
+    free(card_ctxt->mixer_ctls);
+    card_ctxt->mixer_ctls = NULL;
+    card_ctxt->mixer_ctl_count = 0;
+    for (index = 0; index < card_ctxt->source_count; index++)
+        free(card_ctxt->source_files[index]);
+    free(card_ctxt->source_files);
+    card_ctxt->source_files = NULL;
+    card_ctxt->source_count = 0;
+}
+
+/* Compiled config
+ *
+ * A compiled config is an image of the parsed lists of a card: the verbs,
+ * the control lists of each verb and their mixer controls laid out flat,
+ * each string stored once, and the name indexes. Every pointer in the
+ * image holds the file offset of its target, and a table after the image
+ * lists where those pointers are. Opening the card maps the file and turns
+ * the offsets into addresses, there is no parsing and no allocation.
+ * The image is only used while the config files it was compiled from have
+ * the size and hash recorded with it, and only by a build with the same
+ * structure layout.
+ */
+typedef struct snd_ucm_compiled_source {
+    uint64_t path;          /* file offset of the path */
+    uint64_t size;
+    uint64_t hash;
+} snd_ucm_compiled_source_t;
+
+typedef struct snd_ucm_compiled_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t pointer_size;
+    uint32_t verb_size;
+    uint32_t ctrl_size;
+    uint32_t mixer_size;
+    uint64_t file_size;
+    uint64_t payload_hash;  /* of everything after the header */
+    char card_name[MAX_STR_LEN];
+    int32_t verb_count;
+    int32_t mixer_ctl_count;
+    int32_t source_count;
+    int32_t reloc_count;
+    /* file offsets */
+    uint64_t sources;
+    uint64_t relocs;
+    uint64_t verbs;
+    uint64_t verb_list;
+    uint64_t verb_list_index;
+} snd_ucm_compiled_header_t;
+
+/* FNV-1a hash of a buffer */
+static uint64_t snd_ucm_hash_bytes(const char *data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    size_t index;
+
+    for (index = 0; index < size; index++) {
+        hash ^= (unsigned char)data[index];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/* Size and hash of a config file
+ * Returns 0 on sucess, negative error code otherwise
+ */
+static int snd_ucm_hash_file(const char *path, uint64_t *size, uint64_t *hash)
+{
+    struct stat st;
+    char *buf;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -errno;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -EINVAL;
+    }
+    *size = st.st_size;
+    if (st.st_size == 0) {
+        *hash = snd_ucm_hash_bytes(NULL, 0);
+        close(fd);
+        return 0;
+    }
+    buf = (char *)mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (buf == MAP_FAILED)
+        return -EINVAL;
+    *hash = snd_ucm_hash_bytes(buf, st.st_size);
+    munmap(buf, st.st_size);
+    return 0;
+}
+
+static void snd_ucm_compiled_path(card_ctxt_t *card_ctxt, char *path,
+size_t size)
+{
+    snprintf(path, size, "%s%s%s", COMPILED_CONFIG_DIR, card_ctxt->card_name,
+        SND_UCM_COMPILED_SUFFIX);
+}
+
+/* Image of a compiled config being built */
+typedef struct snd_ucm_blob {
+    char *buf;
+    size_t size;
+    size_t capacity;
+    /* file offsets of the pointers in the image */
+    uint64_t *relocs;
+    int reloc_count;
+    int reloc_capacity;
+    /* file offsets of the strings stored so far, open addressed */
+    uint64_t *strings;
+    int string_slots;
+    int string_count;
+    int error;
+} snd_ucm_blob_t;
+
+#define SND_UCM_BLOB_AT(blob, offset, type) \
+    ((type *)((blob)->buf + (offset)))
+
+/* Allocate zeroed space in the image
+ * Returns its file offset, 0 on error
+ */
+static uint64_t snd_ucm_blob_alloc(snd_ucm_blob_t *blob, size_t size,
+size_t align)
+{
+    size_t offset, capacity;
+    char *buf;
+
+    if (blob->error)
+        return 0;
+    offset = (blob->size + align - 1) & ~(align - 1);
+    if (offset + size > blob->capacity) {
+        capacity = blob->capacity ? blob->capacity : 16384;
+        while (capacity < offset + size)
+            capacity *= 2;
+        buf = (char *)realloc(blob->buf, capacity);
+        if (buf == NULL) {
+            blob->error = -ENOMEM;
+            return 0;
+        }
+        memset(buf + blob->capacity, 0, capacity - blob->capacity);
+        blob->buf = buf;
+        blob->capacity = capacity;
+    }
+    blob->size = offset + size;
+    return offset;
+}
+
+/* Point the pointer at file offset field to file offset target */
+static void snd_ucm_blob_ptr(snd_ucm_blob_t *blob, uint64_t field,
+uint64_t target)
+{
+    uint64_t *relocs;
+    int capacity;
+
+    if (blob->error || target == 0)
+        return;
+    if (blob->reloc_count == blob->reloc_capacity) {
+        capacity = blob->reloc_capacity ? blob->reloc_capacity * 2 : 1024;
+        relocs = (uint64_t *)realloc(blob->relocs,
+                     capacity * sizeof(uint64_t));
+        if (relocs == NULL) {
+            blob->error = -ENOMEM;
+            return;
+        }
+        blob->relocs = relocs;
+        blob->reloc_capacity = capacity;
+    }
+    *SND_UCM_BLOB_AT(blob, field, uintptr_t) = (uintptr_t)target;
+    blob->relocs[blob->reloc_count++] = field;
+}
+
+/* Store a string in the image, once however often it is used
+ * Returns its file offset, 0 for a NULL string or on error
+ */
+static uint64_t snd_ucm_blob_string(snd_ucm_blob_t *blob, const char *str)
+{
+    uint64_t *strings, offset;
+    uint32_t slot;
+    size_t len;
+    int slots, index;
+
+    if (str == NULL || blob->error)
+        return 0;
+    if (2 * (blob->string_count + 1) > blob->string_slots) {
+        slots = blob->string_slots ? blob->string_slots * 2 : 256;
+        strings = (uint64_t *)calloc(slots, sizeof(uint64_t));
+        if (strings == NULL) {
+            blob->error = -ENOMEM;
+            return 0;
+        }
+        for (index = 0; index < blob->string_slots; index++) {
+            if ((offset = blob->strings[index]) == 0)
+                continue;
+            slot = snd_ucm_hash(blob->buf + offset) & (slots - 1);
+            while (strings[slot] != 0)
+                slot = (slot + 1) & (slots - 1);
+            strings[slot] = offset;
+        }
+        free(blob->strings);
+        blob->strings = strings;
+        blob->string_slots = slots;
+    }
+    slot = snd_ucm_hash(str) & (blob->string_slots - 1);
+    while ((offset = blob->strings[slot]) != 0) {
+        if (!strcmp(blob->buf + offset, str))
+            return offset;
+        slot = (slot + 1) & (blob->string_slots - 1);
+    }
+    len = strlen(str) + 1;
+    if ((offset = snd_ucm_blob_alloc(blob, len, 1)) == 0)
+        return 0;
+    memcpy(blob->buf + offset, str, len);
+    blob->strings[slot] = offset;
+    blob->string_count++;
+    return offset;
+}
+
+/* Store a list of strings, count including the end of list entry */
+static uint64_t snd_ucm_blob_strings(snd_ucm_blob_t *blob, char **list,
+int count)
+{
+    uint64_t offset, str;
+    int index;
+
+    if (list == NULL)
+        return 0;
+    offset = snd_ucm_blob_alloc(blob, count*sizeof(char *), sizeof(uint64_t));
+    for (index = 0; index < count; index++) {
+        str = snd_ucm_blob_string(blob, list[index]);
+        snd_ucm_blob_ptr(blob, offset + index*sizeof(char *), str);
+    }
+    return offset;
+}
+
+/* Store a mixer control list */
+static uint64_t snd_ucm_blob_mixers(snd_ucm_blob_t *blob,
+const mixer_control_t *list, int count)
+{
+    mixer_control_t *mixer;
+    uint64_t offset, field, name, string, mulval, value;
+    unsigned int mindex;
+    int index;
+
+    if (list == NULL || count <= 0)
+        return 0;
+    offset = snd_ucm_blob_alloc(blob, count*sizeof(mixer_control_t),
+                 sizeof(uint64_t));
+    for (index = 0; index < count; index++) {
+        field = offset + index*sizeof(mixer_control_t);
+        name = snd_ucm_blob_string(blob, list[index].control_name);
+        string = 0;
+        mulval = 0;
+        if (list[index].type == TYPE_STR) {
+            string = snd_ucm_blob_string(blob, list[index].string);
+        } else if (list[index].type == TYPE_MULTI_VAL &&
+                   list[index].mulval != NULL) {
+            mulval = snd_ucm_blob_alloc(blob,
+                         list[index].value*sizeof(char *), sizeof(uint64_t));
+            for (mindex = 0; mindex < list[index].value; mindex++) {
+                value = snd_ucm_blob_string(blob, list[index].mulval[mindex]);
+                snd_ucm_blob_ptr(blob, mulval + mindex*sizeof(char *), value);
+            }
+        }
+        if (blob->error)
+            return 0;
+        mixer = SND_UCM_BLOB_AT(blob, field, mixer_control_t);
+        mixer->type = list[index].type;
+        mixer->value = list[index].value;
+        mixer->ctl_id = list[index].ctl_id;
+        snd_ucm_blob_ptr(blob, field + offsetof(mixer_control_t, control_name),
+            name);
+        snd_ucm_blob_ptr(blob, field + offsetof(mixer_control_t, string),
+            string);
+        snd_ucm_blob_ptr(blob, field + offsetof(mixer_control_t, mulval),
+            mulval);
+    }
+    return offset;
+}
+
+/* Store a control list and its end of list entry */
+static uint64_t snd_ucm_blob_ctrls(snd_ucm_blob_t *blob,
+const card_mctrl_t *list, int count)
+{
+    card_mctrl_t *ctrl;
+    uint64_t offset, field, name, ena, dis, playback, capture, effects;
+    int index;
+
+    if (list == NULL)
+        return 0;
+    offset = snd_ucm_blob_alloc(blob, (count+1)*sizeof(card_mctrl_t),
+                 sizeof(uint64_t));
+    /* Only the name of the end of list entry is set by the parser */
+    field = offset + count*sizeof(card_mctrl_t);
+    name = snd_ucm_blob_string(blob, SND_UCM_END_OF_LIST);
+    snd_ucm_blob_ptr(blob, field + offsetof(card_mctrl_t, case_name), name);
+    for (index = 0; index < count; index++) {
+        field = offset + index*sizeof(card_mctrl_t);
+        name = snd_ucm_blob_string(blob, list[index].case_name);
+        ena = snd_ucm_blob_mixers(blob, list[index].ena_mixer_list,
+                  list[index].ena_mixer_count);
+        dis = snd_ucm_blob_mixers(blob, list[index].dis_mixer_list,
+                  list[index].dis_mixer_count);
+        playback = snd_ucm_blob_string(blob, list[index].playback_dev_name);
+        capture = snd_ucm_blob_string(blob, list[index].capture_dev_name);
+        effects = snd_ucm_blob_string(blob, list[index].effects_mixer_ctl);
+        if (blob->error)
+            return 0;
+        ctrl = SND_UCM_BLOB_AT(blob, field, card_mctrl_t);
+        ctrl->ena_mixer_count = ena ? list[index].ena_mixer_count : 0;
+        ctrl->dis_mixer_count = dis ? list[index].dis_mixer_count : 0;
+        ctrl->acdb_id = list[index].acdb_id;
+        ctrl->capability = list[index].capability;
+        snd_ucm_blob_ptr(blob, field + offsetof(card_mctrl_t, case_name), name);
+        snd_ucm_blob_ptr(blob, field + offsetof(card_mctrl_t, ena_mixer_list),
+            ena);
+        snd_ucm_blob_ptr(blob, field + offsetof(card_mctrl_t, dis_mixer_list),
+            dis);
+        snd_ucm_blob_ptr(blob,
+            field + offsetof(card_mctrl_t, playback_dev_name), playback);
+        snd_ucm_blob_ptr(blob,
+            field + offsetof(card_mctrl_t, capture_dev_name), capture);
+        snd_ucm_blob_ptr(blob,
+            field + offsetof(card_mctrl_t, effects_mixer_ctl), effects);
+    }
+    return offset;
+}
+
+/* Store a name index at file offset field */
+static void snd_ucm_blob_index(snd_ucm_blob_t *blob, uint64_t field,
+const snd_ucm_name_index_t *index)
+{
+    uint64_t slots;
+
+    if (index->size == 0)
+        return;
+    slots = snd_ucm_blob_alloc(blob, index->size*sizeof(int), sizeof(int));
+    if (blob->error)
+        return;
+    memcpy(blob->buf + slots, index->slots, index->size*sizeof(int));
+    SND_UCM_BLOB_AT(blob, field, snd_ucm_name_index_t)->size = index->size;
+    snd_ucm_blob_ptr(blob, field + offsetof(snd_ucm_name_index_t, slots),
+        slots);
+}
+
+/* Store the verbs of a card. Verbs of a single config file share their
+ * device and modifier lists, which are stored once.
+ */
+static uint64_t snd_ucm_blob_verbs(snd_ucm_blob_t *blob,
+card_ctxt_t *card_ctxt, int verb_count)
+{
+    use_case_verb_t *verb_list = card_ctxt->use_case_verb_list, *verb;
+    uint64_t offset, field, name, verb_ctrls, (*lists)[4];
+    int index, prev;
+
+    lists = (uint64_t (*)[4])calloc(verb_count ? verb_count : 1,
+                                    sizeof(*lists));
+    if (lists == NULL) {
+        blob->error = -ENOMEM;
+        return 0;
+    }
+    offset = snd_ucm_blob_alloc(blob, (verb_count+1)*sizeof(use_case_verb_t),
+                 sizeof(uint64_t));
+    for (index = 0; index < verb_count && !blob->error; index++) {
+        verb = &verb_list[index];
+        for (prev = 0; prev < index; prev++) {
+            if (verb_list[prev].device_ctrls == verb->device_ctrls)
+                lists[index][0] = lists[prev][0];
+            if (verb_list[prev].mod_ctrls == verb->mod_ctrls)
+                lists[index][1] = lists[prev][1];
+            if (verb_list[prev].device_list == verb->device_list)
+                lists[index][2] = lists[prev][2];
+            if (verb_list[prev].modifier_list == verb->modifier_list)
+                lists[index][3] = lists[prev][3];
+        }
+        if (lists[index][0] == 0)
+            lists[index][0] = snd_ucm_blob_ctrls(blob, verb->device_ctrls,
+                                  verb->device_count);
+        if (lists[index][1] == 0)
+            lists[index][1] = snd_ucm_blob_ctrls(blob, verb->mod_ctrls,
+                                  verb->mod_count);
+        if (lists[index][2] == 0)
+            lists[index][2] = snd_ucm_blob_strings(blob, verb->device_list,
+                                  verb->device_count+1);
+        if (lists[index][3] == 0)
+            lists[index][3] = snd_ucm_blob_strings(blob, verb->modifier_list,
+                                  verb->mod_count+1);
+        verb_ctrls = snd_ucm_blob_ctrls(blob, verb->verb_ctrls,
+                         verb->verb_count);
+        name = snd_ucm_blob_string(blob, verb->use_case_name);
+        if (blob->error)
+            break;
+        field = offset + index*sizeof(use_case_verb_t);
+        SND_UCM_BLOB_AT(blob, field, use_case_verb_t)->verb_count =
+            verb->verb_count;
+        SND_UCM_BLOB_AT(blob, field, use_case_verb_t)->device_count =
+            verb->device_count;
+        SND_UCM_BLOB_AT(blob, field, use_case_verb_t)->mod_count =
+            verb->mod_count;
+        snd_ucm_blob_ptr(blob, field + offsetof(use_case_verb_t, use_case_name),
+            name);
+        snd_ucm_blob_ptr(blob, field + offsetof(use_case_verb_t, verb_ctrls),
+            verb_ctrls);
+        snd_ucm_blob_ptr(blob, field + offsetof(use_case_verb_t, device_ctrls),
+            lists[index][0]);
+        snd_ucm_blob_ptr(blob, field + offsetof(use_case_verb_t, mod_ctrls),
+            lists[index][1]);
+        snd_ucm_blob_ptr(blob, field + offsetof(use_case_verb_t, device_list),
+            lists[index][2]);
+        snd_ucm_blob_ptr(blob,
+            field + offsetof(use_case_verb_t, modifier_list), lists[index][3]);
+        snd_ucm_blob_index(blob,
+            field + offsetof(use_case_verb_t, verb_ctrls_index),
+            &verb->verb_ctrls_index);
+        snd_ucm_blob_index(blob,
+            field + offsetof(use_case_verb_t, device_ctrls_index),
+            &verb->device_ctrls_index);
+        snd_ucm_blob_index(blob,
+            field + offsetof(use_case_verb_t, mod_ctrls_index),
+            &verb->mod_ctrls_index);
+    }
+    free(lists);
+    return blob->error ? 0 : offset;
+}
+
+/* Write the compiled config of a card once its config files are parsed
+ * and indexed. Written aside and renamed so that it is never seen half
+ * written.
+ * Returns 0 on sucess, negative error code otherwise
+ */
+static int snd_ucm_write_compiled(card_ctxt_t *card_ctxt)
+{
+    snd_ucm_blob_t blob;
+    snd_ucm_compiled_header_t *header;
+    snd_ucm_compiled_source_t *source;
+    uint64_t sources, verbs, verb_list, verb_list_index, relocs, path_offset;
+    uint64_t size, hash;
+    char path[200], tmp_path[210];
+    size_t written;
+    ssize_t count;
+    int verb_count, index, fd, ret = 0;
+
+    if (card_ctxt->source_count <= 0) {
+        ALOGE("Config files not known, config not compiled");
+        return -EINVAL;
+    }
+    for (verb_count = 0; strncmp(card_ctxt->verb_list[verb_count],
+         SND_UCM_END_OF_LIST, strlen(SND_UCM_END_OF_LIST)); verb_count++)
+        ;
+    memset(&blob, 0, sizeof(blob));
+    snd_ucm_blob_alloc(&blob, sizeof(snd_ucm_compiled_header_t),
+        sizeof(uint64_t));
+    sources = snd_ucm_blob_alloc(&blob,
+                  card_ctxt->source_count*sizeof(snd_ucm_compiled_source_t),
+                  sizeof(uint64_t));
+    for (index = 0; index < card_ctxt->source_count; index++) {
+        path_offset = snd_ucm_blob_string(&blob,
+                          card_ctxt->source_files[index]);
+        if ((ret = snd_ucm_hash_file(card_ctxt->source_files[index],
+                 &size, &hash)) < 0) {
+            ALOGE("Failed to read %s: %d", card_ctxt->source_files[index], ret);
+            goto done;
+        }
+        if (blob.error)
+            break;
+        source = SND_UCM_BLOB_AT(&blob, sources, snd_ucm_compiled_source_t) +
+                     index;
+        source->path = path_offset;
+        source->size = size;
+        source->hash = hash;
+    }
+    verbs = snd_ucm_blob_verbs(&blob, card_ctxt, verb_count);
+    verb_list = snd_ucm_blob_strings(&blob, card_ctxt->verb_list,
+                    verb_count+1);
+    verb_list_index = snd_ucm_blob_alloc(&blob, sizeof(snd_ucm_name_index_t),
+                          sizeof(uint64_t));
+    snd_ucm_blob_index(&blob, verb_list_index, &card_ctxt->verb_list_index);
+    relocs = snd_ucm_blob_alloc(&blob, blob.reloc_count*sizeof(uint64_t),
+                 sizeof(uint64_t));
+    if (blob.error) {
+        ret = blob.error;
+        ALOGE("Failed to compile config: %d", ret);
+        goto done;
+    }
+    memcpy(blob.buf + relocs, blob.relocs, blob.reloc_count*sizeof(uint64_t));
+
+    header = SND_UCM_BLOB_AT(&blob, 0, snd_ucm_compiled_header_t);
+    header->magic = SND_UCM_COMPILED_MAGIC;
+    header->version = SND_UCM_COMPILED_VERSION;
+    header->pointer_size = sizeof(void *);
+    header->verb_size = sizeof(use_case_verb_t);
+    header->ctrl_size = sizeof(card_mctrl_t);
+    header->mixer_size = sizeof(mixer_control_t);
+    header->file_size = blob.size;
+    strlcpy(header->card_name, card_ctxt->card_name, MAX_STR_LEN);
+    header->verb_count = verb_count;
+    header->mixer_ctl_count = card_ctxt->mixer_ctl_count;
+    header->source_count = card_ctxt->source_count;
+    header->reloc_count = blob.reloc_count;
+    header->sources = sources;
+    header->relocs = relocs;
+    header->verbs = verbs;
+    header->verb_list = verb_list;
+    header->verb_list_index = verb_list_index;
+    header->payload_hash = snd_ucm_hash_bytes(
+                               blob.buf + sizeof(snd_ucm_compiled_header_t),
+                               blob.size - sizeof(snd_ucm_compiled_header_t));
+
+    snd_ucm_compiled_path(card_ctxt, path, sizeof(path));
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0640);
+    if (fd < 0) {
+        ret = -errno;
+        ALOGE("Failed to create %s: %d", tmp_path, ret);
+        goto done;
+    }
+    for (written = 0; written < blob.size; written += count) {
+        count = write(fd, blob.buf + written, blob.size - written);
+        if (count <= 0) {
+            ret = count < 0 ? -errno : -EIO;
+            break;
+        }
+    }
+    if (ret == 0 && fsync(fd) < 0)
+        ret = -errno;
+    close(fd);
+    if (ret == 0 && rename(tmp_path, path) < 0)
+        ret = -errno;
+    if (ret < 0) {
+        ALOGE("Failed to write %s: %d", path, ret);
+        unlink(tmp_path);
+    } else {
+        ALOGD("Compiled config to %s, %zu bytes", path, blob.size);
+    }
+done:
+    free(blob.buf);
+    free(blob.relocs);
+    free(blob.strings);
+    return ret;
+}
+
+/* Returns true if a table of count entries of size bytes at file offset
+ * offset lies after the header and within the file */
+static bool snd_ucm_compiled_in_file(uint64_t offset, uint64_t count,
+size_t size, uint64_t file_size)
+{
+    return offset >= sizeof(snd_ucm_compiled_header_t) &&
+           offset <= file_size && count <= (file_size - offset) / size;
+}
+
+/* Check the header of a compiled config and that the config files it was
+ * compiled from are unchanged
+ * Returns 0 if it can be used, negative error code otherwise
+ */
+static int snd_ucm_check_compiled(card_ctxt_t *card_ctxt, const char *buf,
+uint64_t file_size)
+{
+    const snd_ucm_compiled_header_t *header =
+        (const snd_ucm_compiled_header_t *)buf;
+    const snd_ucm_compiled_source_t *sources;
+    uint64_t size, hash;
+    int index;
+
+    if (header->magic != SND_UCM_COMPILED_MAGIC ||
+        header->version != SND_UCM_COMPILED_VERSION ||
+        header->pointer_size != sizeof(void *) ||
+        header->verb_size != sizeof(use_case_verb_t) ||
+        header->ctrl_size != sizeof(card_mctrl_t) ||
+        header->mixer_size != sizeof(mixer_control_t) ||
+        header->file_size != file_size ||
+        strncmp(header->card_name, card_ctxt->card_name, MAX_STR_LEN) ||
+        header->verb_count < 0 || header->mixer_ctl_count < 0 ||
+        header->source_count <= 0 || header->reloc_count < 0) {
+        ALOGE("Compiled config of %s not for this build",
+            card_ctxt->card_name);
+        return -EINVAL;
+    }
+    if (!snd_ucm_compiled_in_file(header->sources, header->source_count,
+            sizeof(snd_ucm_compiled_source_t), file_size) ||
+        !snd_ucm_compiled_in_file(header->relocs, header->reloc_count,
+            sizeof(uint64_t), file_size) ||
+        !snd_ucm_compiled_in_file(header->verbs, header->verb_count+1,
+            sizeof(use_case_verb_t), file_size) ||
+        !snd_ucm_compiled_in_file(header->verb_list, header->verb_count+1,
+            sizeof(char *), file_size) ||
+        !snd_ucm_compiled_in_file(header->verb_list_index, 1,
+            sizeof(snd_ucm_name_index_t), file_size) ||
+        header->payload_hash != snd_ucm_hash_bytes(
+            buf + sizeof(snd_ucm_compiled_header_t),
+            file_size - sizeof(snd_ucm_compiled_header_t))) {
+        ALOGE("Compiled config of %s is corrupt", card_ctxt->card_name);
+        return -EINVAL;
+    }
+    sources = (const snd_ucm_compiled_source_t *)(buf + header->sources);
+    for (index = 0; index < header->source_count; index++) {
+        if (!snd_ucm_compiled_in_file(sources[index].path, 1, 1, file_size) ||
+            memchr(buf + sources[index].path, '\0',
+                file_size - sources[index].path) == NULL) {
+            ALOGE("Compiled config of %s is corrupt", card_ctxt->card_name);
+            return -EINVAL;
+        }
+        if (snd_ucm_hash_file(buf + sources[index].path, &size, &hash) < 0 ||
+            size != sources[index].size || hash != sources[index].hash) {
+            ALOGD("Config file %s changed, compiled config not used",
+                buf + sources[index].path);
+            return -ESTALE;
+        }
+    }
+    return 0;
+}
+
+/* Map the compiled config of a card if it is up to date
+ * uc_mgr - use case manager structure
+ * Returns 0 on sucess, negative error code otherwise
+ */
+static int snd_ucm_load_compiled(snd_use_case_mgr_t **uc_mgr)
+{
+    card_ctxt_t *card_ctxt = (*uc_mgr)->card_ctxt_ptr;
+    const snd_ucm_compiled_header_t *header;
+    const uint64_t *relocs;
+    uint64_t target;
+    struct stat st;
+    char path[200], *buf;
+    int fd, index;
+
+    snd_ucm_compiled_path(card_ctxt, path, sizeof(path));
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        ALOGV("No compiled config %s", path);
+        return -ENOENT;
+    }
+    if (fstat(fd, &st) < 0 ||
+        st.st_size < (off_t)sizeof(snd_ucm_compiled_header_t)) {
+        close(fd);
+        return -EINVAL;
+    }
+    /* Private and writable, pointers are fixed up in place */
+    buf = (char *)mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+              fd, 0);
+    close(fd);
+    if (buf == MAP_FAILED) {
+        ALOGE("failed to mmap %s error %d", path, errno);
+        return -EINVAL;
+    }
+    if (snd_ucm_check_compiled(card_ctxt, buf, st.st_size) < 0) {
+        munmap(buf, st.st_size);
+        return -EINVAL;
+    }
+    header = (const snd_ucm_compiled_header_t *)buf;
+    relocs = (const uint64_t *)(buf + header->relocs);
+    for (index = 0; index < header->reloc_count; index++) {
+        if (!snd_ucm_compiled_in_file(relocs[index], 1, sizeof(uintptr_t),
+                st.st_size) || (relocs[index] % sizeof(uintptr_t)) ||
+            (target = *(uintptr_t *)(buf + relocs[index])) <
+                sizeof(snd_ucm_compiled_header_t) ||
+            target >= (uint64_t)st.st_size) {
+            ALOGE("Compiled config %s is corrupt", path);
+            munmap(buf, st.st_size);
+            return -EINVAL;
+        }
+        *(char **)(buf + relocs[index]) = buf + target;
+    }
+    card_ctxt->use_case_verb_list = (use_case_verb_t *)(buf + header->verbs);
+    card_ctxt->verb_list = (char **)(buf + header->verb_list);
+    card_ctxt->verb_list_index =
+        *(snd_ucm_name_index_t *)(buf + header->verb_list_index);
+    card_ctxt->mixer_ctls = (struct mixer_ctl **)calloc(
+                                header->mixer_ctl_count ?
+                                header->mixer_ctl_count : 1,
+                                sizeof(struct mixer_ctl *));
+    card_ctxt->mixer_ctl_count =
+        card_ctxt->mixer_ctls ? header->mixer_ctl_count : 0;
+    card_ctxt->compiled_buf = buf;
+    card_ctxt->compiled_size = st.st_size;
+    ALOGD("Loaded compiled config %s", path);
+    return 0;
+}
@@ -35,6 +35,8 @@
 #include <stdio.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "alsa_ucm.h"
 #include "msm8960_use_cases.h"
@@ -43,6 +45,7 @@
 static void print_help_menu(void);
 static void alsaucm_test_cmd_svr(void);
 static int process_cmd(char *cmdStr);
+static int alsaucm_test_bench(const char *card_name, int iterations);
 
 /* Global data */
 snd_use_case_mgr_t *uc_mgr;
@@ -139,7 +142,10 @@ static void print_help_menu(void)
            "  geti IDENTIFIER            get integer value\n"
            "  set IDENTIFIER VALUE       set string value\n"
            "  help                     help\n"
-           "  quit                     quit\n");
+           "  quit                     quit\n"
+           "\nRun as 'alsaucm_test bench NAME [ITERATIONS]' to time opening card\n"
+           "NAME from its config files and from its compiled config, check both\n"
+           "give the same use cases, and time use case switches.\n");
 }
 
 int main(int argc, char **argv)
@@ -148,6 +154,8 @@ int main(int argc, char **argv)
     argc--;
     argv++;
 
+    if (argc > 1 && !strcmp(argv[0], "bench"))
+        return alsaucm_test_bench(argv[1], argc > 2 ? atoi(argv[2]) : 100);
     if (argc > 0) {
         if (!strncmp(argv[0], help_str, strlen(argv[0])))
             print_help_menu();
@@ -322,3 +330,222 @@ static int process_cmd(char *cmdStr)
     return 0;
 }
 
+
+static long elapsed_us(const struct timespec *start)
+{
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1000000 +
+           (end.tv_nsec - start->tv_nsec) / 1000;
+}
+
+static int str_differs(const char *a, const char *b)
+{
+    if (a == NULL || b == NULL)
+        return a != b;
+    return strcmp(a, b);
+}
+
+static int mixers_differ(const mixer_control_t *a, const mixer_control_t *b,
+                         int count)
+{
+    int i;
+    unsigned j;
+
+    for (i = 0; i < count; i++) {
+        if (str_differs(a[i].control_name, b[i].control_name) ||
+            a[i].type != b[i].type || a[i].ctl_id != b[i].ctl_id)
+            return 1;
+        if (a[i].type == TYPE_STR && str_differs(a[i].string, b[i].string))
+            return 1;
+        if (a[i].type == TYPE_INT && a[i].value != b[i].value)
+            return 1;
+        if (a[i].type == TYPE_MULTI_VAL) {
+            if (a[i].value != b[i].value ||
+                (a[i].mulval == NULL) != (b[i].mulval == NULL))
+                return 1;
+            for (j = 0; a[i].mulval && j < a[i].value; j++)
+                if (str_differs(a[i].mulval[j], b[i].mulval[j]))
+                    return 1;
+        }
+    }
+    return 0;
+}
+
+static int ctrls_differ(const card_mctrl_t *a, const card_mctrl_t *b,
+                        int count)
+{
+    int i;
+
+    if (a == NULL || b == NULL)
+        return a != b;
+    for (i = 0; i < count; i++) {
+        if (str_differs(a[i].case_name, b[i].case_name) ||
+            a[i].ena_mixer_count != b[i].ena_mixer_count ||
+            a[i].dis_mixer_count != b[i].dis_mixer_count ||
+            a[i].acdb_id != b[i].acdb_id ||
+            a[i].capability != b[i].capability ||
+            str_differs(a[i].playback_dev_name, b[i].playback_dev_name) ||
+            str_differs(a[i].capture_dev_name, b[i].capture_dev_name) ||
+            str_differs(a[i].effects_mixer_ctl, b[i].effects_mixer_ctl) ||
+            mixers_differ(a[i].ena_mixer_list, b[i].ena_mixer_list,
+                a[i].ena_mixer_count) ||
+            mixers_differ(a[i].dis_mixer_list, b[i].dis_mixer_list,
+                a[i].dis_mixer_count))
+            return 1;
+    }
+    return str_differs(a[count].case_name, b[count].case_name);
+}
+
+static int names_differ(char **a, char **b, int count)
+{
+    int i;
+
+    if (a == NULL || b == NULL)
+        return a != b;
+    for (i = 0; i <= count; i++)
+        if (str_differs(a[i], b[i]))
+            return 1;
+    return 0;
+}
+
+/* Compare the use cases of a parsed card with those of a compiled one */
+static int cards_differ(card_ctxt_t *parsed, card_ctxt_t *compiled)
+{
+    use_case_verb_t *a, *b;
+    int i;
+
+    for (i = 0; parsed->verb_list[i] &&
+         strcmp(parsed->verb_list[i], SND_UCM_END_OF_LIST); i++) {
+        if (str_differs(parsed->verb_list[i], compiled->verb_list[i])) {
+            printf("verb %d is %s, compiled %s\n", i, parsed->verb_list[i],
+                   compiled->verb_list[i]);
+            return 1;
+        }
+        a = &parsed->use_case_verb_list[i];
+        b = &compiled->use_case_verb_list[i];
+        if (str_differs(a->use_case_name, b->use_case_name) ||
+            a->verb_count != b->verb_count ||
+            a->device_count != b->device_count ||
+            a->mod_count != b->mod_count ||
+            ctrls_differ(a->verb_ctrls, b->verb_ctrls, a->verb_count) ||
+            ctrls_differ(a->device_ctrls, b->device_ctrls, a->device_count) ||
+            ctrls_differ(a->mod_ctrls, b->mod_ctrls, a->mod_count) ||
+            names_differ(a->device_list, b->device_list, a->device_count) ||
+            names_differ(a->modifier_list, b->modifier_list, a->mod_count)) {
+            printf("verb %s differs when compiled\n", parsed->verb_list[i]);
+            return 1;
+        }
+    }
+    return str_differs(parsed->verb_list[i], compiled->verb_list[i]) ||
+           parsed->mixer_ctl_count != compiled->mixer_ctl_count;
+}
+
+static long open_time_us(const char *card_name, const char *compiled_path,
+                         int iterations, int *err)
+{
+    snd_use_case_mgr_t *mgr;
+    struct timespec start;
+    long total = 0;
+    int i;
+
+    for (i = 0; i < iterations; i++) {
+        if (compiled_path != NULL)
+            unlink(compiled_path);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        *err = snd_use_case_mgr_open(&mgr, card_name);
+        if (*err < 0)
+            return 0;
+        snd_use_case_mgr_wait_for_parsing(mgr);
+        total += elapsed_us(&start);
+        snd_use_case_mgr_close(mgr);
+    }
+    return total / iterations;
+}
+
+/* Switch to the first verb that has a device and back, iterations times */
+static long switch_time_us(snd_use_case_mgr_t *mgr, int iterations)
+{
+    card_ctxt_t *card = mgr->card_ctxt_ptr;
+    use_case_verb_t *verb = NULL;
+    struct timespec start;
+    int i;
+
+    for (i = 0; card->verb_list[i] &&
+         strcmp(card->verb_list[i], SND_UCM_END_OF_LIST); i++) {
+        if (card->use_case_verb_list[i].device_count > 0) {
+            verb = &card->use_case_verb_list[i];
+            break;
+        }
+    }
+    if (verb == NULL)
+        return -1;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < iterations; i++) {
+        snd_use_case_set(mgr, "_verb", verb->use_case_name);
+        snd_use_case_set(mgr, "_enadev", verb->device_ctrls[0].case_name);
+        snd_use_case_set(mgr, "_disdev", verb->device_ctrls[0].case_name);
+        snd_use_case_set(mgr, "_verb", SND_USE_CASE_VERB_INACTIVE);
+    }
+    return elapsed_us(&start) / iterations;
+}
+
+/* Times opening a card from its config files and from its compiled config,
+ * checks the compiled config gives the same use cases, and times switching
+ * use cases. Run it like this:
+ *
+ * adb shell alsaucm_test bench snd_soc_msm_2x 100
+ */
+static int alsaucm_test_bench(const char *card_name, int iterations)
+{
+    snd_use_case_mgr_t *parsed = NULL, *compiled = NULL;
+    char compiled_path[200];
+    long parse_us, compiled_us;
+    int err = 0, failed = 0;
+
+    if (iterations < 1)
+        iterations = 1;
+    snprintf(compiled_path, sizeof(compiled_path), "%s%s%s",
+             COMPILED_CONFIG_DIR, card_name, SND_UCM_COMPILED_SUFFIX);
+
+    parse_us = open_time_us(card_name, compiled_path, iterations, &err);
+    if (err < 0) {
+        fprintf(stderr, "bench: error failed to open sound card %s: %d\n",
+                card_name, err);
+        return 1;
+    }
+    if (access(compiled_path, R_OK) != 0) {
+        printf("%s not written\n", compiled_path);
+        failed = 1;
+    }
+    compiled_us = open_time_us(card_name, NULL, iterations, &err);
+    printf("open %s: config files %ld us, compiled %ld us\n", card_name,
+           parse_us, compiled_us);
+
+    unlink(compiled_path);
+    if (snd_use_case_mgr_open(&parsed, card_name) < 0 ||
+        snd_use_case_mgr_wait_for_parsing(parsed) != 0 ||
+        snd_use_case_mgr_open(&compiled, card_name) < 0) {
+        printf("failed to reopen %s\n", card_name);
+        failed = 1;
+    } else if (compiled->card_ctxt_ptr->compiled_buf == NULL) {
+        printf("compiled config of %s not used\n", card_name);
+        failed = 1;
+    } else if (cards_differ(parsed->card_ctxt_ptr, compiled->card_ctxt_ptr)) {
+        printf("compiled config of %s differs from its config files\n",
+               card_name);
+        failed = 1;
+    } else {
+        printf("use case switch: config files %ld us, compiled %ld us\n",
+               switch_time_us(parsed, iterations),
+               switch_time_us(compiled, iterations));
+    }
+    if (parsed)
+        snd_use_case_mgr_close(parsed);
+    if (compiled)
+        snd_use_case_mgr_close(compiled);
+
+    printf("%s\n", failed ? "SOMETHING FAILED" : "ALL PASSED");
+    return failed;
+}
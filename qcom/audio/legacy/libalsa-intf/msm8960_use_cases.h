@@ -106,6 +106,8 @@ typedef struct mixer_control {
     unsigned value;
     char *string;
     char **mulval;
+    /* interned control name, indexes card_ctxt_t mixer_ctls */
+    int ctl_id;
 }mixer_control_t;
 
 /* Use case mixer controls structure */
@@ -130,6 +132,13 @@ struct snd_ucm_ident_node {
     struct snd_ucm_ident_node *next;
 };
 
+/* Hash index over the names of a verb, device or modifier list. Slots are
+ * open addressed and hold the list index + 1, zero marks an empty slot */
+typedef struct snd_ucm_name_index {
+    int size;
+    int *slots;
+}snd_ucm_name_index_t;
+
 /* Structure to maintain the valid devices and
  * modifiers list per each use case */
 typedef struct use_case_verb {
@@ -142,6 +151,9 @@ typedef struct use_case_verb {
     card_mctrl_t *verb_ctrls;
     card_mctrl_t *device_ctrls;
     card_mctrl_t *mod_ctrls;
+    snd_ucm_name_index_t verb_ctrls_index;
+    snd_ucm_name_index_t device_ctrls_index;
+    snd_ucm_name_index_t mod_ctrls_index;
 }use_case_verb_t;
 
 /* SND card context structure */
@@ -158,6 +170,16 @@ typedef struct card_ctxt {
     int current_verb_index;
     use_case_verb_t *use_case_verb_list;
     char **verb_list;
+    snd_ucm_name_index_t verb_list_index;
+    /* mixer controls looked up so far, by ctl_id */
+    struct mixer_ctl **mixer_ctls;
+    int mixer_ctl_count;
+    /* config files parsed, recorded in the compiled config */
+    char **source_files;
+    int source_count;
+    /* mapping of the compiled config, NULL when parsed from text */
+    void *compiled_buf;
+    size_t compiled_size;
 }card_ctxt_t;
 
 /** use case manager structure */
@@ -171,12 +193,22 @@ struct snd_use_case_mgr {
     int current_rx_device;
     card_ctxt_t *card_ctxt_ptr;
     pthread_t thr;
+    bool thr_created;
     void *acdb_handle;
     bool isFusion3Platform;
 };
 
 #define MAX_NUM_CARDS (sizeof(card_list)/sizeof(char *))
 
+/* Parsed config files are compiled to COMPILED_CONFIG_DIR<card name>
+ * SND_UCM_COMPILED_SUFFIX, which later opens map instead of parsing */
+#ifndef COMPILED_CONFIG_DIR
+#define COMPILED_CONFIG_DIR "/data/misc/audio/"
+#endif
+#define SND_UCM_COMPILED_SUFFIX ".ucm"
+#define SND_UCM_COMPILED_MAGIC 0x4d435553 /* "SUCM" */
+#define SND_UCM_COMPILED_VERSION 1
+
 /* Valid sound cards list */
 static const char *card_list[] = {
     "snd_soc_msm",
@@ -314,6 +346,12 @@ static int snd_ucm_extract_dev_name(char *buf, char **dev_name);
 static int snd_ucm_extract_controls(char *buf, mixer_control_t **mixer_list, int count);
 static int snd_ucm_print(snd_use_case_mgr_t *uc_mgr);
 static void snd_ucm_free_mixer_list(snd_use_case_mgr_t **uc_mgr);
+/* Lookup index and compiled config functions */
+static int snd_ucm_build_index(card_ctxt_t *card_ctxt);
+static void snd_ucm_free_index(card_ctxt_t *card_ctxt);
+static int snd_ucm_add_source(card_ctxt_t *card_ctxt, const char *path);
+static int snd_ucm_load_compiled(snd_use_case_mgr_t **uc_mgr);
+static int snd_ucm_write_compiled(card_ctxt_t *card_ctxt);
 #ifdef __cplusplus
 }
 #endif
@@ -58,3 +58,7 @@ LOCAL_C_INCLUDES := \
 include $(BUILD_SHARED_LIBRARY)
 
 endif
+
+ifneq ($(filter msm8974 msm8226 msm8084 msm8992 msm8994,$(TARGET_BOARD_PLATFORM)),)
+include $(call all-makefiles-under, $(LOCAL_PATH))
+endif
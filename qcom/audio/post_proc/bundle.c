@@ -190,6 +190,7 @@ int offload_effects_bundle_hal_start_output(audio_io_handle_t output, int pcm_id
         return init_status;
 
     pthread_mutex_lock(&lock);
+    offload_params_begin();
     if (get_output(output) != NULL) {
         ALOGW("%s output already started", __func__);
         ret = -ENOSYS;
@@ -237,6 +238,7 @@ int offload_effects_bundle_hal_start_output(audio_io_handle_t output, int pcm_id
     }
     list_add_tail(&active_outputs_list, &out_ctxt->outputs_list_node);
 exit:
+    offload_params_commit();
     pthread_mutex_unlock(&lock);
     return ret;
 }
@@ -263,6 +265,7 @@ int offload_effects_bundle_hal_stop_output(audio_io_handle_t output, int pcm_id)
         goto exit;
     }
 
+    offload_params_forget_ctl(out_ctxt->ctl);
     if (out_ctxt->mixer)
         mixer_close(out_ctxt->mixer);
 
@@ -439,8 +442,11 @@ int effect_lib_create(const effect_uuid_t *uuid,
     pthread_mutex_lock(&lock);
     list_add_tail(&created_effects_list, &context->effects_list_node);
     output_context_t *out_ctxt = get_output(ioId);
-    if (out_ctxt != NULL)
+    if (out_ctxt != NULL) {
+        offload_params_begin();
         add_effect_to_output(out_ctxt, context);
+        offload_params_commit();
+    }
     pthread_mutex_unlock(&lock);
 
     *pHandle = (effect_handle_t)context;
@@ -540,6 +546,8 @@ int effect_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
     int status = 0;
 
     pthread_mutex_lock(&lock);
+    /* the parameters a command sets go to the DSP in one write per module */
+    offload_params_begin();
 
     if (!effect_exists(context)) {
         status = -ENOSYS;
@@ -716,6 +724,7 @@ int effect_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
     }
 
 exit:
+    offload_params_commit();
     pthread_mutex_unlock(&lock);
 
     return status;
@@ -19,6 +19,7 @@
 
 #include <errno.h>
 #include <stdbool.h>
+#include <string.h>
 #include <cutils/log.h>
 #include <tinyalsa/asoundlib.h>
 #include <sound/audio_effects.h>
@@ -52,6 +53,295 @@ const int map_reverb_opensl_preset_2_offload_preset
     {6, 20}
 };
 
+/*
+ * Parameter writes staged between offload_params_begin() and
+ * offload_params_commit() go out as one payload per control and module, each
+ * parameter with the last value it was given. Commands repeating what a control
+ * was last sent for a module are dropped. Callers hold the bundle lock.
+ */
+
+/* ints in an "Audio Effects Config" write: module, device, number of commands,
+ * then per command its parameter id, CONFIG_SET, offset, length and values */
+#define OFFLOAD_PARAMS_SIZE 128
+#define OFFLOAD_PARAMS_HEADER_SIZE 3
+#define OFFLOAD_COMMAND_HEADER_SIZE 4
+
+#define MAX_STAGED_PAYLOADS 16
+#define MAX_SENT_COMMANDS 64
+/* the largest command is an OpenSL equalizer configuration */
+#define MAX_SENT_COMMAND_SIZE (OFFLOAD_COMMAND_HEADER_SIZE + EQ_CONFIG_PARAM_LEN + \
+                               MAX_OSL_EQ_BANDS * EQ_CONFIG_PER_BAND_PARAM_LEN)
+
+struct staged_payload {
+    struct mixer_ctl *ctl;
+    int values[OFFLOAD_PARAMS_SIZE];
+    int size;
+};
+
+struct sent_command {
+    struct mixer_ctl *ctl;
+    int module;
+    int device;
+    int size;
+    int values[MAX_SENT_COMMAND_SIZE];
+};
+
+static bool batching_enabled = true;
+static int batch_depth;
+static struct staged_payload staged_payloads[MAX_STAGED_PAYLOADS];
+static int num_staged_payloads;
+static struct sent_command sent_commands[MAX_SENT_COMMANDS];
+static int num_sent_commands;
+
+static int command_size(const int *command)
+{
+    return OFFLOAD_COMMAND_HEADER_SIZE + command[3];
+}
+
+static bool command_is_enable(int module, int param_id)
+{
+    return (module == BASS_BOOST_MODULE && param_id == BASS_BOOST_ENABLE) ||
+           (module == VIRTUALIZER_MODULE && param_id == VIRTUALIZER_ENABLE) ||
+           (module == EQ_MODULE && param_id == EQ_ENABLE) ||
+           (module == REVERB_MODULE && param_id == REVERB_ENABLE);
+}
+
+/* Presets reload the other parameters of their module in the DSP, and are
+ * undone by any of them. Enabling is independent of both. */
+static bool command_is_preset(int module, int param_id)
+{
+    return (module == EQ_MODULE && param_id == EQ_CONFIG) ||
+           (module == REVERB_MODULE && param_id == REVERB_PRESET);
+}
+
+static struct sent_command *find_sent_command(struct mixer_ctl *ctl, int module,
+                                              int param_id)
+{
+    int i;
+
+    for (i = 0; i < num_sent_commands; i++) {
+        if (sent_commands[i].ctl == ctl && sent_commands[i].module == module &&
+            sent_commands[i].values[0] == param_id)
+            return &sent_commands[i];
+    }
+    return NULL;
+}
+
+enum {
+    FORGET_ALL,
+    FORGET_PARAMETERS,  /* what a preset reloads */
+    FORGET_PRESETS,     /* what setting another parameter undoes */
+};
+
+/* module 0 is all modules */
+static void forget_sent_commands(struct mixer_ctl *ctl, int module, int what)
+{
+    int i = 0;
+
+    while (i < num_sent_commands) {
+        struct sent_command *sent = &sent_commands[i];
+        bool forget = sent->ctl == ctl && (module == 0 || sent->module == module);
+
+        if (forget && what == FORGET_PARAMETERS)
+            forget = !command_is_enable(sent->module, sent->values[0]);
+        else if (forget && what == FORGET_PRESETS)
+            forget = command_is_preset(sent->module, sent->values[0]);
+        if (forget)
+            *sent = sent_commands[--num_sent_commands];
+        else
+            i++;
+    }
+}
+
+/* records that command is what the DSP now holds for its parameter */
+static void remember_sent_command(struct mixer_ctl *ctl, int module, int device,
+                                  const int *command)
+{
+    struct sent_command *sent;
+    int size = command_size(command);
+
+    if (command_is_preset(module, command[0]))
+        forget_sent_commands(ctl, module, FORGET_PARAMETERS);
+    else if (!command_is_enable(module, command[0]))
+        forget_sent_commands(ctl, module, FORGET_PRESETS);
+
+    sent = find_sent_command(ctl, module, command[0]);
+    if (sent == NULL) {
+        if (num_sent_commands == MAX_SENT_COMMANDS || size > MAX_SENT_COMMAND_SIZE)
+            return;
+        sent = &sent_commands[num_sent_commands++];
+    } else if (size > MAX_SENT_COMMAND_SIZE) {
+        *sent = sent_commands[--num_sent_commands];
+        return;
+    }
+    sent->ctl = ctl;
+    sent->module = module;
+    sent->device = device;
+    sent->size = size;
+    memcpy(sent->values, command, size * sizeof(int));
+}
+
+static bool command_already_sent(struct mixer_ctl *ctl, int module, int device,
+                                 const int *command)
+{
+    struct sent_command *sent = find_sent_command(ctl, module, command[0]);
+
+    return sent != NULL && sent->device == device &&
+           sent->size == command_size(command) &&
+           memcmp(sent->values, command, sent->size * sizeof(int)) == 0;
+}
+
+/* writes the commands of values that would change what the DSP holds */
+static void write_params(struct mixer_ctl *ctl, const int *values)
+{
+    int param_values[OFFLOAD_PARAMS_SIZE] = {0};
+    int *p_param_values = param_values + OFFLOAD_PARAMS_HEADER_SIZE;
+    const int *command = values + OFFLOAD_PARAMS_HEADER_SIZE;
+    int i;
+
+    if (!batching_enabled) {
+        mixer_ctl_set_array(ctl, values, OFFLOAD_PARAMS_SIZE);
+        return;
+    }
+
+    param_values[0] = values[0];
+    param_values[1] = values[1];
+    for (i = 0; i < values[2]; i++, command += command_size(command)) {
+        if (command_already_sent(ctl, values[0], values[1], command))
+            continue;
+        /* in order, as a preset makes a later command of its module count again */
+        remember_sent_command(ctl, values[0], values[1], command);
+        memcpy(p_param_values, command, command_size(command) * sizeof(int));
+        p_param_values += command_size(command);
+        param_values[2] += 1;
+    }
+    if (param_values[2] == 0)
+        return;
+
+    if (mixer_ctl_set_array(ctl, param_values, OFFLOAD_PARAMS_SIZE) < 0) {
+        ALOGE("%s: writing module %x failed", __func__, values[0]);
+        forget_sent_commands(ctl, values[0], FORGET_ALL);
+    }
+}
+
+static int params_size(const int *values)
+{
+    const int *command = values + OFFLOAD_PARAMS_HEADER_SIZE;
+    int i;
+
+    for (i = 0; i < values[2]; i++)
+        command += command_size(command);
+    return command - values;
+}
+
+/* adds the commands of values to a staged payload, replacing earlier values of
+ * the same parameters */
+static bool merge_params(struct staged_payload *staged, const int *values)
+{
+    const int *command = values + OFFLOAD_PARAMS_HEADER_SIZE;
+    int i;
+
+    if (staged->size + params_size(values) - OFFLOAD_PARAMS_HEADER_SIZE >
+            OFFLOAD_PARAMS_SIZE)
+        return false;
+
+    for (i = 0; i < values[2]; i++, command += command_size(command)) {
+        int *staged_command = staged->values + OFFLOAD_PARAMS_HEADER_SIZE;
+        int j;
+
+        for (j = 0; j < staged->values[2]; j++) {
+            if (staged_command[0] == command[0]) {
+                int size = command_size(staged_command);
+                memmove(staged_command, staged_command + size,
+                        (staged->values + staged->size - staged_command - size) *
+                        sizeof(int));
+                staged->size -= size;
+                staged->values[2] -= 1;
+                break;
+            }
+            staged_command += command_size(staged_command);
+        }
+        memcpy(staged->values + staged->size, command,
+               command_size(command) * sizeof(int));
+        staged->size += command_size(command);
+        staged->values[2] += 1;
+    }
+    memset(staged->values + staged->size, 0,
+           (OFFLOAD_PARAMS_SIZE - staged->size) * sizeof(int));
+    staged->values[1] = values[1];
+    return true;
+}
+
+static void send_params(struct mixer_ctl *ctl, int *values)
+{
+    struct staged_payload *staged;
+    int i;
+
+    if (!batching_enabled || batch_depth == 0) {
+        write_params(ctl, values);
+        return;
+    }
+
+    for (i = 0; i < num_staged_payloads; i++) {
+        staged = &staged_payloads[i];
+        if (staged->ctl == ctl && staged->values[0] == values[0]) {
+            if (!merge_params(staged, values)) {
+                write_params(ctl, staged->values);
+                memcpy(staged->values, values, sizeof(staged->values));
+                staged->size = params_size(values);
+            }
+            return;
+        }
+    }
+    if (num_staged_payloads == MAX_STAGED_PAYLOADS) {
+        write_params(ctl, values);
+        return;
+    }
+    staged = &staged_payloads[num_staged_payloads++];
+    staged->ctl = ctl;
+    memcpy(staged->values, values, sizeof(staged->values));
+    staged->size = params_size(values);
+}
+
+void offload_params_begin(void)
+{
+    batch_depth++;
+}
+
+void offload_params_commit(void)
+{
+    int i;
+
+    if (batch_depth == 0) {
+        ALOGW("%s without offload_params_begin()", __func__);
+        return;
+    }
+    if (--batch_depth > 0)
+        return;
+
+    for (i = 0; i < num_staged_payloads; i++)
+        write_params(staged_payloads[i].ctl, staged_payloads[i].values);
+    num_staged_payloads = 0;
+}
+
+void offload_params_forget_ctl(struct mixer_ctl *ctl)
+{
+    int i = 0;
+
+    while (i < num_staged_payloads) {
+        if (staged_payloads[i].ctl == ctl)
+            staged_payloads[i] = staged_payloads[--num_staged_payloads];
+        else
+            i++;
+    }
+    forget_sent_commands(ctl, 0, FORGET_ALL);
+}
+
+void offload_params_set_batching(bool enable)
+{
+    batching_enabled = enable;
+}
+
 int offload_update_mixer_and_effects_ctl(int card, int device_id,
                                          struct mixer *mixer,
                                          struct mixer_ctl *ctl)
@@ -155,7 +445,7 @@ int offload_bassboost_send_params(struct mixer_ctl *ctl,
     }
 
     if (param_values[2] && ctl)
-        mixer_ctl_set_array(ctl, param_values, ARRAY_SIZE(param_values));
+        send_params(ctl, param_values);
 
     return 0;
 }
@@ -246,7 +536,7 @@ int offload_virtualizer_send_params(struct mixer_ctl *ctl,
     }
 
     if (param_values[2] && ctl)
-        mixer_ctl_set_array(ctl, param_values, ARRAY_SIZE(param_values));
+        send_params(ctl, param_values);
 
     return 0;
 }
@@ -346,7 +636,7 @@ int offload_eq_send_params(struct mixer_ctl *ctl, struct eq_params *eq,
     }
 
     if (param_values[2] && ctl)
-        mixer_ctl_set_array(ctl, param_values, ARRAY_SIZE(param_values));
+        send_params(ctl, param_values);
 
     return 0;
 }
@@ -594,7 +884,7 @@ int offload_reverb_send_params(struct mixer_ctl *ctl,
     }
 
     if (param_values[2] && ctl)
-        mixer_ctl_set_array(ctl, param_values, ARRAY_SIZE(param_values));
+        send_params(ctl, param_values);
 
     return 0;
 }
@@ -22,6 +22,17 @@ int offload_update_mixer_and_effects_ctl(int card, int device_id,
                                          struct mixer_ctl *ctl);
 void offload_close_mixer(struct mixer *mixer);
 
+/* Between offload_params_begin() and offload_params_commit() the
+ * offload_*_send_params() below are staged, and written on commit as one
+ * payload per control and module. Transactions nest. Commands that would not
+ * change what a control holds are never written.
+ * offload_params_forget_ctl() must be called before a control is closed. */
+void offload_params_begin(void);
+void offload_params_commit(void);
+void offload_params_forget_ctl(struct mixer_ctl *ctl);
+/* false writes each offload_*_send_params() call as it comes, for testing */
+void offload_params_set_batching(bool enable);
+
 #define OFFLOAD_SEND_BASSBOOST_ENABLE_FLAG      (1 << 0)
 #define OFFLOAD_SEND_BASSBOOST_STRENGTH         \
                                           (OFFLOAD_SEND_BASSBOOST_ENABLE_FLAG << 1)
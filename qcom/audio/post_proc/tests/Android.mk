@@ -0,0 +1,29 @@
+LOCAL_PATH := $(call my-dir)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	offload_params_test.c \
+	../bundle.c \
+	../equalizer.c \
+	../bass_boost.c \
+	../virtualizer.c \
+	../reverb.c \
+	../effect_api.c
+
+LOCAL_MODULE := offload_params_test
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/.. \
+	external/tinyalsa/include \
+	$(call include-path-for, audio-effects)
+
+LOCAL_CFLAGS := -Wno-unused-parameter -O2
+
+# the test provides its own mixer_* functions in place of libtinyalsa
+LOCAL_SHARED_LIBRARIES := \
+	libcutils \
+	liblog
+
+include $(BUILD_EXECUTABLE)
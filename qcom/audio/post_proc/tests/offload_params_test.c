@@ -0,0 +1,411 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <cutils/list.h>
+#include <audio_effects/effect_bassboost.h>
+#include <audio_effects/effect_environmentalreverb.h>
+#include <audio_effects/effect_equalizer.h>
+#include <audio_effects/effect_virtualizer.h>
+
+#include "bundle.h"
+#include "equalizer.h"
+#include "bass_boost.h"
+#include "virtualizer.h"
+#include "reverb.h"
+
+/*
+ * Drives the offload effects bundle through its effect interface against a
+ * mock mixer that applies each "Audio Effects Config" write to a model of the
+ * DSP and counts them. Runs the same commands writing every parameter change
+ * as it comes, then staged and deduplicated, checks the DSP ends up in the same
+ * state after each command, and times a custom equalizer setting with each
+ * control write costing -w microseconds.
+ *
+ * Run it like this:
+ *
+ * make offload_params_test -j32 && \
+ * adb push $OUT/system/bin/offload_params_test /data/local/tmp && \
+ * adb shell /data/local/tmp/offload_params_test -w 200 -n 50
+ */
+
+extern audio_effect_library_t AUDIO_EFFECT_LIBRARY_INFO_SYM;
+int offload_effects_bundle_hal_start_output(audio_io_handle_t output, int pcm_id);
+int offload_effects_bundle_hal_stop_output(audio_io_handle_t output, int pcm_id);
+
+#define OUTPUT_HANDLE 13
+#define PCM_ID 9
+#define NUM_MODULES 4   /* virtualizer, reverb, bass boost and equalizer */
+#define NUM_PARAMS 16
+#define MAX_PARAM_SIZE 64
+
+/* What the DSP holds, per module and parameter: the last command written. A
+ * preset reloads everything in its module but the enable flag. */
+struct dsp_state {
+    int device[NUM_MODULES];
+    int params[NUM_MODULES][NUM_PARAMS][MAX_PARAM_SIZE];
+};
+
+struct mixer {
+    int card;
+};
+
+struct mixer_ctl {
+    struct dsp_state dsp;
+    int writes;
+    long write_cost_us;
+};
+
+static struct mixer mixer;
+static struct mixer_ctl effects_ctl;
+static bool mixer_opened;
+
+struct mixer *mixer_open(unsigned int card)
+{
+    mixer_opened = true;
+    return &mixer;
+}
+
+void mixer_close(struct mixer *m)
+{
+    mixer_opened = false;
+}
+
+struct mixer_ctl *mixer_get_ctl_by_name(struct mixer *m, const char *name)
+{
+    char expected[64];
+    snprintf(expected, sizeof(expected), "Audio Effects Config %d", PCM_ID);
+    return strcmp(name, expected) == 0 ? &effects_ctl : NULL;
+}
+
+int mixer_ctl_set_array(struct mixer_ctl *ctl, const void *array, size_t count)
+{
+    const int *values = array;
+    const int module = (values[0] >> 12) - 1;
+    const int *command = values + 3;
+    int i;
+
+    if (count != 128 || module < 0 || module >= NUM_MODULES)
+        return -1;
+    ctl->dsp.device[module] = values[1];
+    for (i = 0; i < values[2]; i++) {
+        const int param = command[0] & 0xff;
+        const int size = 4 + command[3];
+        if (param >= NUM_PARAMS || size > MAX_PARAM_SIZE)
+            return -1;
+        if ((values[0] == EQ_MODULE && command[0] == EQ_CONFIG) ||
+            (values[0] == REVERB_MODULE && command[0] == REVERB_PRESET)) {
+            int p;
+            for (p = 2; p < NUM_PARAMS; p++)
+                memset(ctl->dsp.params[module][p], 0, sizeof(ctl->dsp.params[module][p]));
+        }
+        memcpy(ctl->dsp.params[module][param], command, size * sizeof(int));
+        command += size;
+    }
+    ctl->writes++;
+    if (ctl->write_cost_us > 0) {
+        /* spin rather than sleep, an ALSA control write keeps the caller busy */
+        struct timespec start, now;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        do {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+        } while ((now.tv_sec - start.tv_sec) * 1000000 +
+                 (now.tv_nsec - start.tv_nsec) / 1000 < ctl->write_cost_us);
+    }
+    return 0;
+}
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAILED %s:%d: ", __func__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            failures++; \
+        } \
+    } while (0)
+
+enum {
+    EFFECT_EQ,
+    EFFECT_BASS_BOOST,
+    EFFECT_VIRTUALIZER,
+    EFFECT_REVERB,
+    EFFECT_COUNT
+};
+
+static effect_handle_t effects[EFFECT_COUNT];
+
+static int command(effect_handle_t handle, uint32_t code, uint32_t size, void *data)
+{
+    int reply = 0;
+    uint32_t reply_size = sizeof(reply);
+    int status = (*handle)->command(handle, code, size, data, &reply_size, &reply);
+    return status != 0 ? status : reply;
+}
+
+static int set_param(effect_handle_t handle, int32_t param, const void *value,
+                     uint32_t value_size)
+{
+    uint32_t buf[16];
+    effect_param_t *p = (effect_param_t *)buf;
+    p->psize = sizeof(int32_t);
+    p->vsize = value_size;
+    memcpy(p->data, &param, sizeof(param));
+    memcpy(p->data + sizeof(int32_t), value, value_size);
+    return command(handle, EFFECT_CMD_SET_PARAM,
+                   sizeof(effect_param_t) + sizeof(int32_t) + value_size, p);
+}
+
+static int set_param16(effect_handle_t handle, int32_t param, int16_t value)
+{
+    return set_param(handle, param, &value, sizeof(value));
+}
+
+static int set_param32(effect_handle_t handle, int32_t param, int32_t value)
+{
+    return set_param(handle, param, &value, sizeof(value));
+}
+
+static int set_device(effect_handle_t handle, uint32_t device)
+{
+    return command(handle, EFFECT_CMD_SET_DEVICE, sizeof(device), &device);
+}
+
+static int set_custom_bands(effect_handle_t handle, int16_t base)
+{
+    int16_t properties[2 + NUM_EQ_BANDS] = { -1, NUM_EQ_BANDS };
+    int i;
+    for (i = 0; i < NUM_EQ_BANDS; i++)
+        properties[2 + i] = base + 100 * i;
+    return set_param(handle, EQ_PARAM_PROPERTIES, properties, sizeof(properties));
+}
+
+/*
+ * The commands of a session using all four effects. Each step leaves the DSP
+ * state in states[step] and the writes it took in writes[step].
+ */
+enum {
+    STEP_CREATE,
+    STEP_START,
+    STEP_ENABLE,
+    STEP_EQ_PRESET,
+    STEP_EQ_SAME_PRESET,
+    STEP_EQ_CUSTOM,
+    STEP_EQ_PRESET_AGAIN,
+    STEP_REVERB_ROOM,
+    STEP_REVERB_SAME_ROOM,
+    STEP_REVERB_DECAY,
+    STEP_BASS_BOOST_STRENGTH,
+    STEP_SPEAKER,
+    STEP_HEADPHONES,
+    STEP_RESTART,
+    STEP_DISABLE,
+    STEP_COUNT
+};
+
+static const char *step_names[STEP_COUNT] = {
+    "create", "start", "enable", "eq preset", "same eq preset", "custom eq",
+    "eq preset again", "reverb room level", "same reverb room level",
+    "reverb decay time", "bass boost strength", "speaker", "headphones", "restart",
+    "disable",
+};
+
+struct session {
+    struct dsp_state states[STEP_COUNT];
+    int writes[STEP_COUNT];
+};
+
+static void end_step(struct session *session, int step)
+{
+    static int last_writes;
+    if (step == 0)
+        last_writes = 0;
+    session->states[step] = effects_ctl.dsp;
+    session->writes[step] = effects_ctl.writes - last_writes;
+    last_writes = effects_ctl.writes;
+}
+
+static void run_session(struct session *session, bool batching)
+{
+    const effect_descriptor_t *descriptors[EFFECT_COUNT] = {
+        &equalizer_descriptor, &bassboost_descriptor, &virtualizer_descriptor,
+        &aux_env_reverb_descriptor,
+    };
+    int i;
+
+    memset(&effects_ctl, 0, sizeof(effects_ctl));
+    offload_params_set_batching(batching);
+
+    for (i = 0; i < EFFECT_COUNT; i++) {
+        CHECK(AUDIO_EFFECT_LIBRARY_INFO_SYM.create_effect(&descriptors[i]->uuid, 0,
+                OUTPUT_HANDLE, &effects[i]) == 0, "creating effect %d", i);
+    }
+    end_step(session, STEP_CREATE);
+
+    CHECK(offload_effects_bundle_hal_start_output(OUTPUT_HANDLE, PCM_ID) == 0, "start");
+    end_step(session, STEP_START);
+
+    CHECK(set_param16(effects[EFFECT_BASS_BOOST], BASSBOOST_PARAM_STRENGTH, 600) == 0,
+          "bass boost strength");
+    CHECK(set_param16(effects[EFFECT_VIRTUALIZER], VIRTUALIZER_PARAM_STRENGTH, 800) == 0,
+          "virtualizer strength");
+    for (i = 0; i < EFFECT_COUNT; i++)
+        CHECK(command(effects[i], EFFECT_CMD_ENABLE, 0, NULL) == 0, "enabling effect %d", i);
+    end_step(session, STEP_ENABLE);
+
+    CHECK(set_param16(effects[EFFECT_EQ], EQ_PARAM_CUR_PRESET, 2) == 0, "eq preset");
+    end_step(session, STEP_EQ_PRESET);
+    CHECK(set_param16(effects[EFFECT_EQ], EQ_PARAM_CUR_PRESET, 2) == 0, "eq preset");
+    end_step(session, STEP_EQ_SAME_PRESET);
+    CHECK(set_custom_bands(effects[EFFECT_EQ], -300) == 0, "custom eq");
+    end_step(session, STEP_EQ_CUSTOM);
+    CHECK(set_param16(effects[EFFECT_EQ], EQ_PARAM_CUR_PRESET, 2) == 0, "eq preset");
+    end_step(session, STEP_EQ_PRESET_AGAIN);
+
+    CHECK(set_param16(effects[EFFECT_REVERB], REVERB_PARAM_ROOM_LEVEL, -1000) == 0,
+          "reverb room level");
+    end_step(session, STEP_REVERB_ROOM);
+    CHECK(set_param16(effects[EFFECT_REVERB], REVERB_PARAM_ROOM_LEVEL, -1000) == 0,
+          "reverb room level");
+    end_step(session, STEP_REVERB_SAME_ROOM);
+    CHECK(set_param32(effects[EFFECT_REVERB], REVERB_PARAM_DECAY_TIME, 1490) == 0,
+          "reverb decay time");
+    end_step(session, STEP_REVERB_DECAY);
+
+    CHECK(set_param16(effects[EFFECT_BASS_BOOST], BASSBOOST_PARAM_STRENGTH, 700) == 0,
+          "bass boost strength");
+    end_step(session, STEP_BASS_BOOST_STRENGTH);
+
+    for (i = 0; i < EFFECT_COUNT; i++)
+        set_device(effects[i], AUDIO_DEVICE_OUT_SPEAKER);
+    end_step(session, STEP_SPEAKER);
+    for (i = 0; i < EFFECT_COUNT; i++)
+        set_device(effects[i], AUDIO_DEVICE_OUT_WIRED_HEADPHONE);
+    end_step(session, STEP_HEADPHONES);
+
+    /* a new stream starts with none of the parameters */
+    offload_effects_bundle_hal_stop_output(OUTPUT_HANDLE, PCM_ID);
+    CHECK(!mixer_opened, "mixer left open");
+    memset(&effects_ctl.dsp, 0, sizeof(effects_ctl.dsp));
+    CHECK(offload_effects_bundle_hal_start_output(OUTPUT_HANDLE, PCM_ID) == 0, "restart");
+    end_step(session, STEP_RESTART);
+
+    for (i = 0; i < EFFECT_COUNT; i++)
+        CHECK(command(effects[i], EFFECT_CMD_DISABLE, 0, NULL) == 0, "disabling effect %d", i);
+    end_step(session, STEP_DISABLE);
+
+    offload_effects_bundle_hal_stop_output(OUTPUT_HANDLE, PCM_ID);
+    for (i = 0; i < EFFECT_COUNT; i++)
+        AUDIO_EFFECT_LIBRARY_INFO_SYM.release_effect(effects[i]);
+}
+
+static void test_session(void)
+{
+    static struct session immediate, batched;
+    int immediate_writes = 0, batched_writes = 0;
+    int step;
+
+    run_session(&immediate, false);
+    run_session(&batched, true);
+
+    for (step = 0; step < STEP_COUNT; step++) {
+        CHECK(memcmp(&immediate.states[step], &batched.states[step],
+                     sizeof(struct dsp_state)) == 0, "DSP state differs after %s",
+              step_names[step]);
+        CHECK(batched.writes[step] <= immediate.writes[step], "%s: %d writes instead of %d",
+              step_names[step], batched.writes[step], immediate.writes[step]);
+        printf("%-24s %2d writes, %2d batched\n", step_names[step], immediate.writes[step],
+               batched.writes[step]);
+        immediate_writes += immediate.writes[step];
+        batched_writes += batched.writes[step];
+    }
+    printf("%-24s %2d writes, %2d batched\n", "total", immediate_writes, batched_writes);
+
+    CHECK(batched.writes[STEP_EQ_CUSTOM] == 1, "custom eq took %d writes",
+          batched.writes[STEP_EQ_CUSTOM]);
+    CHECK(batched.writes[STEP_EQ_SAME_PRESET] == 0, "same eq preset written again");
+    CHECK(batched.writes[STEP_EQ_PRESET_AGAIN] == 1, "eq preset after custom bands not written");
+    CHECK(batched.writes[STEP_REVERB_SAME_ROOM] == 0, "same reverb room level written again");
+    CHECK(batched.writes[STEP_RESTART] == immediate.writes[STEP_RESTART],
+          "restarted stream got %d writes instead of %d", batched.writes[STEP_RESTART],
+          immediate.writes[STEP_RESTART]);
+}
+
+static long custom_eq_time_us(bool batching, long write_cost_us, int iterations)
+{
+    struct timespec start, end;
+    effect_handle_t eq;
+    long total = 0;
+    int i;
+
+    memset(&effects_ctl, 0, sizeof(effects_ctl));
+    offload_params_set_batching(batching);
+    AUDIO_EFFECT_LIBRARY_INFO_SYM.create_effect(&equalizer_descriptor.uuid, 0, OUTPUT_HANDLE,
+                                                &eq);
+    offload_effects_bundle_hal_start_output(OUTPUT_HANDLE, PCM_ID);
+    command(eq, EFFECT_CMD_ENABLE, 0, NULL);
+    effects_ctl.write_cost_us = write_cost_us;
+
+    for (i = 0; i < iterations; i++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        set_custom_bands(eq, i % 2 ? -300 : 200);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        total += (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000;
+    }
+
+    offload_effects_bundle_hal_stop_output(OUTPUT_HANDLE, PCM_ID);
+    AUDIO_EFFECT_LIBRARY_INFO_SYM.release_effect(eq);
+    return total / iterations;
+}
+
+int main(int argc, char **argv)
+{
+    long write_cost_us = 100;
+    int iterations = 20;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "w:n:")) != -1) {
+        switch (opt) {
+        case 'w':
+            write_cost_us = atol(optarg);
+            break;
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-w write cost in us] [-n settings]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    test_session();
+
+    if (iterations > 0) {
+        printf("custom equalizer with %ld us per control write: %ld us, %ld us batched\n",
+               write_cost_us, custom_eq_time_us(false, write_cost_us, iterations),
+               custom_eq_time_us(true, write_cost_us, iterations));
+    }
+
+    printf("%s\n", failures == 0 ? "ALL PASSED" : "SOMETHING FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -17,7 +17,8 @@ LOCAL_PATH:= $(call my-dir)
 include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES:= \
-	offload_visualizer.c
+	offload_visualizer.c \
+	visualizer_kernels.c
 
 LOCAL_CFLAGS+= -O2 -fvisibility=hidden
 
@@ -35,3 +36,5 @@ LOCAL_C_INCLUDES := \
 	$(call include-path-for, audio-effects)
 
 include $(BUILD_SHARED_LIBRARY)
+
+include $(call all-makefiles-under, $(LOCAL_PATH))
@@ -30,6 +30,8 @@
 #include <tinyalsa/asoundlib.h>
 #include <audio_effects/effect_visualizer.h>
 
+#include "visualizer_kernels.h"
+
 #define LIB_ACDB_LOADER "libacdbloader.so"
 #define ACDB_DEV_TYPE_OUT 1
 #define AFE_PROXY_ACDB_ID 45
@@ -99,6 +101,13 @@ typedef struct output_context_s {
 /* maximum number of buffers for which we keep track of the measurements */
 #define MEASUREMENT_WINDOW_MAX_SIZE_IN_BUFFERS 25 /* note: buffer index is stored in uint8_t */
 
+/* Offload only: the magnitude spectrum of the current capture, computed here once rather than
+ * by every client from the waveform. Enabled by setting this bit with
+ * VISUALIZER_PARAM_MEASUREMENT_MODE; OFFLOAD_VISUALIZER_CMD_MAGNITUDES then replies with
+ * capture_size / 2 int32_t magnitudes in mB, from DC up. */
+#define OFFLOAD_MEASUREMENT_MODE_MAGNITUDES 0x10000
+#define OFFLOAD_VISUALIZER_CMD_MAGNITUDES (EFFECT_CMD_FIRST_PROPRIETARY + 0x100)
+
 typedef struct buffer_stats_s {
     bool is_valid;
     uint16_t peak_u16; /* the positive peak of the absolute value of the samples in a buffer */
@@ -121,6 +130,11 @@ typedef struct visualizer_context_s {
     uint8_t meas_wndw_size_in_buffers;
     uint8_t meas_buffer_idx;
     buffer_stats_t past_meas[MEASUREMENT_WINDOW_MAX_SIZE_IN_BUFFERS];
+    /* for magnitudes */
+    bool fft_valid; /* fft_mb holds the spectrum of the capture starting at fft_capture_point */
+    int32_t fft_capture_point;
+    int32_t fft_mb[VISUALIZER_FFT_SIZE_MAX / 2];
+    visualizer_fft_t fft;
 } visualizer_context_t;
 
 
@@ -571,6 +585,43 @@ uint32_t visualizer_get_delta_time_ms_from_updated_time(visualizer_context_t* vi
     return delta_ms;
 }
 
+/* start in capture_buf of the capture_size samples the listener is hearing delta_ms after the
+ * last update, negative when the capture wraps around the end of the buffer */
+int32_t visualizer_capture_point(visualizer_context_t *visu_ctxt, uint32_t delta_ms)
+{
+    int32_t latency_ms = visu_ctxt->latency;
+    latency_ms -= delta_ms;
+    if (latency_ms < 0) {
+        latency_ms = 0;
+    }
+    const uint32_t delta_smp =
+            visu_ctxt->common.config.inputCfg.samplingRate * latency_ms / 1000;
+
+    return visu_ctxt->capture_idx - visu_ctxt->capture_size - delta_smp;
+}
+
+/* copies the capture_size samples the listener is hearing now, delta_ms after the last update */
+void visualizer_copy_capture(visualizer_context_t *visu_ctxt, uint32_t delta_ms, uint8_t *dst)
+{
+    int32_t capture_point = visualizer_capture_point(visu_ctxt, delta_ms);
+    int32_t capture_size = visu_ctxt->capture_size;
+    if (capture_point < 0) {
+        int32_t size = -capture_point;
+        if (size > capture_size)
+            size = capture_size;
+
+        memcpy(dst,
+               visu_ctxt->capture_buf + CAPTURE_BUF_SIZE + capture_point,
+               size);
+        dst += size;
+        capture_size -= size;
+        capture_point = 0;
+    }
+    memcpy(dst,
+           visu_ctxt->capture_buf + capture_point,
+           capture_size);
+}
+
 int visualizer_reset(effect_context_t *context)
 {
     visualizer_context_t * visu_ctxt = (visualizer_context_t *)context;
@@ -579,6 +630,7 @@ int visualizer_reset(effect_context_t *context)
     visu_ctxt->last_capture_idx = 0;
     visu_ctxt->buffer_update_time.tv_sec = 0;
     visu_ctxt->latency = DSP_OUTPUT_LATENCY_MS;
+    visu_ctxt->fft_valid = false;
     memset(visu_ctxt->capture_buf, 0x80, CAPTURE_BUF_SIZE);
     return 0;
 }
@@ -721,24 +773,21 @@ int visualizer_process(effect_context_t *context,
         return -EINVAL;
     }
 
+    /* one pass over the buffer for the measurements and the normalization shift */
+    const uint32_t sample_count = inBuffer->frameCount * visu_ctxt->channel_count;
+    const bool measure = (visu_ctxt->meas_mode & MEASUREMENT_MODE_PEAK_RMS) != 0;
+    const bool normalize = visu_ctxt->scaling_mode == VISUALIZER_SCALING_MODE_NORMALIZED;
+    buffer_scan_t scan;
+    if (measure || normalize) {
+        visualizer_scan(inBuffer->s16, sample_count, &scan);
+    }
+
     // perform measurements if needed
-    if (visu_ctxt->meas_mode & MEASUREMENT_MODE_PEAK_RMS) {
-        // find the peak and RMS squared for the new buffer
-        uint32_t inIdx;
-        int16_t max_sample = 0;
-        float rms_squared_acc = 0;
-        for (inIdx = 0 ; inIdx < inBuffer->frameCount * visu_ctxt->channel_count ; inIdx++) {
-            if (inBuffer->s16[inIdx] > max_sample) {
-                max_sample = inBuffer->s16[inIdx];
-            } else if (-inBuffer->s16[inIdx] > max_sample) {
-                max_sample = -inBuffer->s16[inIdx];
-            }
-            rms_squared_acc += (inBuffer->s16[inIdx] * inBuffer->s16[inIdx]);
-        }
-        // store the measurement
-        visu_ctxt->past_meas[visu_ctxt->meas_buffer_idx].peak_u16 = (uint16_t)max_sample;
+    if (measure) {
+        // store the peak and RMS squared for the new buffer
+        visu_ctxt->past_meas[visu_ctxt->meas_buffer_idx].peak_u16 = scan.peak;
         visu_ctxt->past_meas[visu_ctxt->meas_buffer_idx].rms_squared =
-                rms_squared_acc / (inBuffer->frameCount * visu_ctxt->channel_count);
+                (float)((double)scan.sum_squares / sample_count);
         visu_ctxt->past_meas[visu_ctxt->meas_buffer_idx].is_valid = true;
         if (++visu_ctxt->meas_buffer_idx >= visu_ctxt->meas_wndw_size_in_buffers) {
             visu_ctxt->meas_buffer_idx = 0;
@@ -748,51 +797,20 @@ int visualizer_process(effect_context_t *context,
     /* all code below assumes stereo 16 bit PCM output and input */
     int32_t shift;
 
-    if (visu_ctxt->scaling_mode == VISUALIZER_SCALING_MODE_NORMALIZED) {
+    if (normalize) {
         /* derive capture scaling factor from peak value in current buffer
          * this gives more interesting captures for display. */
-        shift = 32;
-        int len = inBuffer->frameCount * 2;
-        int i;
-        for (i = 0; i < len; i++) {
-            int32_t smp = inBuffer->s16[i];
-            if (smp < 0) smp = -smp - 1; /* take care to keep the max negative in range */
-            int32_t clz = __builtin_clz(smp);
-            if (shift > clz) shift = clz;
-        }
-        /* A maximum amplitude signal will have 17 leading zeros, which we want to
-         * translate to a shift of 8 (for converting 16 bit to 8 bit) */
-        shift = 25 - shift;
-        /* Never scale by less than 8 to avoid returning unaltered PCM signal. */
-        if (shift < 3) {
-            shift = 3;
-        }
-        /* add one to combine the division by 2 needed after summing
-         * left and right channels below */
-        shift++;
+        shift = visualizer_normalized_shift(scan.magnitude_or);
     } else {
         assert(visu_ctxt->scaling_mode == VISUALIZER_SCALING_MODE_AS_PLAYED);
         shift = 9;
     }
 
-    uint32_t capt_idx;
-    uint32_t in_idx;
-    uint8_t *buf = visu_ctxt->capture_buf;
-    for (in_idx = 0, capt_idx = visu_ctxt->capture_idx;
-         in_idx < inBuffer->frameCount;
-         in_idx++, capt_idx++) {
-        if (capt_idx >= CAPTURE_BUF_SIZE) {
-            /* wrap around */
-            capt_idx = 0;
-        }
-        int32_t smp = inBuffer->s16[2 * in_idx] + inBuffer->s16[2 * in_idx + 1];
-        smp = smp >> shift;
-        buf[capt_idx] = ((uint8_t)smp)^0x80;
-    }
-
-    /* XXX the following two should really be atomic, though it probably doesn't
-     * matter much for visualization purposes */
-    visu_ctxt->capture_idx = capt_idx;
+    /* XXX the capture index update and the time stamp below should really be atomic, though it
+     * probably doesn't matter much for visualization purposes */
+    visualizer_downmix(inBuffer->s16, inBuffer->frameCount, shift,
+                       visu_ctxt->capture_buf, CAPTURE_BUF_SIZE, &visu_ctxt->capture_idx);
+    visu_ctxt->fft_valid = false;
     /* update last buffer update time stamp */
     if (clock_gettime(CLOCK_MONOTONIC, &visu_ctxt->buffer_update_time) < 0) {
         visu_ctxt->buffer_update_time.tv_sec = 0;
@@ -823,32 +841,8 @@ int visualizer_command(effect_context_t * context, uint32_t cmdCode, uint32_t cm
             break;
 
         if (context->state == EFFECT_STATE_ACTIVE) {
-            int32_t latency_ms = visu_ctxt->latency;
             const uint32_t delta_ms = visualizer_get_delta_time_ms_from_updated_time(visu_ctxt);
-            latency_ms -= delta_ms;
-            if (latency_ms < 0) {
-                latency_ms = 0;
-            }
-            const uint32_t delta_smp = context->config.inputCfg.samplingRate * latency_ms / 1000;
-
-            int32_t capture_point = visu_ctxt->capture_idx - visu_ctxt->capture_size - delta_smp;
-            int32_t capture_size = visu_ctxt->capture_size;
-            if (capture_point < 0) {
-                int32_t size = -capture_point;
-                if (size > capture_size)
-                    size = capture_size;
-
-                memcpy(pReplyData,
-                       visu_ctxt->capture_buf + CAPTURE_BUF_SIZE + capture_point,
-                       size);
-                pReplyData = (void *)((size_t)pReplyData + size);
-                capture_size -= size;
-                capture_point = 0;
-            }
-            memcpy(pReplyData,
-                   visu_ctxt->capture_buf + capture_point,
-                   capture_size);
-
+            visualizer_copy_capture(visu_ctxt, delta_ms, pReplyData);
 
             /* if audio framework has stopped playing audio although the effect is still
              * active we must clear the capture buffer to return silence */
@@ -916,6 +910,48 @@ int visualizer_command(effect_context_t * context, uint32_t cmdCode, uint32_t cm
         }
         break;
 
+    case OFFLOAD_VISUALIZER_CMD_MAGNITUDES: {
+        const uint32_t bins = visu_ctxt->capture_size / 2;
+        if (pReplyData == NULL || *replySize != bins * sizeof(int32_t)) {
+            ALOGV("%s OFFLOAD_VISUALIZER_CMD_MAGNITUDES error *replySize %d capture_size %d",
+                  __func__, *replySize, visu_ctxt->capture_size);
+            return -EINVAL;
+        }
+        if (!(visu_ctxt->meas_mode & OFFLOAD_MEASUREMENT_MODE_MAGNITUDES)) {
+            return -EINVAL;
+        }
+        if (visu_ctxt->fft.size != visu_ctxt->capture_size) {
+            visu_ctxt->fft_valid = false;
+            if (!visualizer_fft_init(&visu_ctxt->fft, visu_ctxt->capture_size)) {
+                return -EINVAL;
+            }
+        }
+
+        int32_t *p_int_reply_data = (int32_t *)pReplyData;
+        const uint32_t delta_ms = visualizer_get_delta_time_ms_from_updated_time(visu_ctxt);
+        if (context->state != EFFECT_STATE_ACTIVE ||
+                visu_ctxt->buffer_update_time.tv_sec == 0 || delta_ms > MAX_STALL_TIME_MS) {
+            uint32_t i;
+            for (i = 0; i < bins; i++) {
+                p_int_reply_data[i] = -9600; //-96dB
+            }
+            break;
+        }
+        /* the capture window follows playback between buffers too, so only clients polling
+         * again before it has moved by a sample share one transform; a processed buffer
+         * clears fft_valid as it rewrites capture_buf */
+        const int32_t capture_point = visualizer_capture_point(visu_ctxt, delta_ms);
+        if (!visu_ctxt->fft_valid || visu_ctxt->fft_capture_point != capture_point) {
+            uint8_t capture[VISUALIZER_FFT_SIZE_MAX];
+            visualizer_copy_capture(visu_ctxt, delta_ms, capture);
+            visualizer_fft_magnitudes(&visu_ctxt->fft, capture, visu_ctxt->fft_mb);
+            visu_ctxt->fft_capture_point = capture_point;
+            visu_ctxt->fft_valid = true;
+        }
+        memcpy(pReplyData, visu_ctxt->fft_mb, bins * sizeof(int32_t));
+        }
+        break;
+
     default:
         ALOGW("%s invalid command %d", __func__, cmdCode);
         return -EINVAL;
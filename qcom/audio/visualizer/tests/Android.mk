@@ -0,0 +1,17 @@
+LOCAL_PATH := $(call my-dir)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	visualizer_kernels_test.c \
+	../visualizer_kernels.c
+
+LOCAL_MODULE := visualizer_kernels_test
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/..
+
+LOCAL_CFLAGS := -Wno-unused-parameter -O2
+
+LOCAL_LDLIBS += -lm
+
+include $(BUILD_HOST_EXECUTABLE)
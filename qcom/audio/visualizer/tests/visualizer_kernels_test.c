@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "visualizer_kernels.h"
+
+/*
+ * Checks the visualizer kernels against the loops visualizer_process() used before they were
+ * split out: capture bytes, capture index, peak and normalization shift must match exactly,
+ * and the RMS within float rounding. Also checks the magnitude spectrum against a plain DFT.
+ *
+ * Run it like this:
+ *
+ * make visualizer_kernels_test -j32 && \
+ * out/host/linux-x86/obj/EXECUTABLES/visualizer_kernels_test_intermediates/visualizer_kernels_test
+ */
+
+#define CAPTURE_BUF_SIZE 65536
+#define MAX_FRAMES 4099
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAILED %s:%d: ", __func__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            failures++; \
+        } \
+    } while (0)
+
+/* The original loops of visualizer_process(), verbatim apart from the variable names. */
+static void legacy_measure(const int16_t *s16, uint32_t count, uint16_t *peak, float *rms_squared)
+{
+    uint32_t inIdx;
+    int16_t max_sample = 0;
+    float rms_squared_acc = 0;
+    for (inIdx = 0 ; inIdx < count ; inIdx++) {
+        if (s16[inIdx] > max_sample) {
+            max_sample = s16[inIdx];
+        } else if (-s16[inIdx] > max_sample) {
+            max_sample = -s16[inIdx];
+        }
+        rms_squared_acc += (s16[inIdx] * s16[inIdx]);
+    }
+    *peak = (uint16_t)max_sample;
+    *rms_squared = rms_squared_acc / count;
+}
+
+static int32_t legacy_shift(const int16_t *s16, uint32_t frames)
+{
+    int32_t shift = 32;
+    int len = frames * 2;
+    int i;
+    for (i = 0; i < len; i++) {
+        int32_t smp = s16[i];
+        if (smp < 0) smp = -smp - 1;
+        /* __builtin_clz(0) is undefined; ARM's clz gives 32, which the shipped code relied on */
+        int32_t clz = smp == 0 ? 32 : __builtin_clz(smp);
+        if (shift > clz) shift = clz;
+    }
+    shift = 25 - shift;
+    if (shift < 3) {
+        shift = 3;
+    }
+    shift++;
+    return shift;
+}
+
+static uint32_t legacy_downmix(const int16_t *s16, uint32_t frames, int32_t shift,
+                               uint8_t *buf, uint32_t capture_idx)
+{
+    uint32_t capt_idx;
+    uint32_t in_idx;
+    for (in_idx = 0, capt_idx = capture_idx;
+         in_idx < frames;
+         in_idx++, capt_idx++) {
+        if (capt_idx >= CAPTURE_BUF_SIZE) {
+            capt_idx = 0;
+        }
+        int32_t smp = s16[2 * in_idx] + s16[2 * in_idx + 1];
+        smp = smp >> shift;
+        buf[capt_idx] = ((uint8_t)smp)^0x80;
+    }
+    return capt_idx;
+}
+
+enum signal {
+    SIGNAL_NOISE,
+    SIGNAL_QUIET_NOISE,
+    SIGNAL_SINE,
+    SIGNAL_SILENCE,
+    SIGNAL_CLIPPING,
+    SIGNAL_COUNT
+};
+
+static void fill(int16_t *s16, uint32_t count, enum signal signal)
+{
+    uint32_t i;
+    for (i = 0; i < count; i++) {
+        switch (signal) {
+        case SIGNAL_NOISE:
+            s16[i] = (int16_t)(rand() & 0xffff);
+            break;
+        case SIGNAL_QUIET_NOISE:
+            s16[i] = (int16_t)(rand() % 201 - 100);
+            break;
+        case SIGNAL_SINE:
+            s16[i] = (int16_t)(20000 * sin(i * 0.01));
+            break;
+        case SIGNAL_SILENCE:
+            s16[i] = 0;
+            break;
+        case SIGNAL_CLIPPING:
+            /* full scale square wave with the odd -32768 sample, which the old peak wrapped */
+            s16[i] = (i / 7) & 1 ? 32767 : (rand() % 5 == 0 ? -32768 : -32767);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static void test_process(void)
+{
+    static int16_t s16[MAX_FRAMES * 2 + 1];
+    static uint8_t expected_buf[CAPTURE_BUF_SIZE];
+    static uint8_t actual_buf[CAPTURE_BUF_SIZE];
+    static const uint32_t frame_counts[] = { 0, 1, 7, 15, 16, 17, 240, 256, 1023, MAX_FRAMES };
+    static const uint32_t start_indexes[] = { 0, 5, CAPTURE_BUF_SIZE - 100, CAPTURE_BUF_SIZE };
+    int signal;
+    size_t f, s, offset;
+
+    for (signal = 0; signal < SIGNAL_COUNT; signal++) {
+        for (f = 0; f < sizeof(frame_counts) / sizeof(frame_counts[0]); f++) {
+            /* offset 1 leaves the samples 2 byte aligned only, for the unaligned vector loads */
+            for (offset = 0; offset < 2; offset++) {
+                const uint32_t frames = frame_counts[f];
+                int16_t *in = s16 + offset;
+                fill(in, frames * 2, (enum signal)signal);
+
+                buffer_scan_t scan;
+                visualizer_scan(in, frames * 2, &scan);
+
+                if (frames != 0) {
+                    uint16_t peak;
+                    float rms_squared;
+                    uint64_t sum_squares = 0;
+                    uint32_t i;
+                    legacy_measure(in, frames * 2, &peak, &rms_squared);
+                    for (i = 0; i < frames * 2; i++) {
+                        sum_squares += (int32_t)in[i] * in[i];
+                    }
+                    CHECK(scan.peak == peak, "signal %d frames %u peak %u expected %u",
+                          signal, frames, scan.peak, peak);
+                    CHECK(scan.sum_squares == sum_squares, "signal %d frames %u sum squares",
+                          signal, frames);
+                    /* the old float accumulation loses precision on long loud buffers */
+                    const float new_rms_squared = (float)((double)scan.sum_squares / (frames * 2));
+                    CHECK(fabsf(new_rms_squared - rms_squared) <= 1e-4f * rms_squared + 1e-6f,
+                          "signal %d frames %u rms squared %f expected %f",
+                          signal, frames, new_rms_squared, rms_squared);
+                }
+
+                const int32_t shift = visualizer_normalized_shift(scan.magnitude_or);
+                CHECK(shift == legacy_shift(in, frames), "signal %d frames %u shift %d expected %d",
+                      signal, frames, shift, legacy_shift(in, frames));
+
+                const int32_t shifts[] = { shift, 9 };
+                for (s = 0; s < sizeof(shifts) / sizeof(shifts[0]); s++) {
+                    size_t i;
+                    for (i = 0; i < sizeof(start_indexes) / sizeof(start_indexes[0]); i++) {
+                        memset(expected_buf, 0x55, sizeof(expected_buf));
+                        memset(actual_buf, 0x55, sizeof(actual_buf));
+                        uint32_t index = start_indexes[i];
+                        const uint32_t expected_index = legacy_downmix(in, frames, shifts[s],
+                                                                       expected_buf, index);
+                        visualizer_downmix(in, frames, shifts[s], actual_buf, CAPTURE_BUF_SIZE,
+                                           &index);
+                        CHECK(index == expected_index, "signal %d frames %u index %u expected %u",
+                              signal, frames, index, expected_index);
+                        CHECK(memcmp(actual_buf, expected_buf, CAPTURE_BUF_SIZE) == 0,
+                              "signal %d frames %u shift %d start %u capture differs",
+                              signal, frames, shifts[s], start_indexes[i]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void test_magnitudes(void)
+{
+    static visualizer_fft_t fft;
+    uint8_t capture[VISUALIZER_FFT_SIZE_MAX];
+    int32_t mb[VISUALIZER_FFT_SIZE_MAX / 2];
+    uint32_t size, i, k;
+
+    CHECK(!visualizer_fft_init(&fft, 0), "size 0 accepted");
+    CHECK(!visualizer_fft_init(&fft, 384), "size 384 accepted");
+    CHECK(!visualizer_fft_init(&fft, VISUALIZER_FFT_SIZE_MAX * 2), "size 2048 accepted");
+
+    for (size = 128; size <= VISUALIZER_FFT_SIZE_MAX; size *= 2) {
+        CHECK(visualizer_fft_init(&fft, size), "size %u refused", size);
+
+        /* silence is 0x80 and floors every bin */
+        memset(capture, 0x80, size);
+        visualizer_fft_magnitudes(&fft, capture, mb);
+        for (k = 0; k < size / 2; k++) {
+            CHECK(mb[k] == -9600, "size %u silent bin %u is %d mB", size, k, mb[k]);
+        }
+
+        /* a near full scale sine on a bin center reads about 0 mB there */
+        const uint32_t bin = size / 8;
+        for (i = 0; i < size; i++) {
+            capture[i] = (uint8_t)((int)lrint(127 * sin(2 * M_PI * bin * i / size)) ^ 0x80);
+        }
+        visualizer_fft_magnitudes(&fft, capture, mb);
+        CHECK(abs(mb[bin]) < 20, "size %u sine bin reads %d mB", size, mb[bin]);
+
+        /* and noise matches a plain DFT */
+        for (i = 0; i < size; i++) {
+            capture[i] = (uint8_t)rand();
+        }
+        visualizer_fft_magnitudes(&fft, capture, mb);
+        for (k = 0; k < size / 2; k++) {
+            double re = 0, im = 0;
+            for (i = 0; i < size; i++) {
+                const double x = (int8_t)(capture[i] ^ 0x80);
+                re += x * cos(2 * M_PI * k * i / size);
+                im -= x * sin(2 * M_PI * k * i / size);
+            }
+            const double full_scale = (k == 0 ? 128.0 : 64.0) * size;
+            const double power = (re * re + im * im) / (full_scale * full_scale);
+            const int32_t expected = power < 0.000016 * 0.000016 ?
+                    -9600 : (int32_t)(1000 * log10(power));
+            CHECK(abs(mb[k] - expected) <= 1, "size %u noise bin %u is %d mB expected %d",
+                  size, k, mb[k], expected);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    srand(1);
+    test_process();
+    test_magnitudes();
+
+    if (visualizer_kernels_set_simd_enabled(false)) {
+        printf("Checking the plain C loops\n");
+        test_process();
+        test_magnitudes();
+        visualizer_kernels_set_simd_enabled(true);
+    } else {
+        printf("No vector loops in this build\n");
+    }
+
+    printf("%s\n", failures == 0 ? "ALL PASSED" : "SOMETHING FAILED");
+    return failures == 0 ? 0 : 1;
+}
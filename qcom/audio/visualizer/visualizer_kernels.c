@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define VISUALIZER_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define VISUALIZER_SSE2
+#endif
+
+#include "visualizer_kernels.h"
+
+#define MIN_MB -9600 /* -96dB */
+
+static bool simd_enabled = true;
+
+/*
+ * The peak as the original loop computed it. A -32768 sample does not fit the int16_t
+ * maximum and wraps it negative, after which the result depends on the following samples.
+ * Kept so measurements of clipping buffers do not change.
+ */
+static uint16_t legacy_peak(const int16_t *samples, size_t count)
+{
+    int16_t max_sample = 0;
+    size_t i;
+    for (i = 0; i < count; i++) {
+        if (samples[i] > max_sample) {
+            max_sample = samples[i];
+        } else if (-samples[i] > max_sample) {
+            max_sample = (int16_t)-samples[i];
+        }
+    }
+    return (uint16_t)max_sample;
+}
+
+void visualizer_scan(const int16_t *samples, size_t count, buffer_scan_t *scan)
+{
+    int32_t max_abs = 0;    /* saturated at 32767 */
+    int32_t min_sample = 0;
+    uint32_t magnitude_or = 0;
+    uint64_t sum_squares = 0;
+    size_t i = 0;
+
+#if defined(VISUALIZER_SSE2)
+    if (simd_enabled && count >= 8) {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i vmax = zero;
+        __m128i vmin = zero;
+        __m128i vor = zero;
+        __m128i vsum = zero;
+        for (; i + 8 <= count; i += 8) {
+            const __m128i x = _mm_loadu_si128((const __m128i *)(samples + i));
+            vmax = _mm_max_epi16(vmax, _mm_max_epi16(x, _mm_subs_epi16(zero, x)));
+            vmin = _mm_min_epi16(vmin, x);
+            vor = _mm_or_si128(vor, _mm_xor_si128(x, _mm_srai_epi16(x, 15)));
+            /* pairs of squares are at most 2^31, so the 32 bit lanes are read as unsigned */
+            const __m128i squares = _mm_madd_epi16(x, x);
+            vsum = _mm_add_epi64(vsum, _mm_unpacklo_epi32(squares, zero));
+            vsum = _mm_add_epi64(vsum, _mm_unpackhi_epi32(squares, zero));
+        }
+        int16_t lanes_max[8], lanes_min[8], lanes_or[8];
+        uint64_t lanes_sum[2];
+        _mm_storeu_si128((__m128i *)lanes_max, vmax);
+        _mm_storeu_si128((__m128i *)lanes_min, vmin);
+        _mm_storeu_si128((__m128i *)lanes_or, vor);
+        _mm_storeu_si128((__m128i *)lanes_sum, vsum);
+        int lane;
+        for (lane = 0; lane < 8; lane++) {
+            if (lanes_max[lane] > max_abs) max_abs = lanes_max[lane];
+            if (lanes_min[lane] < min_sample) min_sample = lanes_min[lane];
+            magnitude_or |= (uint16_t)lanes_or[lane];
+        }
+        sum_squares = lanes_sum[0] + lanes_sum[1];
+    }
+#elif defined(VISUALIZER_NEON)
+    if (simd_enabled && count >= 8) {
+        int16x8_t vmax = vdupq_n_s16(0);
+        int16x8_t vmin = vdupq_n_s16(0);
+        int16x8_t vor = vdupq_n_s16(0);
+        int64x2_t vsum = vdupq_n_s64(0);
+        for (; i + 8 <= count; i += 8) {
+            const int16x8_t x = vld1q_s16(samples + i);
+            vmax = vmaxq_s16(vmax, vqabsq_s16(x));
+            vmin = vminq_s16(vmin, x);
+            vor = vorrq_s16(vor, veorq_s16(x, vshrq_n_s16(x, 15)));
+            vsum = vpadalq_s32(vsum, vmull_s16(vget_low_s16(x), vget_low_s16(x)));
+            vsum = vpadalq_s32(vsum, vmull_s16(vget_high_s16(x), vget_high_s16(x)));
+        }
+        int16_t lanes_max[8], lanes_min[8], lanes_or[8];
+        int64_t lanes_sum[2];
+        vst1q_s16(lanes_max, vmax);
+        vst1q_s16(lanes_min, vmin);
+        vst1q_s16(lanes_or, vor);
+        vst1q_s64(lanes_sum, vsum);
+        int lane;
+        for (lane = 0; lane < 8; lane++) {
+            if (lanes_max[lane] > max_abs) max_abs = lanes_max[lane];
+            if (lanes_min[lane] < min_sample) min_sample = lanes_min[lane];
+            magnitude_or |= (uint16_t)lanes_or[lane];
+        }
+        sum_squares = (uint64_t)(lanes_sum[0] + lanes_sum[1]);
+    }
+#endif
+
+    for (; i < count; i++) {
+        const int32_t smp = samples[i];
+        int32_t mag = smp < 0 ? -smp : smp;
+        if (mag > INT16_MAX) mag = INT16_MAX;
+        if (mag > max_abs) max_abs = mag;
+        if (smp < min_sample) min_sample = smp;
+        magnitude_or |= (uint32_t)(smp ^ (smp >> 15));
+        sum_squares += (uint32_t)(smp * smp);
+    }
+
+    scan->peak = min_sample == INT16_MIN ? legacy_peak(samples, count) : (uint16_t)max_abs;
+    scan->sum_squares = sum_squares;
+    scan->magnitude_or = magnitude_or;
+}
+
+int32_t visualizer_normalized_shift(uint32_t magnitude_or)
+{
+    /* The smallest count of leading zeros of any sample is that of their OR. A silent buffer
+     * counts as 32, which is what the ARM clz instruction gives for zero. */
+    int32_t shift = magnitude_or == 0 ? 32 : __builtin_clz(magnitude_or);
+    /* A maximum amplitude signal will have 17 leading zeros, which we want to
+     * translate to a shift of 8 (for converting 16 bit to 8 bit) */
+    shift = 25 - shift;
+    /* Never scale by less than 8 to avoid returning unaltered PCM signal. */
+    if (shift < 3) {
+        shift = 3;
+    }
+    /* add one to combine the division by 2 needed after summing
+     * left and right channels below */
+    return shift + 1;
+}
+
+/* Downmixes frames into contiguous capture bytes. */
+static void downmix_run(const int16_t *stereo, size_t frames, int32_t shift, uint8_t *out)
+{
+    size_t i = 0;
+
+#if defined(VISUALIZER_SSE2)
+    /* (left + right) >> shift only fits the 16 bit pack for shifts of at least one */
+    if (simd_enabled && shift >= 1) {
+        const __m128i ones = _mm_set1_epi16(1);
+        const __m128i count = _mm_cvtsi32_si128(shift);
+        const __m128i low_byte = _mm_set1_epi16(0xff);
+        const __m128i bias = _mm_set1_epi8((char)0x80);
+        for (; i + 16 <= frames; i += 16) {
+            const __m128i *in = (const __m128i *)(stereo + 2 * i);
+            const __m128i s0 = _mm_sra_epi32(_mm_madd_epi16(_mm_loadu_si128(in), ones), count);
+            const __m128i s1 = _mm_sra_epi32(_mm_madd_epi16(_mm_loadu_si128(in + 1), ones), count);
+            const __m128i s2 = _mm_sra_epi32(_mm_madd_epi16(_mm_loadu_si128(in + 2), ones), count);
+            const __m128i s3 = _mm_sra_epi32(_mm_madd_epi16(_mm_loadu_si128(in + 3), ones), count);
+            /* keep the low byte of each sample, as the uint8_t cast does */
+            const __m128i lo = _mm_and_si128(_mm_packs_epi32(s0, s1), low_byte);
+            const __m128i hi = _mm_and_si128(_mm_packs_epi32(s2, s3), low_byte);
+            _mm_storeu_si128((__m128i *)(out + i), _mm_xor_si128(_mm_packus_epi16(lo, hi), bias));
+        }
+    }
+#elif defined(VISUALIZER_NEON)
+    if (simd_enabled) {
+        const int32x4_t right_shift = vdupq_n_s32(-shift);
+        const uint8x8_t bias = vdup_n_u8(0x80);
+        for (; i + 8 <= frames; i += 8) {
+            const int16x8x2_t lr = vld2q_s16(stereo + 2 * i);
+            int32x4_t lo = vaddl_s16(vget_low_s16(lr.val[0]), vget_low_s16(lr.val[1]));
+            int32x4_t hi = vaddl_s16(vget_high_s16(lr.val[0]), vget_high_s16(lr.val[1]));
+            lo = vshlq_s32(lo, right_shift);
+            hi = vshlq_s32(hi, right_shift);
+            /* both narrowings truncate, as the uint8_t cast does */
+            const int16x8_t smp = vcombine_s16(vmovn_s32(lo), vmovn_s32(hi));
+            vst1_u8(out + i, veor_u8(vmovn_u16(vreinterpretq_u16_s16(smp)), bias));
+        }
+    }
+#endif
+
+    for (; i < frames; i++) {
+        int32_t smp = stereo[2 * i] + stereo[2 * i + 1];
+        smp = smp >> shift;
+        out[i] = ((uint8_t)smp)^0x80;
+    }
+}
+
+void visualizer_downmix(const int16_t *stereo, size_t frames, int32_t shift,
+                        uint8_t *capture, uint32_t capture_size, uint32_t *index)
+{
+    uint32_t capt_idx = *index;
+    while (frames > 0) {
+        if (capt_idx >= capture_size) {
+            /* wrap around */
+            capt_idx = 0;
+        }
+        size_t run = capture_size - capt_idx;
+        if (run > frames) {
+            run = frames;
+        }
+        downmix_run(stereo, run, shift, capture + capt_idx);
+        stereo += 2 * run;
+        frames -= run;
+        capt_idx += run;
+    }
+    *index = capt_idx;
+}
+
+bool visualizer_fft_init(visualizer_fft_t *fft, uint32_t size)
+{
+    if (size < 2 || size > VISUALIZER_FFT_SIZE_MAX || (size & (size - 1)) != 0) {
+        return false;
+    }
+    uint32_t k;
+    for (k = 0; k < size / 2; k++) {
+        const double phase = 2.0 * M_PI * k / size;
+        fft->cos_table[k] = (float)cos(phase);
+        fft->sin_table[k] = (float)sin(phase);
+    }
+    fft->size = size;
+    return true;
+}
+
+void visualizer_fft_magnitudes(visualizer_fft_t *fft, const uint8_t *capture, int32_t *mb)
+{
+    const uint32_t n = fft->size;
+    float *re = fft->re;
+    float *im = fft->im;
+    uint32_t i, j, len;
+
+    /* load in bit reversed order */
+    for (i = 0, j = 0; i < n; i++) {
+        re[j] = (float)capture[i] - 128.0f;
+        im[j] = 0.0f;
+        uint32_t bit = n >> 1;
+        while (bit != 0 && (j & bit) != 0) {
+            j ^= bit;
+            bit >>= 1;
+        }
+        j |= bit;
+    }
+
+    /* iterative radix-2 decimation in time */
+    for (len = 2; len <= n; len <<= 1) {
+        const uint32_t half = len / 2;
+        const uint32_t step = n / len;
+        for (i = 0; i < n; i += len) {
+            for (j = 0; j < half; j++) {
+                const float wr = fft->cos_table[j * step];
+                const float wi = -fft->sin_table[j * step];
+                const uint32_t a = i + j;
+                const uint32_t b = a + half;
+                const float xr = re[b] * wr - im[b] * wi;
+                const float xi = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - xr;
+                im[b] = im[a] - xi;
+                re[a] += xr;
+                im[a] += xi;
+            }
+        }
+    }
+
+    /* A full scale sine (amplitude 128) gives 64 * n in its bin; DC at 128 gives 128 * n. */
+    for (i = 0; i < n / 2; i++) {
+        const float full_scale = (i == 0 ? 128.0f : 64.0f) * n;
+        const float power = (re[i] * re[i] + im[i] * im[i]) / (full_scale * full_scale);
+        if (power < 0.000016f * 0.000016f) {
+            mb[i] = MIN_MB;
+        } else {
+            mb[i] = (int32_t)(1000 * log10f(power));
+        }
+    }
+}
+
+bool visualizer_kernels_set_simd_enabled(bool enabled)
+{
+#if defined(VISUALIZER_SSE2) || defined(VISUALIZER_NEON)
+    simd_enabled = enabled;
+    return true;
+#else
+    simd_enabled = false;
+    return false;
+#endif
+}
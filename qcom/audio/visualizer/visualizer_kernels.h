@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OFFLOAD_VISUALIZER_KERNELS_H
+#define OFFLOAD_VISUALIZER_KERNELS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Per-buffer kernels of the offload visualizer, split out of the effect so they can be tested
+ * on the host. The loops use SSE2 or NEON when the compiler targets them and plain C
+ * otherwise; all versions give identical results.
+ */
+
+/* Statistics of one buffer of 16 bit samples, gathered in a single pass. */
+typedef struct buffer_scan_s {
+    uint16_t peak;          /* largest magnitude, as the original scalar loop reported it */
+    uint64_t sum_squares;   /* exact sum of the squared samples */
+    uint32_t magnitude_or;  /* OR of s ^ (s >> 15), whose leading zeros give the scaling shift */
+} buffer_scan_t;
+
+void visualizer_scan(const int16_t *samples, size_t count, buffer_scan_t *scan);
+
+/*
+ * Shift applied to (left + right) to get 8 bit capture samples in normalized mode, derived from
+ * buffer_scan_t.magnitude_or: from 4 for quiet buffers up to 9 for full scale.
+ */
+int32_t visualizer_normalized_shift(uint32_t magnitude_or);
+
+/*
+ * Writes ((left + right) >> shift) ^ 0x80 for each stereo frame into the ring buffer capture,
+ * starting at *index and wrapping at capture_size, and advances *index.
+ */
+void visualizer_downmix(const int16_t *stereo, size_t frames, int32_t shift,
+                        uint8_t *capture, uint32_t capture_size, uint32_t *index);
+
+/*
+ * Magnitude spectrum of an 8 bit capture, in mB relative to a full scale sine.
+ * size is a power of two up to VISUALIZER_FFT_SIZE_MAX; size / 2 bins are produced,
+ * from DC up to one bin below Nyquist, floored at -9600 mB.
+ */
+#define VISUALIZER_FFT_SIZE_MAX 1024
+
+typedef struct visualizer_fft_s {
+    uint32_t size;
+    float cos_table[VISUALIZER_FFT_SIZE_MAX / 2];
+    float sin_table[VISUALIZER_FFT_SIZE_MAX / 2];
+    float re[VISUALIZER_FFT_SIZE_MAX];
+    float im[VISUALIZER_FFT_SIZE_MAX];
+} visualizer_fft_t;
+
+/* Returns false if size is not a power of two between 2 and VISUALIZER_FFT_SIZE_MAX. */
+bool visualizer_fft_init(visualizer_fft_t *fft, uint32_t size);
+void visualizer_fft_magnitudes(visualizer_fft_t *fft, const uint8_t *capture, int32_t *mb);
+
+/* Turns the vector loops off or on so tests can compare them with plain C. Returns false if
+ * this build has none. */
+bool visualizer_kernels_set_simd_enabled(bool enabled);
+
+#endif /* OFFLOAD_VISUALIZER_KERNELS_H */
@@ -746,6 +746,38 @@ const QCameraParameters::QCameraMap<int>
     { VIDEO_ROTATION_270, 270 }
 };
 
+const QCameraParameters::QCameraIncrementalParam
+        QCameraParameters::INCREMENTAL_PARAMS[] = {
+    { KEY_JPEG_QUALITY,                 &QCameraParameters::setJpegQuality },
+    { KEY_JPEG_THUMBNAIL_QUALITY,       &QCameraParameters::setJpegQuality },
+    { KEY_ROTATION,                     &QCameraParameters::setRotation },
+    { KEY_QC_BRIGHTNESS,                &QCameraParameters::setBrightness },
+    { KEY_ZOOM,                         &QCameraParameters::setZoom },
+    { KEY_QC_SHARPNESS,                 &QCameraParameters::setSharpness },
+    { KEY_QC_SATURATION,                &QCameraParameters::setSaturation },
+    { KEY_QC_CONTRAST,                  &QCameraParameters::setContrast },
+    { KEY_FLASH_MODE,                   &QCameraParameters::setFlash },
+    { KEY_AUTO_EXPOSURE_LOCK,           &QCameraParameters::setAecLock },
+    { KEY_AUTO_WHITEBALANCE_LOCK,       &QCameraParameters::setAwbLock },
+    { KEY_ANTIBANDING,                  &QCameraParameters::setAntibanding },
+    { KEY_EXPOSURE_COMPENSATION,        &QCameraParameters::setExposureCompensation },
+    { KEY_FOCUS_AREAS,                  &QCameraParameters::setFocusAreas },
+    { KEY_METERING_AREAS,               &QCameraParameters::setMeteringAreas },
+    { KEY_GPS_PROCESSING_METHOD,        &QCameraParameters::setGpsLocation },
+    { KEY_GPS_LATITUDE,                 &QCameraParameters::setGpsLocation },
+    { KEY_QC_GPS_LATITUDE_REF,          &QCameraParameters::setGpsLocation },
+    { KEY_GPS_LONGITUDE,                &QCameraParameters::setGpsLocation },
+    { KEY_QC_GPS_LONGITUDE_REF,         &QCameraParameters::setGpsLocation },
+    { KEY_QC_GPS_ALTITUDE_REF,          &QCameraParameters::setGpsLocation },
+    { KEY_GPS_ALTITUDE,                 &QCameraParameters::setGpsLocation },
+    { KEY_QC_GPS_STATUS,                &QCameraParameters::setGpsLocation },
+    { KEY_GPS_TIMESTAMP,                &QCameraParameters::setGpsLocation }
+};
+
+const char *const QCameraParameters::READONLY_PARAMS[] = {
+    KEY_SELECTED_AUTO_SCENE
+};
+
 #define DEFAULT_CAMERA_AREA "(0, 0, 0, 0, 0)"
 #define DATA_PTR(MEM_OBJ,INDEX) MEM_OBJ->getPtr( INDEX )
 #define TOTAL_RAM_SIZE_512MB 536870912
@@ -824,7 +856,10 @@ QCameraParameters::QCameraParameters()
       m_bHDRModeSensor(true),
       mOfflineRAW(false),
       m_bTruePortraitOn(false),
-      mCds_mode(CAM_CDS_MODE_OFF)
+      mCds_mode(CAM_CDS_MODE_OFF),
+      m_nParamGen(1),
+      m_nAppliedParamGen(0),
+      m_nFlattenGen(0)
 {
     char value[PROPERTY_VALUE_MAX];
     // TODO: may move to parameter instead of sysprop
@@ -926,7 +961,10 @@ QCameraParameters::QCameraParameters(const String8 &params)
     mOfflineRAW(false),
     m_bTruePortraitOn(false),
     mCds_mode(CAM_CDS_MODE_OFF),
-    mParmEffect(CAM_EFFECT_MODE_OFF)
+    mParmEffect(CAM_EFFECT_MODE_OFF),
+    m_nParamGen(1),
+    m_nAppliedParamGen(0),
+    m_nFlattenGen(0)
 {
     memset(&m_LiveSnapshotSize, 0, sizeof(m_LiveSnapshotSize));
     memset(&m_default_fps_range, 0, sizeof(m_default_fps_range));
@@ -4461,6 +4499,8 @@ int32_t QCameraParameters::updateParameters(QCameraParameters& params,
 {
     int32_t final_rc = NO_ERROR;
     int32_t rc;
+    uint32_t mask = 0;
+    String8 paramStr;
     m_bNeedRestart = false;
 
     if(initBatchUpdate(m_pParamBuf) < 0 ) {
@@ -4469,6 +4509,15 @@ int32_t QCameraParameters::updateParameters(QCameraParameters& params,
         goto UPDATE_PARAM_DONE;
     }
 
+    // Apps updating zoom or exposure compensation per frame change one key
+    // at a time; only run the setters of the keys that changed in that case
+    paramStr = params.flatten();
+    if (isIncrementalUpdateAllowed() &&
+            getChangedParamMask(m_lastParamStr.string(), paramStr.string(), mask)) {
+        final_rc = updateChangedParameters(params, mask);
+        goto UPDATE_PARAM_DONE;
+    }
+
     if ((rc = setPreviewSize(params)))                  final_rc = rc;
     if ((rc = setVideoSize(params)))                    final_rc = rc;
     if ((rc = setPictureSize(params)))                  final_rc = rc;
@@ -4550,7 +4599,13 @@ int32_t QCameraParameters::updateParameters(QCameraParameters& params,
 
     if ((rc = updateFlash(false)))                      final_rc = rc;
 
+    // sizes and formats above are written through CameraParameters directly
+    m_nParamGen++;
+
 UPDATE_PARAM_DONE:
+    if (final_rc == NO_ERROR) {
+        m_pendingParamStr = paramStr;
+    }
     needRestart = m_bNeedRestart;
     return final_rc;
 }
@@ -4568,7 +4623,18 @@ UPDATE_PARAM_DONE:
  *==========================================================================*/
 int32_t QCameraParameters::commitParameters()
 {
-    return commitSetBatch();
+    int32_t rc = commitSetBatch();
+
+    // keep the applied user setting as baseline for the next update
+    if ((rc == NO_ERROR) && !m_pendingParamStr.isEmpty()) {
+        m_lastParamStr = m_pendingParamStr;
+        m_nAppliedParamGen = m_nParamGen;
+    } else {
+        m_lastParamStr.clear();
+    }
+    m_pendingParamStr.clear();
+
+    return rc;
 }
 
 /*===========================================================================
@@ -5379,6 +5445,9 @@ int32_t QCameraParameters::initDefaultParameters()
     setOfflineRAW();
     memset(mStreamPpMask, 0, sizeof(uint32_t)*CAM_STREAM_TYPE_MAX);
 
+    // default sizes and formats are written through CameraParameters directly
+    m_nParamGen++;
+
     int32_t rc = commitParameters();
     if (rc == NO_ERROR) {
         rc = setNumOfSnapshot();
@@ -5473,6 +5542,9 @@ void QCameraParameters::deinit()
     //clear all entries in the map
     String8 emptyStr;
     QCameraParameters::unflatten(emptyStr);
+    m_nParamGen++;
+    m_lastParamStr.clear();
+    m_pendingParamStr.clear();
 
     if (NULL != m_pCamOpsTbl) {
         m_pCamOpsTbl->ops->unmap_buf(
@@ -10411,6 +10483,7 @@ const char *QCameraParameters::getFrameFmtString(cam_format_t fmt)
 int32_t QCameraParameters::initBatchUpdate(parm_buffer_t *p_table)
 {
     m_tempMap.clear();
+    m_pendingParamStr.clear();
 
     clear_metadata_buffer(p_table);
     return NO_ERROR;
@@ -10554,6 +10627,283 @@ int32_t QCameraParameters::commitParamChanges()
     return NO_ERROR;
 }
 
+/*===========================================================================
+ * FUNCTION   : isIncrementalUpdateAllowed
+ *
+ * DESCRIPTION: check if the next user setting can be applied by running only
+ *              the setters of the keys changed since the last commit
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : true if incremental update is allowed, false otherwise
+ *==========================================================================*/
+bool QCameraParameters::isIncrementalUpdateAllowed()
+{
+    // The baseline is only valid if nothing else touched the parameter map
+    // since it was committed, and no pending state asks for a full pass.
+    return !m_lastParamStr.isEmpty() &&
+            (m_nAppliedParamGen == m_nParamGen) &&
+            !m_bUpdateEffects &&
+            !(m_bForceZslMode && !m_bZslMode) &&
+            !m_reprocScaleParam.isScaleEnabled();
+}
+
+/*===========================================================================
+ * FUNCTION   : getChangedParamMask
+ *
+ * DESCRIPTION: compare two flattened parameter strings key by key and mark
+ *              the INCREMENTAL_PARAMS entries of all changed keys
+ *
+ * PARAMETERS :
+ *   @prevStr : flattened parameters of last committed user setting
+ *   @curStr  : flattened parameters of new user setting
+ *   @mask    : [output] bit i set if INCREMENTAL_PARAMS[i] changed
+ *
+ * RETURN     : true if all changed keys are in INCREMENTAL_PARAMS
+ *              false if a full update is needed
+ * NOTE       : Both strings come from flatten() and hence are sorted by key.
+ *==========================================================================*/
+bool QCameraParameters::getChangedParamMask(const char *prevStr,
+        const char *curStr, uint32_t &mask) const
+{
+    const char *prev = prevStr;
+    const char *cur = curStr;
+
+    mask = 0;
+    while ((*prev != '\0') || (*cur != '\0')) {
+        const char *prevEnd = prev + strcspn(prev, ";");
+        const char *curEnd = cur + strcspn(cur, ";");
+        const char *key = NULL;
+        const char *keyEnd = NULL;
+        int cmp;
+
+        if (*prev == '\0') {
+            cmp = 1;
+        } else if (*cur == '\0') {
+            cmp = -1;
+        } else {
+            const char *a = prev;
+            const char *b = cur;
+            while ((*a != '=') && (*a != ';') && (*a != '\0') && (*a == *b)) {
+                a++;
+                b++;
+            }
+            unsigned char ca = (unsigned char)((*a == '=') ? '\0' : *a);
+            unsigned char cb = (unsigned char)((*b == '=') ? '\0' : *b);
+            cmp = ca - cb;
+        }
+
+        if (cmp == 0) {
+            // same key, changed if the value differs
+            if (((prevEnd - prev) != (curEnd - cur)) ||
+                    (memcmp(prev, cur, (size_t)(prevEnd - prev)) != 0)) {
+                key = cur;
+                keyEnd = curEnd;
+            }
+            prev = (*prevEnd == ';') ? prevEnd + 1 : prevEnd;
+            cur = (*curEnd == ';') ? curEnd + 1 : curEnd;
+        } else if (cmp < 0) {
+            // key removed from user setting
+            key = prev;
+            keyEnd = prevEnd;
+            prev = (*prevEnd == ';') ? prevEnd + 1 : prevEnd;
+        } else {
+            // key added to user setting
+            key = cur;
+            keyEnd = curEnd;
+            cur = (*curEnd == ';') ? curEnd + 1 : curEnd;
+        }
+
+        if (key == NULL) {
+            continue;
+        }
+
+        const char *eq = (const char *)memchr(key, '=', (size_t)(keyEnd - key));
+        size_t keyLen = (size_t)(((eq != NULL) ? eq : keyEnd) - key);
+        if (isReadOnlyParam(key, keyLen)) {
+            // no setter reads it; the app just echoes back what HAL reported
+            continue;
+        }
+        size_t i;
+        for (i = 0; i < PARAM_MAP_SIZE(INCREMENTAL_PARAMS); i++) {
+            if ((strncmp(INCREMENTAL_PARAMS[i].key, key, keyLen) == 0) &&
+                    (INCREMENTAL_PARAMS[i].key[keyLen] == '\0')) {
+                break;
+            }
+        }
+        if (i == PARAM_MAP_SIZE(INCREMENTAL_PARAMS)) {
+            CDBG("%s: %.*s changed, full update needed", __func__, (int)keyLen, key);
+            return false;
+        }
+        mask |= (1U << i);
+    }
+
+    return true;
+}
+
+/*===========================================================================
+ * FUNCTION   : updateChangedParameters
+ *
+ * DESCRIPTION: apply the changed keys of user setting found by
+ *              getChangedParamMask
+ *
+ * PARAMETERS :
+ *   @params  : user setting parameters
+ *   @mask    : changed INCREMENTAL_PARAMS entries
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraParameters::updateChangedParameters(const QCameraParameters& params,
+        uint32_t mask)
+{
+    int32_t final_rc = NO_ERROR;
+    int32_t rc;
+
+    for (size_t i = 0; i < PARAM_MAP_SIZE(INCREMENTAL_PARAMS); i++) {
+        if ((mask & (1U << i)) == 0) {
+            continue;
+        }
+        QCameraParamSetter setter = INCREMENTAL_PARAMS[i].setter;
+
+        // setters covering several keys only need to run once
+        for (size_t j = i + 1; j < PARAM_MAP_SIZE(INCREMENTAL_PARAMS); j++) {
+            if (INCREMENTAL_PARAMS[j].setter == setter) {
+                mask &= ~(1U << j);
+            }
+        }
+        if ((rc = (this->*setter)(params)))             final_rc = rc;
+    }
+
+    if ((rc = updateFlash(false)))                      final_rc = rc;
+
+    return final_rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : isReadOnlyParam
+ *
+ * DESCRIPTION: check if a key is only written by HAL to report its state
+ *
+ * PARAMETERS :
+ *   @key     : key of the entry, not necessarily null terminated
+ *   @keyLen  : length of the key
+ *
+ * RETURN     : true if key is in READONLY_PARAMS, false otherwise
+ *==========================================================================*/
+bool QCameraParameters::isReadOnlyParam(const char *key, size_t keyLen) const
+{
+    for (size_t i = 0; i < PARAM_MAP_SIZE(READONLY_PARAMS); i++) {
+        if ((strncmp(READONLY_PARAMS[i], key, keyLen) == 0) &&
+                (READONLY_PARAMS[i][keyLen] == '\0')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*===========================================================================
+ * FUNCTION   : set
+ *
+ * DESCRIPTION: set a parameter entry, counting the change if value differs
+ *
+ * PARAMETERS :
+ *   @key     : key of the entry
+ *   @value   : value of the entry
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraParameters::set(const char *key, const char *value)
+{
+    const char *prev = get(key);
+    if ((prev != NULL) && (value != NULL) && (strcmp(prev, value) == 0)) {
+        return;
+    }
+    CameraParameters::set(key, value);
+    if ((m_nAppliedParamGen == m_nParamGen) && isReadOnlyParam(key, strlen(key))) {
+        // HAL state reports do not invalidate the last committed user setting
+        m_nAppliedParamGen++;
+    }
+    m_nParamGen++;
+}
+
+/*===========================================================================
+ * FUNCTION   : set
+ *
+ * DESCRIPTION: set an integer parameter entry
+ *
+ * PARAMETERS :
+ *   @key     : key of the entry
+ *   @value   : value of the entry
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraParameters::set(const char *key, int value)
+{
+    char str[16];
+    snprintf(str, sizeof(str), "%d", value);
+    set(key, str);
+}
+
+/*===========================================================================
+ * FUNCTION   : setFloat
+ *
+ * DESCRIPTION: set a float parameter entry
+ *
+ * PARAMETERS :
+ *   @key     : key of the entry
+ *   @value   : value of the entry
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraParameters::setFloat(const char *key, float value)
+{
+    char str[16];
+    snprintf(str, sizeof(str), "%g", value);
+    set(key, str);
+}
+
+/*===========================================================================
+ * FUNCTION   : remove
+ *
+ * DESCRIPTION: remove a parameter entry, counting the change if it existed
+ *
+ * PARAMETERS :
+ *   @key     : key of the entry
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraParameters::remove(const char *key)
+{
+    if (get(key) != NULL) {
+        CameraParameters::remove(key);
+        if ((m_nAppliedParamGen == m_nParamGen) && isReadOnlyParam(key, strlen(key))) {
+            m_nAppliedParamGen++;
+        }
+        m_nParamGen++;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : flatten
+ *
+ * DESCRIPTION: flatten parameters into a string, reusing the last result if
+ *              the parameter map has not changed since
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : string obj of flattened parameters
+ *==========================================================================*/
+String8 QCameraParameters::flatten() const
+{
+    if (m_nFlattenGen != m_nParamGen) {
+        m_flattenStr = CameraParameters::flatten();
+        m_nFlattenGen = m_nParamGen;
+    }
+    return m_flattenStr;
+}
+
 /*===========================================================================
  * FUNCTION   : QCameraReprocScaleParam
  *
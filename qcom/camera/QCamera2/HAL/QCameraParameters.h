@@ -572,6 +572,12 @@ public:
         valueType val;
     };
 
+    typedef int32_t (QCameraParameters::*QCameraParamSetter)(const QCameraParameters&);
+    struct QCameraIncrementalParam {
+        const char *const key;
+        QCameraParamSetter setter;
+    };
+
     friend class QCameraReprocScaleParam;
     QCameraReprocScaleParam m_reprocScaleParam;
 
@@ -589,6 +595,14 @@ public:
     int32_t initDefaultParameters();
     int32_t updateParameters(QCameraParameters&, bool &needRestart);
     int32_t commitParameters();
+
+    // CameraParameters mutators are shadowed so that every change to the
+    // parameter map is counted; flatten() caches its output against that count
+    void set(const char *key, const char *value);
+    void set(const char *key, int value);
+    void setFloat(const char *key, float value);
+    void remove(const char *key);
+    String8 flatten() const;
     int getPreviewHalPixelFormat() const;
     int32_t getStreamRotation(cam_stream_type_t streamType,
                                cam_pp_feature_config_t &featureConfig,
@@ -935,6 +949,13 @@ private:
     int32_t updateParamEntry(const char *key, const char *value);
     int32_t commitParamChanges();
 
+    // ops for applying only the user settings changed since last commit
+    bool isIncrementalUpdateAllowed();
+    bool getChangedParamMask(const char *prevStr, const char *curStr,
+            uint32_t &mask) const;
+    int32_t updateChangedParameters(const QCameraParameters& params, uint32_t mask);
+    bool isReadOnlyParam(const char *key, size_t keyLen) const;
+
     // Map from strings to values
     static const cam_dimension_t THUMBNAIL_SIZES_MAP[];
     static const QCameraMap<cam_auto_exposure_mode_type> AUTO_EXPOSURE_MAP[];
@@ -967,6 +988,12 @@ private:
     static const QCameraMap<int> SEE_MORE_MODES_MAP[];
     static const QCameraMap<int> STILL_MORE_MODES_MAP[];
 
+    // Keys that can be applied on their own, in updateParameters order,
+    // at most 32 as getChangedParamMask keeps one mask bit per entry
+    static const QCameraIncrementalParam INCREMENTAL_PARAMS[];
+    // Keys only the HAL writes to report state; apps cannot set them
+    static const char *const READONLY_PARAMS[];
+
     cam_capability_t *m_pCapability;
     mm_camera_vtbl_t *m_pCamOpsTbl;
     QCameraHeapMemory *m_pParamHeap;
@@ -1057,6 +1084,13 @@ private:
     int8_t mBufBatchCnt;
 
     uint32_t mRotation;
+
+    uint32_t m_nParamGen;            // bumped on every change to the parameter map
+    uint32_t m_nAppliedParamGen;     // m_nParamGen when m_lastParamStr was committed
+    String8 m_lastParamStr;          // last committed user setting, flattened
+    String8 m_pendingParamStr;       // user setting waiting for commitParameters
+    mutable String8 m_flattenStr;    // cached flatten() output
+    mutable uint32_t m_nFlattenGen;  // m_nParamGen when m_flattenStr was built
 };
 
 }; // namespace qcamera
@@ -0,0 +1,38 @@
+# Not part of the default build; build it with
+# QCAMERA_BUILD_BENCHMARKS=true make qcamera_parameters_benchmark
+ifeq ($(QCAMERA_BUILD_BENCHMARKS),true)
+
+LOCAL_PATH := $(call my-dir)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+        qcamera_parameters_benchmark.cpp \
+        ../QCameraParameters.cpp \
+        ../QCameraMem.cpp
+
+LOCAL_MODULE := qcamera_parameters_benchmark
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_C_INCLUDES := \
+        $(LOCAL_PATH)/.. \
+        $(LOCAL_PATH)/../../stack/common \
+        $(LOCAL_PATH)/../../util \
+        $(LOCAL_PATH)/../../../mm-image-codec/qexif \
+        $(LOCAL_PATH)/../../../mm-image-codec/qomx_core \
+        frameworks/native/include/media/hardware \
+        frameworks/native/include/media/openmax \
+        hardware/qcom/media/libstagefrighthw \
+        system/media/camera/include \
+        $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include \
+        $(TARGET_OUT_HEADERS)/qcom/display
+
+LOCAL_CFLAGS := -Wall -Wextra -Werror -O2
+LOCAL_CFLAGS += -DDEFAULT_DENOISE_MODE_ON -DHAL3
+
+LOCAL_SHARED_LIBRARIES := libcamera_client liblog libhardware libutils libcutils
+LOCAL_SHARED_LIBRARIES += libmmcamera_interface libmmjpeg_interface libui libqdMetaData
+
+LOCAL_32_BIT_ONLY := $(BOARD_QTI_CAMERA_32BIT_ONLY)
+include $(BUILD_EXECUTABLE)
+endif
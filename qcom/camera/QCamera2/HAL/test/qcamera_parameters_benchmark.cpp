@@ -0,0 +1,395 @@
+/* Copyright (c) 2016, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <utils/Vector.h>
+#include "QCameraParameters.h"
+
+using namespace android;
+using namespace qcamera;
+
+/*
+ * Replays a setParameters() trace through QCameraParameters the way
+ * QCamera2HardwareInterface does (parse, updateParameters, commitParameters)
+ * against a fake backend, checks that changed keys reach the backend and
+ * times each call, plus getParameters() flattening.
+ *
+ * Without -t the trace is the default parameters with zoom, exposure
+ * compensation and touch focus changing frame by frame and a white balance
+ * and a picture size change in between. With -t each line of the file is
+ * one flattened parameter string, e.g. as logged by the camera service.
+ *
+ * Run it like this:
+ *
+ * QCAMERA_BUILD_BENCHMARKS=true make qcamera_parameters_benchmark -j32 && \
+ * adb push $OUT/system/bin/qcamera_parameters_benchmark /data/local/tmp && \
+ * adb shell /data/local/tmp/qcamera_parameters_benchmark -n 20
+ */
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAILED %s:%d: ", __func__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            failures++; \
+        } \
+    } while (0)
+
+static int set_parms_calls;
+static parm_buffer_t last_parms;
+
+static int32_t fake_map_buf(uint32_t, uint8_t, int, size_t)
+{
+    return 0;
+}
+
+static int32_t fake_unmap_buf(uint32_t, uint8_t)
+{
+    return 0;
+}
+
+static int32_t fake_set_parms(uint32_t, parm_buffer_t *parms)
+{
+    set_parms_calls++;
+    memcpy(last_parms.is_valid, parms->is_valid, sizeof(last_parms.is_valid));
+    return 0;
+}
+
+static int32_t fake_get_parms(uint32_t, parm_buffer_t *)
+{
+    return 0;
+}
+
+static void fill_capability(cam_capability_t *cap)
+{
+    static const cam_dimension_t sizes[] = {
+        { 4160, 3120 }, { 1920, 1080 }, { 1280, 720 }, { 640, 480 }
+    };
+    size_t i;
+
+    memset(cap, 0, sizeof(*cap));
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        cap->picture_sizes_tbl[i] = sizes[i];
+        cap->livesnapshot_sizes_tbl[i] = sizes[i];
+    }
+    cap->picture_sizes_tbl_cnt = i;
+    cap->livesnapshot_sizes_tbl_cnt = i;
+    for (i = 1; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        cap->preview_sizes_tbl[i - 1] = sizes[i];
+        cap->video_sizes_tbl[i - 1] = sizes[i];
+    }
+    cap->preview_sizes_tbl_cnt = i - 1;
+    cap->video_sizes_tbl_cnt = i - 1;
+
+    cap->fps_ranges_tbl[0].min_fps = 7.5f;
+    cap->fps_ranges_tbl[0].max_fps = 30.0f;
+    cap->fps_ranges_tbl[0].video_min_fps = 7.5f;
+    cap->fps_ranges_tbl[0].video_max_fps = 30.0f;
+    cap->fps_ranges_tbl[1].min_fps = 30.0f;
+    cap->fps_ranges_tbl[1].max_fps = 30.0f;
+    cap->fps_ranges_tbl[1].video_min_fps = 30.0f;
+    cap->fps_ranges_tbl[1].video_max_fps = 30.0f;
+    cap->fps_ranges_tbl_cnt = 2;
+
+    cap->zoom_supported = 1;
+    cap->zoom_ratio_tbl_cnt = 60;
+    for (i = 0; i < cap->zoom_ratio_tbl_cnt; i++) {
+        cap->zoom_ratio_tbl[i] = (uint32_t)(100 + i * 5);
+    }
+
+    cap->exposure_compensation_min = -12;
+    cap->exposure_compensation_max = 12;
+    cap->exposure_compensation_step = 1.0f / 6;
+    cap->max_num_focus_areas = 1;
+    cap->max_num_metering_areas = 1;
+
+    cap->supported_focus_modes[0] = CAM_FOCUS_MODE_AUTO;
+    cap->supported_focus_modes[1] = CAM_FOCUS_MODE_CONTINOUS_PICTURE;
+    cap->supported_focus_modes_cnt = 2;
+    cap->supported_white_balances[0] = CAM_WB_MODE_AUTO;
+    cap->supported_white_balances[1] = CAM_WB_MODE_DAYLIGHT;
+    cap->supported_white_balances_cnt = 2;
+    cap->supported_flash_modes[0] = CAM_FLASH_MODE_OFF;
+    cap->supported_flash_modes[1] = CAM_FLASH_MODE_AUTO;
+    cap->supported_flash_modes_cnt = 2;
+    cap->supported_antibandings[0] = CAM_ANTIBANDING_MODE_AUTO;
+    cap->supported_antibandings_cnt = 1;
+    cap->supported_preview_fmts[0] = CAM_FORMAT_YUV_420_NV21;
+    cap->supported_preview_fmt_cnt = 1;
+
+    cap->brightness_ctrl.max_value = 6;
+    cap->brightness_ctrl.def_value = 3;
+    cap->brightness_ctrl.step = 1;
+    cap->sharpness_ctrl.max_value = 36;
+    cap->sharpness_ctrl.def_value = 12;
+    cap->sharpness_ctrl.step = 6;
+    cap->contrast_ctrl.max_value = 10;
+    cap->contrast_ctrl.def_value = 5;
+    cap->contrast_ctrl.step = 1;
+    cap->saturation_ctrl.max_value = 10;
+    cap->saturation_ctrl.def_value = 5;
+    cap->saturation_ctrl.step = 1;
+}
+
+/* what an app zooming, metering and refocusing sends frame by frame */
+static void make_trace(const QCameraParameters &defaults, int frames,
+        Vector<String8> &trace)
+{
+    QCameraParameters app(defaults.flatten());
+    char area[64];
+    int i;
+
+    for (i = 0; i < frames; i++) {
+        app.set(CameraParameters::KEY_ZOOM, i % 60);
+        app.set(CameraParameters::KEY_EXPOSURE_COMPENSATION, (i / 4) % 25 - 12);
+        if (i % 16 == 0) {
+            snprintf(area, sizeof(area), "(%d,%d,%d,%d,1)",
+                    -500 + i % 500, -300, i % 500, 300);
+            app.set(CameraParameters::KEY_FOCUS_AREAS, area);
+        }
+        if (i == frames / 2) {
+            app.set(CameraParameters::KEY_WHITE_BALANCE,
+                    CameraParameters::WHITE_BALANCE_DAYLIGHT);
+        }
+        if (i == frames * 3 / 4) {
+            app.set(CameraParameters::KEY_PICTURE_SIZE, "1920x1080");
+        }
+        trace.push(app.flatten());
+    }
+}
+
+static bool load_trace(const char *path, Vector<String8> &trace)
+{
+    FILE *fp = fopen(path, "r");
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+
+    if (fp == NULL) {
+        return false;
+    }
+    while ((len = getline(&line, &cap, fp)) > 0) {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            line[--len] = '\0';
+        }
+        if (len > 0) {
+            trace.push(String8(line));
+        }
+    }
+    free(line);
+    fclose(fp);
+    return true;
+}
+
+/* what QCamera2HardwareInterface::updateParameters and commitParameterChanges do */
+static int32_t set_parameters(QCameraParameters &params, const String8 &str)
+{
+    bool needRestart = false;
+    QCameraParameters param(str);
+    int32_t rc = params.updateParameters(param, needRestart);
+
+    if (rc == NO_ERROR) {
+        rc = params.commitParameters();
+    }
+    if (rc == NO_ERROR) {
+        rc = params.setNumOfSnapshot();
+    }
+    return rc;
+}
+
+static long elapsed_ns(const struct timespec &start, const struct timespec &end)
+{
+    return (end.tv_sec - start.tv_sec) * 1000000000L + (end.tv_nsec - start.tv_nsec);
+}
+
+static void test_updates(QCameraParameters &params, const Vector<String8> &trace)
+{
+    QCameraParameters app(trace[0]);
+    int calls;
+
+    CHECK(set_parameters(params, trace[0]) == NO_ERROR, "first setParameters failed");
+
+    /* a zoom step only sends the zoom */
+    app.set(CameraParameters::KEY_ZOOM, 7);
+    calls = set_parms_calls;
+    CHECK(set_parameters(params, app.flatten()) == NO_ERROR, "zoom setParameters failed");
+    CHECK(params.getInt(CameraParameters::KEY_ZOOM) == 7, "zoom %d",
+            params.getInt(CameraParameters::KEY_ZOOM));
+    CHECK(set_parms_calls == calls + 1 && last_parms.is_valid[CAM_INTF_PARM_ZOOM],
+            "zoom not sent");
+    CHECK(!last_parms.is_valid[CAM_INTF_PARM_STATS_DEBUG_MASK],
+            "unchanged settings sent along with zoom");
+
+    /* nothing changed, nothing sent */
+    calls = set_parms_calls;
+    CHECK(set_parameters(params, app.flatten()) == NO_ERROR, "repeated setParameters failed");
+    CHECK(set_parms_calls == calls, "unchanged setParameters reached the backend");
+
+    /* other keys go through the full update */
+    app.set(CameraParameters::KEY_WHITE_BALANCE, CameraParameters::WHITE_BALANCE_DAYLIGHT);
+    app.set(CameraParameters::KEY_EXPOSURE_COMPENSATION, 3);
+    CHECK(set_parameters(params, app.flatten()) == NO_ERROR, "white balance setParameters failed");
+    CHECK(strcmp(params.get(CameraParameters::KEY_WHITE_BALANCE),
+            CameraParameters::WHITE_BALANCE_DAYLIGHT) == 0, "white balance not applied");
+    CHECK(params.getInt(CameraParameters::KEY_EXPOSURE_COMPENSATION) == 3,
+            "exposure compensation not applied with white balance");
+    CHECK(last_parms.is_valid[CAM_INTF_PARM_STATS_DEBUG_MASK], "full update not taken");
+
+    /* a change made outside setParameters is not lost by the next update */
+    params.set(CameraParameters::KEY_ZOOM, 0);
+    app.set(CameraParameters::KEY_EXPOSURE_COMPENSATION, 4);
+    CHECK(set_parameters(params, app.flatten()) == NO_ERROR, "setParameters failed");
+    CHECK(params.getInt(CameraParameters::KEY_ZOOM) == 7, "zoom not restored, %d",
+            params.getInt(CameraParameters::KEY_ZOOM));
+
+    /* a rejected value is retried by the next update */
+    app.set(CameraParameters::KEY_ZOOM, 1000);
+    CHECK(set_parameters(params, app.flatten()) != NO_ERROR, "bad zoom accepted");
+    CHECK(set_parameters(params, app.flatten()) != NO_ERROR, "bad zoom accepted on retry");
+    app.set(CameraParameters::KEY_ZOOM, 9);
+    CHECK(set_parameters(params, app.flatten()) == NO_ERROR, "zoom after bad zoom failed");
+    CHECK(params.getInt(CameraParameters::KEY_ZOOM) == 9, "zoom %d",
+            params.getInt(CameraParameters::KEY_ZOOM));
+
+    /* a scene reported by ASD does not force the next zoom step through the full update */
+    params.set(QCameraParameters::KEY_SELECTED_AUTO_SCENE, "backlight");
+    app.set(CameraParameters::KEY_ZOOM, 8);
+    CHECK(set_parameters(params, app.flatten()) == NO_ERROR, "zoom after ASD update failed");
+    CHECK(!last_parms.is_valid[CAM_INTF_PARM_STATS_DEBUG_MASK],
+            "ASD update forced a full update");
+    app.set(QCameraParameters::KEY_SELECTED_AUTO_SCENE, "backlight");
+    app.set(CameraParameters::KEY_ZOOM, 9);
+    CHECK(set_parameters(params, app.flatten()) == NO_ERROR, "zoom with ASD scene failed");
+    CHECK(!last_parms.is_valid[CAM_INTF_PARM_STATS_DEBUG_MASK],
+            "echoed ASD scene forced a full update");
+
+    /* flatten follows every change */
+    String8 before = params.flatten();
+    params.set(CameraParameters::KEY_ZOOM, 10);
+    CHECK(params.flatten() != before, "flatten stale after set");
+    params.remove(CameraParameters::KEY_ZOOM);
+    CHECK(strstr(params.flatten().string(), "zoom=") == NULL, "flatten stale after remove");
+    params.set(CameraParameters::KEY_ZOOM, 9);
+}
+
+int main(int argc, char **argv)
+{
+    const char *trace_path = NULL;
+    int frames = 2000, rounds = 10;
+    int opt, i;
+
+    while ((opt = getopt(argc, argv, "t:f:n:")) != -1) {
+        switch (opt) {
+        case 't':
+            trace_path = optarg;
+            break;
+        case 'f':
+            frames = atoi(optarg);
+            break;
+        case 'n':
+            rounds = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-t trace file] [-f frames] [-n rounds]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (frames < 4)
+        frames = 4;
+    if (rounds < 1)
+        rounds = 1;
+
+    cam_capability_t *cap = (cam_capability_t *)malloc(sizeof(cam_capability_t));
+    mm_camera_ops_t ops;
+    mm_camera_vtbl_t vtbl;
+    fill_capability(cap);
+    memset(&ops, 0, sizeof(ops));
+    ops.map_buf = fake_map_buf;
+    ops.unmap_buf = fake_unmap_buf;
+    ops.set_parms = fake_set_parms;
+    ops.get_parms = fake_get_parms;
+    vtbl.camera_handle = 1;
+    vtbl.ops = &ops;
+
+    QCameraParameters *params = new QCameraParameters();
+    if (params->init(cap, &vtbl, NULL) != NO_ERROR) {
+        printf("QCameraParameters init failed\n");
+        return 1;
+    }
+
+    Vector<String8> trace;
+    if (trace_path != NULL) {
+        if (!load_trace(trace_path, trace) || trace.isEmpty()) {
+            printf("cannot read trace %s\n", trace_path);
+            return 1;
+        }
+    } else {
+        make_trace(*params, frames, trace);
+    }
+
+    test_updates(*params, trace);
+
+    struct timespec start, end;
+    long set_ns = 0, get_ns = 0;
+    int calls = 0;
+    for (int r = 0; r < rounds; r++) {
+        for (i = 0; i < (int)trace.size(); i++) {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            set_parameters(*params, trace[i]);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            set_ns += elapsed_ns(start, end);
+
+            /* the app reads the parameters back once in a while */
+            if (i % 8 == 0) {
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                String8 str = params->flatten();
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                get_ns += elapsed_ns(start, end);
+                calls++;
+            }
+        }
+    }
+    printf("%zu setParameters calls x %d: %ld ns per setParameters, "
+           "%ld ns per getParameters flatten\n",
+           trace.size(), rounds, set_ns / (long)(trace.size() * rounds),
+           get_ns / (calls > 0 ? calls : 1));
+
+    delete params;
+    free(cap);
+
+    printf("%s\n", failures == 0 ? "ALL PASSED" : "SOMETHING FAILED");
+    return failures == 0 ? 0 : 1;
+}
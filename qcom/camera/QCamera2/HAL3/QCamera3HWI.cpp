@@ -77,6 +77,12 @@ namespace qcamera {
 #define DEFAULT_VIDEO_FPS      (30.0)
 #define MAX_HFR_BATCH_SIZE     (4)
 #define REGIONS_TUPLE_COUNT    5
+/* Initial capacity of capture result metadata, the tonemap curves and the
+ * lens shading map make up most of the data */
+#define RESULT_METADATA_ENTRY_CAPACITY 128
+#define RESULT_METADATA_DATA_CAPACITY \
+        (3 * 2 * CAM_MAX_TONEMAP_CURVE_SIZE * sizeof(float) + \
+         4 * CAM_MAX_SHADING_MAP_WIDTH * CAM_MAX_SHADING_MAP_HEIGHT * sizeof(float) + 4096)
 
 #define METADATA_MAP_SIZE(MAP) (sizeof(MAP)/sizeof(MAP[0]))
 
@@ -336,7 +342,8 @@ QCamera3HardwareInterface::QCamera3HardwareInterface(uint32_t cameraId,
       mBatchSize(0),
       mToBeQueuedVidBufs(0),
       mHFRVideoFps(DEFAULT_VIDEO_FPS),
-      mOpMode(CAMERA3_STREAM_CONFIGURATION_NORMAL_MODE)
+      mOpMode(CAMERA3_STREAM_CONFIGURATION_NORMAL_MODE),
+      mResultMetadata(NULL)
 {
     getLogLevel();
     mCameraDevice.common.tag = HARDWARE_DEVICE_TAG;
@@ -466,6 +473,10 @@ QCamera3HardwareInterface::~QCamera3HardwareInterface()
     for (size_t i = 0; i < CAMERA3_TEMPLATE_COUNT; i++)
         if (mDefaultMetadata[i])
             free_camera_metadata(mDefaultMetadata[i]);
+    if (mResultMetadata) {
+        free_camera_metadata(mResultMetadata);
+        mResultMetadata = NULL;
+    }
 
     pthread_cond_destroy(&mRequestCond);
 
@@ -991,6 +1002,12 @@ int QCamera3HardwareInterface::configureStreams(
 
     pthread_mutex_lock(&mMutex);
 
+    /* Result metadata of the new configuration may need other capacities */
+    if (mResultMetadata) {
+        free_camera_metadata(mResultMetadata);
+        mResultMetadata = NULL;
+    }
+
     /* Check whether we have video stream */
     m_bIs4KVideo = false;
     m_bIsVideo = false;
@@ -2100,7 +2117,7 @@ void QCamera3HardwareInterface::handleMetadataWithLock(
                 mCallbackOps->process_capture_result(mCallbackOps, &result);
                 CDBG("%s: urgent frame_number = %u, capture_time = %lld",
                      __func__, result.frame_number, capture_time);
-                free_camera_metadata((camera_metadata_t *)result.result);
+                releaseResultMetadata((camera_metadata_t *)result.result);
                 break;
             }
         }
@@ -2182,7 +2199,7 @@ void QCamera3HardwareInterface::handleMetadataWithLock(
             CDBG("%s: Support notification !!!! notify frame_number = %u, capture_time = %llu",
                     __func__, i->frame_number, notify_msg.message.shutter.timestamp);
 
-            CameraMetadata dummyMetadata;
+            CameraMetadata dummyMetadata(acquireResultMetadata());
             dummyMetadata.update(ANDROID_SENSOR_TIMESTAMP,
                     &i->timestamp, 1);
             dummyMetadata.update(ANDROID_REQUEST_ID,
@@ -2292,13 +2309,13 @@ void QCamera3HardwareInterface::handleMetadataWithLock(
             mCallbackOps->process_capture_result(mCallbackOps, &result);
             CDBG("%s: meta frame_number = %u, capture_time = %lld",
                     __func__, result.frame_number, i->timestamp);
-            free_camera_metadata((camera_metadata_t *)result.result);
+            releaseResultMetadata((camera_metadata_t *)result.result);
             delete[] result_buffers;
         } else {
             mCallbackOps->process_capture_result(mCallbackOps, &result);
             CDBG("%s: meta frame_number = %u, capture_time = %lld",
                         __func__, result.frame_number, i->timestamp);
-            free_camera_metadata((camera_metadata_t *)result.result);
+            releaseResultMetadata((camera_metadata_t *)result.result);
         }
         // erase the element from the list
         clearInputBuffer(i->input_buffer);
@@ -3550,6 +3567,74 @@ void QCamera3HardwareInterface::clearInputBuffer(camera3_stream_buffer_t *input_
     }
 }
 
+/*===========================================================================
+ * FUNCTION   : acquireResultMetadata
+ *
+ * DESCRIPTION: get an empty metadata buffer for a capture result. The buffer
+ *              given back by the last releaseResultMetadata is cleared in
+ *              place and reused, so results of a stream configuration do
+ *              not allocate once the buffer has grown to what they need.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : camera_metadata_t*, owned by the caller
+ *              NULL on allocation failure
+ *==========================================================================*/
+camera_metadata_t* QCamera3HardwareInterface::acquireResultMetadata()
+{
+    camera_metadata_t *metadata = mResultMetadata;
+    mResultMetadata = NULL;
+
+    if (metadata != NULL) {
+        camera_metadata_t *placed = place_camera_metadata(metadata,
+                get_camera_metadata_size(metadata),
+                get_camera_metadata_entry_capacity(metadata),
+                get_camera_metadata_data_capacity(metadata));
+        if (placed == NULL) {
+            ALOGE("%s: Failed to reset result metadata", __func__);
+            free_camera_metadata(metadata);
+        }
+        metadata = placed;
+    }
+
+    if (metadata == NULL) {
+        metadata = allocate_camera_metadata(RESULT_METADATA_ENTRY_CAPACITY,
+                RESULT_METADATA_DATA_CAPACITY);
+    }
+    return metadata;
+}
+
+/*===========================================================================
+ * FUNCTION   : releaseResultMetadata
+ *
+ * DESCRIPTION: give back a capture result metadata buffer once the framework
+ *              has consumed it. The buffer is kept for the next result
+ *              instead of being freed.
+ *
+ * PARAMETERS :
+ *   @metadata : buffer returned by translateFromHalMetadata or
+ *               translateCbUrgentMetadataToResultMetadata
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera3HardwareInterface::releaseResultMetadata(camera_metadata_t *metadata)
+{
+    if (metadata == NULL) {
+        return;
+    }
+
+    // Keep the larger buffer, CameraMetadata may have grown this one
+    if (mResultMetadata != NULL) {
+        if (get_camera_metadata_size(mResultMetadata) >=
+                get_camera_metadata_size(metadata)) {
+            free_camera_metadata(metadata);
+            return;
+        }
+        free_camera_metadata(mResultMetadata);
+    }
+    mResultMetadata = metadata;
+}
+
 /*===========================================================================
  *
  * DESCRIPTION:
@@ -3572,7 +3657,7 @@ QCamera3HardwareInterface::translateFromHalMetadata(
                                  uint8_t pipeline_depth,
                                  uint8_t capture_intent)
 {
-    CameraMetadata camMetadata;
+    CameraMetadata camMetadata(acquireResultMetadata());
     camera_metadata_t *resultMetadata;
 
     if (jpegMetadata.entryCount())
@@ -4306,7 +4391,7 @@ camera_metadata_t*
 QCamera3HardwareInterface::translateCbUrgentMetadataToResultMetadata
                                 (metadata_buffer_t *metadata)
 {
-    CameraMetadata camMetadata;
+    CameraMetadata camMetadata(acquireResultMetadata());
     camera_metadata_t *resultMetadata;
 
     IF_META_AVAILABLE(uint32_t, afState, CAM_INTF_META_AF_STATE, metadata) {
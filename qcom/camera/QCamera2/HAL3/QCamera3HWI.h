@@ -239,6 +239,10 @@ private:
     void updatePowerHint(bool bWasVideo, bool bIsVideo);
     int32_t getSensorOutputSize(cam_dimension_t &sensor_dim);
     void clearInputBuffer(camera3_stream_buffer_t *input_buffer);
+    camera_metadata_t *acquireResultMetadata();
+    void releaseResultMetadata(camera_metadata_t *metadata);
+    // test/qcamera3_result_metadata_benchmark.cpp
+    friend class QCamera3ResultMetadataBenchmark;
 
     camera3_device_t   mCameraDevice;
     uint32_t           mCameraId;
@@ -355,6 +359,9 @@ private:
     float mHFRVideoFps;
     cam_stream_ID_t mBatchStreamID;
     uint8_t mOpMode;
+    // result metadata buffer handed back after the last capture result,
+    // reused for the next one within a stream configuration
+    camera_metadata_t *mResultMetadata;
 
     /* sensor output size with current stream configuration */
     QCamera3CropRegionMapper mCropRegionMapper;
@@ -0,0 +1,46 @@
+# Not part of the default build; build it with
+# QCAMERA_BUILD_BENCHMARKS=true make qcamera3_result_metadata_benchmark
+ifeq ($(QCAMERA_BUILD_BENCHMARKS),true)
+
+LOCAL_PATH := $(call my-dir)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+        qcamera3_result_metadata_benchmark.cpp \
+        ../QCamera3HWI.cpp \
+        ../QCamera3Mem.cpp \
+        ../QCamera3Stream.cpp \
+        ../QCamera3Channel.cpp \
+        ../QCamera3VendorTags.cpp \
+        ../QCamera3PostProc.cpp \
+        ../QCamera3CropRegionMapper.cpp \
+        ../../util/QCameraCmdThread.cpp \
+        ../../util/QCameraQueue.cpp
+
+LOCAL_MODULE := qcamera3_result_metadata_benchmark
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_C_INCLUDES := \
+        $(LOCAL_PATH)/.. \
+        $(LOCAL_PATH)/../../stack/common \
+        $(LOCAL_PATH)/../../util \
+        $(LOCAL_PATH)/../../../mm-image-codec/qexif \
+        $(LOCAL_PATH)/../../../mm-image-codec/qomx_core \
+        frameworks/native/include/media/hardware \
+        frameworks/native/include/media/openmax \
+        hardware/qcom/media/libstagefrighthw \
+        system/media/camera/include \
+        $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include \
+        $(TARGET_OUT_HEADERS)/qcom/display
+
+LOCAL_CFLAGS := -Wall -Wextra -Werror -O2
+LOCAL_CFLAGS += -DHAS_MULTIMEDIA_HINTS -DHAL3
+
+LOCAL_SHARED_LIBRARIES := libcamera_client liblog libhardware libutils libcutils libdl
+LOCAL_SHARED_LIBRARIES += libmmcamera_interface libmmjpeg_interface libui libcamera_metadata
+LOCAL_SHARED_LIBRARIES += libqdMetaData
+
+LOCAL_32_BIT_ONLY := $(BOARD_QTI_CAMERA_32BIT_ONLY)
+include $(BUILD_EXECUTABLE)
+endif
@@ -0,0 +1,235 @@
+/* Copyright (c) 2016, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <camera/CameraMetadata.h>
+#include "QCamera3HWI.h"
+
+using namespace android;
+using namespace qcamera;
+
+namespace qcamera {
+extern cam_capability_t *gCamCapability[MM_CAMERA_MAX_NUM_SENSORS];
+
+/* reaches the result metadata cache, which is private to the HAL */
+class QCamera3ResultMetadataBenchmark {
+public:
+    static void release(QCamera3HardwareInterface &hw, camera_metadata_t *metadata)
+    {
+        hw.releaseResultMetadata(metadata);
+    }
+
+    /* drop the cached buffer so the next result is allocated, as before the cache */
+    static void drain(QCamera3HardwareInterface &hw)
+    {
+        if (hw.mResultMetadata != NULL) {
+            free_camera_metadata(hw.mResultMetadata);
+            hw.mResultMetadata = NULL;
+        }
+    }
+};
+}
+
+/*
+ * Translates a stream of synthetic backend metadata into capture result
+ * metadata the way handleMetadataWithLock does, once freeing every result
+ * with the cache emptied before each frame and once handing it back with
+ * releaseResultMetadata, checks that the buffer is recycled without stale
+ * entries and times both. The first pass allocates the result at its
+ * initial capacity, so it does not count the growth of a default
+ * constructed CameraMetadata and understates the old cost.
+ *
+ * Run it like this:
+ *
+ * QCAMERA_BUILD_BENCHMARKS=true make qcamera3_result_metadata_benchmark -j32 && \
+ * adb push $OUT/system/bin/qcamera3_result_metadata_benchmark /data/local/tmp && \
+ * adb shell /data/local/tmp/qcamera3_result_metadata_benchmark -f 5000
+ */
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAILED %s:%d: ", __func__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            failures++; \
+        } \
+    } while (0)
+
+static void fill_metadata(metadata_buffer_t *meta, uint32_t frame)
+{
+    clear_metadata_buffer(meta);
+
+    ADD_SET_PARAM_ENTRY_TO_BATCH(meta, CAM_INTF_META_FRAME_NUMBER, frame);
+    ADD_SET_PARAM_ENTRY_TO_BATCH(meta, CAM_INTF_META_SENSOR_EXPOSURE_TIME,
+            (int64_t)(10000000 + (frame % 16) * 1000));
+    ADD_SET_PARAM_ENTRY_TO_BATCH(meta, CAM_INTF_META_SENSOR_SENSITIVITY,
+            (int32_t)(100 + (frame % 8) * 50));
+    ADD_SET_PARAM_ENTRY_TO_BATCH(meta, CAM_INTF_META_LENS_FOCUS_DISTANCE,
+            (float)(frame % 10) / 10.0f);
+    ADD_SET_PARAM_ENTRY_TO_BATCH(meta, CAM_INTF_META_AEC_STATE,
+            (uint32_t)CAM_AE_STATE_CONVERGED);
+
+    /* faces come and go every few frames */
+    if ((frame / 4) % 2 == 0) {
+        cam_face_detection_data_t faces;
+        memset(&faces, 0, sizeof(faces));
+        faces.num_faces_detected = 2;
+        for (uint8_t i = 0; i < faces.num_faces_detected; i++) {
+            faces.faces[i].face_id = i + 1;
+            faces.faces[i].score = 90;
+            faces.faces[i].face_boundary.left = 100 * (i + 1);
+            faces.faces[i].face_boundary.top = 100;
+            faces.faces[i].face_boundary.width = 200;
+            faces.faces[i].face_boundary.height = 200;
+        }
+        ADD_SET_PARAM_ENTRY_TO_BATCH(meta, CAM_INTF_META_FACE_DETECTION, faces);
+    }
+}
+
+static long elapsed_ns(const struct timespec &start, const struct timespec &end)
+{
+    return (end.tv_sec - start.tv_sec) * 1000000000L + (end.tv_nsec - start.tv_nsec);
+}
+
+static void test_recycle(QCamera3HardwareInterface &hw, metadata_buffer_t *meta)
+{
+    CameraMetadata jpegMetadata;
+    camera_metadata_t *prev = NULL;
+
+    for (uint32_t frame = 0; frame < 16; frame++) {
+        fill_metadata(meta, frame);
+        camera_metadata_t *result = hw.translateFromHalMetadata(meta,
+                (nsecs_t)frame * 33000000, (int32_t)frame, jpegMetadata, 4,
+                ANDROID_CONTROL_CAPTURE_INTENT_PREVIEW);
+        CHECK(result != NULL, "no result for frame %u", frame);
+        if (result == NULL)
+            return;
+
+        if (frame > 1)
+            CHECK(result == prev, "frame %u did not reuse the result buffer", frame);
+
+        camera_metadata_ro_entry_t entry;
+        CHECK(find_camera_metadata_ro_entry(result, ANDROID_SENSOR_TIMESTAMP, &entry) == 0 &&
+                entry.count == 1 && entry.data.i64[0] == (int64_t)frame * 33000000,
+                "wrong timestamp for frame %u", frame);
+        CHECK(find_camera_metadata_ro_entry(result, ANDROID_REQUEST_ID, &entry) == 0 &&
+                entry.count == 1 && entry.data.i32[0] == (int32_t)frame,
+                "wrong request id for frame %u", frame);
+
+        bool hasFaces = (frame / 4) % 2 == 0;
+        int rc = find_camera_metadata_ro_entry(result, ANDROID_STATISTICS_FACE_IDS, &entry);
+        if (hasFaces)
+            CHECK(rc == 0 && entry.count == 2, "faces missing for frame %u", frame);
+        else
+            CHECK(rc != 0, "stale faces in frame %u", frame);
+
+        QCamera3ResultMetadataBenchmark::release(hw, result);
+        prev = result;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int frames = 2000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:")) != -1) {
+        switch (opt) {
+        case 'f':
+            frames = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-f frames]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (frames < 1)
+        frames = 1;
+
+    cam_capability_t *cap = (cam_capability_t *)calloc(1, sizeof(cam_capability_t));
+    metadata_buffer_t *meta = (metadata_buffer_t *)malloc(sizeof(metadata_buffer_t));
+    if (cap == NULL || meta == NULL) {
+        printf("out of memory\n");
+        return 1;
+    }
+    cap->num_color_channels = 4;
+    cap->active_array_size.width = 4000;
+    cap->active_array_size.height = 3000;
+    gCamCapability[0] = cap;
+
+    QCamera3HardwareInterface *hw = new QCamera3HardwareInterface(0, NULL);
+
+    test_recycle(*hw, meta);
+
+    CameraMetadata jpegMetadata;
+    struct timespec start, end;
+    long free_ns = 0, recycle_ns = 0;
+
+    /* every result allocated and freed */
+    for (int i = 0; i < frames; i++) {
+        fill_metadata(meta, (uint32_t)i);
+        QCamera3ResultMetadataBenchmark::drain(*hw);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        camera_metadata_t *result = hw->translateFromHalMetadata(meta, i, i,
+                jpegMetadata, 4, ANDROID_CONTROL_CAPTURE_INTENT_PREVIEW);
+        free_camera_metadata(result);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        free_ns += elapsed_ns(start, end);
+    }
+
+    /* every result handed back and reused */
+    for (int i = 0; i < frames; i++) {
+        fill_metadata(meta, (uint32_t)i);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        camera_metadata_t *result = hw->translateFromHalMetadata(meta, i, i,
+                jpegMetadata, 4, ANDROID_CONTROL_CAPTURE_INTENT_PREVIEW);
+        QCamera3ResultMetadataBenchmark::release(*hw, result);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        recycle_ns += elapsed_ns(start, end);
+    }
+    printf("%d results: %ld ns per result when freed, %ld ns per result when recycled\n",
+           frames, free_ns / frames, recycle_ns / frames);
+
+    delete hw;
+    gCamCapability[0] = NULL;
+    free(meta);
+    free(cap);
+
+    printf("%s\n", failures == 0 ? "ALL PASSED" : "SOMETHING FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -29,6 +29,10 @@
 
 #include "cam_list.h"
 
+/* nodes each queue allocates up front, and the most it keeps for reuse */
+#define CAM_QUEUE_PREALLOC_NODES 8
+#define CAM_QUEUE_MAX_FREE_NODES 64
+
 typedef struct {
     struct cam_list list;
     void *data;
@@ -38,28 +42,71 @@ typedef struct {
     cam_node_t head; /* dummy head */
     uint32_t size;
     pthread_mutex_t lock;
+    struct cam_list free_nodes; /* dequeued nodes kept for the next enqueue */
+    uint32_t free_size;
 } cam_queue_t;
 
+/* Takes a node to enqueue from the free nodes, allocating one only when there
+ * are none. queue->lock must be held. */
+static inline cam_node_t *cam_queue_get_node(cam_queue_t *queue)
+{
+    cam_node_t *node = NULL;
+
+    if (queue->free_nodes.next != &queue->free_nodes) {
+        node = member_of(queue->free_nodes.next, cam_node_t, list);
+        cam_list_del_node(&node->list);
+        queue->free_size--;
+    } else {
+        node = (cam_node_t *)malloc(sizeof(cam_node_t));
+        if (NULL == node) {
+            return NULL;
+        }
+        cam_list_init(&node->list);
+    }
+    node->data = NULL;
+    return node;
+}
+
+/* Gives back a node no longer in the queue. queue->lock must be held. */
+static inline void cam_queue_put_node(cam_queue_t *queue, cam_node_t *node)
+{
+    if (queue->free_size < CAM_QUEUE_MAX_FREE_NODES) {
+        cam_list_insert_before_node(&node->list, queue->free_nodes.next);
+        queue->free_size++;
+    } else {
+        free(node);
+    }
+}
+
 static inline int32_t cam_queue_init(cam_queue_t *queue)
 {
     pthread_mutex_init(&queue->lock, NULL);
     cam_list_init(&queue->head.list);
     queue->size = 0;
+    cam_list_init(&queue->free_nodes);
+    queue->free_size = 0;
+    while (queue->free_size < CAM_QUEUE_PREALLOC_NODES) {
+        cam_node_t *node = (cam_node_t *)malloc(sizeof(cam_node_t));
+        if (NULL == node) {
+            break;
+        }
+        cam_list_add_tail_node(&node->list, &queue->free_nodes);
+        queue->free_size++;
+    }
     return 0;
 }
 
 static inline int32_t cam_queue_enq(cam_queue_t *queue, void *data)
 {
-    cam_node_t *node =
-        (cam_node_t *)malloc(sizeof(cam_node_t));
+    cam_node_t *node = NULL;
+
+    pthread_mutex_lock(&queue->lock);
+    node = cam_queue_get_node(queue);
     if (NULL == node) {
+        pthread_mutex_unlock(&queue->lock);
         return -1;
     }
-
-    memset(node, 0, sizeof(cam_node_t));
     node->data = data;
-
-    pthread_mutex_lock(&queue->lock);
     cam_list_add_tail_node(&node->list, &queue->head.list);
     queue->size++;
     pthread_mutex_unlock(&queue->lock);
@@ -81,13 +128,10 @@ static inline void *cam_queue_deq(cam_queue_t *queue)
         node = member_of(pos, cam_node_t, list);
         cam_list_del_node(&node->list);
         queue->size--;
-    }
-    pthread_mutex_unlock(&queue->lock);
-
-    if (NULL != node) {
         data = node->data;
-        free(node);
+        cam_queue_put_node(queue, node);
     }
+    pthread_mutex_unlock(&queue->lock);
 
     return data;
 }
@@ -114,7 +158,7 @@ static inline int32_t cam_queue_flush(cam_queue_t *queue)
         if (NULL != node->data) {
             free(node->data);
         }
-        free(node);
+        cam_queue_put_node(queue, node);
 
     }
     queue->size = 0;
@@ -125,6 +169,12 @@ static inline int32_t cam_queue_flush(cam_queue_t *queue)
 static inline int32_t cam_queue_deinit(cam_queue_t *queue)
 {
     cam_queue_flush(queue);
+    while (queue->free_nodes.next != &queue->free_nodes) {
+        cam_node_t *node = member_of(queue->free_nodes.next, cam_node_t, list);
+        cam_list_del_node(&node->list);
+        free(node);
+    }
+    queue->free_size = 0;
     pthread_mutex_destroy(&queue->lock);
     return 0;
 }
@@ -151,17 +151,23 @@ typedef struct {
 
 typedef struct {
     mm_camera_poll_thread_type_t poll_type;
-    /* array to store poll fd and cb info
+    /* array to store poll fd and cb info, guarded by mutex
      * for MM_CAMERA_POLL_TYPE_EVT, only index 0 is valid;
      * for MM_CAMERA_POLL_TYPE_DATA, depends on valid stream fd */
     mm_camera_poll_entry_t poll_entries[MAX_STREAM_NUM_IN_BUNDLE];
-    int32_t pfds[2];
+    /* the entries registered with epoll, owned by the poll thread */
+    mm_camera_poll_entry_t active_entries[MAX_STREAM_NUM_IN_BUNDLE];
+    int32_t epoll_fd;
+    int32_t wake_fd;           /* eventfd waking the poll thread */
     pthread_t pid;
     int32_t state;
     int timeoutms;
     uint32_t cmd;
-    struct pollfd poll_fds[MAX_STREAM_NUM_IN_BUNDLE + 1];
-    uint8_t num_fds;
+    uint32_t updated_entries;  /* bit per poll_entries index not yet applied */
+    uint32_t update_seq;       /* counts entry updates */
+    uint32_t applied_seq;      /* update_seq the poll thread has applied */
+    uint8_t wake_pending;      /* wake_fd written since the last apply */
+    uint8_t hold_count;        /* async updates wait for commit while > 0 */
     pthread_mutex_t mutex;
     pthread_cond_t cond_v;
     int32_t status;
@@ -351,8 +357,14 @@ typedef struct {
     uint8_t matched;
     uint8_t expected;
     uint32_t frame_idx;
+    /* while not matched: link in the queue's unmatched list */
+    struct cam_list unmatched;
+    cam_node_t *node;  /* the superbuf queue node holding it */
 } mm_channel_queue_node_t;
 
+/* slots indexing unmatched superbufs by frame_idx, a power of 2 */
+#define MM_CHANNEL_FRAME_SLOTS 32
+
 typedef struct {
     cam_queue_t que;
     uint8_t num_streams;
@@ -368,6 +380,13 @@ typedef struct {
     uint32_t once;
     uint32_t frame_skip_count;
     uint32_t nomatch_frame_id;
+    /* unmatched superbufs in queue order, which is frame order */
+    struct cam_list unmatched;
+    uint32_t unmatched_cnt;
+    /* unmatched superbufs by frame_idx % MM_CHANNEL_FRAME_SLOTS */
+    mm_channel_queue_node_t *frame_slots[MM_CHANNEL_FRAME_SLOTS];
+    /* unmatched superbufs not in frame_slots as their slot was taken */
+    uint32_t unindexed_cnt;
 } mm_channel_queue_t;
 
 typedef struct {
@@ -677,6 +696,8 @@ extern int32_t mm_camera_poll_thread_del_poll_fd(
                                 mm_camera_poll_thread_t * poll_cb,
                                 uint32_t handler,
                                 mm_camera_call_type_t);
+extern int32_t mm_camera_poll_thread_hold_updates(
+        mm_camera_poll_thread_t * poll_cb);
 extern int32_t mm_camera_poll_thread_commit_updates(
         mm_camera_poll_thread_t * poll_cb);
 extern int32_t mm_camera_cmd_thread_launch(
@@ -1305,6 +1305,10 @@ int32_t mm_channel_start(mm_channel_t *my_obj)
         }
     }
 
+    /* streams add their fds to data poll thread when they queue their
+     * first buffer, hold the adds and apply them in one update */
+    mm_camera_poll_thread_hold_updates(&my_obj->poll_thread[0]);
+
     for (i = 0; i < num_streams_to_start; i++) {
         if (s_objs[i]->ch_obj != my_obj) {
             continue;
@@ -1347,6 +1351,8 @@ int32_t mm_channel_start(mm_channel_t *my_obj)
         }
     }
 
+    mm_camera_poll_thread_commit_updates(&my_obj->poll_thread[0]);
+
     /* error handling */
     if (0 != rc) {
         /* unlink the streams first */
@@ -1454,6 +1460,18 @@ int32_t mm_channel_stop(mm_channel_t *my_obj)
         s_objs[meta_stream_idx] = s_obj;
     }
 
+    /* remove all stream fds from data poll thread in one update, so that
+     * stream off does not wait for the poll thread once per stream */
+    for (i = 0; i < num_streams_to_stop; i++) {
+        if (s_objs[i]->ch_obj != my_obj) {
+            continue;
+        }
+        mm_camera_poll_thread_del_poll_fd(&my_obj->poll_thread[0],
+                                          s_objs[i]->my_hdl,
+                                          mm_camera_async_call);
+    }
+    mm_camera_poll_thread_commit_updates(&my_obj->poll_thread[0]);
+
     for (i = 0; i < num_streams_to_stop; i++) {
         /* stream that are linked to this channel should not be stopped */
         if (s_objs[i]->ch_obj != my_obj) {
@@ -2004,6 +2022,10 @@ int32_t mm_channel_unmap_stream_buf(mm_channel_t *my_obj,
  *==========================================================================*/
 int32_t mm_channel_superbuf_queue_init(mm_channel_queue_t * queue)
 {
+    cam_list_init(&queue->unmatched);
+    queue->unmatched_cnt = 0;
+    queue->unindexed_cnt = 0;
+    memset(queue->frame_slots, 0, sizeof(queue->frame_slots));
     return cam_queue_init(&queue->que);
 }
 
@@ -2282,6 +2304,130 @@ end:
     return rc;
 }
 
+/*===========================================================================
+ * FUNCTION   : mm_channel_superbuf_track
+ *
+ * DESCRIPTION: add an unmatched superbuf to the unmatched list and index it
+ *              by frame_idx. queue->que.lock must be held.
+ *
+ * PARAMETERS :
+ *   @queue    : superbuf queue
+ *   @super_buf: unmatched superbuf, already in the queue
+ *   @before   : unmatched superbuf it was queued before, NULL if last
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static void mm_channel_superbuf_track(mm_channel_queue_t *queue,
+                                      mm_channel_queue_node_t *super_buf,
+                                      mm_channel_queue_node_t *before)
+{
+    mm_channel_queue_node_t **slot =
+        &queue->frame_slots[super_buf->frame_idx % MM_CHANNEL_FRAME_SLOTS];
+
+    cam_list_insert_before_node(&super_buf->unmatched,
+            (NULL != before) ? &before->unmatched : &queue->unmatched);
+    queue->unmatched_cnt++;
+    if (NULL == *slot) {
+        *slot = super_buf;
+    } else {
+        queue->unindexed_cnt++;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_channel_superbuf_untrack
+ *
+ * DESCRIPTION: remove a superbuf that got matched or is leaving the queue
+ *              from the unmatched list and index. queue->que.lock must be
+ *              held.
+ *
+ * PARAMETERS :
+ *   @queue    : superbuf queue
+ *   @super_buf: unmatched superbuf
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static void mm_channel_superbuf_untrack(mm_channel_queue_t *queue,
+                                        mm_channel_queue_node_t *super_buf)
+{
+    mm_channel_queue_node_t **slot =
+        &queue->frame_slots[super_buf->frame_idx % MM_CHANNEL_FRAME_SLOTS];
+
+    cam_list_del_node(&super_buf->unmatched);
+    queue->unmatched_cnt--;
+    if (*slot == super_buf) {
+        *slot = NULL;
+    } else {
+        queue->unindexed_cnt--;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_channel_superbuf_drop_unmatched
+ *
+ * DESCRIPTION: return the buffers of an unmatched superbuf to the kernel and
+ *              remove it from the queue. queue->que.lock must be held.
+ *
+ * PARAMETERS :
+ *   @ch_obj   : channel object
+ *   @queue    : superbuf queue
+ *   @super_buf: unmatched superbuf
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static void mm_channel_superbuf_drop_unmatched(mm_channel_t *ch_obj,
+                                               mm_channel_queue_t *queue,
+                                               mm_channel_queue_node_t *super_buf)
+{
+    cam_node_t *node = super_buf->node;
+    uint8_t i;
+
+    for (i = 0; i < super_buf->num_of_bufs; i++) {
+        if (super_buf->super_buf[i].frame_idx != 0) {
+            mm_channel_qbuf(ch_obj, super_buf->super_buf[i].buf);
+        }
+    }
+    mm_channel_superbuf_untrack(queue, super_buf);
+    queue->que.size--;
+    cam_list_del_node(&node->list);
+    cam_queue_put_node(&queue->que, node);
+    free(super_buf);
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_channel_superbuf_first_newer
+ *
+ * DESCRIPTION: find the oldest unmatched superbuf newer than a frame.
+ *              queue->que.lock must be held.
+ *
+ * PARAMETERS :
+ *   @queue    : superbuf queue
+ *   @frame_idx: frame index
+ *
+ * RETURN     : ptr to the unmatched superbuf, NULL if none is newer
+ *==========================================================================*/
+static mm_channel_queue_node_t *mm_channel_superbuf_first_newer(
+                        mm_channel_queue_t *queue,
+                        uint32_t frame_idx)
+{
+    struct cam_list *pos = queue->unmatched.prev;
+    mm_channel_queue_node_t *super_buf = NULL;
+
+    /* frames mostly come in order, then the newest unmatched one is older */
+    if ((pos == &queue->unmatched) ||
+            (member_of(pos, mm_channel_queue_node_t, unmatched)->frame_idx
+            < frame_idx)) {
+        return NULL;
+    }
+    for (pos = queue->unmatched.next; pos != &queue->unmatched; pos = pos->next) {
+        super_buf = member_of(pos, mm_channel_queue_node_t, unmatched);
+        if (super_buf->frame_idx > frame_idx) {
+            return super_buf;
+        }
+    }
+    return NULL;
+}
+
 /*===========================================================================
  * FUNCTION   : mm_channel_superbuf_comp_and_enqueue
  *
@@ -2301,12 +2447,11 @@ int32_t mm_channel_superbuf_comp_and_enqueue(
                         mm_channel_queue_t *queue,
                         mm_camera_buf_info_t *buf_info)
 {
-    cam_node_t* node = NULL;
-    struct cam_list *head = NULL;
     struct cam_list *pos = NULL;
     mm_channel_queue_node_t* super_buf = NULL;
-    uint8_t buf_s_idx, i, found_super_buf, unmatched_bundles;
-    struct cam_list *last_buf, *insert_before_buf, *last_buf_ptr;
+    uint8_t buf_s_idx, i, found_super_buf;
+    uint32_t unmatched_bundles;
+    mm_channel_queue_node_t *last_buf, *insert_before_buf;
 
     CDBG("%s: E", __func__);
 
@@ -2348,26 +2493,23 @@ int32_t mm_channel_superbuf_comp_and_enqueue(
 
     /* comp */
     pthread_mutex_lock(&queue->que.lock);
-    head = &queue->que.head.list;
-    /* get the last one in the queue which is possibly having no matching */
-    pos = head->next;
 
     found_super_buf = 0;
     unmatched_bundles = 0;
     last_buf = NULL;
     insert_before_buf = NULL;
-    last_buf_ptr = NULL;
-
-    while (pos != head) {
-        node = member_of(pos, cam_node_t, list);
-        super_buf = (mm_channel_queue_node_t*)node->data;
 
-        if (NULL != super_buf) {
-            if (super_buf->matched) {
-                /* find a matched super buf, move to next one */
-                pos = pos->next;
-                continue;
-            } else if ( buf_info->frame_idx == super_buf->frame_idx
+    if (((queue->nomatch_frame_id != 0)
+            && (buf_info->buf->stream_type == CAM_STREAM_TYPE_METADATA))
+            || ((queue->attr.priority == MM_CAMERA_SUPER_BUF_PRIORITY_LOW)
+            && (buf_info->buf->stream_type != CAM_STREAM_TYPE_METADATA))
+            || (queue->unindexed_cnt != 0)) {
+        /* the buf may go to a super buf of another frame, or its own may not
+         * be indexed: look through the unmatched super bufs */
+        pos = queue->unmatched.next;
+        while (pos != &queue->unmatched) {
+            super_buf = member_of(pos, mm_channel_queue_node_t, unmatched);
+            if ( buf_info->frame_idx == super_buf->frame_idx
                     /*Pick metadata greater than available frameID*/
                     || ((queue->nomatch_frame_id != 0)
                     && (queue->nomatch_frame_id <= buf_info->frame_idx)
@@ -2384,19 +2526,37 @@ int32_t mm_channel_superbuf_comp_and_enqueue(
                 found_super_buf = 1;
                 queue->nomatch_frame_id = 0;
                 break;
-            } else {
-                unmatched_bundles++;
-                if ( NULL == last_buf ) {
-                    if ( super_buf->frame_idx < buf_info->frame_idx ) {
-                        last_buf = pos;
-                    }
+            }
+            unmatched_bundles++;
+            if ( NULL == last_buf ) {
+                if ( super_buf->frame_idx < buf_info->frame_idx ) {
+                    last_buf = super_buf;
                 }
-                if ( NULL == insert_before_buf ) {
-                    if ( super_buf->frame_idx > buf_info->frame_idx ) {
-                        insert_before_buf = pos;
-                    }
+            }
+            if ( NULL == insert_before_buf ) {
+                if ( super_buf->frame_idx > buf_info->frame_idx ) {
+                    insert_before_buf = super_buf;
                 }
-                pos = pos->next;
+            }
+            pos = pos->next;
+        }
+    } else {
+        /* only the super buf of the same frame can take it */
+        super_buf = queue->frame_slots[buf_info->frame_idx % MM_CHANNEL_FRAME_SLOTS];
+        if ((NULL != super_buf) && (super_buf->frame_idx == buf_info->frame_idx)) {
+            found_super_buf = 1;
+            queue->nomatch_frame_id = 0;
+        } else {
+            unmatched_bundles = queue->unmatched_cnt;
+            insert_before_buf = mm_channel_superbuf_first_newer(queue,
+                    buf_info->frame_idx);
+        }
+        /* unmatched super bufs are in frame order, the first is the oldest */
+        if (queue->unmatched.next != &queue->unmatched) {
+            last_buf = member_of(queue->unmatched.next,
+                    mm_channel_queue_node_t, unmatched);
+            if (last_buf->frame_idx >= buf_info->frame_idx) {
+                last_buf = NULL;
             }
         }
     }
@@ -2447,26 +2607,13 @@ int32_t mm_channel_superbuf_comp_and_enqueue(
 
             /* Any older unmatched buffer need to be released */
             if ( last_buf ) {
-                while ( last_buf != pos ) {
-                    node = member_of(last_buf, cam_node_t, list);
-                    super_buf = (mm_channel_queue_node_t*)node->data;
-                    if (NULL != super_buf) {
-                        for (i=0; i<super_buf->num_of_bufs; i++) {
-                            if (super_buf->super_buf[i].frame_idx != 0) {
-                                mm_channel_qbuf(ch_obj, super_buf->super_buf[i].buf);
-                            }
-                        }
-                        queue->que.size--;
-                        last_buf = last_buf->next;
-                        cam_list_del_node(&node->list);
-                        free(node);
-                        free(super_buf);
-                    } else {
-                        CDBG_ERROR(" %s : Invalid superbuf in queue!", __func__);
-                        break;
-                    }
+                while (queue->unmatched.next != &super_buf->unmatched) {
+                    mm_channel_superbuf_drop_unmatched(ch_obj, queue,
+                            member_of(queue->unmatched.next,
+                            mm_channel_queue_node_t, unmatched));
                 }
             }
+            mm_channel_superbuf_untrack(queue, super_buf);
         }else {
             if (ch_obj->diverted_frame_id == buf_info->frame_idx) {
                 super_buf->expected = TRUE;
@@ -2479,41 +2626,26 @@ int32_t mm_channel_superbuf_comp_and_enqueue(
             /* incoming frame is older than the last bundled one */
             mm_channel_qbuf(ch_obj, buf_info->buf);
         } else {
-            last_buf_ptr = last_buf;
-
             /* Loop to remove unmatched frames */
+            pos = (NULL != last_buf) ? &last_buf->unmatched : &queue->unmatched;
             while ((queue->attr.max_unmatched_frames < unmatched_bundles)
-                    && (last_buf_ptr != NULL && last_buf_ptr != pos)) {
-                node = member_of(last_buf_ptr, cam_node_t, list);
-                super_buf = (mm_channel_queue_node_t*)node->data;
-                if (NULL != super_buf && super_buf->expected == FALSE
-                        && (&node->list != insert_before_buf)) {
-                    for (i=0; i<super_buf->num_of_bufs; i++) {
-                        if (super_buf->super_buf[i].frame_idx != 0) {
-                            mm_channel_qbuf(ch_obj, super_buf->super_buf[i].buf);
-                        }
+                    && (pos != &queue->unmatched)) {
+                super_buf = member_of(pos, mm_channel_queue_node_t, unmatched);
+                /* step past the super buf first, it may be freed */
+                pos = pos->next;
+                if (super_buf->expected == FALSE
+                        && super_buf != insert_before_buf) {
+                    if (super_buf == last_buf) {
+                        last_buf = NULL;
                     }
-                    queue->que.size--;
-                    cam_list_del_node(&node->list);
-                    free(node);
-                    free(super_buf);
+                    mm_channel_superbuf_drop_unmatched(ch_obj, queue, super_buf);
                     unmatched_bundles--;
                 }
-                last_buf_ptr = last_buf_ptr->next;
             }
 
-            if (queue->attr.max_unmatched_frames < unmatched_bundles) {
-                node = member_of(last_buf, cam_node_t, list);
-                super_buf = (mm_channel_queue_node_t*)node->data;
-                for (i=0; i<super_buf->num_of_bufs; i++) {
-                    if (super_buf->super_buf[i].frame_idx != 0) {
-                        mm_channel_qbuf(ch_obj, super_buf->super_buf[i].buf);
-                    }
-                }
-                queue->que.size--;
-                cam_list_del_node(&node->list);
-                free(node);
-                free(super_buf);
+            if ((queue->attr.max_unmatched_frames < unmatched_bundles)
+                    && (NULL != last_buf)) {
+                mm_channel_superbuf_drop_unmatched(ch_obj, queue, last_buf);
             }
 
             /* insert the new frame at the appropriate position. */
@@ -2522,11 +2654,11 @@ int32_t mm_channel_superbuf_comp_and_enqueue(
             cam_node_t* new_node = NULL;
 
             new_buf = (mm_channel_queue_node_t*)malloc(sizeof(mm_channel_queue_node_t));
-            new_node = (cam_node_t*)malloc(sizeof(cam_node_t));
+            new_node = cam_queue_get_node(&queue->que);
             if (NULL != new_buf && NULL != new_node) {
                 memset(new_buf, 0, sizeof(mm_channel_queue_node_t));
-                memset(new_node, 0, sizeof(cam_node_t));
                 new_node->data = (void *)new_buf;
+                new_buf->node = new_node;
                 new_buf->num_of_bufs = queue->num_streams;
                 new_buf->super_buf[buf_s_idx] = *buf_info;
                 new_buf->frame_idx = buf_info->frame_idx;
@@ -2538,7 +2670,8 @@ int32_t mm_channel_superbuf_comp_and_enqueue(
 
                 /* enqueue */
                 if ( insert_before_buf ) {
-                    cam_list_insert_before_node(&new_node->list, insert_before_buf);
+                    cam_list_insert_before_node(&new_node->list,
+                            &insert_before_buf->node->list);
                 } else {
                     cam_list_add_tail_node(&new_node->list, &queue->que.head.list);
                 }
@@ -2549,6 +2682,8 @@ int32_t mm_channel_superbuf_comp_and_enqueue(
                     new_buf->expected = FALSE;
                     queue->expected_frame_id = buf_info->frame_idx + queue->attr.post_frame_skip;
                     queue->match_cnt++;
+                } else {
+                    mm_channel_superbuf_track(queue, new_buf, insert_before_buf);
                 }
 
                 if ((queue->attr.priority == MM_CAMERA_SUPER_BUF_PRIORITY_LOW)
@@ -2563,7 +2698,7 @@ int32_t mm_channel_superbuf_comp_and_enqueue(
                     free(new_buf);
                 }
                 if (NULL != new_node) {
-                    free(new_node);
+                    cam_queue_put_node(&queue->que, new_node);
                 }
                 /* qbuf the new buf since we cannot enqueue */
                 mm_channel_qbuf(ch_obj, buf_info->buf);
@@ -2614,8 +2749,10 @@ mm_channel_queue_node_t* mm_channel_superbuf_dequeue_internal(mm_channel_queue_t
             queue->que.size--;
             if (super_buf->matched == TRUE) {
                 queue->match_cnt--;
+            } else {
+                mm_channel_superbuf_untrack(queue, super_buf);
             }
-            free(node);
+            cam_queue_put_node(&queue->que, node);
         }
     }
 
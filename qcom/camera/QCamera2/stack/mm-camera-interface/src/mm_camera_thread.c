@@ -34,7 +34,9 @@
 #include <sys/stat.h>
 #include <sys/prctl.h>
 #include <fcntl.h>
-#include <poll.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <cam_semaphore.h>
 
 #include "mm_camera_dbg.h"
@@ -42,17 +44,13 @@
 #include "mm_camera.h"
 
 typedef enum {
-    /* poll entries updated */
-    MM_CAMERA_PIPE_CMD_POLL_ENTRIES_UPDATED,
-    /* poll entries updated asynchronous */
-    MM_CAMERA_PIPE_CMD_POLL_ENTRIES_UPDATED_ASYNC,
-    /* commit updates */
-    MM_CAMERA_PIPE_CMD_COMMIT,
+    /* no command */
+    MM_CAMERA_POLL_CMD_NONE,
     /* exit */
-    MM_CAMERA_PIPE_CMD_EXIT,
+    MM_CAMERA_POLL_CMD_EXIT,
     /* max count */
-    MM_CAMERA_PIPE_CMD_MAX
-} mm_camera_pipe_cmd_type_t;
+    MM_CAMERA_POLL_CMD_MAX
+} mm_camera_poll_cmd_type_t;
 
 typedef enum {
     MM_CAMERA_POLL_TASK_STATE_STOPPED,
@@ -60,124 +58,107 @@ typedef enum {
     MM_CAMERA_POLL_TASK_STATE_MAX
 } mm_camera_poll_task_state_type_t;
 
-typedef struct {
-    uint32_t cmd;
-    mm_camera_event_t event;
-} mm_camera_sig_evt_t;
-
+/* epoll data of wake_fd, poll entries use their index */
+#define MM_CAMERA_POLL_WAKE_IDX MAX_STREAM_NUM_IN_BUNDLE
+#define MM_CAMERA_POLL_EVENTS (EPOLLIN | EPOLLRDNORM | EPOLLPRI)
 
 /*===========================================================================
- * FUNCTION   : mm_camera_poll_sig_async
+ * FUNCTION   : mm_camera_poll_wake
  *
- * DESCRIPTION: Asynchoronous call to send a command through pipe.
+ * DESCRIPTION: wake the poll thread to apply updates, unless a wakeup is
+ *              already pending. poll_cb->mutex must be held.
  *
  * PARAMETERS :
- *   @poll_cb      : ptr to poll thread object
- *   @cmd          : command to be sent
+ *   @poll_cb : ptr to poll thread object
  *
  * RETURN     : int32_t type of status
  *              0  -- success
  *              -1 -- failure
  *==========================================================================*/
-static int32_t mm_camera_poll_sig_async(mm_camera_poll_thread_t *poll_cb,
-                                  uint32_t cmd)
+static int32_t mm_camera_poll_wake(mm_camera_poll_thread_t *poll_cb)
 {
-    /* send through pipe */
-    /* get the mutex */
-    mm_camera_sig_evt_t cmd_evt;
-
-    CDBG("%s: E cmd = %d", __func__,cmd);
-    memset(&cmd_evt, 0, sizeof(cmd_evt));
-    cmd_evt.cmd = cmd;
-    pthread_mutex_lock(&poll_cb->mutex);
-    /* reset the statue to false */
-    poll_cb->status = FALSE;
+    uint64_t count = 1;
+    ssize_t len;
 
-    /* send cmd to worker */
-    ssize_t len = write(poll_cb->pfds[1], &cmd_evt, sizeof(cmd_evt));
-    if (len < 1) {
+    if (poll_cb->wake_pending) {
+        return 0;
+    }
+    len = write(poll_cb->wake_fd, &count, sizeof(count));
+    if (len != sizeof(count)) {
         CDBG_ERROR("%s: len = %lld, errno = %d", __func__,
                 (long long int)len, errno);
-        /* Avoid waiting for the signal */
-        pthread_mutex_unlock(&poll_cb->mutex);
-        return 0;
+        return -1;
     }
-    CDBG("%s: begin IN mutex write done, len = %lld", __func__,
-            (long long int)len);
-    pthread_mutex_unlock(&poll_cb->mutex);
-    CDBG("%s: X", __func__);
+    poll_cb->wake_pending = TRUE;
     return 0;
 }
 
-
-
-
 /*===========================================================================
- * FUNCTION   : mm_camera_poll_sig
+ * FUNCTION   : mm_camera_poll_wait_applied
  *
- * DESCRIPTION: synchorinzed call to send a command through pipe.
+ * DESCRIPTION: wait until the poll thread has applied the updates up to
+ *              seq, waking it for updates that are held. poll_cb->mutex
+ *              must be held.
  *
  * PARAMETERS :
- *   @poll_cb      : ptr to poll thread object
- *   @cmd          : command to be sent
+ *   @poll_cb : ptr to poll thread object
+ *   @seq     : update sequence number to wait for
  *
  * RETURN     : int32_t type of status
  *              0  -- success
  *              -1 -- failure
  *==========================================================================*/
-static int32_t mm_camera_poll_sig(mm_camera_poll_thread_t *poll_cb,
-                                  uint32_t cmd)
+static int32_t mm_camera_poll_wait_applied(mm_camera_poll_thread_t *poll_cb,
+                                           uint32_t seq)
 {
-    /* send through pipe */
-    /* get the mutex */
-    mm_camera_sig_evt_t cmd_evt;
-
-    CDBG("%s: E cmd = %d", __func__,cmd);
-    memset(&cmd_evt, 0, sizeof(cmd_evt));
-    cmd_evt.cmd = cmd;
-    pthread_mutex_lock(&poll_cb->mutex);
-    /* reset the statue to false */
-    poll_cb->status = FALSE;
-    /* send cmd to worker */
-
-    ssize_t len = write(poll_cb->pfds[1], &cmd_evt, sizeof(cmd_evt));
-    if(len < 1) {
-        CDBG_ERROR("%s: len = %lld, errno = %d", __func__,
-                (long long int)len, errno);
-        /* Avoid waiting for the signal */
-        pthread_mutex_unlock(&poll_cb->mutex);
-        return 0;
+    if ((int32_t)(poll_cb->applied_seq - seq) < 0 &&
+            0 != mm_camera_poll_wake(poll_cb)) {
+        return -1;
     }
-    CDBG("%s: begin IN mutex write done, len = %lld", __func__,
-            (long long int)len);
-    /* wait till worker task gives positive signal */
-    if (FALSE == poll_cb->status) {
+    while ((int32_t)(poll_cb->applied_seq - seq) < 0 &&
+           MM_CAMERA_POLL_TASK_STATE_POLL == poll_cb->state) {
         CDBG("%s: wait", __func__);
         pthread_cond_wait(&poll_cb->cond_v, &poll_cb->mutex);
     }
-    /* done */
-    pthread_mutex_unlock(&poll_cb->mutex);
-    CDBG("%s: X", __func__);
     return 0;
 }
 
 /*===========================================================================
- * FUNCTION   : mm_camera_poll_sig
+ * FUNCTION   : mm_camera_poll_update_entry
  *
- * DESCRIPTION: signal the status of done
+ * DESCRIPTION: queue an update of a poll entry for the poll thread. Async
+ *              updates return at once, the poll thread applies all updates
+ *              queued by the time it wakes in one go. While updates are
+ *              held, async updates do not wake it and wait for the commit.
+ *              Sync updates return once they are applied, after which the
+ *              old entry's callback is not running and will not be called
+ *              again.
  *
  * PARAMETERS :
- *   @poll_cb : ptr to poll thread object
+ *   @poll_cb   : ptr to poll thread object
+ *   @idx       : index of the poll entry
+ *   @entry     : new entry, fd -1 to remove it
+ *   @call_type : Whether its Synchronous or Asynchronous call
  *
- * RETURN     : none
+ * RETURN     : int32_t type of status
+ *              0  -- success
+ *              -1 -- failure
  *==========================================================================*/
-static void mm_camera_poll_sig_done(mm_camera_poll_thread_t *poll_cb)
+static int32_t mm_camera_poll_update_entry(mm_camera_poll_thread_t *poll_cb,
+                                           uint8_t idx,
+                                           const mm_camera_poll_entry_t *entry,
+                                           mm_camera_call_type_t call_type)
 {
-    pthread_mutex_lock(&poll_cb->mutex);
-    poll_cb->status = TRUE;
-    pthread_cond_signal(&poll_cb->cond_v);
-    CDBG("%s: done, in mutex", __func__);
-    pthread_mutex_unlock(&poll_cb->mutex);
+    poll_cb->poll_entries[idx] = *entry;
+    poll_cb->updated_entries |= 1 << idx;
+    poll_cb->update_seq++;
+    if (call_type == mm_camera_sync_call) {
+        return mm_camera_poll_wait_applied(poll_cb, poll_cb->update_seq);
+    }
+    if (poll_cb->hold_count > 0) {
+        return 0;
+    }
+    return mm_camera_poll_wake(poll_cb);
 }
 
 /*===========================================================================
@@ -198,75 +179,59 @@ static void mm_camera_poll_set_state(mm_camera_poll_thread_t *poll_cb,
 }
 
 /*===========================================================================
- * FUNCTION   : mm_camera_poll_proc_pipe
+ * FUNCTION   : mm_camera_poll_apply_updates
  *
- * DESCRIPTION: polling thread routine to process pipe
+ * DESCRIPTION: polling thread routine to apply the queued entry updates to
+ *              the epoll set and wake up the callers waiting for them
  *
  * PARAMETERS :
  *   @poll_cb : ptr to poll thread object
  *
  * RETURN     : none
  *==========================================================================*/
-static void mm_camera_poll_proc_pipe(mm_camera_poll_thread_t *poll_cb)
+static void mm_camera_poll_apply_updates(mm_camera_poll_thread_t *poll_cb)
 {
-    ssize_t read_len;
+    struct epoll_event event;
+    uint64_t count;
     int i;
-    mm_camera_sig_evt_t cmd_evt;
-    read_len = read(poll_cb->pfds[0], &cmd_evt, sizeof(cmd_evt));
-    CDBG("%s: read_fd = %d, read_len = %d, expect_len = %d cmd = %d",
-         __func__, poll_cb->pfds[0], (int)read_len, (int)sizeof(cmd_evt), cmd_evt.cmd);
-    switch (cmd_evt.cmd) {
-    case MM_CAMERA_PIPE_CMD_POLL_ENTRIES_UPDATED:
-    case MM_CAMERA_PIPE_CMD_POLL_ENTRIES_UPDATED_ASYNC:
-        /* we always have index 0 for pipe read */
-        poll_cb->num_fds = 0;
-        poll_cb->poll_fds[poll_cb->num_fds].fd = poll_cb->pfds[0];
-        poll_cb->poll_fds[poll_cb->num_fds].events = POLLIN|POLLRDNORM|POLLPRI;
-        poll_cb->num_fds++;
-
-        if (MM_CAMERA_POLL_TYPE_EVT == poll_cb->poll_type &&
-                poll_cb->num_fds < MAX_STREAM_NUM_IN_BUNDLE) {
-            if (poll_cb->poll_entries[0].fd > 0) {
-                /* fd is valid, we update poll_fds */
-                poll_cb->poll_fds[poll_cb->num_fds].fd = poll_cb->poll_entries[0].fd;
-                poll_cb->poll_fds[poll_cb->num_fds].events = POLLIN|POLLRDNORM|POLLPRI;
-                poll_cb->num_fds++;
-            }
-        } else if (MM_CAMERA_POLL_TYPE_DATA == poll_cb->poll_type &&
-                poll_cb->num_fds <= MAX_STREAM_NUM_IN_BUNDLE) {
-            for(i = 0; i < MAX_STREAM_NUM_IN_BUNDLE; i++) {
-                if(poll_cb->poll_entries[i].fd > 0) {
-                    /* fd is valid, we update poll_fds to this fd */
-                    poll_cb->poll_fds[poll_cb->num_fds].fd = poll_cb->poll_entries[i].fd;
-                    poll_cb->poll_fds[poll_cb->num_fds].events = POLLIN|POLLRDNORM|POLLPRI;
-                    poll_cb->num_fds++;
-                } else {
-                    /* fd is invalid, we set the entry to -1 to prevent polling.
-                     * According to spec, polling will not poll on entry with fd=-1.
-                     * If this is not the case, we need to skip these invalid fds
-                     * when updating this array.
-                     * We still keep fd=-1 in this array because this makes easier to
-                     * map cb associated with this fd once incoming data avail by directly
-                     * using the index-1(0 is reserved for pipe read, so need to reduce index by 1) */
-                    poll_cb->poll_fds[poll_cb->num_fds].fd = -1;
-                    poll_cb->poll_fds[poll_cb->num_fds].events = 0;
-                    poll_cb->num_fds++;
-                }
+
+    /* the count only tells there were wakeups, the updates are in poll_cb */
+    if (read(poll_cb->wake_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        CDBG_ERROR("%s: read wake fd failed, errno = %d", __func__, errno);
+    }
+
+    pthread_mutex_lock(&poll_cb->mutex);
+    poll_cb->wake_pending = FALSE;
+    for (i = 0; i < MAX_STREAM_NUM_IN_BUNDLE; i++) {
+        mm_camera_poll_entry_t *active = &poll_cb->active_entries[i];
+
+        if (!(poll_cb->updated_entries & (1 << i))) {
+            continue;
+        }
+        /* the fd may have been closed and reused, so always
+         * register again rather than compare fds */
+        if (active->fd > 0) {
+            epoll_ctl(poll_cb->epoll_fd, EPOLL_CTL_DEL, active->fd, NULL);
+        }
+        *active = poll_cb->poll_entries[i];
+        if (active->fd > 0) {
+            memset(&event, 0, sizeof(event));
+            event.events = MM_CAMERA_POLL_EVENTS;
+            event.data.u32 = (uint32_t)i;
+            if (epoll_ctl(poll_cb->epoll_fd, EPOLL_CTL_ADD, active->fd, &event) < 0) {
+                CDBG_ERROR("%s: adding fd %d failed, errno = %d",
+                           __func__, active->fd, errno);
+                active->fd = -1;
             }
         }
-        if (cmd_evt.cmd != MM_CAMERA_PIPE_CMD_POLL_ENTRIES_UPDATED_ASYNC)
-            mm_camera_poll_sig_done(poll_cb);
-        break;
-
-    case MM_CAMERA_PIPE_CMD_COMMIT:
-        mm_camera_poll_sig_done(poll_cb);
-        break;
-    case MM_CAMERA_PIPE_CMD_EXIT:
-    default:
+    }
+    poll_cb->updated_entries = 0;
+    poll_cb->applied_seq = poll_cb->update_seq;
+    if (MM_CAMERA_POLL_CMD_EXIT == poll_cb->cmd) {
         mm_camera_poll_set_state(poll_cb, MM_CAMERA_POLL_TASK_STATE_STOPPED);
-        mm_camera_poll_sig_done(poll_cb);
-        break;
     }
+    pthread_cond_broadcast(&poll_cb->cond_v);
+    pthread_mutex_unlock(&poll_cb->mutex);
 }
 
 /*===========================================================================
@@ -281,44 +246,50 @@ static void mm_camera_poll_proc_pipe(mm_camera_poll_thread_t *poll_cb)
  *==========================================================================*/
 static void *mm_camera_poll_fn(mm_camera_poll_thread_t *poll_cb)
 {
+    struct epoll_event events[MAX_STREAM_NUM_IN_BUNDLE + 1];
     int rc = 0, i;
 
     if (NULL == poll_cb) {
         CDBG_ERROR("%s: poll_cb is NULL!\n", __func__);
         return NULL;
     }
-    CDBG("%s: poll type = %d, num_fd = %d poll_cb = %p\n",
-         __func__, poll_cb->poll_type, poll_cb->num_fds,poll_cb);
+    CDBG("%s: poll type = %d, poll_cb = %p\n",
+         __func__, poll_cb->poll_type, poll_cb);
     do {
-         for(i = 0; i < poll_cb->num_fds; i++) {
-            poll_cb->poll_fds[i].events = POLLIN|POLLRDNORM|POLLPRI;
-         }
-
-         rc = poll(poll_cb->poll_fds, poll_cb->num_fds, poll_cb->timeoutms);
-         if(rc > 0) {
-            if ((poll_cb->poll_fds[0].revents & POLLIN) &&
-                (poll_cb->poll_fds[0].revents & POLLRDNORM)) {
-                /* if we have data on pipe, we only process pipe in this iteration */
-                CDBG("%s: cmd received on pipe\n", __func__);
-                mm_camera_poll_proc_pipe(poll_cb);
-            } else {
-                for(i=1; i<poll_cb->num_fds; i++) {
-                    /* Checking for ctrl events */
-                    if ((poll_cb->poll_type == MM_CAMERA_POLL_TYPE_EVT) &&
-                        (poll_cb->poll_fds[i].revents & POLLPRI)) {
-                        CDBG("%s: mm_camera_evt_notify\n", __func__);
-                        if (NULL != poll_cb->poll_entries[i-1].notify_cb) {
-                            poll_cb->poll_entries[i-1].notify_cb(poll_cb->poll_entries[i-1].user_data);
-                        }
+        rc = epoll_wait(poll_cb->epoll_fd, events,
+                        MAX_STREAM_NUM_IN_BUNDLE + 1, poll_cb->timeoutms);
+        if (rc > 0) {
+            for (i = 0; i < rc; i++) {
+                if (MM_CAMERA_POLL_WAKE_IDX == events[i].data.u32) {
+                    break;
+                }
+            }
+            if (i < rc) {
+                /* if entries were updated, we only apply the updates in this
+                 * iteration, the fds still ready are reported again */
+                CDBG("%s: entries updated\n", __func__);
+                mm_camera_poll_apply_updates(poll_cb);
+                continue;
+            }
+            for (i = 0; i < rc; i++) {
+                mm_camera_poll_entry_t *entry =
+                    &poll_cb->active_entries[events[i].data.u32];
+
+                /* Checking for ctrl events */
+                if ((poll_cb->poll_type == MM_CAMERA_POLL_TYPE_EVT) &&
+                    (events[i].events & EPOLLPRI)) {
+                    CDBG("%s: mm_camera_evt_notify\n", __func__);
+                    if (NULL != entry->notify_cb) {
+                        entry->notify_cb(entry->user_data);
                     }
+                }
 
-                    if ((MM_CAMERA_POLL_TYPE_DATA == poll_cb->poll_type) &&
-                        (poll_cb->poll_fds[i].revents & POLLIN) &&
-                        (poll_cb->poll_fds[i].revents & POLLRDNORM)) {
-                        CDBG("%s: mm_stream_data_notify\n", __func__);
-                        if (NULL != poll_cb->poll_entries[i-1].notify_cb) {
-                            poll_cb->poll_entries[i-1].notify_cb(poll_cb->poll_entries[i-1].user_data);
-                        }
+                if ((MM_CAMERA_POLL_TYPE_DATA == poll_cb->poll_type) &&
+                    (events[i].events & EPOLLIN) &&
+                    (events[i].events & EPOLLRDNORM)) {
+                    CDBG("%s: mm_stream_data_notify\n", __func__);
+                    if (NULL != entry->notify_cb) {
+                        entry->notify_cb(entry->user_data);
                     }
                 }
             }
@@ -346,19 +317,19 @@ static void *mm_camera_poll_thread(void *data)
     prctl(PR_SET_NAME, (unsigned long)"mm_cam_poll_th", 0, 0, 0);
     mm_camera_poll_thread_t *poll_cb = (mm_camera_poll_thread_t *)data;
 
-    /* add pipe read fd into poll first */
-    poll_cb->poll_fds[poll_cb->num_fds++].fd = poll_cb->pfds[0];
-
-    mm_camera_poll_sig_done(poll_cb);
+    pthread_mutex_lock(&poll_cb->mutex);
     mm_camera_poll_set_state(poll_cb, MM_CAMERA_POLL_TASK_STATE_POLL);
+    poll_cb->status = TRUE;
+    pthread_cond_signal(&poll_cb->cond_v);
+    pthread_mutex_unlock(&poll_cb->mutex);
     return mm_camera_poll_fn(poll_cb);
 }
 
 /*===========================================================================
- * FUNCTION   : mm_camera_poll_thread
+ * FUNCTION   : mm_camera_poll_thread_notify_entries_updated
  *
  * DESCRIPTION: notify the polling thread that entries for polling fd have
- *              been updated
+ *              been updated, and wait until it has applied them
  *
  * PARAMETERS :
  *   @poll_cb : ptr to poll thread object
@@ -367,14 +338,47 @@ static void *mm_camera_poll_thread(void *data)
  *==========================================================================*/
 int32_t mm_camera_poll_thread_notify_entries_updated(mm_camera_poll_thread_t * poll_cb)
 {
-    /* send poll entries updated signal to poll thread */
-    return mm_camera_poll_sig(poll_cb, MM_CAMERA_PIPE_CMD_POLL_ENTRIES_UPDATED);
+    int32_t rc;
+
+    pthread_mutex_lock(&poll_cb->mutex);
+    poll_cb->updated_entries = (1 << MAX_STREAM_NUM_IN_BUNDLE) - 1;
+    poll_cb->update_seq++;
+    rc = mm_camera_poll_wake(poll_cb);
+    if (0 == rc) {
+        mm_camera_poll_wait_applied(poll_cb, poll_cb->update_seq);
+    }
+    pthread_mutex_unlock(&poll_cb->mutex);
+    return rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_camera_poll_thread_hold_updates
+ *
+ * DESCRIPTION: keep the following async updates queued without waking the
+ *              poll thread until the matching commit_updates, so that
+ *              updates issued from several places go in one wakeup
+ *
+ * PARAMETERS :
+ *   @poll_cb : ptr to poll thread object
+ *
+ * RETURN     : int32_t type of status
+ *              0  -- success
+ *              -1 -- failure
+ *==========================================================================*/
+int32_t mm_camera_poll_thread_hold_updates(mm_camera_poll_thread_t * poll_cb)
+{
+    pthread_mutex_lock(&poll_cb->mutex);
+    poll_cb->hold_count++;
+    pthread_mutex_unlock(&poll_cb->mutex);
+    return 0;
 }
 
 /*===========================================================================
  * FUNCTION   : mm_camera_poll_thread_commit_updates
  *
- * DESCRIPTION: sync with all previously pending async updates
+ * DESCRIPTION: sync with all previously pending async updates, ending one
+ *              hold_updates if any. Returns at once if there are none, or
+ *              if an outer hold_updates is still open.
  *
  * PARAMETERS :
  *   @poll_cb : ptr to poll thread object
@@ -385,7 +389,17 @@ int32_t mm_camera_poll_thread_notify_entries_updated(mm_camera_poll_thread_t * p
  *==========================================================================*/
 int32_t mm_camera_poll_thread_commit_updates(mm_camera_poll_thread_t * poll_cb)
 {
-    return mm_camera_poll_sig(poll_cb, MM_CAMERA_PIPE_CMD_COMMIT);
+    int32_t rc = 0;
+
+    pthread_mutex_lock(&poll_cb->mutex);
+    if (poll_cb->hold_count > 0) {
+        poll_cb->hold_count--;
+    }
+    if (0 == poll_cb->hold_count) {
+        rc = mm_camera_poll_wait_applied(poll_cb, poll_cb->update_seq);
+    }
+    pthread_mutex_unlock(&poll_cb->mutex);
+    return rc;
 }
 
 /*===========================================================================
@@ -413,6 +427,7 @@ int32_t mm_camera_poll_thread_add_poll_fd(mm_camera_poll_thread_t * poll_cb,
 {
     int32_t rc = -1;
     uint8_t idx = 0;
+    mm_camera_poll_entry_t entry;
 
     if (MM_CAMERA_POLL_TYPE_DATA == poll_cb->poll_type) {
         /* get stream idx from handler if CH type */
@@ -423,16 +438,13 @@ int32_t mm_camera_poll_thread_add_poll_fd(mm_camera_poll_thread_t * poll_cb,
     }
 
     if (MAX_STREAM_NUM_IN_BUNDLE > idx) {
-        poll_cb->poll_entries[idx].fd = fd;
-        poll_cb->poll_entries[idx].handler = handler;
-        poll_cb->poll_entries[idx].notify_cb = notify_cb;
-        poll_cb->poll_entries[idx].user_data = userdata;
-        /* send poll entries updated signal to poll thread */
-        if (call_type == mm_camera_sync_call ) {
-            rc = mm_camera_poll_sig(poll_cb, MM_CAMERA_PIPE_CMD_POLL_ENTRIES_UPDATED);
-        } else {
-            rc = mm_camera_poll_sig_async(poll_cb, MM_CAMERA_PIPE_CMD_POLL_ENTRIES_UPDATED_ASYNC );
-        }
+        entry.fd = fd;
+        entry.handler = handler;
+        entry.notify_cb = notify_cb;
+        entry.user_data = userdata;
+        pthread_mutex_lock(&poll_cb->mutex);
+        rc = mm_camera_poll_update_entry(poll_cb, idx, &entry, call_type);
+        pthread_mutex_unlock(&poll_cb->mutex);
     } else {
         CDBG_ERROR("%s: invalid handler %d (%d)",
                    __func__, handler, idx);
@@ -443,12 +455,14 @@ int32_t mm_camera_poll_thread_add_poll_fd(mm_camera_poll_thread_t * poll_cb,
 /*===========================================================================
  * FUNCTION   : mm_camera_poll_thread_del_poll_fd
  *
- * DESCRIPTION: delete a fd from polling thread
+ * DESCRIPTION: delete a fd from polling thread. Deleting a fd that was
+ *              already deleted only waits for the deletion if sync.
  *
  * PARAMETERS :
  *   @poll_cb   : ptr to poll thread object
  *   @handler   : stream handle if channel data polling thread,
  *                0 if event polling thread
+ *   @call_type : Whether its Synchronous or Asynchronous call
  *
  * RETURN     : int32_t type of status
  *              0  -- success
@@ -460,6 +474,7 @@ int32_t mm_camera_poll_thread_del_poll_fd(mm_camera_poll_thread_t * poll_cb,
 {
     int32_t rc = -1;
     uint8_t idx = 0;
+    mm_camera_poll_entry_t entry;
 
     if (MM_CAMERA_POLL_TYPE_DATA == poll_cb->poll_type) {
         /* get stream idx from handler if CH type */
@@ -469,24 +484,29 @@ int32_t mm_camera_poll_thread_del_poll_fd(mm_camera_poll_thread_t * poll_cb,
         idx = 0;
     }
 
-    if ((MAX_STREAM_NUM_IN_BUNDLE > idx) &&
-        (handler == poll_cb->poll_entries[idx].handler)) {
-        /* reset poll entry */
-        poll_cb->poll_entries[idx].fd = -1; /* set fd to invalid */
-        poll_cb->poll_entries[idx].handler = 0;
-        poll_cb->poll_entries[idx].notify_cb = NULL;
+    if (MAX_STREAM_NUM_IN_BUNDLE <= idx) {
+        CDBG_ERROR("%s: invalid handler %d (%d)",
+                   __func__, handler, idx);
+        return -1;
+    }
 
-        /* send poll entries updated signal to poll thread */
-        if (call_type == mm_camera_sync_call ) {
-            rc = mm_camera_poll_sig(poll_cb, MM_CAMERA_PIPE_CMD_POLL_ENTRIES_UPDATED);
-        } else {
-            rc = mm_camera_poll_sig_async(poll_cb, MM_CAMERA_PIPE_CMD_POLL_ENTRIES_UPDATED_ASYNC );
+    pthread_mutex_lock(&poll_cb->mutex);
+    if (handler == poll_cb->poll_entries[idx].handler) {
+        /* reset poll entry */
+        memset(&entry, 0, sizeof(entry));
+        entry.fd = -1; /* set fd to invalid */
+        rc = mm_camera_poll_update_entry(poll_cb, idx, &entry, call_type);
+    } else if (0 == poll_cb->poll_entries[idx].handler) {
+        /* deleted already, possibly not applied yet */
+        if (call_type == mm_camera_sync_call) {
+            mm_camera_poll_wait_applied(poll_cb, poll_cb->update_seq);
         }
+        rc = 0;
     } else {
         CDBG_ERROR("%s: invalid handler %d (%d)",
                    __func__, handler, idx);
-        return -1;
     }
+    pthread_mutex_unlock(&poll_cb->mutex);
 
     return rc;
 }
@@ -495,21 +515,46 @@ int32_t mm_camera_poll_thread_launch(mm_camera_poll_thread_t * poll_cb,
                                      mm_camera_poll_thread_type_t poll_type)
 {
     int32_t rc = 0;
+    struct epoll_event event;
     poll_cb->poll_type = poll_type;
 
-    poll_cb->pfds[0] = -1;
-    poll_cb->pfds[1] = -1;
-    rc = pipe(poll_cb->pfds);
-    if(rc < 0) {
-        CDBG_ERROR("%s: pipe open rc=%d\n", __func__, rc);
+    poll_cb->epoll_fd = epoll_create(MAX_STREAM_NUM_IN_BUNDLE + 1);
+    if (poll_cb->epoll_fd < 0) {
+        CDBG_ERROR("%s: epoll_create failed, errno = %d\n", __func__, errno);
+        return -1;
+    }
+    poll_cb->wake_fd = eventfd(0, EFD_NONBLOCK);
+    if (poll_cb->wake_fd < 0) {
+        CDBG_ERROR("%s: eventfd failed, errno = %d\n", __func__, errno);
+        close(poll_cb->epoll_fd);
+        poll_cb->epoll_fd = -1;
+        return -1;
+    }
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u32 = MM_CAMERA_POLL_WAKE_IDX;
+    rc = epoll_ctl(poll_cb->epoll_fd, EPOLL_CTL_ADD, poll_cb->wake_fd, &event);
+    if (rc < 0) {
+        CDBG_ERROR("%s: adding wake fd failed, errno = %d\n", __func__, errno);
+        close(poll_cb->wake_fd);
+        close(poll_cb->epoll_fd);
+        poll_cb->wake_fd = -1;
+        poll_cb->epoll_fd = -1;
         return -1;
     }
 
+    memset(poll_cb->active_entries, 0, sizeof(poll_cb->active_entries));
+    poll_cb->cmd = MM_CAMERA_POLL_CMD_NONE;
+    poll_cb->updated_entries = 0;
+    poll_cb->update_seq = 0;
+    poll_cb->applied_seq = 0;
+    poll_cb->wake_pending = FALSE;
+    poll_cb->hold_count = 0;
     poll_cb->timeoutms = -1;  /* Infinite seconds */
 
-    CDBG("%s: poll_type = %d, read fd = %d, write fd = %d timeout = %d",
+    CDBG("%s: poll_type = %d, epoll fd = %d, wake fd = %d timeout = %d",
         __func__, poll_cb->poll_type,
-        poll_cb->pfds[0], poll_cb->pfds[1],poll_cb->timeoutms);
+        poll_cb->epoll_fd, poll_cb->wake_fd, poll_cb->timeoutms);
 
     pthread_mutex_init(&poll_cb->mutex, NULL);
     pthread_cond_init(&poll_cb->cond_v, NULL);
@@ -518,7 +563,7 @@ int32_t mm_camera_poll_thread_launch(mm_camera_poll_thread_t * poll_cb,
     pthread_mutex_lock(&poll_cb->mutex);
     poll_cb->status = 0;
     pthread_create(&poll_cb->pid, NULL, mm_camera_poll_thread, (void *)poll_cb);
-    if(!poll_cb->status) {
+    while (!poll_cb->status) {
         pthread_cond_wait(&poll_cb->cond_v, &poll_cb->mutex);
     }
     if (!poll_cb->threadName) {
@@ -540,25 +585,29 @@ int32_t mm_camera_poll_thread_release(mm_camera_poll_thread_t *poll_cb)
     }
 
     /* send exit signal to poll thread */
-    mm_camera_poll_sig(poll_cb, MM_CAMERA_PIPE_CMD_EXIT);
+    pthread_mutex_lock(&poll_cb->mutex);
+    poll_cb->cmd = MM_CAMERA_POLL_CMD_EXIT;
+    poll_cb->update_seq++;
+    mm_camera_poll_wake(poll_cb);
+    pthread_mutex_unlock(&poll_cb->mutex);
     /* wait until poll thread exits */
     if (pthread_join(poll_cb->pid, NULL) != 0) {
         CDBG_ERROR("%s: pthread dead already\n", __func__);
     }
 
-    /* close pipe */
-    if(poll_cb->pfds[0] >= 0) {
-        close(poll_cb->pfds[0]);
+    /* close epoll and wake fds */
+    if(poll_cb->epoll_fd >= 0) {
+        close(poll_cb->epoll_fd);
     }
-    if(poll_cb->pfds[1] >= 0) {
-        close(poll_cb->pfds[1]);
+    if(poll_cb->wake_fd >= 0) {
+        close(poll_cb->wake_fd);
     }
 
     pthread_mutex_destroy(&poll_cb->mutex);
     pthread_cond_destroy(&poll_cb->cond_v);
     memset(poll_cb, 0, sizeof(mm_camera_poll_thread_t));
-    poll_cb->pfds[0] = -1;
-    poll_cb->pfds[1] = -1;
+    poll_cb->epoll_fd = -1;
+    poll_cb->wake_fd = -1;
     return rc;
 }
 
@@ -0,0 +1,58 @@
+OLD_LOCAL_PATH := $(LOCAL_PATH)
+MM_CAMERA_TEST_PATH := $(call my-dir)
+
+include $(MM_CAMERA_TEST_PATH)/../../../../common.mk
+include $(CLEAR_VARS)
+LOCAL_PATH := $(MM_CAMERA_TEST_PATH)
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CFLAGS := -Wall -Wextra -Werror -Wno-unused-parameter -O2
+LOCAL_CFLAGS += -D_ANDROID_
+
+LOCAL_C_INCLUDES := \
+    $(MM_CAMERA_TEST_PATH)/../inc \
+    $(MM_CAMERA_TEST_PATH)/../../common \
+    system/media/camera/include
+
+LOCAL_C_INCLUDES += $(kernel_includes)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(common_deps)
+
+LOCAL_SRC_FILES := \
+    mm_camera_poll_test.c \
+    ../src/mm_camera_thread.c
+
+LOCAL_32_BIT_ONLY := $(BOARD_QTI_CAMERA_32BIT_ONLY)
+LOCAL_MODULE           := mm-camera-poll-test
+LOCAL_PRELINK_MODULE   := false
+LOCAL_SHARED_LIBRARIES := libcutils liblog
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(MM_CAMERA_TEST_PATH)
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CFLAGS := -Wall -Wextra -Werror -Wno-unused-parameter -O2
+LOCAL_CFLAGS += -D_ANDROID_
+
+LOCAL_C_INCLUDES := \
+    $(MM_CAMERA_TEST_PATH)/../inc \
+    $(MM_CAMERA_TEST_PATH)/../../common \
+    system/media/camera/include
+
+LOCAL_C_INCLUDES += $(kernel_includes)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(common_deps)
+
+LOCAL_SRC_FILES := \
+    mm_camera_superbuf_test.c \
+    ../src/mm_camera_channel.c \
+    ../src/mm_camera_thread.c
+
+LOCAL_32_BIT_ONLY := $(BOARD_QTI_CAMERA_32BIT_ONLY)
+LOCAL_MODULE           := mm-camera-superbuf-test
+LOCAL_PRELINK_MODULE   := false
+LOCAL_SHARED_LIBRARIES := libcutils liblog
+
+include $(BUILD_EXECUTABLE)
+
+LOCAL_PATH := $(OLD_LOCAL_PATH)
@@ -0,0 +1,270 @@
+/* Copyright (c) 2016, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mm_camera.h"
+
+/*
+ * Checks the mm-camera poll thread on pipes standing in for stream fds, then
+ * times a stream start and stop (registering and removing the stream fds of a
+ * channel) and the dispatch of a ready fd to its callback. Registration is
+ * timed the way channel start does it, async adds held until one commit,
+ * and with a sync call per stream.
+ *
+ * Run it like this:
+ *
+ * make mm-camera-poll-test -j32 && \
+ * adb push $OUT/system/bin/mm-camera-poll-test /data/local/tmp && \
+ * adb shell /data/local/tmp/mm-camera-poll-test -n 2000
+ */
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAILED %s:%d: ", __func__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            failures++; \
+        } \
+    } while (0)
+
+/* normally in mm_camera_interface.c */
+volatile uint32_t gMmCameraIntfLogLevel = 0;
+
+uint8_t mm_camera_util_get_index_by_handler(uint32_t handler)
+{
+    return (handler & 0x000000ff);
+}
+
+typedef struct {
+    int fds[2];
+    uint32_t handler;
+    int notified;
+    cam_semaphore_t sem;
+} fake_stream_t;
+
+static fake_stream_t streams[MAX_STREAM_NUM_IN_BUNDLE];
+
+/* what the stream data notify does: take the ready buffer off the fd */
+static void fake_stream_notify(void *user_data)
+{
+    fake_stream_t *stream = (fake_stream_t *)user_data;
+    char c;
+
+    if (read(stream->fds[0], &c, 1) == 1) {
+        __sync_fetch_and_add(&stream->notified, 1);
+        cam_sem_post(&stream->sem);
+    }
+}
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void ready(fake_stream_t *stream)
+{
+    char c = 0;
+    if (write(stream->fds[1], &c, 1) != 1) {
+        perror("write");
+        exit(1);
+    }
+}
+
+static int32_t add_stream(mm_camera_poll_thread_t *poll_cb, fake_stream_t *stream,
+                          mm_camera_call_type_t call_type)
+{
+    return mm_camera_poll_thread_add_poll_fd(poll_cb, stream->handler,
+            stream->fds[0], fake_stream_notify, stream, call_type);
+}
+
+static void check_dispatch(mm_camera_poll_thread_t *poll_cb)
+{
+    int i, notified;
+
+    for (i = 0; i < MAX_STREAM_NUM_IN_BUNDLE; i++) {
+        CHECK(add_stream(poll_cb, &streams[i], mm_camera_async_call) == 0, "add %d", i);
+    }
+    CHECK(mm_camera_poll_thread_commit_updates(poll_cb) == 0, "commit");
+    for (i = 0; i < MAX_STREAM_NUM_IN_BUNDLE; i++) {
+        ready(&streams[i]);
+        cam_sem_wait(&streams[i].sem);
+    }
+
+    /* no callback once a sync del returns */
+    notified = streams[0].notified;
+    CHECK(mm_camera_poll_thread_del_poll_fd(poll_cb, streams[0].handler,
+                mm_camera_sync_call) == 0, "del");
+    ready(&streams[0]);
+    ready(&streams[1]);
+    cam_sem_wait(&streams[1].sem);
+    usleep(20000);
+    CHECK(streams[0].notified == notified, "%d callbacks after del",
+          streams[0].notified - notified);
+
+    /* deleting it again, as stream off after channel stop does, is fine */
+    CHECK(mm_camera_poll_thread_del_poll_fd(poll_cb, streams[0].handler,
+                mm_camera_sync_call) == 0, "second del");
+    CHECK(mm_camera_poll_thread_del_poll_fd(poll_cb, MAX_STREAM_NUM_IN_BUNDLE,
+                mm_camera_sync_call) < 0, "del of invalid handler");
+
+    /* the buffer left on the fd is seen when it is added back */
+    CHECK(add_stream(poll_cb, &streams[0], mm_camera_async_call) == 0, "add again");
+    cam_sem_wait(&streams[0].sem);
+
+    /* held adds wait for the commit, as at channel start */
+    mm_camera_poll_thread_del_poll_fd(poll_cb, streams[0].handler, mm_camera_sync_call);
+    mm_camera_poll_thread_del_poll_fd(poll_cb, streams[1].handler, mm_camera_sync_call);
+    notified = streams[0].notified;
+    CHECK(mm_camera_poll_thread_hold_updates(poll_cb) == 0, "hold");
+    CHECK(add_stream(poll_cb, &streams[0], mm_camera_async_call) == 0, "held add");
+    CHECK(add_stream(poll_cb, &streams[1], mm_camera_async_call) == 0, "held add");
+    ready(&streams[0]);
+    usleep(20000);
+    CHECK(streams[0].notified == notified, "held add applied before commit");
+    CHECK(mm_camera_poll_thread_commit_updates(poll_cb) == 0, "commit held adds");
+    cam_sem_wait(&streams[0].sem);
+    ready(&streams[1]);
+    cam_sem_wait(&streams[1].sem);
+
+    for (i = 0; i < MAX_STREAM_NUM_IN_BUNDLE; i++) {
+        mm_camera_poll_thread_del_poll_fd(poll_cb, streams[i].handler, mm_camera_async_call);
+    }
+    mm_camera_poll_thread_commit_updates(poll_cb);
+}
+
+static int64_t start_stop_ns(mm_camera_poll_thread_t *poll_cb, int iterations,
+                             mm_camera_call_type_t call_type)
+{
+    int64_t start = now_ns();
+    int n, i;
+
+    for (n = 0; n < iterations; n++) {
+        if (call_type == mm_camera_async_call) {
+            mm_camera_poll_thread_hold_updates(poll_cb);
+        }
+        for (i = 0; i < MAX_STREAM_NUM_IN_BUNDLE; i++) {
+            add_stream(poll_cb, &streams[i], call_type);
+        }
+        mm_camera_poll_thread_commit_updates(poll_cb);
+        for (i = 0; i < MAX_STREAM_NUM_IN_BUNDLE; i++) {
+            mm_camera_poll_thread_del_poll_fd(poll_cb, streams[i].handler, call_type);
+        }
+        mm_camera_poll_thread_commit_updates(poll_cb);
+    }
+    return (now_ns() - start) / iterations;
+}
+
+static int64_t dispatch_ns(mm_camera_poll_thread_t *poll_cb, int iterations)
+{
+    int64_t start;
+    int n, i;
+
+    for (i = 0; i < MAX_STREAM_NUM_IN_BUNDLE; i++) {
+        add_stream(poll_cb, &streams[i], mm_camera_async_call);
+    }
+    mm_camera_poll_thread_commit_updates(poll_cb);
+    start = now_ns();
+    for (n = 0; n < iterations; n++) {
+        fake_stream_t *stream = &streams[n % MAX_STREAM_NUM_IN_BUNDLE];
+        ready(stream);
+        cam_sem_wait(&stream->sem);
+    }
+    start = (now_ns() - start) / iterations;
+    for (i = 0; i < MAX_STREAM_NUM_IN_BUNDLE; i++) {
+        mm_camera_poll_thread_del_poll_fd(poll_cb, streams[i].handler, mm_camera_async_call);
+    }
+    mm_camera_poll_thread_commit_updates(poll_cb);
+    return start;
+}
+
+int main(int argc, char **argv)
+{
+    mm_camera_poll_thread_t poll_cb;
+    int iterations = 2000;
+    int opt, i;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n iterations]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (iterations < 1) {
+        iterations = 1;
+    }
+
+    for (i = 0; i < MAX_STREAM_NUM_IN_BUNDLE; i++) {
+        if (pipe(streams[i].fds) < 0) {
+            perror("pipe");
+            return 1;
+        }
+        streams[i].handler = 0x100 | i;
+        cam_sem_init(&streams[i].sem, 0);
+    }
+
+    memset(&poll_cb, 0, sizeof(poll_cb));
+    strncpy(poll_cb.threadName, "CAM_poll_test", sizeof(poll_cb.threadName) - 1);
+    if (mm_camera_poll_thread_launch(&poll_cb, MM_CAMERA_POLL_TYPE_DATA) != 0) {
+        printf("launch failed\n");
+        return 1;
+    }
+
+    check_dispatch(&poll_cb);
+
+    printf("%d streams: start and stop %lld ns async, %lld ns sync\n",
+           MAX_STREAM_NUM_IN_BUNDLE,
+           (long long)start_stop_ns(&poll_cb, iterations, mm_camera_async_call),
+           (long long)start_stop_ns(&poll_cb, iterations, mm_camera_sync_call));
+    printf("dispatch %lld ns\n", (long long)dispatch_ns(&poll_cb, iterations * 10));
+
+    mm_camera_poll_thread_release(&poll_cb);
+    for (i = 0; i < MAX_STREAM_NUM_IN_BUNDLE; i++) {
+        close(streams[i].fds[0]);
+        close(streams[i].fds[1]);
+        cam_sem_destroy(&streams[i].sem);
+    }
+
+    printf("%s\n", failures ? "SOMETHING FAILED" : "ALL PASSED");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,499 @@
+/* Copyright (c) 2016, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mm_camera.h"
+
+/*
+ * Checks the channel superbuf matching on synthetic frames from a metadata,
+ * a preview and a snapshot stream: in order, with dropped and reordered
+ * buffers, with more unmatched frames than index slots and with low priority
+ * metadata matching. Every buffer must come out exactly once, in a matched
+ * superbuf or returned to its stream. Then times a buffer arriving with a
+ * deep ZSL queue of matched superbufs waiting.
+ *
+ * Run it like this:
+ *
+ * make mm-camera-superbuf-test -j32 && \
+ * adb push $OUT/system/bin/mm-camera-superbuf-test /data/local/tmp && \
+ * adb shell /data/local/tmp/mm-camera-superbuf-test -d 32 -n 20000
+ */
+
+int32_t mm_channel_superbuf_queue_init(mm_channel_queue_t * queue);
+int32_t mm_channel_superbuf_queue_deinit(mm_channel_queue_t * queue);
+int32_t mm_channel_superbuf_comp_and_enqueue(mm_channel_t *ch_obj,
+                                             mm_channel_queue_t * queue,
+                                             mm_camera_buf_info_t *buf);
+mm_channel_queue_node_t* mm_channel_superbuf_dequeue(mm_channel_queue_t * queue);
+int32_t mm_channel_superbuf_flush(mm_channel_t* my_obj,
+        mm_channel_queue_t * queue, cam_stream_type_t cam_type);
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAILED %s:%d: ", __func__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            failures++; \
+        } \
+    } while (0)
+
+#define NUM_STREAMS 3
+#define MAX_BUFS 100000
+
+enum {
+    BUF_IN_CHANNEL,
+    BUF_RETURNED,
+    BUF_DELIVERED,
+};
+
+typedef struct {
+    mm_camera_buf_def_t buf; /* first, the channel only sees this */
+    int state;
+} test_buf_t;
+
+static mm_channel_t ch;
+static cam_stream_info_t stream_infos[NUM_STREAMS];
+static metadata_buffer_t metadata;
+static test_buf_t bufs[MAX_BUFS];
+static int num_bufs;
+
+/* normally in mm_camera_interface.c and the files the channel calls */
+volatile uint32_t gMmCameraIntfLogLevel = 0;
+
+uint8_t mm_camera_util_get_index_by_handler(uint32_t handler)
+{
+    return (handler & 0x000000ff);
+}
+
+uint32_t mm_camera_util_generate_handler(uint8_t index)
+{
+    return index;
+}
+
+int32_t mm_camera_start_zsl_snapshot(mm_camera_obj_t *my_obj)
+{
+    return 0;
+}
+
+int32_t mm_camera_stop_zsl_snapshot(mm_camera_obj_t *my_obj)
+{
+    return 0;
+}
+
+int32_t mm_stream_map_buf(mm_stream_t *my_obj, uint8_t buf_type, uint32_t frame_idx,
+                          int32_t plane_idx, int fd, size_t size)
+{
+    return 0;
+}
+
+int32_t mm_stream_unmap_buf(mm_stream_t *my_obj, uint8_t buf_type, uint32_t frame_idx,
+                            int32_t plane_idx)
+{
+    return 0;
+}
+
+/* the channel gives unwanted buffers back to their stream with QBUF */
+int32_t mm_stream_fsm_fn(mm_stream_t *my_obj, mm_stream_evt_type_t evt,
+                         void *in_val, void *out_val)
+{
+    test_buf_t *buf = (test_buf_t *)in_val;
+
+    if (MM_STREAM_EVT_QBUF == evt) {
+        CHECK(buf->state == BUF_IN_CHANNEL, "frame %u stream %u returned twice",
+              buf->buf.frame_idx, buf->buf.stream_id);
+        buf->state = BUF_RETURNED;
+    }
+    return 0;
+}
+
+static uint32_t rand_state = 1;
+
+static uint32_t next_rand(void)
+{
+    rand_state = rand_state * 1103515245 + 12345;
+    return (rand_state >> 16) & 0x7fff;
+}
+
+static mm_channel_queue_t *setup(mm_camera_super_buf_priority_t priority,
+                                 uint8_t max_unmatched_frames)
+{
+    mm_channel_queue_t *queue = &ch.bundle.superbuf_queue;
+    int i;
+
+    memset(&ch, 0, sizeof(ch));
+    stream_infos[0].stream_type = CAM_STREAM_TYPE_METADATA;
+    stream_infos[1].stream_type = CAM_STREAM_TYPE_PREVIEW;
+    stream_infos[2].stream_type = CAM_STREAM_TYPE_SNAPSHOT;
+    for (i = 0; i < NUM_STREAMS; i++) {
+        ch.streams[i].state = MM_STREAM_STATE_ACTIVE;
+        ch.streams[i].my_hdl = 0x100 | i;
+        ch.streams[i].stream_info = &stream_infos[i];
+        ch.streams[i].ch_obj = &ch;
+    }
+
+    mm_channel_superbuf_queue_init(queue);
+    queue->num_streams = NUM_STREAMS;
+    for (i = 0; i < NUM_STREAMS; i++) {
+        queue->bundled_streams[i] = 0x100 | i;
+    }
+    queue->attr.notify_mode = MM_CAMERA_SUPER_BUF_NOTIFY_CONTINUOUS;
+    queue->attr.water_mark = 255;
+    queue->attr.max_unmatched_frames = max_unmatched_frames;
+    queue->attr.priority = priority;
+    num_bufs = 0;
+    return queue;
+}
+
+static void arrive(mm_channel_queue_t *queue, int stream, uint32_t frame_idx)
+{
+    test_buf_t *buf;
+    mm_camera_buf_info_t buf_info;
+
+    if (num_bufs == MAX_BUFS) {
+        printf("out of test buffers\n");
+        exit(1);
+    }
+    buf = &bufs[num_bufs++];
+    memset(buf, 0, sizeof(*buf));
+    buf->buf.stream_id = 0x100 | stream;
+    buf->buf.stream_type = stream_infos[stream].stream_type;
+    buf->buf.frame_idx = frame_idx;
+    buf->buf.buffer = (stream == 0) ? &metadata : NULL;
+    buf->state = BUF_IN_CHANNEL;
+
+    buf_info.stream_id = buf->buf.stream_id;
+    buf_info.frame_idx = frame_idx;
+    buf_info.flags = 0;
+    buf_info.buf = &buf->buf;
+    mm_channel_superbuf_comp_and_enqueue(&ch, queue, &buf_info);
+}
+
+/* takes the matched superbufs off the queue, storing their frames */
+static int drain(mm_channel_queue_t *queue, uint32_t *frames, int max_frames)
+{
+    mm_channel_queue_node_t *super_buf;
+    int n = 0, i;
+
+    while ((super_buf = mm_channel_superbuf_dequeue(queue)) != NULL) {
+        for (i = 0; i < super_buf->num_of_bufs; i++) {
+            test_buf_t *buf = (test_buf_t *)super_buf->super_buf[i].buf;
+            CHECK(buf != NULL, "frame %u has no buf %d", super_buf->frame_idx, i);
+            if (buf != NULL) {
+                CHECK(buf->state == BUF_IN_CHANNEL, "frame %u buf %d delivered twice",
+                      super_buf->frame_idx, i);
+                buf->state = BUF_DELIVERED;
+            }
+        }
+        if (n < max_frames) {
+            frames[n] = super_buf->frame_idx;
+        }
+        n++;
+        free(super_buf);
+    }
+    return n;
+}
+
+/* the unmatched list holds the unmatched superbufs in queue order, which is
+ * frame order, and every slot holds an unmatched superbuf of its frame */
+static void check_queue(mm_channel_queue_t *queue)
+{
+    struct cam_list *pos, *unmatched = queue->unmatched.next;
+    mm_channel_queue_node_t *super_buf, *prev = NULL;
+    uint32_t count = 0, indexed = 0, i;
+
+    for (pos = queue->que.head.list.next; pos != &queue->que.head.list; pos = pos->next) {
+        super_buf = (mm_channel_queue_node_t *)member_of(pos, cam_node_t, list)->data;
+        CHECK(&super_buf->node->list == pos, "frame %u has a stale node", super_buf->frame_idx);
+        if (super_buf->matched) {
+            continue;
+        }
+        CHECK(unmatched == &super_buf->unmatched, "frame %u out of unmatched order",
+              super_buf->frame_idx);
+        CHECK(prev == NULL || prev->frame_idx < super_buf->frame_idx,
+              "frame %u queued after %u", super_buf->frame_idx, prev->frame_idx);
+        unmatched = unmatched->next;
+        prev = super_buf;
+        count++;
+    }
+    CHECK(unmatched == &queue->unmatched, "unmatched list longer than queue");
+    CHECK(count == queue->unmatched_cnt, "%u unmatched, count %u", count, queue->unmatched_cnt);
+    for (i = 0; i < MM_CHANNEL_FRAME_SLOTS; i++) {
+        super_buf = queue->frame_slots[i];
+        if (super_buf != NULL) {
+            CHECK(!super_buf->matched && super_buf->frame_idx % MM_CHANNEL_FRAME_SLOTS == i,
+                  "slot %u holds frame %u", i, super_buf->frame_idx);
+            indexed++;
+        }
+    }
+    CHECK(indexed + queue->unindexed_cnt == count, "%u indexed, %u unindexed, %u unmatched",
+          indexed, queue->unindexed_cnt, count);
+}
+
+/* flushes the queue, after which every buffer must be out of the channel */
+static void finish(mm_channel_queue_t *queue)
+{
+    int i, left = 0;
+
+    mm_channel_superbuf_flush(&ch, queue, CAM_STREAM_TYPE_DEFAULT);
+    for (i = 0; i < num_bufs; i++) {
+        if (bufs[i].state == BUF_IN_CHANNEL) {
+            left++;
+        }
+    }
+    CHECK(left == 0, "%d buffers left in the channel", left);
+    CHECK(queue->unmatched_cnt == 0 && queue->unindexed_cnt == 0,
+          "%u unmatched, %u unindexed after flush", queue->unmatched_cnt, queue->unindexed_cnt);
+    mm_channel_superbuf_queue_deinit(queue);
+}
+
+static void test_in_order(void)
+{
+    mm_channel_queue_t *queue = setup(MM_CAMERA_SUPER_BUF_PRIORITY_NORMAL, 2);
+    uint32_t frame, delivered;
+    int stream;
+
+    for (frame = 1; frame <= 200; frame++) {
+        for (stream = 0; stream < NUM_STREAMS; stream++) {
+            arrive(queue, stream, frame);
+        }
+        CHECK(drain(queue, &delivered, 1) == 1 && delivered == frame,
+              "frame %u not delivered", frame);
+    }
+    check_queue(queue);
+    finish(queue);
+}
+
+/* in order with drops: every frame with all its buffers is delivered */
+static void test_drops(void)
+{
+    mm_channel_queue_t *queue = setup(MM_CAMERA_SUPER_BUF_PRIORITY_NORMAL, 2);
+    uint32_t frame, delivered[4];
+    int stream, n, complete;
+
+    for (frame = 1; frame <= 2000; frame++) {
+        complete = 1;
+        for (stream = 0; stream < NUM_STREAMS; stream++) {
+            if (next_rand() % 8 == 0) {
+                complete = 0;
+            } else {
+                arrive(queue, stream, frame);
+            }
+        }
+        check_queue(queue);
+        n = drain(queue, delivered, 4);
+        CHECK(n == complete && (!complete || delivered[0] == frame),
+              "frame %u: %d delivered, complete %d", frame, n, complete);
+    }
+    finish(queue);
+}
+
+/* buffers of up to 3 frames interleaved, and some dropped */
+static void test_reorder(void)
+{
+    mm_channel_queue_t *queue = setup(MM_CAMERA_SUPER_BUF_PRIORITY_NORMAL, 4);
+    struct { uint32_t frame; int stream; uint32_t key; } events[3 * NUM_STREAMS], tmp;
+    uint32_t base, delivered[16], last = 0;
+    int num_events, i, j, n;
+
+    for (base = 1; base <= 3000; base += 3) {
+        num_events = 0;
+        for (i = 0; i < 3 * NUM_STREAMS; i++) {
+            if (next_rand() % 16 == 0) {
+                continue;
+            }
+            events[num_events].frame = base + i / NUM_STREAMS;
+            events[num_events].stream = i % NUM_STREAMS;
+            events[num_events].key = events[num_events].frame * 4 + next_rand() % 8;
+            num_events++;
+        }
+        for (i = 1; i < num_events; i++) {
+            for (j = i; j > 0 && events[j - 1].key > events[j].key; j--) {
+                tmp = events[j];
+                events[j] = events[j - 1];
+                events[j - 1] = tmp;
+            }
+        }
+        for (i = 0; i < num_events; i++) {
+            arrive(queue, events[i].stream, events[i].frame);
+            check_queue(queue);
+        }
+        n = drain(queue, delivered, 16);
+        for (i = 0; i < n && i < 16; i++) {
+            CHECK(delivered[i] > last, "frame %u delivered after %u", delivered[i], last);
+            last = delivered[i];
+        }
+    }
+    CHECK(last > 2900, "last frame delivered %u", last);
+    finish(queue);
+}
+
+/* more unmatched frames than slots, so some share a slot */
+static void test_collisions(void)
+{
+    mm_channel_queue_t *queue = setup(MM_CAMERA_SUPER_BUF_PRIORITY_NORMAL, 60);
+    uint32_t frame, delivered[8];
+    int n, i;
+
+    for (frame = 1; frame <= 40; frame++) {
+        arrive(queue, 0, frame);
+    }
+    check_queue(queue);
+    CHECK(queue->unindexed_cnt == 40 - MM_CHANNEL_FRAME_SLOTS, "%u unindexed",
+          queue->unindexed_cnt);
+
+    /* matching a frame gives back the older unmatched ones */
+    arrive(queue, 1, 36);
+    arrive(queue, 2, 36);
+    check_queue(queue);
+    CHECK(queue->unmatched_cnt == 4, "%u unmatched", queue->unmatched_cnt);
+    for (i = 0; i < 35; i++) {
+        CHECK(bufs[i].state == BUF_RETURNED, "frame %u not returned", bufs[i].buf.frame_idx);
+    }
+    for (frame = 37; frame <= 40; frame++) {
+        arrive(queue, 2, frame);
+        arrive(queue, 1, frame);
+        check_queue(queue);
+    }
+    n = drain(queue, delivered, 8);
+    CHECK(n == 5 && delivered[0] == 36 && delivered[4] == 40, "%d delivered", n);
+    CHECK(queue->unindexed_cnt == 0, "%u unindexed", queue->unindexed_cnt);
+    finish(queue);
+}
+
+/* low priority: frames go ahead without their metadata, late metadata and
+ * older frames of the other streams join the first superbuf lacking them */
+static void test_low_priority(void)
+{
+    mm_channel_queue_t *queue = setup(MM_CAMERA_SUPER_BUF_PRIORITY_LOW, 2);
+    uint32_t delivered[2];
+
+    arrive(queue, 1, 10);
+    CHECK(queue->nomatch_frame_id == 10, "nomatch frame %u", queue->nomatch_frame_id);
+    /* metadata older than the frame is dropped */
+    arrive(queue, 0, 9);
+    CHECK(bufs[1].state == BUF_RETURNED, "old metadata kept");
+    arrive(queue, 0, 12);
+    CHECK(queue->nomatch_frame_id == 0, "nomatch frame %u", queue->nomatch_frame_id);
+    arrive(queue, 2, 10);
+    check_queue(queue);
+    CHECK(drain(queue, delivered, 2) == 1 && delivered[0] == 10, "frame 10 not delivered");
+
+    arrive(queue, 1, 20);
+    arrive(queue, 2, 18);
+    check_queue(queue);
+    CHECK(queue->unmatched_cnt == 1, "%u unmatched", queue->unmatched_cnt);
+    arrive(queue, 0, 20);
+    CHECK(drain(queue, delivered, 2) == 1 && delivered[0] == 20, "frame 20 not delivered");
+    CHECK(bufs[5].state == BUF_DELIVERED, "frame 20 superbuf without snapshot 18");
+    finish(queue);
+}
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* ZSL: keep depth matched superbufs queued, as the look back does */
+static int64_t zsl_buf_ns(int depth, int frames)
+{
+    mm_channel_queue_t *queue = setup(MM_CAMERA_SUPER_BUF_PRIORITY_NORMAL, 2);
+    mm_channel_queue_node_t *super_buf;
+    int64_t start, total = 0;
+    uint32_t frame;
+    int stream, i;
+
+    for (frame = 1; frame <= (uint32_t)frames; frame++) {
+        if (num_bufs + NUM_STREAMS > MAX_BUFS) {
+            num_bufs = 0;
+        }
+        start = now_ns();
+        for (stream = 0; stream < NUM_STREAMS; stream++) {
+            /* drop a snapshot now and then to keep some frames unmatched */
+            if (stream != 2 || frame % 16 != 0) {
+                arrive(queue, stream, frame);
+            }
+        }
+        total += now_ns() - start;
+        while (queue->match_cnt > (uint32_t)depth) {
+            super_buf = mm_channel_superbuf_dequeue(queue);
+            for (i = 0; i < super_buf->num_of_bufs; i++) {
+                ((test_buf_t *)super_buf->super_buf[i].buf)->state = BUF_DELIVERED;
+            }
+            free(super_buf);
+        }
+    }
+    mm_channel_superbuf_flush(&ch, queue, CAM_STREAM_TYPE_DEFAULT);
+    mm_channel_superbuf_queue_deinit(queue);
+    return total / frames / NUM_STREAMS;
+}
+
+int main(int argc, char **argv)
+{
+    int depth = 32, frames = 20000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:n:")) != -1) {
+        switch (opt) {
+        case 'd':
+            depth = atoi(optarg);
+            break;
+        case 'n':
+            frames = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-d zsl depth] [-n frames]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (frames < 1) {
+        frames = 1;
+    }
+
+    test_in_order();
+    test_drops();
+    test_reorder();
+    test_collisions();
+    test_low_priority();
+
+    printf("%d matched superbufs queued: %lld ns per buf\n", depth,
+           (long long)zsl_buf_ns(depth, frames));
+
+    printf("%s\n", failures ? "SOMETHING FAILED" : "ALL PASSED");
+    return failures ? 1 : 0;
+}
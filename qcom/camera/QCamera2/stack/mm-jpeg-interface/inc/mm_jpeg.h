@@ -252,10 +252,16 @@ typedef union {
   mm_jpeg_q_data_t data;
 } mm_jpeg_q_node_t;
 
+/* nodes each queue allocates up front, and the most it keeps for reuse */
+#define MM_JPEG_QUEUE_PREALLOC_NODES 4
+#define MM_JPEG_QUEUE_MAX_FREE_NODES 32
+
 typedef struct {
   mm_jpeg_q_node_t head; /* dummy head */
   uint32_t size;
   pthread_mutex_t lock;
+  struct cam_list free_nodes; /* dequeued nodes kept for the next enqueue */
+  uint32_t free_size;
 } mm_jpeg_queue_t;
 
 typedef enum {
@@ -459,6 +465,9 @@ extern int32_t mm_jpeg_queue_deinit(mm_jpeg_queue_t* queue);
 extern int32_t mm_jpeg_queue_flush(mm_jpeg_queue_t* queue);
 extern uint32_t mm_jpeg_queue_get_size(mm_jpeg_queue_t* queue);
 extern mm_jpeg_q_data_t mm_jpeg_queue_peek(mm_jpeg_queue_t* queue);
+/* gives back a node taken out of the queue, with queue->lock held */
+extern void mm_jpeg_queue_put_node(mm_jpeg_queue_t* queue,
+    mm_jpeg_q_node_t* node);
 extern int32_t addExifEntry(QOMX_EXIF_INFO *p_exif_info, exif_tag_id_t tagid,
   exif_tag_type_t type, uint32_t count, void *data);
 extern int32_t releaseExifEntry(QEXIF_INFO_DATA *p_exif_data);
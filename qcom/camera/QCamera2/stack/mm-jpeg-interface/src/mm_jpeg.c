@@ -2853,7 +2853,7 @@ mm_jpeg_job_q_node_t* mm_jpeg_queue_remove_job_by_client_id(
       job_node = data;
       cam_list_del_node(&node->list);
       queue->size--;
-      free(node);
+      mm_jpeg_queue_put_node(queue, node);
       CDBG_HIGH("%s: queue size = %d", __func__, queue->size);
       break;
     }
@@ -2887,7 +2887,7 @@ mm_jpeg_job_q_node_t* mm_jpeg_queue_remove_job_by_session_id(
       job_node = data;
       cam_list_del_node(&node->list);
       queue->size--;
-      free(node);
+      mm_jpeg_queue_put_node(queue, node);
       CDBG_HIGH("%s: queue size = %d", __func__, queue->size);
       break;
     }
@@ -2934,7 +2934,7 @@ mm_jpeg_job_q_node_t* mm_jpeg_queue_remove_job_by_job_id(
       job_node = data;
       cam_list_del_node(&node->list);
       queue->size--;
-      free(node);
+      mm_jpeg_queue_put_node(queue, node);
       break;
     }
     pos = pos->next;
@@ -2965,7 +2965,7 @@ mm_jpeg_job_q_node_t* mm_jpeg_queue_remove_job_unlk(
       job_node = data;
       cam_list_del_node(&node->list);
       queue->size--;
-      free(node);
+      mm_jpeg_queue_put_node(queue, node);
       break;
     }
     pos = pos->next;
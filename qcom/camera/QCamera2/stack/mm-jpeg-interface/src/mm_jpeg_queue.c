@@ -31,27 +31,67 @@
 #include "mm_jpeg_dbg.h"
 #include "mm_jpeg.h"
 
+/* takes a node from the free nodes, allocating one only when there are none.
+ * queue->lock must be held */
+static mm_jpeg_q_node_t* mm_jpeg_queue_get_node(mm_jpeg_queue_t* queue)
+{
+    mm_jpeg_q_node_t* node = NULL;
+
+    if (queue->free_nodes.next != &queue->free_nodes) {
+        node = member_of(queue->free_nodes.next, mm_jpeg_q_node_t, list);
+        cam_list_del_node(&node->list);
+        queue->free_size--;
+    } else {
+        node = (mm_jpeg_q_node_t *)malloc(sizeof(mm_jpeg_q_node_t));
+        if (NULL == node) {
+            CDBG_ERROR("%s: No memory for mm_jpeg_q_node_t", __func__);
+            return NULL;
+        }
+    }
+    memset(node, 0, sizeof(mm_jpeg_q_node_t));
+    return node;
+}
+
+void mm_jpeg_queue_put_node(mm_jpeg_queue_t* queue, mm_jpeg_q_node_t* node)
+{
+    if (queue->free_size < MM_JPEG_QUEUE_MAX_FREE_NODES) {
+        cam_list_insert_before_node(&node->list, queue->free_nodes.next);
+        queue->free_size++;
+    } else {
+        free(node);
+    }
+}
+
 int32_t mm_jpeg_queue_init(mm_jpeg_queue_t* queue)
 {
     pthread_mutex_init(&queue->lock, NULL);
     cam_list_init(&queue->head.list);
     queue->size = 0;
+    cam_list_init(&queue->free_nodes);
+    queue->free_size = 0;
+    while (queue->free_size < MM_JPEG_QUEUE_PREALLOC_NODES) {
+        mm_jpeg_q_node_t* node =
+            (mm_jpeg_q_node_t *)malloc(sizeof(mm_jpeg_q_node_t));
+        if (NULL == node) {
+            break;
+        }
+        cam_list_add_tail_node(&node->list, &queue->free_nodes);
+        queue->free_size++;
+    }
     return 0;
 }
 
 int32_t mm_jpeg_queue_enq(mm_jpeg_queue_t* queue, mm_jpeg_q_data_t data)
 {
-    mm_jpeg_q_node_t* node =
-        (mm_jpeg_q_node_t *)malloc(sizeof(mm_jpeg_q_node_t));
+    mm_jpeg_q_node_t* node = NULL;
+
+    pthread_mutex_lock(&queue->lock);
+    node = mm_jpeg_queue_get_node(queue);
     if (NULL == node) {
-        CDBG_ERROR("%s: No memory for mm_jpeg_q_node_t", __func__);
+        pthread_mutex_unlock(&queue->lock);
         return -1;
     }
-
-    memset(node, 0, sizeof(mm_jpeg_q_node_t));
     node->data = data;
-
-    pthread_mutex_lock(&queue->lock);
     cam_list_add_tail_node(&node->list, &queue->head.list);
     queue->size++;
     pthread_mutex_unlock(&queue->lock);
@@ -62,23 +102,16 @@ int32_t mm_jpeg_queue_enq(mm_jpeg_queue_t* queue, mm_jpeg_q_data_t data)
 
 int32_t mm_jpeg_queue_enq_head(mm_jpeg_queue_t* queue, mm_jpeg_q_data_t data)
 {
-  struct cam_list *head = NULL;
-  struct cam_list *pos = NULL;
-  mm_jpeg_q_node_t* node =
-        (mm_jpeg_q_node_t *)malloc(sizeof(mm_jpeg_q_node_t));
+    mm_jpeg_q_node_t* node = NULL;
+
+    pthread_mutex_lock(&queue->lock);
+    node = mm_jpeg_queue_get_node(queue);
     if (NULL == node) {
-        CDBG_ERROR("%s: No memory for mm_jpeg_q_node_t", __func__);
+        pthread_mutex_unlock(&queue->lock);
         return -1;
     }
-
-    memset(node, 0, sizeof(mm_jpeg_q_node_t));
     node->data = data;
-
-    head = &queue->head.list;
-    pos = head->next;
-
-    pthread_mutex_lock(&queue->lock);
-    cam_list_insert_before_node(&node->list, pos);
+    cam_list_insert_before_node(&node->list, queue->head.list.next);
     queue->size++;
     pthread_mutex_unlock(&queue->lock);
 
@@ -101,13 +134,10 @@ mm_jpeg_q_data_t mm_jpeg_queue_deq(mm_jpeg_queue_t* queue)
         node = member_of(pos, mm_jpeg_q_node_t, list);
         cam_list_del_node(&node->list);
         queue->size--;
-    }
-    pthread_mutex_unlock(&queue->lock);
-
-    if (NULL != node) {
         data = node->data;
-        free(node);
+        mm_jpeg_queue_put_node(queue, node);
     }
+    pthread_mutex_unlock(&queue->lock);
 
     return data;
 }
@@ -126,7 +156,15 @@ uint32_t mm_jpeg_queue_get_size(mm_jpeg_queue_t* queue)
 
 int32_t mm_jpeg_queue_deinit(mm_jpeg_queue_t* queue)
 {
+    mm_jpeg_q_node_t* node = NULL;
+
     mm_jpeg_queue_flush(queue);
+    while (queue->free_nodes.next != &queue->free_nodes) {
+        node = member_of(queue->free_nodes.next, mm_jpeg_q_node_t, list);
+        cam_list_del_node(&node->list);
+        free(node);
+    }
+    queue->free_size = 0;
     pthread_mutex_destroy(&queue->lock);
     return 0;
 }
@@ -143,6 +181,7 @@ int32_t mm_jpeg_queue_flush(mm_jpeg_queue_t* queue)
 
     while(pos != head) {
         node = member_of(pos, mm_jpeg_q_node_t, list);
+        pos = pos->next;
         cam_list_del_node(&node->list);
         queue->size--;
 
@@ -151,8 +190,7 @@ int32_t mm_jpeg_queue_flush(mm_jpeg_queue_t* queue)
         if (NULL != node->data.p) {
             free(node->data.p);
         }
-        free(node);
-        pos = pos->next;
+        mm_jpeg_queue_put_node(queue, node);
     }
     queue->size = 0;
     pthread_mutex_unlock(&queue->lock);
@@ -50,6 +50,10 @@ QCameraQueue::QCameraQueue()
     m_dataFn = NULL;
     m_userData = NULL;
     m_active = true;
+    cam_list_init(&m_freeNodes);
+    m_numFreeNodes = 0;
+    m_maxFreeNodes = QCAMERA_QUEUE_MAX_FREE_NODES;
+    reserveNodes(QCAMERA_QUEUE_PREALLOC_NODES);
 }
 
 /*===========================================================================
@@ -71,6 +75,10 @@ QCameraQueue::QCameraQueue(release_data_fn data_rel_fn, void *user_data)
     m_dataFn = data_rel_fn;
     m_userData = user_data;
     m_active = true;
+    cam_list_init(&m_freeNodes);
+    m_numFreeNodes = 0;
+    m_maxFreeNodes = QCAMERA_QUEUE_MAX_FREE_NODES;
+    reserveNodes(QCAMERA_QUEUE_PREALLOC_NODES);
 }
 
 /*===========================================================================
@@ -85,9 +93,110 @@ QCameraQueue::QCameraQueue(release_data_fn data_rel_fn, void *user_data)
 QCameraQueue::~QCameraQueue()
 {
     flush();
+    setMaxFreeNodes(0);
     pthread_mutex_destroy(&m_lock);
 }
 
+/*===========================================================================
+ * FUNCTION   : setMaxFreeNodes
+ *
+ * DESCRIPTION: set how many dequeued nodes the queue keeps for reuse, freeing
+ *              any above the new limit
+ *
+ * PARAMETERS :
+ *   @count   : max number of free nodes kept
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraQueue::setMaxFreeNodes(int count)
+{
+    pthread_mutex_lock(&m_lock);
+    m_maxFreeNodes = count;
+    while (m_numFreeNodes > m_maxFreeNodes) {
+        camera_q_node *node = member_of(m_freeNodes.next, camera_q_node, list);
+        cam_list_del_node(&node->list);
+        m_numFreeNodes--;
+        free(node);
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : reserveNodes
+ *
+ * DESCRIPTION: allocate free nodes up front, so that the first enqueues do not
+ *              have to. Only called from the constructors.
+ *
+ * PARAMETERS :
+ *   @count   : number of free nodes wanted
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraQueue::reserveNodes(int count)
+{
+    while (m_numFreeNodes < count) {
+        camera_q_node *node = (camera_q_node *)malloc(sizeof(camera_q_node));
+        if (NULL == node) {
+            ALOGE("%s: No memory for camera_q_node", __func__);
+            break;
+        }
+        cam_list_add_tail_node(&node->list, &m_freeNodes);
+        m_numFreeNodes++;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : getNode
+ *
+ * DESCRIPTION: take a node to enqueue from the free nodes, allocating one only
+ *              when there are none. m_lock must be held.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : node ptr. NULL if no memory.
+ *==========================================================================*/
+QCameraQueue::camera_q_node *QCameraQueue::getNode()
+{
+    camera_q_node *node = NULL;
+
+    if (m_freeNodes.next != &m_freeNodes) {
+        node = member_of(m_freeNodes.next, camera_q_node, list);
+        cam_list_del_node(&node->list);
+        m_numFreeNodes--;
+    } else {
+        node = (camera_q_node *)malloc(sizeof(camera_q_node));
+        if (NULL == node) {
+            ALOGE("%s: No memory for camera_q_node", __func__);
+            return NULL;
+        }
+        cam_list_init(&node->list);
+    }
+    node->data = NULL;
+    return node;
+}
+
+/*===========================================================================
+ * FUNCTION   : putNode
+ *
+ * DESCRIPTION: give back a node that is no longer in the queue, keeping it for
+ *              the next enqueue. m_lock must be held.
+ *
+ * PARAMETERS :
+ *   @node    : node removed from the queue
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraQueue::putNode(camera_q_node *node)
+{
+    if (m_numFreeNodes < m_maxFreeNodes) {
+        /* at the head, so the next enqueue gets the most recently used node */
+        cam_list_insert_before_node(&node->list, m_freeNodes.next);
+        m_numFreeNodes++;
+    } else {
+        free(node);
+    }
+}
+
 /*===========================================================================
  * FUNCTION   : init
  *
@@ -136,25 +245,18 @@ bool QCameraQueue::isEmpty()
  *==========================================================================*/
 bool QCameraQueue::enqueue(void *data)
 {
-    bool rc;
-    camera_q_node *node =
-        (camera_q_node *)malloc(sizeof(camera_q_node));
-    if (NULL == node) {
-        ALOGE("%s: No memory for camera_q_node", __func__);
-        return false;
-    }
-
-    memset(node, 0, sizeof(camera_q_node));
-    node->data = data;
+    bool rc = false;
+    camera_q_node *node = NULL;
 
     pthread_mutex_lock(&m_lock);
     if (m_active) {
-        cam_list_add_tail_node(&node->list, &m_head.list);
-        m_size++;
-        rc = true;
-    } else {
-        free(node);
-        rc = false;
+        node = getNode();
+        if (NULL != node) {
+            node->data = data;
+            cam_list_add_tail_node(&node->list, &m_head.list);
+            m_size++;
+            rc = true;
+        }
     }
     pthread_mutex_unlock(&m_lock);
     return rc;
@@ -173,31 +275,18 @@ bool QCameraQueue::enqueue(void *data)
  *==========================================================================*/
 bool QCameraQueue::enqueueWithPriority(void *data)
 {
-    bool rc;
-    camera_q_node *node =
-        (camera_q_node *)malloc(sizeof(camera_q_node));
-    if (NULL == node) {
-        ALOGE("%s: No memory for camera_q_node", __func__);
-        return false;
-    }
-
-    memset(node, 0, sizeof(camera_q_node));
-    node->data = data;
+    bool rc = false;
+    camera_q_node *node = NULL;
 
     pthread_mutex_lock(&m_lock);
     if (m_active) {
-        struct cam_list *p_next = m_head.list.next;
-
-        m_head.list.next = &node->list;
-        p_next->prev = &node->list;
-        node->list.next = p_next;
-        node->list.prev = &m_head.list;
-
-        m_size++;
-        rc = true;
-    } else {
-        free(node);
-        rc = false;
+        node = getNode();
+        if (NULL != node) {
+            node->data = data;
+            cam_list_insert_before_node(&node->list, m_head.list.next);
+            m_size++;
+            rc = true;
+        }
     }
     pthread_mutex_unlock(&m_lock);
     return rc;
@@ -266,15 +355,12 @@ void* QCameraQueue::dequeue(bool bFromHead)
             node = member_of(pos, camera_q_node, list);
             cam_list_del_node(&node->list);
             m_size--;
+            data = node->data;
+            putNode(node);
         }
     }
     pthread_mutex_unlock(&m_lock);
 
-    if (NULL != node) {
-        data = node->data;
-        free(node);
-    }
-
     return data;
 }
 
@@ -310,7 +396,7 @@ void QCameraQueue::flush(){
                 }
                 free(node->data);
             }
-            free(node);
+            putNode(node);
 
         }
         m_size = 0;
@@ -357,7 +443,7 @@ void QCameraQueue::flushNodes(match_fn match){
                     }
                     free(node->data);
                 }
-                free(node);
+                putNode(node);
             }
         }
     }
@@ -402,7 +488,7 @@ void QCameraQueue::flushNodes(match_fn_data match, void *match_data){
                     }
                     free(node->data);
                 }
-                free(node);
+                putNode(node);
             }
         }
     }
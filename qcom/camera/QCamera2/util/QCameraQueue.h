@@ -35,6 +35,10 @@
 
 namespace qcamera {
 
+/* nodes each queue allocates up front, and the most it keeps for reuse */
+#define QCAMERA_QUEUE_PREALLOC_NODES 8
+#define QCAMERA_QUEUE_MAX_FREE_NODES 64
+
 typedef bool (*match_fn_data)(void *data, void *user_data, void *match_data);
 typedef void (*release_data_fn)(void* data, void *user_data);
 typedef bool (*match_fn)(void *data, void *user_data);
@@ -56,14 +60,23 @@ public:
     void* peek();
     bool isEmpty();
     int getCurrentSize() {return m_size;}
+    /* 0 allocates and frees a node per enqueue, for benchmarking */
+    void setMaxFreeNodes(int count);
 private:
     typedef struct {
         struct cam_list list;
         void* data;
     } camera_q_node;
 
+    void reserveNodes(int count);
+    camera_q_node *getNode();
+    void putNode(camera_q_node *node);
+
     camera_q_node m_head; // dummy head
     int m_size;
+    struct cam_list m_freeNodes; // dequeued nodes kept for the next enqueue
+    int m_numFreeNodes;
+    int m_maxFreeNodes;
     bool m_active;
     pthread_mutex_t m_lock;
     release_data_fn m_dataFn;
@@ -0,0 +1,21 @@
+LOCAL_PATH := $(call my-dir)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+        qcamera_queue_benchmark.cpp \
+        ../QCameraQueue.cpp
+
+LOCAL_MODULE := qcamera_queue_benchmark
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_C_INCLUDES := \
+        $(LOCAL_PATH)/.. \
+        $(LOCAL_PATH)/../../stack/common
+
+LOCAL_CFLAGS := -Wall -Wextra -Werror -O2
+
+LOCAL_SHARED_LIBRARIES := liblog libutils
+
+LOCAL_32_BIT_ONLY := $(BOARD_QTI_CAMERA_32BIT_ONLY)
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,344 @@
+/* Copyright (c) 2016, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <cam_semaphore.h>
+#include "QCameraQueue.h"
+
+using namespace qcamera;
+
+/*
+ * Checks QCameraQueue and times an enqueue and dequeue, then the HAL1 stream
+ * callback to postproc pipeline through it: -s stream callback threads each
+ * queue -f frames on the postproc input queue and wake the postproc thread,
+ * which moves them onto the JPEG queue for a JPEG thread to release. Both are
+ * timed with the queues reusing their dequeued nodes and allocating a node per
+ * enqueue.
+ *
+ * Run it like this:
+ *
+ * make qcamera_queue_benchmark -j32 && \
+ * adb push $OUT/system/bin/qcamera_queue_benchmark /data/local/tmp && \
+ * adb shell /data/local/tmp/qcamera_queue_benchmark -s 3 -f 20000
+ */
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAILED %s:%d: ", __func__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            failures++; \
+        } \
+    } while (0)
+
+static int *new_value(int value)
+{
+    int *data = (int *)malloc(sizeof(int));
+    *data = value;
+    return data;
+}
+
+static int take_value(void *data)
+{
+    int value = data ? *(int *)data : -1;
+    free(data);
+    return value;
+}
+
+static void count_release(void * /*data*/, void *user_data)
+{
+    (*(int *)user_data)++;
+}
+
+static bool match_odd(void *data, void * /*user_data*/)
+{
+    return *(int *)data % 2 != 0;
+}
+
+static bool match_value(void *data, void * /*user_data*/, void *match_data)
+{
+    return *(int *)data == *(int *)match_data;
+}
+
+static void test_queue(int max_free_nodes)
+{
+    int released = 0;
+    QCameraQueue queue(count_release, &released);
+    int i, value;
+
+    queue.setMaxFreeNodes(max_free_nodes);
+
+    queue.enqueue(new_value(1));
+    queue.enqueue(new_value(2));
+    queue.enqueue(new_value(3));
+    queue.enqueueWithPriority(new_value(0));
+    CHECK(queue.getCurrentSize() == 4, "size %d", queue.getCurrentSize());
+    CHECK(*(int *)queue.peek() == 0, "priority enqueue not at the head");
+    CHECK(take_value(queue.dequeue()) == 0, "head");
+    CHECK(take_value(queue.dequeue(false)) == 3, "tail");
+    CHECK(take_value(queue.dequeue()) == 1, "head after tail");
+    CHECK(take_value(queue.dequeue()) == 2, "last");
+    CHECK(queue.dequeue() == NULL && queue.isEmpty(), "queue not empty");
+
+    /* past the preallocated and the kept nodes, in order */
+    for (i = 0; i < 3 * QCAMERA_QUEUE_MAX_FREE_NODES; i++)
+        queue.enqueue(new_value(i));
+    for (i = 0; i < 3 * QCAMERA_QUEUE_MAX_FREE_NODES; i++) {
+        value = take_value(queue.dequeue());
+        if (value != i) {
+            CHECK(value == i, "dequeued %d, expected %d", value, i);
+            break;
+        }
+    }
+
+    for (i = 0; i < 10; i++)
+        queue.enqueue(new_value(i));
+    queue.flushNodes(match_odd);
+    CHECK(released == 5 && queue.getCurrentSize() == 5, "flushNodes released %d, left %d",
+          released, queue.getCurrentSize());
+    value = 4;
+    queue.flushNodes(match_value, &value);
+    CHECK(released == 6 && queue.getCurrentSize() == 4, "flushNodes with data released %d",
+          released);
+    CHECK(take_value(queue.dequeue()) == 0 && take_value(queue.dequeue()) == 2,
+          "flushNodes broke the order");
+    queue.enqueueWithPriority(new_value(2));
+    CHECK(take_value(queue.dequeue()) == 2 && take_value(queue.dequeue()) == 6 &&
+          take_value(queue.dequeue()) == 8, "enqueue after flushNodes");
+
+    queue.enqueue(new_value(1));
+    queue.enqueue(new_value(2));
+    released = 0;
+    queue.flush();
+    CHECK(released == 2, "flush released %d", released);
+    int *data = new_value(3);
+    CHECK(!queue.enqueue(data), "enqueue after flush");
+    CHECK(!queue.enqueueWithPriority(data), "priority enqueue after flush");
+    queue.init();
+    CHECK(queue.enqueue(data) && take_value(queue.dequeue()) == 3, "enqueue after init");
+}
+
+/* returns the ns an enqueue and dequeue pair takes on one thread */
+static long queue_pair_ns(int pairs, int max_free_nodes)
+{
+    QCameraQueue queue;
+    struct timespec start, end;
+    int value = 0, i;
+
+    queue.setMaxFreeNodes(max_free_nodes);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < pairs; i++) {
+        queue.enqueue(&value);
+        queue.enqueue(&value);
+        queue.dequeue();
+        queue.dequeue();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return ((end.tv_sec - start.tv_sec) * 1000000000L + (end.tv_nsec - start.tv_nsec)) /
+           (2 * pairs);
+}
+
+#define NUM_STREAMS_MAX 8
+
+struct frame {
+    int stream;
+    int idx;
+};
+
+struct pipeline {
+    QCameraQueue input_q;       /* what the stream callbacks hand to postproc */
+    QCameraQueue jpeg_q;        /* what postproc hands to the JPEG thread */
+    cam_semaphore_t pp_sem;
+    cam_semaphore_t jpeg_sem;
+    int frames_per_stream;
+    struct frame *frames[NUM_STREAMS_MAX];
+    int last_idx[NUM_STREAMS_MAX];
+    int received;
+    bool out_of_order;
+};
+
+struct stream_arg {
+    struct pipeline *p;
+    int stream;
+};
+
+static struct frame exit_frame;
+
+static void *stream_cb_thread(void *arg)
+{
+    struct stream_arg *s = (struct stream_arg *)arg;
+    struct pipeline *p = s->p;
+    int i;
+
+    for (i = 0; i < p->frames_per_stream; i++) {
+        /* QCameraPostProcessor::processData() and the DO_NEXT_JOB command */
+        p->input_q.enqueue(&p->frames[s->stream][i]);
+        cam_sem_post(&p->pp_sem);
+    }
+    return NULL;
+}
+
+static void *postproc_thread(void *arg)
+{
+    struct pipeline *p = (struct pipeline *)arg;
+    struct frame *frame;
+
+    do {
+        cam_sem_wait(&p->pp_sem);
+        frame = (struct frame *)p->input_q.dequeue();
+        if (frame != NULL) {
+            p->jpeg_q.enqueue(frame);
+            cam_sem_post(&p->jpeg_sem);
+        }
+    } while (frame != &exit_frame);
+    return NULL;
+}
+
+static void *jpeg_thread(void *arg)
+{
+    struct pipeline *p = (struct pipeline *)arg;
+    struct frame *frame;
+
+    for (;;) {
+        cam_sem_wait(&p->jpeg_sem);
+        frame = (struct frame *)p->jpeg_q.dequeue();
+        if (frame == &exit_frame)
+            break;
+        if (frame == NULL)
+            continue;
+        if (frame->idx != p->last_idx[frame->stream] + 1)
+            p->out_of_order = true;
+        p->last_idx[frame->stream] = frame->idx;
+        p->received++;
+    }
+    return NULL;
+}
+
+/* returns the ns each frame took through the pipeline */
+static long run_pipeline(int num_streams, int frames_per_stream, int max_free_nodes)
+{
+    struct pipeline *p = new pipeline;
+    struct stream_arg args[NUM_STREAMS_MAX];
+    pthread_t streams[NUM_STREAMS_MAX], pp, jpeg;
+    struct timespec start, end;
+    int i, j;
+
+    p->input_q.setMaxFreeNodes(max_free_nodes);
+    p->jpeg_q.setMaxFreeNodes(max_free_nodes);
+    cam_sem_init(&p->pp_sem, 0);
+    cam_sem_init(&p->jpeg_sem, 0);
+    p->frames_per_stream = frames_per_stream;
+    p->received = 0;
+    p->out_of_order = false;
+    for (i = 0; i < num_streams; i++) {
+        p->frames[i] = new frame[frames_per_stream];
+        for (j = 0; j < frames_per_stream; j++) {
+            p->frames[i][j].stream = i;
+            p->frames[i][j].idx = j;
+        }
+        p->last_idx[i] = -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_create(&jpeg, NULL, jpeg_thread, p);
+    pthread_create(&pp, NULL, postproc_thread, p);
+    for (i = 0; i < num_streams; i++) {
+        args[i].p = p;
+        args[i].stream = i;
+        pthread_create(&streams[i], NULL, stream_cb_thread, &args[i]);
+    }
+    for (i = 0; i < num_streams; i++)
+        pthread_join(streams[i], NULL);
+    p->input_q.enqueue(&exit_frame);
+    cam_sem_post(&p->pp_sem);
+    pthread_join(pp, NULL);
+    pthread_join(jpeg, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    CHECK(p->received == num_streams * frames_per_stream, "%d of %d frames through",
+          p->received, num_streams * frames_per_stream);
+    CHECK(!p->out_of_order, "frames of a stream out of order");
+
+    for (i = 0; i < num_streams; i++)
+        delete[] p->frames[i];
+    cam_sem_destroy(&p->pp_sem);
+    cam_sem_destroy(&p->jpeg_sem);
+    delete p;
+
+    return ((end.tv_sec - start.tv_sec) * 1000000000L + (end.tv_nsec - start.tv_nsec)) /
+           (num_streams * frames_per_stream);
+}
+
+int main(int argc, char **argv)
+{
+    int num_streams = 3, frames_per_stream = 20000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:f:")) != -1) {
+        switch (opt) {
+        case 's':
+            num_streams = atoi(optarg);
+            break;
+        case 'f':
+            frames_per_stream = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s streams] [-f frames per stream]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (num_streams < 1 || num_streams > NUM_STREAMS_MAX)
+        num_streams = 3;
+    if (frames_per_stream < 1)
+        frames_per_stream = 1;
+
+    test_queue(QCAMERA_QUEUE_MAX_FREE_NODES);
+    test_queue(0);
+
+    printf("enqueue and dequeue: %ld ns allocating nodes, %ld ns reusing them\n",
+           queue_pair_ns(num_streams * frames_per_stream, 0),
+           queue_pair_ns(num_streams * frames_per_stream, QCAMERA_QUEUE_MAX_FREE_NODES));
+
+    /* once untimed, so both timed runs start with a warm allocator */
+    run_pipeline(num_streams, frames_per_stream, 0);
+    long alloc_ns = run_pipeline(num_streams, frames_per_stream, 0);
+    long reuse_ns = run_pipeline(num_streams, frames_per_stream, QCAMERA_QUEUE_MAX_FREE_NODES);
+    printf("%d streams, %d frames each: %ld ns per frame allocating nodes, %ld ns reusing them\n",
+           num_streams, frames_per_stream, alloc_ns, reuse_ns);
+
+    printf("%s\n", failures == 0 ? "ALL PASSED" : "SOMETHING FAILED");
+    return failures == 0 ? 0 : 1;
+}
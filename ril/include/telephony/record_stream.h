@@ -21,6 +21,16 @@
 #ifndef _LIBRIL_RECORD_STREAM_H
 #define _LIBRIL_RECORD_STREAM_H
 
+#include <stddef.h>
+#ifndef HAVE_WINSOCK
+#include <sys/uio.h>
+#else
+struct iovec {
+    void *iov_base;
+    size_t iov_len;
+};
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -34,6 +44,11 @@ extern void record_stream_free(RecordStream *p_rs);
 extern int record_stream_get_next (RecordStream *p_rs, void ** p_outRecord,
                                     size_t *p_outRecordLen);
 
+/* p_outIov must have room for two entries; see record_stream.c */
+extern int record_stream_get_next_iov (RecordStream *p_rs,
+                                    struct iovec *p_outIov, int *p_outIovCnt,
+                                    size_t *p_outRecordLen);
+
 #ifdef __cplusplus
 }
 #endif
@@ -6,6 +6,10 @@ include $(CLEAR_VARS)
 LOCAL_SRC_FILES:= \
     ril.cpp \
     ril_event.cpp\
+    ril_request_table.cpp \
+    ril_response_queue.cpp \
+    ril_strings.cpp \
+    ril_trace.cpp \
     RilSocket.cpp \
     RilSapSocket.cpp \
 
@@ -43,7 +47,11 @@ ifneq ($(ANDROID_BIONIC_TRANSITION),)
 include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES:= \
-    ril.cpp
+    ril.cpp \
+    ril_request_table.cpp \
+    ril_response_queue.cpp \
+    ril_strings.cpp \
+    ril_trace.cpp
 
 LOCAL_STATIC_LIBRARIES := \
     libutils_static \
@@ -57,3 +65,5 @@ LOCAL_MODULE:= libril_static
 
 include $(BUILD_STATIC_LIBRARY)
 endif # ANDROID_BIONIC_TRANSITION
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
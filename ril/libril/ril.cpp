@@ -43,10 +43,16 @@
 #include <ctype.h>
 #include <alloca.h>
 #include <sys/un.h>
+#include <sys/uio.h>
+#include <poll.h>
 #include <assert.h>
 #include <netinet/in.h>
 #include <cutils/properties.h>
+#include <cutils/atomic.h>
 #include <RilSapSocket.h>
+#include <ril_request_table.h>
+#include <ril_response_queue.h>
+#include <ril_trace.h>
 
 extern "C" void
 RIL_onRequestComplete(RIL_Token t, RIL_Errno e, void *response, size_t responselen);
@@ -72,6 +78,14 @@ namespace android {
 // match with constant in RIL.java
 #define MAX_COMMAND_BYTES (8 * 1024)
 
+// Responses buffered per command socket while the framework catches up
+#define RESPONSE_QUEUE_SIZE 256
+// Unsolicited responses are dropped once the queue is this full, leaving
+// the rest for solicited responses the framework is waiting on
+#define RESPONSE_QUEUE_UNSOL_LIMIT (RESPONSE_QUEUE_SIZE * 3 / 4)
+// Max responses coalesced into one writev()
+#define MAX_RESPONSE_BATCH 64
+
 // Basically: memset buffers that the client library
 // shouldn't be using anymore in an attempt to find
 // memory usage issues sooner.
@@ -136,10 +150,39 @@ typedef struct {
     WakeType wakeType;
 } UnsolResponseInfo;
 
+enum {
+    // don't take the wake lock for this response while the screen is off
+    COALESCE_NO_WAKE_SCREEN_OFF = 1 << 0,
+};
+
+typedef struct {
+    int requestNumber;
+    int windowMs;       // deliver at most one response per window
+    int flags;
+} UnsolCoalescePolicy;
+
+/*
+ * Coalescing state of one unsolicited response id on one SIM, guarded by
+ * s_coalesceMutex except for wakeupsSaved.
+ */
+typedef struct {
+    RIL_SOCKET_ID socket_id;
+    int unsolResponse;
+    int windowMs;
+    int64_t lastSentMs;     // elapsedRealtime() of the last delivery
+    void *held;             // newest undelivered response Parcel, or NULL
+    size_t heldSize;
+    bool heldWake;          // the held response wanted the wake lock
+    bool flushScheduled;
+    int32_t received;
+    int32_t sent;
+    int32_t coalesced;      // replaced by a newer value before delivery
+    volatile int32_t wakeupsSaved;
+} UnsolCoalesceState;
+
 typedef struct RequestInfo {
     int32_t token;      //this is not RIL_Token
     CommandInfo *pCI;
-    struct RequestInfo *p_next;
     char cancelled;
     char local;         // responses to local commands do not go back to command process
     RIL_SOCKET_ID socket_id;
@@ -180,39 +223,82 @@ static struct ril_event s_wakeupfd_event;
 static struct ril_event s_listen_event;
 static SocketListenParam s_ril_param_socket;
 
-static pthread_mutex_t s_pendingRequestsMutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t s_writeMutex = PTHREAD_MUTEX_INITIALIZER;
-static RequestInfo *s_pendingRequests = NULL;
-
 #if (SIM_COUNT >= 2)
 static struct ril_event s_commands_event_socket2;
 static struct ril_event s_listen_event_socket2;
 static SocketListenParam s_ril_param_socket2;
-
-static pthread_mutex_t s_pendingRequestsMutex_socket2  = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t s_writeMutex_socket2            = PTHREAD_MUTEX_INITIALIZER;
-static RequestInfo *s_pendingRequests_socket2          = NULL;
 #endif
 
 #if (SIM_COUNT >= 3)
 static struct ril_event s_commands_event_socket3;
 static struct ril_event s_listen_event_socket3;
 static SocketListenParam s_ril_param_socket3;
-
-static pthread_mutex_t s_pendingRequestsMutex_socket3  = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t s_writeMutex_socket3            = PTHREAD_MUTEX_INITIALIZER;
-static RequestInfo *s_pendingRequests_socket3          = NULL;
 #endif
 
 #if (SIM_COUNT >= 4)
 static struct ril_event s_commands_event_socket4;
 static struct ril_event s_listen_event_socket4;
 static SocketListenParam s_ril_param_socket4;
+#endif
 
-static pthread_mutex_t s_pendingRequestsMutex_socket4  = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t s_writeMutex_socket4            = PTHREAD_MUTEX_INITIALIZER;
-static RequestInfo *s_pendingRequests_socket4          = NULL;
+/*
+ * Counters for the response writer, dumped through the debug socket.
+ * Fields bumped by calling threads are updated atomically; the rest are
+ * only written by the writer thread.
+ */
+typedef struct ResponseWriterStats {
+    volatile int32_t queued;        // responses accepted
+    volatile int32_t unsolDropped;  // unsolicited dropped, queue too full
+    volatile int32_t stalls;        // solicited responses that had to wait
+    int32_t written;                // responses written to the socket
+    int32_t batches;                // writev() batches
+    int32_t bytes;                  // bytes written, including headers
+    int32_t closedDropped;          // dropped because the socket went away
+    int32_t writeErrors;            // batches lost to write errors
+    int32_t maxDepth;               // high watermark of the queue
+} ResponseWriterStats;
+
+/*
+ * Per-SIM state: the command socket, the requests dispatched on it that the
+ * vendor RIL has not completed yet, and the queue and thread that write
+ * responses to it so a slow reader never stalls a vendor thread.
+ */
+typedef struct SimContext {
+    SocketListenParam *param;
+    pthread_mutex_t pendingRequestsMutex;
+    pthread_mutex_t writeMutex;
+    struct ril_request_table pendingRequests;
+
+    struct ril_response_queue responseQueue;
+    pthread_t writerThread;
+    pthread_cond_t writerCond;      // queue became non-empty
+    pthread_cond_t spaceCond;       // queue has room again
+    volatile int32_t writerIdle;
+    volatile int32_t spaceWaiters;
+    // bumped when the command socket closes, so responses queued for an
+    // old connection are never written to the next one
+    volatile int32_t connection;
+    ResponseWriterStats stats;
+} SimContext;
+
+#define SIM_CONTEXT_INITIALIZER(param) \
+    { (param), PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, \
+      RIL_REQUEST_TABLE_INITIALIZER, { NULL, 0, 0, 0 }, 0, \
+      PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0, 0, \
+      { 0, 0, 0, 0, 0, 0, 0, 0, 0 } }
+
+static SimContext s_simContexts[SIM_COUNT] = {
+    SIM_CONTEXT_INITIALIZER(&s_ril_param_socket),
+#if (SIM_COUNT >= 2)
+    SIM_CONTEXT_INITIALIZER(&s_ril_param_socket2),
+#endif
+#if (SIM_COUNT >= 3)
+    SIM_CONTEXT_INITIALIZER(&s_ril_param_socket3),
 #endif
+#if (SIM_COUNT >= 4)
+    SIM_CONTEXT_INITIALIZER(&s_ril_param_socket4),
+#endif
+};
 
 static struct ril_event s_wake_timeout_event;
 static struct ril_event s_debug_event;
@@ -241,6 +327,10 @@ static size_t s_lastNITZTimeDataSize;
 
 /*******************************************************************/
 static int sendResponse (Parcel &p, RIL_SOCKET_ID socket_id);
+static void initUnsolCoalescing();
+static void noteScreenState(Parcel &p);
+static void flushCoalescedUnsolicited();
+static void dumpUnsolCoalesceStats(int fd);
 
 static void dispatchVoid (Parcel& p, RequestInfo *pRI);
 static void dispatchString (Parcel& p, RequestInfo *pRI);
@@ -343,6 +433,19 @@ static UnsolResponseInfo s_unsolResponses[] = {
 #include "ril_unsol_commands.h"
 };
 
+static UnsolCoalescePolicy s_unsolCoalescePolicies[] = {
+#include "ril_unsol_coalesce.h"
+};
+
+/** Index == unsolResponse - RIL_UNSOL_RESPONSE_BASE, -1 if not coalesced */
+static int8_t s_unsolCoalesceIndex[NUM_ELEMS(s_unsolResponses)];
+
+static pthread_mutex_t s_coalesceMutex = PTHREAD_MUTEX_INITIALIZER;
+static UnsolCoalesceState s_unsolCoalesce[SIM_COUNT][NUM_ELEMS(s_unsolCoalescePolicies)];
+
+// Updated from RIL_REQUEST_SCREEN_STATE as it goes by
+static volatile int32_t s_screenOn = 1;
+
 /* For older RILs that do not support new commands RIL_REQUEST_VOICE_RADIO_TECH and
    RIL_UNSOL_VOICE_RADIO_TECH_CHANGED messages, decode the voice radio tech from
    radio state message and store it. Every time there is a change in Radio State
@@ -424,6 +527,31 @@ void   nullParcelReleaseFunction (const uint8_t* data, size_t dataSize,
     // do nothing -- the data reference lives longer than the Parcel object
 }
 
+static SimContext *
+getSimContext(RIL_SOCKET_ID socket_id) {
+    if ((int)socket_id < 0 || (int)socket_id >= SIM_COUNT) {
+        return &s_simContexts[RIL_SOCKET_1];
+    }
+    return &s_simContexts[socket_id];
+}
+
+static void
+enqueueRequestInfo(RequestInfo *pRI) {
+    SimContext *ctx = getSimContext(pRI->socket_id);
+    int ret;
+
+    ret = pthread_mutex_lock(&ctx->pendingRequestsMutex);
+    assert (ret == 0);
+
+    if (!ril_request_table_add(&ctx->pendingRequests, pRI)) {
+        RLOGE("%s: unable to track request; response will be dropped",
+                __FUNCTION__);
+    }
+
+    ret = pthread_mutex_unlock(&ctx->pendingRequestsMutex);
+    assert (ret == 0);
+}
+
 /**
  * To be called from dispatch thread
  * Issue a single local request, ensuring that the response
@@ -432,19 +560,6 @@ void   nullParcelReleaseFunction (const uint8_t* data, size_t dataSize,
 static void
 issueLocalRequest(int request, void *data, int len, RIL_SOCKET_ID socket_id) {
     RequestInfo *pRI;
-    int ret;
-    /* Hook for current context */
-    /* pendingRequestsMutextHook refer to &s_pendingRequestsMutex */
-    pthread_mutex_t* pendingRequestsMutexHook = &s_pendingRequestsMutex;
-    /* pendingRequestsHook refer to &s_pendingRequests */
-    RequestInfo**    pendingRequestsHook = &s_pendingRequests;
-
-#if (SIM_COUNT == 2)
-    if (socket_id == RIL_SOCKET_2) {
-        pendingRequestsMutexHook = &s_pendingRequestsMutex_socket2;
-        pendingRequestsHook = &s_pendingRequests_socket2;
-    }
-#endif
 
     pRI = (RequestInfo *)calloc(1, sizeof(RequestInfo));
 
@@ -453,14 +568,10 @@ issueLocalRequest(int request, void *data, int len, RIL_SOCKET_ID socket_id) {
     pRI->pCI = &(s_commands[request]);
     pRI->socket_id = socket_id;
 
-    ret = pthread_mutex_lock(pendingRequestsMutexHook);
-    assert (ret == 0);
+    enqueueRequestInfo(pRI);
 
-    pRI->p_next = *pendingRequestsHook;
-    *pendingRequestsHook = pRI;
-
-    ret = pthread_mutex_unlock(pendingRequestsMutexHook);
-    assert (ret == 0);
+    ril_trace_record(RIL_TRACE_LOCAL_REQUEST, 0, socket_id, request,
+            pRI->token, 0, NULL, 0);
 
     RLOGD("C[locl]> %s", requestToString(request));
 
@@ -476,12 +587,6 @@ processCommandBuffer(void *buffer, size_t buflen, RIL_SOCKET_ID socket_id) {
     int32_t request;
     int32_t token;
     RequestInfo *pRI;
-    int ret;
-    /* Hook for current context */
-    /* pendingRequestsMutextHook refer to &s_pendingRequestsMutex */
-    pthread_mutex_t* pendingRequestsMutexHook = &s_pendingRequestsMutex;
-    /* pendingRequestsHook refer to &s_pendingRequests */
-    RequestInfo**    pendingRequestsHook = &s_pendingRequests;
 
     p.setData((uint8_t *) buffer, buflen);
 
@@ -489,25 +594,6 @@ processCommandBuffer(void *buffer, size_t buflen, RIL_SOCKET_ID socket_id) {
     status = p.readInt32(&request);
     status = p.readInt32 (&token);
 
-#if (SIM_COUNT >= 2)
-    if (socket_id == RIL_SOCKET_2) {
-        pendingRequestsMutexHook = &s_pendingRequestsMutex_socket2;
-        pendingRequestsHook = &s_pendingRequests_socket2;
-    }
-#if (SIM_COUNT >= 3)
-    else if (socket_id == RIL_SOCKET_3) {
-        pendingRequestsMutexHook = &s_pendingRequestsMutex_socket3;
-        pendingRequestsHook = &s_pendingRequests_socket3;
-    }
-#endif
-#if (SIM_COUNT >= 4)
-    else if (socket_id == RIL_SOCKET_4) {
-        pendingRequestsMutexHook = &s_pendingRequestsMutex_socket4;
-        pendingRequestsHook = &s_pendingRequests_socket4;
-    }
-#endif
-#endif
-
     if (status != NO_ERROR) {
         RLOGE("invalid request block");
         return 0;
@@ -532,14 +618,14 @@ processCommandBuffer(void *buffer, size_t buflen, RIL_SOCKET_ID socket_id) {
     pRI->pCI = &(s_commands[request]);
     pRI->socket_id = socket_id;
 
-    ret = pthread_mutex_lock(pendingRequestsMutexHook);
-    assert (ret == 0);
+    enqueueRequestInfo(pRI);
 
-    pRI->p_next = *pendingRequestsHook;
-    *pendingRequestsHook = pRI;
+    ril_trace_record(RIL_TRACE_REQUEST, 0, socket_id, request, token, 0,
+            (uint8_t *) buffer + p.dataPosition(), buflen - p.dataPosition());
 
-    ret = pthread_mutex_unlock(pendingRequestsMutexHook);
-    assert (ret == 0);
+    if (request == RIL_REQUEST_SCREEN_STATE) {
+        noteScreenState(p);
+    }
 
 /*    sLastDispatchedToken = token; */
 
@@ -2071,35 +2157,169 @@ blockingWrite(int fd, const void *buffer, size_t len) {
     return 0;
 }
 
+/**
+ * Write a batch of iovecs fully to a non-blocking socket, waiting for it
+ * to drain instead of spinning on EAGAIN.
+ */
 static int
-sendResponseRaw (const void *data, size_t dataSize, RIL_SOCKET_ID socket_id) {
-    int fd = s_ril_param_socket.fdCommand;
-    int ret;
-    uint32_t header;
-    pthread_mutex_t * writeMutexHook = &s_writeMutex;
+blockingWritev(int fd, struct iovec *iov, int iovcnt) {
+    while (iovcnt > 0) {
+        ssize_t written = writev(fd, iov, iovcnt);
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else if (errno == EAGAIN) {
+                struct pollfd pfd;
+                pfd.fd = fd;
+                pfd.events = POLLOUT;
+                pfd.revents = 0;
+                poll(&pfd, 1, -1);
+                continue;
+            }
+            RLOGE ("RIL Response: unexpected error on writev errno:%d", errno);
+            return -1;
+        }
+
+        // skip what was written, possibly ending mid-iovec
+        while (iovcnt > 0 && (size_t) written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (uint8_t *) iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+    return 0;
+}
+
+static void
+wakeSpaceWaiters(SimContext *ctx) {
+    android_memory_barrier();
+    if (android_atomic_acquire_load(&ctx->spaceWaiters) > 0) {
+        pthread_mutex_lock(&ctx->writeMutex);
+        pthread_cond_broadcast(&ctx->spaceCond);
+        pthread_mutex_unlock(&ctx->writeMutex);
+    }
+}
+
+/**
+ * Per-socket writer thread: drains the response queue and coalesces
+ * everything queued into a single writev().
+ */
+static void *
+responseWriterLoop(void *param) {
+    SimContext *ctx = (SimContext *) param;
+    ResponseWriterStats *stats = &ctx->stats;
+    struct ril_response *batch[MAX_RESPONSE_BATCH];
+    struct iovec iov[MAX_RESPONSE_BATCH];
+
+    for (;;) {
+        int count = 0;
+        int32_t connection;
+        int fd;
+
+        int32_t depth = ril_response_queue_size(&ctx->responseQueue);
+        if (depth > stats->maxDepth) {
+            stats->maxDepth = depth;
+        }
+
+        while (count < MAX_RESPONSE_BATCH) {
+            struct ril_response *response =
+                    ril_response_queue_pop(&ctx->responseQueue);
+            if (response == NULL) {
+                break;
+            }
+            batch[count++] = response;
+        }
 
+        if (count == 0) {
+            pthread_mutex_lock(&ctx->writeMutex);
+            android_atomic_release_store(1, &ctx->writerIdle);
+            android_memory_barrier();
+            while (ril_response_queue_size(&ctx->responseQueue) == 0) {
+                pthread_cond_wait(&ctx->writerCond, &ctx->writeMutex);
+            }
+            android_atomic_release_store(0, &ctx->writerIdle);
+            pthread_mutex_unlock(&ctx->writeMutex);
+            continue;
+        }
+
+        wakeSpaceWaiters(ctx);
+
+        fd = ctx->param->fdCommand;
+        connection = android_atomic_acquire_load(&ctx->connection);
+
+        int iovcnt = 0;
+        int32_t bytes = 0;
+        for (int i = 0; i < count; i++) {
+            if (fd < 0 || batch[i]->connection != connection) {
+                stats->closedDropped++;
+                continue;
+            }
+            iov[iovcnt].iov_base = &batch[i]->header;
+            iov[iovcnt].iov_len = sizeof(batch[i]->header) + batch[i]->len;
+            bytes += iov[iovcnt].iov_len;
+            iovcnt++;
+        }
+
+        if (iovcnt > 0) {
+            if (blockingWritev(fd, iov, iovcnt) < 0) {
+                stats->writeErrors++;
+            } else {
+                stats->written += iovcnt;
+                stats->batches++;
+                stats->bytes += bytes;
+            }
+        }
 #if VDBG
-    RLOGE("Send Response to %s", rilSocketIdToString(socket_id));
+        RLOGD("RIL Response batch: %d responses, %d bytes", iovcnt, bytes);
 #endif
 
-#if (SIM_COUNT >= 2)
-    if (socket_id == RIL_SOCKET_2) {
-        fd = s_ril_param_socket2.fdCommand;
-        writeMutexHook = &s_writeMutex_socket2;
+        for (int i = 0; i < count; i++) {
+            ril_response_free(batch[i]);
+        }
     }
-#if (SIM_COUNT >= 3)
-    else if (socket_id == RIL_SOCKET_3) {
-        fd = s_ril_param_socket3.fdCommand;
-        writeMutexHook = &s_writeMutex_socket3;
+
+    return NULL;
+}
+
+static void
+startResponseWriter(SimContext *ctx) {
+    pthread_attr_t attr;
+    int ret;
+
+    if (!ril_response_queue_init(&ctx->responseQueue, RESPONSE_QUEUE_SIZE)) {
+        RLOGE("Failed to allocate response queue");
+        return;
     }
-#endif
-#if (SIM_COUNT >= 4)
-    else if (socket_id == RIL_SOCKET_4) {
-        fd = s_ril_param_socket4.fdCommand;
-        writeMutexHook = &s_writeMutex_socket4;
+
+    pthread_attr_init (&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    ret = pthread_create(&ctx->writerThread, &attr, responseWriterLoop, ctx);
+    if (ret != 0) {
+        RLOGE("Failed to create response writer thread: %s", strerror(ret));
     }
+}
+
+/**
+ * Queue a response for the command socket and return without waiting for
+ * the write. Unsolicited responses are dropped when the queue is nearly
+ * full; solicited ones wait for room.
+ */
+static int
+sendResponseRaw (const void *data, size_t dataSize, RIL_SOCKET_ID socket_id) {
+    SimContext *ctx = getSimContext(socket_id);
+    int fd = ctx->param->fdCommand;
+    struct ril_response *response;
+    bool unsolicited;
+
+#if VDBG
+    RLOGE("Send Response to %s", rilSocketIdToString(socket_id));
 #endif
-#endif
+
     if (fd < 0) {
         return -1;
     }
@@ -2111,29 +2331,86 @@ sendResponseRaw (const void *data, size_t dataSize, RIL_SOCKET_ID socket_id) {
         return -1;
     }
 
-    pthread_mutex_lock(writeMutexHook);
+    if (ctx->responseQueue.cells == NULL) {
+        return -1;
+    }
 
-    header = htonl(dataSize);
+    // Parcel data starts with the response type
+    unsolicited = dataSize >= sizeof(int32_t)
+            && *(const int32_t *) data == RESPONSE_UNSOLICITED;
 
-    ret = blockingWrite(fd, (void *)&header, sizeof(header));
+    if (unsolicited && ril_response_queue_size(&ctx->responseQueue)
+            >= RESPONSE_QUEUE_UNSOL_LIMIT) {
+        android_atomic_inc(&ctx->stats.unsolDropped);
+        return -1;
+    }
 
-    if (ret < 0) {
-        pthread_mutex_unlock(writeMutexHook);
-        return ret;
+    response = ril_response_new(data, dataSize, unsolicited,
+            android_atomic_acquire_load(&ctx->connection));
+    if (response == NULL) {
+        RLOGE("RIL: out of memory queueing response");
+        return -1;
     }
 
-    ret = blockingWrite(fd, data, dataSize);
+    if (!ril_response_queue_push(&ctx->responseQueue, response)) {
+        if (unsolicited) {
+            android_atomic_inc(&ctx->stats.unsolDropped);
+            ril_response_free(response);
+            return -1;
+        }
 
-    if (ret < 0) {
-        pthread_mutex_unlock(writeMutexHook);
-        return ret;
+        // back-pressure: the framework must get every solicited response
+        android_atomic_inc(&ctx->stats.stalls);
+        pthread_mutex_lock(&ctx->writeMutex);
+        android_atomic_inc(&ctx->spaceWaiters);
+        while (!ril_response_queue_push(&ctx->responseQueue, response)) {
+            pthread_cond_wait(&ctx->spaceCond, &ctx->writeMutex);
+        }
+        android_atomic_dec(&ctx->spaceWaiters);
+        pthread_mutex_unlock(&ctx->writeMutex);
     }
+    android_atomic_inc(&ctx->stats.queued);
 
-    pthread_mutex_unlock(writeMutexHook);
+    android_memory_barrier();
+    if (android_atomic_acquire_load(&ctx->writerIdle)) {
+        pthread_mutex_lock(&ctx->writeMutex);
+        pthread_cond_signal(&ctx->writerCond);
+        pthread_mutex_unlock(&ctx->writeMutex);
+    }
 
     return 0;
 }
 
+static void
+dumpResponseWriterStats(int fd) {
+    char buf[256];
+
+    for (int i = 0; i < SIM_COUNT; i++) {
+        SimContext *ctx = &s_simContexts[i];
+        ResponseWriterStats *stats = &ctx->stats;
+        int len;
+
+        len = snprintf(buf, sizeof(buf),
+                "%s: queued %d written %d batches %d bytes %d depth %d/%d "
+                "max %d unsol_dropped %d stalls %d closed_dropped %d "
+                "write_errors %d\n",
+                rilSocketIdToString((RIL_SOCKET_ID) i),
+                android_atomic_acquire_load(&stats->queued),
+                stats->written, stats->batches, stats->bytes,
+                (int) ril_response_queue_size(&ctx->responseQueue),
+                ctx->responseQueue.cells != NULL
+                        ? (int) ril_response_queue_capacity(&ctx->responseQueue) : 0,
+                stats->maxDepth,
+                android_atomic_acquire_load(&stats->unsolDropped),
+                android_atomic_acquire_load(&stats->stalls),
+                stats->closedDropped, stats->writeErrors);
+        RLOGI("%s", buf);
+        if (fd >= 0 && len > 0) {
+            send(fd, buf, MIN(len, (int) sizeof(buf) - 1), 0);
+        }
+    }
+}
+
 static int
 sendResponse (Parcel &p, RIL_SOCKET_ID socket_id) {
     printResponse;
@@ -3723,47 +4000,24 @@ static void processWakeupCallback(int fd, short flags, void *param) {
     } while (ret > 0 || (ret < 0 && errno == EINTR));
 }
 
+static void cancelRequestInfo(void *request, void *param) {
+    ((RequestInfo *) request)->cancelled = 1;
+}
+
 static void onCommandsSocketClosed(RIL_SOCKET_ID socket_id) {
     int ret;
-    RequestInfo *p_cur;
-    /* Hook for current context
-       pendingRequestsMutextHook refer to &s_pendingRequestsMutex */
-    pthread_mutex_t * pendingRequestsMutexHook = &s_pendingRequestsMutex;
-    /* pendingRequestsHook refer to &s_pendingRequests */
-    RequestInfo **    pendingRequestsHook = &s_pendingRequests;
+    SimContext *ctx = getSimContext(socket_id);
+
+    /* anything still queued was meant for the old connection */
+    android_atomic_inc(&ctx->connection);
 
-#if (SIM_COUNT >= 2)
-    if (socket_id == RIL_SOCKET_2) {
-        pendingRequestsMutexHook = &s_pendingRequestsMutex_socket2;
-        pendingRequestsHook = &s_pendingRequests_socket2;
-    }
-#if (SIM_COUNT >= 3)
-    else if (socket_id == RIL_SOCKET_3) {
-        pendingRequestsMutexHook = &s_pendingRequestsMutex_socket3;
-        pendingRequestsHook = &s_pendingRequests_socket3;
-    }
-#endif
-#if (SIM_COUNT >= 4)
-    else if (socket_id == RIL_SOCKET_4) {
-        pendingRequestsMutexHook = &s_pendingRequestsMutex_socket4;
-        pendingRequestsHook = &s_pendingRequests_socket4;
-    }
-#endif
-#endif
     /* mark pending requests as "cancelled" so we dont report responses */
-    ret = pthread_mutex_lock(pendingRequestsMutexHook);
+    ret = pthread_mutex_lock(&ctx->pendingRequestsMutex);
     assert (ret == 0);
 
-    p_cur = *pendingRequestsHook;
-
-    for (p_cur = *pendingRequestsHook
-            ; p_cur != NULL
-            ; p_cur  = p_cur->p_next
-    ) {
-        p_cur->cancelled = 1;
-    }
+    ril_request_table_for_each(&ctx->pendingRequests, cancelRequestInfo, NULL);
 
-    ret = pthread_mutex_unlock(pendingRequestsMutexHook);
+    ret = pthread_mutex_unlock(&ctx->pendingRequestsMutex);
     assert (ret == 0);
 }
 
@@ -3905,6 +4159,13 @@ static void listenCallback (int fd, short flags, void *param) {
 
     err = getsockopt(fdCommand, SOL_SOCKET, SO_PEERCRED, &creds, &szCreds);
 
+#ifdef RIL_HOST_TEST
+    // host test builds run client and RIL as the same user; there is no
+    // radio user to check against
+    if (err == 0 && szCreds > 0 && creds.uid == getuid()) {
+        is_phone_socket = 1;
+    } else
+#endif
     if (err == 0 && szCreds > 0) {
         errno = 0;
         pwd = getpwuid(creds.uid);
@@ -4140,6 +4401,20 @@ static void debugCallback (int fd, short flags, void *param) {
             issueLocalRequest(RIL_REQUEST_HANGUP, &hangupData,
                               sizeof(hangupData), socket_id);
             break;
+        case 11:
+            RLOGI("Debug port: Dump response writer stats");
+            dumpResponseWriterStats(acceptFD);
+            break;
+        case 12:
+            RLOGI("Debug port: Dump binary request trace");
+            if (ril_trace_dump(acceptFD) != 0) {
+                RLOGE("Failed to dump request trace: %d", errno);
+            }
+            break;
+        case 13:
+            RLOGI("Debug port: Flush coalesced unsolicited responses");
+            dumpUnsolCoalesceStats(acceptFD);
+            break;
         default:
             RLOGE ("Invalid request");
             break;
@@ -4373,6 +4648,9 @@ RIL_register (const RIL_RadioFunctions *callbacks) {
 #endif
 
 
+    // before s_registerCalled lets unsolicited responses through
+    initUnsolCoalescing();
+
     s_registerCalled = 1;
 
     RLOGI("s_registerCalled flag set, %d", s_started);
@@ -4394,6 +4672,10 @@ RIL_register (const RIL_RadioFunctions *callbacks) {
         RIL_startEventLoop();
     }
 
+    for (int i = 0; i < SIM_COUNT; i++) {
+        startResponseWriter(&s_simContexts[i]);
+    }
+
     // start listen socket1
     startListen(RIL_SOCKET_1, &s_ril_param_socket);
 
@@ -4477,50 +4759,20 @@ RIL_register_socket (RIL_RadioFunctions *(*Init)(const struct RIL_Env *, int, ch
 
 static int
 checkAndDequeueRequestInfo(struct RequestInfo *pRI) {
-    int ret = 0;
-    /* Hook for current context
-       pendingRequestsMutextHook refer to &s_pendingRequestsMutex */
-    pthread_mutex_t* pendingRequestsMutexHook = &s_pendingRequestsMutex;
-    /* pendingRequestsHook refer to &s_pendingRequests */
-    RequestInfo ** pendingRequestsHook = &s_pendingRequests;
+    int ret;
+    SimContext *ctx;
 
     if (pRI == NULL) {
         return 0;
     }
 
-#if (SIM_COUNT >= 2)
-    if (pRI->socket_id == RIL_SOCKET_2) {
-        pendingRequestsMutexHook = &s_pendingRequestsMutex_socket2;
-        pendingRequestsHook = &s_pendingRequests_socket2;
-    }
-#if (SIM_COUNT >= 3)
-        if (pRI->socket_id == RIL_SOCKET_3) {
-            pendingRequestsMutexHook = &s_pendingRequestsMutex_socket3;
-            pendingRequestsHook = &s_pendingRequests_socket3;
-        }
-#endif
-#if (SIM_COUNT >= 4)
-    if (pRI->socket_id == RIL_SOCKET_4) {
-        pendingRequestsMutexHook = &s_pendingRequestsMutex_socket4;
-        pendingRequestsHook = &s_pendingRequests_socket4;
-    }
-#endif
-#endif
-    pthread_mutex_lock(pendingRequestsMutexHook);
+    ctx = getSimContext(pRI->socket_id);
 
-    for(RequestInfo **ppCur = pendingRequestsHook
-        ; *ppCur != NULL
-        ; ppCur = &((*ppCur)->p_next)
-    ) {
-        if (pRI == *ppCur) {
-            ret = 1;
+    pthread_mutex_lock(&ctx->pendingRequestsMutex);
 
-            *ppCur = (*ppCur)->p_next;
-            break;
-        }
-    }
+    ret = ril_request_table_remove(&ctx->pendingRequests, pRI) ? 1 : 0;
 
-    pthread_mutex_unlock(pendingRequestsMutexHook);
+    pthread_mutex_unlock(&ctx->pendingRequestsMutex);
 
     return ret;
 }
@@ -4530,7 +4782,7 @@ extern "C" void
 RIL_onRequestComplete(RIL_Token t, RIL_Errno e, void *response, size_t responselen) {
     RequestInfo *pRI;
     int ret;
-    int fd = s_ril_param_socket.fdCommand;
+    int fd;
     size_t errorOffset;
     RIL_SOCKET_ID socket_id = RIL_SOCKET_1;
 
@@ -4542,21 +4794,7 @@ RIL_onRequestComplete(RIL_Token t, RIL_Errno e, void *response, size_t responsel
     }
 
     socket_id = pRI->socket_id;
-#if (SIM_COUNT >= 2)
-    if (socket_id == RIL_SOCKET_2) {
-        fd = s_ril_param_socket2.fdCommand;
-    }
-#if (SIM_COUNT >= 3)
-        if (socket_id == RIL_SOCKET_3) {
-            fd = s_ril_param_socket3.fdCommand;
-        }
-#endif
-#if (SIM_COUNT >= 4)
-    if (socket_id == RIL_SOCKET_4) {
-        fd = s_ril_param_socket4.fdCommand;
-    }
-#endif
-#endif
+    fd = getSimContext(socket_id)->param->fdCommand;
 #if VDBG
     RLOGD("RequestComplete, %s", rilSocketIdToString(socket_id));
 #endif
@@ -4565,6 +4803,8 @@ RIL_onRequestComplete(RIL_Token t, RIL_Errno e, void *response, size_t responsel
         // Locally issued command...void only!
         // response does not go back up the command socket
         RLOGD("C[locl]< %s", requestToString(pRI->pCI->requestNumber));
+        ril_trace_record(RIL_TRACE_RESPONSE, RIL_TRACE_FLAG_LOCAL, socket_id,
+                pRI->pCI->requestNumber, pRI->token, e, NULL, 0);
 
         goto done;
     }
@@ -4593,6 +4833,12 @@ RIL_onRequestComplete(RIL_Token t, RIL_Errno e, void *response, size_t responsel
             }
         }
 
+        ril_trace_record(RIL_TRACE_RESPONSE, 0, socket_id,
+                pRI->pCI->requestNumber, pRI->token,
+                (response != NULL && ret != 0) ? ret : e,
+                p.data() + errorOffset + sizeof(int32_t),
+                p.dataSize() - errorOffset - sizeof(int32_t));
+
         if (e != RIL_E_SUCCESS) {
             appendPrintBuf("%s fails by %s", printBuf, failCauseToString(e));
         }
@@ -4601,6 +4847,9 @@ RIL_onRequestComplete(RIL_Token t, RIL_Errno e, void *response, size_t responsel
             RLOGD ("RIL onRequestComplete: Command channel closed");
         }
         sendResponse(p, socket_id);
+    } else {
+        ril_trace_record(RIL_TRACE_RESPONSE, RIL_TRACE_FLAG_CANCELLED, socket_id,
+                pRI->pCI->requestNumber, pRI->token, e, NULL, 0);
     }
 
 done:
@@ -4747,6 +4996,229 @@ processRadioState(RIL_RadioState newRadioState, RIL_SOCKET_ID socket_id) {
 }
 
 
+static void
+scheduleWakeTimeout() {
+    // Cancel the previous request
+    if (s_last_wake_timeout_info != NULL) {
+        s_last_wake_timeout_info->userParam = (void *)1;
+    }
+
+    s_last_wake_timeout_info
+        = internalRequestTimedCallback(wakeTimeoutCallback, NULL,
+                                        &TIMEVAL_WAKE_TIMEOUT);
+}
+
+static void
+sendUnsolicitedParcel(Parcel &p, RIL_SOCKET_ID soc_id, int unsolResponse) {
+    int ret;
+
+    ril_trace_record(RIL_TRACE_UNSOL, 0, soc_id, unsolResponse, 0, 0,
+            p.data() + 2 * sizeof(int32_t), p.dataSize() - 2 * sizeof(int32_t));
+
+    ret = sendResponse(p, soc_id);
+    if (ret != 0 && unsolResponse == RIL_UNSOL_NITZ_TIME_RECEIVED) {
+
+        // Unfortunately, NITZ time is not poll/update like everything
+        // else in the system. So, if the upstream client isn't connected,
+        // keep a copy of the last NITZ response (with receive time noted
+        // above) around so we can deliver it when it is connected
+
+        if (s_lastNITZTimeData != NULL) {
+            free (s_lastNITZTimeData);
+            s_lastNITZTimeData = NULL;
+        }
+
+        s_lastNITZTimeData = malloc(p.dataSize());
+        s_lastNITZTimeDataSize = p.dataSize();
+        memcpy(s_lastNITZTimeData, p.data(), p.dataSize());
+    }
+}
+
+static void
+initUnsolCoalescing() {
+    memset(s_unsolCoalesceIndex, -1, sizeof(s_unsolCoalesceIndex));
+
+    for (int i = 0; i < (int)NUM_ELEMS(s_unsolCoalescePolicies); i++) {
+        UnsolCoalescePolicy *policy = &s_unsolCoalescePolicies[i];
+        int index = policy->requestNumber - RIL_UNSOL_RESPONSE_BASE;
+
+        if (index < 0 || index >= (int)NUM_ELEMS(s_unsolResponses)) {
+            RLOGE("coalescing policy for unknown unsolicited response %d",
+                    policy->requestNumber);
+            continue;
+        }
+        s_unsolCoalesceIndex[index] = i;
+
+        for (int j = 0; j < SIM_COUNT; j++) {
+            UnsolCoalesceState *state = &s_unsolCoalesce[j][i];
+            state->socket_id = (RIL_SOCKET_ID) j;
+            state->unsolResponse = policy->requestNumber;
+            state->windowMs = policy->windowMs;
+            state->lastSentMs = -policy->windowMs;
+        }
+    }
+}
+
+// Called with s_coalesceMutex held
+static void
+deliverHeldLocked(UnsolCoalesceState *state) {
+    Parcel p;
+
+    if (state->held == NULL) {
+        return;
+    }
+
+    if (state->heldWake) {
+        grabPartialWakeLock();
+    }
+
+    p.setData((uint8_t *) state->held, state->heldSize);
+    free(state->held);
+    state->held = NULL;
+
+    sendUnsolicitedParcel(p, state->socket_id, state->unsolResponse);
+    state->lastSentMs = elapsedRealtime();
+    state->sent++;
+
+    if (state->heldWake) {
+        scheduleWakeTimeout();
+    }
+}
+
+static void
+coalesceFlushCallback(void *param) {
+    UnsolCoalesceState *state = (UnsolCoalesceState *) param;
+
+    pthread_mutex_lock(&s_coalesceMutex);
+    state->flushScheduled = false;
+    deliverHeldLocked(state);
+    pthread_mutex_unlock(&s_coalesceMutex);
+}
+
+/**
+ * Sends p now if the window since the last delivery has closed, otherwise
+ * keeps it as the pending value, replacing any older one, and makes sure
+ * a flush is scheduled for when the window closes.
+ *
+ * Returns true if p was held rather than sent.
+ */
+static bool
+coalesceUnsolicited(UnsolCoalesceState *state, Parcel &p, bool wake) {
+    bool held = true;
+    int64_t now;
+
+    pthread_mutex_lock(&s_coalesceMutex);
+
+    state->received++;
+    if (state->held != NULL) {
+        // the pending value is superseded and never delivered
+        free(state->held);
+        state->held = NULL;
+        state->coalesced++;
+        if (state->heldWake) {
+            android_atomic_inc(&state->wakeupsSaved);
+        }
+    }
+
+    now = elapsedRealtime();
+    if (now - state->lastSentMs >= state->windowMs) {
+        sendUnsolicitedParcel(p, state->socket_id, state->unsolResponse);
+        state->lastSentMs = now;
+        state->sent++;
+        held = false;
+    } else {
+        state->held = malloc(p.dataSize());
+        if (state->held == NULL) {
+            RLOGE("out of memory coalescing %s", requestToString(state->unsolResponse));
+        } else {
+            memcpy(state->held, p.data(), p.dataSize());
+            state->heldSize = p.dataSize();
+            state->heldWake = wake;
+
+            if (!state->flushScheduled) {
+                int64_t delayMs = state->lastSentMs + state->windowMs - now;
+                struct timeval tv;
+
+                tv.tv_sec = delayMs / 1000;
+                tv.tv_usec = (delayMs % 1000) * 1000;
+                internalRequestTimedCallback(coalesceFlushCallback, state, &tv);
+                state->flushScheduled = true;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&s_coalesceMutex);
+    return held;
+}
+
+/**
+ * Delivers every held unsolicited response right away, e.g. because the
+ * screen came on and the framework wants current values.
+ */
+static void
+flushCoalescedUnsolicited() {
+    pthread_mutex_lock(&s_coalesceMutex);
+    for (int i = 0; i < SIM_COUNT; i++) {
+        for (int j = 0; j < (int)NUM_ELEMS(s_unsolCoalescePolicies); j++) {
+            deliverHeldLocked(&s_unsolCoalesce[i][j]);
+        }
+    }
+    pthread_mutex_unlock(&s_coalesceMutex);
+}
+
+static void
+noteScreenState(Parcel &p) {
+    size_t pos = p.dataPosition();
+    int32_t count = 0;
+    int32_t on = 0;
+    status_t status;
+
+    status = p.readInt32(&count);
+    if (status == NO_ERROR && count >= 1) {
+        status = p.readInt32(&on);
+    }
+    p.setDataPosition(pos);
+
+    if (status != NO_ERROR || count < 1) {
+        return;
+    }
+
+    // only the dispatch thread writes s_screenOn
+    bool wasOn = android_atomic_acquire_load(&s_screenOn) != 0;
+    android_atomic_release_store(on != 0, &s_screenOn);
+    if (on && !wasOn) {
+        flushCoalescedUnsolicited();
+    }
+}
+
+static void
+dumpUnsolCoalesceStats(int fd) {
+    char buf[256];
+
+    flushCoalescedUnsolicited();
+
+    pthread_mutex_lock(&s_coalesceMutex);
+    for (int i = 0; i < SIM_COUNT; i++) {
+        for (int j = 0; j < (int)NUM_ELEMS(s_unsolCoalescePolicies); j++) {
+            UnsolCoalesceState *state = &s_unsolCoalesce[i][j];
+            int len;
+
+            len = snprintf(buf, sizeof(buf),
+                    "%s: %s window %dms received %d sent %d coalesced %d "
+                    "wakeups_saved %d\n",
+                    rilSocketIdToString((RIL_SOCKET_ID) i),
+                    requestToString(state->unsolResponse), state->windowMs,
+                    state->received, state->sent, state->coalesced,
+                    android_atomic_acquire_load(&state->wakeupsSaved));
+            RLOGI("%s", buf);
+            if (fd >= 0 && len > 0) {
+                send(fd, buf, MIN(len, (int) sizeof(buf) - 1), 0);
+            }
+        }
+    }
+    pthread_mutex_unlock(&s_coalesceMutex);
+}
+
 #if defined(ANDROID_MULTI_SIM)
 extern "C"
 void RIL_onUnsolicitedResponse(int unsolResponse, const void *data,
@@ -4763,6 +5235,8 @@ void RIL_onUnsolicitedResponse(int unsolResponse, const void *data,
     bool shouldScheduleTimeout = false;
     RIL_RadioState newState;
     RIL_SOCKET_ID soc_id = RIL_SOCKET_1;
+    UnsolCoalesceState *coalesce = NULL;
+    WakeType wakeType;
 
 #if defined(ANDROID_MULTI_SIM)
     soc_id = socket_id;
@@ -4783,10 +5257,22 @@ void RIL_onUnsolicitedResponse(int unsolResponse, const void *data,
         return;
     }
 
+    wakeType = s_unsolResponses[unsolResponseIndex].wakeType;
+    if (s_unsolCoalesceIndex[unsolResponseIndex] >= 0) {
+        int policy = s_unsolCoalesceIndex[unsolResponseIndex];
+        coalesce = &s_unsolCoalesce[soc_id][policy];
+        if (wakeType == WAKE_PARTIAL
+                && (s_unsolCoalescePolicies[policy].flags & COALESCE_NO_WAKE_SCREEN_OFF)
+                && !android_atomic_acquire_load(&s_screenOn)) {
+            wakeType = DONT_WAKE;
+            android_atomic_inc(&coalesce->wakeupsSaved);
+        }
+    }
+
     // Grab a wake lock if needed for this reponse,
     // as we exit we'll either release it immediately
     // or set a timer to release it later.
-    switch (s_unsolResponses[unsolResponseIndex].wakeType) {
+    switch (wakeType) {
         case WAKE_PARTIAL:
             grabPartialWakeLock();
             shouldScheduleTimeout = true;
@@ -4844,36 +5330,27 @@ void RIL_onUnsolicitedResponse(int unsolResponse, const void *data,
 #if VDBG
     RLOGI("%s UNSOLICITED: %s length:%d", rilSocketIdToString(soc_id), requestToString(unsolResponse), p.dataSize());
 #endif
-    ret = sendResponse(p, soc_id);
-    if (ret != 0 && unsolResponse == RIL_UNSOL_NITZ_TIME_RECEIVED) {
 
-        // Unfortunately, NITZ time is not poll/update like everything
-        // else in the system. So, if the upstream client isn't connected,
-        // keep a copy of the last NITZ response (with receive time noted
-        // above) around so we can deliver it when it is connected
-
-        if (s_lastNITZTimeData != NULL) {
-            free (s_lastNITZTimeData);
-            s_lastNITZTimeData = NULL;
+    if (coalesce != NULL) {
+        if (coalesceUnsolicited(coalesce, p, shouldScheduleTimeout)) {
+            // Held until its window closes. The wake lock is only kept
+            // if an earlier response already scheduled its release.
+            if (shouldScheduleTimeout && s_last_wake_timeout_info == NULL) {
+                releaseWakeLock();
+            }
+        } else if (shouldScheduleTimeout) {
+            scheduleWakeTimeout();
         }
-
-        s_lastNITZTimeData = malloc(p.dataSize());
-        s_lastNITZTimeDataSize = p.dataSize();
-        memcpy(s_lastNITZTimeData, p.data(), p.dataSize());
+        return;
     }
 
+    sendUnsolicitedParcel(p, soc_id, unsolResponse);
+
     // For now, we automatically go back to sleep after TIMEVAL_WAKE_TIMEOUT
     // FIXME The java code should handshake here to release wake lock
 
     if (shouldScheduleTimeout) {
-        // Cancel the previous request
-        if (s_last_wake_timeout_info != NULL) {
-            s_last_wake_timeout_info->userParam = (void *)1;
-        }
-
-        s_last_wake_timeout_info
-            = internalRequestTimedCallback(wakeTimeoutCallback, NULL,
-                                            &TIMEVAL_WAKE_TIMEOUT);
+        scheduleWakeTimeout();
     }
 
     // Normal exit
@@ -4923,244 +5400,6 @@ RIL_requestTimedCallback (RIL_TimedCallback callback, void *param,
     internalRequestTimedCallback (callback, param, relativeTime);
 }
 
-const char *
-failCauseToString(RIL_Errno e) {
-    switch(e) {
-        case RIL_E_SUCCESS: return "E_SUCCESS";
-        case RIL_E_RADIO_NOT_AVAILABLE: return "E_RADIO_NOT_AVAILABLE";
-        case RIL_E_GENERIC_FAILURE: return "E_GENERIC_FAILURE";
-        case RIL_E_PASSWORD_INCORRECT: return "E_PASSWORD_INCORRECT";
-        case RIL_E_SIM_PIN2: return "E_SIM_PIN2";
-        case RIL_E_SIM_PUK2: return "E_SIM_PUK2";
-        case RIL_E_REQUEST_NOT_SUPPORTED: return "E_REQUEST_NOT_SUPPORTED";
-        case RIL_E_CANCELLED: return "E_CANCELLED";
-        case RIL_E_OP_NOT_ALLOWED_DURING_VOICE_CALL: return "E_OP_NOT_ALLOWED_DURING_VOICE_CALL";
-        case RIL_E_OP_NOT_ALLOWED_BEFORE_REG_TO_NW: return "E_OP_NOT_ALLOWED_BEFORE_REG_TO_NW";
-        case RIL_E_SMS_SEND_FAIL_RETRY: return "E_SMS_SEND_FAIL_RETRY";
-        case RIL_E_SIM_ABSENT:return "E_SIM_ABSENT";
-        case RIL_E_ILLEGAL_SIM_OR_ME:return "E_ILLEGAL_SIM_OR_ME";
-#ifdef FEATURE_MULTIMODE_ANDROID
-        case RIL_E_SUBSCRIPTION_NOT_AVAILABLE:return "E_SUBSCRIPTION_NOT_AVAILABLE";
-        case RIL_E_MODE_NOT_SUPPORTED:return "E_MODE_NOT_SUPPORTED";
-#endif
-        default: return "<unknown error>";
-    }
-}
-
-const char *
-radioStateToString(RIL_RadioState s) {
-    switch(s) {
-        case RADIO_STATE_OFF: return "RADIO_OFF";
-        case RADIO_STATE_UNAVAILABLE: return "RADIO_UNAVAILABLE";
-        case RADIO_STATE_SIM_NOT_READY: return "RADIO_SIM_NOT_READY";
-        case RADIO_STATE_SIM_LOCKED_OR_ABSENT: return "RADIO_SIM_LOCKED_OR_ABSENT";
-        case RADIO_STATE_SIM_READY: return "RADIO_SIM_READY";
-        case RADIO_STATE_RUIM_NOT_READY:return"RADIO_RUIM_NOT_READY";
-        case RADIO_STATE_RUIM_READY:return"RADIO_RUIM_READY";
-        case RADIO_STATE_RUIM_LOCKED_OR_ABSENT:return"RADIO_RUIM_LOCKED_OR_ABSENT";
-        case RADIO_STATE_NV_NOT_READY:return"RADIO_NV_NOT_READY";
-        case RADIO_STATE_NV_READY:return"RADIO_NV_READY";
-        case RADIO_STATE_ON:return"RADIO_ON";
-        default: return "<unknown state>";
-    }
-}
-
-const char *
-callStateToString(RIL_CallState s) {
-    switch(s) {
-        case RIL_CALL_ACTIVE : return "ACTIVE";
-        case RIL_CALL_HOLDING: return "HOLDING";
-        case RIL_CALL_DIALING: return "DIALING";
-        case RIL_CALL_ALERTING: return "ALERTING";
-        case RIL_CALL_INCOMING: return "INCOMING";
-        case RIL_CALL_WAITING: return "WAITING";
-        default: return "<unknown state>";
-    }
-}
-
-const char *
-requestToString(int request) {
-/*
- cat libs/telephony/ril_commands.h \
- | egrep "^ *{RIL_" \
- | sed -re 's/\{RIL_([^,]+),[^,]+,([^}]+).+/case RIL_\1: return "\1";/'
-
-
- cat libs/telephony/ril_unsol_commands.h \
- | egrep "^ *{RIL_" \
- | sed -re 's/\{RIL_([^,]+),([^}]+).+/case RIL_\1: return "\1";/'
-
-*/
-    switch(request) {
-        case RIL_REQUEST_GET_SIM_STATUS: return "GET_SIM_STATUS";
-        case RIL_REQUEST_ENTER_SIM_PIN: return "ENTER_SIM_PIN";
-        case RIL_REQUEST_ENTER_SIM_PUK: return "ENTER_SIM_PUK";
-        case RIL_REQUEST_ENTER_SIM_PIN2: return "ENTER_SIM_PIN2";
-        case RIL_REQUEST_ENTER_SIM_PUK2: return "ENTER_SIM_PUK2";
-        case RIL_REQUEST_CHANGE_SIM_PIN: return "CHANGE_SIM_PIN";
-        case RIL_REQUEST_CHANGE_SIM_PIN2: return "CHANGE_SIM_PIN2";
-        case RIL_REQUEST_ENTER_NETWORK_DEPERSONALIZATION: return "ENTER_NETWORK_DEPERSONALIZATION";
-        case RIL_REQUEST_GET_CURRENT_CALLS: return "GET_CURRENT_CALLS";
-        case RIL_REQUEST_DIAL: return "DIAL";
-        case RIL_REQUEST_GET_IMSI: return "GET_IMSI";
-        case RIL_REQUEST_HANGUP: return "HANGUP";
-        case RIL_REQUEST_HANGUP_WAITING_OR_BACKGROUND: return "HANGUP_WAITING_OR_BACKGROUND";
-        case RIL_REQUEST_HANGUP_FOREGROUND_RESUME_BACKGROUND: return "HANGUP_FOREGROUND_RESUME_BACKGROUND";
-        case RIL_REQUEST_SWITCH_WAITING_OR_HOLDING_AND_ACTIVE: return "SWITCH_WAITING_OR_HOLDING_AND_ACTIVE";
-        case RIL_REQUEST_CONFERENCE: return "CONFERENCE";
-        case RIL_REQUEST_UDUB: return "UDUB";
-        case RIL_REQUEST_LAST_CALL_FAIL_CAUSE: return "LAST_CALL_FAIL_CAUSE";
-        case RIL_REQUEST_SIGNAL_STRENGTH: return "SIGNAL_STRENGTH";
-        case RIL_REQUEST_VOICE_REGISTRATION_STATE: return "VOICE_REGISTRATION_STATE";
-        case RIL_REQUEST_DATA_REGISTRATION_STATE: return "DATA_REGISTRATION_STATE";
-        case RIL_REQUEST_OPERATOR: return "OPERATOR";
-        case RIL_REQUEST_RADIO_POWER: return "RADIO_POWER";
-        case RIL_REQUEST_DTMF: return "DTMF";
-        case RIL_REQUEST_SEND_SMS: return "SEND_SMS";
-        case RIL_REQUEST_SEND_SMS_EXPECT_MORE: return "SEND_SMS_EXPECT_MORE";
-        case RIL_REQUEST_SETUP_DATA_CALL: return "SETUP_DATA_CALL";
-        case RIL_REQUEST_SIM_IO: return "SIM_IO";
-        case RIL_REQUEST_SEND_USSD: return "SEND_USSD";
-        case RIL_REQUEST_CANCEL_USSD: return "CANCEL_USSD";
-        case RIL_REQUEST_GET_CLIR: return "GET_CLIR";
-        case RIL_REQUEST_SET_CLIR: return "SET_CLIR";
-        case RIL_REQUEST_QUERY_CALL_FORWARD_STATUS: return "QUERY_CALL_FORWARD_STATUS";
-        case RIL_REQUEST_SET_CALL_FORWARD: return "SET_CALL_FORWARD";
-        case RIL_REQUEST_QUERY_CALL_WAITING: return "QUERY_CALL_WAITING";
-        case RIL_REQUEST_SET_CALL_WAITING: return "SET_CALL_WAITING";
-        case RIL_REQUEST_SMS_ACKNOWLEDGE: return "SMS_ACKNOWLEDGE";
-        case RIL_REQUEST_GET_IMEI: return "GET_IMEI";
-        case RIL_REQUEST_GET_IMEISV: return "GET_IMEISV";
-        case RIL_REQUEST_ANSWER: return "ANSWER";
-        case RIL_REQUEST_DEACTIVATE_DATA_CALL: return "DEACTIVATE_DATA_CALL";
-        case RIL_REQUEST_QUERY_FACILITY_LOCK: return "QUERY_FACILITY_LOCK";
-        case RIL_REQUEST_SET_FACILITY_LOCK: return "SET_FACILITY_LOCK";
-        case RIL_REQUEST_CHANGE_BARRING_PASSWORD: return "CHANGE_BARRING_PASSWORD";
-        case RIL_REQUEST_QUERY_NETWORK_SELECTION_MODE: return "QUERY_NETWORK_SELECTION_MODE";
-        case RIL_REQUEST_SET_NETWORK_SELECTION_AUTOMATIC: return "SET_NETWORK_SELECTION_AUTOMATIC";
-        case RIL_REQUEST_SET_NETWORK_SELECTION_MANUAL: return "SET_NETWORK_SELECTION_MANUAL";
-        case RIL_REQUEST_QUERY_AVAILABLE_NETWORKS : return "QUERY_AVAILABLE_NETWORKS ";
-        case RIL_REQUEST_DTMF_START: return "DTMF_START";
-        case RIL_REQUEST_DTMF_STOP: return "DTMF_STOP";
-        case RIL_REQUEST_BASEBAND_VERSION: return "BASEBAND_VERSION";
-        case RIL_REQUEST_SEPARATE_CONNECTION: return "SEPARATE_CONNECTION";
-        case RIL_REQUEST_SET_PREFERRED_NETWORK_TYPE: return "SET_PREFERRED_NETWORK_TYPE";
-        case RIL_REQUEST_GET_PREFERRED_NETWORK_TYPE: return "GET_PREFERRED_NETWORK_TYPE";
-        case RIL_REQUEST_GET_NEIGHBORING_CELL_IDS: return "GET_NEIGHBORING_CELL_IDS";
-        case RIL_REQUEST_SET_MUTE: return "SET_MUTE";
-        case RIL_REQUEST_GET_MUTE: return "GET_MUTE";
-        case RIL_REQUEST_QUERY_CLIP: return "QUERY_CLIP";
-        case RIL_REQUEST_LAST_DATA_CALL_FAIL_CAUSE: return "LAST_DATA_CALL_FAIL_CAUSE";
-        case RIL_REQUEST_DATA_CALL_LIST: return "DATA_CALL_LIST";
-        case RIL_REQUEST_RESET_RADIO: return "RESET_RADIO";
-        case RIL_REQUEST_OEM_HOOK_RAW: return "OEM_HOOK_RAW";
-        case RIL_REQUEST_OEM_HOOK_STRINGS: return "OEM_HOOK_STRINGS";
-        case RIL_REQUEST_SET_BAND_MODE: return "SET_BAND_MODE";
-        case RIL_REQUEST_QUERY_AVAILABLE_BAND_MODE: return "QUERY_AVAILABLE_BAND_MODE";
-        case RIL_REQUEST_STK_GET_PROFILE: return "STK_GET_PROFILE";
-        case RIL_REQUEST_STK_SET_PROFILE: return "STK_SET_PROFILE";
-        case RIL_REQUEST_STK_SEND_ENVELOPE_COMMAND: return "STK_SEND_ENVELOPE_COMMAND";
-        case RIL_REQUEST_STK_SEND_TERMINAL_RESPONSE: return "STK_SEND_TERMINAL_RESPONSE";
-        case RIL_REQUEST_STK_HANDLE_CALL_SETUP_REQUESTED_FROM_SIM: return "STK_HANDLE_CALL_SETUP_REQUESTED_FROM_SIM";
-        case RIL_REQUEST_SCREEN_STATE: return "SCREEN_STATE";
-        case RIL_REQUEST_EXPLICIT_CALL_TRANSFER: return "EXPLICIT_CALL_TRANSFER";
-        case RIL_REQUEST_SET_LOCATION_UPDATES: return "SET_LOCATION_UPDATES";
-        case RIL_REQUEST_CDMA_SET_SUBSCRIPTION_SOURCE:return"CDMA_SET_SUBSCRIPTION_SOURCE";
-        case RIL_REQUEST_CDMA_SET_ROAMING_PREFERENCE:return"CDMA_SET_ROAMING_PREFERENCE";
-        case RIL_REQUEST_CDMA_QUERY_ROAMING_PREFERENCE:return"CDMA_QUERY_ROAMING_PREFERENCE";
-        case RIL_REQUEST_SET_TTY_MODE:return"SET_TTY_MODE";
-        case RIL_REQUEST_QUERY_TTY_MODE:return"QUERY_TTY_MODE";
-        case RIL_REQUEST_CDMA_SET_PREFERRED_VOICE_PRIVACY_MODE:return"CDMA_SET_PREFERRED_VOICE_PRIVACY_MODE";
-        case RIL_REQUEST_CDMA_QUERY_PREFERRED_VOICE_PRIVACY_MODE:return"CDMA_QUERY_PREFERRED_VOICE_PRIVACY_MODE";
-        case RIL_REQUEST_CDMA_FLASH:return"CDMA_FLASH";
-        case RIL_REQUEST_CDMA_BURST_DTMF:return"CDMA_BURST_DTMF";
-        case RIL_REQUEST_CDMA_SEND_SMS:return"CDMA_SEND_SMS";
-        case RIL_REQUEST_CDMA_SMS_ACKNOWLEDGE:return"CDMA_SMS_ACKNOWLEDGE";
-        case RIL_REQUEST_GSM_GET_BROADCAST_SMS_CONFIG:return"GSM_GET_BROADCAST_SMS_CONFIG";
-        case RIL_REQUEST_GSM_SET_BROADCAST_SMS_CONFIG:return"GSM_SET_BROADCAST_SMS_CONFIG";
-        case RIL_REQUEST_CDMA_GET_BROADCAST_SMS_CONFIG:return "CDMA_GET_BROADCAST_SMS_CONFIG";
-        case RIL_REQUEST_CDMA_SET_BROADCAST_SMS_CONFIG:return "CDMA_SET_BROADCAST_SMS_CONFIG";
-        case RIL_REQUEST_CDMA_SMS_BROADCAST_ACTIVATION:return "CDMA_SMS_BROADCAST_ACTIVATION";
-        case RIL_REQUEST_CDMA_VALIDATE_AND_WRITE_AKEY: return"CDMA_VALIDATE_AND_WRITE_AKEY";
-        case RIL_REQUEST_CDMA_SUBSCRIPTION: return"CDMA_SUBSCRIPTION";
-        case RIL_REQUEST_CDMA_WRITE_SMS_TO_RUIM: return "CDMA_WRITE_SMS_TO_RUIM";
-        case RIL_REQUEST_CDMA_DELETE_SMS_ON_RUIM: return "CDMA_DELETE_SMS_ON_RUIM";
-        case RIL_REQUEST_DEVICE_IDENTITY: return "DEVICE_IDENTITY";
-        case RIL_REQUEST_EXIT_EMERGENCY_CALLBACK_MODE: return "EXIT_EMERGENCY_CALLBACK_MODE";
-        case RIL_REQUEST_GET_SMSC_ADDRESS: return "GET_SMSC_ADDRESS";
-        case RIL_REQUEST_SET_SMSC_ADDRESS: return "SET_SMSC_ADDRESS";
-        case RIL_REQUEST_REPORT_SMS_MEMORY_STATUS: return "REPORT_SMS_MEMORY_STATUS";
-        case RIL_REQUEST_REPORT_STK_SERVICE_IS_RUNNING: return "REPORT_STK_SERVICE_IS_RUNNING";
-        case RIL_REQUEST_CDMA_GET_SUBSCRIPTION_SOURCE: return "CDMA_GET_SUBSCRIPTION_SOURCE";
-        case RIL_REQUEST_ISIM_AUTHENTICATION: return "ISIM_AUTHENTICATION";
-        case RIL_REQUEST_ACKNOWLEDGE_INCOMING_GSM_SMS_WITH_PDU: return "RIL_REQUEST_ACKNOWLEDGE_INCOMING_GSM_SMS_WITH_PDU";
-        case RIL_REQUEST_STK_SEND_ENVELOPE_WITH_STATUS: return "RIL_REQUEST_STK_SEND_ENVELOPE_WITH_STATUS";
-        case RIL_REQUEST_VOICE_RADIO_TECH: return "VOICE_RADIO_TECH";
-        case RIL_REQUEST_GET_CELL_INFO_LIST: return"GET_CELL_INFO_LIST";
-        case RIL_REQUEST_SET_UNSOL_CELL_INFO_LIST_RATE: return"SET_UNSOL_CELL_INFO_LIST_RATE";
-        case RIL_REQUEST_SET_INITIAL_ATTACH_APN: return "RIL_REQUEST_SET_INITIAL_ATTACH_APN";
-        case RIL_REQUEST_IMS_REGISTRATION_STATE: return "IMS_REGISTRATION_STATE";
-        case RIL_REQUEST_IMS_SEND_SMS: return "IMS_SEND_SMS";
-        case RIL_REQUEST_SIM_TRANSMIT_APDU_BASIC: return "SIM_TRANSMIT_APDU_BASIC";
-        case RIL_REQUEST_SIM_OPEN_CHANNEL: return "SIM_OPEN_CHANNEL";
-        case RIL_REQUEST_SIM_CLOSE_CHANNEL: return "SIM_CLOSE_CHANNEL";
-        case RIL_REQUEST_SIM_TRANSMIT_APDU_CHANNEL: return "SIM_TRANSMIT_APDU_CHANNEL";
-        case RIL_REQUEST_GET_RADIO_CAPABILITY: return "RIL_REQUEST_GET_RADIO_CAPABILITY";
-        case RIL_REQUEST_SET_RADIO_CAPABILITY: return "RIL_REQUEST_SET_RADIO_CAPABILITY";
-        case RIL_REQUEST_SET_UICC_SUBSCRIPTION: return "SET_UICC_SUBSCRIPTION";
-        case RIL_REQUEST_ALLOW_DATA: return "ALLOW_DATA";
-        case RIL_REQUEST_GET_HARDWARE_CONFIG: return "GET_HARDWARE_CONFIG";
-        case RIL_REQUEST_SIM_AUTHENTICATION: return "SIM_AUTHENTICATION";
-        case RIL_REQUEST_GET_DC_RT_INFO: return "GET_DC_RT_INFO";
-        case RIL_REQUEST_SET_DC_RT_INFO_RATE: return "SET_DC_RT_INFO_RATE";
-        case RIL_REQUEST_SET_DATA_PROFILE: return "SET_DATA_PROFILE";
-        case RIL_UNSOL_RESPONSE_RADIO_STATE_CHANGED: return "UNSOL_RESPONSE_RADIO_STATE_CHANGED";
-        case RIL_UNSOL_RESPONSE_CALL_STATE_CHANGED: return "UNSOL_RESPONSE_CALL_STATE_CHANGED";
-        case RIL_UNSOL_RESPONSE_VOICE_NETWORK_STATE_CHANGED: return "UNSOL_RESPONSE_VOICE_NETWORK_STATE_CHANGED";
-        case RIL_UNSOL_RESPONSE_NEW_SMS: return "UNSOL_RESPONSE_NEW_SMS";
-        case RIL_UNSOL_RESPONSE_NEW_SMS_STATUS_REPORT: return "UNSOL_RESPONSE_NEW_SMS_STATUS_REPORT";
-        case RIL_UNSOL_RESPONSE_NEW_SMS_ON_SIM: return "UNSOL_RESPONSE_NEW_SMS_ON_SIM";
-        case RIL_UNSOL_ON_USSD: return "UNSOL_ON_USSD";
-        case RIL_UNSOL_ON_USSD_REQUEST: return "UNSOL_ON_USSD_REQUEST(obsolete)";
-        case RIL_UNSOL_NITZ_TIME_RECEIVED: return "UNSOL_NITZ_TIME_RECEIVED";
-        case RIL_UNSOL_SIGNAL_STRENGTH: return "UNSOL_SIGNAL_STRENGTH";
-        case RIL_UNSOL_STK_SESSION_END: return "UNSOL_STK_SESSION_END";
-        case RIL_UNSOL_STK_PROACTIVE_COMMAND: return "UNSOL_STK_PROACTIVE_COMMAND";
-        case RIL_UNSOL_STK_EVENT_NOTIFY: return "UNSOL_STK_EVENT_NOTIFY";
-        case RIL_UNSOL_STK_CALL_SETUP: return "UNSOL_STK_CALL_SETUP";
-        case RIL_UNSOL_SIM_SMS_STORAGE_FULL: return "UNSOL_SIM_SMS_STORAGE_FUL";
-        case RIL_UNSOL_SIM_REFRESH: return "UNSOL_SIM_REFRESH";
-        case RIL_UNSOL_DATA_CALL_LIST_CHANGED: return "UNSOL_DATA_CALL_LIST_CHANGED";
-        case RIL_UNSOL_CALL_RING: return "UNSOL_CALL_RING";
-        case RIL_UNSOL_RESPONSE_SIM_STATUS_CHANGED: return "UNSOL_RESPONSE_SIM_STATUS_CHANGED";
-        case RIL_UNSOL_RESPONSE_CDMA_NEW_SMS: return "UNSOL_NEW_CDMA_SMS";
-        case RIL_UNSOL_RESPONSE_NEW_BROADCAST_SMS: return "UNSOL_NEW_BROADCAST_SMS";
-        case RIL_UNSOL_CDMA_RUIM_SMS_STORAGE_FULL: return "UNSOL_CDMA_RUIM_SMS_STORAGE_FULL";
-        case RIL_UNSOL_RESTRICTED_STATE_CHANGED: return "UNSOL_RESTRICTED_STATE_CHANGED";
-        case RIL_UNSOL_ENTER_EMERGENCY_CALLBACK_MODE: return "UNSOL_ENTER_EMERGENCY_CALLBACK_MODE";
-        case RIL_UNSOL_CDMA_CALL_WAITING: return "UNSOL_CDMA_CALL_WAITING";
-        case RIL_UNSOL_CDMA_OTA_PROVISION_STATUS: return "UNSOL_CDMA_OTA_PROVISION_STATUS";
-        case RIL_UNSOL_CDMA_INFO_REC: return "UNSOL_CDMA_INFO_REC";
-        case RIL_UNSOL_OEM_HOOK_RAW: return "UNSOL_OEM_HOOK_RAW";
-        case RIL_UNSOL_RINGBACK_TONE: return "UNSOL_RINGBACK_TONE";
-        case RIL_UNSOL_RESEND_INCALL_MUTE: return "UNSOL_RESEND_INCALL_MUTE";
-        case RIL_UNSOL_CDMA_SUBSCRIPTION_SOURCE_CHANGED: return "UNSOL_CDMA_SUBSCRIPTION_SOURCE_CHANGED";
-        case RIL_UNSOL_CDMA_PRL_CHANGED: return "UNSOL_CDMA_PRL_CHANGED";
-        case RIL_UNSOL_EXIT_EMERGENCY_CALLBACK_MODE: return "UNSOL_EXIT_EMERGENCY_CALLBACK_MODE";
-        case RIL_UNSOL_RIL_CONNECTED: return "UNSOL_RIL_CONNECTED";
-        case RIL_UNSOL_VOICE_RADIO_TECH_CHANGED: return "UNSOL_VOICE_RADIO_TECH_CHANGED";
-        case RIL_UNSOL_CELL_INFO_LIST: return "UNSOL_CELL_INFO_LIST";
-        case RIL_UNSOL_RESPONSE_IMS_NETWORK_STATE_CHANGED: return "RESPONSE_IMS_NETWORK_STATE_CHANGED";
-        case RIL_UNSOL_UICC_SUBSCRIPTION_STATUS_CHANGED: return "UNSOL_UICC_SUBSCRIPTION_STATUS_CHANGED";
-        case RIL_UNSOL_SRVCC_STATE_NOTIFY: return "UNSOL_SRVCC_STATE_NOTIFY";
-        case RIL_UNSOL_HARDWARE_CONFIG_CHANGED: return "HARDWARE_CONFIG_CHANGED";
-        case RIL_UNSOL_DC_RT_INFO_CHANGED: return "UNSOL_DC_RT_INFO_CHANGED";
-        case RIL_REQUEST_SHUTDOWN: return "SHUTDOWN";
-        case RIL_UNSOL_RADIO_CAPABILITY: return "RIL_UNSOL_RADIO_CAPABILITY";
-        default: return "<unknown request>";
-    }
-}
-
 const char *
 rilSocketIdToString(RIL_SOCKET_ID socket_id)
 {
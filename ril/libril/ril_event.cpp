@@ -26,6 +26,10 @@
 #include <string.h>
 #include <sys/time.h>
 #include <time.h>
+#ifndef RIL_EVENT_USE_SELECT
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#endif
 
 #include <pthread.h>
 static pthread_mutex_t listMutex;
@@ -65,11 +69,37 @@ static pthread_mutex_t listMutex;
     } while(0);
 #endif
 
+#ifdef RIL_EVENT_USE_SELECT
 static fd_set readFds;
 static int nfds = 0;
 
 static struct ril_event * watch_table[MAX_FD_EVENTS];
-static struct ril_event timer_list;
+#else
+// Max number of ready fd's collected per epoll_wait(); any others are
+// reported on the next pass through the loop.
+#define EPOLL_BATCH_SIZE 16
+
+static int epollFd = -1;
+
+// Events watching each fd, indexed by fd and chained through fd_next in the
+// order they were added. The epoll entry of an fd only carries the fd, so
+// events may share an fd and a removed event is never reached through it.
+static struct ril_event ** fd_watch = NULL;
+static int fd_watch_size = 0;
+
+// timerfd tracking the earliest timer deadline so timers fire with
+// microsecond rather than epoll_wait() millisecond resolution.
+static int timerFd = -1;
+static struct timeval timerFdDeadline;
+#endif
+
+// Binary min-heap of pending timers ordered by (timeout, timer_seq), so
+// insertion, expiry and cancellation are all O(log n).
+static struct ril_event ** timer_heap = NULL;
+static int timer_count = 0;
+static int timer_capacity = 0;
+static unsigned int timer_seq = 0;
+
 static struct ril_event pending_list;
 
 #define DEBUG 0
@@ -130,11 +160,119 @@ static void removeFromList(struct ril_event * ev)
     dlog("~~~~ -removeFromList ~~~~");
 }
 
+static bool timerBefore(struct ril_event * a, struct ril_event * b)
+{
+    if (timercmp(&a->timeout, &b->timeout, !=)) {
+        return timercmp(&a->timeout, &b->timeout, <);
+    }
+    // equal deadlines fire in the order they were added
+    return (int)(a->timer_seq - b->timer_seq) < 0;
+}
+
+static void heapSet(int index, struct ril_event * ev)
+{
+    timer_heap[index] = ev;
+    ev->timer_index = index;
+}
+
+static void heapSiftUp(int index)
+{
+    struct ril_event * ev = timer_heap[index];
+
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (!timerBefore(ev, timer_heap[parent])) {
+            break;
+        }
+        heapSet(index, timer_heap[parent]);
+        index = parent;
+    }
+    heapSet(index, ev);
+}
+
+static void heapSiftDown(int index)
+{
+    struct ril_event * ev = timer_heap[index];
+
+    for (;;) {
+        int child = 2 * index + 1;
+        if (child >= timer_count) {
+            break;
+        }
+        if (child + 1 < timer_count
+                && timerBefore(timer_heap[child + 1], timer_heap[child])) {
+            child++;
+        }
+        if (!timerBefore(timer_heap[child], ev)) {
+            break;
+        }
+        heapSet(index, timer_heap[child]);
+        index = child;
+    }
+    heapSet(index, ev);
+}
+
+static bool heapInsert(struct ril_event * ev)
+{
+    if (timer_count == timer_capacity) {
+        int capacity = timer_capacity ? timer_capacity * 2 : 16;
+        struct ril_event ** heap = (struct ril_event **)
+                realloc(timer_heap, capacity * sizeof(struct ril_event *));
+        if (heap == NULL) {
+            RLOGE("ril_event: out of memory growing timer queue to %d", capacity);
+            return false;
+        }
+        timer_heap = heap;
+        timer_capacity = capacity;
+    }
+
+    heapSet(timer_count, ev);
+    timer_count++;
+    heapSiftUp(ev->timer_index);
+    return true;
+}
+
+static void heapRemove(struct ril_event * ev)
+{
+    int index = ev->timer_index;
+
+    ev->timer_index = -1;
+    timer_count--;
+    if (index == timer_count) {
+        return;
+    }
+
+    // move the last timer into the hole and restore heap order
+    heapSet(index, timer_heap[timer_count]);
+    if (index > 0 && timerBefore(timer_heap[index], timer_heap[(index - 1) / 2])) {
+        heapSiftUp(index);
+    } else {
+        heapSiftDown(index);
+    }
+}
+
+#ifdef RIL_EVENT_USE_SELECT
+static void addWatch(struct ril_event * ev)
+{
+    for (int i = 0; i < MAX_FD_EVENTS; i++) {
+        if (watch_table[i] == NULL) {
+            watch_table[i] = ev;
+            ev->index = i;
+            dlog("~~~~ added at %d ~~~~", i);
+            dump_event(ev);
+            FD_SET(ev->fd, &readFds);
+            if (ev->fd >= nfds) nfds = ev->fd+1;
+            dlog("~~~~ nfds = %d ~~~~", nfds);
+            return;
+        }
+    }
+    RLOGE("ril_event: watch table full, dropping fd %d", ev->fd);
+}
 
-static void removeWatch(struct ril_event * ev, int index)
+static void removeWatch(struct ril_event * ev)
 {
     dlog("~~~~ +removeWatch ~~~~");
-    watch_table[index] = NULL;
+    watch_table[ev->index] = NULL;
     ev->index = -1;
 
     FD_CLR(ev->fd, &readFds);
@@ -154,31 +292,109 @@ static void removeWatch(struct ril_event * ev, int index)
     }
     dlog("~~~~ -removeWatch ~~~~");
 }
+#else
+static void addWatch(struct ril_event * ev)
+{
+    struct epoll_event eev;
+    struct ril_event ** link;
+
+    if (ev->index >= 0) {
+        // already watched
+        return;
+    }
+    if (ev->fd < 0) {
+        RLOGE("ril_event: cannot watch fd %d", ev->fd);
+        return;
+    }
+
+    if (ev->fd >= fd_watch_size) {
+        int size = fd_watch_size > 0 ? fd_watch_size : MAX_FD_EVENTS;
+        while (size <= ev->fd) {
+            size *= 2;
+        }
+        struct ril_event ** table = (struct ril_event **) realloc(fd_watch,
+                size * sizeof(struct ril_event *));
+        if (table == NULL) {
+            RLOGE("ril_event: no memory to watch fd %d", ev->fd);
+            return;
+        }
+        memset(table + fd_watch_size, 0,
+                (size - fd_watch_size) * sizeof(struct ril_event *));
+        fd_watch = table;
+        fd_watch_size = size;
+    }
+
+    if (fd_watch[ev->fd] == NULL) {
+        memset(&eev, 0, sizeof(eev));
+        eev.events = EPOLLIN;
+        eev.data.fd = ev->fd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, ev->fd, &eev) < 0
+                && (errno != EEXIST
+                    || epoll_ctl(epollFd, EPOLL_CTL_MOD, ev->fd, &eev) < 0)) {
+            RLOGE("ril_event: epoll_ctl add fd %d error (%d)", ev->fd, errno);
+            return;
+        }
+    }
+
+    for (link = &fd_watch[ev->fd]; *link != NULL; link = &(*link)->fd_next);
+    *link = ev;
+    ev->fd_next = NULL;
+    ev->index = 0;
+    dlog("~~~~ added fd %d ~~~~", ev->fd);
+    dump_event(ev);
+}
+
+static void removeWatch(struct ril_event * ev)
+{
+    struct ril_event ** link;
+
+    dlog("~~~~ +removeWatch ~~~~");
+    ev->index = -1;
+    if (ev->fd < 0 || ev->fd >= fd_watch_size) {
+        return;
+    }
+
+    for (link = &fd_watch[ev->fd]; *link != NULL; link = &(*link)->fd_next) {
+        if (*link == ev) {
+            *link = ev->fd_next;
+            break;
+        }
+    }
+    ev->fd_next = NULL;
+
+    // The fd may already have been closed, which drops it from the epoll
+    // set on its own.
+    if (fd_watch[ev->fd] == NULL
+            && epoll_ctl(epollFd, EPOLL_CTL_DEL, ev->fd, NULL) < 0
+            && errno != EBADF && errno != ENOENT) {
+        RLOGE("ril_event: epoll_ctl del fd %d error (%d)", ev->fd, errno);
+    }
+    dlog("~~~~ -removeWatch ~~~~");
+}
+#endif
 
 static void processTimeouts()
 {
     dlog("~~~~ +processTimeouts ~~~~");
     MUTEX_ACQUIRE();
     struct timeval now;
-    struct ril_event * tev = timer_list.next;
-    struct ril_event * next;
 
     getNow(&now);
-    // walk list, see if now >= ev->timeout for any events
+    // pop the heap while now >= ev->timeout
 
     dlog("~~~~ Looking for timers <= %ds + %dus ~~~~", (int)now.tv_sec, (int)now.tv_usec);
-    while ((tev != &timer_list) && (timercmp(&now, &tev->timeout, >))) {
+    while ((timer_count > 0) && (timercmp(&now, &timer_heap[0]->timeout, >))) {
         // Timer expired
+        struct ril_event * tev = timer_heap[0];
         dlog("~~~~ firing timer ~~~~");
-        next = tev->next;
-        removeFromList(tev);
+        heapRemove(tev);
         addToList(tev, &pending_list);
-        tev = next;
     }
     MUTEX_RELEASE();
     dlog("~~~~ -processTimeouts ~~~~");
 }
 
+#ifdef RIL_EVENT_USE_SELECT
 static void processReadReadies(fd_set * rfds, int n)
 {
     dlog("~~~~ +processReadReadies (%d) ~~~~", n);
@@ -189,7 +405,7 @@ static void processReadReadies(fd_set * rfds, int n)
         if (rev != NULL && FD_ISSET(rev->fd, rfds)) {
             addToList(rev, &pending_list);
             if (rev->persist == false) {
-                removeWatch(rev, i);
+                removeWatch(rev);
             }
             n--;
         }
@@ -198,6 +414,41 @@ static void processReadReadies(fd_set * rfds, int n)
     MUTEX_RELEASE();
     dlog("~~~~ -processReadReadies (%d) ~~~~", n);
 }
+#else
+static void processReadReadies(struct epoll_event * events, int n)
+{
+    dlog("~~~~ +processReadReadies (%d) ~~~~", n);
+    MUTEX_ACQUIRE();
+
+    for (int i = 0; i < n; i++) {
+        int fd = events[i].data.fd;
+        if (fd == timerFd) {
+            // timerfd expiry; the timers themselves are handled by
+            // processTimeouts(). EAGAIN means it was re-armed meanwhile.
+            uint64_t expirations;
+            ssize_t len = read(timerFd, &expirations, sizeof(expirations));
+            if (len != sizeof(expirations) && !(len < 0 && errno == EAGAIN)) {
+                RLOGE("ril_event: timerfd read returned %d (%d)", (int)len, errno);
+            }
+            timerclear(&timerFdDeadline);
+            continue;
+        }
+        // events removed since epoll_wait() returned are no longer chained
+        struct ril_event * rev = fd < fd_watch_size ? fd_watch[fd] : NULL;
+        while (rev != NULL) {
+            struct ril_event * next = rev->fd_next;
+            addToList(rev, &pending_list);
+            if (rev->persist == false) {
+                removeWatch(rev);
+            }
+            rev = next;
+        }
+    }
+
+    MUTEX_RELEASE();
+    dlog("~~~~ -processReadReadies (%d) ~~~~", n);
+}
+#endif
 
 static void firePending()
 {
@@ -214,17 +465,20 @@ static void firePending()
 
 static int calcNextTimeout(struct timeval * tv)
 {
-    struct ril_event * tev = timer_list.next;
+    struct ril_event * tev;
     struct timeval now;
 
-    getNow(&now);
-
-    // Sorted list, so calc based on first node
-    if (tev == &timer_list) {
+    MUTEX_ACQUIRE();
+    if (timer_count == 0) {
         // no pending timers
+        MUTEX_RELEASE();
         return -1;
     }
 
+    // Heap, so calc based on the root
+    tev = timer_heap[0];
+    getNow(&now);
+
     dlog("~~~~ now = %ds + %dus ~~~~", (int)now.tv_sec, (int)now.tv_usec);
     dlog("~~~~ next = %ds + %dus ~~~~",
             (int)tev->timeout.tv_sec, (int)tev->timeout.tv_usec);
@@ -234,6 +488,7 @@ static int calcNextTimeout(struct timeval * tv)
         // timer already expired.
         tv->tv_sec = tv->tv_usec = 0;
     }
+    MUTEX_RELEASE();
     return 0;
 }
 
@@ -242,10 +497,35 @@ void ril_event_init()
 {
     MUTEX_INIT();
 
+#ifdef RIL_EVENT_USE_SELECT
     FD_ZERO(&readFds);
-    init_list(&timer_list);
-    init_list(&pending_list);
     memset(watch_table, 0, sizeof(watch_table));
+#else
+    epollFd = epoll_create(MAX_FD_EVENTS);
+    if (epollFd < 0) {
+        RLOGE("ril_event: epoll_create error (%d)", errno);
+    } else {
+        fcntl(epollFd, F_SETFD, FD_CLOEXEC);
+    }
+
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerFd < 0) {
+        RLOGE("ril_event: timerfd_create error (%d)", errno);
+    } else if (epollFd >= 0) {
+        struct epoll_event eev;
+        memset(&eev, 0, sizeof(eev));
+        eev.events = EPOLLIN;
+        eev.data.fd = timerFd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &eev) < 0) {
+            RLOGE("ril_event: epoll_ctl add timerfd error (%d)", errno);
+            close(timerFd);
+            timerFd = -1;
+        }
+    }
+    timerclear(&timerFdDeadline);
+#endif
+    init_list(&pending_list);
+    timer_count = 0;
 }
 
 // Initialize an event
@@ -255,6 +535,7 @@ void ril_event_set(struct ril_event * ev, int fd, bool persist, ril_event_cb fun
     memset(ev, 0, sizeof(struct ril_event));
     ev->fd = fd;
     ev->index = -1;
+    ev->timer_index = -1;
     ev->persist = persist;
     ev->func = func;
     ev->param = param;
@@ -266,18 +547,7 @@ void ril_event_add(struct ril_event * ev)
 {
     dlog("~~~~ +ril_event_add ~~~~");
     MUTEX_ACQUIRE();
-    for (int i = 0; i < MAX_FD_EVENTS; i++) {
-        if (watch_table[i] == NULL) {
-            watch_table[i] = ev;
-            ev->index = i;
-            dlog("~~~~ added at %d ~~~~", i);
-            dump_event(ev);
-            FD_SET(ev->fd, &readFds);
-            if (ev->fd >= nfds) nfds = ev->fd+1;
-            dlog("~~~~ nfds = %d ~~~~", nfds);
-            break;
-        }
-    }
+    addWatch(ev);
     MUTEX_RELEASE();
     dlog("~~~~ -ril_event_add ~~~~");
 }
@@ -288,23 +558,19 @@ void ril_timer_add(struct ril_event * ev, struct timeval * tv)
     dlog("~~~~ +ril_timer_add ~~~~");
     MUTEX_ACQUIRE();
 
-    struct ril_event * list;
     if (tv != NULL) {
-        // add to timer list
-        list = timer_list.next;
+        // add to timer heap
         ev->fd = -1; // make sure fd is invalid
 
         struct timeval now;
         getNow(&now);
         timeradd(&now, tv, &ev->timeout);
+        ev->timer_seq = timer_seq++;
 
-        // keep list sorted
-        while (timercmp(&list->timeout, &ev->timeout, < )
-                && (list != &timer_list)) {
-            list = list->next;
+        if (ev->timer_index >= 0) {
+            heapRemove(ev);
         }
-        // list now points to the first event older than ev
-        addToList(ev, list);
+        heapInsert(ev);
     }
 
     MUTEX_RELEASE();
@@ -317,17 +583,26 @@ void ril_event_del(struct ril_event * ev)
     dlog("~~~~ +ril_event_del ~~~~");
     MUTEX_ACQUIRE();
 
-    if (ev->index < 0 || ev->index >= MAX_FD_EVENTS) {
-        MUTEX_RELEASE();
-        return;
+    if (ev->timer_index >= 0 && ev->timer_index < timer_count
+            && timer_heap[ev->timer_index] == ev) {
+        heapRemove(ev);
     }
 
-    removeWatch(ev, ev->index);
+#ifdef RIL_EVENT_USE_SELECT
+    if (ev->index >= 0 && ev->index < MAX_FD_EVENTS) {
+        removeWatch(ev);
+    }
+#else
+    if (ev->index >= 0) {
+        removeWatch(ev);
+    }
+#endif
 
     MUTEX_RELEASE();
     dlog("~~~~ -ril_event_del ~~~~");
 }
 
+#ifdef RIL_EVENT_USE_SELECT
 #if DEBUG
 static void printReadies(fd_set * rfds)
 {
@@ -353,7 +628,9 @@ void ril_event_loop()
     for (;;) {
 
         // make local copy of read fd_set
+        MUTEX_ACQUIRE();
         memcpy(&rfds, &readFds, sizeof(fd_set));
+        MUTEX_RELEASE();
         if (-1 == calcNextTimeout(&tv)) {
             // no pending timers; block indefinitely
             dlog("~~~~ no timers; blocking indefinitely ~~~~");
@@ -382,3 +659,80 @@ void ril_event_loop()
         firePending();
     }
 }
+#else
+// Arm the timerfd for the earliest timer. Returns the epoll_wait() timeout
+// to use: -1 when the timerfd (or nothing) will wake us, else a fallback
+// millisecond timeout.
+static int armNextTimeout()
+{
+    struct timeval tv;
+    struct timeval deadline;
+    struct itimerspec its;
+
+    if (-1 == calcNextTimeout(&tv)) {
+        // no pending timers; block indefinitely
+        dlog("~~~~ no timers; blocking indefinitely ~~~~");
+        return -1;
+    }
+    dlog("~~~~ blocking for %ds + %dus ~~~~", (int)tv.tv_sec, (int)tv.tv_usec);
+
+    if (timerFd >= 0) {
+        MUTEX_ACQUIRE();
+        deadline = timer_count > 0 ? timer_heap[0]->timeout : timerFdDeadline;
+        MUTEX_RELEASE();
+
+        if (timercmp(&deadline, &timerFdDeadline, ==)) {
+            // already armed
+            return -1;
+        }
+
+        // processTimeouts() fires timers strictly after their deadline
+        memset(&its, 0, sizeof(its));
+        its.it_value.tv_sec = deadline.tv_sec;
+        its.it_value.tv_nsec = deadline.tv_usec * 1000 + 1000;
+        if (its.it_value.tv_nsec >= 1000000000) {
+            its.it_value.tv_sec++;
+            its.it_value.tv_nsec -= 1000000000;
+        }
+        if (timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &its, NULL) == 0) {
+            timerFdDeadline = deadline;
+            return -1;
+        }
+        RLOGE("ril_event: timerfd_settime error (%d)", errno);
+    }
+
+    // round up so an unexpired timer never turns into a busy loop
+    return tv.tv_sec * 1000 + (tv.tv_usec + 999) / 1000;
+}
+
+void ril_event_loop()
+{
+    int n;
+    struct epoll_event events[EPOLL_BATCH_SIZE];
+
+    if (epollFd < 0) {
+        RLOGE("ril_event: no epoll instance");
+        return;
+    }
+
+    for (;;) {
+
+        n = epoll_wait(epollFd, events, EPOLL_BATCH_SIZE, armNextTimeout());
+        dlog("~~~~ %d events fired ~~~~", n);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+
+            RLOGE("ril_event: epoll_wait error (%d)", errno);
+            // bail?
+            return;
+        }
+
+        // Check for timeouts
+        processTimeouts();
+        // Check for read-ready
+        processReadReadies(events, n);
+        // Fire away
+        firePending();
+    }
+}
+#endif
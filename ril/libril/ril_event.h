@@ -15,7 +15,8 @@
 ** limitations under the License.
 */
 
-// Max number of fd's we watch at any one time.  Increase if necessary.
+// Max number of fd's we watch at any one time with the select() backend.
+// The default epoll backend has no fixed limit.
 #define MAX_FD_EVENTS 8
 
 typedef void (*ril_event_cb)(int fd, short events, void *userdata);
@@ -25,7 +26,10 @@ struct ril_event {
     struct ril_event *prev;
 
     int fd;
-    int index;
+    int index;          // watch slot, or -1 when not watched
+    struct ril_event *fd_next;  // next event watching the same fd (epoll)
+    int timer_index;    // position in the timer heap, or -1
+    unsigned int timer_seq;
     bool persist;
     struct timeval timeout;
     ril_event_cb func;
@@ -44,7 +48,7 @@ void ril_event_add(struct ril_event * ev);
 // Add timer event
 void ril_timer_add(struct ril_event * ev, struct timeval * tv);
 
-// Remove event from watch list
+// Remove event from watch list or timer queue
 void ril_event_del(struct ril_event * ev);
 
 // Event loop
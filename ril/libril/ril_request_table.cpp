@@ -0,0 +1,155 @@
+/* //device/libs/telephony/ril_request_table.cpp
+**
+** Copyright 2016, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#define LOG_TAG "RILC"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <utils/Log.h>
+#include <ril_request_table.h>
+
+#define MIN_CAPACITY 64
+
+static size_t hashRequest(void * request, size_t mask)
+{
+    // RequestInfo allocations are at least 8 byte aligned; drop the low
+    // bits and mix the rest (MurmurHash3 finalizer).
+    uint64_t h = (uint64_t) (uintptr_t) request >> 3;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (size_t) h & mask;
+}
+
+static void insertSlot(void ** slots, size_t mask, void * request)
+{
+    size_t i = hashRequest(request, mask);
+
+    while (slots[i] != NULL) {
+        i = (i + 1) & mask;
+    }
+    slots[i] = request;
+}
+
+static bool grow(struct ril_request_table * table)
+{
+    size_t capacity = table->capacity ? table->capacity * 2 : MIN_CAPACITY;
+    void ** slots = (void **) calloc(capacity, sizeof(void *));
+
+    if (slots == NULL) {
+        RLOGE("ril_request_table: out of memory growing to %u",
+                (unsigned int) capacity);
+        return false;
+    }
+
+    for (size_t i = 0; i < table->capacity; i++) {
+        if (table->slots[i] != NULL) {
+            insertSlot(slots, capacity - 1, table->slots[i]);
+        }
+    }
+
+    free(table->slots);
+    table->slots = slots;
+    table->capacity = capacity;
+    return true;
+}
+
+static ssize_t findSlot(struct ril_request_table * table, void * request)
+{
+    if (table->capacity == 0 || request == NULL) {
+        return -1;
+    }
+
+    size_t mask = table->capacity - 1;
+    size_t i = hashRequest(request, mask);
+
+    while (table->slots[i] != NULL) {
+        if (table->slots[i] == request) {
+            return i;
+        }
+        i = (i + 1) & mask;
+    }
+    return -1;
+}
+
+bool ril_request_table_add(struct ril_request_table * table, void * request)
+{
+    // keep the load factor at or below 1/2 so probe runs stay short
+    if ((table->count + 1) * 2 > table->capacity && !grow(table)) {
+        return false;
+    }
+
+    insertSlot(table->slots, table->capacity - 1, request);
+    table->count++;
+    return true;
+}
+
+bool ril_request_table_remove(struct ril_request_table * table, void * request)
+{
+    ssize_t found = findSlot(table, request);
+
+    if (found < 0) {
+        return false;
+    }
+
+    // Backward shift deletion: pull later members of the probe run into the
+    // hole so lookups never need tombstones.
+    size_t mask = table->capacity - 1;
+    size_t hole = found;
+    size_t i = hole;
+
+    for (;;) {
+        i = (i + 1) & mask;
+        if (table->slots[i] == NULL) {
+            break;
+        }
+        size_t home = hashRequest(table->slots[i], mask);
+        // move the entry if its home slot is not in (hole, i]
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            table->slots[hole] = table->slots[i];
+            hole = i;
+        }
+    }
+    table->slots[hole] = NULL;
+    table->count--;
+    return true;
+}
+
+bool ril_request_table_contains(struct ril_request_table * table, void * request)
+{
+    return findSlot(table, request) >= 0;
+}
+
+void ril_request_table_for_each(struct ril_request_table * table,
+        ril_request_table_cb func, void * param)
+{
+    for (size_t i = 0; i < table->capacity; i++) {
+        if (table->slots[i] != NULL) {
+            func(table->slots[i], param);
+        }
+    }
+}
+
+void ril_request_table_free(struct ril_request_table * table)
+{
+    free(table->slots);
+    table->slots = NULL;
+    table->capacity = 0;
+    table->count = 0;
+}
@@ -0,0 +1,55 @@
+/* //device/libs/telephony/ril_request_table.h
+**
+** Copyright 2016, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef RIL_REQUEST_TABLE_H_INCLUDED
+#define RIL_REQUEST_TABLE_H_INCLUDED
+
+// Set of in-flight requests, keyed by the RIL_Token handed to the vendor
+// RIL. Open addressing with linear probing, so adding, completing and
+// cancelling a request are all O(1) on average regardless of how many
+// requests are outstanding. Not thread safe; callers hold their own lock.
+
+#include <stddef.h>
+
+struct ril_request_table {
+    void **slots;
+    size_t capacity;    // always zero or a power of two
+    size_t count;
+};
+
+#define RIL_REQUEST_TABLE_INITIALIZER { NULL, 0, 0 }
+
+typedef void (*ril_request_table_cb)(void *request, void *param);
+
+// Add a request. Returns false if the table could not grow.
+bool ril_request_table_add(struct ril_request_table * table, void * request);
+
+// Remove a request. Returns false if it was not in the table.
+bool ril_request_table_remove(struct ril_request_table * table, void * request);
+
+// Returns true if the request is in the table.
+bool ril_request_table_contains(struct ril_request_table * table, void * request);
+
+// Call func for every request in the table, in no particular order.
+// func must not add or remove entries.
+void ril_request_table_for_each(struct ril_request_table * table,
+        ril_request_table_cb func, void * param);
+
+// Release the table's storage. Requests themselves are not freed.
+void ril_request_table_free(struct ril_request_table * table);
+
+#endif
@@ -0,0 +1,130 @@
+/* //device/libs/telephony/ril_response_queue.cpp
+**
+** Copyright 2016, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <cutils/atomic.h>
+#include <ril_response_queue.h>
+
+// Each cell carries a sequence number that tells producers and the consumer
+// whose turn it is (Vyukov's bounded queue): a cell at position pos is free
+// for the producer holding ticket pos when seq == pos, and holds a response
+// for the consumer when seq == pos + 1. Positions are free-running 32-bit
+// counters compared by signed difference, so wrap-around is harmless.
+
+struct ril_response * ril_response_new(const void * data, size_t len,
+        bool unsolicited, int32_t connection)
+{
+    struct ril_response * response = (struct ril_response *)
+            malloc(sizeof(struct ril_response) + len);
+
+    if (response == NULL) {
+        return NULL;
+    }
+    response->connection = connection;
+    response->unsolicited = unsolicited;
+    response->len = len;
+    response->header = htonl(len);
+    memcpy(response->data, data, len);
+    return response;
+}
+
+void ril_response_free(struct ril_response * response)
+{
+    free(response);
+}
+
+bool ril_response_queue_init(struct ril_response_queue * queue, size_t capacity)
+{
+    size_t size = 2;
+
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    queue->cells = (struct ril_response_cell *)
+            calloc(size, sizeof(struct ril_response_cell));
+    if (queue->cells == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < size; i++) {
+        queue->cells[i].seq = i;
+    }
+    queue->mask = size - 1;
+    queue->enqueuePos = 0;
+    queue->dequeuePos = 0;
+    return true;
+}
+
+bool ril_response_queue_push(struct ril_response_queue * queue,
+        struct ril_response * response)
+{
+    struct ril_response_cell * cell;
+    int32_t pos = android_atomic_acquire_load(&queue->enqueuePos);
+
+    for (;;) {
+        cell = &queue->cells[(uint32_t) pos & queue->mask];
+        int32_t seq = android_atomic_acquire_load(&cell->seq);
+        int32_t diff = (int32_t) ((uint32_t) seq - (uint32_t) pos);
+
+        if (diff == 0) {
+            // our turn; claim the ticket
+            if (android_atomic_acquire_cas(pos, (uint32_t) pos + 1,
+                    &queue->enqueuePos) == 0) {
+                break;
+            }
+            pos = android_atomic_acquire_load(&queue->enqueuePos);
+        } else if (diff < 0) {
+            // the consumer has not freed this cell yet: full
+            return false;
+        } else {
+            // another producer got here first
+            pos = android_atomic_acquire_load(&queue->enqueuePos);
+        }
+    }
+
+    cell->response = response;
+    android_atomic_release_store((uint32_t) pos + 1, &cell->seq);
+    return true;
+}
+
+struct ril_response * ril_response_queue_pop(struct ril_response_queue * queue)
+{
+    int32_t pos = queue->dequeuePos;
+    struct ril_response_cell * cell = &queue->cells[(uint32_t) pos & queue->mask];
+    int32_t seq = android_atomic_acquire_load(&cell->seq);
+
+    if (seq != (int32_t) ((uint32_t) pos + 1)) {
+        return NULL;
+    }
+
+    struct ril_response * response = cell->response;
+    cell->response = NULL;
+    android_atomic_release_store((uint32_t) pos + queue->mask + 1, &cell->seq);
+    android_atomic_release_store((uint32_t) pos + 1, &queue->dequeuePos);
+    return response;
+}
+
+size_t ril_response_queue_size(struct ril_response_queue * queue)
+{
+    int32_t head = android_atomic_acquire_load(&queue->enqueuePos);
+    int32_t tail = android_atomic_acquire_load(&queue->dequeuePos);
+    int32_t size = (int32_t) ((uint32_t) head - (uint32_t) tail);
+
+    return size > 0 ? size : 0;
+}
@@ -0,0 +1,72 @@
+/* //device/libs/telephony/ril_response_queue.h
+**
+** Copyright 2016, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef RIL_RESPONSE_QUEUE_H_INCLUDED
+#define RIL_RESPONSE_QUEUE_H_INCLUDED
+
+// Bounded lock-free queue of responses waiting to be written to a command
+// socket. Any number of threads may push; exactly one thread pops.
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct ril_response {
+    int32_t connection;     // command socket connection this belongs to
+    bool unsolicited;
+    size_t len;             // payload length, excluding header
+    uint32_t header;        // big endian payload length
+    uint8_t data[];         // payload; written together with header
+};
+
+struct ril_response_cell {
+    volatile int32_t seq;
+    struct ril_response *response;
+};
+
+struct ril_response_queue {
+    struct ril_response_cell *cells;
+    uint32_t mask;
+    volatile int32_t enqueuePos;
+    volatile int32_t dequeuePos;
+};
+
+// Allocate a response holding a copy of data. Returns NULL on failure.
+struct ril_response * ril_response_new(const void * data, size_t len,
+        bool unsolicited, int32_t connection);
+
+void ril_response_free(struct ril_response * response);
+
+// capacity is rounded up to a power of two
+bool ril_response_queue_init(struct ril_response_queue * queue, size_t capacity);
+
+// Returns false without blocking if the queue is full.
+bool ril_response_queue_push(struct ril_response_queue * queue,
+        struct ril_response * response);
+
+// Consumer only. Returns NULL if the queue is empty.
+struct ril_response * ril_response_queue_pop(struct ril_response_queue * queue);
+
+// Approximate number of queued responses; exact from the consumer thread
+// when no push is in progress.
+size_t ril_response_queue_size(struct ril_response_queue * queue);
+
+static inline size_t ril_response_queue_capacity(struct ril_response_queue * queue)
+{
+    return queue->mask + 1;
+}
+
+#endif
@@ -0,0 +1,139 @@
+/* //device/libs/telephony/ril_trace.cpp
+**
+** Copyright 2016, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#define LOG_TAG "RILC"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cutils/atomic.h>
+#include <utils/Log.h>
+#include <ril_trace.h>
+
+// Writers claim slots with an atomic counter and publish them seqlock
+// style: seq is cleared (followed by a full barrier) before the entry is
+// filled and set last, so the dumper can skip entries that are being
+// overwritten.
+
+static struct ril_trace_entry s_entries[RIL_TRACE_ENTRIES];
+static volatile int32_t s_next = 0;
+
+static int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void ril_trace_record(int type, int flags, int socketId, int32_t id,
+        int32_t token, int32_t error, const void * payload, size_t len)
+{
+    uint32_t ordinal = (uint32_t) android_atomic_inc(&s_next);
+    struct ril_trace_entry * entry = &s_entries[ordinal & (RIL_TRACE_ENTRIES - 1)];
+    size_t kept = len < RIL_TRACE_PAYLOAD_MAX ? len : RIL_TRACE_PAYLOAD_MAX;
+
+    android_atomic_release_store(0, (volatile int32_t *) &entry->seq);
+    // The release store only orders what came before it; keep the payload
+    // stores below from becoming visible ahead of the cleared seq.
+    android_memory_barrier();
+
+    entry->type = type;
+    entry->flags = flags;
+    entry->socketId = socketId;
+    entry->payloadLen = kept;
+    entry->id = id;
+    entry->token = token;
+    entry->error = error;
+    entry->totalLen = len;
+    entry->timestampNs = nowNs();
+    if (kept > 0 && payload != NULL) {
+        memcpy(entry->payload, payload, kept);
+    }
+
+    android_atomic_release_store(ordinal + 1, (volatile int32_t *) &entry->seq);
+}
+
+static bool entryBefore(const struct ril_trace_entry & a,
+        const struct ril_trace_entry & b)
+{
+    return (int32_t) (a.seq - b.seq) < 0;
+}
+
+static int writeFully(int fd, const void * buffer, size_t len)
+{
+    const uint8_t * p = (const uint8_t *) buffer;
+
+    while (len > 0) {
+        ssize_t written = write(fd, p, len);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += written;
+        len -= written;
+    }
+    return 0;
+}
+
+int ril_trace_dump(int fd)
+{
+    struct ril_trace_entry * snapshot = (struct ril_trace_entry *)
+            malloc(sizeof(s_entries));
+    struct ril_trace_header header;
+    uint32_t count = 0;
+    int ret;
+
+    if (snapshot == NULL) {
+        RLOGE("ril_trace: out of memory for dump");
+        return -1;
+    }
+
+    for (int i = 0; i < RIL_TRACE_ENTRIES; i++) {
+        struct ril_trace_entry * entry = &s_entries[i];
+        int32_t before = android_atomic_acquire_load((volatile int32_t *) &entry->seq);
+
+        if (before == 0) {
+            continue;
+        }
+        memcpy(&snapshot[count], entry, sizeof(*entry));
+        android_memory_barrier();
+        if (android_atomic_acquire_load((volatile int32_t *) &entry->seq) != before) {
+            // overwritten while we copied it
+            continue;
+        }
+        snapshot[count].seq = before;
+        count++;
+    }
+
+    std::sort(snapshot, snapshot + count, entryBefore);
+
+    header.magic = RIL_TRACE_MAGIC;
+    header.version = RIL_TRACE_VERSION;
+    header.entrySize = sizeof(struct ril_trace_entry);
+    header.count = count;
+
+    ret = writeFully(fd, &header, sizeof(header));
+    if (ret == 0) {
+        ret = writeFully(fd, snapshot, count * sizeof(struct ril_trace_entry));
+    }
+
+    free(snapshot);
+    return ret;
+}
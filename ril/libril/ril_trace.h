@@ -0,0 +1,78 @@
+/* //device/libs/telephony/ril_trace.h
+**
+** Copyright 2016, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef RIL_TRACE_H_INCLUDED
+#define RIL_TRACE_H_INCLUDED
+
+// Binary trace of RIL traffic. Every request, response and unsolicited
+// response is recorded into a fixed-size lock-free ring with its raw Parcel
+// payload and no formatting at all, so tracing can stay on in production.
+// The ring is dumped through the rild-debug socket and pretty-printed
+// offline by ril_trace_decode.
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Entries kept; must be a power of two
+#define RIL_TRACE_ENTRIES 1024
+// Payload bytes kept per entry
+#define RIL_TRACE_PAYLOAD_MAX 96
+
+#define RIL_TRACE_MAGIC 0x544c4952  // "RILT"
+#define RIL_TRACE_VERSION 1
+
+enum {
+    RIL_TRACE_REQUEST = 1,      // framework -> vendor RIL
+    RIL_TRACE_RESPONSE = 2,     // vendor RIL -> framework, solicited
+    RIL_TRACE_UNSOL = 3,        // vendor RIL -> framework, unsolicited
+    RIL_TRACE_LOCAL_REQUEST = 4,    // issued through the debug socket
+};
+
+enum {
+    RIL_TRACE_FLAG_CANCELLED = 1 << 0,  // response dropped, socket closed
+    RIL_TRACE_FLAG_LOCAL = 1 << 1,      // response to a local request
+};
+
+struct ril_trace_entry {
+    volatile uint32_t seq;  // 0 while being written, else ordinal + 1
+    uint8_t type;
+    uint8_t flags;
+    uint8_t socketId;
+    uint8_t payloadLen;     // bytes in payload, <= RIL_TRACE_PAYLOAD_MAX
+    int32_t id;             // request or unsolicited response number
+    int32_t token;
+    int32_t error;
+    uint32_t totalLen;      // full payload length before truncation
+    int64_t timestampNs;    // CLOCK_MONOTONIC
+    uint8_t payload[RIL_TRACE_PAYLOAD_MAX];
+};
+
+// Dump header, followed by count entries in ascending seq order
+struct ril_trace_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entrySize;
+    uint32_t count;
+};
+
+void ril_trace_record(int type, int flags, int socketId, int32_t id,
+        int32_t token, int32_t error, const void * payload, size_t len);
+
+// Write the ring to fd in the dump format. Returns 0 on success.
+int ril_trace_dump(int fd);
+
+#endif
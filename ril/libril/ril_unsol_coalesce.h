@@ -0,0 +1,31 @@
+/* //device/libs/telephony/ril_unsol_coalesce.h
+**
+** Copyright 2016, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+/*
+ * Coalescing policy for unsolicited responses listed in ril_unsol_commands.h.
+ * At most one response per id is delivered per window (in ms); anything
+ * arriving inside the window replaces the pending value and is delivered
+ * when the window closes. Ids not listed here are never delayed.
+ *
+ * COALESCE_NO_WAKE_SCREEN_OFF only downgrades responses that are
+ * WAKE_PARTIAL in ril_unsol_commands.h; ids that are already DONT_WAKE
+ * there, like RIL_UNSOL_SIGNAL_STRENGTH, leave it off.
+ */
+    {RIL_UNSOL_NITZ_TIME_RECEIVED, 1000, 0},
+    {RIL_UNSOL_SIGNAL_STRENGTH, 2000, 0},
+    {RIL_UNSOL_CELL_INFO_LIST, 2000, COALESCE_NO_WAKE_SCREEN_OFF},
+    {RIL_UNSOL_DC_RT_INFO_CHANGED, 1000, COALESCE_NO_WAKE_SCREEN_OFF},
+    {RIL_UNSOL_LCEDATA_RECV, 1000, COALESCE_NO_WAKE_SCREEN_OFF},
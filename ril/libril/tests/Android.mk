@@ -0,0 +1,95 @@
+# Copyright 2016 The Android Open Source Project
+
+LOCAL_PATH:= $(call my-dir)
+
+# ril_event loop benchmark, epoll backend
+# =========================================
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    ril_event_benchmark.cpp \
+    ../ril_event.cpp \
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+
+LOCAL_STATIC_LIBRARIES := liblog
+
+LOCAL_LDLIBS += -lpthread
+
+LOCAL_MODULE:= ril_event_benchmark
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# ril_event loop benchmark, legacy select() backend
+# =========================================
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    ril_event_benchmark.cpp \
+    ../ril_event.cpp \
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+
+LOCAL_CFLAGS := -DRIL_EVENT_USE_SELECT
+
+LOCAL_STATIC_LIBRARIES := liblog
+
+LOCAL_LDLIBS += -lpthread
+
+LOCAL_MODULE:= ril_event_benchmark_select
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# Pending request table stress test
+# =========================================
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    ril_request_table_test.cpp \
+    ../ril_request_table.cpp \
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+
+LOCAL_STATIC_LIBRARIES := liblog
+
+LOCAL_LDLIBS += -lpthread
+
+LOCAL_MODULE:= ril_request_table_test
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# Response queue concurrency test
+# =========================================
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    ril_response_queue_test.cpp \
+    ../ril_response_queue.cpp \
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+
+LOCAL_STATIC_LIBRARIES := libcutils
+
+LOCAL_LDLIBS += -lpthread
+
+LOCAL_MODULE:= ril_response_queue_test
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# Binary trace ring test
+# =========================================
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    ril_trace_test.cpp \
+    ../ril_trace.cpp \
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+
+LOCAL_LDLIBS += -lpthread
+
+LOCAL_MODULE:= ril_trace_test
+
+include $(BUILD_HOST_EXECUTABLE)
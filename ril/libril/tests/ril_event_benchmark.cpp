@@ -0,0 +1,335 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Micro-benchmark for the ril_event loop.
+ *
+ * Built twice: ril_event_benchmark uses the default epoll backend and
+ * ril_event_benchmark_select the legacy select() backend, so the numbers
+ * can be compared directly.
+ *
+ * With epoll, a check that events sharing an fd all fire runs first. The
+ * fd scenario drives one byte at a time through a set of watched pipes and
+ * measures the time from write() to callback along with the event loop
+ * thread's CPU time per event. The timer scenario queues timers with random
+ * deadlines the way RIL_requestTimedCallback does and measures insertion
+ * cost and how late each timer fires.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <ril_event.h>
+
+#define MAX_WATCHED_FDS 64
+
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_cond = PTHREAD_COND_INITIALIZER;
+static int s_done;
+
+static int s_wakeupWrite;
+static struct ril_event s_wakeupEvent;
+static pthread_t s_loopThread;
+
+static int s_pipes[MAX_WATCHED_FDS][2];
+static struct ril_event s_events[MAX_WATCHED_FDS];
+static int64_t s_sentNs;
+static std::vector<int64_t> s_latencies;
+
+static int64_t nowNs(clockid_t clock = CLOCK_MONOTONIC) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int64_t loopCpuNs() {
+    clockid_t clock;
+    if (pthread_getcpuclockid(s_loopThread, &clock) != 0) {
+        return 0;
+    }
+    return nowNs(clock);
+}
+
+static void signalDone() {
+    pthread_mutex_lock(&s_mutex);
+    s_done = 1;
+    pthread_cond_signal(&s_cond);
+    pthread_mutex_unlock(&s_mutex);
+}
+
+static void waitDone() {
+    pthread_mutex_lock(&s_mutex);
+    while (!s_done) {
+        pthread_cond_wait(&s_cond, &s_mutex);
+    }
+    s_done = 0;
+    pthread_mutex_unlock(&s_mutex);
+}
+
+static void wakeupCallback(int fd, short flags, void *param) {
+    char buf[16];
+    while (read(fd, buf, sizeof(buf)) > 0);
+}
+
+// Same wakeup pipe ril.cpp uses to get the loop to notice new timers.
+static void triggerEvLoop() {
+    int ret;
+    do {
+        ret = write(s_wakeupWrite, " ", 1);
+    } while (ret < 0 && errno == EINTR);
+}
+
+static void fdCallback(int fd, short flags, void *param) {
+    char c;
+    if (read(fd, &c, 1) == 1) {
+        s_latencies.push_back(nowNs() - s_sentNs);
+        signalDone();
+    }
+}
+
+static void *loopThread(void *param) {
+    ril_event_loop();
+    fprintf(stderr, "ril_event_loop returned\n");
+    exit(1);
+    return NULL;
+}
+
+static void printLatencies(const char *what, std::vector<int64_t> &v) {
+    if (v.empty()) {
+        return;
+    }
+    std::sort(v.begin(), v.end());
+    printf("  %s: p50 %.1f us, p99 %.1f us, max %.1f us\n", what,
+            v[v.size() / 2] / 1000.0,
+            v[v.size() * 99 / 100] / 1000.0,
+            v.back() / 1000.0);
+}
+
+static void runFdScenario(int numFds, int iterations) {
+    for (int i = 0; i < numFds; i++) {
+        if (pipe(s_pipes[i]) < 0) {
+            perror("pipe");
+            exit(1);
+        }
+        ril_event_set(&s_events[i], s_pipes[i][0], true, fdCallback, NULL);
+        ril_event_add(&s_events[i]);
+    }
+    triggerEvLoop();
+
+    s_latencies.clear();
+    s_latencies.reserve(iterations);
+
+    int64_t cpuStart = loopCpuNs();
+    int64_t wallStart = nowNs();
+    for (int i = 0; i < iterations; i++) {
+        int which = rand() % numFds;
+        s_sentNs = nowNs();
+        if (write(s_pipes[which][1], "x", 1) != 1) {
+            perror("write");
+            exit(1);
+        }
+        waitDone();
+    }
+    int64_t wall = nowNs() - wallStart;
+    int64_t cpu = loopCpuNs() - cpuStart;
+
+    printf("fd wakeups: %d watched fds, %d events\n", numFds, iterations);
+    printLatencies("wakeup latency", s_latencies);
+    printf("  loop cpu %.2f us/event, wall %.2f us/event\n",
+            cpu / 1000.0 / iterations, wall / 1000.0 / iterations);
+
+    for (int i = 0; i < numFds; i++) {
+        ril_event_del(&s_events[i]);
+        close(s_pipes[i][0]);
+        close(s_pipes[i][1]);
+    }
+}
+
+#ifndef RIL_EVENT_USE_SELECT
+static int s_sharedCalls[2];
+
+static void sharedCallback(int fd, short flags, void *param) {
+    s_sharedCalls[(intptr_t) param]++;
+}
+
+static void sharedReadCallback(int fd, short flags, void *param) {
+    char c;
+    if (read(fd, &c, 1) == 1) {
+        s_sharedCalls[(intptr_t) param]++;
+        signalDone();
+    }
+}
+
+// Two events watching one fd: both fire, and removing one leaves the other
+// watched. The select() backend accepts this too but only fires the first.
+static void runSharedFdCheck() {
+    int fds[2];
+    struct ril_event once;
+    struct ril_event persistent;
+
+    if (pipe(fds) < 0) {
+        perror("pipe");
+        exit(1);
+    }
+    // callbacks run in the order the events were added, so the reader that
+    // signals completion goes last
+    ril_event_set(&once, fds[0], false, sharedCallback, (void *) 0);
+    ril_event_set(&persistent, fds[0], true, sharedReadCallback, (void *) 1);
+    ril_event_add(&once);
+    ril_event_add(&persistent);
+    triggerEvLoop();
+
+    bool ok = true;
+    for (int i = 0; i < 3; i++) {
+        if (i == 2) {
+            // watched again, then removed before it fires
+            ril_event_set(&once, fds[0], false, sharedCallback, (void *) 0);
+            ril_event_add(&once);
+            ril_event_del(&once);
+            memset(&once, 0, sizeof(once));
+        }
+        if (write(fds[1], "x", 1) != 1) {
+            perror("write");
+            exit(1);
+        }
+        waitDone();
+        ok = ok && s_sharedCalls[0] == 1 && s_sharedCalls[1] == i + 1;
+    }
+    ril_event_del(&persistent);
+    close(fds[0]);
+    close(fds[1]);
+
+    printf("shared fd: %s\n", ok ? "ok" : "FAILED");
+    if (!ok) {
+        exit(1);
+    }
+}
+#endif
+
+struct BenchTimer {
+    struct ril_event event;
+    int64_t deadlineNs;
+};
+
+static int s_timersLeft;
+static std::vector<int64_t> s_lateness;
+
+static void timerCallback(int fd, short flags, void *param) {
+    BenchTimer *t = (BenchTimer *) param;
+    s_lateness.push_back(nowNs() - t->deadlineNs);
+    if (--s_timersLeft == 0) {
+        signalDone();
+    }
+}
+
+static void runTimerScenario(int numTimers, int maxDelayMs) {
+    std::vector<BenchTimer> timers(numTimers);
+
+    s_lateness.clear();
+    s_lateness.reserve(numTimers);
+    s_timersLeft = numTimers;
+
+    int64_t cpuStart = loopCpuNs();
+    int64_t addNs = 0;
+    for (int i = 0; i < numTimers; i++) {
+        struct timeval tv;
+        int delayUs = rand() % (maxDelayMs * 1000);
+        tv.tv_sec = delayUs / 1000000;
+        tv.tv_usec = delayUs % 1000000;
+
+        ril_event_set(&timers[i].event, -1, false, timerCallback, &timers[i]);
+        int64_t start = nowNs();
+        timers[i].deadlineNs = start + delayUs * 1000LL;
+        ril_timer_add(&timers[i].event, &tv);
+        addNs += nowNs() - start;
+        triggerEvLoop();
+    }
+    waitDone();
+    int64_t cpu = loopCpuNs() - cpuStart;
+
+    printf("timers: %d timers over %d ms\n", numTimers, maxDelayMs);
+    printf("  ril_timer_add %.2f us/timer\n", addNs / 1000.0 / numTimers);
+    printLatencies("firing lateness", s_lateness);
+    printf("  loop cpu %.2f us/timer\n", cpu / 1000.0 / numTimers);
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [-f watched fds] [-i iterations] [-t timers] [-d max timer delay ms]\n",
+            argv0);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    int numFds = 6;
+    int iterations = 20000;
+    int numTimers = 5000;
+    int maxDelayMs = 200;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:i:t:d:")) != -1) {
+        switch (opt) {
+            case 'f': numFds = atoi(optarg); break;
+            case 'i': iterations = atoi(optarg); break;
+            case 't': numTimers = atoi(optarg); break;
+            case 'd': maxDelayMs = atoi(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (numFds < 1 || numFds > MAX_WATCHED_FDS || iterations < 1
+            || numTimers < 1 || maxDelayMs < 1) {
+        usage(argv[0]);
+    }
+
+#ifdef RIL_EVENT_USE_SELECT
+    printf("ril_event backend: select\n");
+    if (numFds + 1 > MAX_FD_EVENTS) {
+        fprintf(stderr, "select backend watches at most %d fds\n", MAX_FD_EVENTS);
+        return 1;
+    }
+#else
+    printf("ril_event backend: epoll\n");
+#endif
+
+    int filedes[2];
+    ril_event_init();
+    if (pipe(filedes) < 0) {
+        perror("pipe");
+        return 1;
+    }
+    s_wakeupWrite = filedes[1];
+    ril_event_set(&s_wakeupEvent, filedes[0], true, wakeupCallback, NULL);
+    ril_event_add(&s_wakeupEvent);
+
+    pthread_create(&s_loopThread, NULL, loopThread, NULL);
+
+    srand(1);
+#ifndef RIL_EVENT_USE_SELECT
+    runSharedFdCheck();
+#endif
+    runFdScenario(numFds, iterations);
+    runTimerScenario(numTimers, maxDelayMs);
+    return 0;
+}
@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Stress test for the pending request table used by libril.
+ *
+ * Models thousands of requests in flight on one SIM that the vendor RIL
+ * completes out of order from several threads, the socket closing while
+ * requests are outstanding, and vendor bugs such as completing a token
+ * twice. Timing is reported next to the singly linked list libril used
+ * before, for comparison.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <ril_request_table.h>
+
+struct FakeRequest {
+    int token;
+    char cancelled;
+    FakeRequest *p_next;    // only used by the linked list baseline
+};
+
+static int s_failures;
+
+#define EXPECT(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #cond); \
+            s_failures++; \
+        } \
+    } while (0)
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void countCancel(void *request, void *param) {
+    ((FakeRequest *) request)->cancelled = 1;
+    (*(int *) param)++;
+}
+
+static void testOutOfOrderCompletion(int numRequests) {
+    struct ril_request_table table = RIL_REQUEST_TABLE_INITIALIZER;
+    std::vector<FakeRequest> requests(numRequests);
+
+    for (int i = 0; i < numRequests; i++) {
+        requests[i].token = i;
+        EXPECT(ril_request_table_add(&table, &requests[i]));
+    }
+    EXPECT(table.count == (size_t) numRequests);
+
+    std::vector<int> order(numRequests);
+    for (int i = 0; i < numRequests; i++) {
+        order[i] = i;
+    }
+    std::random_shuffle(order.begin(), order.end());
+
+    // complete the first half, then check that exactly the rest is pending
+    int half = numRequests / 2;
+    for (int i = 0; i < half; i++) {
+        EXPECT(ril_request_table_remove(&table, &requests[order[i]]));
+    }
+    for (int i = 0; i < numRequests; i++) {
+        bool completed = std::find(order.begin(), order.begin() + half, i)
+                != order.begin() + half;
+        EXPECT(ril_request_table_contains(&table, &requests[i]) == !completed);
+    }
+
+    // a vendor RIL completing the same token twice must be rejected
+    EXPECT(!ril_request_table_remove(&table, &requests[order[0]]));
+    EXPECT(!ril_request_table_remove(&table, NULL));
+
+    // the command socket closes; everything left gets cancelled
+    int cancelled = 0;
+    ril_request_table_for_each(&table, countCancel, &cancelled);
+    EXPECT(cancelled == numRequests - half);
+
+    for (int i = half; i < numRequests; i++) {
+        EXPECT(requests[order[i]].cancelled);
+        EXPECT(ril_request_table_remove(&table, &requests[order[i]]));
+    }
+    EXPECT(table.count == 0);
+
+    ril_request_table_free(&table);
+}
+
+struct ThreadedState {
+    pthread_mutex_t mutex;
+    struct ril_request_table table;
+    std::vector<FakeRequest> *requests;
+    int numThreads;
+    int completed;
+};
+
+struct CompleterArgs {
+    ThreadedState *state;
+    int index;
+};
+
+// Each vendor thread owns every numThreads-th request and completes them
+// in reverse order, spinning until the dispatcher has added each one.
+static void *completerThread(void *param) {
+    CompleterArgs *args = (CompleterArgs *) param;
+    ThreadedState *state = args->state;
+    int numRequests = state->requests->size();
+
+    for (int i = numRequests - 1 - args->index; i >= 0; i -= state->numThreads) {
+        FakeRequest *pRI = &(*state->requests)[i];
+        for (;;) {
+            pthread_mutex_lock(&state->mutex);
+            bool found = ril_request_table_remove(&state->table, pRI);
+            if (found) {
+                state->completed++;
+            }
+            pthread_mutex_unlock(&state->mutex);
+            if (found) {
+                break;
+            }
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void testConcurrentCompletion(int numRequests, int numThreads) {
+    ThreadedState state;
+    std::vector<FakeRequest> requests(numRequests);
+    std::vector<pthread_t> threads(numThreads);
+    std::vector<CompleterArgs> args(numThreads);
+
+    pthread_mutex_init(&state.mutex, NULL);
+    memset(&state.table, 0, sizeof(state.table));
+    state.requests = &requests;
+    state.numThreads = numThreads;
+    state.completed = 0;
+
+    for (int t = 0; t < numThreads; t++) {
+        args[t].state = &state;
+        args[t].index = t;
+        pthread_create(&threads[t], NULL, completerThread, &args[t]);
+    }
+
+    // dispatch thread
+    for (int i = 0; i < numRequests; i++) {
+        requests[i].token = i;
+        pthread_mutex_lock(&state.mutex);
+        EXPECT(ril_request_table_add(&state.table, &requests[i]));
+        pthread_mutex_unlock(&state.mutex);
+    }
+
+    for (int t = 0; t < numThreads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    EXPECT(state.completed == numRequests);
+    EXPECT(state.table.count == 0);
+
+    ril_request_table_free(&state.table);
+    pthread_mutex_destroy(&state.mutex);
+}
+
+// The list walk checkAndDequeueRequestInfo() used to do.
+static bool listRemove(FakeRequest **head, FakeRequest *pRI) {
+    for (FakeRequest **ppCur = head; *ppCur != NULL; ppCur = &((*ppCur)->p_next)) {
+        if (*ppCur == pRI) {
+            *ppCur = pRI->p_next;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void benchmark(int numRequests) {
+    std::vector<FakeRequest> requests(numRequests);
+    std::vector<int> order(numRequests);
+    for (int i = 0; i < numRequests; i++) {
+        order[i] = i;
+    }
+    std::random_shuffle(order.begin(), order.end());
+
+    struct ril_request_table table = RIL_REQUEST_TABLE_INITIALIZER;
+    int64_t start = nowNs();
+    for (int i = 0; i < numRequests; i++) {
+        ril_request_table_add(&table, &requests[i]);
+    }
+    for (int i = 0; i < numRequests; i++) {
+        ril_request_table_remove(&table, &requests[order[i]]);
+    }
+    int64_t tableNs = nowNs() - start;
+    ril_request_table_free(&table);
+
+    FakeRequest *head = NULL;
+    start = nowNs();
+    for (int i = 0; i < numRequests; i++) {
+        requests[i].p_next = head;
+        head = &requests[i];
+    }
+    for (int i = 0; i < numRequests; i++) {
+        listRemove(&head, &requests[order[i]]);
+    }
+    int64_t listNs = nowNs() - start;
+
+    printf("%6d outstanding: table %.3f us/request, list %.3f us/request\n",
+            numRequests, tableNs / 1000.0 / numRequests,
+            listNs / 1000.0 / numRequests);
+}
+
+int main(int argc, char **argv) {
+    srand(1);
+
+    testOutOfOrderCompletion(10);
+    testOutOfOrderCompletion(5000);
+    testConcurrentCompletion(20000, 4);
+
+    benchmark(16);
+    benchmark(256);
+    benchmark(4096);
+
+    if (s_failures != 0) {
+        printf("FAILED (%d)\n", s_failures);
+        return 1;
+    }
+    printf("PASSED\n");
+    return 0;
+}
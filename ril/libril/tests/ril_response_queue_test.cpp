@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Test for the response queue between vendor threads and the per-socket
+ * writer thread: several producers push concurrently into a small queue
+ * while one consumer drains it. Every response must arrive exactly once
+ * and each producer's responses must stay in order.
+ */
+
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include <ril_response_queue.h>
+
+struct Payload {
+    int32_t producer;
+    int32_t seq;
+};
+
+struct ProducerArgs {
+    struct ril_response_queue *queue;
+    int index;
+    int count;
+    int fullRetries;
+};
+
+static int s_failures;
+
+#define EXPECT(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #cond); \
+            s_failures++; \
+        } \
+    } while (0)
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void *producerThread(void *param) {
+    ProducerArgs *args = (ProducerArgs *) param;
+
+    for (int i = 0; i < args->count; i++) {
+        Payload payload = { args->index, i };
+        struct ril_response *response = ril_response_new(&payload,
+                sizeof(payload), (i & 1) != 0, 0);
+        while (!ril_response_queue_push(args->queue, response)) {
+            args->fullRetries++;
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void testBasic() {
+    struct ril_response_queue queue;
+
+    EXPECT(ril_response_queue_init(&queue, 3));
+    EXPECT(ril_response_queue_capacity(&queue) == 4);
+    EXPECT(ril_response_queue_pop(&queue) == NULL);
+
+    Payload payload = { 0, 0 };
+    for (int i = 0; i < 4; i++) {
+        payload.seq = i;
+        EXPECT(ril_response_queue_push(&queue,
+                ril_response_new(&payload, sizeof(payload), false, 7)));
+    }
+    struct ril_response *extra = ril_response_new(&payload, sizeof(payload), true, 7);
+    EXPECT(!ril_response_queue_push(&queue, extra));
+    EXPECT(ril_response_queue_size(&queue) == 4);
+
+    for (int i = 0; i < 4; i++) {
+        struct ril_response *response = ril_response_queue_pop(&queue);
+        EXPECT(response != NULL);
+        if (response == NULL) {
+            continue;
+        }
+        EXPECT(response->connection == 7);
+        EXPECT(response->len == sizeof(Payload));
+        EXPECT(ntohl(response->header) == sizeof(Payload));
+        // header and payload must be contiguous for writev()
+        EXPECT((uint8_t *) &response->header + sizeof(response->header)
+                == response->data);
+        EXPECT(((Payload *) response->data)->seq == i);
+        ril_response_free(response);
+    }
+    EXPECT(ril_response_queue_pop(&queue) == NULL);
+    EXPECT(ril_response_queue_push(&queue, extra));
+    ril_response_free(ril_response_queue_pop(&queue));
+    free(queue.cells);
+}
+
+static void testConcurrent(int numProducers, int perProducer, size_t capacity) {
+    struct ril_response_queue queue;
+    std::vector<pthread_t> threads(numProducers);
+    std::vector<ProducerArgs> args(numProducers);
+    std::vector<int32_t> nextSeq(numProducers, 0);
+
+    EXPECT(ril_response_queue_init(&queue, capacity));
+
+    int64_t start = nowNs();
+    for (int p = 0; p < numProducers; p++) {
+        args[p].queue = &queue;
+        args[p].index = p;
+        args[p].count = perProducer;
+        args[p].fullRetries = 0;
+        pthread_create(&threads[p], NULL, producerThread, &args[p]);
+    }
+
+    int total = numProducers * perProducer;
+    for (int received = 0; received < total; ) {
+        struct ril_response *response = ril_response_queue_pop(&queue);
+        if (response == NULL) {
+            sched_yield();
+            continue;
+        }
+        Payload *payload = (Payload *) response->data;
+        EXPECT(payload->producer >= 0 && payload->producer < numProducers);
+        if (payload->producer >= 0 && payload->producer < numProducers) {
+            EXPECT(payload->seq == nextSeq[payload->producer]);
+            nextSeq[payload->producer] = payload->seq + 1;
+        }
+        EXPECT(response->unsolicited == ((payload->seq & 1) != 0));
+        ril_response_free(response);
+        received++;
+    }
+    int64_t elapsed = nowNs() - start;
+
+    int fullRetries = 0;
+    for (int p = 0; p < numProducers; p++) {
+        pthread_join(threads[p], NULL);
+        fullRetries += args[p].fullRetries;
+    }
+    EXPECT(ril_response_queue_pop(&queue) == NULL);
+
+    printf("%d producers, capacity %u: %.3f us/response, %d pushes hit a full queue\n",
+            numProducers, (unsigned int) ril_response_queue_capacity(&queue),
+            elapsed / 1000.0 / total, fullRetries);
+    free(queue.cells);
+}
+
+int main(int argc, char **argv) {
+    testBasic();
+    testConcurrent(1, 200000, 256);
+    testConcurrent(4, 100000, 256);
+    testConcurrent(8, 50000, 4);
+
+    if (s_failures != 0) {
+        printf("FAILED (%d)\n", s_failures);
+        return 1;
+    }
+    printf("PASSED\n");
+    return 0;
+}
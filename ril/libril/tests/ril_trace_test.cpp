@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Test for the binary RIL trace ring: several threads record entries while
+ * the main thread dumps the ring repeatedly. Every dump must parse, be in
+ * strictly increasing seq order, and only contain fully written entries.
+ * Recording cost is reported, since the ring is meant to stay on in
+ * production.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <ril_trace.h>
+
+struct RecorderArgs {
+    int index;
+    int count;
+};
+
+static int s_failures;
+
+#define EXPECT(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #cond); \
+            s_failures++; \
+        } \
+    } while (0)
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Payload bytes are derived from (thread, token) so torn entries show up.
+static void fillPayload(uint8_t *payload, size_t len, int index, int token) {
+    for (size_t i = 0; i < len; i++) {
+        payload[i] = (uint8_t)(index * 131 + token * 7 + i);
+    }
+}
+
+static void *recorderThread(void *param) {
+    RecorderArgs *args = (RecorderArgs *) param;
+    uint8_t payload[RIL_TRACE_PAYLOAD_MAX * 2];
+
+    for (int token = 0; token < args->count; token++) {
+        size_t len = token % sizeof(payload);
+        fillPayload(payload, len, args->index, token);
+        ril_trace_record(RIL_TRACE_REQUEST, 0, args->index, 1000 + len, token,
+                args->index, payload, len);
+    }
+    return NULL;
+}
+
+// Dumps the ring through a temporary file and returns the parsed entries.
+static std::vector<struct ril_trace_entry> dumpRing() {
+    std::vector<struct ril_trace_entry> entries;
+    struct ril_trace_header header;
+    FILE *f = tmpfile();
+
+    EXPECT(f != NULL);
+    if (f == NULL) {
+        return entries;
+    }
+    EXPECT(ril_trace_dump(fileno(f)) == 0);
+    rewind(f);
+
+    EXPECT(fread(&header, sizeof(header), 1, f) == 1);
+    EXPECT(header.magic == RIL_TRACE_MAGIC);
+    EXPECT(header.version == RIL_TRACE_VERSION);
+    EXPECT(header.entrySize == sizeof(struct ril_trace_entry));
+    EXPECT(header.count <= RIL_TRACE_ENTRIES);
+
+    entries.resize(header.count);
+    if (header.count > 0) {
+        EXPECT(fread(&entries[0], sizeof(struct ril_trace_entry), header.count, f)
+                == header.count);
+    }
+    fclose(f);
+    return entries;
+}
+
+// Checks the entries recorded since start; older ones, left in the ring by
+// an earlier test until the recorders overwrite them, are skipped.
+static void checkEntries(const std::vector<struct ril_trace_entry> &entries, int64_t start) {
+    uint8_t expected[RIL_TRACE_PAYLOAD_MAX];
+
+    for (size_t i = 0; i < entries.size(); i++) {
+        const struct ril_trace_entry &e = entries[i];
+        EXPECT(e.seq != 0);
+        if (i > 0) {
+            EXPECT((int32_t)(e.seq - entries[i - 1].seq) > 0);
+        }
+        if (e.timestampNs < start) {
+            continue;
+        }
+        EXPECT(e.type == RIL_TRACE_REQUEST);
+        EXPECT(e.socketId == e.error);
+        EXPECT(e.totalLen == (uint32_t)(e.id - 1000));
+        EXPECT(e.payloadLen == (e.totalLen < RIL_TRACE_PAYLOAD_MAX
+                ? e.totalLen : RIL_TRACE_PAYLOAD_MAX));
+
+        fillPayload(expected, e.payloadLen, e.socketId, e.token);
+        EXPECT(memcmp(expected, e.payload, e.payloadLen) == 0);
+    }
+}
+
+static void testSingleThread() {
+    for (int token = 0; token < 10; token++) {
+        ril_trace_record(RIL_TRACE_UNSOL, 0, 0, 1000, token, 0, NULL, 0);
+    }
+    std::vector<struct ril_trace_entry> entries = dumpRing();
+    EXPECT(entries.size() == 10);
+    for (size_t i = 0; i < entries.size(); i++) {
+        EXPECT(entries[i].token == (int32_t) i);
+        EXPECT(entries[i].type == RIL_TRACE_UNSOL);
+        EXPECT(i == 0 || entries[i].timestampNs >= entries[i - 1].timestampNs);
+    }
+}
+
+static void testConcurrent(int numThreads, int perThread) {
+    std::vector<pthread_t> threads(numThreads);
+    std::vector<RecorderArgs> args(numThreads);
+    int dumps = 0;
+
+    int64_t start = nowNs();
+    for (int t = 0; t < numThreads; t++) {
+        args[t].index = t;
+        args[t].count = perThread;
+        pthread_create(&threads[t], NULL, recorderThread, &args[t]);
+    }
+
+    // dump while the recorders are running, like a debug socket client would
+    for (int i = 0; i < 20; i++) {
+        checkEntries(dumpRing(), start);
+        dumps++;
+    }
+
+    for (int t = 0; t < numThreads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    int64_t elapsed = nowNs() - start;
+
+    std::vector<struct ril_trace_entry> entries = dumpRing();
+    checkEntries(entries, start);
+    EXPECT(entries.size() == RIL_TRACE_ENTRIES);
+
+    printf("%d threads: %.3f us/record with %d concurrent dumps\n", numThreads,
+            elapsed / 1000.0 / (numThreads * perThread), dumps);
+}
+
+int main(int argc, char **argv) {
+    testSingleThread();
+    testConcurrent(1, 200000);
+    testConcurrent(4, 100000);
+
+    if (s_failures != 0) {
+        printf("FAILED (%d)\n", s_failures);
+        return 1;
+    }
+    printf("PASSED\n");
+    return 0;
+}
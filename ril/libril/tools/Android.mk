@@ -0,0 +1,17 @@
+# Copyright 2016 The Android Open Source Project
+
+LOCAL_PATH:= $(call my-dir)
+
+# Offline decoder for "radiooptions 12" trace dumps
+# =========================================
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    ril_trace_decode.cpp \
+    ../ril_strings.cpp \
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+
+LOCAL_MODULE:= ril_trace_decode
+
+include $(BUILD_HOST_EXECUTABLE)
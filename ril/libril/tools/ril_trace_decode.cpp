@@ -0,0 +1,375 @@
+/* //device/libs/telephony/tools/ril_trace_decode.cpp
+**
+** Copyright 2016, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+/*
+ * Pretty-prints a libril trace dump:
+ *
+ *   adb shell radiooptions 12 0 0 > trace.bin
+ *   ril_trace_decode trace.bin
+ *
+ * Payloads are decoded with the same ril_commands.h and
+ * ril_unsol_commands.h tables libril dispatches with; the common int and
+ * string marshallers are understood, everything else is shown as hex.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <vector>
+
+#include <telephony/ril.h>
+#include <ril_trace.h>
+
+extern "C" const char * requestToString(int request);
+extern "C" const char * failCauseToString(RIL_Errno);
+
+#define NUM_ELEMS(a)     (sizeof (a) / sizeof (a)[0])
+
+// Reads Parcel-encoded values out of a possibly truncated payload.
+struct PayloadReader {
+    const uint8_t *data;
+    size_t len;
+    size_t pos;
+
+    bool readInt32(int32_t *out) {
+        if (pos + sizeof(int32_t) > len) {
+            return false;
+        }
+        memcpy(out, data + pos, sizeof(int32_t));
+        pos += sizeof(int32_t);
+        return true;
+    }
+
+    // String16: char count, UTF-16 chars, NUL, padded to 4 bytes
+    bool readString(char *out, size_t outLen) {
+        int32_t count;
+        if (!readInt32(&count)) {
+            return false;
+        }
+        if (count < 0) {
+            snprintf(out, outLen, "(null)");
+            return true;
+        }
+        size_t o = 0;
+        for (int32_t i = 0; i < count; i++) {
+            uint16_t c;
+            if (pos + sizeof(c) > len) {
+                out[o] = '\0';
+                return false;
+            }
+            memcpy(&c, data + pos, sizeof(c));
+            pos += sizeof(c);
+            if (o + 1 < outLen) {
+                out[o++] = (c >= 0x20 && c < 0x7f) ? (char) c : '?';
+            }
+        }
+        out[o] = '\0';
+        size_t padded = ((count + 1) * sizeof(uint16_t) + 3) & ~3;
+        pos += padded - count * sizeof(uint16_t);
+        return true;
+    }
+};
+
+typedef void (*Decoder)(PayloadReader &r);
+
+static void printTruncated(PayloadReader &r) {
+    printf("...");
+}
+
+static void decodeHex(PayloadReader &r) {
+    printf("%zu bytes:", r.len);
+    for (size_t i = 0; i < r.len; i++) {
+        printf(" %02x", r.data[i]);
+    }
+}
+
+static void decodeVoid(PayloadReader &r) {
+}
+
+static void decodeIntArray(PayloadReader &r) {
+    int32_t count, value;
+    if (!r.readInt32(&count)) {
+        printTruncated(r);
+        return;
+    }
+    for (int32_t i = 0; i < count; i++) {
+        if (!r.readInt32(&value)) {
+            printTruncated(r);
+            return;
+        }
+        printf("%s%d", i == 0 ? "" : ",", value);
+    }
+}
+
+static void decodeString(PayloadReader &r) {
+    char buf[RIL_TRACE_PAYLOAD_MAX + 1];
+    bool complete = r.readString(buf, sizeof(buf));
+    printf("%s", buf);
+    if (!complete) {
+        printTruncated(r);
+    }
+}
+
+static void decodeStringArray(PayloadReader &r) {
+    int32_t count;
+    if (!r.readInt32(&count)) {
+        printTruncated(r);
+        return;
+    }
+    for (int32_t i = 0; i < count; i++) {
+        if (i != 0) {
+            printf(",");
+        }
+        char buf[RIL_TRACE_PAYLOAD_MAX + 1];
+        bool complete = r.readString(buf, sizeof(buf));
+        printf("%s", buf);
+        if (!complete) {
+            printTruncated(r);
+            return;
+        }
+    }
+}
+
+static void decodeFailCause(PayloadReader &r) {
+    int32_t cause;
+    if (!r.readInt32(&cause)) {
+        printTruncated(r);
+        return;
+    }
+    printf("%d", cause);
+    if (r.pos < r.len) {
+        printf(",vendor_cause=");
+        decodeString(r);
+    }
+}
+
+static void decodeRaw(PayloadReader &r) {
+    int32_t len;
+    if (!r.readInt32(&len)) {
+        printTruncated(r);
+        return;
+    }
+    if (len < 0) {
+        printf("(null)");
+        return;
+    }
+    for (int32_t i = 0; i < len; i++) {
+        if (r.pos >= r.len) {
+            printTruncated(r);
+            return;
+        }
+        printf("%02x", r.data[r.pos++]);
+    }
+}
+
+// Map every marshaller name used by the command tables onto a decoder.
+#define dispatchVoid decodeVoid
+#define dispatchInts decodeIntArray
+#define dispatchString decodeString
+#define dispatchStrings decodeStringArray
+#define dispatchRaw decodeRaw
+#define responseVoid decodeVoid
+#define responseInts decodeIntArray
+#define responseString decodeString
+#define responseStrings decodeStringArray
+#define responseRaw decodeRaw
+#define responseFailCause decodeFailCause
+
+#define dispatchCallForward decodeHex
+#define dispatchCdmaBrSmsCnf decodeHex
+#define dispatchCdmaSms decodeHex
+#define dispatchCdmaSmsAck decodeHex
+#define dispatchCdmaSubscriptionSource decodeHex
+#define dispatchDataCall decodeHex
+#define dispatchDataProfile decodeHex
+#define dispatchDial decodeHex
+#define dispatchGsmBrSmsCnf decodeHex
+#define dispatchImsSms decodeHex
+#define dispatchNVReadItem decodeHex
+#define dispatchNVWriteItem decodeHex
+#define dispatchRadioCapability decodeHex
+#define dispatchRilCdmaSmsWriteArgs decodeHex
+#define dispatchSIM_APDU decodeHex
+#define dispatchSIM_IO decodeHex
+#define dispatchSetInitialAttachApn decodeHex
+#define dispatchSimAuthentication decodeHex
+#define dispatchSmsWrite decodeHex
+#define dispatchUiccSubscripton decodeHex
+#define dispatchVoiceRadioTech decodeHex
+#define responseActivityData decodeHex
+#define responseCallForwards decodeHex
+#define responseCallList decodeHex
+#define responseCallRing decodeHex
+#define responseCdmaBrSmsCnf decodeHex
+#define responseCdmaCallWaiting decodeHex
+#define responseCdmaInformationRecords decodeHex
+#define responseCdmaSms decodeHex
+#define responseCellInfoList decodeHex
+#define responseCellList decodeHex
+#define responseDataCallList decodeHex
+#define responseDcRtInfo decodeHex
+#define responseGsmBrSmsCnf decodeHex
+#define responseHardwareConfig decodeHex
+#define responseLceData decodeHex
+#define responseLceStatus decodeHex
+#define responseRadioCapability decodeHex
+#define responseRilSignalStrength decodeHex
+#define responseSIM_IO decodeHex
+#define responseSMS decodeHex
+#define responseSSData decodeHex
+#define responseSetupDataCall decodeHex
+#define responseSimRefresh decodeHex
+#define responseSimStatus decodeHex
+#define responseSsn decodeHex
+
+enum WakeType {DONT_WAKE, WAKE_PARTIAL};
+
+typedef struct {
+    int requestNumber;
+    Decoder request;
+    Decoder response;
+} CommandDecoder;
+
+typedef struct {
+    int requestNumber;
+    Decoder response;
+    WakeType wakeType;
+} UnsolDecoder;
+
+static CommandDecoder s_commands[] = {
+#include "../ril_commands.h"
+};
+
+static UnsolDecoder s_unsolResponses[] = {
+#include "../ril_unsol_commands.h"
+};
+
+static const char * typeToString(int type) {
+    switch (type) {
+        case RIL_TRACE_REQUEST: return "REQ";
+        case RIL_TRACE_RESPONSE: return "RSP";
+        case RIL_TRACE_UNSOL: return "UNSOL";
+        case RIL_TRACE_LOCAL_REQUEST: return "LOCAL";
+        default: return "?";
+    }
+}
+
+static Decoder findDecoder(const struct ril_trace_entry &e) {
+    if (e.type == RIL_TRACE_UNSOL) {
+        int index = e.id - RIL_UNSOL_RESPONSE_BASE;
+        if (index >= 0 && index < (int) NUM_ELEMS(s_unsolResponses)) {
+            return s_unsolResponses[index].response;
+        }
+        return decodeHex;
+    }
+    if (e.id > 0 && e.id < (int) NUM_ELEMS(s_commands)) {
+        return e.type == RIL_TRACE_RESPONSE ? s_commands[e.id].response
+                : s_commands[e.id].request;
+    }
+    return decodeHex;
+}
+
+static void printEntry(const struct ril_trace_entry &e, int64_t startNs,
+        std::map<int64_t, int64_t> &pending) {
+    // tokens are per socket, so key the in-flight map on both
+    int64_t key = ((int64_t) e.socketId << 32) | (uint32_t) e.token;
+
+    printf("%10.6f RIL%d %-5s ", (e.timestampNs - startNs) / 1e9, e.socketId,
+            typeToString(e.type));
+    if (e.type == RIL_TRACE_UNSOL) {
+        printf("%s ", requestToString(e.id));
+    } else {
+        printf("[%04d] %s ", e.token, requestToString(e.id));
+    }
+
+    if (e.type == RIL_TRACE_RESPONSE) {
+        if (e.error != RIL_E_SUCCESS) {
+            printf("error %s ", failCauseToString((RIL_Errno) e.error));
+        }
+        std::map<int64_t, int64_t>::iterator it = pending.find(key);
+        if (it != pending.end()) {
+            printf("(%.3f ms) ", (e.timestampNs - it->second) / 1e6);
+            pending.erase(it);
+        }
+        if (e.flags & RIL_TRACE_FLAG_CANCELLED) {
+            printf("cancelled ");
+        }
+    } else if (e.type != RIL_TRACE_UNSOL) {
+        pending[key] = e.timestampNs;
+    }
+
+    // local requests and dropped responses never had a Parcel
+    if (e.type == RIL_TRACE_LOCAL_REQUEST
+            || (e.flags & (RIL_TRACE_FLAG_CANCELLED | RIL_TRACE_FLAG_LOCAL))) {
+        printf("\n");
+        return;
+    }
+
+    PayloadReader reader = { e.payload, e.payloadLen, 0 };
+    printf("{");
+    findDecoder(e)(reader);
+    if (e.totalLen > e.payloadLen) {
+        printf("} %u of %u bytes\n", e.payloadLen, e.totalLen);
+    } else {
+        printf("}\n");
+    }
+}
+
+int main(int argc, char **argv) {
+    FILE *in = stdin;
+    struct ril_trace_header header;
+
+    if (argc > 2) {
+        fprintf(stderr, "usage: %s [trace file]\n", argv[0]);
+        return 1;
+    }
+    if (argc == 2 && (in = fopen(argv[1], "rb")) == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    if (fread(&header, sizeof(header), 1, in) != 1
+            || header.magic != RIL_TRACE_MAGIC) {
+        fprintf(stderr, "not a RIL trace dump\n");
+        return 1;
+    }
+    if (header.version != RIL_TRACE_VERSION
+            || header.entrySize != sizeof(struct ril_trace_entry)) {
+        fprintf(stderr, "unsupported trace version %u, entry size %u\n",
+                header.version, header.entrySize);
+        return 1;
+    }
+
+    std::vector<struct ril_trace_entry> entries(header.count);
+    size_t count = header.count == 0 ? 0
+            : fread(&entries[0], sizeof(struct ril_trace_entry), header.count, in);
+    if (count != header.count) {
+        fprintf(stderr, "trace truncated: %zu of %u entries\n", count, header.count);
+    }
+
+    std::map<int64_t, int64_t> pending;
+    for (size_t i = 0; i < count; i++) {
+        printEntry(entries[i], entries[0].timestampNs, pending);
+    }
+
+    if (in != stdin) {
+        fclose(in);
+    }
+    return 0;
+}
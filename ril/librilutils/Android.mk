@@ -48,3 +48,5 @@ LOCAL_SRC_FILES := proto/sap-api.proto
 LOCAL_PROTOC_OPTIMIZE_TYPE := micro
 
 include $(BUILD_STATIC_JAVA_LIBRARY)
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
@@ -26,37 +26,52 @@
 #include <winsock2.h>   /* for ntohl */
 #else
 #include <netinet/in.h>
+#include <sys/uio.h>
 #endif
 
 #define HEADER_SIZE 4
 
+/*
+ * Records are kept in a ring buffer so a partial record never has to be
+ * moved back to the start of the buffer before the next read. head and tail
+ * are free-running byte counts; the buffer offset is (count & mask).
+ */
 struct RecordStream {
     int fd;
     size_t maxRecordLen;
 
     unsigned char *buffer;
+    size_t size;
+    size_t mask;
+
+    size_t head;    /* bytes read from fd */
+    size_t tail;    /* bytes handed out as records */
 
-    unsigned char *unconsumed;
-    unsigned char *read_end;
-    unsigned char *buffer_end;
+    /* contiguous copy of a wrapped record for record_stream_get_next() */
+    unsigned char *linear;
 };
 
 
 extern RecordStream *record_stream_new(int fd, size_t maxRecordLen)
 {
     RecordStream *ret;
+    size_t size;
 
     assert (maxRecordLen <= 0xffff);
 
+    /* room for at least two maximal records, rounded up to a power of two */
+    size = 1;
+    while (size < 2 * (maxRecordLen + HEADER_SIZE)) {
+        size <<= 1;
+    }
+
     ret = (RecordStream *)calloc(1, sizeof(RecordStream));
 
     ret->fd = fd;
     ret->maxRecordLen = maxRecordLen;
-    ret->buffer = (unsigned char *)malloc (maxRecordLen + HEADER_SIZE);
-
-    ret->unconsumed = ret->buffer;
-    ret->read_end = ret->buffer;
-    ret->buffer_end = ret->buffer + maxRecordLen + HEADER_SIZE;
+    ret->buffer = (unsigned char *)malloc (size);
+    ret->size = size;
+    ret->mask = size - 1;
 
     return ret;
 }
@@ -64,123 +79,227 @@ extern RecordStream *record_stream_new(int fd, size_t maxRecordLen)
 
 extern void record_stream_free(RecordStream *rs)
 {
+    free(rs->linear);
     free(rs->buffer);
     free(rs);
 }
 
 
-/* returns NULL; if there isn't a full record in the buffer */
-static unsigned char * getEndOfRecord (unsigned char *p_begin,
-                                            unsigned char *p_end)
+/* copies len bytes starting at stream offset pos out of the ring */
+static void copyOut (RecordStream *p_rs, size_t pos, void *dest, size_t len)
+{
+    size_t offset = pos & p_rs->mask;
+    size_t first = p_rs->size - offset;
+
+    if (first >= len) {
+        memcpy(dest, p_rs->buffer + offset, len);
+    } else {
+        memcpy(dest, p_rs->buffer + offset, first);
+        memcpy((unsigned char *)dest + first, p_rs->buffer, len - first);
+    }
+}
+
+/*
+ * Returns 1 and fills p_outIov/p_outIovCnt if there is a full record in the
+ * buffer, 0 if there isn't, -1 / errno = EFBIG if the next record is longer
+ * than maxRecordLen.
+ */
+static int getNextRecord (RecordStream *p_rs, struct iovec *p_outIov,
+                            int *p_outIovCnt, size_t *p_outRecordLen)
 {
+    uint32_t header;
     size_t len;
-    unsigned char * p_ret;
+    size_t offset;
+    size_t first;
 
-    if (p_end < p_begin + HEADER_SIZE) {
-        return NULL;
+    if (p_rs->head - p_rs->tail < HEADER_SIZE) {
+        return 0;
     }
 
     //First four bytes are length
-    len = ntohl(*((uint32_t *)p_begin));
+    copyOut(p_rs, p_rs->tail, &header, HEADER_SIZE);
+    len = ntohl(header);
 
-    p_ret = p_begin + HEADER_SIZE + len;
+    if (len > p_rs->maxRecordLen) {
+        errno = EFBIG;
+        return -1;
+    }
 
-    if (p_end < p_ret) {
-        return NULL;
+    if (p_rs->head - p_rs->tail < HEADER_SIZE + len) {
+        return 0;
     }
 
-    return p_ret;
+    /* one full record in the buffer */
+    offset = (p_rs->tail + HEADER_SIZE) & p_rs->mask;
+    first = p_rs->size - offset;
+
+    p_outIov[0].iov_base = p_rs->buffer + offset;
+    if (first >= len) {
+        p_outIov[0].iov_len = len;
+        *p_outIovCnt = 1;
+    } else {
+        p_outIov[0].iov_len = first;
+        p_outIov[1].iov_base = p_rs->buffer;
+        p_outIov[1].iov_len = len - first;
+        *p_outIovCnt = 2;
+    }
+
+    p_rs->tail += HEADER_SIZE + len;
+    *p_outRecordLen = len;
+
+    return 1;
 }
 
-static void *getNextRecord (RecordStream *p_rs, size_t *p_outRecordLen)
+/* Reads as much as fits in the free part of the ring with one call */
+static ssize_t fillBuffer (RecordStream *p_rs)
 {
-    unsigned char *record_start, *record_end;
+    size_t used = p_rs->head - p_rs->tail;
+    size_t space = p_rs->size - used;
+    size_t offset;
+    size_t first;
+    ssize_t countRead;
 
-    record_end = getEndOfRecord (p_rs->unconsumed, p_rs->read_end);
+    if (used == 0) {
+        /* empty; start over at the front to keep records contiguous */
+        p_rs->head = p_rs->tail = 0;
+    }
 
-    if (record_end != NULL) {
-        /* one full line in the buffer */
-        record_start = p_rs->unconsumed + HEADER_SIZE;
-        p_rs->unconsumed = record_end;
+    offset = p_rs->head & p_rs->mask;
+    first = p_rs->size - offset;
+    if (first > space) {
+        first = space;
+    }
 
-        *p_outRecordLen = record_end - record_start;
+#ifdef HAVE_WINSOCK
+    countRead = read (p_rs->fd, p_rs->buffer + offset, first);
+#else
+    if (first < space) {
+        struct iovec iov[2];
+
+        iov[0].iov_base = p_rs->buffer + offset;
+        iov[0].iov_len = first;
+        iov[1].iov_base = p_rs->buffer;
+        iov[1].iov_len = space - first;
+        countRead = readv (p_rs->fd, iov, 2);
+    } else {
+        countRead = read (p_rs->fd, p_rs->buffer + offset, first);
+    }
+#endif
 
-        return record_start;
+    if (countRead > 0) {
+        p_rs->head += countRead;
     }
 
-    return NULL;
+    return countRead;
 }
 
 /**
- * Reads the next record from stream fd
- * Records are prefixed by a 16-bit big endian length value
+ * Reads the next record from stream fd, without copying.
+ * Records are prefixed by a 32-bit big endian length value
  * Records may not be larger than maxRecordLen
  *
+ * A record that wraps around the end of the internal ring buffer is
+ * returned as two iovecs; otherwise *p_outIovCnt is 1. The record stays
+ * valid until the next call on p_rs.
+ *
+ * Every complete record already buffered is handed out before fd is read
+ * again, and each read fills all of the free space at once.
+ *
  * Doesn't guard against EINTR
  *
- * p_outRecord and p_outRecordLen may not be NULL
+ * p_outIov must have room for two entries; none of the out params may be
+ * NULL
  *
  * Return 0 on success, -1 on fail
- * Returns 0 with *p_outRecord set to NULL on end of stream
+ * Returns 0 with *p_outIovCnt set to 0 on end of stream
  * Returns -1 / errno = EAGAIN if it needs to read again
  */
-int record_stream_get_next (RecordStream *p_rs, void ** p_outRecord,
-                                    size_t *p_outRecordLen)
+int record_stream_get_next_iov (RecordStream *p_rs, struct iovec *p_outIov,
+                                    int *p_outIovCnt, size_t *p_outRecordLen)
 {
-    void *ret;
-
     ssize_t countRead;
+    int ret;
 
     /* is there one record already in the buffer? */
-    ret = getNextRecord (p_rs, p_outRecordLen);
+    ret = getNextRecord (p_rs, p_outIov, p_outIovCnt, p_outRecordLen);
 
-    if (ret != NULL) {
-        *p_outRecord = ret;
-        return 0;
+    if (ret != 0) {
+        return ret > 0 ? 0 : -1;
     }
 
     // if the buffer is full and we don't have a full record
-    if (p_rs->unconsumed == p_rs->buffer
-        && p_rs->read_end == p_rs->buffer_end
-    ) {
+    if (p_rs->head - p_rs->tail == p_rs->size) {
         // this should never happen
         //ALOGE("max record length exceeded\n");
-        assert (0);
         errno = EFBIG;
         return -1;
     }
 
-    if (p_rs->unconsumed != p_rs->buffer) {
-        // move remainder to the beginning of the buffer
-        size_t toMove;
-
-        toMove = p_rs->read_end - p_rs->unconsumed;
-        if (toMove) {
-            memmove(p_rs->buffer, p_rs->unconsumed, toMove);
-        }
-
-        p_rs->read_end = p_rs->buffer + toMove;
-        p_rs->unconsumed = p_rs->buffer;
-    }
-
-    countRead = read (p_rs->fd, p_rs->read_end, p_rs->buffer_end - p_rs->read_end);
+    countRead = fillBuffer (p_rs);
 
     if (countRead <= 0) {
         /* note: end-of-stream drops through here too */
-        *p_outRecord = NULL;
+        *p_outIovCnt = 0;
         return countRead;
     }
 
-    p_rs->read_end += countRead;
+    ret = getNextRecord (p_rs, p_outIov, p_outIovCnt, p_outRecordLen);
 
-    ret = getNextRecord (p_rs, p_outRecordLen);
-
-    if (ret == NULL) {
+    if (ret == 0) {
         /* not enough of a buffer to for a whole command */
         errno = EAGAIN;
         return -1;
     }
 
-    *p_outRecord = ret;
+    return ret > 0 ? 0 : -1;
+}
+
+/**
+ * Reads the next record from stream fd
+ * Records are prefixed by a 32-bit big endian length value
+ * Records may not be larger than maxRecordLen
+ *
+ * Same as record_stream_get_next_iov(), except that the record is always
+ * returned contiguously. Only a record that wraps around the end of the
+ * ring buffer is copied.
+ *
+ * Doesn't guard against EINTR
+ *
+ * p_outRecord and p_outRecordLen may not be NULL
+ *
+ * Return 0 on success, -1 on fail
+ * Returns 0 with *p_outRecord set to NULL on end of stream
+ * Returns -1 / errno = EAGAIN if it needs to read again
+ */
+int record_stream_get_next (RecordStream *p_rs, void ** p_outRecord,
+                                    size_t *p_outRecordLen)
+{
+    struct iovec iov[2];
+    int iovcnt;
+    int ret;
+
+    ret = record_stream_get_next_iov (p_rs, iov, &iovcnt, p_outRecordLen);
+
+    if (ret < 0) {
+        return ret;
+    }
+
+    if (iovcnt == 0) {
+        *p_outRecord = NULL;
+    } else if (iovcnt == 1) {
+        *p_outRecord = iov[0].iov_base;
+    } else {
+        if (p_rs->linear == NULL) {
+            p_rs->linear = (unsigned char *)malloc (p_rs->maxRecordLen);
+            if (p_rs->linear == NULL) {
+                errno = ENOMEM;
+                return -1;
+            }
+        }
+        memcpy(p_rs->linear, iov[0].iov_base, iov[0].iov_len);
+        memcpy(p_rs->linear + iov[0].iov_len, iov[1].iov_base, iov[1].iov_len);
+        *p_outRecord = p_rs->linear;
+    }
+
     return 0;
 }
@@ -0,0 +1,14 @@
+# Copyright 2016 The Android Open Source Project
+
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    record_stream_test.c \
+    ../record_stream.c \
+
+LOCAL_LDLIBS += -lpthread
+
+LOCAL_MODULE:= record_stream_test
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Throughput test for record_stream.
+ *
+ * A writer thread pushes length-prefixed records through a socketpair in
+ * bursts, the way the framework sends RIL requests, while the main thread
+ * drains them with record_stream_get_next() or record_stream_get_next_iov().
+ * Every record carries its sequence number and a byte pattern derived from
+ * it, so reordering, truncation or corruption fails the test.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <telephony/record_stream.h>
+
+#define MAX_RECORD_LEN (8 * 1024)
+#define HEADER_SIZE 4
+#define BURST_MAX 32
+
+typedef size_t (*SizeDistribution)(unsigned int *seed);
+
+struct Scenario {
+    const char *name;
+    SizeDistribution nextSize;
+};
+
+struct WriterArgs {
+    int fd;
+    int numRecords;
+    SizeDistribution nextSize;
+};
+
+/* Parcels are always a multiple of 4 bytes */
+static size_t align4(size_t len) {
+    return (len + 3) & ~3;
+}
+
+/* small requests, e.g. RIL_REQUEST_GET_SIGNAL_STRENGTH */
+static size_t smallRecords(unsigned int *seed) {
+    return align4(8 + rand_r(seed) % 56);
+}
+
+/* mostly small with the occasional SMS PDU or SIM IO */
+static size_t mixedRecords(unsigned int *seed) {
+    if (rand_r(seed) % 10 == 0) {
+        return align4(256 + rand_r(seed) % 1024);
+    }
+    return align4(8 + rand_r(seed) % 120);
+}
+
+/* large records up to the libril limit */
+static size_t largeRecords(unsigned int *seed) {
+    return align4(1024 + rand_r(seed) % (MAX_RECORD_LEN - 1024 - 3));
+}
+
+static const struct Scenario s_scenarios[] = {
+    { "small", smallRecords },
+    { "mixed", mixedRecords },
+    { "large", largeRecords },
+};
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static unsigned char patternByte(uint32_t seq, size_t i) {
+    return (unsigned char)(seq * 31 + i);
+}
+
+static int writeFully(int fd, const unsigned char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t ret = write(fd, buf, len);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += ret;
+        len -= ret;
+    }
+    return 0;
+}
+
+static void *writerThread(void *param) {
+    struct WriterArgs *args = (struct WriterArgs *) param;
+    unsigned int seed = 1;
+    unsigned char *burst = malloc(BURST_MAX * (MAX_RECORD_LEN + HEADER_SIZE));
+    int seq = 0;
+
+    while (seq < args->numRecords) {
+        size_t used = 0;
+        int count = 1 + rand_r(&seed) % BURST_MAX;
+
+        for (; count > 0 && seq < args->numRecords; count--, seq++) {
+            size_t len = args->nextSize(&seed);
+            uint32_t header = htonl(len);
+            uint32_t seqBytes = seq;
+            size_t i;
+
+            memcpy(burst + used, &header, HEADER_SIZE);
+            used += HEADER_SIZE;
+            memcpy(burst + used, &seqBytes, sizeof(seqBytes));
+            for (i = sizeof(seqBytes); i < len; i++) {
+                burst[used + i] = patternByte(seq, i);
+            }
+            used += len;
+        }
+        if (writeFully(args->fd, burst, used) < 0) {
+            perror("write");
+            exit(1);
+        }
+    }
+
+    free(burst);
+    close(args->fd);
+    return NULL;
+}
+
+static int checkRecord(const struct iovec *iov, int iovcnt, size_t len,
+                        uint32_t expectedSeq) {
+    uint32_t seq;
+    unsigned char first[sizeof(seq)];
+    size_t pos = 0;
+    int v;
+
+    for (v = 0; v < iovcnt; v++) {
+        const unsigned char *p = iov[v].iov_base;
+        size_t i;
+        for (i = 0; i < iov[v].iov_len; i++, pos++) {
+            if (pos < sizeof(seq)) {
+                first[pos] = p[i];
+            } else if (p[i] != patternByte(expectedSeq, pos)) {
+                fprintf(stderr, "record %u corrupt at byte %zu\n", expectedSeq, pos);
+                return -1;
+            }
+        }
+    }
+    if (pos != len || len < sizeof(seq)) {
+        fprintf(stderr, "record %u length mismatch\n", expectedSeq);
+        return -1;
+    }
+    memcpy(&seq, first, sizeof(seq));
+    if (seq != expectedSeq) {
+        fprintf(stderr, "expected record %u, got %u\n", expectedSeq, seq);
+        return -1;
+    }
+    return 0;
+}
+
+static int runScenario(const struct Scenario *scenario, int numRecords, int useIov) {
+    int sv[2];
+    pthread_t writer;
+    struct WriterArgs args;
+    RecordStream *rs;
+    uint32_t seq = 0;
+    uint64_t bytes = 0;
+    int wrapped = 0;
+    int64_t start;
+    double secs;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+        perror("socketpair");
+        return -1;
+    }
+
+    rs = record_stream_new(sv[0], MAX_RECORD_LEN);
+    args.fd = sv[1];
+    args.numRecords = numRecords;
+    args.nextSize = scenario->nextSize;
+
+    start = nowNs();
+    pthread_create(&writer, NULL, writerThread, &args);
+
+    for (;;) {
+        struct iovec iov[2];
+        int iovcnt;
+        size_t len;
+        int ret;
+
+        if (useIov) {
+            ret = record_stream_get_next_iov(rs, iov, &iovcnt, &len);
+        } else {
+            void *record;
+            ret = record_stream_get_next(rs, &record, &len);
+            iov[0].iov_base = record;
+            iov[0].iov_len = len;
+            iovcnt = record != NULL ? 1 : 0;
+        }
+
+        if (ret < 0) {
+            if (errno == EAGAIN || errno == EINTR) continue;
+            perror("record_stream");
+            return -1;
+        }
+        if (iovcnt == 0) {
+            /* end of stream */
+            break;
+        }
+        if (iovcnt == 2) {
+            wrapped++;
+        }
+        if (checkRecord(iov, iovcnt, len, seq) < 0) {
+            return -1;
+        }
+        bytes += len + HEADER_SIZE;
+        seq++;
+    }
+
+    secs = (nowNs() - start) / 1e9;
+    pthread_join(writer, NULL);
+    record_stream_free(rs);
+    close(sv[0]);
+
+    if ((int)seq != numRecords) {
+        fprintf(stderr, "%s: received %u of %d records\n", scenario->name, seq,
+                numRecords);
+        return -1;
+    }
+
+    printf("%-6s %-6s %8d records %8.1f MB/s %10.0f records/s %6d wrapped\n",
+            scenario->name, useIov ? "iov" : "linear", numRecords,
+            bytes / secs / (1024 * 1024), numRecords / secs, wrapped);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int numRecords = argc > 1 ? atoi(argv[1]) : 200000;
+    size_t i;
+    int useIov;
+
+    if (numRecords < 1) {
+        fprintf(stderr, "usage: %s [records per scenario]\n", argv[0]);
+        return 1;
+    }
+
+    for (i = 0; i < sizeof(s_scenarios) / sizeof(s_scenarios[0]); i++) {
+        for (useIov = 0; useIov <= 1; useIov++) {
+            if (runScenario(&s_scenarios[i], numRecords, useIov) < 0) {
+                printf("FAILED\n");
+                return 1;
+            }
+        }
+    }
+    printf("PASSED\n");
+    return 0;
+}
@@ -45,3 +45,5 @@ else
   LOCAL_MODULE:= reference-ril
   include $(BUILD_EXECUTABLE)
 endif
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
@@ -188,3 +188,210 @@ int at_tok_hasmore(char **p_cur)
 }
 
 
+
+/**
+ * Starts tokenizing an AT response line without modifying it
+ * returns -1 if this is not a valid response string, 0 on success.
+ */
+int at_tok_begin(ATTokenizer *p_tok, const char *line)
+{
+    if (line == NULL) {
+        p_tok->p_cur = NULL;
+        return -1;
+    }
+
+    // skip prefix
+    // consume "^[^:]:"
+
+    p_tok->p_cur = strchr(line, ':');
+
+    if (p_tok->p_cur == NULL) {
+        return -1;
+    }
+
+    p_tok->p_cur++;
+
+    return 0;
+}
+
+/**
+ * Returns the next token as a span of the line and steps past the comma
+ * that ends it. Quotes around the token are stripped; a quoted token may
+ * contain commas.
+ * returns 0 on success and -1 if there are no more tokens
+ */
+int at_tok_getspan(ATTokenizer *p_tok, const char **p_out, size_t *p_len)
+{
+    const char *cur = p_tok->p_cur;
+    const char *end;
+
+    if (cur == NULL) {
+        return -1;
+    }
+
+    while (*cur != '\0' && isspace(*cur)) {
+        cur++;
+    }
+
+    if (*cur == '"') {
+        cur++;
+        end = strchr(cur, '"');
+        if (end == NULL) {
+            /* unterminated: take the rest of the line */
+            end = cur + strlen(cur);
+            p_tok->p_cur = NULL;
+        } else {
+            p_tok->p_cur = strchr(end, ',');
+            if (p_tok->p_cur != NULL) {
+                p_tok->p_cur++;
+            }
+        }
+    } else {
+        end = strchr(cur, ',');
+        if (end == NULL) {
+            end = cur + strlen(cur);
+            p_tok->p_cur = NULL;
+        } else {
+            p_tok->p_cur = end + 1;
+        }
+    }
+
+    *p_out = cur;
+    *p_len = end - cur;
+
+    return 0;
+}
+
+static int at_tok_getint_base(ATTokenizer *p_tok, int *p_out, int base, int uns)
+{
+    const char *tok;
+    const char *end;
+    size_t len;
+    unsigned long value = 0;
+    int negative = 0;
+    int digits = 0;
+
+    if (at_tok_getspan(p_tok, &tok, &len) < 0) {
+        return -1;
+    }
+
+    // the span is not terminated, so parse it here rather than with
+    // strtol(), which would run on into the next token
+    end = tok + len;
+
+    if (!uns && tok < end && (*tok == '-' || *tok == '+')) {
+        negative = (*tok == '-');
+        tok++;
+    }
+    if (base == 16 && end - tok > 2 && tok[0] == '0'
+            && (tok[1] == 'x' || tok[1] == 'X')) {
+        tok += 2;
+    }
+
+    for (; tok < end; tok++, digits++) {
+        int digit;
+
+        if (*tok >= '0' && *tok <= '9') {
+            digit = *tok - '0';
+        } else if (base == 16 && *tok >= 'a' && *tok <= 'f') {
+            digit = *tok - 'a' + 10;
+        } else if (base == 16 && *tok >= 'A' && *tok <= 'F') {
+            digit = *tok - 'A' + 10;
+        } else {
+            break;
+        }
+        value = value * base + digit;
+    }
+
+    if (digits == 0) {
+        return -1;
+    }
+
+    *p_out = negative ? -(int)value : (int)value;
+
+    return 0;
+}
+
+/**
+ * Parses the next base 10 integer in the AT response line
+ * and places it in *p_out
+ * returns 0 on success and -1 on fail
+ */
+int at_tok_getint(ATTokenizer *p_tok, int *p_out)
+{
+    return at_tok_getint_base(p_tok, p_out, 10, 0);
+}
+
+/**
+ * Parses the next base 16 integer in the AT response line
+ * and places it in *p_out
+ * returns 0 on success and -1 on fail
+ */
+int at_tok_gethexint(ATTokenizer *p_tok, int *p_out)
+{
+    return at_tok_getint_base(p_tok, p_out, 16, 1);
+}
+
+int at_tok_getbool(ATTokenizer *p_tok, char *p_out)
+{
+    int result;
+
+    if (at_tok_getint(p_tok, &result) < 0) {
+        return -1;
+    }
+
+    // booleans should be 0 or 1
+    if (!(result == 0 || result == 1)) {
+        return -1;
+    }
+
+    if (p_out != NULL) {
+        *p_out = (char)result;
+    }
+
+    return 0;
+}
+
+/**
+ * Copies the next string token into out, truncating it to outLen - 1
+ * characters.
+ * returns 0 on success and -1 on fail
+ */
+int at_tok_getstr(ATTokenizer *p_tok, char *out, size_t outLen)
+{
+    const char *tok;
+    size_t len;
+
+    if (outLen == 0 || at_tok_getspan(p_tok, &tok, &len) < 0) {
+        return -1;
+    }
+
+    if (len >= outLen) {
+        len = outLen - 1;
+    }
+    memcpy(out, tok, len);
+    out[len] = '\0';
+
+    return 0;
+}
+
+/** returns 1 on "has more tokens" and 0 if no */
+int at_tok_more(const ATTokenizer *p_tok)
+{
+    return ! (p_tok->p_cur == NULL || *p_tok->p_cur == '\0');
+}
+
+/** returns the number of tokens left, without consuming them */
+int at_tok_count(const ATTokenizer *p_tok)
+{
+    ATTokenizer tok = *p_tok;
+    const char *span;
+    size_t len;
+    int count = 0;
+
+    while (at_tok_more(&tok) && at_tok_getspan(&tok, &span, &len) == 0) {
+        count++;
+    }
+
+    return count;
+}
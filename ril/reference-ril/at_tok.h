@@ -18,6 +18,8 @@
 #ifndef AT_TOK_H
 #define AT_TOK_H 1
 
+#include <stddef.h>
+
 int at_tok_start(char **p_cur);
 int at_tok_nextint(char **p_cur, int *p_out);
 int at_tok_nexthexint(char **p_cur, int *p_out);
@@ -27,4 +29,24 @@ int at_tok_nextstr(char **p_cur, char **out);
 
 int at_tok_hasmore(char **p_cur);
 
+/*
+ * Non-destructive tokenizer. Unlike the at_tok_next* functions above it
+ * never writes into the line, so it can parse const lines (eg. in the
+ * unsolicited handler) and lines that are still in use without copying
+ * them first. Strings come back as a pointer into the line and a length;
+ * surrounding quotes are not included.
+ */
+typedef struct {
+    const char *p_cur;
+} ATTokenizer;
+
+int at_tok_begin(ATTokenizer *p_tok, const char *line);
+int at_tok_getint(ATTokenizer *p_tok, int *p_out);
+int at_tok_gethexint(ATTokenizer *p_tok, int *p_out);
+int at_tok_getbool(ATTokenizer *p_tok, char *p_out);
+int at_tok_getspan(ATTokenizer *p_tok, const char **p_out, size_t *p_len);
+int at_tok_getstr(ATTokenizer *p_tok, char *out, size_t outLen);
+int at_tok_more(const ATTokenizer *p_tok);
+int at_tok_count(const ATTokenizer *p_tok);
+
 #endif /*AT_TOK_H */
@@ -42,7 +42,7 @@
 
 #define NUM_ELEMS(x) (sizeof(x)/sizeof(x[0]))
 
-#define MAX_AT_RESPONSE (8 * 1024)
+#define MAX_AT_RESPONSE (8 * 1024)     /* must be a power of two */
 #define HANDSHAKE_RETRY_COUNT 8
 #define HANDSHAKE_TIMEOUT_MSEC 250
 
@@ -50,10 +50,43 @@ static pthread_t s_tid_reader;
 static int s_fd = -1;    /* fd of the AT channel */
 static ATUnsolHandler s_unsolHandler;
 
-/* for input buffering */
+/*
+ * for input buffering
+ *
+ * s_ATBuffer is a ring: s_ATHead and s_ATTail are free-running byte
+ * counts of data consumed and read, and s_ATScan is where the search for
+ * the next end of line resumes, so bytes are never scanned twice and
+ * partial lines are never moved. Only a line that wraps around the end
+ * of the ring is copied, into s_ATLine.
+ */
 
-static char s_ATBuffer[MAX_AT_RESPONSE+1];
-static char *s_ATBufferCur = s_ATBuffer;
+static char s_ATBuffer[MAX_AT_RESPONSE];
+static size_t s_ATHead;
+static size_t s_ATTail;
+static size_t s_ATScan;
+static char s_ATLine[MAX_AT_RESPONSE+1];
+
+#define AT_BUFFER_MASK (MAX_AT_RESPONSE - 1)
+#define AT_BUFFER_AT(i) (s_ATBuffer[(i) & AT_BUFFER_MASK])
+
+/*
+ * Per-command arena. A response, its intermediate lines and its final
+ * response are carved out of a chain of chunks and released together by
+ * at_response_free(). One chunk is kept spare between commands, so a
+ * command with a typical response does not call malloc at all.
+ */
+#define ARENA_CHUNK_SIZE 1024
+#define ARENA_ALIGN 8
+
+typedef struct ATArenaChunk {
+    struct ATArenaChunk *p_next;    /* older chunks */
+    size_t used;
+    size_t size;
+    char data[];
+} ATArenaChunk;
+
+static pthread_mutex_t s_spareChunkMutex = PTHREAD_MUTEX_INITIALIZER;
+static ATArenaChunk *s_spareChunk = NULL;
 
 #if AT_DEBUG
 void  AT_DUMP(const char*  prefix, const char*  buff, int  len)
@@ -97,6 +130,12 @@ static void setTimespecRelative(struct timespec *p_ts, long long msec)
        a relative time again */
     p_ts->tv_sec = tv.tv_sec + (msec / 1000);
     p_ts->tv_nsec = (tv.tv_usec + (msec % 1000) * 1000L ) * 1000L;
+    /* pthread_cond_timedwait fails with EINVAL, rather than waiting,
+       on an unnormalized timespec */
+    if (p_ts->tv_nsec >= 1000000000L) {
+        p_ts->tv_sec++;
+        p_ts->tv_nsec -= 1000000000L;
+    }
 }
 #endif /*USE_NP*/
 
@@ -115,14 +154,102 @@ static void sleepMsec(long long msec)
 
 
 
+static ATArenaChunk *newArenaChunk(size_t size)
+{
+    ATArenaChunk *p_chunk = NULL;
+
+    if (size == ARENA_CHUNK_SIZE) {
+        pthread_mutex_lock(&s_spareChunkMutex);
+        p_chunk = s_spareChunk;
+        s_spareChunk = NULL;
+        pthread_mutex_unlock(&s_spareChunkMutex);
+    }
+
+    if (p_chunk == NULL) {
+        p_chunk = (ATArenaChunk *) malloc(sizeof(ATArenaChunk) + size);
+        if (p_chunk == NULL) {
+            return NULL;
+        }
+    }
+
+    p_chunk->p_next = NULL;
+    p_chunk->used = 0;
+    p_chunk->size = size;
+
+    return p_chunk;
+}
+
+static void freeArenaChunk(ATArenaChunk *p_chunk)
+{
+    if (p_chunk->size == ARENA_CHUNK_SIZE) {
+        pthread_mutex_lock(&s_spareChunkMutex);
+        if (s_spareChunk == NULL) {
+            s_spareChunk = p_chunk;
+            p_chunk = NULL;
+        }
+        pthread_mutex_unlock(&s_spareChunkMutex);
+    }
+
+    free(p_chunk);
+}
+
+/** returns len bytes from the response's arena, or NULL if out of memory */
+static void *arenaAlloc(ATResponse *p_response, size_t len)
+{
+    ATArenaChunk *p_chunk = p_response->p_arena;
+    void *ret;
+
+    len = (len + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    if (p_chunk->size - p_chunk->used < len) {
+        size_t size = p_chunk->size * 2;
+        ATArenaChunk *p_new;
+
+        if (size < len) {
+            size = len;
+        }
+        p_new = newArenaChunk(size);
+        if (p_new == NULL) {
+            return NULL;
+        }
+        p_new->p_next = p_chunk;
+        p_response->p_arena = p_chunk = p_new;
+    }
+
+    ret = p_chunk->data + p_chunk->used;
+    p_chunk->used += len;
+
+    return ret;
+}
+
+static char *arenaStrdup(ATResponse *p_response, const char *s)
+{
+    size_t len = strlen(s) + 1;
+    char *ret = (char *) arenaAlloc(p_response, len);
+
+    if (ret != NULL) {
+        memcpy(ret, s, len);
+    }
+
+    return ret;
+}
+
 /** add an intermediate response to sp_response*/
 static void addIntermediate(const char *line)
 {
     ATLine *p_new;
+    size_t len = strlen(line) + 1;
 
-    p_new = (ATLine  *) malloc(sizeof(ATLine));
+    /* the line is stored right behind its list node */
+    p_new = (ATLine  *) arenaAlloc(sp_response, sizeof(ATLine) + len);
 
-    p_new->line = strdup(line);
+    if (p_new == NULL) {
+        RLOGE("out of memory for intermediate response %s", line);
+        return;
+    }
+
+    p_new->line = (char *) (p_new + 1);
+    memcpy(p_new->line, line, len);
 
     /* note: this adds to the head of the list, so the list
        will be in reverse order of lines received. the order is flipped
@@ -217,7 +344,14 @@ static int isSMSUnsolicited(const char *line)
 /** assumes s_commandmutex is held */
 static void handleFinalResponse(const char *line)
 {
-    sp_response->finalResponse = strdup(line);
+    sp_response->finalResponse = arenaStrdup(sp_response, line);
+
+    if (sp_response->finalResponse == NULL) {
+        /* still wake up the command thread, with a result it can read */
+        RLOGE("out of memory for final response %s", line);
+        sp_response->success = 0;
+        sp_response->finalResponse = (char *) "ERROR";
+    }
 
     pthread_cond_signal(&s_commandcond);
 }
@@ -290,26 +424,6 @@ static void processLine(const char *line)
 }
 
 
-/**
- * Returns a pointer to the end of the next line
- * special-cases the "> " SMS prompt
- *
- * returns NULL if there is no complete line
- */
-static char * findNextEOL(char *cur)
-{
-    if (cur[0] == '>' && cur[1] == ' ' && cur[2] == '\0') {
-        /* SMS prompt character...not \r terminated */
-        return cur+2;
-    }
-
-    // Find next newline
-    while (*cur != '\0' && *cur != '\r' && *cur != '\n') cur++;
-
-    return *cur == '\0' ? NULL : cur;
-}
-
-
 /**
  * Reads a line from the AT channel, returns NULL on timeout.
  * Assumes it has exclusive read access to the FD
@@ -323,68 +437,65 @@ static char * findNextEOL(char *cur)
 static const char *readline()
 {
     ssize_t count;
-
-    char *p_read = NULL;
-    char *p_eol = NULL;
     char *ret;
 
-    /* this is a little odd. I use *s_ATBufferCur == 0 to
-     * mean "buffer consumed completely". If it points to a character, than
-     * the buffer continues until a \0
-     */
-    if (*s_ATBufferCur == '\0') {
-        /* empty buffer */
-        s_ATBufferCur = s_ATBuffer;
-        *s_ATBufferCur = '\0';
-        p_read = s_ATBuffer;
-    } else {   /* *s_ATBufferCur != '\0' */
-        /* there's data in the buffer from the last read */
+    for (;;) {
+        size_t len;
 
         // skip over leading newlines
-        while (*s_ATBufferCur == '\r' || *s_ATBufferCur == '\n')
-            s_ATBufferCur++;
-
-        p_eol = findNextEOL(s_ATBufferCur);
+        while (s_ATHead != s_ATTail
+                && (AT_BUFFER_AT(s_ATHead) == '\r'
+                    || AT_BUFFER_AT(s_ATHead) == '\n')) {
+            s_ATHead++;
+        }
+        if (s_ATScan < s_ATHead) {
+            s_ATScan = s_ATHead;
+        }
 
-        if (p_eol == NULL) {
-            /* a partial line. move it up and prepare to read more */
-            size_t len;
+        // Find next newline
+        while (s_ATScan != s_ATTail
+                && AT_BUFFER_AT(s_ATScan) != '\r'
+                && AT_BUFFER_AT(s_ATScan) != '\n') {
+            s_ATScan++;
+        }
 
-            len = strlen(s_ATBufferCur);
+        if (s_ATScan != s_ATTail) {
+            break;
+        }
 
-            memmove(s_ATBuffer, s_ATBufferCur, len + 1);
-            p_read = s_ATBuffer + len;
-            s_ATBufferCur = s_ATBuffer;
+        if (s_ATTail - s_ATHead == 2
+                && AT_BUFFER_AT(s_ATHead) == '>'
+                && AT_BUFFER_AT(s_ATHead + 1) == ' ') {
+            /* SMS prompt character...not \r terminated */
+            s_ATLine[0] = '>';
+            s_ATLine[1] = ' ';
+            s_ATLine[2] = '\0';
+            s_ATHead = s_ATScan = s_ATTail;
+
+            RLOGD("AT< %s\n", s_ATLine);
+            return s_ATLine;
         }
-        /* Otherwise, (p_eol !- NULL) there is a complete line  */
-        /* that will be returned the while () loop below        */
-    }
 
-    while (p_eol == NULL) {
-        if (0 == MAX_AT_RESPONSE - (p_read - s_ATBuffer)) {
+        if (s_ATTail - s_ATHead == MAX_AT_RESPONSE) {
             RLOGE("ERROR: Input line exceeded buffer\n");
             /* ditch buffer and start over again */
-            s_ATBufferCur = s_ATBuffer;
-            *s_ATBufferCur = '\0';
-            p_read = s_ATBuffer;
+            s_ATHead = s_ATScan = s_ATTail;
+        }
+
+        /* read as much as fits before the ring wraps or fills up */
+        len = MAX_AT_RESPONSE - (s_ATTail - s_ATHead);
+        if (len > MAX_AT_RESPONSE - (s_ATTail & AT_BUFFER_MASK)) {
+            len = MAX_AT_RESPONSE - (s_ATTail & AT_BUFFER_MASK);
         }
 
         do {
-            count = read(s_fd, p_read,
-                            MAX_AT_RESPONSE - (p_read - s_ATBuffer));
+            count = read(s_fd, &AT_BUFFER_AT(s_ATTail), len);
         } while (count < 0 && errno == EINTR);
 
         if (count > 0) {
-            AT_DUMP( "<< ", p_read, count );
-
-            p_read[count] = '\0';
-
-            // skip over leading newlines
-            while (*s_ATBufferCur == '\r' || *s_ATBufferCur == '\n')
-                s_ATBufferCur++;
+            AT_DUMP( "<< ", &AT_BUFFER_AT(s_ATTail), count );
 
-            p_eol = findNextEOL(s_ATBufferCur);
-            p_read += count;
+            s_ATTail += count;
         } else if (count <= 0) {
             /* read error encountered or EOF reached */
             if(count == 0) {
@@ -396,12 +507,24 @@ static const char *readline()
         }
     }
 
-    /* a full line in the buffer. Place a \0 over the \r and return */
+    /* a full line in the ring, ending at s_ATScan */
+
+    if ((s_ATHead & AT_BUFFER_MASK) <= (s_ATScan & AT_BUFFER_MASK)) {
+        /* contiguous: place a \0 over the \r and return it in place */
+        ret = &AT_BUFFER_AT(s_ATHead);
+        AT_BUFFER_AT(s_ATScan) = '\0';
+    } else {
+        /* wrapped around the end of the ring */
+        size_t first = MAX_AT_RESPONSE - (s_ATHead & AT_BUFFER_MASK);
+        size_t second = s_ATScan & AT_BUFFER_MASK;
+
+        memcpy(s_ATLine, &AT_BUFFER_AT(s_ATHead), first);
+        memcpy(s_ATLine + first, s_ATBuffer, second);
+        s_ATLine[first + second] = '\0';
+        ret = s_ATLine;
+    }
 
-    ret = s_ATBufferCur;
-    *p_eol = '\0';
-    s_ATBufferCur = p_eol + 1; /* this will always be <= p_read,    */
-                              /* and there will be a \0 at *p_read */
+    s_ATHead = s_ATScan = s_ATScan + 1;
 
     RLOGD("AT< %s\n", ret);
     return ret;
@@ -615,29 +738,42 @@ void at_close()
 
 static ATResponse * at_response_new()
 {
-    return (ATResponse *) calloc(1, sizeof(ATResponse));
+    ATArenaChunk *p_chunk;
+    ATResponse *p_response;
+
+    p_chunk = newArenaChunk(ARENA_CHUNK_SIZE);
+
+    if (p_chunk == NULL) {
+        return NULL;
+    }
+
+    /* the response is the first thing in its own arena */
+    p_response = (ATResponse *) p_chunk->data;
+    memset(p_response, 0, sizeof(ATResponse));
+    p_chunk->used = (sizeof(ATResponse) + ARENA_ALIGN - 1)
+            & ~(size_t)(ARENA_ALIGN - 1);
+    p_response->p_arena = p_chunk;
+
+    return p_response;
 }
 
 void at_response_free(ATResponse *p_response)
 {
-    ATLine *p_line;
+    ATArenaChunk *p_chunk;
 
     if (p_response == NULL) return;
 
-    p_line = p_response->p_intermediates;
+    /* the chunk holding p_response itself is the last one freed */
+    p_chunk = p_response->p_arena;
 
-    while (p_line != NULL) {
-        ATLine *p_toFree;
+    while (p_chunk != NULL) {
+        ATArenaChunk *p_toFree;
 
-        p_toFree = p_line;
-        p_line = p_line->p_next;
+        p_toFree = p_chunk;
+        p_chunk = p_chunk->p_next;
 
-        free(p_toFree->line);
-        free(p_toFree);
+        freeArenaChunk(p_toFree);
     }
-
-    free (p_response->finalResponse);
-    free (p_response);
 }
 
 /**
@@ -691,6 +827,11 @@ static int at_send_command_full_nolock (const char *command, ATCommandType type,
     s_smsPDU = smspdu;
     sp_response = at_response_new();
 
+    if (sp_response == NULL) {
+        err = AT_ERROR_GENERIC;
+        goto error;
+    }
+
 #ifndef USE_NP
     if (timeoutMsec != 0) {
         setTimespecRelative(&ts, timeoutMsec);
@@ -57,12 +57,17 @@ typedef struct ATLine  {
     char *line;
 } ATLine;
 
+struct ATArenaChunk;
+
 /** Free this with at_response_free() */
 typedef struct {
     int success;              /* true if final response indicates
                                     success (eg "OK") */
     char *finalResponse;      /* eg OK, ERROR */
     ATLine  *p_intermediates; /* any intermediate responses */
+    /* private: the response and all of its lines are carved out of
+       this arena, and freed with it in one go */
+    struct ATArenaChunk *p_arena;
 } ATResponse;
 
 /**
@@ -35,7 +35,7 @@
 #include <sys/socket.h>
 #include <cutils/sockets.h>
 #include <termios.h>
-#include <sys/system_properties.h>
+#include <cutils/properties.h>
 
 #include "ril.h"
 #include "hardware/qemu_pipe.h"
@@ -48,6 +48,11 @@ static void *noopRemoveWarning( void *a ) { return a; }
 
 #define MAX_AT_RESPONSE 0x1000
 
+/* longest strings kept from +CLCC, +COPS and %CTZV lines */
+#define MAX_CLCC_NUMBER 128
+#define MAX_OPERATOR_NAME 128
+#define MAX_NITZ_LENGTH 64
+
 /* pathname returned from RIL_REQUEST_SETUP_DATA_CALL / RIL_REQUEST_SETUP_DEFAULT_PDP */
 #define PPP_TTY_PATH "eth0"
 
@@ -267,47 +272,51 @@ static int clccStateToRILState(int state, RIL_CallState *p_state)
 }
 
 /**
- * Note: directly modified line and has *p_call point directly into
- * modified line
+ * Note: line is left untouched; the number is copied into "number",
+ * which *p_call then points to
  */
-static int callFromCLCCLine(char *line, RIL_Call *p_call)
+static int callFromCLCCLine(const char *line, RIL_Call *p_call,
+                            char *number, size_t numberLen)
 {
         //+CLCC: 1,0,2,0,0,\"+18005551212\",145
         //     index,isMT,state,mode,isMpty(,number,TOA)?
 
+    ATTokenizer tok;
     int err;
     int state;
     int mode;
 
-    err = at_tok_start(&line);
+    err = at_tok_begin(&tok, line);
     if (err < 0) goto error;
 
-    err = at_tok_nextint(&line, &(p_call->index));
+    err = at_tok_getint(&tok, &(p_call->index));
     if (err < 0) goto error;
 
-    err = at_tok_nextbool(&line, &(p_call->isMT));
+    err = at_tok_getbool(&tok, &(p_call->isMT));
     if (err < 0) goto error;
 
-    err = at_tok_nextint(&line, &state);
+    err = at_tok_getint(&tok, &state);
     if (err < 0) goto error;
 
     err = clccStateToRILState(state, &(p_call->state));
     if (err < 0) goto error;
 
-    err = at_tok_nextint(&line, &mode);
+    err = at_tok_getint(&tok, &mode);
     if (err < 0) goto error;
 
     p_call->isVoice = (mode == 0);
 
-    err = at_tok_nextbool(&line, &(p_call->isMpty));
+    err = at_tok_getbool(&tok, &(p_call->isMpty));
     if (err < 0) goto error;
 
-    if (at_tok_hasmore(&line)) {
-        err = at_tok_nextstr(&line, &(p_call->number));
+    if (at_tok_more(&tok)) {
+        err = at_tok_getstr(&tok, number, numberLen);
 
         /* tolerate null here */
         if (err < 0) return 0;
 
+        p_call->number = number;
+
         // Some lame implementations return strings
         // like "NOT AVAILABLE" in the CLCC line
         if (p_call->number != NULL
@@ -316,7 +325,7 @@ static int callFromCLCCLine(char *line, RIL_Call *p_call)
             p_call->number = NULL;
         }
 
-        err = at_tok_nextint(&line, &p_call->toa);
+        err = at_tok_getint(&tok, &p_call->toa);
         if (err < 0) goto error;
     }
 
@@ -551,9 +560,9 @@ static void requestOrSendDataCallList(RIL_Token *t)
         strcpy(responses[i].addresses, out);
 
         {
-            char  propValue[PROP_VALUE_MAX];
+            char  propValue[PROPERTY_VALUE_MAX];
 
-            if (__system_property_get("ro.kernel.qemu", propValue) != 0) {
+            if (property_get("ro.kernel.qemu", propValue, "") != 0) {
                 /* We are in the emulator - the dns servers are listed
                  * by the following system properties, setup in
                  * /system/etc/init.goldfish.sh:
@@ -570,11 +579,11 @@ static void requestOrSendDataCallList(RIL_Token *t)
                 dnslist[0] = 0;
                 for (nn = 1; nn <= 4; nn++) {
                     /* Probe net.eth0.dns<n> */
-                    char  propName[PROP_NAME_MAX];
+                    char  propName[PROPERTY_KEY_MAX];
                     snprintf(propName, sizeof propName, "net.eth0.dns%d", nn);
 
                     /* Ignore if undefined */
-                    if (__system_property_get(propName, propValue) == 0) {
+                    if (property_get(propName, propValue, "") == 0) {
                         continue;
                     }
 
@@ -674,6 +683,7 @@ static void requestGetCurrentCalls(void *data __unused, size_t datalen __unused,
     int countValidCalls;
     RIL_Call *p_calls;
     RIL_Call **pp_calls;
+    char *numbers;
     int i;
     int needRepoll = 0;
 
@@ -704,6 +714,7 @@ static void requestGetCurrentCalls(void *data __unused, size_t datalen __unused,
     pp_calls = (RIL_Call **)alloca(countCalls * sizeof(RIL_Call *));
     p_calls = (RIL_Call *)alloca(countCalls * sizeof(RIL_Call));
     memset (p_calls, 0, countCalls * sizeof(RIL_Call));
+    numbers = (char *)alloca(countCalls * MAX_CLCC_NUMBER);
 
     /* init the pointer array */
     for(i = 0; i < countCalls ; i++) {
@@ -714,7 +725,8 @@ static void requestGetCurrentCalls(void *data __unused, size_t datalen __unused,
             ; p_cur != NULL
             ; p_cur = p_cur->p_next
     ) {
-        err = callFromCLCCLine(p_cur->line, p_calls + countValidCalls);
+        err = callFromCLCCLine(p_cur->line, p_calls + countValidCalls,
+                numbers + countValidCalls * MAX_CLCC_NUMBER, MAX_CLCC_NUMBER);
 
         if (err != 0) {
             continue;
@@ -1206,17 +1218,17 @@ error:
     RIL_onRequestComplete(t, RIL_E_GENERIC_FAILURE, NULL, 0);
 }
 
-static int parseRegistrationState(char *str, int *type, int *items, int **response)
+static int parseRegistrationState(const char *str, int *type, int *items, int **response)
 {
     int err;
-    char *line = str, *p;
+    ATTokenizer tok;
     int *resp = NULL;
     int skip;
     int count = 3;
     int commas;
 
     RLOGD("parseRegistrationState. Parsing: %s",str);
-    err = at_tok_start(&line);
+    err = at_tok_begin(&tok, str);
     if (err < 0) goto error;
 
     /* Ok you have to be careful here
@@ -1241,25 +1253,23 @@ static int parseRegistrationState(char *str, int *type, int *items, int **respon
      */
 
     /* count number of commas */
-    commas = 0;
-    for (p = line ; *p != '\0' ;p++) {
-        if (*p == ',') commas++;
-    }
+    commas = at_tok_count(&tok) - 1;
+    if (commas < 0) goto error;
 
     resp = (int *)calloc(commas + 1, sizeof(int));
     if (!resp) goto error;
     switch (commas) {
         case 0: /* +CREG: <stat> */
-            err = at_tok_nextint(&line, &resp[0]);
+            err = at_tok_getint(&tok, &resp[0]);
             if (err < 0) goto error;
             resp[1] = -1;
             resp[2] = -1;
         break;
 
         case 1: /* +CREG: <n>, <stat> */
-            err = at_tok_nextint(&line, &skip);
+            err = at_tok_getint(&tok, &skip);
             if (err < 0) goto error;
-            err = at_tok_nextint(&line, &resp[0]);
+            err = at_tok_getint(&tok, &resp[0]);
             if (err < 0) goto error;
             resp[1] = -1;
             resp[2] = -1;
@@ -1267,36 +1277,36 @@ static int parseRegistrationState(char *str, int *type, int *items, int **respon
         break;
 
         case 2: /* +CREG: <stat>, <lac>, <cid> */
-            err = at_tok_nextint(&line, &resp[0]);
+            err = at_tok_getint(&tok, &resp[0]);
             if (err < 0) goto error;
-            err = at_tok_nexthexint(&line, &resp[1]);
+            err = at_tok_gethexint(&tok, &resp[1]);
             if (err < 0) goto error;
-            err = at_tok_nexthexint(&line, &resp[2]);
+            err = at_tok_gethexint(&tok, &resp[2]);
             if (err < 0) goto error;
         break;
         case 3: /* +CREG: <n>, <stat>, <lac>, <cid> */
-            err = at_tok_nextint(&line, &skip);
+            err = at_tok_getint(&tok, &skip);
             if (err < 0) goto error;
-            err = at_tok_nextint(&line, &resp[0]);
+            err = at_tok_getint(&tok, &resp[0]);
             if (err < 0) goto error;
-            err = at_tok_nexthexint(&line, &resp[1]);
+            err = at_tok_gethexint(&tok, &resp[1]);
             if (err < 0) goto error;
-            err = at_tok_nexthexint(&line, &resp[2]);
+            err = at_tok_gethexint(&tok, &resp[2]);
             if (err < 0) goto error;
         break;
         /* special case for CGREG, there is a fourth parameter
          * that is the network type (unknown/gprs/edge/umts)
          */
         case 4: /* +CGREG: <n>, <stat>, <lac>, <cid>, <networkType> */
-            err = at_tok_nextint(&line, &skip);
+            err = at_tok_getint(&tok, &skip);
             if (err < 0) goto error;
-            err = at_tok_nextint(&line, &resp[0]);
+            err = at_tok_getint(&tok, &resp[0]);
             if (err < 0) goto error;
-            err = at_tok_nexthexint(&line, &resp[1]);
+            err = at_tok_gethexint(&tok, &resp[1]);
             if (err < 0) goto error;
-            err = at_tok_nexthexint(&line, &resp[2]);
+            err = at_tok_gethexint(&tok, &resp[2]);
             if (err < 0) goto error;
-            err = at_tok_nexthexint(&line, &resp[3]);
+            err = at_tok_gethexint(&tok, &resp[3]);
             if (err < 0) goto error;
             count = 4;
         break;
@@ -1440,6 +1450,7 @@ static void requestOperator(void *data __unused, size_t datalen __unused, RIL_To
     int skip;
     ATLine *p_cur;
     char *response[3];
+    char names[3][MAX_OPERATOR_NAME];
 
     memset(response, 0, sizeof(response));
 
@@ -1461,32 +1472,36 @@ static void requestOperator(void *data __unused, size_t datalen __unused, RIL_To
             ; p_cur != NULL
             ; p_cur = p_cur->p_next, i++
     ) {
-        char *line = p_cur->line;
+        ATTokenizer tok;
 
-        err = at_tok_start(&line);
+        // more than 3 lines is an error, checked below
+        if (i >= 3) continue;
+
+        err = at_tok_begin(&tok, p_cur->line);
         if (err < 0) goto error;
 
-        err = at_tok_nextint(&line, &skip);
+        err = at_tok_getint(&tok, &skip);
         if (err < 0) goto error;
 
         // If we're unregistered, we may just get
         // a "+COPS: 0" response
-        if (!at_tok_hasmore(&line)) {
+        if (!at_tok_more(&tok)) {
             response[i] = NULL;
             continue;
         }
 
-        err = at_tok_nextint(&line, &skip);
+        err = at_tok_getint(&tok, &skip);
         if (err < 0) goto error;
 
         // a "+COPS: 0, n" response is also possible
-        if (!at_tok_hasmore(&line)) {
+        if (!at_tok_more(&tok)) {
             response[i] = NULL;
             continue;
         }
 
-        err = at_tok_nextstr(&line, &(response[i]));
+        err = at_tok_getstr(&tok, names[i], sizeof(names[i]));
         if (err < 0) goto error;
+        response[i] = names[i];
         // Simple assumption that mcc and mnc are 3 digits each
         if (strlen(response[i]) == 6) {
             if (sscanf(response[i], "%3d%3d", &s_mcc, &s_mnc) != 2) {
@@ -2828,38 +2843,32 @@ error:
 int parse_technology_response( const char *response, int *current, int32_t *preferred )
 {
     int err;
-    char *line, *p;
+    ATTokenizer tok;
     int ct;
     int32_t pt = 0;
-    char *str_pt;
-
-    line = p = strdup(response);
-    RLOGD("Response: %s", line);
-    err = at_tok_start(&p);
-    if (err || !at_tok_hasmore(&p)) {
-        RLOGD("err: %d. p: %s", err, p);
-        free(line);
+
+    RLOGD("Response: %s", response);
+    err = at_tok_begin(&tok, response);
+    if (err || !at_tok_more(&tok)) {
+        RLOGD("err: %d. p: %s", err, tok.p_cur);
         return -1;
     }
 
-    err = at_tok_nextint(&p, &ct);
+    err = at_tok_getint(&tok, &ct);
     if (err) {
-        free(line);
         return -1;
     }
     if (current) *current = ct;
 
-    RLOGD("line remaining after int: %s", p);
+    RLOGD("line remaining after int: %s", tok.p_cur);
 
-    err = at_tok_nexthexint(&p, &pt);
+    err = at_tok_gethexint(&tok, &pt);
     if (err) {
-        free(line);
         return 1;
     }
     if (preferred) {
         *preferred = pt;
     }
-    free(line);
 
     return 0;
 }
@@ -3091,7 +3100,7 @@ static void sendUnsolImsNetworkStateChanged()
  */
 static void onUnsolicited (const char *s, const char *sms_pdu)
 {
-    char *line = NULL, *p;
+    ATTokenizer tok;
     int err;
 
     /* Ignore unsolicited responses until we're initialized.
@@ -3103,14 +3112,12 @@ static void onUnsolicited (const char *s, const char *sms_pdu)
 
     if (strStartsWith(s, "%CTZV:")) {
         /* TI specific -- NITZ time */
-        char *response;
+        char response[MAX_NITZ_LENGTH];
 
-        line = p = strdup(s);
-        at_tok_start(&p);
+        at_tok_begin(&tok, s);
 
-        err = at_tok_nextstr(&p, &response);
+        err = at_tok_getstr(&tok, response, sizeof(response));
 
-        free(line);
         if (err != 0) {
             RLOGE("invalid NITZ line %s\n", s);
         } else {
@@ -3177,18 +3184,11 @@ static void onUnsolicited (const char *s, const char *sms_pdu)
         }
     } else if (strStartsWith(s, "+CCSS: ")) {
         int source = 0;
-        line = p = strdup(s);
-        if (!line) {
-            RLOGE("+CCSS: Unable to allocate memory");
-            return;
-        }
-        if (at_tok_start(&p) < 0) {
-            free(line);
+        if (at_tok_begin(&tok, s) < 0) {
             return;
         }
-        if (at_tok_nextint(&p, &source) < 0) {
-            RLOGE("invalid +CCSS response: %s", line);
-            free(line);
+        if (at_tok_getint(&tok, &source) < 0) {
+            RLOGE("invalid +CCSS response: %s", s);
             return;
         }
         SSOURCE(sMdmInfo) = source;
@@ -3197,21 +3197,13 @@ static void onUnsolicited (const char *s, const char *sms_pdu)
     } else if (strStartsWith(s, "+WSOS: ")) {
         char state = 0;
         int unsol;
-        line = p = strdup(s);
-        if (!line) {
-            RLOGE("+WSOS: Unable to allocate memory");
+        if (at_tok_begin(&tok, s) < 0) {
             return;
         }
-        if (at_tok_start(&p) < 0) {
-            free(line);
+        if (at_tok_getbool(&tok, &state) < 0) {
+            RLOGE("invalid +WSOS response: %s", s);
             return;
         }
-        if (at_tok_nextbool(&p, &state) < 0) {
-            RLOGE("invalid +WSOS response: %s", line);
-            free(line);
-            return;
-        }
-        free(line);
 
         unsol = state ?
                 RIL_UNSOL_ENTER_EMERGENCY_CALLBACK_MODE : RIL_UNSOL_EXIT_EMERGENCY_CALLBACK_MODE;
@@ -3220,22 +3212,14 @@ static void onUnsolicited (const char *s, const char *sms_pdu)
 
     } else if (strStartsWith(s, "+WPRL: ")) {
         int version = -1;
-        line = p = strdup(s);
-        if (!line) {
-            RLOGE("+WPRL: Unable to allocate memory");
-            return;
-        }
-        if (at_tok_start(&p) < 0) {
+        if (at_tok_begin(&tok, s) < 0) {
             RLOGE("invalid +WPRL response: %s", s);
-            free(line);
             return;
         }
-        if (at_tok_nextint(&p, &version) < 0) {
+        if (at_tok_getint(&tok, &version) < 0) {
             RLOGE("invalid +WPRL response: %s", s);
-            free(line);
             return;
         }
-        free(line);
         RIL_onUnsolicitedResponse(RIL_UNSOL_CDMA_PRL_CHANGED, &version, sizeof(version));
     } else if (strStartsWith(s, "+CFUN: 0")) {
         setRadioState(RADIO_STATE_OFF);
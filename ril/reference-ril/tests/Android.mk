@@ -0,0 +1,28 @@
+# Copyright 2016 The Android Open Source Project
+
+LOCAL_PATH:= $(call my-dir)
+
+# AT channel test against a pty fake modem
+# =========================================
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    atchannel_test.c \
+    ../atchannel.c \
+    ../at_tok.c \
+    ../misc.c \
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+
+LOCAL_CFLAGS := -D_GNU_SOURCE
+
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+
+# count the allocations atchannel.c makes
+LOCAL_LDFLAGS := -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=strdup
+
+LOCAL_LDLIBS += -lpthread -lutil
+
+LOCAL_MODULE:= atchannel_test
+
+include $(BUILD_HOST_EXECUTABLE)
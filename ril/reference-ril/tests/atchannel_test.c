@@ -0,0 +1,432 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Test for the AT channel against a fake modem on a pty.
+ *
+ * A modem thread answers +CLCC, +COPS and +CREG queries with canned
+ * multi-line responses of varying length, so lines keep wrapping around
+ * the reader's ring buffer, and mixes in unsolicited lines. Every
+ * response is checked with the non-destructive tokenizer. malloc and
+ * friends are wrapped at link time to count the allocations atchannel.c
+ * makes per command, and the tokenizers are timed against each other.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cutils/atomic.h>
+
+#include "atchannel.h"
+#include "at_tok.h"
+
+static volatile int32_t s_allocs;
+static volatile int32_t s_unsolicited;
+static int s_failures;
+
+#define EXPECT(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #cond); \
+            s_failures++; \
+        } \
+    } while (0)
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+char *__real_strdup(const char *s);
+
+void *__wrap_malloc(size_t size)
+{
+    android_atomic_inc(&s_allocs);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+    android_atomic_inc(&s_allocs);
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    android_atomic_inc(&s_allocs);
+    return __real_realloc(ptr, size);
+}
+
+char *__wrap_strdup(const char *s)
+{
+    android_atomic_inc(&s_allocs);
+    return __real_strdup(s);
+}
+
+static int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int writeFully(int fd, const char *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t ret = write(fd, buf, len);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += ret;
+        len -= ret;
+    }
+    return 0;
+}
+
+/*
+ * Canned responses. The modem pads the +COPS long name and the +CLCC
+ * number by the request count, so line lengths keep changing and lines
+ * straddle the end of the reader's ring.
+ */
+static void modemReply(int fd, const char *command, int count)
+{
+    char buf[2048];
+    size_t len = 0;
+    int pad = count % 37;
+    int i;
+
+    if (count % 5 == 0) {
+        len += snprintf(buf + len, sizeof(buf) - len, "\r\n+CSQ: 20,99\r\n");
+    }
+
+    if (strcmp(command, "AT+CLCC") == 0) {
+        for (i = 1; i <= 4; i++) {
+            len += snprintf(buf + len, sizeof(buf) - len,
+                    "\r\n+CLCC: %d,%d,%d,0,0,\"+1800555%04d%.*s\",145\r\n",
+                    i, i & 1, i == 1 ? 0 : 1, count % 10000, pad,
+                    "0123456789012345678901234567890123456789");
+        }
+    } else if (strncmp(command, "AT+COPS=3,0", 11) == 0) {
+        len += snprintf(buf + len, sizeof(buf) - len,
+                "\r\n+COPS: 0,0,\"Example, Mobile %.*s\"\r\n"
+                "\r\n+COPS: 0,1,\"EXM\"\r\n"
+                "\r\n+COPS: 0,2,\"310170\"\r\n", pad,
+                "XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX");
+    } else if (strcmp(command, "AT+CREG?") == 0) {
+        len += snprintf(buf + len, sizeof(buf) - len,
+                "\r\n+CREG: 2,1,\"%04X\",\"%08X\"\r\n", count & 0xffff,
+                count * 7919);
+    }
+
+    len += snprintf(buf + len, sizeof(buf) - len, "\r\nOK\r\n");
+    writeFully(fd, buf, len);
+}
+
+static void *modemThread(void *param)
+{
+    int fd = *(int *) param;
+    char command[256];
+    size_t used = 0;
+    int count = 0;
+
+    for (;;) {
+        char c;
+        ssize_t ret = read(fd, &c, 1);
+
+        if (ret <= 0) {
+            if (ret < 0 && errno == EINTR) continue;
+            break;
+        }
+        if (c != '\r') {
+            if (used < sizeof(command) - 1) {
+                command[used++] = c;
+            }
+            continue;
+        }
+        command[used] = '\0';
+        used = 0;
+        modemReply(fd, command, count++);
+    }
+    return NULL;
+}
+
+static void onUnsolicited(const char *s, const char *sms_pdu)
+{
+    android_atomic_inc(&s_unsolicited);
+}
+
+static int openModem(pthread_t *modem, int *p_masterFd)
+{
+    struct termios ios;
+    int master, slave;
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+        perror("posix_openpt");
+        return -1;
+    }
+    slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    if (slave < 0) {
+        perror("open pts");
+        return -1;
+    }
+
+    // like a modem tty: no echo, no line discipline
+    tcgetattr(slave, &ios);
+    cfmakeraw(&ios);
+    tcsetattr(slave, TCSANOW, &ios);
+    tcgetattr(master, &ios);
+    cfmakeraw(&ios);
+    tcsetattr(master, TCSANOW, &ios);
+
+    *p_masterFd = master;
+    pthread_create(modem, NULL, modemThread, p_masterFd);
+
+    if (at_open(slave, onUnsolicited) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static void checkClcc(const ATResponse *p_response, int count)
+{
+    ATLine *p_cur;
+    int lines = 0;
+
+    for (p_cur = p_response->p_intermediates; p_cur != NULL;
+            p_cur = p_cur->p_next) {
+        ATTokenizer tok;
+        int index, state, mode, toa;
+        char isMT, isMpty;
+        char number[64];
+        char expected[16];
+
+        lines++;
+        EXPECT(at_tok_begin(&tok, p_cur->line) == 0);
+        EXPECT(at_tok_count(&tok) == 7);
+        EXPECT(at_tok_getint(&tok, &index) == 0 && index == lines);
+        EXPECT(at_tok_getbool(&tok, &isMT) == 0 && isMT == (lines & 1));
+        EXPECT(at_tok_getint(&tok, &state) == 0);
+        EXPECT(at_tok_getint(&tok, &mode) == 0 && mode == 0);
+        EXPECT(at_tok_getbool(&tok, &isMpty) == 0 && isMpty == 0);
+        EXPECT(at_tok_getstr(&tok, number, sizeof(number)) == 0);
+        snprintf(expected, sizeof(expected), "+1800555%04d", count % 10000);
+        EXPECT(strncmp(number, expected, strlen(expected)) == 0);
+        EXPECT(at_tok_getint(&tok, &toa) == 0 && toa == 145);
+        EXPECT(!at_tok_more(&tok));
+    }
+    EXPECT(lines == 4);
+}
+
+static void checkCops(const ATResponse *p_response)
+{
+    static const char *names[] = { "Example, Mobile", "EXM", "310170" };
+    ATLine *p_cur;
+    int i = 0;
+
+    for (p_cur = p_response->p_intermediates; p_cur != NULL;
+            p_cur = p_cur->p_next, i++) {
+        ATTokenizer tok;
+        const char *name;
+        size_t len;
+        int mode, format;
+
+        EXPECT(i < 3);
+        if (i >= 3) break;
+        EXPECT(at_tok_begin(&tok, p_cur->line) == 0);
+        EXPECT(at_tok_getint(&tok, &mode) == 0 && mode == 0);
+        EXPECT(at_tok_getint(&tok, &format) == 0 && format == i);
+        // the quoted name may contain commas
+        EXPECT(at_tok_getspan(&tok, &name, &len) == 0);
+        EXPECT(len >= strlen(names[i]) && strncmp(name, names[i], strlen(names[i])) == 0);
+    }
+    EXPECT(i == 3);
+}
+
+static void checkCreg(const ATResponse *p_response, int count)
+{
+    ATTokenizer tok;
+    int n, stat, lac, cid;
+
+    EXPECT(at_tok_begin(&tok, p_response->p_intermediates->line) == 0);
+    EXPECT(at_tok_getint(&tok, &n) == 0 && n == 2);
+    EXPECT(at_tok_getint(&tok, &stat) == 0 && stat == 1);
+    EXPECT(at_tok_gethexint(&tok, &lac) == 0 && lac == (count & 0xffff));
+    EXPECT(at_tok_gethexint(&tok, &cid) == 0 && cid == count * 7919);
+}
+
+static void runCommands(int iterations)
+{
+    int32_t allocsBefore = android_atomic_acquire_load(&s_allocs);
+    int64_t start = nowNs();
+    int count = 0;
+    int i;
+
+    for (i = 0; i < iterations; i++) {
+        ATResponse *p_response = NULL;
+        int err;
+
+        err = at_send_command_multiline("AT+CLCC", "+CLCC:", &p_response);
+        EXPECT(err == 0 && p_response != NULL && p_response->success);
+        if (err == 0) checkClcc(p_response, count);
+        at_response_free(p_response);
+        count++;
+
+        err = at_send_command_multiline(
+                "AT+COPS=3,0;+COPS?;+COPS=3,1;+COPS?;+COPS=3,2;+COPS?",
+                "+COPS:", &p_response);
+        EXPECT(err == 0 && p_response != NULL && p_response->success);
+        if (err == 0) checkCops(p_response);
+        at_response_free(p_response);
+        count++;
+
+        err = at_send_command_singleline("AT+CREG?", "+CREG:", &p_response);
+        EXPECT(err == 0 && p_response != NULL && p_response->success);
+        if (err == 0) checkCreg(p_response, count);
+        at_response_free(p_response);
+        count++;
+    }
+
+    int64_t elapsed = nowNs() - start;
+    int32_t allocs = android_atomic_acquire_load(&s_allocs) - allocsBefore;
+
+    printf("%d commands: %.1f us/command round trip, %.2f allocations/command, "
+            "%d unsolicited\n", count, elapsed / 1000.0 / count,
+            (double) allocs / count, android_atomic_acquire_load(&s_unsolicited));
+}
+
+/* +CLCC parse as callFromCLCCLine() did with the destructive tokenizer */
+static int parseClccCopy(const char *line)
+{
+    char *copy = __real_strdup(line);
+    char *p = copy;
+    char *number;
+    int value, sum = 0;
+    char b;
+
+    at_tok_start(&p);
+    at_tok_nextint(&p, &value); sum += value;
+    at_tok_nextbool(&p, &b); sum += b;
+    at_tok_nextint(&p, &value); sum += value;
+    at_tok_nextint(&p, &value); sum += value;
+    at_tok_nextbool(&p, &b); sum += b;
+    at_tok_nextstr(&p, &number); sum += number[1];
+    at_tok_nextint(&p, &value); sum += value;
+    free(copy);
+    return sum;
+}
+
+static int parseClccInPlace(const char *line)
+{
+    ATTokenizer tok;
+    const char *number;
+    size_t len;
+    int value, sum = 0;
+    char b;
+
+    at_tok_begin(&tok, line);
+    at_tok_getint(&tok, &value); sum += value;
+    at_tok_getbool(&tok, &b); sum += b;
+    at_tok_getint(&tok, &value); sum += value;
+    at_tok_getint(&tok, &value); sum += value;
+    at_tok_getbool(&tok, &b); sum += b;
+    at_tok_getspan(&tok, &number, &len); sum += number[1];
+    at_tok_getint(&tok, &value); sum += value;
+    return sum;
+}
+
+static void benchmarkTokenizers(int iterations)
+{
+    const char *line = "+CLCC: 1,0,2,0,0,\"+18005551212\",145";
+    volatile int sink = 0;
+    int64_t start;
+    int i;
+
+    EXPECT(parseClccCopy(line) == parseClccInPlace(line));
+
+    start = nowNs();
+    for (i = 0; i < iterations; i++) {
+        sink += parseClccCopy(line);
+    }
+    int64_t copyNs = nowNs() - start;
+
+    start = nowNs();
+    for (i = 0; i < iterations; i++) {
+        sink += parseClccInPlace(line);
+    }
+    int64_t inPlaceNs = nowNs() - start;
+
+    printf("+CLCC line parse: strdup + at_tok_next* %.1f ns, at_tok_get* %.1f ns\n",
+            (double) copyNs / iterations, (double) inPlaceNs / iterations);
+}
+
+static void testTokenizerEdgeCases()
+{
+    ATTokenizer tok;
+    const char *span;
+    size_t len;
+    char str[4];
+    int value;
+
+    EXPECT(at_tok_begin(&tok, "NO PREFIX") < 0);
+    EXPECT(at_tok_begin(&tok, NULL) < 0);
+
+    EXPECT(at_tok_begin(&tok, "+X: ,5,\"a,b\",\"unterminated") == 0);
+    EXPECT(at_tok_count(&tok) == 4);
+    EXPECT(at_tok_getint(&tok, &value) < 0);        // empty token
+    EXPECT(at_tok_getint(&tok, &value) == 0 && value == 5);
+    EXPECT(at_tok_getspan(&tok, &span, &len) == 0 && len == 3
+            && strncmp(span, "a,b", 3) == 0);
+    EXPECT(at_tok_getstr(&tok, str, sizeof(str)) == 0 && strcmp(str, "unt") == 0);
+    EXPECT(!at_tok_more(&tok));
+    EXPECT(at_tok_getspan(&tok, &span, &len) < 0);
+
+    EXPECT(at_tok_begin(&tok, "+X: 1A") == 0);
+    EXPECT(at_tok_gethexint(&tok, &value) == 0 && value == 0x1a);
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+    pthread_t modem;
+    int masterFd;
+
+    if (iterations < 1) {
+        fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    testTokenizerEdgeCases();
+    benchmarkTokenizers(iterations * 100);
+
+    if (openModem(&modem, &masterFd) < 0) {
+        printf("FAILED\n");
+        return 1;
+    }
+    runCommands(iterations);
+
+    if (s_failures != 0) {
+        printf("FAILED (%d)\n", s_failures);
+        return 1;
+    }
+    printf("PASSED\n");
+    return 0;
+}
@@ -35,6 +35,9 @@ enum options {
     DIAL_CALL,
     ANSWER_CALL,
     END_CALL,
+    DUMP_WRITER_STATS,
+    DUMP_TRACE,
+    FLUSH_UNSOL,
 };
 
 
@@ -50,7 +53,10 @@ static void print_usage() {
            7 - DEACTIVE_PDP, \n\
            8 number - DIAL_CALL number, \n\
            9 - ANSWER_CALL, \n\
-           10 - END_CALL \n\
+           10 - END_CALL, \n\
+           11 - DUMP_WRITER_STATS, \n\
+           12 - DUMP_TRACE (binary, decode with ril_trace_decode), \n\
+           13 - FLUSH_UNSOL (flush coalesced indications, print stats) \n\
           The argument before the last one must be SIM slot \n\
            0 - SIM1, \n\
            1 - SIM2, \n\
@@ -66,7 +72,7 @@ static int error_check(int argc, char * argv[]) {
         return -1;
     }
     const int option = atoi(argv[1]);
-    if (option < 0 || option > 10) {
+    if (option < 0 || option > 13) {
         return 0;
     } else if ((option == DIAL_CALL || option == SETUP_PDP) && argc == 5) {
         return 0;
@@ -144,6 +150,15 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (atoi(argv[1]) == DUMP_WRITER_STATS || atoi(argv[1]) == DUMP_TRACE
+            || atoi(argv[1]) == FLUSH_UNSOL) {
+        char buf[4096];
+        shutdown(fd, SHUT_WR);
+        while ((ret = recv(fd, buf, sizeof(buf), 0)) > 0) {
+            fwrite(buf, 1, ret, stdout);
+        }
+    }
+
     close(fd);
     return 0;
 }
@@ -0,0 +1,77 @@
+# Copyright 2016 The Android Open Source Project
+
+LOCAL_PATH:= $(call my-dir)
+
+# The three halves of a running RIL, built for the host: libril, the
+# reference vendor RIL, and a stand-in for rild that drives them against
+# a fake modem and a fake framework client.
+
+# libril, accepting a client running as the same user
+# =========================================
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    ../libril/ril.cpp \
+    ../libril/ril_event.cpp \
+    ../libril/ril_request_table.cpp \
+    ../libril/ril_response_queue.cpp \
+    ../libril/ril_strings.cpp \
+    ../libril/ril_trace.cpp \
+    ../libril/RilSocket.cpp \
+    ../libril/RilSapSocket.cpp \
+    ../librilutils/librilutils.c \
+    ../librilutils/record_stream.c \
+    ../librilutils/proto/sap-api.proto \
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/../libril
+LOCAL_C_INCLUDES += external/nanopb-c
+
+LOCAL_PROTOC_OPTIMIZE_TYPE := nanopb-c-enable_malloc
+
+LOCAL_CFLAGS := -DRIL_HOST_TEST
+
+LOCAL_MODULE:= libril_host_test
+
+include $(BUILD_HOST_STATIC_LIBRARY)
+
+# reference-ril
+# =========================================
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    ../reference-ril/reference-ril.c \
+    ../reference-ril/atchannel.c \
+    ../reference-ril/misc.c \
+    ../reference-ril/at_tok.c \
+
+LOCAL_CFLAGS := -D_GNU_SOURCE -DRIL_SHLIB
+
+LOCAL_MODULE:= libreference-ril_host_test
+
+include $(BUILD_HOST_STATIC_LIBRARY)
+
+# End to end latency benchmark
+# =========================================
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    ril_latency_benchmark.cpp \
+    fake_modem.cpp \
+    ril_client.cpp \
+
+LOCAL_CFLAGS := -DRIL_SHLIB
+
+LOCAL_STATIC_LIBRARIES := \
+    libreference-ril_host_test \
+    libril_host_test \
+    libprotobuf-c-nano-enable_malloc \
+    libbinder \
+    libutils \
+    libcutils \
+    liblog \
+
+LOCAL_LDLIBS += -lpthread -lrt -lm
+
+LOCAL_MODULE:= ril_latency_benchmark
+
+include $(BUILD_HOST_EXECUTABLE)
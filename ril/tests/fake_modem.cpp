@@ -0,0 +1,431 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <cutils/atomic.h>
+
+#include "fake_modem.h"
+
+#define CTRL_Z '\032'
+
+enum RuleKind {
+    RULE_AT,
+    RULE_SMS,
+    RULE_UNSOL,
+};
+
+struct fake_modem_rule {
+    RuleKind kind;
+    std::string prefix;         // command prefix, or name for RULE_UNSOL
+    useconds_t delayUs;
+    int unsolId;
+    std::string reply;          // framed lines, ready to write
+    std::deque<int64_t> sent;   // RULE_UNSOL send times not matched yet
+};
+
+struct fake_modem {
+    int fdMaster;
+    int fdSlave;                // kept open so the raw settings stick
+    int fdWakeRead;
+    int fdWakeWrite;
+    char path[64];
+    bool started;
+    pthread_t tid;
+    // replies and bursts are written from different threads and must not
+    // interleave mid-line
+    pthread_mutex_t writeMutex;
+    pthread_mutex_t unsolMutex;
+    std::vector<fake_modem_rule> rules;
+    volatile int32_t commands;
+};
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static bool writeFully(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t ret = write(fd, buf, len);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        buf += ret;
+        len -= ret;
+    }
+    return true;
+}
+
+static bool writeReply(struct fake_modem *modem, const std::string &reply) {
+    pthread_mutex_lock(&modem->writeMutex);
+    bool ret = writeFully(modem->fdMaster, reply.data(), reply.size());
+    pthread_mutex_unlock(&modem->writeMutex);
+    return ret;
+}
+
+// Splits off the next whitespace separated word of *p_cur.
+static std::string nextWord(const char **p_cur) {
+    const char *cur = *p_cur;
+    while (isspace(*cur)) cur++;
+    const char *start = cur;
+    while (*cur != '\0' && !isspace(*cur)) cur++;
+    *p_cur = cur;
+    return std::string(start, cur - start);
+}
+
+// "a|b" -> "\r\na\r\n\r\nb\r\n", the way a modem frames its lines
+static std::string frameLines(const char *lines) {
+    std::string framed;
+    while (isspace(*lines)) lines++;
+    for (;;) {
+        const char *end = strchr(lines, '|');
+        size_t len = end != NULL ? (size_t)(end - lines) : strlen(lines);
+        while (len > 0 && isspace(lines[len - 1])) len--;
+        framed += "\r\n";
+        framed.append(lines, len);
+        framed += "\r\n";
+        if (end == NULL) break;
+        lines = end + 1;
+    }
+    return framed;
+}
+
+static bool parseRule(const char *line, int lineNumber, fake_modem_rule *rule) {
+    const char *cur = line;
+    std::string kind = nextWord(&cur);
+    std::string prefix = nextWord(&cur);
+    std::string arg = nextWord(&cur);
+    char *end;
+
+    if (prefix.empty() || arg.empty() || *cur == '\0') {
+        fprintf(stderr, "script line %d: expected 4 fields\n", lineNumber);
+        return false;
+    }
+
+    rule->prefix = prefix;
+    rule->delayUs = 0;
+    rule->unsolId = -1;
+
+    if (kind == "at" || kind == "sms") {
+        double delayMs = strtod(arg.c_str(), &end);
+        if (*end != '\0' || delayMs < 0) {
+            fprintf(stderr, "script line %d: bad delay '%s'\n", lineNumber,
+                    arg.c_str());
+            return false;
+        }
+        rule->kind = kind == "at" ? RULE_AT : RULE_SMS;
+        rule->delayUs = (useconds_t)(delayMs * 1000);
+    } else if (kind == "unsol") {
+        rule->unsolId = strtol(arg.c_str(), &end, 10);
+        if (*end != '\0') {
+            fprintf(stderr, "script line %d: bad unsol id '%s'\n", lineNumber,
+                    arg.c_str());
+            return false;
+        }
+        rule->kind = RULE_UNSOL;
+    } else {
+        fprintf(stderr, "script line %d: unknown rule '%s'\n", lineNumber,
+                kind.c_str());
+        return false;
+    }
+
+    rule->reply = frameLines(cur);
+    return true;
+}
+
+static bool parseScript(struct fake_modem *modem, const char *script) {
+    int lineNumber = 0;
+
+    while (*script != '\0') {
+        const char *end = strchr(script, '\n');
+        std::string line(script, end != NULL ? end - script : strlen(script));
+        script = end != NULL ? end + 1 : script + line.size();
+        lineNumber++;
+
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+
+        fake_modem_rule rule;
+        if (!parseRule(line.c_str(), lineNumber, &rule)) {
+            return false;
+        }
+        modem->rules.push_back(rule);
+    }
+    return true;
+}
+
+static const fake_modem_rule * findCommandRule(struct fake_modem *modem,
+        const std::string &command) {
+    for (size_t i = 0; i < modem->rules.size(); i++) {
+        const fake_modem_rule &rule = modem->rules[i];
+        if (rule.kind != RULE_UNSOL
+                && command.compare(0, rule.prefix.size(), rule.prefix) == 0) {
+            return &rule;
+        }
+    }
+    return NULL;
+}
+
+// Reads from the master until *p_buf holds delimiter. Returns false once
+// the modem is being stopped or the pty is gone.
+static bool readUntil(struct fake_modem *modem, std::string *p_buf, char delimiter) {
+    while (p_buf->find(delimiter) == std::string::npos) {
+        struct pollfd fds[2];
+        char buf[512];
+
+        fds[0].fd = modem->fdMaster;
+        fds[0].events = POLLIN;
+        fds[1].fd = modem->fdWakeRead;
+        fds[1].events = POLLIN;
+
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (fds[1].revents != 0) {
+            return false;
+        }
+        ssize_t ret = read(modem->fdMaster, buf, sizeof(buf));
+        if (ret < 0 && (errno == EINTR || errno == EAGAIN)) {
+            continue;
+        }
+        if (ret <= 0) {
+            return false;
+        }
+        p_buf->append(buf, ret);
+    }
+    return true;
+}
+
+static void *modemLoop(void *param) {
+    struct fake_modem *modem = (struct fake_modem *) param;
+    std::string input;
+
+    for (;;) {
+        if (!readUntil(modem, &input, '\r')) {
+            break;
+        }
+
+        size_t end = input.find('\r');
+        size_t start = input.find_first_not_of("\r\n");
+        std::string command = start < end ? input.substr(start, end - start) : "";
+        input.erase(0, end + 1);
+
+        if (command.empty()) {
+            continue;
+        }
+
+        const fake_modem_rule *rule = findCommandRule(modem, command);
+
+        if (rule != NULL && rule->kind == RULE_SMS) {
+            // the PDU follows the prompt and is terminated by ctrl-Z
+            if (!writeReply(modem, "\r\n> ") || !readUntil(modem, &input, CTRL_Z)) {
+                break;
+            }
+            input.erase(0, input.find(CTRL_Z) + 1);
+        }
+
+        if (rule != NULL && rule->delayUs > 0) {
+            usleep(rule->delayUs);
+        }
+        if (!writeReply(modem, rule != NULL ? rule->reply : "\r\nOK\r\n")) {
+            break;
+        }
+        android_atomic_inc(&modem->commands);
+    }
+    return NULL;
+}
+
+struct fake_modem * fake_modem_new(const char * script) {
+    struct fake_modem *modem = new fake_modem();
+    struct termios ios;
+    int pipefd[2];
+
+    modem->fdMaster = -1;
+    modem->fdSlave = -1;
+    modem->fdWakeRead = -1;
+    modem->fdWakeWrite = -1;
+    modem->started = false;
+    modem->commands = 0;
+    pthread_mutex_init(&modem->writeMutex, NULL);
+    pthread_mutex_init(&modem->unsolMutex, NULL);
+
+    if (!parseScript(modem, script)) {
+        goto error;
+    }
+
+    modem->fdMaster = posix_openpt(O_RDWR | O_NOCTTY);
+    if (modem->fdMaster < 0 || grantpt(modem->fdMaster) < 0
+            || unlockpt(modem->fdMaster) < 0) {
+        perror("posix_openpt");
+        goto error;
+    }
+    snprintf(modem->path, sizeof(modem->path), "%s", ptsname(modem->fdMaster));
+
+    // a modem tty has no echo or line discipline; the settings belong to
+    // the pty, so they hold for whoever opens the slave later
+    modem->fdSlave = open(modem->path, O_RDWR | O_NOCTTY);
+    if (modem->fdSlave < 0) {
+        perror(modem->path);
+        goto error;
+    }
+    tcgetattr(modem->fdSlave, &ios);
+    cfmakeraw(&ios);
+    tcsetattr(modem->fdSlave, TCSANOW, &ios);
+    tcgetattr(modem->fdMaster, &ios);
+    cfmakeraw(&ios);
+    tcsetattr(modem->fdMaster, TCSANOW, &ios);
+
+    if (pipe(pipefd) < 0) {
+        perror("pipe");
+        goto error;
+    }
+    modem->fdWakeRead = pipefd[0];
+    modem->fdWakeWrite = pipefd[1];
+
+    return modem;
+
+error:
+    fake_modem_free(modem);
+    return NULL;
+}
+
+const char * fake_modem_path(struct fake_modem * modem) {
+    return modem->path;
+}
+
+bool fake_modem_start(struct fake_modem * modem) {
+    int ret = pthread_create(&modem->tid, NULL, modemLoop, modem);
+    if (ret != 0) {
+        fprintf(stderr, "failed to start modem thread: %s\n", strerror(ret));
+        return false;
+    }
+    modem->started = true;
+    return true;
+}
+
+bool fake_modem_burst(struct fake_modem * modem, const char * name, int count) {
+    for (size_t i = 0; i < modem->rules.size(); i++) {
+        fake_modem_rule &rule = modem->rules[i];
+        if (rule.kind != RULE_UNSOL || rule.prefix != name) {
+            continue;
+        }
+
+        std::string burst;
+        for (int j = 0; j < count; j++) {
+            burst += rule.reply;
+        }
+
+        pthread_mutex_lock(&modem->writeMutex);
+        int64_t sent = nowNs();
+        pthread_mutex_lock(&modem->unsolMutex);
+        for (int j = 0; j < count; j++) {
+            rule.sent.push_back(sent);
+        }
+        pthread_mutex_unlock(&modem->unsolMutex);
+        bool ret = writeFully(modem->fdMaster, burst.data(), burst.size());
+        pthread_mutex_unlock(&modem->writeMutex);
+        return ret;
+    }
+    return false;
+}
+
+int64_t fake_modem_take_unsol(struct fake_modem * modem, int unsolId) {
+    int64_t sent = -1;
+
+    pthread_mutex_lock(&modem->unsolMutex);
+    for (size_t i = 0; i < modem->rules.size(); i++) {
+        fake_modem_rule &rule = modem->rules[i];
+        if (rule.kind == RULE_UNSOL && rule.unsolId == unsolId
+                && !rule.sent.empty()
+                && (sent < 0 || rule.sent.front() < sent)) {
+            sent = rule.sent.front();
+        }
+    }
+    for (size_t i = 0; sent >= 0 && i < modem->rules.size(); i++) {
+        fake_modem_rule &rule = modem->rules[i];
+        if (rule.kind == RULE_UNSOL && rule.unsolId == unsolId
+                && !rule.sent.empty() && rule.sent.front() == sent) {
+            rule.sent.pop_front();
+            break;
+        }
+    }
+    pthread_mutex_unlock(&modem->unsolMutex);
+
+    return sent;
+}
+
+size_t fake_modem_pending_unsol(struct fake_modem * modem) {
+    size_t pending = 0;
+
+    pthread_mutex_lock(&modem->unsolMutex);
+    for (size_t i = 0; i < modem->rules.size(); i++) {
+        pending += modem->rules[i].sent.size();
+    }
+    pthread_mutex_unlock(&modem->unsolMutex);
+
+    return pending;
+}
+
+size_t fake_modem_drop_unsol(struct fake_modem * modem) {
+    size_t dropped = 0;
+
+    pthread_mutex_lock(&modem->unsolMutex);
+    for (size_t i = 0; i < modem->rules.size(); i++) {
+        dropped += modem->rules[i].sent.size();
+        modem->rules[i].sent.clear();
+    }
+    pthread_mutex_unlock(&modem->unsolMutex);
+
+    return dropped;
+}
+
+int32_t fake_modem_commands(struct fake_modem * modem) {
+    return android_atomic_acquire_load(&modem->commands);
+}
+
+void fake_modem_free(struct fake_modem * modem) {
+    if (modem->started) {
+        writeFully(modem->fdWakeWrite, "x", 1);
+        pthread_join(modem->tid, NULL);
+    }
+    if (modem->fdWakeRead >= 0) close(modem->fdWakeRead);
+    if (modem->fdWakeWrite >= 0) close(modem->fdWakeWrite);
+    if (modem->fdSlave >= 0) close(modem->fdSlave);
+    if (modem->fdMaster >= 0) close(modem->fdMaster);
+    pthread_mutex_destroy(&modem->writeMutex);
+    pthread_mutex_destroy(&modem->unsolMutex);
+    delete modem;
+}
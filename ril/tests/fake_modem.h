@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Scripted fake modem on a pty, so reference-ril can be driven without a
+// radio. The vendor RIL opens the pty slave like any modem tty.
+//
+// A script has one rule per line; blank lines and lines starting with '#'
+// are ignored:
+//
+//   at <prefix> <delay ms> <line>[|<line>...]
+//       Answer commands starting with <prefix> with the given lines after
+//       <delay ms> (fractions allowed). The last line should be the final
+//       result code.
+//   sms <prefix> <delay ms> <line>[|<line>...]
+//       Like "at", but send the "> " prompt first and reply once the PDU
+//       has been received.
+//   unsol <name> <unsol id> <line>
+//       An unsolicited line fake_modem_burst() can send. <unsol id> is the
+//       RIL_UNSOL_* the RIL is expected to turn it into, which is how
+//       deliveries are matched back to the time the line was sent.
+//
+// Rules are tried in order. Commands that match none are answered with OK
+// straight away.
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct fake_modem;
+
+// Parse script and create the pty. The modem does not answer until
+// fake_modem_start() is called. Returns NULL, after printing why, on failure.
+struct fake_modem * fake_modem_new(const char * script);
+
+// Path of the pty slave, to pass to the vendor RIL.
+const char * fake_modem_path(struct fake_modem * modem);
+
+// Start answering commands on a thread of the calling process.
+bool fake_modem_start(struct fake_modem * modem);
+
+// Send count copies of the named unsolicited line in one write.
+// Returns false if there is no such rule.
+bool fake_modem_burst(struct fake_modem * modem, const char * name, int count);
+
+// CLOCK_MONOTONIC time, in ns, the oldest not yet matched line for unsolId
+// was sent at, or -1 if there is none. The entry is consumed.
+int64_t fake_modem_take_unsol(struct fake_modem * modem, int unsolId);
+
+// Number of unsolicited lines sent but not matched yet.
+size_t fake_modem_pending_unsol(struct fake_modem * modem);
+
+// Forget unsolicited lines that were never matched. Returns how many.
+size_t fake_modem_drop_unsol(struct fake_modem * modem);
+
+// Number of commands answered so far.
+int32_t fake_modem_commands(struct fake_modem * modem);
+
+void fake_modem_free(struct fake_modem * modem);
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cutils/jstring.h>
+#include <telephony/record_stream.h>
+
+#include "ril_client.h"
+
+using namespace android;
+
+// as much as a record_stream can hold; RIL.java itself stops at 8k
+#define MAX_RESPONSE_BYTES 0xffff
+
+#define RESPONSE_SOLICITED 0
+#define RESPONSE_UNSOLICITED 1
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+bool ril_client_connect(struct ril_client * client, const char * path) {
+    struct sockaddr_un addr;
+
+    client->fd = -1;
+    client->rs = NULL;
+    client->nextToken = 1;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    client->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (client->fd < 0
+            || connect(client->fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        int err = errno;
+        ril_client_close(client);
+        errno = err;
+        return false;
+    }
+    fcntl(client->fd, F_SETFL, O_NONBLOCK);
+
+    client->rs = record_stream_new(client->fd, MAX_RESPONSE_BYTES);
+    return true;
+}
+
+void ril_client_close(struct ril_client * client) {
+    if (client->rs != NULL) {
+        record_stream_free(client->rs);
+        client->rs = NULL;
+    }
+    if (client->fd >= 0) {
+        close(client->fd);
+        client->fd = -1;
+    }
+}
+
+int32_t ril_client_begin_request(struct ril_client * client, Parcel &p,
+        int request) {
+    int32_t token = client->nextToken++;
+
+    p.writeInt32(request);
+    p.writeInt32(token);
+    return token;
+}
+
+void ril_client_write_string(Parcel &p, const char * s) {
+    if (s == NULL) {
+        p.writeString16(NULL, 0);
+        return;
+    }
+
+    char16_t *s16;
+    size_t s16_len;
+    s16 = strdup8to16(s, &s16_len);
+    p.writeString16(s16, s16_len);
+    free(s16);
+}
+
+static bool writeFully(int fd, const uint8_t *buf, size_t len) {
+    while (len > 0) {
+        ssize_t ret = write(fd, buf, len);
+        if (ret < 0 && errno == EAGAIN) {
+            struct pollfd pfd = { fd, POLLOUT, 0 };
+            poll(&pfd, 1, -1);
+            continue;
+        }
+        if (ret < 0 && errno != EINTR) {
+            fprintf(stderr, "write to libril: %s\n", strerror(errno));
+            return false;
+        }
+        if (ret > 0) {
+            buf += ret;
+            len -= ret;
+        }
+    }
+    return true;
+}
+
+bool ril_client_send(struct ril_client * client, const Parcel &p) {
+    uint32_t header = htonl(p.dataSize());
+    struct iovec iov[2];
+
+    iov[0].iov_base = &header;
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = (void *) p.data();
+    iov[1].iov_len = p.dataSize();
+
+    ssize_t ret = writev(client->fd, iov, 2);
+    if (ret < 0 && errno != EAGAIN && errno != EINTR) {
+        fprintf(stderr, "write to libril: %s\n", strerror(errno));
+        return false;
+    }
+    if (ret < 0) {
+        ret = 0;
+    }
+
+    // finish a short write the slow way
+    if ((size_t) ret < sizeof(header)) {
+        if (!writeFully(client->fd, (uint8_t *) &header + ret, sizeof(header) - ret)) {
+            return false;
+        }
+        ret = sizeof(header);
+    }
+    size_t done = ret - sizeof(header);
+    return writeFully(client->fd, p.data() + done, p.dataSize() - done);
+}
+
+bool ril_client_receive(struct ril_client * client,
+        struct ril_client_response * response, int timeoutMs) {
+    int64_t deadline = nowNs() + (int64_t) timeoutMs * 1000000;
+
+    for (;;) {
+        void *record;
+        size_t recordLen;
+
+        int ret = record_stream_get_next(client->rs, &record, &recordLen);
+
+        if (ret == 0 && record == NULL) {
+            fprintf(stderr, "libril closed the socket\n");
+            return false;
+        } else if (ret == 0) {
+            Parcel p;
+            int32_t type;
+
+            response->receivedNs = nowNs();
+            p.setData((uint8_t *) record, recordLen);
+            p.readInt32(&type);
+            response->unsolicited = (type == RESPONSE_UNSOLICITED);
+            p.readInt32(&response->id);
+            response->error = 0;
+            if (type == RESPONSE_SOLICITED) {
+                p.readInt32(&response->error);
+            }
+            return true;
+        } else if (errno != EAGAIN && errno != EINTR) {
+            fprintf(stderr, "read from libril: %s\n", strerror(errno));
+            return false;
+        }
+
+        int64_t left = deadline - nowNs();
+        if (left <= 0) {
+            return false;
+        }
+        struct pollfd pfd = { client->fd, POLLIN, 0 };
+        poll(&pfd, 1, (int) ((left + 999999) / 1000000));
+    }
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Fake framework client for the libril command socket. Requests and
+// responses are Parcels framed by a big endian length, as RIL.java sends
+// and reads them.
+
+#include <stdint.h>
+
+#include <binder/Parcel.h>
+
+struct RecordStream;
+
+struct ril_client {
+    int fd;
+    RecordStream *rs;
+    int32_t nextToken;
+};
+
+// Connect to a libril command socket bound at path. Returns false with
+// errno set on failure.
+bool ril_client_connect(struct ril_client * client, const char * path);
+
+void ril_client_close(struct ril_client * client);
+
+// Start a request parcel: request number and a new token, which is returned.
+int32_t ril_client_begin_request(struct ril_client * client, android::Parcel &p,
+        int request);
+
+// Writes a string the way RIL.java does; NULL is written as a null string.
+void ril_client_write_string(android::Parcel &p, const char * s);
+
+bool ril_client_send(struct ril_client * client, const android::Parcel &p);
+
+struct ril_client_response {
+    bool unsolicited;
+    int32_t id;             // token, or the RIL_UNSOL_* number
+    int32_t error;          // solicited only
+    int64_t receivedNs;     // CLOCK_MONOTONIC
+};
+
+// Wait up to timeoutMs for the next response. Returns false on timeout,
+// or if libril closed the socket.
+bool ril_client_receive(struct ril_client * client,
+        struct ril_client_response * response, int timeoutMs);
@@ -0,0 +1,506 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * End to end latency benchmark for libril and reference-ril, on a host.
+ *
+ * A child process plays rild: it starts the libril event loop, initializes
+ * reference-ril on the pty of a scripted fake modem and registers it.
+ * The parent runs the fake modem and a fake framework client that talks to
+ * the child over the usual command socket. For each workload it reports
+ * p50/p99 round trip per request type, the delay from the modem writing an
+ * unsolicited line to the client receiving the RIL_UNSOL_* it turns into,
+ * and the CPU the child used per request.
+ *
+ *   ril_latency_benchmark [-n requests] [-w workload] [-b burst]
+ *                         [-s script] [-v]
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <cutils/sockets.h>
+#include <hardware_legacy/power.h>
+#include <telephony/ril.h>
+
+#include "fake_modem.h"
+#include "ril_client.h"
+
+using namespace android;
+
+#define NUM_ELEMS(a)     (sizeof (a) / sizeof (a)[0])
+
+// libril entry points, as rild.c declares them
+extern "C" {
+void RIL_startEventLoop(void);
+void RIL_register(const RIL_RadioFunctions *callbacks);
+void RIL_onRequestComplete(RIL_Token t, RIL_Errno e, void *response,
+        size_t responselen);
+void RIL_onUnsolicitedResponse(int unsolResponse, const void *data,
+        size_t datalen);
+void RIL_requestTimedCallback(RIL_TimedCallback callback, void *param,
+        const struct timeval *relativeTime);
+const char * requestToString(int request);
+}
+
+static struct RIL_Env s_rilEnv = {
+    RIL_onRequestComplete,
+    RIL_onUnsolicitedResponse,
+    RIL_requestTimedCallback
+};
+
+// Enough for reference-ril to come up with the radio on and the SIM ready,
+// plus the commands the workloads below end up sending.
+static const char s_defaultScript[] =
+    "at AT+CFUN? 0 +CFUN: 1|OK\n"
+    "at AT+CPIN? 0 +CPIN: READY|OK\n"
+    "at AT+CSQ 0.5 +CSQ: 20,99,-1,-1,-1,-1,-1,-1,99,-1,-1,-1|OK\n"
+    "at ATD 2 OK\n"
+    "sms AT+CMGS= 5 +CMGS: 17|OK\n"
+    "at AT+CGACT? 1 +CGACT: 1,1|OK\n"
+    "at AT+CGDCONT? 1 +CGDCONT: 1,\"IP\",\"internet\",\"10.0.2.15/24\",0,0|OK\n"
+    "unsol ring 1001 RING\n";
+
+enum RequestKind {
+    KIND_DIAL,
+    KIND_SEND_SMS,
+    KIND_DATA_CALL_LIST,
+    KIND_CELL_INFO_LIST,
+    KIND_SIGNAL_STRENGTH,
+    NUM_KINDS
+};
+
+static const int s_requests[NUM_KINDS] = {
+    RIL_REQUEST_DIAL,
+    RIL_REQUEST_SEND_SMS,
+    RIL_REQUEST_DATA_CALL_LIST,
+    RIL_REQUEST_GET_CELL_INFO_LIST,
+    RIL_REQUEST_SIGNAL_STRENGTH,
+};
+
+struct Workload {
+    const char *name;
+    int weights[NUM_KINDS];     // relative frequency of each RequestKind
+    int burstEvery;             // requests between unsolicited bursts, 0 = none
+};
+
+static const Workload s_workloads[] = {
+    { "dial",     { 1, 0, 0, 0, 0 }, 0 },
+    { "sms",      { 0, 1, 0, 0, 0 }, 0 },
+    { "datacall", { 0, 0, 1, 0, 0 }, 0 },
+    { "cellinfo", { 0, 0, 0, 1, 1 }, 0 },
+    { "mixed",    { 1, 2, 2, 3, 2 }, 10 },
+};
+
+struct Results {
+    std::vector<int64_t> roundTrip[NUM_KINDS];
+    std::vector<int64_t> unsolDelivery;
+    int errors;
+};
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int64_t processCpuNs(clockid_t clock) {
+    struct timespec ts;
+    if (clock_gettime(clock, &ts) < 0) {
+        return 0;
+    }
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "Usage: %s [-n requests] [-w workload] [-b burst] [-s script] [-v]\n"
+            "  workloads:", argv0);
+    for (size_t i = 0; i < NUM_ELEMS(s_workloads); i++) {
+        fprintf(stderr, " %s", s_workloads[i].name);
+    }
+    fprintf(stderr, " (default: all)\n");
+    exit(EXIT_FAILURE);
+}
+
+static bool readScript(const char *path, std::string *script) {
+    FILE *f = fopen(path, "r");
+    char buf[4096];
+    size_t len;
+
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+    while ((len = fread(buf, 1, sizeof(buf), f)) > 0) {
+        script->append(buf, len);
+    }
+    fclose(f);
+    return true;
+}
+
+/*
+ * Bind the sockets init would create for rild and publish them the way
+ * init does, so android_get_control_socket() finds them in the child.
+ */
+static bool createControlSocket(const char *dir, const char *name,
+        std::string *path) {
+    struct sockaddr_un addr;
+    char fdString[16];
+    std::string envName = std::string(ANDROID_SOCKET_ENV_PREFIX) + name;
+
+    *path = std::string(dir) + "/" + name;
+    if (path->size() >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "socket path too long: %s\n", path->c_str());
+        return false;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path->c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "bind %s: %s\n", path->c_str(), strerror(errno));
+        return false;
+    }
+    snprintf(fdString, sizeof(fdString), "%d", fd);
+    setenv(envName.c_str(), fdString, 1);
+    return true;
+}
+
+// The child: what rild does, minus dlopen() and dropping privileges.
+static void runRild(const char *ttyPath) {
+    char *argv[] = {
+        (char *) "ril_latency_benchmark", (char *) "-d", (char *) ttyPath, NULL
+    };
+
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+    // reference-ril parses its arguments with getopt() too
+    optind = 1;
+
+    RIL_startEventLoop();
+    const RIL_RadioFunctions *funcs = RIL_Init(&s_rilEnv, NUM_ELEMS(argv) - 1, argv);
+    if (funcs == NULL) {
+        fprintf(stderr, "RIL_Init failed\n");
+        _exit(EXIT_FAILURE);
+    }
+    RIL_register(funcs);
+
+    for (;;) {
+        pause();
+    }
+}
+
+static void buildRequest(struct ril_client *client, RequestKind kind, Parcel &p,
+        int32_t *p_token) {
+    *p_token = ril_client_begin_request(client, p, s_requests[kind]);
+
+    switch (kind) {
+        case KIND_DIAL:
+            ril_client_write_string(p, "+15555550100");
+            p.writeInt32(0);    // clir
+            p.writeInt32(0);    // no uus info
+            break;
+        case KIND_SEND_SMS:
+            p.writeInt32(2);
+            ril_client_write_string(p, NULL);
+            ril_client_write_string(p,
+                    "0001000b915155255501f0000004d4f29c0e");
+            break;
+        default:
+            break;
+    }
+}
+
+static void recordUnsolicited(struct fake_modem *modem,
+        const struct ril_client_response &response, Results *results) {
+    int64_t sent = fake_modem_take_unsol(modem, response.id);
+    if (sent >= 0) {
+        results->unsolDelivery.push_back(response.receivedNs - sent);
+    }
+}
+
+// Send one request and wait for its response, collecting unsolicited
+// responses that arrive meanwhile.
+static bool roundTrip(struct ril_client *client, struct fake_modem *modem,
+        RequestKind kind, Results *results, int32_t *p_error) {
+    Parcel p;
+    int32_t token;
+    struct ril_client_response response;
+
+    buildRequest(client, kind, p, &token);
+
+    int64_t start = nowNs();
+    if (!ril_client_send(client, p)) {
+        return false;
+    }
+
+    for (;;) {
+        if (!ril_client_receive(client, &response, 5000)) {
+            fprintf(stderr, "no response to %s\n", requestToString(s_requests[kind]));
+            return false;
+        }
+        if (response.unsolicited) {
+            if (results != NULL) {
+                recordUnsolicited(modem, response, results);
+            }
+        } else if (response.id == token) {
+            break;
+        }
+    }
+
+    if (results != NULL) {
+        results->roundTrip[kind].push_back(response.receivedNs - start);
+    }
+    *p_error = response.error;
+    return true;
+}
+
+// reference-ril answers RADIO_NOT_AVAILABLE until it has set up the modem
+static bool waitForRadio(struct ril_client *client, struct fake_modem *modem) {
+    int64_t deadline = nowNs() + 10 * 1000000000LL;
+
+    while (nowNs() < deadline) {
+        int32_t error;
+        if (!roundTrip(client, modem, KIND_SIGNAL_STRENGTH, NULL, &error)) {
+            return false;
+        }
+        if (error == RIL_E_SUCCESS) {
+            return true;
+        }
+        usleep(100 * 1000);
+    }
+    fprintf(stderr, "radio did not come up\n");
+    return false;
+}
+
+static int64_t percentile(std::vector<int64_t> &v, double q) {
+    size_t index = (size_t) ceil(q * v.size());
+    return v[index > 0 ? index - 1 : 0];
+}
+
+static void printLatencies(const char *name, std::vector<int64_t> &v) {
+    if (v.empty()) {
+        return;
+    }
+    std::sort(v.begin(), v.end());
+    printf("  %-36s %7zu %9.1f %9.1f %9.1f\n", name, v.size(),
+            percentile(v, 0.5) / 1000.0, percentile(v, 0.99) / 1000.0,
+            v.back() / 1000.0);
+}
+
+static bool runWorkload(struct ril_client *client, struct fake_modem *modem,
+        clockid_t rildCpu, const Workload &workload, int count, int burst) {
+    Results results;
+    int totalWeight = 0;
+    unsigned int seed = 1;
+
+    results.errors = 0;
+    for (int k = 0; k < NUM_KINDS; k++) {
+        totalWeight += workload.weights[k];
+    }
+
+    int64_t cpuStart = processCpuNs(rildCpu);
+    int32_t commandsStart = fake_modem_commands(modem);
+    int64_t start = nowNs();
+
+    for (int i = 0; i < count; i++) {
+        if (workload.burstEvery > 0 && i % workload.burstEvery == 0) {
+            fake_modem_burst(modem, "ring", burst);
+        }
+
+        // same sequence every run, so runs can be compared
+        int pick = rand_r(&seed) % totalWeight;
+        int kind = 0;
+        while (pick >= workload.weights[kind]) {
+            pick -= workload.weights[kind++];
+        }
+
+        int32_t error;
+        if (!roundTrip(client, modem, (RequestKind) kind, &results, &error)) {
+            return false;
+        }
+        if (error != RIL_E_SUCCESS) {
+            results.errors++;
+        }
+    }
+
+    // let the last burst drain
+    struct ril_client_response response;
+    while (fake_modem_pending_unsol(modem) > 0
+            && ril_client_receive(client, &response, 1000)) {
+        if (response.unsolicited) {
+            recordUnsolicited(modem, response, &results);
+        }
+    }
+    size_t lost = fake_modem_drop_unsol(modem);
+
+    int64_t elapsed = nowNs() - start;
+    int64_t cpu = processCpuNs(rildCpu) - cpuStart;
+    int32_t commands = fake_modem_commands(modem) - commandsStart;
+
+    printf("%s: %d requests in %.2f s, %.1f us rild CPU/request, "
+            "%.1f AT commands/request, %d errors", workload.name, count,
+            elapsed / 1e9, cpu / 1000.0 / count, (double) commands / count,
+            results.errors);
+    if (lost > 0) {
+        printf(", %zu unsolicited lost", lost);
+    }
+    printf("\n  %-36s %7s %9s %9s %9s\n", "", "count", "p50 us", "p99 us", "max us");
+    for (int k = 0; k < NUM_KINDS; k++) {
+        printLatencies(requestToString(s_requests[k]), results.roundTrip[k]);
+    }
+    printLatencies("unsolicited delivery", results.unsolDelivery);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const char *workloadName = NULL;
+    const char *scriptPath = NULL;
+    std::string script = s_defaultScript;
+    int count = 1000;
+    int burst = 4;
+    bool verbose = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:w:b:s:v")) != -1) {
+        switch (opt) {
+            case 'n': count = atoi(optarg); break;
+            case 'w': workloadName = optarg; break;
+            case 'b': burst = atoi(optarg); break;
+            case 's': scriptPath = optarg; break;
+            case 'v': verbose = true; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (count <= 0 || burst < 0) {
+        usage(argv[0]);
+    }
+    if (workloadName != NULL) {
+        size_t i = 0;
+        while (i < NUM_ELEMS(s_workloads) && strcmp(workloadName, s_workloads[i].name) != 0) {
+            i++;
+        }
+        if (i == NUM_ELEMS(s_workloads)) {
+            usage(argv[0]);
+        }
+    }
+    if (scriptPath != NULL) {
+        script.clear();
+        if (!readScript(scriptPath, &script)) {
+            return EXIT_FAILURE;
+        }
+    }
+    if (!verbose) {
+        // host liblog writes to stderr; the RIL logs every request
+        setenv("ANDROID_LOG_TAGS", "*:s", 0);
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    char dir[] = "/tmp/ril_latency_benchmark.XXXXXX";
+    std::string rildPath, debugPath;
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+    if (!createControlSocket(dir, "rild", &rildPath)
+            || !createControlSocket(dir, "rild-debug", &debugPath)) {
+        return EXIT_FAILURE;
+    }
+
+    struct fake_modem *modem = fake_modem_new(script.c_str());
+    if (modem == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return EXIT_FAILURE;
+    }
+    if (pid == 0) {
+        runRild(fake_modem_path(modem));
+    }
+
+    int ret = EXIT_FAILURE;
+    struct ril_client client;
+    clockid_t rildCpu;
+
+    if (!fake_modem_start(modem)) {
+        goto done;
+    }
+    if (clock_getcpuclockid(pid, &rildCpu) != 0) {
+        fprintf(stderr, "no CPU clock for the rild process\n");
+        goto done;
+    }
+
+    // libril only starts listening once reference-ril is registered
+    for (int i = 0; !ril_client_connect(&client, rildPath.c_str()); i++) {
+        if (i == 50 || waitpid(pid, NULL, WNOHANG) == pid) {
+            fprintf(stderr, "connect to %s: %s\n", rildPath.c_str(), strerror(errno));
+            goto done;
+        }
+        usleep(100 * 1000);
+    }
+    if (!waitForRadio(&client, modem)) {
+        goto close;
+    }
+
+    ret = EXIT_SUCCESS;
+    for (size_t i = 0; i < NUM_ELEMS(s_workloads) && ret == EXIT_SUCCESS; i++) {
+        if (workloadName != NULL && strcmp(workloadName, s_workloads[i].name) != 0) {
+            continue;
+        }
+        if (!runWorkload(&client, modem, rildCpu, s_workloads[i], count, burst)) {
+            ret = EXIT_FAILURE;
+        }
+    }
+
+close:
+    ril_client_close(&client);
+done:
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    fake_modem_free(modem);
+    unlink(rildPath.c_str());
+    unlink(debugPath.c_str());
+    rmdir(dir);
+    return ret;
+}
+
+// There is no power HAL on the host; libril's wake lock is a no-op here.
+extern "C" int acquire_wake_lock(int lock, const char *id) {
+    return 0;
+}
+
+extern "C" int release_wake_lock(const char *id) {
+    return 0;
+}